@@ -0,0 +1,207 @@
+"""
+Compares mods linked with the selective exports of windhawk_api.h against the
+same mods linked with --export-all-symbols, as done by older versions.
+
+Reports, for each mod:
+* The DLL size and the number of exported names.
+* The time to load and unload the DLL, which includes mapping it, applying
+  relocations and running its static initializers (but not Wh_ModInit).
+* The time of a GetProcAddress lookup of a mod callback. Older engines looked
+  up the callback on each call, newer ones look it up once, when the mod is
+  loaded, so this is the per-call overhead which was removed.
+
+Must run on Windows, with the Python architecture matching the target. Usage:
+
+python compare_mod_exports.py ^
+    --compiler-path "C:\\Program Files\\Windhawk\\Compiler" ^
+    --engine-path "C:\\Program Files\\Windhawk\\Engine\\1.7" ^
+    mod1.wh.cpp mod2.wh.cpp
+"""
+
+import argparse
+import ctypes
+import os
+import statistics
+import struct
+import subprocess
+import tempfile
+import time
+from ctypes import wintypes
+from pathlib import Path
+
+CALLBACK_NAMES = [
+    b'_Z10Wh_ModInitv',
+    b'_Z15Wh_ModAfterInitv',
+    b'_Z18Wh_ModBeforeUninitv',
+    b'_Z12Wh_ModUninitv',
+    b'_Z21Wh_ModSettingsChangedPi',
+    b'_Z21Wh_ModSettingsChangedv',
+]
+
+TARGET_SUBFOLDERS = {
+    'i686-w64-mingw32': '32',
+    'x86_64-w64-mingw32': '64',
+    'aarch64-w64-mingw32': 'arm64',
+}
+
+LOAD_WITH_ALTERED_SEARCH_PATH = 0x00000008
+
+kernel32 = ctypes.WinDLL('kernel32', use_last_error=True)
+kernel32.LoadLibraryExW.restype = wintypes.HMODULE
+kernel32.LoadLibraryExW.argtypes = [wintypes.LPCWSTR, wintypes.HANDLE,
+                                    wintypes.DWORD]
+kernel32.FreeLibrary.argtypes = [wintypes.HMODULE]
+kernel32.GetProcAddress.restype = ctypes.c_void_p
+kernel32.GetProcAddress.argtypes = [wintypes.HMODULE, wintypes.LPCSTR]
+
+
+def compile_mod(args, source_path: Path, output_path: Path, export_all: bool):
+    engine_lib_path = (Path(args.engine_path) /
+                       TARGET_SUBFOLDERS[args.target] / 'windhawk.lib')
+
+    # Keep in sync with getCompileModArgs in compilerUtils.ts.
+    compile_args = [
+        str(Path(args.compiler_path) / 'bin' / 'clang++.exe'),
+        '-std=c++23',
+        '-O2',
+        '-shared',
+        '-DUNICODE',
+        '-D_UNICODE',
+        '-DWINVER=0x0A00',
+        '-D_WIN32_WINNT=0x0A00',
+        '-D_WIN32_IE=0x0A00',
+        '-DNTDDI_VERSION=0x0A000008',
+        '-D__USE_MINGW_ANSI_STDIO=0',
+        '-DWH_MOD',
+        '-DWH_MOD_ID=L"compare-mod-exports"',
+        '-DWH_MOD_VERSION=L"1.0"',
+        str(engine_lib_path),
+        '-x',
+        'c++',
+        '-',
+        '-include',
+        'windhawk_api.h',
+        '-target',
+        args.target,
+        '-o',
+        str(output_path),
+    ]
+
+    if export_all:
+        compile_args += ['-DWH_EXPORT_ALL_SYMBOLS', '-Wl,--export-all-symbols']
+
+    subprocess.run(compile_args, input=source_path.read_bytes(),
+                   cwd=args.compiler_path, check=True)
+
+
+def count_exported_names(dll_path: Path):
+    data = dll_path.read_bytes()
+
+    pe_offset = struct.unpack_from('<I', data, 0x3C)[0]
+    section_count, optional_header_size = struct.unpack_from(
+        '<2xH12xH', data, pe_offset + 4)
+    optional_header_offset = pe_offset + 24
+    magic = struct.unpack_from('<H', data, optional_header_offset)[0]
+    data_directories_offset = optional_header_offset + (
+        112 if magic == 0x20B else 96)
+    export_rva = struct.unpack_from('<I', data, data_directories_offset)[0]
+    if export_rva == 0:
+        return 0
+
+    sections_offset = optional_header_offset + optional_header_size
+    for i in range(section_count):
+        virtual_size, virtual_address, _, raw_offset = struct.unpack_from(
+            '<8xIIII', data, sections_offset + i * 40)
+        if virtual_address <= export_rva < virtual_address + virtual_size:
+            export_offset = export_rva - virtual_address + raw_offset
+            return struct.unpack_from('<I', data, export_offset + 24)[0]
+
+    raise ValueError(f'Export directory not found: {dll_path}')
+
+
+def measure_load_time_us(dll_path: Path, iterations: int):
+    durations = []
+    for _ in range(iterations):
+        start = time.perf_counter_ns()
+        module = kernel32.LoadLibraryExW(str(dll_path), None,
+                                         LOAD_WITH_ALTERED_SEARCH_PATH)
+        if not module:
+            raise ctypes.WinError(ctypes.get_last_error())
+        kernel32.FreeLibrary(module)
+        durations.append(time.perf_counter_ns() - start)
+
+    return statistics.median(durations) / 1000
+
+
+def measure_lookup_time_ns(dll_path: Path, iterations: int):
+    module = kernel32.LoadLibraryExW(str(dll_path), None,
+                                     LOAD_WITH_ALTERED_SEARCH_PATH)
+    if not module:
+        raise ctypes.WinError(ctypes.get_last_error())
+
+    try:
+        # The ctypes call overhead is included, and is the same for both
+        # variants.
+        durations = []
+        for _ in range(iterations):
+            start = time.perf_counter_ns()
+            for name in CALLBACK_NAMES:
+                kernel32.GetProcAddress(module, name)
+            durations.append(time.perf_counter_ns() - start)
+    finally:
+        kernel32.FreeLibrary(module)
+
+    return statistics.median(durations) / len(CALLBACK_NAMES)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compare selective and full mod exports.')
+    parser.add_argument('--compiler-path', required=True)
+    parser.add_argument('--engine-path', required=True)
+    parser.add_argument('--target', default='x86_64-w64-mingw32',
+                        choices=TARGET_SUBFOLDERS.keys())
+    parser.add_argument('--iterations', type=int, default=200)
+    parser.add_argument('mod_sources', nargs='+', type=Path)
+    args = parser.parse_args()
+
+    # Keep the engine loaded, so that only the mod is loaded and unloaded.
+    engine_dll_path = (Path(args.engine_path) /
+                       TARGET_SUBFOLDERS[args.target] / 'windhawk.dll')
+    os.add_dll_directory(str(engine_dll_path.parent))
+    engine_module = kernel32.LoadLibraryExW(str(engine_dll_path), None,
+                                            LOAD_WITH_ALTERED_SEARCH_PATH)
+    if not engine_module:
+        raise ctypes.WinError(ctypes.get_last_error())
+
+    print(f'{"mod":<32} {"exports":>12} {"size (KB)":>16} '
+          f'{"load (us)":>18} {"lookup (ns)":>18}')
+
+    with tempfile.TemporaryDirectory() as temp_dir:
+        for source_path in args.mod_sources:
+            results = {}
+            for export_all in [True, False]:
+                dll_path = (Path(temp_dir) /
+                            f'{source_path.stem}_{int(export_all)}.dll')
+                compile_mod(args, source_path, dll_path, export_all)
+                results[export_all] = (
+                    count_exported_names(dll_path),
+                    dll_path.stat().st_size / 1024,
+                    measure_load_time_us(dll_path, args.iterations),
+                    measure_lookup_time_ns(dll_path, args.iterations),
+                )
+
+            # Each column shows the value with all symbols exported, then with
+            # the selective exports.
+            all_exports, selective = results[True], results[False]
+            print(f'{source_path.name:<32} '
+                  f'{all_exports[0]:>5} -> {selective[0]:<4} '
+                  f'{all_exports[1]:>7.1f} -> {selective[1]:<6.1f} '
+                  f'{all_exports[2]:>8.1f} -> {selective[2]:<7.1f} '
+                  f'{all_exports[3]:>8.1f} -> {selective[3]:<7.1f}')
+
+    kernel32.FreeLibrary(engine_module)
+
+
+if __name__ == '__main__':
+    main()
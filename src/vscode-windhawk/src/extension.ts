@@ -83,13 +83,18 @@ export function activate(context: vscode.ExtensionContext) {
 	try {
 		i18n.init(context.extensionPath);
 
-		windhawkLogOutput = new WindhawkLogOutput(path.join(context.extensionPath, 'files', 'DbgViewMini.exe'));
 		windhawkCompilerOutput = vscode.window.createOutputChannel('Windhawk Compiler');
 
 		const arm64Enabled = process.env.WINDHAWK_ARM64_ENABLED === '1';
 
 		const paths = storagePaths.getStoragePaths();
 		const { appRootPath, appDataPath, enginePath, compilerPath } = paths.fsPaths;
+
+		windhawkLogOutput = new WindhawkLogOutput(
+			path.join(appRootPath, 'windhawk.exe'),
+			path.join(context.extensionPath, 'files', 'DbgViewMini.exe')
+		);
+
 		const utils: AppUtils = {
 			modSource: new ModSourceUtils(appDataPath),
 			modConfig: paths.portable
@@ -792,6 +797,8 @@ class WindhawkPanel {
 					// includeExcludeCustomOnly: false,
 					// patternsMatchCriticalSystemProcesses: false,
 					architecture: metadata.architecture || [],
+					threadAgnostic: metadata.threadAgnostic === 'true',
+					hotSwapEnabled: metadata.hotSwap === 'true',
 					version: metadata.version || ''
 				}, {
 					initialSettings: initialSettings || {},
@@ -865,6 +872,8 @@ class WindhawkPanel {
 					// includeExcludeCustomOnly: false,
 					// patternsMatchCriticalSystemProcesses: false,
 					architecture: metadata.architecture || [],
+					threadAgnostic: metadata.threadAgnostic === 'true',
+					hotSwapEnabled: metadata.hotSwap === 'true',
 					version: metadata.version || ''
 				});
 
@@ -1027,7 +1036,7 @@ class WindhawkPanel {
 				reportException(e);
 			}
 		},
-		deleteMod: message => {
+		deleteMod: async message => {
 			const data: DeleteModData = message.data;
 
 			let succeeded = false;
@@ -1037,7 +1046,7 @@ class WindhawkPanel {
 				this._utils.modConfig.deleteMod(modId);
 				this._utils.modSource.deleteSource(modId);
 
-				this._utils.modFiles.deleteModFiles(modId);
+				await this._utils.modFiles.deleteModFiles(modId);
 
 				if (modId.startsWith('local@')) {
 					this._utils.editorWorkspace.deleteModFromDrafts(modId.replace(/^local@/, ''));
@@ -1527,6 +1536,8 @@ class WindhawkViewProvider implements vscode.WebviewViewProvider {
 					// includeExcludeCustomOnly: false,
 					// patternsMatchCriticalSystemProcesses: false,
 					architecture: metadata.architecture || [],
+					threadAgnostic: metadata.threadAgnostic === 'true',
+					hotSwapEnabled: metadata.hotSwap === 'true',
 					version: metadata.version || ''
 				}, {
 					initialSettings: initialSettings || {},
@@ -1,15 +1,50 @@
 import * as child_process from 'child_process';
 import * as vscode from 'vscode';
 
+// How long to wait before restarting a log output process which exited.
+const restartDelay = 1000;
+
+type LogOutputProcess = {
+	path: string;
+	args: string[];
+	process?: child_process.ChildProcessWithoutNullStreams;
+	incompleteStdoutBuffer: Buffer;
+	incompleteStderrBuffer: Buffer;
+	restartTimer?: NodeJS.Timeout;
+};
+
 export class WindhawkLogOutput {
-	private _logOutputProcessPath: string;
 	private _logOutputChannel?: vscode.OutputChannel;
-	private _logOutputProcess?: child_process.ChildProcessWithoutNullStreams;
-	private _incompleteStdoutBuffer: Buffer = Buffer.alloc(0);
-	private _incompleteStderrBuffer: Buffer = Buffer.alloc(0);
-
-	constructor(logOutputProcessPath: string) {
-		this._logOutputProcessPath = logOutputProcessPath;
+	private _logOutputProcesses: LogOutputProcess[];
+
+	constructor(windhawkPath: string, dbgViewMiniPath: string) {
+		this._logOutputProcesses = [
+			// Reads the session log which is written by the engine instances
+			// of the running Windhawk session. It waits for a new session if
+			// there's none, or when the current one ends.
+			{
+				path: windhawkPath,
+				args: [
+					'-collect-logs',
+				],
+				incompleteStdoutBuffer: Buffer.alloc(0),
+				incompleteStderrBuffer: Buffer.alloc(0),
+			},
+			// Reads the lines which the engine outputs with OutputDebugString
+			// when they can't be written to the session log, e.g. before a
+			// session is running. Lines which are written to the session log
+			// aren't output this way, so there are no duplicates.
+			{
+				path: dbgViewMiniPath,
+				args: [
+					'--pattern',
+					'[WH] *',
+					'--no-buffering',
+				],
+				incompleteStdoutBuffer: Buffer.alloc(0),
+				incompleteStderrBuffer: Buffer.alloc(0),
+			},
+		];
 	}
 
 	public createOrShow(preserveFocus?: boolean) {
@@ -18,54 +53,25 @@ export class WindhawkLogOutput {
 		}
 		this._logOutputChannel.show(preserveFocus);
 
-		if (!this._logOutputProcess) {
-			const args = [
-				'--pattern',
-				'[WH] *',
-				'--no-buffering',
-			];
-			const ps = child_process.spawn(this._logOutputProcessPath, args);
-
-			this._logOutputProcess = ps;
-
-			ps.stdout.on('data', data => {
-				const dataWithIncompleteBuffer = Buffer.concat([this._incompleteStdoutBuffer, data]);
-				const index = incompleteUTF8Index(dataWithIncompleteBuffer);
-				const dataToOutput = dataWithIncompleteBuffer.subarray(0, index);
-				this._incompleteStdoutBuffer = dataWithIncompleteBuffer.subarray(index);
-				this._logOutputChannel?.append(dataToOutput.toString());
-			});
-
-			ps.stderr.on('data', data => {
-				const dataWithIncompleteBuffer = Buffer.concat([this._incompleteStderrBuffer, data]);
-				const index = incompleteUTF8Index(dataWithIncompleteBuffer);
-				const dataToOutput = dataWithIncompleteBuffer.subarray(0, index);
-				this._incompleteStderrBuffer = dataWithIncompleteBuffer.subarray(index);
-				this._logOutputChannel?.append(dataToOutput.toString());
-			});
-
-			let gotError = false;
-
-			ps.on('error', err => {
-				//console.log('Oh no, the error: ' + err);
-				this._logOutputProcess = undefined;
-				gotError = true;
-				vscode.window.showErrorMessage(err.message);
-			});
-
-			ps.on('close', code => {
-				//console.log(`ps process exited with code ${code}`);
-				if (!gotError) {
-					this._logOutputProcess = undefined;
-				}
-			});
+		for (const logOutputProcess of this._logOutputProcesses) {
+			if (!logOutputProcess.process && !logOutputProcess.restartTimer) {
+				this._startProcess(logOutputProcess);
+			}
 		}
 	}
 
 	public dispose() {
-		if (this._logOutputProcess) {
-			this._logOutputProcess.kill();
-			this._logOutputProcess = undefined;
+		for (const logOutputProcess of this._logOutputProcesses) {
+			if (logOutputProcess.restartTimer) {
+				clearTimeout(logOutputProcess.restartTimer);
+				logOutputProcess.restartTimer = undefined;
+			}
+
+			if (logOutputProcess.process) {
+				const ps = logOutputProcess.process;
+				logOutputProcess.process = undefined;
+				ps.kill();
+			}
 		}
 
 		if (this._logOutputChannel) {
@@ -73,38 +79,62 @@ export class WindhawkLogOutput {
 			this._logOutputChannel = undefined;
 		}
 	}
-}
 
-// Inspired by https://stackoverflow.com/a/27587200
-function incompleteUTF8Index(buf: Buffer) {
-    for (let i = Math.max(buf.length - 3, 0); i < buf.length; i++) {
-        const ch = buf[i];
-        if ((ch & 0xc0) === 0x80) {
-            // 10xxxxxx
-            continue;
-        }
-
-        const leadIndex = i;
-        if ((ch & 0x80) === 0) {
-            // 0xxxxxxx
-        } else if ((ch & 0xe0) === 0xc0) {
-            // 110xxxxx
-            i++;
-        } else if ((ch & 0xf0) === 0xe0) {
-            // 1110xxxx
-            i += 2;
-        } else if ((ch & 0xf8) === 0xf0) {
-            // 11110xxx
-            i += 3;
-        } else {
-            // Unrecognized.
-            break;
-        }
-
-        if (i >= buf.length) {
-            return leadIndex;
-        }
-    }
-
-    return buf.length;
+	private _startProcess(logOutputProcess: LogOutputProcess) {
+		const ps = child_process.spawn(logOutputProcess.path, logOutputProcess.args);
+
+		logOutputProcess.process = ps;
+		logOutputProcess.incompleteStdoutBuffer = Buffer.alloc(0);
+		logOutputProcess.incompleteStderrBuffer = Buffer.alloc(0);
+
+		// Only complete lines are output, so that the lines of the two
+		// processes don't get mixed, and UTF-8 sequences aren't split.
+		ps.stdout.on('data', data => {
+			const dataWithIncompleteBuffer = Buffer.concat([logOutputProcess.incompleteStdoutBuffer, data]);
+			const index = dataWithIncompleteBuffer.lastIndexOf('\n') + 1;
+			const dataToOutput = dataWithIncompleteBuffer.subarray(0, index);
+			logOutputProcess.incompleteStdoutBuffer = dataWithIncompleteBuffer.subarray(index);
+			this._logOutputChannel?.append(dataToOutput.toString());
+		});
+
+		ps.stderr.on('data', data => {
+			const dataWithIncompleteBuffer = Buffer.concat([logOutputProcess.incompleteStderrBuffer, data]);
+			const index = dataWithIncompleteBuffer.lastIndexOf('\n') + 1;
+			const dataToOutput = dataWithIncompleteBuffer.subarray(0, index);
+			logOutputProcess.incompleteStderrBuffer = dataWithIncompleteBuffer.subarray(index);
+			this._logOutputChannel?.append(dataToOutput.toString());
+		});
+
+		let gotError = false;
+
+		ps.on('error', err => {
+			//console.log('Oh no, the error: ' + err);
+			if (logOutputProcess.process === ps) {
+				logOutputProcess.process = undefined;
+			}
+			gotError = true;
+			vscode.window.showErrorMessage(err.message);
+		});
+
+		ps.on('close', code => {
+			//console.log(`ps process exited with code ${code}`);
+			if (gotError || logOutputProcess.process !== ps) {
+				// Failed to start, or killed by dispose.
+				return;
+			}
+
+			logOutputProcess.process = undefined;
+
+			// Restart the process while the output channel is open, e.g. if
+			// the app was restarted or updated.
+			if (this._logOutputChannel) {
+				logOutputProcess.restartTimer = setTimeout(() => {
+					logOutputProcess.restartTimer = undefined;
+					if (this._logOutputChannel && !logOutputProcess.process) {
+						this._startProcess(logOutputProcess);
+					}
+				}, restartDelay);
+			}
+		});
+	}
 }
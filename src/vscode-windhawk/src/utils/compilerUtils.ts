@@ -1,5 +1,7 @@
 import * as child_process from 'child_process';
+import * as crypto from 'crypto';
 import * as fs from 'fs';
+import * as os from 'os';
 import * as path from 'path';
 import * as vscode from 'vscode';
 
@@ -49,19 +51,37 @@ export class CompilerKilled extends Error {
 	}
 }
 
+// Change to invalidate the cached builds, e.g. if the way mods are compiled
+// changes in a way which isn't reflected in the compiler arguments.
+const compilationCacheVersion = 1;
+
+// Per target. The least recently used builds are removed first.
+const compilationCacheMaxEntries = 200;
+
 export default class CompilerUtils {
 	private compilerPath: string;
 	private enginePath: string;
 	private engineModsPath: string;
+	private compilationCachePath: string;
 	private arm64Enabled: boolean;
 	private supportedCompilationTargets: CompilationTarget[];
 	private activeProcesses: Set<child_process.ChildProcess> = new Set();
 	private canceledProcesses: Set<child_process.ChildProcess> = new Set();
+	private compilerIdentities: Map<CompilationTarget, string> = new Map();
+
+	// Targets are compiled concurrently, and so are mods, e.g. when several
+	// mods are updated at once. The number of compiler processes is limited
+	// to the number of CPUs, the rest wait in a queue.
+	private maxCompilationSlots = Math.max(1, os.cpus().length);
+	private usedCompilationSlots = 0;
+	private compilationSlotQueue: (() => void)[] = [];
+	private cancelGeneration = 0;
 
 	public constructor(compilerPath: string, enginePath: string, appDataPath: string, arm64Enabled: boolean) {
 		this.compilerPath = compilerPath;
 		this.enginePath = enginePath;
 		this.engineModsPath = path.join(appDataPath, 'Engine', 'Mods');
+		this.compilationCachePath = path.join(appDataPath, 'CompilationCache');
 		this.arm64Enabled = arm64Enabled;
 
 		this.supportedCompilationTargets = [
@@ -232,22 +252,17 @@ export default class CompilerUtils {
 		});
 	}
 
-	private async compileModInternal(
+	private getCompileModArgs(
 		modSourceCode: string,
-		targetDllName: string,
+		compiledModDllPath: string,
 		target: CompilationTarget,
 		modId: string,
 		modVersion: string,
 		extraArgs: string[],
 		pchPath?: string
-	): Promise<CompilationResult> {
-		const clangPath = path.join(this.compilerPath, 'bin', 'clang++.exe');
-
+	) {
 		const subfolder = this.subfolderFromCompilationTarget(target);
 		const engineLibPath = path.join(this.enginePath, subfolder, 'windhawk.lib');
-		const compiledModDllPath = path.join(this.engineModsPath, subfolder, targetDllName);
-
-		fs.mkdirSync(path.dirname(compiledModDllPath), { recursive: true });
 
 		const windowsVersionFlags = [
 			'classic-taskdlg-fix\n1.1.0',
@@ -286,6 +301,14 @@ export default class CompilerUtils {
 			backwardCompatibilityFlags.push('-include', 'vector');
 		}
 
+		// Only the symbols which are marked with dllexport in windhawk_api.h
+		// are exported, which keeps the export table small. All symbols are
+		// exported, as before, if the source doesn't fit these declarations,
+		// see modRequiresExportAllSymbols.
+		if (modRequiresExportAllSymbols(modSourceCode)) {
+			backwardCompatibilityFlags.push('-DWH_EXPORT_ALL_SYMBOLS', '-Wl,--export-all-symbols');
+		}
+
 		const args = [
 			'-std=c++23',
 			'-O2',
@@ -305,13 +328,22 @@ export default class CompilerUtils {
 			'windhawk_api.h',
 			'-target',
 			target,
-			'-Wl,--export-all-symbols',
 			'-o',
 			compiledModDllPath,
 			...(pchPath ? ['-include-pch', pchPath] : []),
 			...extraArgs,
 			...backwardCompatibilityFlags,
 		];
+
+		return args;
+	}
+
+	private async compileModInternal(
+		modSourceCode: string,
+		args: string[]
+	): Promise<CompilationResult> {
+		const clangPath = path.join(this.compilerPath, 'bin', 'clang++.exe');
+
 		const ps = child_process.spawn(clangPath, args, {
 			cwd: this.compilerPath
 		});
@@ -415,71 +447,230 @@ export default class CompilerUtils {
 		}
 	}
 
-	public async compileMod(
+	private async acquireCompilationSlot() {
+		const generation = this.cancelGeneration;
+
+		if (this.usedCompilationSlots < this.maxCompilationSlots) {
+			this.usedCompilationSlots++;
+		} else {
+			// The slot is handed over by releaseCompilationSlot.
+			await new Promise<void>(resolve => this.compilationSlotQueue.push(resolve));
+		}
+
+		if (generation !== this.cancelGeneration) {
+			this.releaseCompilationSlot();
+			throw new CompilerKilled();
+		}
+	}
+
+	private releaseCompilationSlot() {
+		const next = this.compilationSlotQueue.shift();
+		if (next) {
+			next();
+		} else {
+			this.usedCompilationSlots--;
+		}
+	}
+
+	private getCompilerIdentity(target: CompilationTarget) {
+		let identity = this.compilerIdentities.get(target);
+		if (identity !== undefined) {
+			return identity;
+		}
+
+		const hash = crypto.createHash('sha256');
+
+		const clangPath = path.join(this.compilerPath, 'bin', 'clang++.exe');
+		const engineLibPath = path.join(this.enginePath, this.subfolderFromCompilationTarget(target), 'windhawk.lib');
+		for (const filePath of [clangPath, engineLibPath]) {
+			const stat = fs.statSync(filePath);
+			hash.update(`${filePath}\n${stat.size}\n${stat.mtimeMs}\n`);
+		}
+
+		const apiHeaderPaths = [
+			path.join(this.compilerPath, 'include', 'windhawk_api.h'),
+			path.join(this.compilerPath, target, 'include', 'windhawk_api.h'),
+		];
+		for (const filePath of apiHeaderPaths) {
+			if (fs.existsSync(filePath)) {
+				hash.update(`${filePath}\n`);
+				hash.update(fs.readFileSync(filePath));
+			}
+		}
+
+		identity = hash.digest('hex');
+		this.compilerIdentities.set(target, identity);
+		return identity;
+	}
+
+	private getCompilationCacheKey(
+		target: CompilationTarget,
+		args: string[],
+		modSourceCode: string,
+		pchHeaderPath?: string
+	) {
+		try {
+			const hash = crypto.createHash('sha256');
+			hash.update(JSON.stringify({
+				version: compilationCacheVersion,
+				target,
+				compiler: this.getCompilerIdentity(target),
+				args,
+			}));
+			hash.update('\n');
+			if (pchHeaderPath) {
+				hash.update(fs.readFileSync(pchHeaderPath));
+				hash.update('\n');
+			}
+			hash.update(modSourceCode);
+			return hash.digest('hex');
+		} catch (e: unknown) {
+			// Compile without the cache, which reports missing files properly.
+			console.error('Failed to compute compilation cache key:', e);
+			return undefined;
+		}
+	}
+
+	private restoreFromCompilationCache(cachedDllPath: string, compiledModDllPath: string) {
+		try {
+			fs.copyFileSync(cachedDllPath, compiledModDllPath);
+		} catch (e: unknown) {
+			if ((e as NodeJS.ErrnoException).code !== 'ENOENT') {
+				console.error('Failed to use cached build:', e);
+			}
+			return false;
+		}
+
+		// Mark as recently used.
+		try {
+			const now = new Date();
+			fs.utimesSync(cachedDllPath, now, now);
+		} catch (e: unknown) {
+			console.error('Failed to update cached build time:', e);
+		}
+
+		return true;
+	}
+
+	private storeInCompilationCache(cachedDllPath: string, compiledModDllPath: string) {
+		try {
+			const cacheDir = path.dirname(cachedDllPath);
+			fs.mkdirSync(cacheDir, { recursive: true });
+
+			// Copy under a temporary name first, so that a partially written
+			// file is never used.
+			const tempPath = `${cachedDllPath}.${crypto.randomBytes(4).toString('hex')}.tmp`;
+			fs.copyFileSync(compiledModDllPath, tempPath);
+			fs.renameSync(tempPath, cachedDllPath);
+
+			const entries = fs.readdirSync(cacheDir)
+				.filter(name => name.endsWith('.dll'))
+				.map(name => {
+					const filePath = path.join(cacheDir, name);
+					return { filePath, mtimeMs: fs.statSync(filePath).mtimeMs };
+				});
+			if (entries.length > compilationCacheMaxEntries) {
+				entries.sort((a, b) => a.mtimeMs - b.mtimeMs);
+				for (const { filePath } of entries.slice(0, entries.length - compilationCacheMaxEntries)) {
+					fs.unlinkSync(filePath);
+				}
+			}
+		} catch (e: unknown) {
+			console.error('Failed to store build in cache:', e);
+		}
+	}
+
+	private async compileModForTarget(
 		modId: string,
 		modVersion: string,
-		modTargets: string[],
 		modSourceCode: string,
-		architectures: string[],
-		compilerOptions: string | undefined,
+		targetDllName: string,
+		target: CompilationTarget,
+		compilerOptionsArray: string[],
 		precompiledHeadersFolder?: string
 	) {
-		let targetDllName: string;
-		for (; ;) {
-			targetDllName = modId + '_' + modVersion + '_' + randomIntFromInterval(100000, 999999) + '.dll';
-			if (this.supportedCompilationTargets.every(target => !this.doesCompiledModExist(targetDllName, target))) {
-				break;
+		const subfolder = this.subfolderFromCompilationTarget(target);
+		const compiledModDllPath = path.join(this.engineModsPath, subfolder, targetDllName);
+
+		fs.mkdirSync(path.dirname(compiledModDllPath), { recursive: true });
+
+		let pchHeaderPath: string | undefined = undefined;
+		let pchPath: string | undefined = undefined;
+		if (precompiledHeadersFolder) {
+			pchHeaderPath = path.join(precompiledHeadersFolder, 'windhawk_pch.h');
+			if (fs.existsSync(pchHeaderPath)) {
+				pchPath = path.join(precompiledHeadersFolder, `windhawk_t_${target}.pch`);
+			} else {
+				pchHeaderPath = undefined;
 			}
 		}
 
-		let compilerOptionsArray: string[] = [];
-		if (compilerOptions && compilerOptions.trim() !== '') {
-			compilerOptionsArray = splitargs(compilerOptions);
+		// The output path has a random name, and is left out of the key.
+		const cacheKey = this.getCompilationCacheKey(
+			target,
+			this.getCompileModArgs(
+				modSourceCode,
+				'',
+				target,
+				modId,
+				modVersion,
+				compilerOptionsArray,
+				pchPath
+			),
+			modSourceCode,
+			pchHeaderPath
+		);
+		const cachedDllPath = cacheKey !== undefined
+			? path.join(this.compilationCachePath, subfolder, `${cacheKey}.dll`)
+			: undefined;
+
+		if (cachedDllPath && this.restoreFromCompilationCache(cachedDllPath, compiledModDllPath)) {
+			console.log(`Using cached build for target ${target}`);
+			return;
 		}
 
-		for (const target of this.compilationTargetsFromArchitecture(architectures, modTargets)) {
-			let pchPath: string | undefined = undefined;
-			if (precompiledHeadersFolder) {
-				const pchHeaderPath = path.join(precompiledHeadersFolder, 'windhawk_pch.h');
-				if (fs.existsSync(pchHeaderPath)) {
-					pchPath = path.join(precompiledHeadersFolder, `windhawk_t_${target}.pch`);
-					if (!fs.existsSync(pchPath) ||
-						fs.statSync(pchPath).mtimeMs < fs.statSync(pchHeaderPath).mtimeMs) {
-						const { exitCode, stdout, stderr } = await this.makePrecompiledHeaders(
-							pchHeaderPath,
-							pchPath,
+		await this.acquireCompilationSlot();
+		try {
+			if (pchHeaderPath && pchPath) {
+				if (!fs.existsSync(pchPath) ||
+					fs.statSync(pchPath).mtimeMs < fs.statSync(pchHeaderPath).mtimeMs) {
+					const { exitCode, stdout, stderr } = await this.makePrecompiledHeaders(
+						pchHeaderPath,
+						pchPath,
+						target,
+						modId,
+						modVersion,
+						compilerOptionsArray
+					);
+					if (exitCode !== 0) {
+						throw new CompilerError(
 							target,
-							modId,
-							modVersion,
-							compilerOptionsArray
+							exitCode,
+							stdout,
+							stderr
 						);
-						if (exitCode !== 0) {
-							throw new CompilerError(
-								target,
-								exitCode,
-								stdout,
-								stderr
-							);
-						}
+					}
 
-						if (stdout) {
-							console.log(`Precompiled headers stdout for target ${target}:\n${stdout}`);
-						}
-						if (stderr) {
-							console.log(`Precompiled headers stderr for target ${target}:\n${stderr}`);
-						}
+					if (stdout) {
+						console.log(`Precompiled headers stdout for target ${target}:\n${stdout}`);
+					}
+					if (stderr) {
+						console.log(`Precompiled headers stderr for target ${target}:\n${stderr}`);
 					}
 				}
 			}
 
 			const { exitCode, stdout, stderr } = await this.compileModInternal(
 				modSourceCode,
-				targetDllName,
-				target,
-				modId,
-				modVersion,
-				compilerOptionsArray,
-				pchPath
+				this.getCompileModArgs(
+					modSourceCode,
+					compiledModDllPath,
+					target,
+					modId,
+					modVersion,
+					compilerOptionsArray,
+					pchPath
+				)
 			);
 			if (exitCode !== 0) {
 				throw new CompilerError(
@@ -496,6 +687,55 @@ export default class CompilerUtils {
 			if (stderr) {
 				console.log(`Compiler stderr for target ${target}:\n${stderr}`);
 			}
+		} finally {
+			this.releaseCompilationSlot();
+		}
+
+		if (cachedDllPath) {
+			this.storeInCompilationCache(cachedDllPath, compiledModDllPath);
+		}
+	}
+
+	public async compileMod(
+		modId: string,
+		modVersion: string,
+		modTargets: string[],
+		modSourceCode: string,
+		architectures: string[],
+		compilerOptions: string | undefined,
+		precompiledHeadersFolder?: string
+	) {
+		let targetDllName: string;
+		for (; ;) {
+			targetDllName = modId + '_' + modVersion + '_' + randomIntFromInterval(100000, 999999) + '.dll';
+			if (this.supportedCompilationTargets.every(target => !this.doesCompiledModExist(targetDllName, target))) {
+				break;
+			}
+		}
+
+		let compilerOptionsArray: string[] = [];
+		if (compilerOptions && compilerOptions.trim() !== '') {
+			compilerOptionsArray = splitargs(compilerOptions);
+		}
+
+		const targets = this.compilationTargetsFromArchitecture(architectures, modTargets);
+
+		const results = await Promise.allSettled(targets.map(target => this.compileModForTarget(
+			modId,
+			modVersion,
+			modSourceCode,
+			targetDllName,
+			target,
+			compilerOptionsArray,
+			precompiledHeadersFolder
+		)));
+
+		// Report the error of the first failed target, same as if the targets
+		// were compiled one after another.
+		for (const result of results) {
+			if (result.status === 'rejected') {
+				throw result.reason;
+			}
 		}
 
 		return {
@@ -504,6 +744,10 @@ export default class CompilerUtils {
 	}
 
 	public cancelCompilation() {
+		// Compilations which are waiting for a slot are aborted once they get
+		// it.
+		this.cancelGeneration++;
+
 		for (const process of this.activeProcesses) {
 			this.canceledProcesses.add(process);
 			try {
@@ -528,6 +772,114 @@ function randomIntFromInterval(min: number, max: number) {
 	return Math.floor(Math.random() * (max - min + 1) + min);
 }
 
+// The mod callbacks, which windhawk_api.h declares with dllexport, and the
+// definitions which are compatible with these declarations.
+const exportedModCallbacks: Record<string, { returnType: string, params: RegExp }[]> = {
+	Wh_ModInit: [{ returnType: 'BOOL', params: /^(?:void)?$/ }],
+	Wh_ModAfterInit: [{ returnType: 'void', params: /^(?:void)?$/ }],
+	Wh_ModBeforeUninit: [{ returnType: 'void', params: /^(?:void)?$/ }],
+	Wh_ModUninit: [{ returnType: 'void', params: /^(?:void)?$/ }],
+	Wh_ModSettingsChanged: [
+		{ returnType: 'BOOL', params: /^BOOL\s*\*\s*\w*$/ },
+		{ returnType: 'void', params: /^(?:void)?$/ },
+	],
+};
+
+// Functions which the engine's shim library patches in older mods, and finds
+// by their exported names.
+const exportedModHelpers = [
+	'HookSymbols',
+	'HookSymbolsWithOnlineCacheFallback',
+	'CmwfHookSymbols',
+];
+
+// Keywords which can precede a call, as opposed to a return type.
+const keywordsBeforeCall = new Set([
+	'return',
+	'co_return',
+	'co_await',
+	'else',
+	'case',
+	'throw',
+	'sizeof',
+	'decltype',
+]);
+
+// Returns whether the mod has to be linked with all symbols exported, and
+// without the dllexport declarations of windhawk_api.h. That's the case if it
+// defines a callback with a signature other than the documented one, e.g.
+// `bool Wh_ModInit()`, which doesn't compile with these declarations, or if it
+// defines one of exportedModHelpers. The check is conservative: a declaration
+// which isn't recognized, e.g. with a calling convention or with `static`,
+// falls back to exporting all symbols, which only makes the mod larger.
+function modRequiresExportAllSymbols(modSourceCode: string) {
+	// A callback with C linkage conflicts with the declarations.
+	if (/\bextern\s*"C"/.test(modSourceCode) && /\bWh_Mod\w+\s*\(/.test(modSourceCode)) {
+		return true;
+	}
+
+	// Blank out comments and literals, keeping the offsets.
+	const code = modSourceCode.replace(
+		/\/\/[^\n]*|\/\*[\s\S]*?\*\/|"(?:\\.|[^"\\\n])*"|'(?:\\.|[^'\\\n])*'/g,
+		match => match.replace(/[^\n]/g, ' ')
+	);
+
+	const names = [...Object.keys(exportedModCallbacks), ...exportedModHelpers];
+	const nameRegex = new RegExp(`\\b(${names.join('|')})\\s*\\(`, 'g');
+
+	for (const match of code.matchAll(nameRegex)) {
+		const name = match[1];
+		const before = code.slice(0, match.index);
+		const precedingToken = before.match(/([A-Za-z_]\w*|\S)\s*$/)?.[1];
+		if (!precedingToken) {
+			continue;
+		}
+
+		if (!/^[A-Za-z_]/.test(precedingToken)) {
+			if (precedingToken === ':' && !(name in exportedModCallbacks)) {
+				// A call, such as `WindhawkUtils::HookSymbols(...)`.
+				continue;
+			}
+
+			if (['*', '&', '>', ':'].includes(precedingToken)) {
+				// A return type which ends with a pointer, a reference or a
+				// template argument list, or a qualified name.
+				return true;
+			}
+
+			// A call, e.g. after `=` or `(`.
+			continue;
+		}
+
+		if (keywordsBeforeCall.has(precedingToken)) {
+			continue;
+		}
+
+		// A declaration or a definition, which may span several lines.
+		const signatures = exportedModCallbacks[name];
+		if (!signatures) {
+			return true;
+		}
+
+		const beforeReturnType = before.slice(0, before.lastIndexOf(precedingToken));
+		if (/\bstatic\b[^;{}]*$/.test(beforeReturnType)) {
+			return true;
+		}
+
+		const declaration = code.slice(match.index + match[0].length).match(/^([^()]*)\)\s*[{;]/);
+		if (!declaration) {
+			return true;
+		}
+
+		const params = declaration[1].trim();
+		if (!signatures.some(signature => signature.returnType === precedingToken && signature.params.test(params))) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 // https://github.com/elgs/splitargs
 function splitargs(input: string, sep?: RegExp, keepQuotes?: boolean) {
 	const separator = sep || /\s/g;
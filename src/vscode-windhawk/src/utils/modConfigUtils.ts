@@ -31,6 +31,8 @@ const CONFIG_FIELDS = [
 	{ name: 'includeExcludeCustomOnly', storageName: 'IncludeExcludeCustomOnly', type: 'boolean' },
 	{ name: 'patternsMatchCriticalSystemProcesses', storageName: 'PatternsMatchCriticalSystemProcesses', type: 'boolean' },
 	{ name: 'architecture', storageName: 'Architecture', type: 'string-array' },
+	{ name: 'threadAgnostic', storageName: 'ThreadAgnostic', type: 'boolean' },
+	{ name: 'hotSwapEnabled', storageName: 'HotSwapEnabled', type: 'boolean' },
 	{ name: 'version', storageName: 'Version', type: 'string' }
 ] as const satisfies readonly FieldDescriptor[];
 
@@ -59,7 +59,10 @@ export default class ModFilesUtils {
 		return subfolders;
 	}
 
+	// Returns the paths of the files which couldn't be deleted because they're
+	// in use.
 	private deleteOldModFilesInFolder(modId: string, subfolder: ArchitectureSubfolder, currentDllName?: string) {
+		const filesInUse: string[] = [];
 		const compiledModsPath = path.join(this.engineModsPath, subfolder);
 
 		let compiledModsDir: fs.Dir;
@@ -70,7 +73,7 @@ export default class ModFilesUtils {
 			if (e.code !== 'ENOENT') {
 				throw e;
 			}
-			return;
+			return filesInUse;
 		}
 
 		try {
@@ -96,15 +99,15 @@ export default class ModFilesUtils {
 
 				const compiledModPath = path.join(compiledModsPath, filename);
 
-				try {
-					fs.unlinkSync(compiledModPath);
-				} catch (e) {
-					// Ignore errors (file may be in use).
+				if (!tryDeleteFile(compiledModPath)) {
+					filesInUse.push(compiledModPath);
 				}
 			}
 		} finally {
 			compiledModsDir.closeSync();
 		}
+
+		return filesInUse;
 	}
 
 	public deleteOldModFiles(modId: string, architectures: string[], currentDllName?: string) {
@@ -206,19 +209,39 @@ export default class ModFilesUtils {
 		return { targetDllName };
 	}
 
-	public deleteModFiles(modId: string) {
+	public async deleteModFiles(modId: string) {
 		// Delete all files for all architectures
 		const allSubfolders: ArchitectureSubfolder[] = ['32', '64'];
 		if (this.arm64Enabled) {
 			allSubfolders.push('arm64');
 		}
 
+		let filesInUse: string[] = [];
 		for (const subfolder of allSubfolders) {
-			this.deleteOldModFilesInFolder(modId, subfolder);
+			filesInUse.push(...this.deleteOldModFilesInFolder(modId, subfolder));
+		}
+
+		// The engine keeps the libraries of enabled mods mapped, and releases
+		// them shortly after the mod config is removed, as do the processes
+		// which loaded the mod. Retry for a bit before giving up.
+		for (let attempt = 0; filesInUse.length > 0 && attempt < 10; attempt++) {
+			await new Promise(resolve => setTimeout(resolve, 100));
+			filesInUse = filesInUse.filter(filePath => !tryDeleteFile(filePath));
 		}
 	}
 }
 
+function tryDeleteFile(filePath: string) {
+	try {
+		fs.unlinkSync(filePath);
+	} catch (e: any) {
+		// Ignore errors (file may be in use).
+		return e.code === 'ENOENT';
+	}
+
+	return true;
+}
+
 // https://stackoverflow.com/a/7228322
 // min and max included
 function randomIntFromInterval(min: number, max: number) {
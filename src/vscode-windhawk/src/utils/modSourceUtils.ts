@@ -14,6 +14,8 @@ const modMetadataParams = {
 		'compilerOptions',
 		'license',
 		'donateUrl',
+		'threadAgnostic',
+		'hotSwap',
 	],
 	singleValueLocalizable: [
 		'name',
@@ -169,6 +171,14 @@ export default class ModSourceUtils {
 				throw new Error(`Mod architecture must be one of ${supportedArchitecture.join(', ')}: ${architecture}`);
 			}
 		}
+
+		if (metadata.threadAgnostic !== undefined && !['true', 'false'].includes(metadata.threadAgnostic)) {
+			throw new Error(`Mod threadAgnostic must be one of true, false: ${metadata.threadAgnostic}`);
+		}
+
+		if (metadata.hotSwap !== undefined && !['true', 'false'].includes(metadata.hotSwap)) {
+			throw new Error(`Mod hotSwap must be one of true, false: ${metadata.hotSwap}`);
+		}
 	}
 
 	public extractMetadata(modSource: string, language: string) {
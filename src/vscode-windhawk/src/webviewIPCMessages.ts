@@ -98,6 +98,8 @@ export type ModMetadata = Partial<{
   compilerOptions: string;
   license: string;
   donateUrl: string;
+  threadAgnostic: string;
+  hotSwap: string;
   name: string;
   description: string;
   author: string;
@@ -3,8 +3,12 @@
 #include "functions.h"
 #include "logger.h"
 #include "main_window.h"
+#include "mod_status.h"
 #include "resource.h"
 #include "service.h"
+#include "service_common.h"
+#include "session_log.h"
+#include "startup_profile.h"
 #include "storage_manager.h"
 #include "ui_control.h"
 
@@ -27,8 +31,18 @@ enum class Action {
     kExit,
     kRestart,
     kRestartBg,
+    kCollectLogs,
+    kStartupProfile,
+    kMemoryUsage,
 };
 
+// How often the session log is polled for new records.
+constexpr DWORD kCollectLogsPollInterval = 100;
+
+// A record which is still being written after this long is skipped, its writer
+// was probably terminated in the middle of the write.
+constexpr DWORD kCollectLogsPendingTimeout = 1000;
+
 void Initialize();
 void Run(Action action);
 void RunDaemon();
@@ -38,6 +52,10 @@ void NotifyAppSettingsChanged();
 void ExitApp(bool wait, DWORD timeout);
 void RestartApp(DWORD timeout, bool trayOnly);
 void RestartAppBg(DWORD timeout);
+void CollectLogs(PCWSTR modNameFilter);
+void ExportStartupProfile(PCWSTR exportPath);
+void ExportMemoryUsage();
+DWORD GetSessionManagerProcessId();
 void EnableSafeMode();
 void WaitForRunningProcessesToTerminate(DWORD timeout,
                                         bool windhawkBgOnly = false);
@@ -49,6 +67,7 @@ void SetNamedEventForAllSessions(PCWSTR eventNamePrefix);
 bool SetNamedEvent(PCWSTR eventName);
 bool DoesParamExist(PCWSTR param);
 int GetIntParam(PCWSTR param);
+PCWSTR GetStringParam(PCWSTR param);
 
 }  // namespace
 
@@ -99,6 +118,12 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance,
         action = Action::kRestart;
     } else if (DoesParamExist(L"-restart-bg")) {
         action = Action::kRestartBg;
+    } else if (DoesParamExist(L"-collect-logs")) {
+        action = Action::kCollectLogs;
+    } else if (DoesParamExist(L"-startup-profile")) {
+        action = Action::kStartupProfile;
+    } else if (DoesParamExist(L"-memory-usage")) {
+        action = Action::kMemoryUsage;
     }
 
     HRESULT hr = S_OK;
@@ -229,6 +254,21 @@ void Run(Action action) {
             break;
         }
 
+        case Action::kCollectLogs:
+            VERBOSE("Collecting logs");
+            CollectLogs(GetStringParam(L"-mod"));
+            break;
+
+        case Action::kStartupProfile:
+            VERBOSE("Exporting startup profile");
+            ExportStartupProfile(GetStringParam(L"-export"));
+            break;
+
+        case Action::kMemoryUsage:
+            VERBOSE("Exporting memory usage");
+            ExportMemoryUsage();
+            break;
+
         default:
             VERBOSE("Running Windhawk daemon");
             RunDaemon();
@@ -417,6 +457,217 @@ void RestartAppBg(DWORD timeout) {
     }
 }
 
+// Writes the session log records to the standard output as UTF-8 lines, until
+// the output is closed or the session ends. Returns right away if no session is
+// running. The process doesn't wait for a new session, since a running
+// windhawk.exe process holds up restarts and updates of the app (see
+// WaitForRunningProcessesToTerminate). Instead, the editor extension runs it
+// again when it exits.
+void CollectLogs(PCWSTR modNameFilter) {
+    HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+    THROW_LAST_ERROR_IF(!output || output == INVALID_HANDLE_VALUE);
+
+    wil::unique_process_handle sessionManagerProcess;
+    std::optional<SessionLog::Reader> reader;
+    try {
+        DWORD sessionManagerProcessId = GetSessionManagerProcessId();
+
+        sessionManagerProcess.reset(
+            OpenProcess(SYNCHRONIZE, FALSE, sessionManagerProcessId));
+        THROW_LAST_ERROR_IF(!sessionManagerProcess);
+
+        reader.emplace(sessionManagerProcessId);
+    } catch (const std::exception& e) {
+        // Not logged by default, since the app log is also read by the editor
+        // extension while it waits for a session.
+        VERBOSE(L"No session log: %S", e.what());
+        return;
+    }
+
+    std::string pendingOutput;
+    auto appendLine = [&pendingOutput](PCWSTR line) {
+        pendingOutput += CW2A(line, CP_UTF8);
+        pendingOutput += "\r\n";
+    };
+
+    uint64_t reportedLostSlotCount = 0;
+    DWORD pendingSinceTickCount = 0;
+    bool pending = false;
+
+    while (true) {
+        SessionLogRing::Record record;
+        auto result = reader->Read(&record);
+        if (result == SessionLog::Reader::ReadResult::kRecord) {
+            pending = false;
+
+            if (modNameFilter && _wcsicmp(record.channel, modNameFilter) != 0) {
+                continue;
+            }
+
+            FILETIME fileTime = {
+                .dwLowDateTime = static_cast<DWORD>(record.timestamp),
+                .dwHighDateTime = static_cast<DWORD>(record.timestamp >> 32),
+            };
+            FILETIME localFileTime;
+            SYSTEMTIME time{};
+            if (FileTimeToLocalFileTime(&fileTime, &localFileTime)) {
+                FileTimeToSystemTime(&localFileTime, &time);
+            }
+
+            WCHAR line[SessionLogRing::kChannelMaxLen +
+                       SessionLogRing::kTextMaxLen + 64];
+            if (*record.channel) {
+                _snwprintf_s(line, _TRUNCATE,
+                             L"%02u:%02u:%02u.%03u [%u:%u] [WH] [%s] %s",
+                             time.wHour, time.wMinute, time.wSecond,
+                             time.wMilliseconds, record.processId,
+                             record.threadId, record.channel, record.text);
+            } else {
+                _snwprintf_s(line, _TRUNCATE, L"%02u:%02u:%02u.%03u [%u:%u] %s",
+                             time.wHour, time.wMinute, time.wSecond,
+                             time.wMilliseconds, record.processId,
+                             record.threadId, record.text);
+            }
+
+            appendLine(line);
+
+            // Keep reading, but don't let the output grow without bounds if
+            // the log is very busy.
+            if (pendingOutput.size() < 64 * 1024) {
+                continue;
+            }
+        } else if (result == SessionLog::Reader::ReadResult::kPending) {
+            if (!pending) {
+                pending = true;
+                pendingSinceTickCount = GetTickCount();
+            } else if (GetTickCount() - pendingSinceTickCount >=
+                       kCollectLogsPendingTimeout) {
+                pending = false;
+                reader->SkipPending();
+                continue;
+            }
+        }
+
+        uint64_t lostSlotCount = reader->GetLostSlotCount();
+        if (lostSlotCount != reportedLostSlotCount) {
+            WCHAR line[128];
+            _snwprintf_s(line, _TRUNCATE,
+                         L"[WH] [CollectLogs]: %I64u log records were lost",
+                         lostSlotCount - reportedLostSlotCount);
+            appendLine(line);
+            reportedLostSlotCount = lostSlotCount;
+        }
+
+        if (!pendingOutput.empty()) {
+            DWORD written;
+            if (!WriteFile(output, pendingOutput.data(),
+                           static_cast<DWORD>(pendingOutput.size()), &written,
+                           nullptr)) {
+                // The reading end was closed.
+                break;
+            }
+
+            pendingOutput.clear();
+        }
+
+        if (result == SessionLog::Reader::ReadResult::kRecord) {
+            continue;
+        }
+
+        if (WaitForSingleObject(sessionManagerProcess.get(),
+                                kCollectLogsPollInterval) != WAIT_TIMEOUT) {
+            constexpr char kLine[] =
+                "[WH] [CollectLogs]: The session ended\r\n";
+            DWORD written;
+            WriteFile(output, kLine, sizeof(kLine) - 1, &written, nullptr);
+            break;
+        }
+    }
+}
+
+// Writes the aggregated startup profile of the session as CSV, to the given
+// file or to the standard output.
+void ExportStartupProfile(PCWSTR exportPath) {
+    StartupProfile::SessionTableReader reader(GetSessionManagerProcessId());
+
+    std::string csv =
+        StartupProfile::FormatCsv(StartupProfile::Aggregate(reader.Read()));
+
+    wil::unique_hfile exportFile;
+    HANDLE output;
+    if (exportPath) {
+        exportFile.reset(CreateFile(exportPath, GENERIC_WRITE, 0, nullptr,
+                                    CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                                    nullptr));
+        THROW_LAST_ERROR_IF(!exportFile);
+        output = exportFile.get();
+    } else {
+        output = GetStdHandle(STD_OUTPUT_HANDLE);
+        THROW_LAST_ERROR_IF(!output || output == INVALID_HANDLE_VALUE);
+    }
+
+    DWORD written;
+    THROW_IF_WIN32_BOOL_FALSE(WriteFile(output, csv.data(),
+                                        static_cast<DWORD>(csv.size()),
+                                        &written, nullptr));
+}
+
+// Writes the last memory usage snapshot of each customized process as CSV to
+// the standard output, in bytes.
+void ExportMemoryUsage() {
+    HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+    THROW_LAST_ERROR_IF(!output || output == INVALID_HANDLE_VALUE);
+
+    ModStatus::SessionTableReader reader(GetSessionManagerProcessId());
+
+    std::wstring csv = L"process_id,process_name";
+    for (PCWSTR fieldName : ModStatusTable::kEngineMemoryFieldNames) {
+        csv += L',';
+        csv += fieldName;
+    }
+
+    csv += L"\r\n";
+
+    for (const auto& item :
+         reader.Read(ModStatusTable::Category::kEngineMemory)) {
+        csv += std::to_wstring(item.processId);
+        csv += L',';
+        csv += item.processName;
+        csv += L',';
+        csv += item.value;
+        csv += L"\r\n";
+    }
+
+    std::string csvUtf8(CW2A(csv.c_str(), CP_UTF8));
+
+    DWORD written;
+    THROW_IF_WIN32_BOOL_FALSE(WriteFile(output, csvUtf8.data(),
+                                        static_cast<DWORD>(csvUtf8.size()),
+                                        &written, nullptr));
+}
+
+DWORD GetSessionManagerProcessId() {
+    if (StorageManager::GetInstance().IsPortable()) {
+        // In portable mode, the daemon is the session manager.
+        CWindow hDaemonWnd(FindWindow(L"WindhawkDaemon", nullptr));
+        THROW_WIN32_IF(ERROR_NOT_FOUND, !hDaemonWnd);
+
+        return hDaemonWnd.GetWindowProcessID();
+    }
+
+    wil::unique_handle fileMapping(OpenFileMapping(
+        FILE_MAP_READ, FALSE, ServiceCommon::kInfoFileMappingName));
+    THROW_LAST_ERROR_IF(!fileMapping);
+
+    wil::unique_mapview_ptr<ServiceCommon::ServiceInfo> fileMappingView(
+        reinterpret_cast<ServiceCommon::ServiceInfo*>(
+            MapViewOfFile(fileMapping.get(), FILE_MAP_READ, 0, 0,
+                          sizeof(ServiceCommon::ServiceInfo))));
+    THROW_LAST_ERROR_IF(!fileMappingView);
+
+    return fileMappingView->processId;
+}
+
 void EnableSafeMode() {
     StorageManager::GetInstance()
         .GetAppConfig(L"Settings", true)
@@ -636,4 +887,14 @@ int GetIntParam(PCWSTR param) {
     return 0;
 }
 
+PCWSTR GetStringParam(PCWSTR param) {
+    for (int i = 1; i < __argc - 1; i++) {
+        if (_wcsicmp(__wargv[i], param) == 0) {
+            return __wargv[i + 1];
+        }
+    }
+
+    return nullptr;
+}
+
 }  // namespace
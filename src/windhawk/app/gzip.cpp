@@ -0,0 +1,227 @@
+#include "stdafx.h"
+
+#include "gzip.h"
+
+namespace {
+
+// Matches are looked up with hash chains over the deflate window. Longer
+// chains find longer matches, at the cost of time.
+constexpr size_t kWindowSize = 32 * 1024;
+constexpr size_t kMinMatch = 3;
+constexpr size_t kMaxMatch = 258;
+constexpr int kHashBits = 15;
+constexpr int kMaxChainLength = 64;
+
+// RFC 1951, 3.2.5.
+constexpr uint16_t kLengthBase[] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+constexpr uint8_t kLengthExtraBits[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+    2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+constexpr uint16_t kDistanceBase[] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577,
+};
+constexpr uint8_t kDistanceExtraBits[] = {
+    0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+constexpr auto kCrc32Table = [] {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+        }
+
+        table[i] = crc;
+    }
+
+    return table;
+}();
+
+uint32_t Crc32(std::string_view data) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (char c : data) {
+        crc = kCrc32Table[(crc ^ static_cast<uint8_t>(c)) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+class BitWriter {
+   public:
+    explicit BitWriter(std::string* out) : m_out(out) {}
+
+    // Writes the low count bits of value, least significant bit first.
+    void Write(uint32_t value, int count) {
+        m_buffer |= static_cast<uint64_t>(value) << m_count;
+        m_count += count;
+        while (m_count >= 8) {
+            m_out->push_back(static_cast<char>(m_buffer & 0xFF));
+            m_buffer >>= 8;
+            m_count -= 8;
+        }
+    }
+
+    // Huffman codes are written most significant bit first.
+    void WriteCode(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; i++) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+
+        Write(reversed, length);
+    }
+
+    void Flush() {
+        if (m_count > 0) {
+            m_out->push_back(static_cast<char>(m_buffer & 0xFF));
+            m_buffer = 0;
+            m_count = 0;
+        }
+    }
+
+   private:
+    std::string* m_out;
+    uint64_t m_buffer = 0;
+    int m_count = 0;
+};
+
+// The fixed literal/length codes, RFC 1951, 3.2.6.
+void WriteLiteralOrLength(BitWriter& writer, int symbol) {
+    if (symbol < 144) {
+        writer.WriteCode(0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        writer.WriteCode(0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+        writer.WriteCode(symbol - 256, 7);
+    } else {
+        writer.WriteCode(0xC0 + symbol - 280, 8);
+    }
+}
+
+void WriteMatch(BitWriter& writer, size_t length, size_t distance) {
+    int lengthCode = static_cast<int>(std::size(kLengthBase)) - 1;
+    while (kLengthBase[lengthCode] > length) {
+        lengthCode--;
+    }
+
+    WriteLiteralOrLength(writer, 257 + lengthCode);
+    writer.Write(static_cast<uint32_t>(length - kLengthBase[lengthCode]),
+                 kLengthExtraBits[lengthCode]);
+
+    int distanceCode = static_cast<int>(std::size(kDistanceBase)) - 1;
+    while (kDistanceBase[distanceCode] > distance) {
+        distanceCode--;
+    }
+
+    writer.WriteCode(distanceCode, 5);
+    writer.Write(static_cast<uint32_t>(distance - kDistanceBase[distanceCode]),
+                 kDistanceExtraBits[distanceCode]);
+}
+
+void AppendUInt32(std::string* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out->push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+}
+
+}  // namespace
+
+namespace Gzip {
+
+std::string Compress(std::string_view data) {
+    std::string out;
+    out.reserve(data.size() / 2 + 32);
+
+    // RFC 1952: the magic, deflate, no flags, no modification time, no extra
+    // flags and an unknown OS.
+    constexpr char kHeader[] = {'\x1F', '\x8B', 8, 0, 0, 0, 0, 0, 0, '\xFF'};
+    out.append(kHeader, sizeof(kHeader));
+
+    BitWriter writer(&out);
+
+    // A single final block with the fixed Huffman codes.
+    writer.Write(1, 1);
+    writer.Write(1, 2);
+
+    auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    size_t size = data.size();
+
+    auto hashAt = [bytes](size_t i) {
+        uint32_t value = bytes[i] | (bytes[i + 1] << 8) | (bytes[i + 2] << 16);
+        return (value * 2654435761u) >> (32 - kHashBits);
+    };
+
+    // The last position of each hash, and the previous position with the
+    // same hash of each position in the window.
+    std::vector<int32_t> head(size_t{1} << kHashBits, -1);
+    std::vector<int32_t> prev(kWindowSize, -1);
+
+    auto insert = [&](size_t i) {
+        uint32_t hash = hashAt(i);
+        prev[i % kWindowSize] = head[hash];
+        head[hash] = static_cast<int32_t>(i);
+    };
+
+    size_t i = 0;
+    while (i < size) {
+        size_t bestLength = 0;
+        size_t bestDistance = 0;
+
+        if (i + kMinMatch <= size) {
+            size_t maxLength = std::min(kMaxMatch, size - i);
+            int32_t candidate = head[hashAt(i)];
+            for (int chain = 0; chain < kMaxChainLength && candidate >= 0 &&
+                                i - candidate <= kWindowSize;
+                 chain++) {
+                size_t length = 0;
+                while (length < maxLength &&
+                       bytes[candidate + length] == bytes[i + length]) {
+                    length++;
+                }
+
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = i - candidate;
+                    if (length == maxLength) {
+                        break;
+                    }
+                }
+
+                candidate = prev[candidate % kWindowSize];
+            }
+
+            insert(i);
+        }
+
+        if (bestLength >= kMinMatch) {
+            WriteMatch(writer, bestLength, bestDistance);
+            for (size_t j = i + 1; j < i + bestLength && j + kMinMatch <= size;
+                 j++) {
+                insert(j);
+            }
+
+            i += bestLength;
+        } else {
+            WriteLiteralOrLength(writer, bytes[i]);
+            i++;
+        }
+    }
+
+    // End of block.
+    WriteLiteralOrLength(writer, 256);
+    writer.Flush();
+
+    AppendUInt32(&out, Crc32(data));
+    AppendUInt32(&out, static_cast<uint32_t>(size));
+    return out;
+}
+
+}  // namespace Gzip
@@ -0,0 +1,11 @@
+#pragma once
+
+// A small gzip compressor for request bodies, since the app has no
+// compression library and WinHTTP only decompresses responses. Uses a single
+// deflate block with the fixed Huffman codes, which is enough for JSON. Only
+// depends on the standard library.
+namespace Gzip {
+
+std::string Compress(std::string_view data);
+
+}  // namespace Gzip
@@ -0,0 +1,148 @@
+#pragma once
+
+// A list of items which is kept in sync with snapshots of a keyed data source.
+// Each snapshot is diffed against the current items: only added, removed and
+// changed items are touched, and the display order is only recomputed if
+// something changed. Meant to back an owner-data (virtual) list view, which
+// queries the rows by index.
+//
+// Only the standard library is used here.
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+template <typename Key, typename Item, typename Hash = std::hash<Key>>
+class KeyedListModel {
+   public:
+    struct Changes {
+        size_t added = 0;
+        size_t removed = 0;
+        size_t changed = 0;
+
+        bool Any() const { return added || removed || changed; }
+    };
+
+    using Less = std::function<bool(const Item&, const Item&)>;
+
+    size_t GetCount() const { return m_rows.size(); }
+    Item& GetRow(size_t row) { return m_rows[row].item; }
+    const Item& GetRow(size_t row) const { return m_rows[row].item; }
+    const Key& GetRowKey(size_t row) const { return m_rows[row].key; }
+
+    std::optional<size_t> FindRow(const Key& key) const {
+        auto it = m_rowByKey.find(key);
+        if (it == m_rowByKey.end()) {
+            return std::nullopt;
+        }
+
+        return it->second;
+    }
+
+    // Brings the items in sync with the snapshot:
+    // * keyOf(const Source&) returns the key of a snapshot entry.
+    // * create(Source&&) returns a new item for an entry with a new key.
+    // * update(Item&, Source&&) updates an existing item, and returns whether
+    //   the item was changed.
+    // Snapshot entries with a duplicate key are ignored.
+    template <typename Source, typename KeyOf, typename Create, typename Update>
+    Changes Apply(std::vector<Source> snapshot,
+                  KeyOf keyOf,
+                  Create create,
+                  Update update) {
+        Changes changes;
+
+        std::vector<Key> keys;
+        keys.reserve(snapshot.size());
+
+        std::unordered_map<Key, size_t, Hash> snapshotIndexByKey;
+        snapshotIndexByKey.reserve(snapshot.size());
+
+        // Entries which were matched with an existing item, or which have a
+        // duplicate key.
+        std::vector<bool> consumed(snapshot.size());
+
+        for (size_t i = 0; i < snapshot.size(); i++) {
+            keys.push_back(keyOf(snapshot[i]));
+            if (!snapshotIndexByKey.try_emplace(keys[i], i).second) {
+                consumed[i] = true;
+            }
+        }
+
+        // Update or remove the existing rows, keeping their relative order.
+        size_t keptCount = 0;
+        for (size_t i = 0; i < m_rows.size(); i++) {
+            auto it = snapshotIndexByKey.find(m_rows[i].key);
+            if (it == snapshotIndexByKey.end()) {
+                changes.removed++;
+                continue;
+            }
+
+            size_t snapshotIndex = it->second;
+            consumed[snapshotIndex] = true;
+
+            if (update(m_rows[i].item, std::move(snapshot[snapshotIndex]))) {
+                changes.changed++;
+            }
+
+            if (keptCount != i) {
+                m_rows[keptCount] = std::move(m_rows[i]);
+            }
+
+            keptCount++;
+        }
+
+        m_rows.erase(m_rows.begin() + keptCount, m_rows.end());
+
+        for (size_t i = 0; i < snapshot.size(); i++) {
+            if (consumed[i]) {
+                continue;
+            }
+
+            m_rows.push_back(Row{
+                .key = std::move(keys[i]),
+                .item = create(std::move(snapshot[i])),
+            });
+            changes.added++;
+        }
+
+        if (changes.Any()) {
+            Reorder();
+        }
+
+        return changes;
+    }
+
+    void SetOrder(Less less) {
+        m_less = std::move(less);
+        Reorder();
+    }
+
+   private:
+    struct Row {
+        Key key;
+        Item item;
+    };
+
+    void Reorder() {
+        if (m_less) {
+            std::stable_sort(m_rows.begin(), m_rows.end(),
+                             [this](const Row& a, const Row& b) {
+                                 return m_less(a.item, b.item);
+                             });
+        }
+
+        m_rowByKey.clear();
+        m_rowByKey.reserve(m_rows.size());
+        for (size_t i = 0; i < m_rows.size(); i++) {
+            m_rowByKey.try_emplace(m_rows[i].key, i);
+        }
+    }
+
+    std::vector<Row> m_rows;
+    std::unordered_map<Key, size_t, Hash> m_rowByKey;
+    Less m_less;
+};
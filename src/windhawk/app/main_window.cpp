@@ -147,14 +147,6 @@ BOOL CMainWindow::OnIdle() {
                 case kModTasksChanged:
                     if (m_modTasksDlg) {
                         m_modTasksDlg->DataChanged();
-
-                        try {
-                            m_modTasksChangeNotification->ContinueMonitoring();
-                        } catch (const std::exception& e) {
-                            LOG(L"Tasks ContinueMonitoring failed: %S",
-                                e.what());
-                            m_modTasksChangeNotification.reset();
-                        }
                     } else {
                         // In the common case, there's a short-lived event, such
                         // as mod initialization, that is cleared right away.
@@ -170,14 +162,6 @@ BOOL CMainWindow::OnIdle() {
                     if (m_modStatusesDlg) {
                         m_modStatusesDlg->DataChanged();
                     }
-
-                    try {
-                        m_modStatusesChangeNotification->ContinueMonitoring();
-                    } catch (const std::exception& e) {
-                        LOG(L"Statuses ContinueMonitoring failed: %S",
-                            e.what());
-                        m_modStatusesChangeNotification.reset();
-                    }
                     break;
 
                 case kExplorerCrashed: {
@@ -237,7 +221,8 @@ int CMainWindow::OnCreate(LPCREATESTRUCT lpCreateStruct) {
     LoadSettings();
 
     try {
-        m_modTasksChangeNotification.emplace(L"mod-task");
+        m_modTasksChangeNotification.emplace(
+            m_serviceInfo.processId, ModStatusTable::Category::kModTask);
     } catch (const std::exception& e) {
         LOG(L"Tasks ChangeNotification failed: %S", e.what());
     }
@@ -313,17 +298,18 @@ void CMainWindow::OnTimer(UINT_PTR nIDEvent) {
             KillTimer(Timer::kModTasksDlgCreate);
 
             try {
-                m_modTasksChangeNotification.emplace(L"mod-task");
+                m_modTasksChangeNotification.emplace(
+                    m_serviceInfo.processId,
+                    ModStatusTable::Category::kModTask);
 
                 if (!CTaskManagerDlg::IsDataSourceEmpty(
-                        CTaskManagerDlg::DataSource::kModTask)) {
+                        CTaskManagerDlg::DataSource::kModTask,
+                        m_serviceInfo.processId)) {
                     m_modTasksDlg.emplace(CTaskManagerDlg::DialogOptions{
                         .dataSource = CTaskManagerDlg::DataSource::kModTask,
                         .autonomousMode = true,
                         .autonomousModeShowDelay = m_modTasksDlgDelay,
                         .sessionManagerProcessId = m_serviceInfo.processId,
-                        .sessionManagerProcessCreationTime =
-                            m_serviceInfo.processCreationTime,
                         .runButtonCallback = [this](HWND hWnd) { RunUI(hWnd); },
                         .finalMessageCallback =
                             [this](HWND hWnd) { m_modTasksDlg.reset(); }});
@@ -1027,7 +1013,6 @@ void CMainWindow::ShowLoadedModsDialog() {
     m_modStatusesDlg.emplace(CTaskManagerDlg::DialogOptions{
         .dataSource = CTaskManagerDlg::DataSource::kModStatus,
         .sessionManagerProcessId = m_serviceInfo.processId,
-        .sessionManagerProcessCreationTime = m_serviceInfo.processCreationTime,
         .runButtonCallback = [this](HWND hWnd) { RunUI(hWnd); },
         .finalMessageCallback =
             [this](HWND hWnd) {
@@ -1043,7 +1028,8 @@ void CMainWindow::ShowLoadedModsDialog() {
     m_modStatusesDlg->ShowWindow(SW_SHOWNORMAL);
 
     try {
-        m_modStatusesChangeNotification.emplace(L"mod-status");
+        m_modStatusesChangeNotification.emplace(
+            m_serviceInfo.processId, ModStatusTable::Category::kModStatus);
     } catch (const std::exception& e) {
         LOG(L"Statuses ChangeNotification failed: %S", e.what());
     }
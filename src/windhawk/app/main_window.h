@@ -117,12 +117,11 @@ class CMainWindow : public CWindowImpl<CMainWindow, CWindow, CNullTraits>,
     // Shown automatically when mods are doing tasks such as initializing or
     // loading symbols.
     std::optional<CTaskManagerDlg> m_modTasksDlg;
-    std::optional<StorageManager::ModMetadataChangeNotification>
-        m_modTasksChangeNotification;
+    std::optional<ModStatus::ChangeNotification> m_modTasksChangeNotification;
 
     // Opened by the user.
     std::optional<CTaskManagerDlg> m_modStatusesDlg;
-    std::optional<StorageManager::ModMetadataChangeNotification>
+    std::optional<ModStatus::ChangeNotification>
         m_modStatusesChangeNotification;
 
     // Opened from the tray icon, with a hotkey, or when explorer isn't running.
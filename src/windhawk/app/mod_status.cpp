@@ -0,0 +1,193 @@
+#include "stdafx.h"
+
+#include "mod_status.h"
+
+#include "session_private_namespace.h"
+
+namespace {
+
+// Without a creation time, a process which reuses the process ID is treated as
+// the same process.
+bool IsProcessTerminated(DWORD processId,
+                         std::optional<ULONGLONG> processCreationTime) {
+    wil::unique_process_handle process(
+        OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId));
+    if (!process) {
+        // Other errors, such as access denied, mean that the process exists.
+        return GetLastError() == ERROR_INVALID_PARAMETER;
+    }
+
+    FILETIME creationTime;
+    FILETIME exitTime;
+    FILETIME kernelTime;
+    FILETIME userTime;
+    if (!GetProcessTimes(process.get(), &creationTime, &exitTime, &kernelTime,
+                         &userTime)) {
+        return false;
+    }
+
+    if (processCreationTime &&
+        wil::filetime::to_int64(creationTime) != *processCreationTime) {
+        // The process ID was reused.
+        return true;
+    }
+
+    DWORD exitCode;
+    return GetExitCodeProcess(process.get(), &exitCode) &&
+           exitCode != STILL_ACTIVE;
+}
+
+void ReclaimSlotIfOrphaned(ModStatusTable::SessionTable::SlotType& slot) {
+    // A slot which is being written will be reported by the change
+    // notification when the write is done. But if its owner was terminated in
+    // the middle of a write, the slot stays busy, and if it was terminated
+    // before its first write, the slot stays inactive. Such slots are only
+    // reclaimed here.
+    auto ownership = slot.GetOwnership();
+    if (ownership.owner == 0 ||
+        ownership.owner ==
+            ModStatusTable::SessionTable::SlotType::kReclaimingOwner) {
+        return;
+    }
+
+    // The owner is the process ID, which is read together with the generation.
+    // The process ID and creation time in the entry can't be used: the entry
+    // might be torn, e.g. if the owner is a suspended process in the middle of
+    // its first write, with the rest of the entry still being the previous
+    // owner's. Therefore, a process which reuses the process ID of a
+    // terminated owner keeps the slot from being reclaimed until it exits.
+    if (!IsProcessTerminated(ownership.owner, std::nullopt)) {
+        return;
+    }
+
+    slot.TryReclaim(ownership.owner, ownership.generation);
+}
+
+}  // namespace
+
+namespace ModStatus {
+
+SessionTableReader::SessionTableReader(DWORD sessionManagerProcessId)
+    : m_privateNamespace(
+          SessionPrivateNamespace::Open(sessionManagerProcessId)) {
+    m_fileMapping.reset(OpenFileMapping(
+        FILE_MAP_READ | FILE_MAP_WRITE, FALSE,
+        SessionPrivateNamespace::MakeObjectName(
+            sessionManagerProcessId, ModStatusTable::kFileMappingName)
+            .c_str()));
+    THROW_LAST_ERROR_IF(!m_fileMapping);
+
+    m_table.reset(reinterpret_cast<ModStatusTable::SessionTable*>(
+        MapViewOfFile(m_fileMapping.get(), FILE_MAP_WRITE, 0, 0, 0)));
+    THROW_LAST_ERROR_IF(!m_table);
+
+    if (!m_table->IsCompatible(ModStatusTable::kVersion)) {
+        throw std::runtime_error("Incompatible mod status table");
+    }
+}
+
+template <typename Callback>
+void SessionTableReader::ForEachEntry(ModStatusTable::Category category,
+                                      Callback callback) {
+    // Whether a process is terminated, by process ID and creation time.
+    std::map<std::pair<DWORD, ULONGLONG>, bool> terminatedProcesses;
+
+    DWORD usedCount = m_table->GetUsedCount();
+    for (DWORD i = 0; i < usedCount; i++) {
+        auto& slot = m_table->GetSlot(i);
+
+        ModStatusTable::SessionTable::SlotType::Snapshot snapshot;
+        if (slot.Read(&snapshot) !=
+            ModStatusTable::SessionTable::SlotType::ReadResult::kValid) {
+            ReclaimSlotIfOrphaned(slot);
+            continue;
+        }
+
+        // Slots of terminated processes are reclaimed regardless of the
+        // category, since some categories, such as the engine memory, might
+        // not be read regularly.
+        const auto& entry = snapshot.value;
+        auto [it, inserted] = terminatedProcesses.try_emplace(
+            std::make_pair(entry.processId, entry.processCreationTime));
+        if (inserted) {
+            it->second =
+                IsProcessTerminated(entry.processId, entry.processCreationTime);
+        }
+
+        if (it->second) {
+            slot.TryReclaim(snapshot.owner, snapshot.generation);
+            continue;
+        }
+
+        if (entry.category != category) {
+            continue;
+        }
+
+        if (!callback(static_cast<int>(i), snapshot)) {
+            break;
+        }
+    }
+}
+
+std::vector<Item> SessionTableReader::Read(ModStatusTable::Category category) {
+    std::vector<Item> items;
+
+    ForEachEntry(category, [&items](int slotIndex, const auto& snapshot) {
+        const auto& entry = snapshot.value;
+        items.push_back(Item{
+            .slotIndex = slotIndex,
+            .generation = snapshot.generation,
+            .processId = entry.processId,
+            .creationTime = entry.creationTime,
+            .modName = entry.modName,
+            .processName = entry.processName,
+            .value = entry.value,
+        });
+        return true;
+    });
+
+    return items;
+}
+
+bool SessionTableReader::IsEmpty(ModStatusTable::Category category) {
+    bool empty = true;
+
+    ForEachEntry(category, [&empty](int slotIndex, const auto& snapshot) {
+        empty = false;
+        return false;
+    });
+
+    return empty;
+}
+
+ChangeNotification::ChangeNotification(DWORD sessionManagerProcessId,
+                                       ModStatusTable::Category category)
+    : m_privateNamespace(
+          SessionPrivateNamespace::Open(sessionManagerProcessId)) {
+    PCWSTR eventName = nullptr;
+    switch (category) {
+        case ModStatusTable::Category::kModStatus:
+            eventName = ModStatusTable::kModStatusChangedEventName;
+            break;
+
+        case ModStatusTable::Category::kModTask:
+            eventName = ModStatusTable::kModTaskChangedEventName;
+            break;
+
+        case ModStatusTable::Category::kEngineMemory:
+            throw std::logic_error("Engine memory changes aren't signaled");
+    }
+
+    m_event.reset(OpenEvent(
+        SYNCHRONIZE, FALSE,
+        SessionPrivateNamespace::MakeObjectName(
+            sessionManagerProcessId, eventName)
+            .c_str()));
+    THROW_LAST_ERROR_IF(!m_event);
+}
+
+HANDLE ChangeNotification::GetHandle() {
+    return m_event.get();
+}
+
+}  // namespace ModStatus
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "mod_status_table.h"
+
+namespace ModStatus {
+
+struct Item {
+    // The slot index and generation identify an item for as long as it lives.
+    int slotIndex;
+    DWORD generation;
+    DWORD processId;
+    ULONGLONG creationTime;
+    std::wstring modName;
+    std::wstring processName;
+    std::wstring value;
+};
+
+// Reads the mod status table of a session, which is written by the engine
+// instances of the session.
+class SessionTableReader {
+   public:
+    SessionTableReader(DWORD sessionManagerProcessId);
+
+    // Slots of processes which were terminated without releasing them are
+    // reclaimed while reading.
+    std::vector<Item> Read(ModStatusTable::Category category);
+    bool IsEmpty(ModStatusTable::Category category);
+
+   private:
+    template <typename Callback>
+    void ForEachEntry(ModStatusTable::Category category, Callback callback);
+
+    wil::unique_private_namespace_close m_privateNamespace;
+    wil::unique_handle m_fileMapping;
+    wil::unique_mapview_ptr<ModStatusTable::SessionTable> m_table;
+};
+
+// Signaled when the values of the category change.
+class ChangeNotification {
+   public:
+    ChangeNotification(DWORD sessionManagerProcessId,
+                       ModStatusTable::Category category);
+
+    HANDLE GetHandle();
+
+   private:
+    wil::unique_private_namespace_close m_privateNamespace;
+    wil::unique_event_nothrow m_event;
+};
+
+}  // namespace ModStatus
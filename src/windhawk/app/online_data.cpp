@@ -0,0 +1,128 @@
+#include "stdafx.h"
+
+#include "online_data.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+class SaxParser : public nlohmann::json_sax<json> {
+   public:
+    SaxParser(const std::unordered_set<std::string>* modIds,
+              OnlineData::Versions* versions)
+        : m_modIds(modIds), m_versions(versions) {}
+
+    bool null() override { return true; }
+    bool boolean(bool val) override { return true; }
+    bool number_integer(number_integer_t val) override { return true; }
+    bool number_unsigned(number_unsigned_t val) override { return true; }
+    bool number_float(number_float_t val, const string_t& s) override {
+        return true;
+    }
+    bool binary(binary_t& val) override { return true; }
+
+    bool string(string_t& val) override {
+        OnString(val);
+        return true;
+    }
+
+    bool start_object(std::size_t elements) override {
+        if (m_levels.size() == 1 && KeyAt(0, "mods")) {
+            m_versions->hasMods = true;
+        }
+
+        m_levels.push_back({.isArray = false});
+        return true;
+    }
+
+    bool key(string_t& val) override {
+        m_levels.back().key = std::move(val);
+        return true;
+    }
+
+    bool end_object() override {
+        m_levels.pop_back();
+        return true;
+    }
+
+    bool start_array(std::size_t elements) override {
+        m_levels.push_back({.isArray = true});
+        return true;
+    }
+
+    bool end_array() override {
+        m_levels.pop_back();
+        return true;
+    }
+
+    bool parse_error(std::size_t position,
+                     const std::string& last_token,
+                     const nlohmann::detail::exception& ex) override {
+        throw std::runtime_error(ex.what());
+    }
+
+   private:
+    struct Level {
+        bool isArray;
+        std::string key;
+    };
+
+    bool KeyAt(size_t index, std::string_view key) const {
+        return !m_levels[index].isArray && m_levels[index].key == key;
+    }
+
+    void OnString(std::string& val) {
+        for (const auto& level : m_levels) {
+            if (level.isArray) {
+                return;
+            }
+        }
+
+        switch (m_levels.size()) {
+            case 1:
+                if (KeyAt(0, "app")) {
+                    m_versions->appVersion = std::move(val);
+                }
+                break;
+
+            case 2:
+                if (KeyAt(0, "app") && KeyAt(1, "version")) {
+                    m_versions->appVersion = std::move(val);
+                } else if (KeyAt(0, "mods")) {
+                    OnModVersion(m_levels[1].key, val);
+                }
+                break;
+
+            case 4:
+                if (KeyAt(0, "mods") && KeyAt(2, "metadata") &&
+                    KeyAt(3, "version")) {
+                    OnModVersion(m_levels[1].key, val);
+                }
+                break;
+        }
+    }
+
+    void OnModVersion(const std::string& modId, std::string& version) {
+        if (m_modIds->contains(modId)) {
+            m_versions->modVersions[modId] = std::move(version);
+        }
+    }
+
+    const std::unordered_set<std::string>* m_modIds;
+    OnlineData::Versions* m_versions;
+    std::vector<Level> m_levels;
+};
+
+}  // namespace
+
+namespace OnlineData {
+
+Versions Parse(std::string_view data,
+               const std::unordered_set<std::string>& modIds) {
+    Versions versions;
+    SaxParser parser(&modIds, &versions);
+    json::sax_parse(data.begin(), data.end(), &parser);
+    return versions;
+}
+
+}  // namespace OnlineData
@@ -0,0 +1,25 @@
+#pragma once
+
+// The versions which the update check gets from the server. Only depends on
+// the standard library and nlohmann/json, so that it can be tested with
+// canned responses.
+namespace OnlineData {
+
+struct Versions {
+    std::optional<std::string> appVersion;
+    bool hasMods = false;
+    std::unordered_map<std::string, std::string> modVersions;
+};
+
+// Extracts the latest app version and the latest versions of the given mods
+// while the data is parsed, without building a DOM for the whole document,
+// most of which describes mods which aren't installed. The format is:
+// {"app": VERSION, "mods": {"mod-id": VERSION, ...}}, where VERSION is either
+// a string, or {"version": "..."} for the app and {"metadata": {"version":
+// "..."}} for mods. Other values are ignored. A delta response has the same
+// format, but only lists what changed, see UpdateChecker. Throws if the data
+// isn't valid JSON.
+Versions Parse(std::string_view data,
+               const std::unordered_set<std::string>& modIds);
+
+}  // namespace OnlineData
@@ -0,0 +1,42 @@
+#include "stdafx.h"
+
+#include "session_log.h"
+
+#include "session_private_namespace.h"
+
+namespace SessionLog {
+
+Reader::Reader(DWORD sessionManagerProcessId)
+    : m_privateNamespace(
+          SessionPrivateNamespace::Open(sessionManagerProcessId)) {
+    m_fileMapping.reset(OpenFileMapping(
+        FILE_MAP_READ, FALSE,
+        SessionPrivateNamespace::MakeObjectName(
+            sessionManagerProcessId, SessionLogRing::kFileMappingName)
+            .c_str()));
+    THROW_LAST_ERROR_IF(!m_fileMapping);
+
+    m_ring.reset(reinterpret_cast<SessionLogRing::SessionRing*>(
+        MapViewOfFile(m_fileMapping.get(), FILE_MAP_READ, 0, 0, 0)));
+    THROW_LAST_ERROR_IF(!m_ring);
+
+    if (!m_ring->IsCompatible(SessionLogRing::kVersion)) {
+        throw std::runtime_error("Incompatible session log ring");
+    }
+
+    m_reader.emplace(*m_ring);
+}
+
+Reader::ReadResult Reader::Read(SessionLogRing::Record* record) {
+    return m_reader->Read(record);
+}
+
+void Reader::SkipPending() {
+    m_reader->SkipPending();
+}
+
+uint64_t Reader::GetLostSlotCount() const {
+    return m_reader->GetLostSlotCount();
+}
+
+}  // namespace SessionLog
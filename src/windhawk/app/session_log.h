@@ -0,0 +1,27 @@
+#pragma once
+
+#include "session_log_ring.h"
+
+namespace SessionLog {
+
+// Reads the session log ring, which is written by the engine instances of the
+// session. Only records which are written after the reader is created are
+// read.
+class Reader {
+   public:
+    using ReadResult = SessionLogRing::SessionReader::ReadResult;
+
+    Reader(DWORD sessionManagerProcessId);
+
+    ReadResult Read(SessionLogRing::Record* record);
+    void SkipPending();
+    uint64_t GetLostSlotCount() const;
+
+   private:
+    wil::unique_private_namespace_close m_privateNamespace;
+    wil::unique_handle m_fileMapping;
+    wil::unique_mapview_ptr<SessionLogRing::SessionRing> m_ring;
+    std::optional<SessionLogRing::SessionReader> m_reader;
+};
+
+}  // namespace SessionLog
@@ -0,0 +1,76 @@
+#include "stdafx.h"
+
+#include "session_private_namespace.h"
+
+namespace {
+
+wil::unique_boundary_descriptor BuildBoundaryDescriptor(PCWSTR descriptorName) {
+    wil::unique_boundary_descriptor boundaryDesc(
+        CreateBoundaryDescriptor(descriptorName, 0));
+    THROW_LAST_ERROR_IF_NULL(boundaryDesc);
+
+    {
+        wil::unique_sid pSID;
+        SID_IDENTIFIER_AUTHORITY SIDWorldAuth = SECURITY_WORLD_SID_AUTHORITY;
+        THROW_IF_WIN32_BOOL_FALSE(AllocateAndInitializeSid(
+            &SIDWorldAuth, 1, SECURITY_WORLD_RID, 0, 0, 0, 0, 0, 0, 0, &pSID));
+
+        THROW_IF_WIN32_BOOL_FALSE(
+            AddSIDToBoundaryDescriptor(boundaryDesc.addressof(), pSID.get()));
+    }
+
+    {
+        wil::unique_sid pSID;
+        SID_IDENTIFIER_AUTHORITY SIDMandatoryLabelAuth =
+            SECURITY_MANDATORY_LABEL_AUTHORITY;
+        THROW_IF_WIN32_BOOL_FALSE(AllocateAndInitializeSid(
+            &SIDMandatoryLabelAuth, 1, SECURITY_MANDATORY_MEDIUM_RID, 0, 0, 0,
+            0, 0, 0, 0, &pSID));
+
+        THROW_IF_WIN32_BOOL_FALSE(AddIntegrityLabelToBoundaryDescriptor(
+            boundaryDesc.addressof(), pSID.get()));
+    }
+
+    return boundaryDesc;
+}
+
+}  // namespace
+
+namespace SessionPrivateNamespace {
+
+int MakeName(WCHAR szPrivateNamespaceName[kPrivateNamespaceMaxLen + 1],
+             DWORD dwSessionManagerProcessId) noexcept {
+    static_assert(kPrivateNamespaceMaxLen + 1 ==
+                  sizeof("WindhawkSession1234567890"));
+    return swprintf_s(szPrivateNamespaceName, kPrivateNamespaceMaxLen + 1,
+                      L"WindhawkSession%u", dwSessionManagerProcessId);
+}
+
+std::wstring MakeObjectName(DWORD dwSessionManagerProcessId,
+                            PCWSTR objectName) {
+    WCHAR szPrivateNamespaceName[kPrivateNamespaceMaxLen + 1];
+    MakeName(szPrivateNamespaceName, dwSessionManagerProcessId);
+
+    std::wstring name = szPrivateNamespaceName;
+    name += L'\\';
+    name += objectName;
+    return name;
+}
+
+wil::unique_private_namespace_close Open(DWORD dwSessionManagerProcessId) {
+    WCHAR szPrivateNamespaceName[kPrivateNamespaceMaxLen + 1];
+    MakeName(szPrivateNamespaceName, dwSessionManagerProcessId);
+
+    // Note: We use the private namespace name as the boundary name too, it
+    // must match the boundary which is used by the engine.
+    wil::unique_boundary_descriptor boundaryDesc(
+        BuildBoundaryDescriptor(szPrivateNamespaceName));
+
+    wil::unique_private_namespace_close privateNamespace(OpenPrivateNamespace(
+        (void*)boundaryDesc.get(), szPrivateNamespaceName));
+    THROW_LAST_ERROR_IF_NULL(privateNamespace);
+
+    return privateNamespace;
+}
+
+}  // namespace SessionPrivateNamespace
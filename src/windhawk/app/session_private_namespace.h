@@ -0,0 +1,17 @@
+#pragma once
+
+// The session private namespace is created by the engine of the session
+// manager process, see engine/session_private_namespace.cpp. The app only opens
+// it to access the objects which are shared by the session.
+namespace SessionPrivateNamespace {
+
+constexpr size_t kPrivateNamespaceMaxLen =
+    sizeof("WindhawkSession1234567890") - 1;
+
+int MakeName(WCHAR szPrivateNamespaceName[kPrivateNamespaceMaxLen + 1],
+             DWORD dwSessionManagerProcessId) noexcept;
+// Returns the name of an object in the private namespace.
+std::wstring MakeObjectName(DWORD dwSessionManagerProcessId, PCWSTR objectName);
+wil::unique_private_namespace_close Open(DWORD dwSessionManagerProcessId);
+
+}  // namespace SessionPrivateNamespace
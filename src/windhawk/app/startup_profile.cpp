@@ -0,0 +1,236 @@
+#include "stdafx.h"
+
+#include "startup_profile.h"
+
+#include "session_private_namespace.h"
+
+namespace {
+
+using StartupProfileTable::Entry;
+using StartupProfileTable::Kind;
+
+constexpr PCSTR kProcessPhaseNames[] = {
+    "injection",        "engine_load", "session_start", "private_namespace",
+    "hook_engine_init", "mods_load",   "hooks_apply",   "after_init",
+};
+static_assert(std::size(kProcessPhaseNames) ==
+              static_cast<size_t>(StartupProfileTable::ProcessPhase::kCount));
+
+constexpr PCSTR kModPhaseNames[] = {
+    "load",
+    "initialize",
+    "symbols",
+    "after_init",
+};
+static_assert(std::size(kModPhaseNames) ==
+              static_cast<size_t>(StartupProfileTable::ModPhase::kCount));
+
+// Nearest-rank percentiles of the given durations.
+StartupProfile::PhaseStats CalculateStats(std::vector<DWORD>& durations) {
+    StartupProfile::PhaseStats stats{
+        .count = static_cast<DWORD>(durations.size()),
+    };
+
+    if (durations.empty()) {
+        return stats;
+    }
+
+    std::sort(durations.begin(), durations.end());
+
+    auto percentile = [&durations](size_t p) {
+        size_t rank = (durations.size() * p + 99) / 100;
+        return durations[rank > 0 ? rank - 1 : 0];
+    };
+
+    stats.p50 = percentile(50);
+    stats.p90 = percentile(90);
+    stats.p99 = percentile(99);
+    return stats;
+}
+
+std::string FormatEngineVersion(DWORD version) {
+    char buffer[32];
+    sprintf_s(buffer, "%u.%u.%u.%u", (version >> 24) & 0xFF,
+              (version >> 16) & 0xFF, (version >> 8) & 0xFF, version & 0xFF);
+    return buffer;
+}
+
+// Quotes the value if needed, as described in RFC 4180.
+std::string EscapeCsvValue(std::string value) {
+    if (value.find_first_of(",\"\r\n") == std::string::npos) {
+        return value;
+    }
+
+    std::string escaped = "\"";
+    for (char c : value) {
+        if (c == '"') {
+            escaped += '"';
+        }
+
+        escaped += c;
+    }
+
+    escaped += '"';
+    return escaped;
+}
+
+void AppendCsvLine(std::string& csv,
+                   const StartupProfile::Group& group,
+                   PCSTR phaseName,
+                   const StartupProfile::PhaseStats& stats) {
+    if (stats.count == 0) {
+        return;
+    }
+
+    char numbers[64];
+    sprintf_s(numbers, "%u,%u,%u,%u", stats.count, stats.p50, stats.p90,
+              stats.p99);
+
+    csv += group.kind == Kind::kProcess ? "process" : "mod";
+    csv += ',';
+    csv += EscapeCsvValue(std::string(CW2A(group.name.c_str(), CP_UTF8)));
+    csv += ',';
+    csv += FormatEngineVersion(group.engineVersion);
+    csv += ',';
+    csv += phaseName;
+    csv += ',';
+    csv += numbers;
+    csv += "\r\n";
+}
+
+}  // namespace
+
+namespace StartupProfile {
+
+SessionTableReader::SessionTableReader(DWORD sessionManagerProcessId)
+    : m_privateNamespace(
+          SessionPrivateNamespace::Open(sessionManagerProcessId)) {
+    m_fileMapping.reset(OpenFileMapping(
+        FILE_MAP_READ, FALSE,
+        SessionPrivateNamespace::MakeObjectName(
+            sessionManagerProcessId, StartupProfileTable::kFileMappingName)
+            .c_str()));
+    THROW_LAST_ERROR_IF(!m_fileMapping);
+
+    m_ring.reset(reinterpret_cast<StartupProfileTable::SessionRing*>(
+        MapViewOfFile(m_fileMapping.get(), FILE_MAP_READ, 0, 0, 0)));
+    THROW_LAST_ERROR_IF(!m_ring);
+
+    if (!m_ring->IsCompatible(StartupProfileTable::kVersion)) {
+        throw std::runtime_error("Incompatible startup profile table");
+    }
+}
+
+std::vector<Entry> SessionTableReader::Read() {
+    std::vector<Entry> entries;
+
+    m_ring->ForEach([&entries](const Entry& entry) {
+        if (entry.kind != Kind::kProcess && entry.kind != Kind::kMod) {
+            return;
+        }
+
+        Entry& newEntry = entries.emplace_back(entry);
+        newEntry.processName[std::size(newEntry.processName) - 1] = L'\0';
+        newEntry.modName[std::size(newEntry.modName) - 1] = L'\0';
+    });
+
+    return entries;
+}
+
+std::vector<Group> Aggregate(const std::vector<Entry>& entries) {
+    struct GroupDurations {
+        std::vector<DWORD> phases[StartupProfileTable::kMaxPhaseCount];
+        std::vector<DWORD> total;
+    };
+
+    // Keyed by kind, lowercase name and engine version, which also determines
+    // the output order.
+    std::map<std::tuple<Kind, std::wstring, DWORD>,
+             std::pair<std::wstring, GroupDurations>>
+        groupsMap;
+
+    for (const auto& entry : entries) {
+        PCWSTR name =
+            entry.kind == Kind::kProcess ? entry.processName : entry.modName;
+
+        std::wstring key = name;
+        std::transform(key.begin(), key.end(), key.begin(), towlower);
+
+        auto [it, inserted] = groupsMap.try_emplace(
+            {entry.kind, std::move(key), entry.engineVersion});
+        auto& [groupName, durations] = it->second;
+        if (inserted) {
+            groupName = name;
+        }
+
+        DWORD total = 0;
+        bool anyMeasured = false;
+        for (size_t i = 0; i < StartupProfileTable::kMaxPhaseCount; i++) {
+            DWORD duration = entry.durations[i];
+            if (duration == StartupProfileTable::kNoDuration) {
+                continue;
+            }
+
+            durations.phases[i].push_back(duration);
+
+            // The symbols phase of a mod is a part of its initialize phase.
+            if (entry.kind == Kind::kMod &&
+                i == static_cast<size_t>(
+                         StartupProfileTable::ModPhase::kSymbols)) {
+                continue;
+            }
+
+            total += duration;
+            anyMeasured = true;
+        }
+
+        if (anyMeasured) {
+            durations.total.push_back(total);
+        }
+    }
+
+    std::vector<Group> groups;
+    groups.reserve(groupsMap.size());
+
+    for (auto& [key, value] : groupsMap) {
+        auto& [groupName, durations] = value;
+
+        Group& group = groups.emplace_back(Group{
+            .kind = std::get<0>(key),
+            .name = std::move(groupName),
+            .engineVersion = std::get<2>(key),
+        });
+
+        for (size_t i = 0; i < StartupProfileTable::kMaxPhaseCount; i++) {
+            group.phases[i] = CalculateStats(durations.phases[i]);
+        }
+
+        group.total = CalculateStats(durations.total);
+    }
+
+    return groups;
+}
+
+std::string FormatCsv(const std::vector<Group>& groups) {
+    std::string csv =
+        "kind,name,engine_version,phase,count,p50_us,p90_us,p99_us\r\n";
+
+    for (const auto& group : groups) {
+        if (group.kind == Kind::kProcess) {
+            for (size_t i = 0; i < std::size(kProcessPhaseNames); i++) {
+                AppendCsvLine(csv, group, kProcessPhaseNames[i],
+                              group.phases[i]);
+            }
+        } else {
+            for (size_t i = 0; i < std::size(kModPhaseNames); i++) {
+                AppendCsvLine(csv, group, kModPhaseNames[i], group.phases[i]);
+            }
+        }
+
+        AppendCsvLine(csv, group, "total", group.total);
+    }
+
+    return csv;
+}
+
+}  // namespace StartupProfile
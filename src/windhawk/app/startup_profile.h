@@ -0,0 +1,48 @@
+#pragma once
+
+#include "startup_profile_table.h"
+
+namespace StartupProfile {
+
+struct PhaseStats {
+    // The amount of records in which the phase was measured.
+    DWORD count;
+    // Percentiles, in microseconds.
+    DWORD p50;
+    DWORD p90;
+    DWORD p99;
+};
+
+// The records of a process name or a mod name, for a single engine version.
+struct Group {
+    StartupProfileTable::Kind kind;
+    std::wstring name;
+    DWORD engineVersion;
+    PhaseStats phases[StartupProfileTable::kMaxPhaseCount];
+    // The sum of the measured phases of each record.
+    PhaseStats total;
+};
+
+// Reads the startup profile table of a session, which is written by the engine
+// instances of the session.
+class SessionTableReader {
+   public:
+    SessionTableReader(DWORD sessionManagerProcessId);
+
+    std::vector<StartupProfileTable::Entry> Read();
+
+   private:
+    wil::unique_private_namespace_close m_privateNamespace;
+    wil::unique_handle m_fileMapping;
+    wil::unique_mapview_ptr<StartupProfileTable::SessionRing> m_ring;
+};
+
+// Groups the records by kind, name and engine version. Names are compared
+// case-insensitively.
+std::vector<Group> Aggregate(
+    const std::vector<StartupProfileTable::Entry>& entries);
+
+// One line per group and phase, with a header line.
+std::string FormatCsv(const std::vector<Group>& groups);
+
+}  // namespace StartupProfile
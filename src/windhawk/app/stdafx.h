@@ -59,11 +59,14 @@ extern CAppModule _Module;
 #include <filesystem>
 #include <fstream>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <ranges>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <variant>
 
 //////////////////////////////////////////////////////////////////////////
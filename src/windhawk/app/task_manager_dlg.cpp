@@ -4,7 +4,6 @@
 
 #include "functions.h"
 #include "logger.h"
-#include "storage_manager.h"
 
 namespace {
 
@@ -13,16 +12,6 @@ constexpr auto kRefreshListOnDataChangeDelay = 200;
 
 constexpr auto kUpdateProcessesStatusInterval = 1000;
 
-struct ListItemData {
-    std::wstring filePath;
-    std::wstring processName;
-    DWORD processId = 0;
-    ULONGLONG creationTime = 0;
-    bool isFrozen = false;
-    wil::unique_process_handle executionRequiredRequestProcess;
-    wil::unique_handle executionRequiredRequest;
-};
-
 bool CanShowDialog() {
     QUERY_USER_NOTIFICATION_STATE pquns;
     if (FAILED(SHQueryUserNotificationState(&pquns))) {
@@ -41,34 +30,17 @@ bool CanShowDialog() {
     return true;
 }
 
-std::wstring GetMetadataContent(PCWSTR filePath, FILETIME* pCreationTime) {
-    wil::unique_hfile file(
-        CreateFile(filePath, GENERIC_READ,
-                   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-                   nullptr, OPEN_EXISTING, 0, nullptr));
-    THROW_LAST_ERROR_IF(!file);
-
-    LARGE_INTEGER fileSizeLarge;
-    THROW_IF_WIN32_BOOL_FALSE(GetFileSizeEx(file.get(), &fileSizeLarge));
-
-    DWORD fileSize = 0;
-    if (fileSizeLarge.QuadPart <= DWORD_MAX ||
-        (fileSizeLarge.QuadPart % sizeof(WCHAR)) == 0) {
-        fileSize = static_cast<DWORD>(fileSizeLarge.QuadPart);
-    }
-
-    std::wstring fileContents(fileSize / sizeof(WCHAR), L'\0');
-
-    DWORD numberOfBytesRead;
-    THROW_IF_WIN32_BOOL_FALSE(ReadFile(file.get(), fileContents.data(),
-                                       fileSize, &numberOfBytesRead, nullptr));
+ModStatusTable::Category GetModStatusCategory(
+    CTaskManagerDlg::DataSource dataSource) {
+    switch (dataSource) {
+        case CTaskManagerDlg::DataSource::kModStatus:
+            return ModStatusTable::Category::kModStatus;
 
-    if (pCreationTime) {
-        THROW_IF_WIN32_BOOL_FALSE(
-            GetFileTime(file.get(), pCreationTime, nullptr, nullptr));
+        case CTaskManagerDlg::DataSource::kModTask:
+            return ModStatusTable::Category::kModTask;
     }
 
-    return fileContents;
+    throw std::logic_error("Unknown data source");
 }
 
 std::wstring LocalizeStatus(PCWSTR status) {
@@ -103,47 +75,13 @@ std::wstring LocalizeStatus(PCWSTR status) {
     return status;
 }
 
-bool IsProcessFrozen(DWORD processId) {
-    wil::unique_process_handle process(
-        OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId));
-    if (!process) {
-        return false;
-    }
-
-    return Functions::IsProcessFrozen(process.get());
-}
-
 }  // namespace
 
 // static
-bool CTaskManagerDlg::IsDataSourceEmpty(DataSource dataSource) {
-    PCWSTR metadataCategory = nullptr;
-    switch (dataSource) {
-        case DataSource::kModStatus:
-            metadataCategory = L"mod-status";
-            break;
-
-        case DataSource::kModTask:
-            metadataCategory = L"mod-task";
-            break;
-    }
-
-    auto metadataPath =
-        StorageManager::GetInstance().GetModMetadataPath(metadataCategory);
-
-    if (!std::filesystem::exists(metadataPath)) {
-        return true;
-    }
-
-    for (const auto& p : std::filesystem::directory_iterator(metadataPath)) {
-        if (!p.is_regular_file()) {
-            continue;
-        }
-
-        return false;
-    }
-
-    return true;
+bool CTaskManagerDlg::IsDataSourceEmpty(DataSource dataSource,
+                                        DWORD sessionManagerProcessId) {
+    ModStatus::SessionTableReader reader(sessionManagerProcessId);
+    return reader.IsEmpty(GetModStatusCategory(dataSource));
 }
 
 CTaskManagerDlg::CTaskManagerDlg(DialogOptions dialogOptions)
@@ -181,7 +119,7 @@ void CTaskManagerDlg::LoadLanguageStrings() {
     for (int i = 0; i < ARRAYSIZE(columnStringIds); i++) {
         LVCOLUMN column = {LVCF_TEXT};
         column.pszText = (PWSTR)Functions::LoadStrFromRsrc(columnStringIds[i]);
-        m_taskListSort.SetColumn(i, &column);
+        m_taskList.SetColumn(i, &column);
     }
 
     bool languageRightToLeft =
@@ -263,11 +201,6 @@ void CTaskManagerDlg::OnDestroy() {
         KillTimer(Timer::kShowDlg);
     }
 
-    int count = m_taskListSort.GetItemCount();
-    for (int i = 0; i < count; i++) {
-        delete reinterpret_cast<ListItemData*>(m_taskListSort.GetItemData(i));
-    }
-
     // From GDI handle checks, not all icons are freed automatically.
     ::DestroyIcon(SetIcon(nullptr, TRUE));
     ::DestroyIcon(SetIcon(nullptr, FALSE));
@@ -319,13 +252,88 @@ void CTaskManagerDlg::OnCancel(UINT uNotifyCode, int nID, CWindow wndCtl) {
 LRESULT CTaskManagerDlg::OnListRightClick(LPNMHDR pnmh) {
     // LPNMITEMACTIVATE pnmItemActivate = (LPNMITEMACTIVATE)pnmh;
 
-    // if (m_taskListSort.GetItemCount() == 0) {
+    // if (m_taskListModel.GetCount() == 0) {
     //     return 1;
     // }
 
     return 1;
 }
 
+LRESULT CTaskManagerDlg::OnListGetDispInfo(LPNMHDR pnmh) {
+    auto* pDispInfo = reinterpret_cast<NMLVDISPINFO*>(pnmh);
+    LVITEM& item = pDispInfo->item;
+
+    if (!(item.mask & LVIF_TEXT) || item.iItem < 0 ||
+        static_cast<size_t>(item.iItem) >= m_taskListModel.GetCount()) {
+        return 0;
+    }
+
+    const auto& listItem = m_taskListModel.GetRow(item.iItem);
+
+    switch (item.iSubItem) {
+        case 0:
+            wcsncpy_s(item.pszText, item.cchTextMax, listItem.modName.c_str(),
+                      _TRUNCATE);
+            break;
+
+        case 1: {
+            auto it = m_processes.find(listItem.processId);
+            if (it != m_processes.end() && it->second.isFrozen) {
+                _snwprintf_s(
+                    item.pszText, item.cchTextMax, _TRUNCATE, L"%s %s",
+                    listItem.processName.c_str(),
+                    Functions::LoadStrFromRsrc(IDS_TASKDLG_PROCESS_SUSPENDED));
+            } else {
+                wcsncpy_s(item.pszText, item.cchTextMax,
+                          listItem.processName.c_str(), _TRUNCATE);
+            }
+            break;
+        }
+
+        case 2:
+            wcsncpy_s(item.pszText, item.cchTextMax,
+                      listItem.processIdText.c_str(), _TRUNCATE);
+            break;
+
+        case 3:
+            wcsncpy_s(item.pszText, item.cchTextMax,
+                      listItem.statusText.c_str(), _TRUNCATE);
+            break;
+    }
+
+    return 0;
+}
+
+LRESULT CTaskManagerDlg::OnListColumnClick(LPNMHDR pnmh) {
+    auto* pnmListView = reinterpret_cast<LPNMLISTVIEW>(pnmh);
+
+    if (pnmListView->iSubItem == m_sortColumn) {
+        m_sortDescending = !m_sortDescending;
+    } else {
+        m_sortColumn = pnmListView->iSubItem;
+        m_sortDescending = false;
+    }
+
+    int selectedIndex = m_taskList.GetSelectedIndex();
+    std::optional<ListItemKey> selectedKey;
+    if (selectedIndex != -1) {
+        selectedKey = m_taskListModel.GetRowKey(selectedIndex);
+    }
+
+    ApplyTaskListSortOrder();
+
+    if (selectedKey) {
+        auto row = m_taskListModel.FindRow(*selectedKey);
+        if (row) {
+            m_taskList.SelectItem(static_cast<int>(*row));
+        }
+    }
+
+    m_taskList.Invalidate(FALSE);
+
+    return 0;
+}
+
 void CTaskManagerDlg::OnFinalMessage(HWND hWnd) {
     if (m_dialogOptions.finalMessageCallback) {
         m_dialogOptions.finalMessageCallback(m_hWnd);
@@ -378,9 +386,9 @@ void CTaskManagerDlg::PlaceWindowAtTrayArea() {
 }
 
 void CTaskManagerDlg::InitTaskList() {
-    CListViewCtrl list(GetDlgItem(IDC_TASK_LIST));
+    m_taskList = GetDlgItem(IDC_TASK_LIST);
 
-    m_taskListSort.SubclassWindow(list);
+    CListViewCtrl list(m_taskList);
 
     list.SetExtendedListViewStyle(LVS_EX_HEADERDRAGDROP | LVS_EX_FULLROWSELECT |
                                   LVS_EX_LABELTIP | LVS_EX_DOUBLEBUFFER);
@@ -388,21 +396,14 @@ void CTaskManagerDlg::InitTaskList() {
 
     UINT windowDpi = Functions::GetDpiForWindowWithFallback(m_hWnd);
 
-    // Sort PIDs as decimals, signed 128-bit (16-byte) values representing
-    // 96-bit (12-byte) integer numbers:
-    // https://learn.microsoft.com/en-us/dotnet/visual-basic/language-reference/data-types/decimal-data-type
-    // A bit of an overkill, but LVCOLSORT_LONG is signed 32-bit while PIDs are
-    // unsigned 32-bit, so it doesn't fit. And a custom type isn't worth the
-    // effort.
     struct {
         PCWSTR name;
         int width;
-        WORD sort;
     } columns[] = {
-        {L"Mod", 160, LVCOLSORT_TEXT},
-        {L"Process", 80, LVCOLSORT_TEXT},
-        {L"PID", 60, LVCOLSORT_DECIMAL},
-        {L"Status", LVSCW_AUTOSIZE_USEHEADER, LVCOLSORT_TEXT},
+        {L"Mod", 160},
+        {L"Process", 80},
+        {L"PID", 60},
+        {L"Status", LVSCW_AUTOSIZE_USEHEADER},
     };
 
     for (int i = 0; i < ARRAYSIZE(columns); i++) {
@@ -412,7 +413,6 @@ void CTaskManagerDlg::InitTaskList() {
             width = MulDiv(width, windowDpi, 96);
         }
         list.SetColumnWidth(i, width);
-        m_taskListSort.SetColumnSortType(i, columns[i].sort);
     }
 
     // Reduce the width of the last column so that a horizontal scrollbar won't
@@ -424,7 +424,7 @@ void CTaskManagerDlg::InitTaskList() {
         lastColumn, std::max(list.GetColumnWidth(lastColumn) - scrollbarWidth,
                              scrollbarWidth));
 
-    m_taskListSort.SetSortColumn(0);
+    ApplyTaskListSortOrder();
 
     // Fix tooltip not always on top.
     if (GetExStyle() & WS_EX_TOPMOST) {
@@ -433,182 +433,128 @@ void CTaskManagerDlg::InitTaskList() {
     }
 }
 
-void CTaskManagerDlg::LoadTaskList() {
-    m_taskListSort.SetRedraw(FALSE);
-
-    auto redrawWhenDone = wil::scope_exit([this] {
-        m_taskListSort.SetRedraw(TRUE);
-        m_taskListSort.RedrawWindow(
-            nullptr, nullptr,
-            RDW_ERASE | RDW_FRAME | RDW_INVALIDATE | RDW_ALLCHILDREN);
+void CTaskManagerDlg::ApplyTaskListSortOrder() {
+    int sortColumn = m_sortColumn;
+    bool sortDescending = m_sortDescending;
+    m_taskListModel.SetOrder([sortColumn, sortDescending](const ListItem& a,
+                                                          const ListItem& b) {
+        int result = CompareListItems(a, b, sortColumn);
+        return sortDescending ? result > 0 : result < 0;
     });
 
-    PCWSTR metadataCategory = nullptr;
-    switch (m_dialogOptions.dataSource) {
-        case DataSource::kModStatus:
-            metadataCategory = L"mod-status";
-            break;
-
-        case DataSource::kModTask:
-            metadataCategory = L"mod-task";
-            break;
+    CHeaderCtrl header = m_taskList.GetHeader();
+    int columnCount = header.GetItemCount();
+    for (int i = 0; i < columnCount; i++) {
+        HDITEM headerItem = {HDI_FORMAT};
+        header.GetItem(i, &headerItem);
+        headerItem.fmt &= ~(HDF_SORTUP | HDF_SORTDOWN);
+        if (i == m_sortColumn) {
+            headerItem.fmt |= m_sortDescending ? HDF_SORTDOWN : HDF_SORTUP;
+        }
+        header.SetItem(i, &headerItem);
     }
+}
 
-    auto metadataPath =
-        StorageManager::GetInstance().GetModMetadataPath(metadataCategory);
-
-    int firstItemIndex = m_taskListSort.GetItemCount();
-    int itemIndex = firstItemIndex;
-
-    int selectedIndex = m_taskListSort.GetSelectedIndex();
-    bool isSelectionVisible = selectedIndex == -1
-                                  ? false
-                                  : m_taskListSort.IsItemVisible(selectedIndex);
-    std::wstring selectedFilePath =
-        selectedIndex == -1 ? std::wstring()
-                            : reinterpret_cast<ListItemData*>(
-                                  m_taskListSort.GetItemData(selectedIndex))
-                                  ->filePath;
-
-    if (std::filesystem::exists(metadataPath)) {
-        for (const auto& p :
-             std::filesystem::directory_iterator(metadataPath)) {
-            if (!p.is_regular_file()) {
-                continue;
+void CTaskManagerDlg::LoadTaskList() {
+    if (!m_modStatusReader) {
+        m_modStatusReader.emplace(m_dialogOptions.sessionManagerProcessId);
+    }
+
+    auto items = m_modStatusReader->Read(
+        GetModStatusCategory(m_dialogOptions.dataSource));
+
+    int selectedIndex = m_taskList.GetSelectedIndex();
+    std::optional<ListItemKey> selectedKey;
+    bool isSelectionVisible = false;
+    if (selectedIndex != -1) {
+        selectedKey = m_taskListModel.GetRowKey(selectedIndex);
+        int topIndex = m_taskList.GetTopIndex();
+        isSelectionVisible =
+            selectedIndex >= topIndex &&
+            selectedIndex < topIndex + m_taskList.GetCountPerPage();
+    }
+
+    auto changes = m_taskListModel.Apply(
+        std::move(items),
+        [](const ModStatus::Item& item) {
+            return (static_cast<ListItemKey>(item.slotIndex) << 32) |
+                   item.generation;
+        },
+        [](ModStatus::Item&& item) {
+            std::wstring statusText = LocalizeStatus(item.value.c_str());
+            return ListItem{
+                .modName = std::move(item.modName),
+                .processName = std::move(item.processName),
+                .processId = item.processId,
+                .processIdText = std::to_wstring(item.processId),
+                .status = std::move(item.value),
+                .statusText = std::move(statusText),
+                .creationTime = item.creationTime,
+            };
+        },
+        [](ListItem& listItem, ModStatus::Item&& item) {
+            // The key identifies the mod and the process, only the value can
+            // change.
+            if (listItem.status == item.value) {
+                return false;
             }
 
-            try {
-                if (!LoadTaskItemFromMetadataFile(p.path(), itemIndex)) {
-                    VERBOSE(L"Didn't load %s", p.path().c_str());
-                    continue;
-                }
-
-                if (selectedFilePath == p.path()) {
-                    // Like SelectItem, but without EnsureVisible.
-                    if (m_taskListSort.SetItemState(
-                            itemIndex, LVIS_SELECTED | LVIS_FOCUSED,
-                            LVIS_SELECTED | LVIS_FOCUSED)) {
-                        m_taskListSort.SetSelectionMark(itemIndex);
-                    }
-                }
-
-                itemIndex++;
-            } catch (const std::exception& e) {
-                LOG(L"Error handling %s: %S", p.path().c_str(), e.what());
-            }
-        }
-    }
+            listItem.statusText = LocalizeStatus(item.value.c_str());
+            listItem.status = std::move(item.value);
+            return true;
+        });
 
-    // Remove old items only after adding new items to preserve the scroll
-    // position.
-    for (int i = 0; i < firstItemIndex; i++) {
-        delete reinterpret_cast<ListItemData*>(m_taskListSort.GetItemData(0));
-        m_taskListSort.DeleteItem(0);
+    if (!changes.Any()) {
+        return;
     }
 
-    m_taskListSort.DoSortItems(m_taskListSort.GetSortColumn(),
-                               m_taskListSort.IsSortDescending());
-
-    if (isSelectionVisible) {
-        int newSelectedIndex = m_taskListSort.GetSelectedIndex();
-        if (newSelectedIndex != -1) {
-            m_taskListSort.EnsureVisible(newSelectedIndex, FALSE);
-        }
-    }
-}
+    UpdateTaskListProcesses();
 
-bool CTaskManagerDlg::LoadTaskItemFromMetadataFile(
-    const std::filesystem::path& filePath,
-    int itemIndex) {
-    auto filenameParts =
-        Functions::SplitString(filePath.filename().native(), L'_');
-    if (filenameParts.size() != 4) {
-        return false;
-    }
+    // Only the visible rows are queried again.
+    m_taskList.SetItemCountEx(static_cast<int>(m_taskListModel.GetCount()),
+                              LVSICF_NOSCROLL);
 
-    DWORD sessionManagerProcessId = std::stoul(filenameParts[0]);
-    ULONGLONG sessionManagerProcessCreationTime = std::stoull(filenameParts[1]);
-    if (sessionManagerProcessId != m_dialogOptions.sessionManagerProcessId ||
-        sessionManagerProcessCreationTime !=
-            m_dialogOptions.sessionManagerProcessCreationTime) {
-        // Probably a stale file, try to remove.
-        std::error_code ec;
-        std::filesystem::remove(filePath, ec);
-        return false;
+    // Selection is tracked by index, move it with the item.
+    std::optional<size_t> newSelectedRow;
+    if (selectedKey) {
+        newSelectedRow = m_taskListModel.FindRow(*selectedKey);
     }
 
-    DWORD targetProcessId = std::stoul(filenameParts[2]);
-
-    auto& modName = filenameParts[3];
+    if (!newSelectedRow || *newSelectedRow != selectedIndex) {
+        m_taskList.SetItemState(-1, 0, LVIS_SELECTED | LVIS_FOCUSED);
 
-    FILETIME creationTime;
-    std::wstring metadata = GetMetadataContent(filePath.c_str(), &creationTime);
+        if (newSelectedRow) {
+            int newSelectedIndex = static_cast<int>(*newSelectedRow);
 
-    PCWSTR processName = metadata.c_str();
-    PCWSTR status = L"";
+            // Like SelectItem, but without EnsureVisible.
+            if (m_taskList.SetItemState(newSelectedIndex,
+                                        LVIS_SELECTED | LVIS_FOCUSED,
+                                        LVIS_SELECTED | LVIS_FOCUSED)) {
+                m_taskList.SetSelectionMark(newSelectedIndex);
+            }
 
-    auto separator = metadata.find(L'|');
-    if (separator != metadata.npos) {
-        metadata[separator] = L'\0';
-        status = metadata.c_str() + separator + 1;
+            if (isSelectionVisible) {
+                m_taskList.EnsureVisible(newSelectedIndex, FALSE);
+            }
+        }
     }
-
-    AddItemToList(itemIndex, filePath.c_str(), modName.c_str(), processName,
-                  targetProcessId, status, creationTime);
-    return true;
 }
 
-void CTaskManagerDlg::AddItemToList(int itemIndex,
-                                    PCWSTR filePath,
-                                    PCWSTR mod,
-                                    PCWSTR processName,
-                                    DWORD processId,
-                                    PCWSTR status,
-                                    FILETIME creationTime) {
-    std::wstring processNameFormatted = processName;
-    bool isFrozen = IsProcessFrozen(processId);
-    if (isFrozen) {
-        processNameFormatted += L' ';
-        processNameFormatted +=
-            Functions::LoadStrFromRsrc(IDS_TASKDLG_PROCESS_SUSPENDED);
-    }
-
-    m_taskListSort.AddItem(itemIndex, 0, mod);
-    m_taskListSort.AddItem(itemIndex, 1, processNameFormatted.c_str());
-    m_taskListSort.AddItem(itemIndex, 2, std::to_wstring(processId).c_str());
-    m_taskListSort.AddItem(itemIndex, 3, LocalizeStatus(status).c_str());
+void CTaskManagerDlg::UpdateTaskListProcesses() {
+    std::unordered_set<DWORD> processIds;
 
-    // The process handle must be kept alive while the request is active.
-    // Otherwise, a BSOD might occur in Windows 10.
-    wil::unique_process_handle executionRequiredRequestProcess;
-    wil::unique_handle executionRequiredRequest;
-    if (Functions::IsWindowsVersionOrGreaterWithBuildNumber(10, 0, 0)) {
-        executionRequiredRequestProcess.reset(
-            OpenProcess(PROCESS_SET_LIMITED_INFORMATION, FALSE, processId));
-        if (executionRequiredRequestProcess) {
-            HRESULT hr = Functions::CreateExecutionRequiredRequest(
-                executionRequiredRequestProcess.get(),
-                executionRequiredRequest.put());
-            if (FAILED(hr) || !executionRequiredRequest) {
-                LOG(L"Failed to create execution required request: %08X", hr);
-                executionRequiredRequest.reset();
-                executionRequiredRequestProcess.reset();
-            }
+    size_t count = m_taskListModel.GetCount();
+    for (size_t i = 0; i < count; i++) {
+        DWORD processId = m_taskListModel.GetRow(i).processId;
+        if (processIds.insert(processId).second &&
+            !m_processes.contains(processId)) {
+            m_processes.emplace(processId, OpenProcessState(processId));
         }
     }
 
-    auto* itemData = new ListItemData{
-        .filePath = filePath,
-        .processName = processName,
-        .processId = processId,
-        .creationTime = wil::filetime::to_int64(creationTime),
-        .isFrozen = isFrozen,
-        .executionRequiredRequestProcess =
-            std::move(executionRequiredRequestProcess),
-        .executionRequiredRequest = std::move(executionRequiredRequest),
-    };
-    m_taskListSort.SetItemData(itemIndex,
-                               reinterpret_cast<DWORD_PTR>(itemData));
+    std::erase_if(m_processes, [&processIds](const auto& item) {
+        return !processIds.contains(item.first);
+    });
 }
 
 void CTaskManagerDlg::RefreshTaskList() {
@@ -631,31 +577,20 @@ void CTaskManagerDlg::RefreshTaskList() {
 void CTaskManagerDlg::UpdateTaskListProcessesStatus() {
     bool updated = false;
 
-    int itemCount = m_taskListSort.GetItemCount();
-    for (int i = 0; i < itemCount; i++) {
-        auto* itemData =
-            reinterpret_cast<ListItemData*>(m_taskListSort.GetItemData(i));
-
-        bool isFrozen = IsProcessFrozen(itemData->processId);
-        if (isFrozen == itemData->isFrozen) {
+    for (auto& [processId, processState] : m_processes) {
+        bool isFrozen =
+            processState.process &&
+            Functions::IsProcessFrozen(processState.process.get());
+        if (isFrozen == processState.isFrozen) {
             continue;
         }
 
-        itemData->isFrozen = isFrozen;
-
-        std::wstring processNameFormatted = itemData->processName;
-        if (isFrozen) {
-            processNameFormatted += L' ';
-            processNameFormatted +=
-                Functions::LoadStrFromRsrc(IDS_TASKDLG_PROCESS_SUSPENDED);
-        }
-
-        m_taskListSort.SetItemText(i, 1, processNameFormatted.c_str());
-
+        processState.isFrozen = isFrozen;
         updated = true;
     }
 
     if (updated) {
+        m_taskList.Invalidate(FALSE);
         UpdateDialogAfterListUpdate();
     }
 }
@@ -665,21 +600,14 @@ void CTaskManagerDlg::UpdateDialogAfterListUpdate() {
         return;
     }
 
-    int itemCount = m_taskListSort.GetItemCount();
+    size_t itemCount = m_taskListModel.GetCount();
     if (itemCount == 0) {
         DestroyWindow();
         return;
     }
 
-    bool allProcessesAreFrozen = true;
-    for (int i = 0; i < itemCount; i++) {
-        auto* itemData =
-            reinterpret_cast<ListItemData*>(m_taskListSort.GetItemData(i));
-        if (!itemData->isFrozen) {
-            allProcessesAreFrozen = false;
-            break;
-        }
-    }
+    bool allProcessesAreFrozen = std::ranges::all_of(
+        m_processes, [](const auto& item) { return item.second.isFrozen; });
 
     if (allProcessesAreFrozen) {
         if (m_showDlgPending) {
@@ -698,10 +626,8 @@ void CTaskManagerDlg::UpdateDialogAfterListUpdate() {
         // will always be updated and the dialog will never be shown.
 
         ULONGLONG earliestCreationTime = ULONGLONG_MAX;
-        for (int i = 0; i < itemCount; i++) {
-            auto* itemData =
-                reinterpret_cast<ListItemData*>(m_taskListSort.GetItemData(i));
-            ULONGLONG creationTime = itemData->creationTime;
+        for (size_t i = 0; i < itemCount; i++) {
+            ULONGLONG creationTime = m_taskListModel.GetRow(i).creationTime;
             if (creationTime < earliestCreationTime) {
                 earliestCreationTime = creationTime;
             }
@@ -729,3 +655,58 @@ void CTaskManagerDlg::UpdateDialogAfterListUpdate() {
         m_showDlgPending = true;
     }
 }
+
+// static
+int CTaskManagerDlg::CompareListItems(const ListItem& a,
+                                      const ListItem& b,
+                                      int column) {
+    switch (column) {
+        case 0:
+            return lstrcmpi(a.modName.c_str(), b.modName.c_str());
+
+        case 1:
+            return lstrcmpi(a.processName.c_str(), b.processName.c_str());
+
+        case 2:
+            return a.processId < b.processId ? -1
+                   : a.processId > b.processId ? 1
+                                               : 0;
+
+        case 3:
+            return lstrcmpi(a.statusText.c_str(), b.statusText.c_str());
+    }
+
+    return 0;
+}
+
+// static
+CTaskManagerDlg::ProcessState CTaskManagerDlg::OpenProcessState(
+    DWORD processId) {
+    ProcessState processState;
+
+    processState.process.reset(
+        OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processId));
+    if (processState.process) {
+        processState.isFrozen =
+            Functions::IsProcessFrozen(processState.process.get());
+    }
+
+    // The process handle must be kept alive while the request is active.
+    // Otherwise, a BSOD might occur in Windows 10.
+    if (Functions::IsWindowsVersionOrGreaterWithBuildNumber(10, 0, 0)) {
+        processState.executionRequiredRequestProcess.reset(
+            OpenProcess(PROCESS_SET_LIMITED_INFORMATION, FALSE, processId));
+        if (processState.executionRequiredRequestProcess) {
+            HRESULT hr = Functions::CreateExecutionRequiredRequest(
+                processState.executionRequiredRequestProcess.get(),
+                processState.executionRequiredRequest.put());
+            if (FAILED(hr) || !processState.executionRequiredRequest) {
+                LOG(L"Failed to create execution required request: %08X", hr);
+                processState.executionRequiredRequest.reset();
+                processState.executionRequiredRequestProcess.reset();
+            }
+        }
+    }
+
+    return processState;
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "keyed_list_model.h"
+#include "mod_status.h"
 #include "resource.h"
 
 class CTaskManagerDlg : public CDialogImpl<CTaskManagerDlg>,
@@ -29,12 +31,12 @@ class CTaskManagerDlg : public CDialogImpl<CTaskManagerDlg>,
         bool autonomousMode = false;
         int autonomousModeShowDelay = kAutonomousModeShowDelayDefault;
         DWORD sessionManagerProcessId{};
-        ULONGLONG sessionManagerProcessCreationTime{};
         DlgCallback runButtonCallback;
         DlgCallback finalMessageCallback;
     };
 
-    static bool IsDataSourceEmpty(DataSource dataSource);
+    static bool IsDataSourceEmpty(DataSource dataSource,
+                                  DWORD sessionManagerProcessId);
 
     CTaskManagerDlg(DialogOptions dialogOptions);
 
@@ -57,8 +59,31 @@ class CTaskManagerDlg : public CDialogImpl<CTaskManagerDlg>,
         COMMAND_ID_HANDLER_EX(IDOK, OnOK)
         COMMAND_ID_HANDLER_EX(IDCANCEL, OnCancel)
         NOTIFY_HANDLER_EX(IDC_TASK_LIST, NM_RCLICK, OnListRightClick)
+        NOTIFY_HANDLER_EX(IDC_TASK_LIST, LVN_GETDISPINFO, OnListGetDispInfo)
+        NOTIFY_HANDLER_EX(IDC_TASK_LIST, LVN_COLUMNCLICK, OnListColumnClick)
     END_MSG_MAP()
 
+    // The slot index and the generation of the mod status table entry.
+    using ListItemKey = ULONGLONG;
+
+    struct ListItem {
+        std::wstring modName;
+        std::wstring processName;
+        DWORD processId = 0;
+        std::wstring processIdText;
+        std::wstring status;
+        std::wstring statusText;
+        ULONGLONG creationTime = 0;
+    };
+
+    // Shared by all list items of a process.
+    struct ProcessState {
+        wil::unique_process_handle process;
+        bool isFrozen = false;
+        wil::unique_process_handle executionRequiredRequestProcess;
+        wil::unique_handle executionRequiredRequest;
+    };
+
     BOOL OnInitDialog(CWindow wndFocus, LPARAM lInitParam);
     void OnDestroy();
     void OnTimer(UINT_PTR nIDEvent);
@@ -66,6 +91,8 @@ class CTaskManagerDlg : public CDialogImpl<CTaskManagerDlg>,
     void OnOK(UINT uNotifyCode, int nID, CWindow wndCtl);
     void OnCancel(UINT uNotifyCode, int nID, CWindow wndCtl);
     LRESULT OnListRightClick(LPNMHDR pnmh);
+    LRESULT OnListGetDispInfo(LPNMHDR pnmh);
+    LRESULT OnListColumnClick(LPNMHDR pnmh);
 
     void OnFinalMessage(HWND hWnd) override;
     UINT_PTR SetTimer(Timer nIDEvent,
@@ -75,22 +102,25 @@ class CTaskManagerDlg : public CDialogImpl<CTaskManagerDlg>,
     void ReloadMainIcon();
     void PlaceWindowAtTrayArea();
     void InitTaskList();
+    void ApplyTaskListSortOrder();
     void LoadTaskList();
-    bool LoadTaskItemFromMetadataFile(const std::filesystem::path& filePath,
-                                      int itemIndex);
-    void AddItemToList(int itemIndex,
-                       PCWSTR filePath,
-                       PCWSTR mod,
-                       PCWSTR processName,
-                       DWORD processId,
-                       PCWSTR status,
-                       FILETIME creationTime);
+    void UpdateTaskListProcesses();
     void RefreshTaskList();
     void UpdateTaskListProcessesStatus();
     void UpdateDialogAfterListUpdate();
 
+    static int CompareListItems(const ListItem& a,
+                                const ListItem& b,
+                                int column);
+    static ProcessState OpenProcessState(DWORD processId);
+
     const DialogOptions m_dialogOptions;
-    CSortListViewCtrl m_taskListSort;
+    std::optional<ModStatus::SessionTableReader> m_modStatusReader;
+    CListViewCtrl m_taskList;
+    KeyedListModel<ListItemKey, ListItem> m_taskListModel;
+    std::unordered_map<DWORD, ProcessState> m_processes;
+    int m_sortColumn = 0;
+    bool m_sortDescending = false;
     bool m_refreshListOnDataChangePending = false;
     bool m_showDlgPending = false;
 };
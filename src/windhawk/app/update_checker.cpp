@@ -2,14 +2,43 @@
 
 #include "update_checker.h"
 
+#include "gzip.h"
 #include "logger.h"
+#include "storage_manager.h"
 #include "version.h"
 
+#ifndef WINHTTP_OPTION_DECOMPRESSION
+#define WINHTTP_OPTION_DECOMPRESSION 118
+#define WINHTTP_DECOMPRESSION_FLAG_GZIP 0x00000001
+#define WINHTTP_DECOMPRESSION_FLAG_DEFLATE 0x00000002
+#define WINHTTP_DECOMPRESSION_FLAG_ALL \
+    (WINHTTP_DECOMPRESSION_FLAG_GZIP | WINHTTP_DECOMPRESSION_FLAG_DEFLATE)
+#endif
+
 namespace {
 
 constexpr auto* kUpdateCheckerUrl =
     L"https://update.windhawk.net/versions.json";
 
+// The ETag of the last response, and the hash of the data which was posted to
+// get it. If the data to post didn't change since then, the request is made
+// conditional, and the server can reply with 304 Not Modified instead of
+// sending the same versions again.
+constexpr auto* kUpdateCheckETagValueName = L"UpdateCheckETag";
+constexpr auto* kUpdateCheckPostedDataHashValueName =
+    L"UpdateCheckPostedDataHash";
+
+// Set once the server announced that it accepts gzip request bodies with an
+// Accept-Encoding response header (RFC 7694). Until then, and if it rejects
+// them with 415 UNSUPPORTED MEDIA TYPE, the data is posted as is.
+constexpr auto* kUpdateCheckGzipRequestsValueName = L"UpdateCheckGzipRequests";
+
+// Requested together with If-None-Match (RFC 3229). The server can reply with
+// 226 IM USED and only the versions which changed since the ETag, in the same
+// format as the full response.
+constexpr auto* kDeltaInstanceManipulation = L"windhawk-delta";
+constexpr DWORD kHttpStatusImUsed = 226;
+
 USHORT GetNativeMachineImpl() {
     using IsWow64Process2_t = BOOL(WINAPI*)(
         HANDLE hProcess, USHORT * pProcessMachine, USHORT * pNativeMachine);
@@ -76,30 +105,188 @@ CWinHTTPSimpleOptions GetUpdateCheckerOptions(DWORD flags,
     return options;
 }
 
+void EnableDecompression(CWinHTTPSimple& httpSimple) {
+    // Makes WinHTTP send Accept-Encoding and decompress gzip and deflate
+    // responses. Supported since Windows 8.1.
+    DWORD decompression = WINHTTP_DECOMPRESSION_FLAG_ALL;
+    HRESULT hr = httpSimple.SetOption(WINHTTP_OPTION_DECOMPRESSION,
+                                      &decompression, sizeof(decompression));
+    if (FAILED(hr)) {
+        VERBOSE(L"WINHTTP_OPTION_DECOMPRESSION isn't supported: 0x%08X", hr);
+    }
+}
+
+// FNV-1a, only used to detect changes of the posted data.
+std::wstring HashPostedData(const std::string& data) {
+    ULONGLONG hash = 14695981039346656037ULL;
+    for (char c : data) {
+        hash ^= static_cast<BYTE>(c);
+        hash *= 1099511628211ULL;
+    }
+
+    WCHAR hashString[17];
+    swprintf_s(hashString, L"%016llX", hash);
+    return hashString;
+}
+
+std::optional<std::wstring> GetStoredETag(const std::wstring& postedDataHash) {
+    try {
+        auto settings =
+            StorageManager::GetInstance().GetAppConfig(L"Settings", false);
+        if (settings->GetString(kUpdateCheckPostedDataHashValueName) ==
+            postedDataHash) {
+            return settings->GetString(kUpdateCheckETagValueName);
+        }
+    } catch (const std::exception& e) {
+        LOG(L"%S", e.what());
+    }
+
+    return std::nullopt;
+}
+
+void StoreETag(const std::wstring& postedDataHash,
+               const std::optional<std::wstring>& etag) {
+    try {
+        auto settings =
+            StorageManager::GetInstance().GetAppConfig(L"Settings", true);
+        if (etag) {
+            settings->SetString(kUpdateCheckETagValueName, etag->c_str());
+            settings->SetString(kUpdateCheckPostedDataHashValueName,
+                                postedDataHash.c_str());
+        } else {
+            settings->Remove(kUpdateCheckETagValueName);
+            settings->Remove(kUpdateCheckPostedDataHashValueName);
+        }
+    } catch (const std::exception& e) {
+        LOG(L"%S", e.what());
+    }
+}
+
+bool AreGzipRequestsAccepted() {
+    try {
+        auto settings =
+            StorageManager::GetInstance().GetAppConfig(L"Settings", false);
+        return settings->GetInt(kUpdateCheckGzipRequestsValueName)
+                   .value_or(0) != 0;
+    } catch (const std::exception& e) {
+        LOG(L"%S", e.what());
+    }
+
+    return false;
+}
+
+void StoreGzipRequestsAccepted(bool accepted) {
+    try {
+        auto settings =
+            StorageManager::GetInstance().GetAppConfig(L"Settings", true);
+        if (accepted) {
+            settings->SetInt(kUpdateCheckGzipRequestsValueName, 1);
+        } else {
+            settings->Remove(kUpdateCheckGzipRequestsValueName);
+        }
+    } catch (const std::exception& e) {
+        LOG(L"%S", e.what());
+    }
+}
+
+// A response header, e.g. WINHTTP_QUERY_ETAG, or WINHTTP_QUERY_CUSTOM with
+// the header name.
+std::optional<std::wstring> QueryHeader(
+    CWinHTTPSimple& httpSimple,
+    DWORD infoLevel,
+    PCWSTR name = WINHTTP_HEADER_NAME_BY_INDEX) {
+    DWORD size = 0;
+    httpSimple.QueryHeaders(infoLevel, name, nullptr, size,
+                            WINHTTP_NO_HEADER_INDEX);
+    if (size == 0) {
+        return std::nullopt;
+    }
+
+    std::wstring value(size / sizeof(WCHAR), L'\0');
+    if (FAILED(httpSimple.QueryHeaders(infoLevel, name, value.data(), size,
+                                       WINHTTP_NO_HEADER_INDEX))) {
+        return std::nullopt;
+    }
+
+    value.resize(size / sizeof(WCHAR));
+    return value;
+}
+
+// Whether a comma-separated header value, such as Accept-Encoding, has the
+// token, ignoring case and parameters such as ";q=1".
+bool HeaderHasToken(std::wstring_view value, std::wstring_view token) {
+    while (!value.empty()) {
+        size_t comma = value.find(L',');
+        auto item = value.substr(0, comma);
+        value = comma == value.npos ? L"" : value.substr(comma + 1);
+
+        item = item.substr(0, item.find(L';'));
+        size_t start = item.find_first_not_of(L" \t");
+        size_t end = item.find_last_not_of(L" \t");
+        if (start != item.npos &&
+            item.substr(start, end - start + 1).length() == token.length() &&
+            _wcsnicmp(item.data() + start, token.data(), token.length()) ==
+                0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Like other non-2XX status codes, these are reported as an invalid header
+// error.
+bool IsErrorStatusCode(CWinHTTPSimple& httpSimple, DWORD statusCode) {
+    return httpSimple.GetRequestResult() ==
+               HRESULT_FROM_WIN32(ERROR_WINHTTP_INVALID_HEADER) &&
+           httpSimple.GetLastStatusCode() == statusCode;
+}
+
 }  // namespace
 
 UpdateChecker::UpdateChecker(DWORD flags,
                              std::function<void()> onUpdateCheckDone)
     : m_flags(flags),
       m_postedData(UserProfile::GetLocalUpdatedContentAsString()),
+      m_gzipRequest(!m_postedData.empty() && AreGzipRequestsAccepted()),
+      m_requestBody(m_gzipRequest ? Gzip::Compress(m_postedData)
+                                  : m_postedData),
       m_httpSimple(GetUpdateCheckerOptions(m_flags,
-                                           m_postedData.data(),
-                                           m_postedData.length()),
+                                           m_requestBody.data(),
+                                           m_requestBody.length()),
                    onUpdateCheckDone != nullptr),
       m_onUpdateCheckDone(std::move(onUpdateCheckDone)) {
     if (!m_postedData.empty()) {
         THROW_IF_FAILED(m_httpSimple.AddHeaders(
             L"Content-Type: application/json", -1L, WINHTTP_ADDREQ_FLAG_ADD));
+
+        if (m_gzipRequest) {
+            THROW_IF_FAILED(m_httpSimple.AddHeaders(L"Content-Encoding: gzip",
+                                                    -1L,
+                                                    WINHTTP_ADDREQ_FLAG_ADD));
+        }
+
+        m_postedDataHash = HashPostedData(m_postedData);
+        if (auto etag = GetStoredETag(m_postedDataHash)) {
+            std::wstring headers = L"If-None-Match: " + *etag +
+                                   L"\r\nA-IM: " + kDeltaInstanceManipulation;
+            THROW_IF_FAILED(m_httpSimple.AddHeaders(headers.c_str(), -1L,
+                                                    WINHTTP_ADDREQ_FLAG_ADD));
+            m_conditionalRequest = true;
+        }
     }
 
+    EnableDecompression(m_httpSimple);
+
     if (m_onUpdateCheckDone) {
         THROW_IF_FAILED(m_httpSimple.SendRequest([this] { OnRequestDone(); }));
     } else {
         m_httpSimple.SendRequest(nullptr);
-        if (ShouldRetryWithAGetRequest()) {
-            m_httpSimpleGetRequest = std::make_unique<CWinHTTPSimple>(
-                GetUpdateCheckerOptions(m_flags, nullptr, 0), false);
-            m_httpSimpleGetRequest->SendRequest(nullptr);
+        if (auto retryRequest = GetRetryRequest();
+            retryRequest != RetryRequest::kNone) {
+            m_retryRequest = retryRequest;
+            m_httpSimpleRetryRequest = CreateRetryRequest(retryRequest, false);
+            m_httpSimpleRetryRequest->SendRequest(nullptr);
         }
     }
 }
@@ -110,26 +297,50 @@ void UpdateChecker::Abort() {
     m_httpSimple.Abort();
 
     {
-        std::lock_guard<std::mutex> guard(m_httpSimpleGetRequestMutex);
-        if (m_httpSimpleGetRequest) {
-            m_httpSimpleGetRequest->Abort();
+        std::lock_guard<std::mutex> guard(m_httpSimpleRetryRequestMutex);
+        if (m_httpSimpleRetryRequest) {
+            m_httpSimpleRetryRequest->Abort();
         }
     }
 }
 
 UpdateChecker::Result UpdateChecker::HandleResponse() {
     CWinHTTPSimple& httpSimple =
-        m_httpSimpleGetRequest ? *m_httpSimpleGetRequest : m_httpSimple;
+        m_httpSimpleRetryRequest ? *m_httpSimpleRetryRequest : m_httpSimple;
 
     Result result = {};
     result.hrError = httpSimple.GetRequestResult();
     result.httpStatusCode = httpSimple.GetLastStatusCode();
 
+    if (IsNotModifiedResponse()) {
+        // The versions were already stored by the check which returned the
+        // ETag, and there are no new updates since then.
+        result.hrError = S_OK;
+        result.updateStatus = UserProfile::GetUpdateStatus();
+        return result;
+    }
+
     if (SUCCEEDED(result.hrError)) {
         try {
             const auto& response = httpSimple.GetResponse();
             result.updateStatus = UserProfile::UpdateContentWithOnlineData(
-                reinterpret_cast<PCSTR>(response.data()), response.size());
+                reinterpret_cast<PCSTR>(response.data()), response.size(),
+                IsDeltaResponse(httpSimple));
+
+            // The response of a GET request doesn't depend on the posted
+            // data, so its headers aren't stored.
+            if (m_retryRequest != RetryRequest::kGet &&
+                !m_postedData.empty()) {
+                StoreETag(m_postedDataHash,
+                          QueryHeader(httpSimple, WINHTTP_QUERY_ETAG));
+
+                auto acceptEncoding = QueryHeader(
+                    httpSimple, WINHTTP_QUERY_CUSTOM, L"Accept-Encoding");
+                if (!m_gzipRequest && acceptEncoding &&
+                    HeaderHasToken(*acceptEncoding, L"gzip")) {
+                    StoreGzipRequestsAccepted(true);
+                }
+            }
         } catch (const std::exception& e) {
             LOG(L"Handling server response failed: %S", e.what());
             result.hrError = E_FAIL;
@@ -139,28 +350,93 @@ UpdateChecker::Result UpdateChecker::HandleResponse() {
     return result;
 }
 
-bool UpdateChecker::ShouldRetryWithAGetRequest() {
+bool UpdateChecker::IsNotModifiedResponse() {
+    return m_conditionalRequest && m_retryRequest == RetryRequest::kNone &&
+           IsErrorStatusCode(m_httpSimple, HTTP_STATUS_NOT_MODIFIED);
+}
+
+bool UpdateChecker::IsDeltaResponse(CWinHTTPSimple& httpSimple) {
+    if (!m_conditionalRequest || m_retryRequest != RetryRequest::kNone ||
+        httpSimple.GetLastStatusCode() != kHttpStatusImUsed) {
+        return false;
+    }
+
+    auto instanceManipulation =
+        QueryHeader(httpSimple, WINHTTP_QUERY_CUSTOM, L"IM");
+    if (!instanceManipulation ||
+        !HeaderHasToken(*instanceManipulation, kDeltaInstanceManipulation)) {
+        throw std::runtime_error("Unsupported delta response");
+    }
+
+    return true;
+}
+
+UpdateChecker::RetryRequest UpdateChecker::GetRetryRequest() {
     // If the server doesn't support POST requests,
     // it can return 405 NOT ALLOWED.
     // Try with a GET request.
-    return m_httpSimple.GetRequestResult() ==
-               HRESULT_FROM_WIN32(ERROR_WINHTTP_INVALID_HEADER) &&
-           m_httpSimple.GetLastStatusCode() == 405;
+    if (IsErrorStatusCode(m_httpSimple, HTTP_STATUS_BAD_METHOD)) {
+        return RetryRequest::kGet;
+    }
+
+    // For a POST request, a failed If-None-Match condition is answered with
+    // 412 PRECONDITION FAILED instead of 304 NOT MODIFIED (RFC 9110). The
+    // stored ETag is stale in this case, so it's sent again without it.
+    if (m_conditionalRequest &&
+        IsErrorStatusCode(m_httpSimple, HTTP_STATUS_PRECOND_FAILED)) {
+        return RetryRequest::kPlain;
+    }
+
+    if (m_gzipRequest &&
+        IsErrorStatusCode(m_httpSimple, HTTP_STATUS_UNSUPPORTED_MEDIA)) {
+        return RetryRequest::kPlain;
+    }
+
+    return RetryRequest::kNone;
+}
+
+std::unique_ptr<CWinHTTPSimple> UpdateChecker::CreateRetryRequest(
+    RetryRequest retryRequest,
+    bool async) {
+    if (retryRequest == RetryRequest::kGet) {
+        auto httpSimple = std::make_unique<CWinHTTPSimple>(
+            GetUpdateCheckerOptions(m_flags, nullptr, 0), async);
+        EnableDecompression(*httpSimple);
+        return httpSimple;
+    }
+
+    // The data is posted without the condition and uncompressed.
+    if (IsErrorStatusCode(m_httpSimple, HTTP_STATUS_PRECOND_FAILED)) {
+        StoreETag(m_postedDataHash, std::nullopt);
+    } else {
+        StoreGzipRequestsAccepted(false);
+    }
+
+    auto httpSimple = std::make_unique<CWinHTTPSimple>(
+        GetUpdateCheckerOptions(m_flags, m_postedData.data(),
+                                m_postedData.length()),
+        async);
+    THROW_IF_FAILED(httpSimple->AddHeaders(L"Content-Type: application/json",
+                                           -1L, WINHTTP_ADDREQ_FLAG_ADD));
+    EnableDecompression(*httpSimple);
+    return httpSimple;
 }
 
 void UpdateChecker::OnRequestDone() {
-    if (ShouldRetryWithAGetRequest() && !m_aborted) {
-        std::lock_guard<std::mutex> guard(m_httpSimpleGetRequestMutex);
+    auto retryRequest = GetRetryRequest();
+    if (retryRequest != RetryRequest::kNone && !m_aborted) {
+        std::lock_guard<std::mutex> guard(m_httpSimpleRetryRequestMutex);
 
         if (!m_aborted) {
             try {
-                m_httpSimpleGetRequest = std::make_unique<CWinHTTPSimple>(
-                    GetUpdateCheckerOptions(m_flags, nullptr, 0), true);
-                THROW_IF_FAILED(m_httpSimpleGetRequest->SendRequest(
+                m_retryRequest = retryRequest;
+                m_httpSimpleRetryRequest =
+                    CreateRetryRequest(retryRequest, true);
+                THROW_IF_FAILED(m_httpSimpleRetryRequest->SendRequest(
                     [this] { m_onUpdateCheckDone(); }));
             } catch (const std::exception& e) {
-                m_httpSimpleGetRequest.reset();
-                LOG(L"Get request failed: %S", e.what());
+                m_httpSimpleRetryRequest.reset();
+                LOG(L"Retry request failed: %S", e.what());
                 m_onUpdateCheckDone();
             }
 
@@ -20,14 +20,30 @@ class UpdateChecker {
     Result HandleResponse();
 
    private:
-    bool ShouldRetryWithAGetRequest();
+    enum class RetryRequest {
+        kNone,
+        kPlain,
+        kGet,
+    };
+
+    bool IsNotModifiedResponse();
+    bool IsDeltaResponse(CWinHTTPSimple& httpSimple);
+    RetryRequest GetRetryRequest();
+    std::unique_ptr<CWinHTTPSimple> CreateRetryRequest(
+        RetryRequest retryRequest,
+        bool async);
     void OnRequestDone();
 
     std::atomic<bool> m_aborted = false;
     DWORD m_flags = 0;
     std::string m_postedData;
+    bool m_gzipRequest = false;
+    std::string m_requestBody;
+    std::wstring m_postedDataHash;
+    bool m_conditionalRequest = false;
     CWinHTTPSimple m_httpSimple;
-    std::unique_ptr<CWinHTTPSimple> m_httpSimpleGetRequest;
-    std::mutex m_httpSimpleGetRequestMutex;
+    RetryRequest m_retryRequest = RetryRequest::kNone;
+    std::unique_ptr<CWinHTTPSimple> m_httpSimpleRetryRequest;
+    std::mutex m_httpSimpleRetryRequestMutex;
     std::function<void()> m_onUpdateCheckDone;
 };
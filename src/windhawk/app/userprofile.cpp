@@ -4,6 +4,7 @@
 
 #include "functions.h"
 #include "logger.h"
+#include "online_data.h"
 #include "storage_manager.h"
 #include "version.h"
 
@@ -140,6 +141,46 @@ bool version_less_than(std::string v1, std::string v2) {
     return false;
 }
 
+// Counts the available updates, which are stored in userprofile.json.
+UserProfile::UpdateStatus GetStoredUpdateStatus(const json& userProfileJson) {
+    UserProfile::UpdateStatus updateStatus{};
+
+    // Check app update.
+    {
+        auto app = userProfileJson.find("app");
+        if (app != userProfileJson.end() && app->is_object()) {
+            auto version = app->find("version");
+            auto latestVersion = app->find("latestVersion");
+            if (version != app->end() && latestVersion != app->end() &&
+                version->is_string() && latestVersion->is_string() &&
+                *latestVersion != "" &&
+                version_less_than(version->get<std::string>(),
+                                  latestVersion->get<std::string>())) {
+                updateStatus.appUpdateAvailable = true;
+            }
+        }
+    }
+
+    // Check mod updates.
+    auto mods = userProfileJson.find("mods");
+    if (mods != userProfileJson.end() && mods->is_object()) {
+        for (auto& [key, mod] : mods->items()) {
+            if (mod.is_object()) {
+                auto modVersion = mod.find("version");
+                auto latestModVersion = mod.find("latestVersion");
+                if (modVersion != mod.end() && latestModVersion != mod.end() &&
+                    modVersion->is_string() && latestModVersion->is_string() &&
+                    *latestModVersion != "" &&
+                    *modVersion != *latestModVersion) {
+                    updateStatus.modUpdatesAvailable++;
+                }
+            }
+        }
+    }
+
+    return updateStatus;
+}
+
 }  // namespace
 
 namespace UserProfile {
@@ -149,12 +190,10 @@ std::string GetLocalUpdatedContentAsString() {
 }
 
 UpdateStatus UpdateContentWithOnlineData(PCSTR onlineData,
-                                         size_t onlineDataLength) {
+                                         size_t onlineDataLength,
+                                         bool delta) {
     UpdateStatus updateStatus{};
 
-    const json onlineDataJson =
-        json::parse(onlineData, onlineData + onlineDataLength);
-
     auto userProfileJsonPath =
         StorageManager::GetInstance().GetUserProfileJsonPath();
 
@@ -162,15 +201,33 @@ UpdateStatus UpdateContentWithOnlineData(PCSTR onlineData,
 
     bool updatedData = false;
 
+    auto& mods = userProfileJson["mods"];
+    if (!mods.is_object()) {
+        mods = json::object();
+        updatedData = true;
+    }
+
+    // Only the versions of installed mods are collected from the online data.
+    std::unordered_set<std::string> modIds;
+    for (const auto& [key, value] : mods.items()) {
+        modIds.insert(key);
+    }
+
+    auto onlineVersions = OnlineData::Parse(
+        std::string_view(onlineData, onlineDataLength), modIds);
+
+    // A delta only has what changed since the last check.
+    if (!delta && !onlineVersions.appVersion) {
+        throw std::runtime_error("Online data has no app version");
+    }
+
+    if (!delta && !onlineVersions.hasMods) {
+        throw std::runtime_error("Online data has no mods");
+    }
+
     // Update app latest version if necessary.
-    {
-        std::string onlineLatestVersion;
-        auto& onlineApp = onlineDataJson.at("app");
-        if (onlineApp.is_string()) {
-            onlineLatestVersion = onlineApp.get<std::string>();
-        } else {
-            onlineLatestVersion = onlineApp.at("version").get<std::string>();
-        }
+    if (onlineVersions.appVersion) {
+        const std::string& onlineLatestVersion = *onlineVersions.appVersion;
 
         auto& app = userProfileJson["app"];
         if (!app.is_object()) {
@@ -201,32 +258,14 @@ UpdateStatus UpdateContentWithOnlineData(PCSTR onlineData,
     }
 
     // Update mods latest version if necessary.
-    auto& mods = userProfileJson["mods"];
-    if (!mods.is_object()) {
-        mods = json::object();
-        updatedData = true;
-    }
-
-    for (auto& [key, value] : onlineDataJson.at("mods").items()) {
-        auto it = mods.find(key);
-        if (it == mods.end()) {
-            continue;
-        }
-
-        auto& mod = *it;
+    for (const auto& [key, onlineLatestModVersion] :
+         onlineVersions.modVersions) {
+        auto& mod = mods[key];
         if (!mod.is_object()) {
             mod = json::object();
             updatedData = true;
         }
 
-        std::string onlineLatestModVersion;
-        if (value.is_string()) {
-            onlineLatestModVersion = value.get<std::string>();
-        } else {
-            onlineLatestModVersion =
-                value.at("metadata").at("version").get<std::string>();
-        }
-
         auto& latestModVersion = mod["latestVersion"];
         std::string prevLatestModVersion =
             latestModVersion.is_string() ? latestModVersion.get<std::string>()
@@ -260,48 +299,19 @@ UpdateStatus UpdateContentWithOnlineData(PCSTR onlineData,
         }
     }
 
+    // The updates which the delta didn't mention are still available.
+    if (delta) {
+        auto storedUpdateStatus = GetStoredUpdateStatus(userProfileJson);
+        updateStatus.appUpdateAvailable = storedUpdateStatus.appUpdateAvailable;
+        updateStatus.modUpdatesAvailable =
+            storedUpdateStatus.modUpdatesAvailable;
+    }
+
     return updateStatus;
 }
 
 UpdateStatus GetUpdateStatus() {
-    UpdateStatus updateStatus{};
-
-    const json userProfileJson = GetLocalUpdatedContent();
-
-    // Check app update.
-    {
-        auto app = userProfileJson.find("app");
-        if (app != userProfileJson.end() && app->is_object()) {
-            auto version = app->find("version");
-            auto latestVersion = app->find("latestVersion");
-            if (version != app->end() && latestVersion != app->end() &&
-                version->is_string() && latestVersion->is_string() &&
-                *latestVersion != "" &&
-                version_less_than(version->get<std::string>(),
-                                  latestVersion->get<std::string>())) {
-                updateStatus.appUpdateAvailable = true;
-            }
-        }
-    }
-
-    // Check mod updates.
-    auto mods = userProfileJson.find("mods");
-    if (mods != userProfileJson.end() && mods->is_object()) {
-        for (auto& [key, mod] : mods->items()) {
-            if (mod.is_object()) {
-                auto modVersion = mod.find("version");
-                auto latestModVersion = mod.find("latestVersion");
-                if (modVersion != mod.end() && latestModVersion != mod.end() &&
-                    modVersion->is_string() && latestModVersion->is_string() &&
-                    *latestModVersion != "" &&
-                    *modVersion != *latestModVersion) {
-                    updateStatus.modUpdatesAvailable++;
-                }
-            }
-        }
-    }
-
-    return updateStatus;
+    return GetStoredUpdateStatus(GetLocalUpdatedContent());
 }
 
 }  // namespace UserProfile
@@ -9,8 +9,12 @@ struct UpdateStatus {
 };
 
 std::string GetLocalUpdatedContentAsString();
+
+// If delta is set, the online data only has the versions which changed since
+// the last update, see UpdateChecker.
 UpdateStatus UpdateContentWithOnlineData(PCSTR onlineData,
-                                         size_t onlineDataLength);
+                                         size_t onlineDataLength,
+                                         bool delta);
 UpdateStatus GetUpdateStatus();
 
 }  // namespace UserProfile
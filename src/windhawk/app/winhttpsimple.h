@@ -210,6 +210,11 @@ public:
 		return m_downloadRequest.AddHeaders(pwszHeaders, dwHeadersLength, dwModifiers);
 	}
 
+	HRESULT SetOption(DWORD dwOption, LPVOID lpBuffer, DWORD dwBufferLength)
+	{
+		return m_downloadRequest.SetOption(dwOption, lpBuffer, dwBufferLength);
+	}
+
 	HRESULT SendRequest(std::function<void()> doneCallback)
 	{
 		void* lpOptional = NULL;
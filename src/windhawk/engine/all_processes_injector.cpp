@@ -215,6 +215,10 @@ AllProcessesInjector::AllProcessesInjector() {
     m_appPrivateNamespace =
         SessionPrivateNamespace::Create(GetCurrentProcessId());
 
+    m_modStatusTable.emplace();
+    m_sessionLogRing.emplace();
+    m_startupProfileTable.emplace();
+
     auto settings = StorageManager::GetInstance().GetAppConfig(L"Settings");
     m_includePattern = settings->GetString(L"Include").value_or(L"");
     m_excludePattern = settings->GetString(L"Exclude").value_or(L"");
@@ -244,9 +248,19 @@ AllProcessesInjector::AllProcessesInjector() {
 
         m_excludePattern += ProcessLists::kGames;
     }
+
+    try {
+        m_modImagePreloader.emplace();
+    } catch (const std::exception& e) {
+        LOG(L"ModImagePreloader constructor failed: %S", e.what());
+    }
 }
 
 int AllProcessesInjector::InjectIntoNewProcesses() noexcept {
+    if (m_modImagePreloader) {
+        m_modImagePreloader->RefreshIfChanged();
+    }
+
     int count = 0;
 
     while (true) {
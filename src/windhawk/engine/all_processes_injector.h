@@ -1,5 +1,10 @@
 #pragma once
 
+#include "mod_image_preloader.h"
+#include "mod_status.h"
+#include "session_log.h"
+#include "startup_profile.h"
+
 class AllProcessesInjector {
    public:
     AllProcessesInjector();
@@ -31,6 +36,10 @@ class AllProcessesInjector {
     DWORD64 m_pRtlUserThreadStart = 0;
     DWORD64 m_pRtlUserThreadStart_x64OnArm64 = 0;
     wil::unique_private_namespace_destroy m_appPrivateNamespace;
+    std::optional<ModStatus::SessionTable> m_modStatusTable;
+    std::optional<SessionLog::SessionRing> m_sessionLogRing;
+    std::optional<StartupProfile::SessionTable> m_startupProfileTable;
+    std::optional<ModImagePreloader> m_modImagePreloader;
     std::wstring m_includePattern;
     std::wstring m_excludePattern;
     std::wstring m_threadAttachExemptPattern;
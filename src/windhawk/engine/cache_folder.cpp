@@ -0,0 +1,74 @@
+#include "stdafx.h"
+
+#include "cache_folder.h"
+
+namespace CacheFolder {
+
+void Touch(const std::filesystem::path& path) noexcept {
+    std::error_code ec;
+    std::filesystem::last_write_time(
+        path, std::filesystem::file_time_type::clock::now(), ec);
+}
+
+void Trim(const std::filesystem::path& folder,
+          std::wstring_view extension,
+          size_t maxFileCount,
+          uintmax_t maxTotalSize) noexcept {
+    struct File {
+        std::filesystem::path path;
+        std::filesystem::file_time_type lastWriteTime;
+        uintmax_t size;
+    };
+
+    try {
+        std::vector<File> files;
+        uintmax_t totalSize = 0;
+
+        std::error_code ec;
+        for (const auto& entry :
+             std::filesystem::directory_iterator(folder, ec)) {
+            if (!entry.is_regular_file(ec) ||
+                entry.path().extension() != extension) {
+                continue;
+            }
+
+            auto lastWriteTime = entry.last_write_time(ec);
+            if (ec) {
+                continue;
+            }
+
+            auto size = entry.file_size(ec);
+            if (ec) {
+                continue;
+            }
+
+            files.push_back({entry.path(), lastWriteTime, size});
+            totalSize += size;
+        }
+
+        if (files.size() <= maxFileCount && totalSize <= maxTotalSize) {
+            return;
+        }
+
+        std::sort(files.begin(), files.end(),
+                  [](const File& a, const File& b) {
+                      return a.lastWriteTime < b.lastWriteTime;
+                  });
+
+        size_t fileCount = files.size();
+        for (const auto& file : files) {
+            if (fileCount <= maxFileCount && totalSize <= maxTotalSize) {
+                break;
+            }
+
+            if (std::filesystem::remove(file.path, ec)) {
+                fileCount--;
+                totalSize -= file.size;
+            }
+        }
+    } catch (const std::exception&) {
+        // Out of memory, the folder is trimmed next time.
+    }
+}
+
+}  // namespace CacheFolder
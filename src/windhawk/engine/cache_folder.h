@@ -0,0 +1,21 @@
+#pragma once
+
+// Size limits of the folders in which the engine caches data for all
+// processes, such as call indexes. The last write time of a file is its last
+// use, so that the least recently used files are deleted first. Only depends
+// on the standard library.
+namespace CacheFolder {
+
+// Marks a cache file as used now. Errors are ignored.
+void Touch(const std::filesystem::path& path) noexcept;
+
+// Deletes the least recently used files with the given extension, until at
+// most maxFileCount files and maxTotalSize bytes are left. Files which can't
+// be deleted, and files with other extensions, such as the temporary files of
+// other processes, are left as is. Errors are ignored.
+void Trim(const std::filesystem::path& folder,
+          std::wstring_view extension,
+          size_t maxFileCount,
+          uintmax_t maxTotalSize) noexcept;
+
+}  // namespace CacheFolder
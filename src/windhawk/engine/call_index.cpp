@@ -0,0 +1,268 @@
+#include "stdafx.h"
+
+#include "call_index.h"
+
+// The index itself, which only depends on the standard library and on the
+// disassembler. The disk cache is in call_index_cache.cpp.
+
+namespace {
+
+constexpr DWORD kFileMagic = 'XIHW';
+constexpr DWORD kFileVersion = 1;
+
+struct FileHeader {
+    DWORD magic;
+    DWORD version;
+    DWORD targetCount;
+    DWORD callerCount;
+    // Followed by DWORD targets[targetCount], offsets[targetCount + 1] and
+    // callers[callerCount].
+};
+
+struct CallEdge {
+    DWORD target;
+    DWORD caller;
+};
+
+#if defined(_M_IX86) || defined(_M_X64)
+void CollectX86SectionCalls(const BYTE* moduleBase,
+                            DWORD imageSize,
+                            const IMAGE_SECTION_HEADER& section,
+                            bool is64Bit,
+                            std::vector<CallEdge>& edges) {
+    ZydisDecoder decoder;
+    if (is64Bit) {
+        ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LONG_64,
+                         ZYDIS_STACK_WIDTH_64);
+    } else {
+        ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LEGACY_32,
+                         ZYDIS_STACK_WIDTH_32);
+    }
+    ZydisDecoderEnableMode(&decoder, ZYDIS_DECODER_MODE_MINIMAL, ZYAN_TRUE);
+
+    DWORD sectionSize = section.Misc.VirtualSize ? section.Misc.VirtualSize
+                                                 : section.SizeOfRawData;
+    const BYTE* start = moduleBase + section.VirtualAddress;
+    const BYTE* end = start + sectionSize;
+
+    // A linear sweep, which resynchronizes after data and padding within a
+    // few instructions. Targets are computed from RVAs, since the code of
+    // another architecture isn't necessarily mapped at its image base.
+    ZydisDecodedInstruction instruction;
+    for (const BYTE* p = start; p < end;) {
+        if (!ZYAN_SUCCESS(ZydisDecoderDecodeInstruction(
+                &decoder, nullptr, p, end - p, &instruction))) {
+            p++;
+            continue;
+        }
+
+        const auto& imm = instruction.raw.imm[0];
+        if (imm.is_relative && instruction.operand_width != 16 &&
+            (instruction.mnemonic == ZYDIS_MNEMONIC_CALL ||
+             (instruction.mnemonic == ZYDIS_MNEMONIC_JMP && imm.size == 32))) {
+            DWORD callerRva = static_cast<DWORD>(p - moduleBase);
+            INT64 targetRva = static_cast<INT64>(callerRva) +
+                              instruction.length + imm.value.s;
+            if (!is64Bit) {
+                // Relative targets wrap around in 32-bit code.
+                targetRva = static_cast<INT32>(targetRva);
+            }
+
+            if (targetRva >= 0 && targetRva < imageSize) {
+                edges.push_back({static_cast<DWORD>(targetRva), callerRva});
+            }
+        }
+
+        p += instruction.length;
+    }
+}
+#endif  // defined(_M_IX86) || defined(_M_X64)
+
+void CollectArm64SectionCalls(const BYTE* moduleBase,
+                              DWORD imageSize,
+                              const IMAGE_SECTION_HEADER& section,
+                              std::vector<CallEdge>& edges) {
+    DWORD sectionSize = section.Misc.VirtualSize ? section.Misc.VirtualSize
+                                                 : section.SizeOfRawData;
+    const DWORD* start =
+        reinterpret_cast<const DWORD*>(moduleBase + section.VirtualAddress);
+    const DWORD* end = start + sectionSize / sizeof(DWORD);
+
+    // Instructions are fixed-size, so B and BL can be matched by their
+    // encoding directly: a 6-bit opcode and a 26-bit signed word offset.
+    for (const DWORD* p = start; p < end; p++) {
+        DWORD instruction = *p;
+        DWORD opcode = instruction & 0xFC000000;
+        if (opcode != 0x94000000 /* BL */ && opcode != 0x14000000 /* B */) {
+            continue;
+        }
+
+        INT64 offset = static_cast<INT32>(instruction << 6) >> 4;
+        DWORD callerRva = static_cast<DWORD>(
+            reinterpret_cast<const BYTE*>(p) - moduleBase);
+        INT64 targetRva = static_cast<INT64>(callerRva) + offset;
+        if (targetRva >= 0 && targetRva < imageSize) {
+            edges.push_back({static_cast<DWORD>(targetRva), callerRva});
+        }
+    }
+}
+
+}  // namespace
+
+// static
+std::unique_ptr<CallIndex> CallIndex::Build(const BYTE* imageBase,
+                                            Architecture architecture) {
+    auto* dosHeader = reinterpret_cast<const IMAGE_DOS_HEADER*>(imageBase);
+    auto* ntHeader = reinterpret_cast<const IMAGE_NT_HEADERS*>(
+        imageBase + dosHeader->e_lfanew);
+    DWORD imageSize = ntHeader->OptionalHeader.SizeOfImage;
+
+    std::vector<CallEdge> edges;
+
+    auto* section = IMAGE_FIRST_SECTION(ntHeader);
+    for (WORD i = 0; i < ntHeader->FileHeader.NumberOfSections;
+         i++, section++) {
+        if (!(section->Characteristics & IMAGE_SCN_MEM_EXECUTE)) {
+            continue;
+        }
+
+        switch (architecture) {
+#if defined(_M_IX86) || defined(_M_X64)
+            case Architecture::kX86:
+            case Architecture::kX64:
+                CollectX86SectionCalls(imageBase, imageSize, *section,
+                                       architecture == Architecture::kX64,
+                                       edges);
+                break;
+#endif  // defined(_M_IX86) || defined(_M_X64)
+
+            case Architecture::kArm64:
+                CollectArm64SectionCalls(imageBase, imageSize, *section,
+                                         edges);
+                break;
+
+            default:
+                throw std::logic_error("Unsupported architecture");
+        }
+    }
+
+    std::sort(edges.begin(), edges.end(), [](const auto& a, const auto& b) {
+        return a.target != b.target ? a.target < b.target : a.caller < b.caller;
+    });
+
+    std::unique_ptr<CallIndex> index(new CallIndex());
+    index->m_callers.reserve(edges.size());
+
+    for (const auto& edge : edges) {
+        if (index->m_targets.empty() || index->m_targets.back() != edge.target) {
+            index->m_targets.push_back(edge.target);
+            index->m_offsets.push_back(
+                static_cast<DWORD>(index->m_callers.size()));
+        }
+
+        index->m_callers.push_back(edge.caller);
+    }
+
+    index->m_offsets.push_back(static_cast<DWORD>(index->m_callers.size()));
+
+    index->UpdateMemoryUsage();
+    return index;
+}
+
+// static
+std::unique_ptr<CallIndex> CallIndex::Load(std::span<const BYTE> data,
+                                           DWORD imageSize) {
+    if (data.size() < sizeof(FileHeader)) {
+        return nullptr;
+    }
+
+    FileHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+
+    ULONGLONG expectedSize =
+        sizeof(FileHeader) +
+        (static_cast<ULONGLONG>(header.targetCount) * 2 + 1 +
+         header.callerCount) *
+            sizeof(DWORD);
+    if (header.magic != kFileMagic || header.version != kFileVersion ||
+        expectedSize != data.size()) {
+        return nullptr;
+    }
+
+    std::unique_ptr<CallIndex> index(new CallIndex());
+
+    const BYTE* p = data.data() + sizeof(FileHeader);
+    auto readArray = [&p](std::vector<DWORD>& array, size_t count) {
+        array.resize(count);
+        memcpy(array.data(), p, count * sizeof(DWORD));
+        p += count * sizeof(DWORD);
+    };
+
+    readArray(index->m_targets, header.targetCount);
+    readArray(index->m_offsets, header.targetCount + 1);
+    readArray(index->m_callers, header.callerCount);
+
+    // The data is written by other processes, validate it to make sure that
+    // queries stay in bounds.
+    const auto& targets = index->m_targets;
+    const auto& offsets = index->m_offsets;
+    const auto& callers = index->m_callers;
+    auto inImage = [imageSize](DWORD rva) { return rva < imageSize; };
+    bool valid =
+        offsets.front() == 0 && offsets.back() == header.callerCount &&
+        std::is_sorted(offsets.begin(), offsets.end()) &&
+        std::adjacent_find(targets.begin(), targets.end(),
+                           std::greater_equal<DWORD>()) == targets.end() &&
+        std::all_of(targets.begin(), targets.end(), inImage) &&
+        std::all_of(callers.begin(), callers.end(), inImage);
+    if (!valid) {
+        return nullptr;
+    }
+
+    index->UpdateMemoryUsage();
+    return index;
+}
+
+std::vector<BYTE> CallIndex::Save() const {
+    FileHeader header{
+        .magic = kFileMagic,
+        .version = kFileVersion,
+        .targetCount = static_cast<DWORD>(m_targets.size()),
+        .callerCount = static_cast<DWORD>(m_callers.size()),
+    };
+
+    std::vector<BYTE> data(sizeof(header) +
+                           (m_targets.size() + m_offsets.size() +
+                            m_callers.size()) *
+                               sizeof(DWORD));
+
+    BYTE* p = data.data();
+    auto write = [&p](const void* buffer, size_t size) {
+        memcpy(p, buffer, size);
+        p += size;
+    };
+
+    write(&header, sizeof(header));
+    write(m_targets.data(), m_targets.size() * sizeof(DWORD));
+    write(m_offsets.data(), m_offsets.size() * sizeof(DWORD));
+    write(m_callers.data(), m_callers.size() * sizeof(DWORD));
+
+    return data;
+}
+
+std::span<const DWORD> CallIndex::FindCallers(DWORD targetRva) const {
+    auto it = std::lower_bound(m_targets.begin(), m_targets.end(), targetRva);
+    if (it == m_targets.end() || *it != targetRva) {
+        return {};
+    }
+
+    size_t i = it - m_targets.begin();
+    return std::span(m_callers).subspan(m_offsets[i],
+                                        m_offsets[i + 1] - m_offsets[i]);
+}
+
+void CallIndex::UpdateMemoryUsage() {
+    m_memoryUsage.Set(
+        (m_targets.capacity() + m_offsets.capacity() + m_callers.capacity()) *
+        sizeof(DWORD));
+}
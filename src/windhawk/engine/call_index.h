@@ -0,0 +1,57 @@
+#pragma once
+
+#include "memory_usage.h"
+
+// An index of the direct calls of a module, from each call target to the
+// instructions which call it. The direct jumps with a 32-bit offset are
+// included too, since they're commonly used for tail calls. Targets and
+// callers are stored as RVAs in a compressed sparse row layout: sorted targets,
+// and for each target, a range in a shared array of callers.
+class CallIndex {
+   public:
+    // The instruction set of the indexed code. The engine only indexes code of
+    // its own architecture, the others are used by tests.
+    enum class Architecture {
+        kX86,
+        kX64,
+        kArm64,
+    };
+
+    // Returns the index of the module, which is loaded from the disk cache, or
+    // built if it's not cached. onBuild is called before building. Indexes are
+    // kept for the lifetime of the engine, by cache key. Indexes of different
+    // modules can be built concurrently.
+    static const CallIndex& Get(HMODULE module,
+                                const std::wstring& cacheKey,
+                                const std::function<void()>& onBuild);
+
+    // Builds the index of the executable sections of an image which is mapped
+    // at imageBase. The x86 and x64 instruction sets are only supported by
+    // the x86 and x64 builds, which include their decoder.
+    static std::unique_ptr<CallIndex> Build(const BYTE* imageBase,
+                                            Architecture architecture);
+
+    // Reads an index in the format of the disk cache. Returns nullptr if the
+    // data isn't a valid index of an image of imageSize bytes.
+    static std::unique_ptr<CallIndex> Load(std::span<const BYTE> data,
+                                           DWORD imageSize);
+
+    // Returns the index in the format of the disk cache.
+    std::vector<BYTE> Save() const;
+
+    // Returns the RVAs of the instructions which call or jump to the target,
+    // in ascending order.
+    std::span<const DWORD> FindCallers(DWORD targetRva) const;
+
+   private:
+    CallIndex() = default;
+
+    void UpdateMemoryUsage();
+
+    std::vector<DWORD> m_targets;
+    // m_targets.size() + 1 offsets, the callers of m_targets[i] are in the
+    // [m_offsets[i], m_offsets[i + 1]) range of m_callers.
+    std::vector<DWORD> m_offsets;
+    std::vector<DWORD> m_callers;
+    MemoryUsage::TrackedSize m_memoryUsage{MemoryUsage::Subsystem::kSymbols};
+};
@@ -0,0 +1,157 @@
+#include "stdafx.h"
+
+#include "cache_folder.h"
+#include "call_index.h"
+#include "logger.h"
+#include "storage_manager.h"
+#include "var_init_once.h"
+
+// The disk cache of call indexes, which is shared by all processes, and the
+// indexes which are loaded in the current process.
+
+namespace {
+
+constexpr WCHAR kFileExtension[] = L".bin";
+
+// Cache files are rejected above this size, an index is expected to be a few
+// bytes per call instruction.
+constexpr ULONGLONG kMaxFileSize = 256 * 1024 * 1024;
+
+// The least recently used files are deleted above these limits. An index of a
+// large system module takes a few megabytes.
+constexpr size_t kMaxCachedFileCount = 100;
+constexpr uintmax_t kMaxCacheSize = 256 * 1024 * 1024;
+
+struct LoadedIndex {
+    // Held while the index is loaded or built, so that it's only built once
+    // per process.
+    std::mutex mutex;
+    std::unique_ptr<CallIndex> index;
+};
+
+struct LoadedIndexes {
+    // Only held while an entry is looked up, so that indexes of different
+    // modules are built concurrently.
+    std::mutex mutex;
+    std::unordered_map<std::wstring, std::unique_ptr<LoadedIndex>> indexes;
+};
+
+#if defined(_M_IX86)
+constexpr auto kArchitecture = CallIndex::Architecture::kX86;
+#elif defined(_M_X64)
+constexpr auto kArchitecture = CallIndex::Architecture::kX64;
+#elif defined(_M_ARM64)
+constexpr auto kArchitecture = CallIndex::Architecture::kArm64;
+#else
+#error "Unsupported architecture"
+#endif
+
+std::unique_ptr<CallIndex> LoadFromFile(const std::filesystem::path& path,
+                                        DWORD imageSize) {
+    wil::unique_hfile file(CreateFile(path.c_str(), GENERIC_READ,
+                                      FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                      nullptr, OPEN_EXISTING, 0, nullptr));
+    if (!file) {
+        return nullptr;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file.get(), &fileSize) ||
+        static_cast<ULONGLONG>(fileSize.QuadPart) > kMaxFileSize) {
+        return nullptr;
+    }
+
+    std::vector<BYTE> data(static_cast<size_t>(fileSize.QuadPart));
+    DWORD bytesRead;
+    if (!ReadFile(file.get(), data.data(), static_cast<DWORD>(data.size()),
+                  &bytesRead, nullptr) ||
+        bytesRead != data.size()) {
+        return nullptr;
+    }
+
+    return CallIndex::Load(data, imageSize);
+}
+
+void SaveToFile(const std::filesystem::path& path, const CallIndex& index) {
+    std::filesystem::create_directories(path.parent_path());
+
+    auto data = index.Save();
+
+    // Written to a temporary file first, so that other processes never read a
+    // partially written index.
+    auto tempPath = path;
+    tempPath += L"." + std::to_wstring(GetCurrentProcessId()) + L".tmp";
+
+    {
+        wil::unique_hfile file(CreateFile(tempPath.c_str(), GENERIC_WRITE, 0,
+                                          nullptr, CREATE_ALWAYS, 0, nullptr));
+        THROW_LAST_ERROR_IF(!file);
+
+        DWORD bytesWritten;
+        THROW_IF_WIN32_BOOL_FALSE(WriteFile(file.get(), data.data(),
+                                            static_cast<DWORD>(data.size()),
+                                            &bytesWritten, nullptr));
+    }
+
+    if (!MoveFileEx(tempPath.c_str(), path.c_str(),
+                    MOVEFILE_REPLACE_EXISTING)) {
+        DWORD error = GetLastError();
+        DeleteFile(tempPath.c_str());
+        THROW_WIN32(error);
+    }
+}
+
+}  // namespace
+
+// static
+const CallIndex& CallIndex::Get(HMODULE module,
+                                const std::wstring& cacheKey,
+                                const std::function<void()>& onBuild) {
+    STATIC_INIT_ONCE(LoadedIndexes, loadedIndexes);
+
+    LoadedIndex* loadedIndex;
+    {
+        std::lock_guard<std::mutex> guard(loadedIndexes->mutex);
+        auto& entry = loadedIndexes->indexes[cacheKey];
+        if (!entry) {
+            entry = std::make_unique<LoadedIndex>();
+        }
+
+        loadedIndex = entry.get();
+    }
+
+    std::lock_guard<std::mutex> guard(loadedIndex->mutex);
+
+    if (loadedIndex->index) {
+        return *loadedIndex->index;
+    }
+
+    auto* moduleBase = reinterpret_cast<const BYTE*>(module);
+    auto* dosHeader = reinterpret_cast<const IMAGE_DOS_HEADER*>(module);
+    auto* ntHeader = reinterpret_cast<const IMAGE_NT_HEADERS*>(
+        moduleBase + dosHeader->e_lfanew);
+    DWORD imageSize = ntHeader->OptionalHeader.SizeOfImage;
+
+    auto folder = StorageManager::GetInstance().GetCallIndexPath();
+    auto path = folder / (cacheKey + kFileExtension);
+
+    auto index = LoadFromFile(path, imageSize);
+    if (index) {
+        CacheFolder::Touch(path);
+    } else {
+        onBuild();
+        index = Build(moduleBase, kArchitecture);
+
+        try {
+            SaveToFile(path, *index);
+        } catch (const std::exception& e) {
+            LOG(L"Saving call index failed: %S", e.what());
+        }
+
+        CacheFolder::Trim(folder, kFileExtension, kMaxCachedFileCount,
+                          kMaxCacheSize);
+    }
+
+    loadedIndex->index = std::move(index);
+    return *loadedIndex->index;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+// The code ranges of hybrid images: CHPE images, in which x86 code is mixed
+// with ARM64 code, and ARM64EC and ARM64X images. Each range tells the
+// architecture of the code in it.
+namespace ChpeRanges {
+
+// https://ntdoc.m417z.com/image_chpe_range_entry
+typedef struct _IMAGE_CHPE_RANGE_ENTRY {
+    union {
+        ULONG StartOffset;
+        struct {
+            ULONG NativeCode : 1;
+            ULONG AddressBits : 31;
+        } DUMMYSTRUCTNAME;
+    } DUMMYUNIONNAME;
+
+    ULONG Length;
+} IMAGE_CHPE_RANGE_ENTRY, *PIMAGE_CHPE_RANGE_ENTRY;
+
+// Returns std::nullopt if the image isn't a hybrid image. The returned ranges
+// point into the image.
+template <typename IMAGE_NT_HEADERS_T, typename IMAGE_LOAD_CONFIG_DIRECTORY_T>
+std::optional<std::span<const IMAGE_CHPE_RANGE_ENTRY>> GetRanges(
+    const IMAGE_DOS_HEADER* dosHeader,
+    const IMAGE_NT_HEADERS_T* ntHeader) {
+    auto* opt = &ntHeader->OptionalHeader;
+
+    if (opt->NumberOfRvaAndSizes <= IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG ||
+        !opt->DataDirectory[IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG].VirtualAddress) {
+        return std::nullopt;
+    }
+
+    DWORD directorySize =
+        opt->DataDirectory[IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG].Size;
+
+    auto* cfg =
+        (const IMAGE_LOAD_CONFIG_DIRECTORY_T*)((const char*)dosHeader +
+                                               opt->DataDirectory
+                                                   [IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG]
+                                                       .VirtualAddress);
+
+    constexpr DWORD kMinSize =
+        offsetof(IMAGE_LOAD_CONFIG_DIRECTORY_T, CHPEMetadataPointer) +
+        sizeof(IMAGE_LOAD_CONFIG_DIRECTORY_T::CHPEMetadataPointer);
+
+    if (directorySize < kMinSize || cfg->Size < kMinSize) {
+        return std::nullopt;
+    }
+
+    if (!cfg->CHPEMetadataPointer) {
+        return std::nullopt;
+    }
+
+    // Either IMAGE_CHPE_METADATA_X86 or IMAGE_ARM64EC_METADATA.
+    const void* metadata =
+        (const char*)dosHeader + cfg->CHPEMetadataPointer - opt->ImageBase;
+
+    ULONG codeMapRva = ((const ULONG*)metadata)[1];
+    ULONG codeMapCount = ((const ULONG*)metadata)[2];
+
+    auto* codeMap =
+        (const IMAGE_CHPE_RANGE_ENTRY*)((const char*)dosHeader + codeMapRva);
+
+    return std::span(codeMap, codeMapCount);
+}
+
+// Returns the range which contains the RVA, or nullptr. The low bits of the
+// start offset hold the code type: one bit in 32-bit images, two bits in
+// 64-bit images.
+inline const IMAGE_CHPE_RANGE_ENTRY* FindRange(
+    std::span<const IMAGE_CHPE_RANGE_ENTRY> ranges,
+    ULONG rva,
+    bool is32Bit) {
+    for (const auto& range : ranges) {
+        ULONG start =
+            is32Bit ? (range.StartOffset & ~1) : (range.StartOffset & ~3);
+        if (rva >= start && rva < start + range.Length) {
+            return &range;
+        }
+    }
+
+    return nullptr;
+}
+
+}  // namespace ChpeRanges
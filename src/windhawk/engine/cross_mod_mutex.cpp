@@ -0,0 +1,51 @@
+#include "stdafx.h"
+
+#include "cross_mod_mutex.h"
+#include "customization_session.h"
+#include "functions.h"
+#include "logger.h"
+#include "session_private_namespace.h"
+
+CrossModMutex::CrossModMutex(PCWSTR mutexIdentifier) {
+    try {
+        m_mutex.reset(CreateSessionMutex(mutexIdentifier, FALSE));
+    } catch (const std::exception& e) {
+        LOG(L"%S", e.what());
+    }
+}
+
+bool CrossModMutex::Acquire(DWORD milliseconds) {
+    m_mutexLock = m_mutex.acquire(nullptr, milliseconds);
+    return !!m_mutexLock;
+}
+
+HANDLE CrossModMutex::CreateSessionMutex(PCWSTR mutexIdentifier,
+                                         BOOL initialOwner) {
+    DWORD dwSessionManagerProcessId =
+        CustomizationSession::GetSessionManagerProcessId();
+
+    WCHAR sessionPrivateNamespaceName
+        [SessionPrivateNamespace::kPrivateNamespaceMaxLen + 1];
+    SessionPrivateNamespace::MakeName(sessionPrivateNamespaceName,
+                                      dwSessionManagerProcessId);
+
+    std::wstring mutexName = sessionPrivateNamespaceName;
+    mutexName += L'\\';
+    mutexName += mutexIdentifier;
+
+    wil::unique_hlocal secDesc;
+    THROW_IF_WIN32_BOOL_FALSE(
+        Functions::GetFullAccessSecurityDescriptor(&secDesc, nullptr));
+
+    SECURITY_ATTRIBUTES secAttr{
+        .nLength = sizeof(secAttr),
+        .lpSecurityDescriptor = secDesc.get(),
+        .bInheritHandle = FALSE,
+    };
+
+    wil::unique_mutex_nothrow mutex(
+        CreateMutex(&secAttr, initialOwner, mutexName.c_str()));
+    THROW_LAST_ERROR_IF_NULL(mutex);
+
+    return mutex.release();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// A named mutex in the private namespace of the customization session, which
+// is shared by the mods of all processes in the session. If the mutex can't be
+// created, the object evaluates to false and the error is logged.
+class CrossModMutex {
+   public:
+    CrossModMutex(PCWSTR mutexIdentifier);
+
+    operator bool() const { return !!m_mutex; }
+
+    bool Acquire(DWORD milliseconds = INFINITE);
+
+   private:
+    HANDLE CreateSessionMutex(PCWSTR mutexIdentifier, BOOL initialOwner);
+
+    wil::unique_mutex_nothrow m_mutex;
+    wil::mutex_release_scope_exit m_mutexLock;
+};
@@ -2,8 +2,12 @@
 
 #include "customization_session.h"
 #include "functions.h"
+#include "hook_engine.h"
 #include "logger.h"
+#include "memory_usage.h"
+#include "session_log.h"
 #include "session_private_namespace.h"
+#include "startup_profile.h"
 
 extern HINSTANCE g_hDllInst;
 
@@ -101,6 +105,25 @@ bool CurrentProcessHasMitigationPolicy() {
            policy.ProhibitDynamicCode;
 }
 
+bool CanWaitWithoutWaiterThreads() {
+    // Since Windows 8, thread pool waits are queued to the completion port of
+    // the pool. Before that, waits were handled by dedicated waiter threads,
+    // which would keep the last thread detection from ever completing.
+    GET_PROC_ADDRESS_ONCE(FARPROC, pNtAssociateWaitCompletionPacket,
+                          L"ntdll.dll", "NtAssociateWaitCompletionPacket");
+
+    return pNtAssociateWaitCompletionPacket != nullptr;
+}
+
+// The committed stack of the current thread, which is released when it exits,
+// along with the TEB and the kernel stack. The pages which were touched are
+// also part of the working set.
+size_t GetCurrentThreadCommittedStackSize() {
+    auto* tib = reinterpret_cast<NT_TIB*>(NtCurrentTeb());
+    return static_cast<BYTE*>(tib->StackBase) -
+           static_cast<BYTE*>(tib->StackLimit);
+}
+
 }  // namespace
 
 // static
@@ -180,24 +203,30 @@ CustomizationSession::CustomizationSession(
       m_scopedStaticSessionManagerProcess(std::move(sessionManagerProcess)),
       m_sessionMutex(std::move(sessionMutex)),
       m_privateNamespace(OpenSessionPrivateNamespace()),
-#ifdef WH_HOOKING_ENGINE_MINHOOK
       // If runningFromAPC, no other threads should be running, skip thread
       // freeze.
-      m_minHookScopeInit(runningFromAPC ? MH_FREEZE_METHOD_NONE_UNSAFE
-                                        : MH_FREEZE_METHOD_FAST_UNDOCUMENTED),
-#endif  // WH_HOOKING_ENGINE_MINHOOK
-      m_modsManager(),
-      m_newProcessInjector(m_scopedStaticSessionManagerProcess)
-#ifdef WH_HOOKING_ENGINE_MINHOOK
-      ,
-      m_minHookScopeApply()
-#endif  // WH_HOOKING_ENGINE_MINHOOK
-{
+      m_hookEngineScopeInit(/*freezeThreads=*/!runningFromAPC),
+      // Loading mods on other threads requires thread creation, which is
+      // unsafe if running from APC, and would invoke the TLS and DllMain
+      // callbacks which are avoided if threadAttachExempt is set.
+      m_modsManager(/*concurrentInit=*/!runningFromAPC && !threadAttachExempt),
+      m_newProcessInjector(m_scopedStaticSessionManagerProcess),
+      m_hookEngineScopeApply() {
+    try {
+        Logger::GetInstance().SetSessionLog(
+            std::make_unique<SessionLog::Writer>(GetSessionManagerProcessId()));
+    } catch (const std::exception& e) {
+        LOG(L"Failed to open the session log: %S", e.what());
+    }
+
     try {
         m_modsManager.AfterInit();
     } catch (const std::exception& e) {
         LOG(L"AfterInit failed: %S", e.what());
     }
+
+    StartupProfile::MarkPhaseEnd(StartupProfile::ProcessPhase::kAfterInit);
+    StartupProfile::PublishProcess();
 }
 
 CustomizationSession::~CustomizationSession() {
@@ -208,49 +237,39 @@ CustomizationSession::~CustomizationSession() {
     }
 }
 
-#ifdef WH_HOOKING_ENGINE_MINHOOK
-CustomizationSession::MinHookScopeInit::MinHookScopeInit(
-    MH_THREAD_FREEZE_METHOD freezeMethod) {
-    MH_STATUS status = MH_Initialize();
-    if (status != MH_OK) {
-        LOG(L"MH_Initialize failed with %d", status);
-        throw std::runtime_error("Failed to initialize MinHook");
+CustomizationSession::HookEngineScopeInit::HookEngineScopeInit(
+    bool freezeThreads) {
+    auto status = HookEngine::Initialize(freezeThreads);
+    if (status != HookEngine::kOk) {
+        LOG(L"HookEngine::Initialize failed with %d", status);
+        throw std::runtime_error("Failed to initialize the hooking engine");
     }
-
-    MH_SetThreadFreezeMethod(freezeMethod);
-
-#ifdef WH_HOOKING_ENGINE_MINHOOK_DETOURS
-    MH_SetBulkOperationMode(
-        /*continueOnError=*/TRUE, [](LPVOID pTarget, NTSTATUS detoursStatus) {
-            LOG(L"Hooking operation failed for %p with status 0x%08X", pTarget,
-                detoursStatus);
-        });
-#endif
 }
 
-CustomizationSession::MinHookScopeInit::~MinHookScopeInit() {
-    MH_STATUS status = MH_Uninitialize();
-    if (status != MH_OK) {
-        LOG(L"MH_Uninitialize failed with status %d", status);
+CustomizationSession::HookEngineScopeInit::~HookEngineScopeInit() {
+    auto status = HookEngine::Uninitialize();
+    if (status != HookEngine::kOk) {
+        LOG(L"HookEngine::Uninitialize failed with status %d", status);
     }
 }
 
-CustomizationSession::MinHookScopeApply::MinHookScopeApply() {
-    MH_STATUS status = MH_ApplyQueuedEx(MH_ALL_IDENTS);
-    if (status != MH_OK) {
-        LOG(L"MH_ApplyQueuedEx failed with %d", status);
+CustomizationSession::HookEngineScopeApply::HookEngineScopeApply() {
+    auto status = HookEngine::ApplyQueued(HookEngine::kAllOwners);
+    if (status != HookEngine::kOk) {
+        LOG(L"HookEngine::ApplyQueued failed with %d", status);
     }
 
-    MH_SetThreadFreezeMethod(MH_FREEZE_METHOD_FAST_UNDOCUMENTED);
+    HookEngine::SetFreezeThreads(true);
+
+    StartupProfile::MarkPhaseEnd(StartupProfile::ProcessPhase::kHooksApply);
 }
 
-CustomizationSession::MinHookScopeApply::~MinHookScopeApply() {
-    MH_STATUS status = MH_DisableHookEx(MH_ALL_IDENTS, MH_ALL_HOOKS);
-    if (status != MH_OK) {
-        LOG(L"MH_DisableHookEx failed with status %d", status);
+CustomizationSession::HookEngineScopeApply::~HookEngineScopeApply() {
+    auto status = HookEngine::DisableAllHooks();
+    if (status != HookEngine::kOk) {
+        LOG(L"HookEngine::DisableAllHooks failed with status %d", status);
     }
 }
-#endif  // WH_HOOKING_ENGINE_MINHOOK
 
 CustomizationSession::MainLoopRunner::MainLoopRunner() noexcept {
     try {
@@ -263,7 +282,10 @@ CustomizationSession::MainLoopRunner::MainLoopRunner() noexcept {
 CustomizationSession::MainLoopRunner::Result
 CustomizationSession::MainLoopRunner::Run(HANDLE sessionManagerProcess,
                                           DWORD* lastThreadExitCode) noexcept {
-    DWORD lastThreadExitCodeLocal = 0;
+    // Keep the exit code which was already observed, e.g. by the thread pool
+    // main loop, in case there are no threads left.
+    DWORD lastThreadExitCodeLocal =
+        lastThreadExitCode ? *lastThreadExitCode : 0;
 
     while (true) {
         wil::unique_handle firstThread;
@@ -371,6 +393,165 @@ bool CustomizationSession::MainLoopRunner::CanRunAcrossThreads() noexcept {
     return true;
 }
 
+HANDLE
+CustomizationSession::MainLoopRunner::GetModConfigChangeHandle() noexcept {
+    if (!m_modConfigChangeNotification) {
+        return nullptr;
+    }
+
+    return m_modConfigChangeNotification->GetHandle();
+}
+
+CustomizationSession::ThreadPoolMainLoop::ThreadPoolMainLoop(
+    CustomizationSession* session) noexcept
+    : m_session(session) {
+    InitializeThreadpoolEnvironment(&m_callbackEnvironment);
+}
+
+CustomizationSession::ThreadPoolMainLoop::~ThreadPoolMainLoop() {
+    Close(nullptr);
+    DestroyThreadpoolEnvironment(&m_callbackEnvironment);
+}
+
+bool CustomizationSession::ThreadPoolMainLoop::Start() noexcept {
+    m_pool = CreateThreadpool(nullptr);
+    if (!m_pool) {
+        LOG(L"CreateThreadpool failed: %u", GetLastError());
+        return false;
+    }
+
+    SetThreadpoolThreadMaximum(m_pool, 1);
+    SetThreadpoolCallbackPool(&m_callbackEnvironment, m_pool);
+
+    for (PTP_WAIT* wait : {&m_sessionManagerProcessWait, &m_firstThreadWait,
+                           &m_modConfigChangeWait}) {
+        *wait = CreateThreadpoolWait(WaitCallback, this,
+                                     &m_callbackEnvironment);
+        if (!*wait) {
+            LOG(L"CreateThreadpoolWait failed: %u", GetLastError());
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    if (!m_loop.Start()) {
+        // The process is exiting, let the regular main loop handle it.
+        return false;
+    }
+
+    // Bump the reference count of the module to ensure that the module will
+    // stay loaded as long as the waits are set. The reference is released by
+    // the thread which deletes the session.
+    HMODULE hDllInst;
+    GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                      reinterpret_cast<LPCWSTR>(g_hDllInst), &hDllInst);
+
+    SetThreadpoolWait(m_sessionManagerProcessWait,
+                      m_session->m_scopedStaticSessionManagerProcess,
+                      nullptr);
+
+    if (HANDLE modConfigChangeHandle =
+            m_session->m_mainLoopRunner->GetModConfigChangeHandle()) {
+        SetThreadpoolWait(m_modConfigChangeWait, modConfigChangeHandle,
+                          nullptr);
+    }
+
+    return true;
+}
+
+void CustomizationSession::ThreadPoolMainLoop::Close(
+    PTP_WAIT currentWait) noexcept {
+    for (PTP_WAIT* wait : {&m_sessionManagerProcessWait, &m_firstThreadWait,
+                           &m_modConfigChangeWait}) {
+        if (!*wait) {
+            continue;
+        }
+
+        SetThreadpoolWait(*wait, nullptr, nullptr);
+
+        // The pool has a single thread, so while running the callback of
+        // currentWait, the callbacks of the other waits can only be pending,
+        // and they're cancelled.
+        if (*wait != currentWait) {
+            WaitForThreadpoolWaitCallbacks(*wait, TRUE);
+        }
+
+        CloseThreadpoolWait(*wait);
+        *wait = nullptr;
+    }
+
+    if (m_pool) {
+        CloseThreadpool(m_pool);
+        m_pool = nullptr;
+    }
+}
+
+// static
+void CALLBACK CustomizationSession::ThreadPoolMainLoop::WaitCallback(
+    PTP_CALLBACK_INSTANCE instance,
+    PVOID context,
+    PTP_WAIT wait,
+    TP_WAIT_RESULT waitResult) {
+    auto* this_ = reinterpret_cast<ThreadPoolMainLoop*>(context);
+
+    PoolWaitLoop::Wait signaled;
+    if (wait == this_->m_firstThreadWait) {
+        signaled = PoolWaitLoop::Wait::kFirstThread;
+    } else if (wait == this_->m_modConfigChangeWait) {
+        signaled = PoolWaitLoop::Wait::kModConfigChange;
+    } else {
+        signaled = PoolWaitLoop::Wait::kSessionManagerProcess;
+    }
+
+    PoolWaitLoop::State state;
+    {
+        std::lock_guard<std::mutex> guard(this_->m_mutex);
+        state = this_->m_loop.OnSignaled(signaled);
+    }
+
+    if (state != PoolWaitLoop::State::kWaiting) {
+        VERBOSE(L"Exiting engine thread pool wait loop");
+
+        // Might delete this object.
+        this_->m_session->EndMainLoopOnThreadPool(
+            instance, wait, state == PoolWaitLoop::State::kModConfigChanged,
+            state == PoolWaitLoop::State::kNoThreadsLeft);
+    }
+}
+
+// Replaces the rescan of MainLoopRunner::Run: waits for the first alive thread
+// other than the current one. If the threads can't be enumerated, the process
+// is monitored without them.
+PoolWaitLoop::FirstThread
+CustomizationSession::ThreadPoolMainLoop::WaitForFirstThread() noexcept {
+    m_firstThread.reset();
+
+    auto maybeFirstThread =
+        GetFirstThreadOfCurrentProcess(THREAD_QUERY_LIMITED_INFORMATION);
+    if (!maybeFirstThread) {
+        return PoolWaitLoop::FirstThread::kUnknown;
+    }
+
+    if (!*maybeFirstThread) {
+        return PoolWaitLoop::FirstThread::kNoneLeft;
+    }
+
+    m_firstThread.reset(*maybeFirstThread);
+    SetThreadpoolWait(m_firstThreadWait, m_firstThread.get(), nullptr);
+    return PoolWaitLoop::FirstThread::kFound;
+}
+
+void CustomizationSession::ThreadPoolMainLoop::OnFirstThreadExited() noexcept {
+    GetExitCodeThread(m_firstThread.get(), &m_session->m_lastThreadExitCode);
+}
+
+bool CustomizationSession::ThreadPoolMainLoop::WaitForSessionManagerExit(
+    uint32_t timeoutMs) noexcept {
+    return WaitForSingleObject(m_session->m_scopedStaticSessionManagerProcess,
+                               timeoutMs) == WAIT_OBJECT_0;
+}
+
 // static
 std::optional<CustomizationSession>& CustomizationSession::GetInstance() {
     // Use NoDestructorIfTerminating not only for performance reasons, but also
@@ -387,6 +568,12 @@ std::optional<CustomizationSession>& CustomizationSession::GetInstance() {
 
 wil::unique_private_namespace_close
 CustomizationSession::OpenSessionPrivateNamespace() {
+    StartupProfile::MarkPhaseEnd(StartupProfile::ProcessPhase::kSessionStart);
+    auto markPhaseEnd = wil::scope_exit([] {
+        StartupProfile::MarkPhaseEnd(
+            StartupProfile::ProcessPhase::kPrivateNamespace);
+    });
+
     DWORD dwSessionManagerProcessId = GetSessionManagerProcessId();
     if (dwSessionManagerProcessId == GetCurrentProcessId()) {
         // In the session manager process, the session manager creates the
@@ -406,8 +593,13 @@ void CustomizationSession::StartInitialized(
 
     if (!runningFromAPC) {
         // No need to create a new thread, a dedicated thread was created for us
-        // before injection.
+        // before injection. If possible, let it exit and wait on the thread
+        // pool instead.
         m_mainLoopRunner.emplace();
+        if (StartMainLoopOnThreadPool()) {
+            return;
+        }
+
         RunMainLoop();
         DeleteThis();
         return;
@@ -492,15 +684,10 @@ void CustomizationSession::
                 this_->m_mainLoopRunner.emplace();
             }
 
-            if (CurrentProcessHasMitigationPolicy()) {
-                LOG(L"Process prohibits dynamic code, cannot reload mods "
-                    L"safely");
-            } else {
-                try {
-                    this_->m_modsManager.ReloadModsAndSettings();
-                } catch (const std::exception& e) {
-                    LOG(L"ReloadModsAndSettings failed: %S", e.what());
-                }
+            this_->ReloadModsAndSettings();
+
+            if (this_->StartMainLoopOnThreadPool()) {
+                FreeLibraryAndExitThread(g_hDllInst, 0);
             }
 
             this_->RunMainLoop();
@@ -540,6 +727,8 @@ void CustomizationSession::
 
 void CustomizationSession::RunMainLoop() noexcept {
     while (true) {
+        PublishMemoryUsage();
+
         auto result = m_mainLoopRunner->Run(m_scopedStaticSessionManagerProcess,
                                             &m_lastThreadExitCode);
         if (result != MainLoopRunner::Result::kReloadModsAndSettings) {
@@ -548,18 +737,141 @@ void CustomizationSession::RunMainLoop() noexcept {
 
         m_mainLoopRunner->ContinueMonitoring();
 
-        if (CurrentProcessHasMitigationPolicy()) {
-            LOG(L"Process prohibits dynamic code, cannot reload mods safely");
-        } else {
-            try {
-                m_modsManager.ReloadModsAndSettings();
-            } catch (const std::exception& e) {
-                LOG(L"ReloadModsAndSettings failed: %S", e.what());
+        ReloadModsAndSettings();
+    }
+
+    VERBOSE(L"Exiting engine thread wait loop");
+}
+
+bool CustomizationSession::StartMainLoopOnThreadPool() noexcept {
+    // A registry notification which isn't thread agnostic is removed when the
+    // thread which registered it exits, and pool threads exit when idle. Mods
+    // which aren't thread agnostic keep the current thread for their
+    // callbacks, see the thread contract in mods_api.h.
+    if (!m_mainLoopRunner->CanRunAcrossThreads() ||
+        !CanWaitWithoutWaiterThreads() ||
+        !m_modsManager.AreAllModsThreadAgnostic()) {
+        return false;
+    }
+
+    PublishMemoryUsage();
+
+    m_threadPoolMainLoop.emplace(this);
+    if (!m_threadPoolMainLoop->Start()) {
+        m_threadPoolMainLoop.reset();
+        return false;
+    }
+
+    // The current thread exits next, which is what idle processes save
+    // compared to MainLoopRunner::Run.
+    VERBOSE(L"Waiting on the thread pool, releasing %zu KB of thread stack",
+            GetCurrentThreadCommittedStackSize() / 1024);
+
+    return true;
+}
+
+void CustomizationSession::EndMainLoopOnThreadPool(
+    PTP_CALLBACK_INSTANCE instance,
+    PTP_WAIT wait,
+    bool modConfigChanged,
+    bool noThreadsLeft) noexcept {
+    if (noThreadsLeft) {
+        // The process exits with the exit code of its last thread, so the pool
+        // thread must exit before the thread which deletes the session.
+        m_threadPoolWorkerThread.reset(
+            OpenThread(SYNCHRONIZE, FALSE, GetCurrentThreadId()));
+    }
+
+    // The rest is done on a new thread, since the pool can't be closed from its
+    // own callback. The thread takes over the module reference of the pool
+    // waits. Mods are reloaded on it, since a newly loaded mod might not be
+    // thread agnostic, and then the waits are started again if possible.
+    // Otherwise, it runs the regular main loop, which returns right away if
+    // the session manager exited or no threads are left.
+    LPTHREAD_START_ROUTINE routine;
+    if (modConfigChanged) {
+        routine = [](LPVOID pThis) -> DWORD {
+            SetThreadErrorMode(SEM_FAILCRITICALERRORS, nullptr);
+            auto* this_ = reinterpret_cast<CustomizationSession*>(pThis);
+
+            // Waits for the callback which created this thread to return.
+            this_->m_threadPoolMainLoop.reset();
+
+            this_->m_mainLoopRunner->ContinueMonitoring();
+            this_->ReloadModsAndSettings();
+
+            if (this_->StartMainLoopOnThreadPool()) {
+                FreeLibraryAndExitThread(g_hDllInst, 0);
             }
+
+            this_->RunMainLoop();
+            this_->DeleteThis();
+
+            FreeLibraryAndExitThread(g_hDllInst, this_->m_lastThreadExitCode);
+        };
+    } else {
+        routine = [](LPVOID pThis) -> DWORD {
+            SetThreadErrorMode(SEM_FAILCRITICALERRORS, nullptr);
+            auto* this_ = reinterpret_cast<CustomizationSession*>(pThis);
+
+            // Waits for the callback which created this thread to return.
+            this_->m_threadPoolMainLoop.reset();
+
+            if (this_->m_threadPoolWorkerThread) {
+                WaitForSingleObject(this_->m_threadPoolWorkerThread.get(),
+                                    INFINITE);
+                this_->m_threadPoolWorkerThread.reset();
+            }
+
+            this_->RunMainLoop();
+            this_->DeleteThis();
+
+            FreeLibraryAndExitThread(g_hDllInst, this_->m_lastThreadExitCode);
+        };
+    }
+
+    wil::unique_process_handle thread(
+        Functions::MyCreateRemoteThread(GetCurrentProcess(), routine, this, 0));
+    if (!thread) {
+        LOG(L"Thread creation failed: %u", GetLastError());
+        m_threadPoolWorkerThread.reset();
+        m_threadPoolMainLoop->Close(wait);
+        if (modConfigChanged) {
+            m_mainLoopRunner->ContinueMonitoring();
+            ReloadModsAndSettings();
         }
+
+        RunMainLoop();
+        DeleteThis();
+        FreeLibraryWhenCallbackReturns(instance, g_hDllInst);
+        return;
     }
 
-    VERBOSE(L"Exiting engine thread wait loop");
+    Functions::SetThreadDescriptionIfAvailable(thread.get(),
+                                               L"WindhawkMainLoop");
+}
+
+void CustomizationSession::ReloadModsAndSettings() noexcept {
+    if (CurrentProcessHasMitigationPolicy()) {
+        LOG(L"Process prohibits dynamic code, cannot reload mods safely");
+        return;
+    }
+
+    try {
+        m_modsManager.ReloadModsAndSettings();
+    } catch (const std::exception& e) {
+        LOG(L"ReloadModsAndSettings failed: %S", e.what());
+    }
+}
+
+// Published when the main loop starts waiting, i.e. after the mods are loaded
+// or reloaded, so that idle processes don't have to wake up for it.
+void CustomizationSession::PublishMemoryUsage() noexcept {
+    try {
+        m_memoryUsageStatus.Set(MemoryUsage::FormatSnapshot().c_str());
+    } catch (const std::exception& e) {
+        LOG(L"Failed to publish the memory usage: %S", e.what());
+    }
 }
 
 void CustomizationSession::DeleteThis() noexcept {
@@ -3,6 +3,7 @@
 #include "mods_manager.h"
 #include "new_process_injector.h"
 #include "no_destructor.h"
+#include "pool_wait_loop.h"
 #include "storage_manager.h"
 #include "var_init_once.h"
 
@@ -57,25 +58,23 @@ class CustomizationSession {
         operator HANDLE() { return GetInstance().value().get(); }
     };
 
-#ifdef WH_HOOKING_ENGINE_MINHOOK
-    class MinHookScopeInit {
+    class HookEngineScopeInit {
        public:
-        MinHookScopeInit(const MinHookScopeInit&) = delete;
-        MinHookScopeInit& operator=(const MinHookScopeInit&) = delete;
+        HookEngineScopeInit(const HookEngineScopeInit&) = delete;
+        HookEngineScopeInit& operator=(const HookEngineScopeInit&) = delete;
 
-        MinHookScopeInit(MH_THREAD_FREEZE_METHOD freezeMethod);
-        ~MinHookScopeInit();
+        HookEngineScopeInit(bool freezeThreads);
+        ~HookEngineScopeInit();
     };
 
-    class MinHookScopeApply {
+    class HookEngineScopeApply {
        public:
-        MinHookScopeApply(const MinHookScopeApply&) = delete;
-        MinHookScopeApply& operator=(const MinHookScopeApply&) = delete;
+        HookEngineScopeApply(const HookEngineScopeApply&) = delete;
+        HookEngineScopeApply& operator=(const HookEngineScopeApply&) = delete;
 
-        MinHookScopeApply();
-        ~MinHookScopeApply();
+        HookEngineScopeApply();
+        ~HookEngineScopeApply();
     };
-#endif  // WH_HOOKING_ENGINE_MINHOOK
 
     class MainLoopRunner {
        public:
@@ -91,12 +90,59 @@ class CustomizationSession {
                    DWORD* lastThreadExitCode) noexcept;
         bool ContinueMonitoring() noexcept;
         bool CanRunAcrossThreads() noexcept;
+        HANDLE GetModConfigChangeHandle() noexcept;
 
        private:
         std::optional<StorageManager::ModConfigChangeNotification>
             m_modConfigChangeNotification;
     };
 
+    // Waits for the same events as MainLoopRunner::Run with thread pool waits
+    // instead of a blocking loop, so that no thread is kept while the process
+    // is idle. The waits run on a private pool which is limited to a single
+    // thread, so that the callbacks never run concurrently. Mod callbacks don't
+    // run on the pool: when the mod config changes, or once the session
+    // manager exits or no other threads are left, the waits are closed and the
+    // rest is done on a new thread, see EndMainLoopOnThreadPool.
+    class ThreadPoolMainLoop : private PoolWaitLoop::Host {
+       public:
+        ThreadPoolMainLoop(const ThreadPoolMainLoop&) = delete;
+        ThreadPoolMainLoop& operator=(const ThreadPoolMainLoop&) = delete;
+
+        ThreadPoolMainLoop(CustomizationSession* session) noexcept;
+        ~ThreadPoolMainLoop();
+
+        // Returns false if the waits couldn't be started, in which case the
+        // object should be destroyed.
+        bool Start() noexcept;
+        // Can be called from the callback of currentWait, otherwise must be
+        // called from a thread which isn't running a callback.
+        void Close(PTP_WAIT currentWait) noexcept;
+
+       private:
+        static void CALLBACK WaitCallback(PTP_CALLBACK_INSTANCE instance,
+                                          PVOID context,
+                                          PTP_WAIT wait,
+                                          TP_WAIT_RESULT waitResult);
+
+        // PoolWaitLoop::Host.
+        PoolWaitLoop::FirstThread WaitForFirstThread() noexcept override;
+        void OnFirstThreadExited() noexcept override;
+        bool WaitForSessionManagerExit(uint32_t timeoutMs) noexcept override;
+
+        CustomizationSession* m_session;
+        PoolWaitLoop m_loop{this};
+        // Held while starting and in callbacks, so that callbacks don't run
+        // before all waits are set.
+        std::mutex m_mutex;
+        PTP_POOL m_pool = nullptr;
+        TP_CALLBACK_ENVIRON m_callbackEnvironment;
+        PTP_WAIT m_sessionManagerProcessWait = nullptr;
+        PTP_WAIT m_firstThreadWait = nullptr;
+        PTP_WAIT m_modConfigChangeWait = nullptr;
+        wil::unique_handle m_firstThread;
+    };
+
     static std::optional<CustomizationSession>& GetInstance();
 
     wil::unique_private_namespace_close OpenSessionPrivateNamespace();
@@ -105,24 +151,34 @@ class CustomizationSession {
                           bool runningFromAPC) noexcept;
     void RunMainLoopAndDeleteThisWithThreadRecreate() noexcept;
     void RunMainLoop() noexcept;
+    bool StartMainLoopOnThreadPool() noexcept;
+    void EndMainLoopOnThreadPool(PTP_CALLBACK_INSTANCE instance,
+                                 PTP_WAIT wait,
+                                 bool modConfigChanged,
+                                 bool noThreadsLeft) noexcept;
+    void ReloadModsAndSettings() noexcept;
     void DeleteThis() noexcept;
+    void PublishMemoryUsage() noexcept;
 
     bool m_threadAttachExempt;
     ScopedStaticSessionManagerProcess m_scopedStaticSessionManagerProcess;
     wil::unique_mutex_nothrow m_sessionMutex;
     wil::unique_private_namespace_close m_privateNamespace;
-#ifdef WH_HOOKING_ENGINE_MINHOOK
-    MinHookScopeInit m_minHookScopeInit;
-#endif  // WH_HOOKING_ENGINE_MINHOOK
+    HookEngineScopeInit m_hookEngineScopeInit;
     ModsManager m_modsManager;
     NewProcessInjector m_newProcessInjector;
-#ifdef WH_HOOKING_ENGINE_MINHOOK
-    MinHookScopeApply m_minHookScopeApply;
-#endif  // WH_HOOKING_ENGINE_MINHOOK
+    HookEngineScopeApply m_hookEngineScopeApply;
 
     std::optional<MainLoopRunner> m_mainLoopRunner;
+    std::optional<ThreadPoolMainLoop> m_threadPoolMainLoop;
+    // The pool thread which ran the last callback if no other threads were
+    // left, see EndMainLoopOnThreadPool.
+    wil::unique_handle m_threadPoolWorkerThread;
     DWORD m_lastThreadExitCode = 0;
 
+    ModStatus::Entry m_memoryUsageStatus{
+        ModStatusTable::Category::kEngineMemory, L""};
+
     // Must be released after the singleton object is freed. See the careful
     // usage in DeleteThis.
     wil::unique_semaphore m_sessionSemaphore;
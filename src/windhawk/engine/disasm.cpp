@@ -0,0 +1,366 @@
+#include "stdafx.h"
+
+#include "disasm.h"
+#include "var_init_once.h"
+
+#if defined(_M_ARM64)
+#include <binaryninja-arm64-disassembler/decode.h>
+#include <binaryninja-arm64-disassembler/format.h>
+#endif
+
+namespace {
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+struct ZydisState {
+    ZydisState() {
+#if defined(_M_IX86)
+        constexpr auto machineMode = ZYDIS_MACHINE_MODE_LEGACY_32;
+        constexpr auto stackWidth = ZYDIS_STACK_WIDTH_32;
+#else
+        constexpr auto machineMode = ZYDIS_MACHINE_MODE_LONG_64;
+        constexpr auto stackWidth = ZYDIS_STACK_WIDTH_64;
+#endif
+
+        ZydisDecoderInit(&decoder, machineMode, stackWidth);
+
+        ZydisDecoderInit(&minimalDecoder, machineMode, stackWidth);
+        ZydisDecoderEnableMode(&minimalDecoder, ZYDIS_DECODER_MODE_MINIMAL,
+                               ZYAN_TRUE);
+
+        ZydisFormatterInit(&formatter, ZYDIS_FORMATTER_STYLE_INTEL);
+    }
+
+    ZydisDecoder decoder;
+    // Only decodes the length and basic info of instructions, without
+    // operands.
+    ZydisDecoder minimalDecoder;
+    ZydisFormatter formatter;
+};
+
+const ZydisState& GetZydisState() {
+    STATIC_INIT_ONCE(ZydisState, zydisState);
+    return *zydisState;
+}
+
+PCSTR RegisterName(ZydisRegister reg) {
+    return reg != ZYDIS_REGISTER_NONE ? ZydisRegisterGetString(reg) : nullptr;
+}
+
+void FillInstruction(const ZydisDecodedInstruction& instruction,
+                     const ZydisDecodedOperand* operands,
+                     WH_DISASM_INSTRUCTION* result) {
+    auto runtimeAddress = reinterpret_cast<ZyanU64>(result->address);
+
+    result->mnemonic = ZydisMnemonicGetString(instruction.mnemonic);
+
+    switch (instruction.meta.category) {
+        case ZYDIS_CATEGORY_CALL:
+            result->flags |= WH_DISASM_FLAG_CALL;
+            break;
+
+        case ZYDIS_CATEGORY_COND_BR:
+            result->flags |= WH_DISASM_FLAG_JUMP | WH_DISASM_FLAG_CONDITIONAL;
+            break;
+
+        case ZYDIS_CATEGORY_UNCOND_BR:
+            result->flags |= WH_DISASM_FLAG_JUMP;
+            break;
+
+        case ZYDIS_CATEGORY_RET:
+            result->flags |= WH_DISASM_FLAG_RETURN;
+            break;
+    }
+
+    size_t operandCount = std::min(
+        static_cast<size_t>(instruction.operand_count_visible),
+        std::size(result->operands));
+
+    for (size_t i = 0; i < operandCount; i++) {
+        const auto& operand = operands[i];
+        auto& resultOperand = result->operands[i];
+
+        switch (operand.type) {
+            case ZYDIS_OPERAND_TYPE_REGISTER:
+                resultOperand.type = WH_DISASM_OPERAND_REGISTER;
+                resultOperand.reg = RegisterName(operand.reg.value);
+                break;
+
+            case ZYDIS_OPERAND_TYPE_IMMEDIATE:
+                resultOperand.type = WH_DISASM_OPERAND_IMMEDIATE;
+                if (operand.imm.is_relative) {
+                    ZyanU64 target;
+                    if (ZYAN_SUCCESS(ZydisCalcAbsoluteAddress(
+                            &instruction, &operand, runtimeAddress, &target))) {
+                        resultOperand.value = static_cast<INT64>(target);
+                        result->flags |= WH_DISASM_FLAG_RELATIVE;
+                    }
+                } else if (operand.imm.is_signed) {
+                    resultOperand.value = operand.imm.value.s;
+                } else {
+                    resultOperand.value =
+                        static_cast<INT64>(operand.imm.value.u);
+                }
+                break;
+
+            case ZYDIS_OPERAND_TYPE_MEMORY:
+                resultOperand.type = WH_DISASM_OPERAND_MEMORY;
+                if (operand.mem.base == ZYDIS_REGISTER_RIP ||
+                    operand.mem.base == ZYDIS_REGISTER_EIP) {
+                    ZyanU64 target;
+                    if (ZYAN_SUCCESS(ZydisCalcAbsoluteAddress(
+                            &instruction, &operand, runtimeAddress, &target))) {
+                        resultOperand.value = static_cast<INT64>(target);
+                        result->flags |= WH_DISASM_FLAG_RELATIVE;
+                    }
+                } else {
+                    resultOperand.reg = RegisterName(operand.mem.base);
+                    resultOperand.value = operand.mem.disp.value;
+                }
+                resultOperand.index = RegisterName(operand.mem.index);
+                resultOperand.scale = operand.mem.scale;
+                break;
+
+            case ZYDIS_OPERAND_TYPE_POINTER:
+                resultOperand.type = WH_DISASM_OPERAND_IMMEDIATE;
+                resultOperand.value = operand.ptr.offset;
+                break;
+
+            default:
+                resultOperand.type = WH_DISASM_OPERAND_OTHER;
+                break;
+        }
+    }
+
+    result->operandCount = operandCount;
+}
+
+#elif defined(_M_ARM64)
+
+void FillInstruction(const Instruction& instruction,
+                     WH_DISASM_INSTRUCTION* result) {
+    result->mnemonic = get_operation(&instruction);
+
+    switch (instruction.operation) {
+        case ARM64_BL:
+        case ARM64_BLR:
+        case ARM64_BLRAA:
+        case ARM64_BLRAAZ:
+        case ARM64_BLRAB:
+        case ARM64_BLRABZ:
+            result->flags |= WH_DISASM_FLAG_CALL;
+            break;
+
+        case ARM64_B:
+        case ARM64_B_AL:
+        case ARM64_BR:
+        case ARM64_BRAA:
+        case ARM64_BRAAZ:
+        case ARM64_BRAB:
+        case ARM64_BRABZ:
+            result->flags |= WH_DISASM_FLAG_JUMP;
+            break;
+
+        case ARM64_B_CC:
+        case ARM64_B_CS:
+        case ARM64_B_EQ:
+        case ARM64_B_GE:
+        case ARM64_B_GT:
+        case ARM64_B_HI:
+        case ARM64_B_LE:
+        case ARM64_B_LS:
+        case ARM64_B_LT:
+        case ARM64_B_MI:
+        case ARM64_B_NE:
+        case ARM64_B_PL:
+        case ARM64_B_VC:
+        case ARM64_B_VS:
+        case ARM64_CBNZ:
+        case ARM64_CBZ:
+        case ARM64_TBNZ:
+        case ARM64_TBZ:
+            result->flags |= WH_DISASM_FLAG_JUMP | WH_DISASM_FLAG_CONDITIONAL;
+            break;
+
+        case ARM64_RET:
+        case ARM64_RETAA:
+        case ARM64_RETAB:
+            result->flags |= WH_DISASM_FLAG_RETURN;
+            break;
+    }
+
+    size_t operandCount = 0;
+    for (const auto& operand : instruction.operands) {
+        if (operand.operandClass == NONE ||
+            operandCount == std::size(result->operands)) {
+            break;
+        }
+
+        auto& resultOperand = result->operands[operandCount++];
+
+        switch (operand.operandClass) {
+            case REG:
+                resultOperand.type = WH_DISASM_OPERAND_REGISTER;
+                resultOperand.reg = get_register_name(operand.reg[0]);
+                break;
+
+            case IMM32:
+            case IMM64:
+                resultOperand.type = WH_DISASM_OPERAND_IMMEDIATE;
+                resultOperand.value = static_cast<INT64>(operand.immediate);
+                break;
+
+            case LABEL:
+                // The decoder resolves labels to absolute addresses.
+                resultOperand.type = WH_DISASM_OPERAND_IMMEDIATE;
+                resultOperand.value = static_cast<INT64>(operand.immediate);
+                result->flags |= WH_DISASM_FLAG_RELATIVE;
+                break;
+
+            case MEM_REG:
+            case MEM_PRE_IDX:
+            case MEM_POST_IDX:
+            case MEM_OFFSET:
+                resultOperand.type = WH_DISASM_OPERAND_MEMORY;
+                resultOperand.reg = get_register_name(operand.reg[0]);
+                resultOperand.value = static_cast<INT64>(operand.immediate);
+                break;
+
+            case MEM_EXTENDED:
+                resultOperand.type = WH_DISASM_OPERAND_MEMORY;
+                resultOperand.reg = get_register_name(operand.reg[0]);
+                resultOperand.index = get_register_name(operand.reg[1]);
+                resultOperand.scale =
+                    operand.shiftValueUsed ? 1u << operand.shiftValue : 1;
+                break;
+
+            default:
+                resultOperand.type = WH_DISASM_OPERAND_OTHER;
+                break;
+        }
+    }
+
+    result->operandCount = operandCount;
+}
+
+#else
+#error "Unsupported architecture"
+#endif
+
+}  // namespace
+
+namespace Disasm {
+
+bool DisassembleText(const void* address,
+                     WH_DISASM_RESULT* result,
+                     unsigned int* error) {
+#if defined(_M_ARM64)
+    int rc = aarch64_decompose_and_disassemble(
+        reinterpret_cast<ULONG_PTR>(address),
+        *reinterpret_cast<const DWORD*>(address), result->text,
+        sizeof(result->text));
+    if (rc) {
+        *error = rc;
+        return false;
+    }
+
+    result->length = sizeof(DWORD);
+    return true;
+#else
+    const auto& zydisState = GetZydisState();
+
+    ZydisDecodedInstruction instruction;
+    ZydisDecodedOperand operands[ZYDIS_MAX_OPERAND_COUNT];
+    ZyanStatus status =
+        ZydisDecoderDecodeFull(&zydisState.decoder, address,
+                               ZYDIS_MAX_INSTRUCTION_LENGTH, &instruction,
+                               operands);
+    if (ZYAN_SUCCESS(status)) {
+        status = ZydisFormatterFormatInstruction(
+            &zydisState.formatter, &instruction, operands,
+            instruction.operand_count_visible, result->text,
+            sizeof(result->text), reinterpret_cast<ZyanU64>(address),
+            ZYAN_NULL);
+    }
+
+    if (!ZYAN_SUCCESS(status)) {
+        *error = status;
+        return false;
+    }
+
+    result->length = instruction.length;
+    return true;
+#endif  // defined(_M_ARM64)
+}
+
+size_t DecodeRange(const void* address,
+                   WH_DISASM_INSTRUCTION* instructions,
+                   size_t instructionsCount,
+                   bool lengthOnly,
+                   bool stopAtReturn) {
+    auto* p = static_cast<const BYTE*>(address);
+    size_t count = 0;
+
+#if defined(_M_ARM64)
+    while (count < instructionsCount) {
+        Instruction instruction{};
+        if (aarch64_decompose(*reinterpret_cast<const DWORD*>(p),
+                              &instruction, reinterpret_cast<ULONG_PTR>(p))) {
+            break;
+        }
+
+        auto* result = &instructions[count++];
+        *result = {};
+        result->address = const_cast<BYTE*>(p);
+        result->length = sizeof(DWORD);
+        if (!lengthOnly) {
+            FillInstruction(instruction, result);
+        }
+
+        p += sizeof(DWORD);
+
+        if (stopAtReturn && (instruction.operation == ARM64_RET ||
+                             instruction.operation == ARM64_RETAA ||
+                             instruction.operation == ARM64_RETAB)) {
+            break;
+        }
+    }
+#else
+    const auto& zydisState = GetZydisState();
+
+    while (count < instructionsCount) {
+        ZydisDecodedInstruction instruction;
+        ZydisDecodedOperand operands[ZYDIS_MAX_OPERAND_COUNT];
+        ZyanStatus status =
+            lengthOnly ? ZydisDecoderDecodeInstruction(
+                             &zydisState.minimalDecoder, nullptr, p,
+                             ZYDIS_MAX_INSTRUCTION_LENGTH, &instruction)
+                       : ZydisDecoderDecodeFull(
+                             &zydisState.decoder, p,
+                             ZYDIS_MAX_INSTRUCTION_LENGTH, &instruction,
+                             operands);
+        if (!ZYAN_SUCCESS(status)) {
+            break;
+        }
+
+        auto* result = &instructions[count++];
+        *result = {};
+        result->address = const_cast<BYTE*>(p);
+        result->length = instruction.length;
+        if (!lengthOnly) {
+            FillInstruction(instruction, operands, result);
+        }
+
+        p += instruction.length;
+
+        // The category is available in the minimal decoder mode too.
+        if (stopAtReturn && instruction.meta.category == ZYDIS_CATEGORY_RET) {
+            break;
+        }
+    }
+#endif  // defined(_M_ARM64)
+
+    return count;
+}
+
+}  // namespace Disasm
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "mods_api.h"
+
+// Disassembly helpers for the mod API. The decoder and formatter state is
+// initialized once per process and shared by all threads, since decoding
+// doesn't modify it.
+namespace Disasm {
+
+// Decodes a single instruction and formats it as text. On failure, returns
+// false and sets error to the error code of the disassembler library.
+bool DisassembleText(const void* address,
+                     WH_DISASM_RESULT* result,
+                     unsigned int* error);
+
+// Decodes up to instructionsCount consecutive instructions, stopping after an
+// instruction which can't be decoded, and after a return instruction if
+// stopAtReturn is set. In length only mode, only the address and length of
+// each instruction are filled. Returns the number of decoded instructions.
+size_t DecodeRange(const void* address,
+                   WH_DISASM_INSTRUCTION* instructions,
+                   size_t instructionsCount,
+                   bool lengthOnly,
+                   bool stopAtReturn);
+
+}  // namespace Disasm
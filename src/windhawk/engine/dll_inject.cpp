@@ -3,6 +3,7 @@
 #include "dll_inject.h"
 #include "functions.h"
 #include "logger.h"
+#include "startup_profile.h"
 #include "storage_manager.h"
 #include "var_init_once.h"
 
@@ -737,8 +738,9 @@ void DllInject(HANDLE hProcess,
             }
         });
 
-    size_t shellcodeDataSize =
-        offsetof(LOAD_LIBRARY_REMOTE_DATA, szDllName) + dllPathBytes;
+    size_t shellcodeDataSize = offsetof(LOAD_LIBRARY_REMOTE_DATA, szDllName) +
+                               dllPathBytes +
+                               sizeof(LOAD_LIBRARY_REMOTE_DATA_TRAILER);
     auto shellcodeDataVector = std::vector<BYTE>(shellcodeDataSize);
     auto shellcodeData =
         reinterpret_cast<LOAD_LIBRARY_REMOTE_DATA*>(shellcodeDataVector.data());
@@ -751,6 +753,12 @@ void DllInject(HANDLE hProcess,
     shellcodeData->hSessionMutex = hRemoteSessionMutex;
     memcpy(shellcodeData->szDllName, dllPath.c_str(), dllPathBytes);
 
+    LOAD_LIBRARY_REMOTE_DATA_TRAILER trailer{
+        .nInjectionTimestamp = StartupProfile::GetTimestamp(),
+    };
+    memcpy(reinterpret_cast<BYTE*>(shellcodeData->szDllName) + dllPathBytes,
+           &trailer, sizeof(trailer));
+
     size_t shellcodeSizeAligned =
         (shellcodeSize + (sizeof(LONG_PTR) - 1)) & ~(sizeof(LONG_PTR) - 1);
 
@@ -831,4 +839,12 @@ void DllInject(HANDLE hProcess,
     remoteCodeCleanup.release();
 }
 
+LOAD_LIBRARY_REMOTE_DATA_TRAILER GetRemoteDataTrailer(
+    const LOAD_LIBRARY_REMOTE_DATA* pInjData) {
+    LOAD_LIBRARY_REMOTE_DATA_TRAILER trailer;
+    memcpy(&trailer, pInjData->szDllName + wcslen(pInjData->szDllName) + 1,
+           sizeof(trailer));
+    return trailer;
+}
+
 }  // namespace DllInject
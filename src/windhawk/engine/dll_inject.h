@@ -34,8 +34,18 @@ struct LOAD_LIBRARY_REMOTE_DATA {
         DWORD64 dw64APCShellcodeAddress;
     };
     WCHAR szDllName[1];  // flexible array member
+    // Followed by LOAD_LIBRARY_REMOTE_DATA_TRAILER, unaligned, after the null
+    // terminator of szDllName. Not used by the shellcode.
 };
 
+struct LOAD_LIBRARY_REMOTE_DATA_TRAILER {
+    // The performance counter value right before the injection.
+    INT64 nInjectionTimestamp;
+};
+
+LOAD_LIBRARY_REMOTE_DATA_TRAILER GetRemoteDataTrailer(
+    const LOAD_LIBRARY_REMOTE_DATA* pInjData);
+
 void DllInject(HANDLE hProcess,
                HANDLE hThreadForAPC,
                HANDLE hSessionManagerProcess,
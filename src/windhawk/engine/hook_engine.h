@@ -0,0 +1,179 @@
+#pragma once
+
+#include "logger.h"
+#include "memory_usage.h"
+
+// The hooking engine is selected at compile time in stdafx.h. Each engine is a
+// policy class with the same static interface, and HookEngine is an alias of
+// the selected one. Callers don't branch on the engine, and since the methods
+// are inline, each call compiles to a direct call into the engine library.
+//
+// Hooks are grouped by an owner, the LoadedMod object for mod hooks. Enable
+// and disable operations are queued and applied in batches, so that threads
+// are frozen once per batch.
+
+#ifdef WH_HOOKING_ENGINE_MINHOOK
+
+class MinHookEngine {
+   public:
+    using Status = MH_STATUS;
+
+    static constexpr Status kOk = MH_OK;
+    static constexpr ULONG_PTR kEngineOwner = MH_DEFAULT_IDENT;
+    static constexpr ULONG_PTR kAllOwners = MH_ALL_IDENTS;
+
+    // Whether SetHookDetour is supported. With Detours, hooked targets jump to
+    // the detour through a pointer in the trampoline, which can be replaced in
+    // place.
+#ifdef WH_HOOKING_ENGINE_MINHOOK_DETOURS
+    static constexpr bool kCanSetHookDetour = true;
+#else
+    static constexpr bool kCanSetHookDetour = false;
+#endif  // WH_HOOKING_ENGINE_MINHOOK_DETOURS
+
+    // If freezeThreads is false, the caller must make sure that no other
+    // threads are running while hooks are applied.
+    static Status Initialize(bool freezeThreads) {
+        Status status = MH_Initialize();
+        if (status != MH_OK) {
+            return status;
+        }
+
+        SetFreezeThreads(freezeThreads);
+
+#ifdef WH_HOOKING_ENGINE_MINHOOK_DETOURS
+        MH_SetBulkOperationMode(
+            /*continueOnError=*/TRUE,
+            [](LPVOID pTarget, NTSTATUS detoursStatus) {
+                LOG(L"Hooking operation failed for %p with status 0x%08X",
+                    pTarget, detoursStatus);
+            });
+#endif  // WH_HOOKING_ENGINE_MINHOOK_DETOURS
+
+        return MH_OK;
+    }
+
+    static Status Uninitialize() {
+        MemoryUsage::InvalidateTrampolinesSize();
+        return MH_Uninitialize();
+    }
+
+    static void SetFreezeThreads(bool freezeThreads) {
+        MH_SetThreadFreezeMethod(freezeThreads
+                                     ? MH_FREEZE_METHOD_FAST_UNDOCUMENTED
+                                     : MH_FREEZE_METHOD_NONE_UNSAFE);
+    }
+
+    static Status CreateHook(ULONG_PTR owner,
+                             void* target,
+                             void* detour,
+                             void** original) {
+        MemoryUsage::InvalidateTrampolinesSize();
+        return MH_CreateHookEx(owner, target, detour, original);
+    }
+
+    // Replaces the detour of an enabled hook and moves the hook to newOwner.
+    // The hook stays enabled, and threads aren't frozen. Fails if the owner
+    // has no enabled hook on the target.
+    static Status SetHookDetour(ULONG_PTR owner,
+                                void* target,
+                                ULONG_PTR newOwner,
+                                void* detour,
+                                void** original) {
+#ifdef WH_HOOKING_ENGINE_MINHOOK_DETOURS
+        return MH_SetHookDetourEx(owner, target, newOwner, detour, original);
+#else
+        return MH_ERROR_UNSUPPORTED_FUNCTION;
+#endif  // WH_HOOKING_ENGINE_MINHOOK_DETOURS
+    }
+
+    // Removes all hooks of the owner immediately.
+    static Status RemoveHooks(ULONG_PTR owner) {
+        MemoryUsage::InvalidateTrampolinesSize();
+        return MH_RemoveHookEx(owner, MH_ALL_HOOKS);
+    }
+
+    // Removes the hooks of the owner which were disabled by ApplyQueued.
+    static Status RemoveDisabledHooks(ULONG_PTR owner) {
+        MemoryUsage::InvalidateTrampolinesSize();
+        return MH_RemoveDisabledHooksEx(owner);
+    }
+
+    static Status QueueEnableHook(ULONG_PTR owner, void* target) {
+        return MH_QueueEnableHookEx(owner, target);
+    }
+
+    // If target is nullptr, all hooks of the owner are queued.
+    static Status QueueDisableHook(ULONG_PTR owner, void* target) {
+        return MH_QueueDisableHookEx(owner, target ? target : MH_ALL_HOOKS);
+    }
+
+    static Status ApplyQueued(ULONG_PTR owner) {
+        return MH_ApplyQueuedEx(owner);
+    }
+
+    // Disables all hooks of all owners immediately.
+    static Status DisableAllHooks() {
+        return MH_DisableHookEx(MH_ALL_IDENTS, MH_ALL_HOOKS);
+    }
+};
+
+using HookEngine = MinHookEngine;
+
+#elif WH_HOOKING_ENGINE == WH_HOOKING_ENGINE_NONE
+
+// For testing without a hooking engine. Setting, removing and applying the
+// hooks of a mod fails, as without the policy class. Operations on the hooks
+// of all owners, and the cleanup of an owner, do nothing.
+class NullHookEngine {
+   public:
+    using Status = int;
+
+    static constexpr Status kOk = 0;
+    static constexpr Status kNotSupported = -1;
+    static constexpr ULONG_PTR kEngineOwner = 1;
+    static constexpr ULONG_PTR kAllOwners = 0;
+    static constexpr bool kCanSetHookDetour = false;
+
+    static Status Initialize(bool freezeThreads) { return kOk; }
+    static Status Uninitialize() { return kOk; }
+    static void SetFreezeThreads(bool freezeThreads) {}
+
+    static Status CreateHook(ULONG_PTR owner,
+                             void* target,
+                             void* detour,
+                             void** original) {
+        return kNotSupported;
+    }
+
+    static Status SetHookDetour(ULONG_PTR owner,
+                                void* target,
+                                ULONG_PTR newOwner,
+                                void* detour,
+                                void** original) {
+        return kNotSupported;
+    }
+
+    static Status RemoveHooks(ULONG_PTR owner) { return kOk; }
+    static Status RemoveDisabledHooks(ULONG_PTR owner) { return kOk; }
+
+    static Status QueueEnableHook(ULONG_PTR owner, void* target) {
+        return kNotSupported;
+    }
+
+    static Status QueueDisableHook(ULONG_PTR owner, void* target) {
+        return target ? kNotSupported : kOk;
+    }
+
+    static Status ApplyQueued(ULONG_PTR owner) {
+        return owner == kAllOwners ? kOk : kNotSupported;
+    }
+
+    static Status DisableAllHooks() { return kOk; }
+};
+
+using HookEngine = NullHookEngine;
+
+#else
+#error "Unsupported hooking engine"
+#endif  // WH_HOOKING_ENGINE
@@ -0,0 +1,523 @@
+#include "stdafx.h"
+
+#include "import_hooks.h"
+#include "import_table.h"
+#include "logger.h"
+#include "module_load_notifier.h"
+#include "no_destructor.h"
+#include "var_init_once.h"
+
+extern HINSTANCE g_hDllInst;
+
+namespace {
+
+// A stub takes two pages: the code, and the pointer it jumps through, which
+// stays writable so that it can be replaced without changing the protection.
+constexpr size_t kStubPageSize = 0x1000;
+
+// The page is made writable for the write, and its protection is restored
+// afterwards. The caller serializes the writes, so that a write doesn't
+// restore the protection while another write to the same page is in progress.
+template <typename T>
+bool CompareExchangeProtected(T* address, T expected, T desired) {
+    // The page might hold code too, which other threads might be running, so
+    // it stays executable if it was.
+    MEMORY_BASIC_INFORMATION memoryInfo;
+    if (!VirtualQuery(address, &memoryInfo, sizeof(memoryInfo))) {
+        LOG(L"VirtualQuery failed for %p: %u", address, GetLastError());
+        return false;
+    }
+
+    constexpr DWORD kExecuteProtect = PAGE_EXECUTE | PAGE_EXECUTE_READ |
+                                      PAGE_EXECUTE_READWRITE |
+                                      PAGE_EXECUTE_WRITECOPY;
+    DWORD newProtect = (memoryInfo.Protect & kExecuteProtect)
+                           ? PAGE_EXECUTE_READWRITE
+                           : PAGE_READWRITE;
+
+    DWORD oldProtect;
+    if (!VirtualProtect(address, sizeof(T), newProtect, &oldProtect)) {
+        LOG(L"VirtualProtect failed for %p: %u", address, GetLastError());
+        return false;
+    }
+
+    bool exchanged =
+        std::atomic_ref<T>(*address).compare_exchange_strong(expected, desired);
+
+    VirtualProtect(address, sizeof(T), oldProtect, &oldProtect);
+
+    return exchanged;
+}
+
+void* AllocateStubMemory(HMODULE dllModule) {
+#ifdef _WIN64
+    // The export table entry is a 32-bit offset from the DLL base, so the stub
+    // must be within 4 GB above it.
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    ULONG_PTR granularity = systemInfo.dwAllocationGranularity;
+    auto alignUp = [granularity](ULONG_PTR address) {
+        return (address + granularity - 1) & ~(granularity - 1);
+    };
+
+    ULONG_PTR base = reinterpret_cast<ULONG_PTR>(dllModule);
+    DWORD imageSize =
+        ImportTable::GetNtHeaders(dllModule)->OptionalHeader.SizeOfImage;
+    ULONG_PTR address = alignUp(base + imageSize);
+    ULONG_PTR maxAddress = base + 0xFFFFFFFF - kStubPageSize * 2;
+
+    MEMORY_BASIC_INFORMATION memoryInfo;
+    while (address <= maxAddress &&
+           VirtualQuery(reinterpret_cast<void*>(address), &memoryInfo,
+                        sizeof(memoryInfo))) {
+        if (memoryInfo.State == MEM_FREE) {
+            void* memory = VirtualAlloc(reinterpret_cast<void*>(address),
+                                        kStubPageSize * 2,
+                                        MEM_RESERVE | MEM_COMMIT,
+                                        PAGE_READWRITE);
+            if (memory) {
+                return memory;
+            }
+        }
+
+        address = alignUp(reinterpret_cast<ULONG_PTR>(memoryInfo.BaseAddress) +
+                          memoryInfo.RegionSize);
+    }
+
+    return nullptr;
+#else
+    // Offsets wrap around, so any address can be used.
+    return VirtualAlloc(nullptr, kStubPageSize * 2, MEM_RESERVE | MEM_COMMIT,
+                        PAGE_READWRITE);
+#endif  // _WIN64
+}
+
+// Returns the pointer which the stub jumps through.
+void** WriteStubCode(void* memory) {
+    auto* code = static_cast<BYTE*>(memory);
+    auto* jumpTarget = reinterpret_cast<void**>(code + kStubPageSize);
+
+    ImportTable::WriteStubCode(code, jumpTarget);
+
+    DWORD oldProtect;
+    THROW_IF_WIN32_BOOL_FALSE(
+        VirtualProtect(code, kStubPageSize, PAGE_EXECUTE_READ, &oldProtect));
+
+    FlushInstructionCache(GetCurrentProcess(), code, kStubPageSize);
+
+    return jumpTarget;
+}
+
+// Returns an empty handle if the module isn't loaded.
+wil::unique_hmodule PinModule(HMODULE module) {
+    HMODULE pinned;
+    if (!GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                           reinterpret_cast<LPCWSTR>(module), &pinned)) {
+        return {};
+    }
+
+    wil::unique_hmodule result(pinned);
+    if (pinned != module) {
+        // Another module was loaded at the same address.
+        result.reset();
+    }
+
+    return result;
+}
+
+std::vector<wil::unique_hmodule> PinLoadedModules() {
+    wil::unique_hfile snapshot;
+    do {
+        // Can fail with ERROR_BAD_LENGTH while modules are being loaded.
+        snapshot.reset(CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, 0));
+    } while (!snapshot && GetLastError() == ERROR_BAD_LENGTH);
+    THROW_LAST_ERROR_IF(!snapshot);
+
+    std::vector<wil::unique_hmodule> modules;
+
+    MODULEENTRY32 entry;
+    entry.dwSize = sizeof(entry);
+    for (BOOL found = Module32First(snapshot.get(), &entry); found;
+         found = Module32Next(snapshot.get(), &entry)) {
+        if (auto module = PinModule(entry.hModule)) {
+            modules.push_back(std::move(module));
+        }
+    }
+
+    return modules;
+}
+
+}  // namespace
+
+// static
+ImportHooks& ImportHooks::GetInstance() {
+    STATIC_INIT_ONCE(NoDestructorIfTerminating<ImportHooks>, s);
+    return **s;
+}
+
+ImportHooks::ImportHooks() = default;
+
+HANDLE ImportHooks::Set(void* owner,
+                        HMODULE module,
+                        PCWSTR dllName,
+                        PCSTR functionName,
+                        void* hookFunction,
+                        void** originalFunction,
+                        bool patchExportTable,
+                        void* replaceOwner) {
+    HMODULE dllModule = GetModuleHandle(dllName);
+    if (!dllModule) {
+        throw std::runtime_error("The DLL isn't loaded");
+    }
+
+    if (patchExportTable) {
+        // The export table entry and the stub outlive the hook, so the DLL is
+        // kept loaded.
+        THROW_IF_WIN32_BOOL_FALSE(GetModuleHandleEx(
+            GET_MODULE_HANDLE_EX_FLAG_PIN, dllName, &dllModule));
+    }
+
+    void* targetFunction = GetProcAddress(dllModule, functionName);
+    if (!targetFunction) {
+        throw std::runtime_error("The function isn't exported");
+    }
+
+    auto hook = std::make_unique<Hook>();
+    hook->owner = owner;
+    hook->module = module;
+    hook->hookFunction = hookFunction;
+
+    Hook* key = hook.get();
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        // If the export table was patched, the stub is returned. If the stub
+        // is idle, or its hook is taken over, the function it jumps to is used
+        // instead. Otherwise, the new hook is chained after the existing one.
+        if (ExportStub* stub = FindStubLocked(targetFunction)) {
+            if (!stub->activeHook ||
+                (replaceOwner && stub->activeHook->owner == replaceOwner)) {
+                hook->replaceValues.push_back(targetFunction);
+                targetFunction = stub->originalTarget;
+            }
+        }
+
+        hook->targetFunction = targetFunction;
+        hook->replaceValues.push_back(targetFunction);
+
+        if (replaceOwner) {
+            for (const auto& [otherKey, other] : m_hooks) {
+                if (other->owner == replaceOwner &&
+                    other->targetFunction == targetFunction) {
+                    hook->replaceValues.push_back(other->hookFunction);
+                }
+            }
+        }
+
+        if (originalFunction) {
+            *originalFunction = targetFunction;
+        }
+
+        if (patchExportTable) {
+            PatchExportTableLocked(*hook, dllModule, functionName,
+                                   replaceOwner);
+        }
+
+        m_hooks.emplace(key, std::move(hook));
+    }
+
+    std::vector<wil::unique_hmodule> pinnedModules;
+
+    try {
+        if (!module) {
+            AddModuleLoadCallbacks();
+
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                key->hasModuleLoadCallbacks = true;
+            }
+
+            // Registered first, so that no load is missed.
+            pinnedModules = PinLoadedModules();
+        }
+    } catch (...) {
+        Remove(owner, key);
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if (module) {
+            PatchModuleLocked({&key, 1}, module);
+        } else {
+            for (const auto& pinnedModule : pinnedModules) {
+                PatchModuleLocked({&key, 1}, pinnedModule.get());
+            }
+        }
+
+        VERBOSE(L"Patched %zu import table slots",
+                key->patchedSlots.size());
+    }
+
+    return key;
+}
+
+bool ImportHooks::Remove(void* owner, HANDLE hookHandle) {
+    std::unique_ptr<Hook> hook;
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        auto it = m_hooks.find(static_cast<Hook*>(hookHandle));
+        if (it == m_hooks.end() || it->second->owner != owner) {
+            return false;
+        }
+
+        hook = std::move(it->second);
+        m_hooks.erase(it);
+    }
+
+    // The callbacks only patch hooks which are in m_hooks, so no more slots
+    // are patched.
+    if (hook->hasModuleLoadCallbacks) {
+        RemoveModuleLoadCallbacks();
+    }
+
+    // Slots of modules which were unloaded in the meantime are skipped.
+    std::unordered_map<HMODULE, wil::unique_hmodule> pinnedModules;
+    for (const auto& [module, slot] : hook->patchedSlots) {
+        if (!pinnedModules.contains(module)) {
+            pinnedModules.try_emplace(module, PinModule(module));
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        for (const auto& [module, slot] : hook->patchedSlots) {
+            if (pinnedModules.at(module)) {
+                CompareExchangeProtected(slot, hook->hookFunction,
+                                         hook->targetFunction);
+            }
+        }
+
+        ExportStub* stub = hook->exportStub;
+        if (stub && stub->activeHook == hook.get()) {
+            std::atomic_ref<void*>(*stub->jumpTarget)
+                .store(stub->originalTarget);
+            stub->activeHook = nullptr;
+
+            // Fails if another hook was chained after this one.
+            CompareExchangeProtected(stub->entry, stub->stubRva,
+                                     stub->originalRva);
+        }
+    }
+
+    return true;
+}
+
+void ImportHooks::RemoveAll(void* owner) {
+    std::vector<HANDLE> hooks;
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        for (const auto& [key, hook] : m_hooks) {
+            if (hook->owner == owner) {
+                hooks.push_back(key);
+            }
+        }
+    }
+
+    for (HANDLE hook : hooks) {
+        Remove(owner, hook);
+    }
+}
+
+void ImportHooks::PatchModuleLocked(std::span<Hook* const> hooks,
+                                    HMODULE module) {
+    // The imports of the engine are used while patching.
+    if (module == g_hDllInst) {
+        return;
+    }
+
+    // Slots are matched by value rather than by name, which also covers
+    // imports from API sets and forwarded exports. A slot which was patched by
+    // one hook can be patched again by a hook which takes it over.
+    ImportTable::ForEachImportSlot(module, [&](void** slot) {
+        void* value = *slot;
+        for (Hook* hook : hooks) {
+            if (std::find(hook->replaceValues.begin(),
+                          hook->replaceValues.end(),
+                          value) == hook->replaceValues.end()) {
+                continue;
+            }
+
+            if (CompareExchangeProtected(slot, value, hook->hookFunction)) {
+                hook->patchedSlots.push_back({module, slot});
+                value = hook->hookFunction;
+            }
+        }
+    });
+}
+
+void ImportHooks::PatchExportTableLocked(Hook& hook,
+                                         HMODULE dllModule,
+                                         PCSTR functionName,
+                                         void* replaceOwner) {
+    DWORD* entry = ImportTable::FindExportEntry(dllModule, functionName);
+    if (!entry) {
+        throw std::runtime_error("Export table entry not found");
+    }
+
+    DWORD currentRva = *entry;
+
+    // Reuse the stub the entry points to if it's idle or taken over, or an
+    // idle stub if the entry was restored.
+    for (const auto& stub : m_exportStubs) {
+        if (stub->entry != entry) {
+            continue;
+        }
+
+        if (stub->stubRva == currentRva) {
+            if (!stub->activeHook) {
+                std::atomic_ref<void*>(*stub->jumpTarget)
+                    .store(hook.hookFunction);
+            } else if (replaceOwner &&
+                       stub->activeHook->owner == replaceOwner) {
+                std::atomic_ref<void*>(*stub->jumpTarget)
+                    .store(hook.hookFunction);
+            } else {
+                // Chain after the active hook with a new stub.
+                break;
+            }
+        } else if (!stub->activeHook && stub->originalRva == currentRva) {
+            std::atomic_ref<void*>(*stub->jumpTarget).store(hook.hookFunction);
+            if (!CompareExchangeProtected(entry, currentRva, stub->stubRva)) {
+                std::atomic_ref<void*>(*stub->jumpTarget)
+                    .store(stub->originalTarget);
+                throw std::runtime_error("Failed to patch the export table");
+            }
+        } else {
+            continue;
+        }
+
+        stub->activeHook = &hook;
+        hook.exportStub = stub.get();
+        return;
+    }
+
+    m_exportStubs.reserve(m_exportStubs.size() + 1);
+
+    void* memory = AllocateStubMemory(dllModule);
+    if (!memory) {
+        throw std::runtime_error("Failed to allocate a stub near the DLL");
+    }
+
+    auto freeMemoryOnFailure = wil::scope_exit(
+        [memory] { VirtualFree(memory, 0, MEM_RELEASE); });
+
+    auto stub = std::make_unique<ExportStub>();
+    stub->entry = entry;
+    stub->originalRva = currentRva;
+    stub->stubRva = static_cast<DWORD>(reinterpret_cast<ULONG_PTR>(memory) -
+                                       reinterpret_cast<ULONG_PTR>(dllModule));
+    stub->originalTarget = hook.targetFunction;
+    stub->jumpTarget = WriteStubCode(memory);
+    stub->code = memory;
+
+    *stub->jumpTarget = hook.hookFunction;
+
+    if (!CompareExchangeProtected(entry, currentRva, stub->stubRva)) {
+        throw std::runtime_error("Failed to patch the export table");
+    }
+
+    freeMemoryOnFailure.release();
+
+    stub->activeHook = &hook;
+    hook.exportStub = stub.get();
+    m_exportStubs.push_back(std::move(stub));
+}
+
+ImportHooks::ExportStub* ImportHooks::FindStubLocked(void* code) {
+    for (const auto& stub : m_exportStubs) {
+        if (stub->code == code) {
+            return stub.get();
+        }
+    }
+
+    return nullptr;
+}
+
+void ImportHooks::AddModuleLoadCallbacks() {
+    std::lock_guard<std::mutex> guard(m_moduleLoadCallbacksMutex);
+
+    if (m_moduleLoadCallbacksCount == 0) {
+        auto unregisterOnFailure = wil::scope_exit([this] {
+            for (HANDLE registration : m_moduleLoadRegistrations) {
+                ModuleLoadNotifier::GetInstance().Unregister(this,
+                                                             registration);
+            }
+
+            m_moduleLoadRegistrations.clear();
+        });
+
+        // Imports might not be resolved yet when the notification of a module
+        // load arrives, in which case the module is patched once the load
+        // completes. Patching a module twice does nothing.
+        for (bool async : {false, true}) {
+            HANDLE registration = ModuleLoadNotifier::GetInstance().Register(
+                this, L"*",
+                [this](HMODULE loadedModule, PCWSTR moduleName) {
+                    OnModuleLoaded(loadedModule);
+                },
+                async);
+            if (!registration) {
+                throw std::runtime_error(
+                    "Failed to register a module load callback");
+            }
+
+            m_moduleLoadRegistrations.push_back(registration);
+        }
+
+        unregisterOnFailure.release();
+    }
+
+    m_moduleLoadCallbacksCount++;
+}
+
+void ImportHooks::RemoveModuleLoadCallbacks() {
+    std::lock_guard<std::mutex> guard(m_moduleLoadCallbacksMutex);
+
+    if (--m_moduleLoadCallbacksCount > 0) {
+        return;
+    }
+
+    // The loader lock might be needed to unregister, so it's done without
+    // holding m_mutex, which the callbacks acquire while holding the loader
+    // lock.
+    for (HANDLE registration : m_moduleLoadRegistrations) {
+        ModuleLoadNotifier::GetInstance().Unregister(this, registration);
+    }
+
+    m_moduleLoadRegistrations.clear();
+}
+
+void ImportHooks::OnModuleLoaded(HMODULE module) {
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    // All hooks of all modules are patched in a single walk of the import
+    // table.
+    std::vector<Hook*> hooks;
+    for (const auto& [key, hook] : m_hooks) {
+        if (!hook->module) {
+            hooks.push_back(key);
+        }
+    }
+
+    if (!hooks.empty()) {
+        PatchModuleLocked(hooks, module);
+    }
+}
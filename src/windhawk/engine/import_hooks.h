@@ -0,0 +1,96 @@
+#pragma once
+
+// Hooks functions by replacing their pointers in the import address tables of
+// modules, and optionally in the export table of the DLL which exports them.
+// Each pointer is replaced with a single atomic write, so that, unlike with
+// inline hooks, no threads have to be frozen to set or remove a hook.
+//
+// An import table slot is only replaced if it points to the target function,
+// so that slots which were replaced by others aren't overwritten, and it's
+// only restored if it still points to the hook.
+//
+// The export table holds 32-bit offsets from the DLL base, so the hook can't
+// be written to it directly. Instead, it points to a stub which jumps through
+// a pointer. When the hook is removed, the pointer is set back to the target
+// function, since callers may still hold the address of the stub. Stubs are
+// therefore never freed, and are reused when the same function is hooked
+// again.
+class ImportHooks {
+   public:
+    static ImportHooks& GetInstance();
+
+    ImportHooks(const ImportHooks&) = delete;
+    ImportHooks& operator=(const ImportHooks&) = delete;
+
+    ImportHooks();
+
+    // If module is nullptr, all loaded modules are patched, and modules which
+    // are loaded later are patched while they're being loaded. Hooks of
+    // replaceOwner on the same function are taken over, as used for hot
+    // swapping a mod. originalFunction is set before any pointer is replaced.
+    // Throws on failure.
+    HANDLE Set(void* owner,
+               HMODULE module,
+               PCWSTR dllName,
+               PCSTR functionName,
+               void* hookFunction,
+               void** originalFunction,
+               bool patchExportTable,
+               void* replaceOwner);
+
+    // Once this returns, the hook won't be called by new callers, but it might
+    // still be running.
+    bool Remove(void* owner, HANDLE hook);
+    void RemoveAll(void* owner);
+
+   private:
+    struct Hook;
+
+    struct ExportStub {
+        // The export table entry which points to the stub.
+        DWORD* entry;
+        DWORD originalRva;
+        DWORD stubRva;
+        void* originalTarget;
+        // The stub jumps through this pointer, which is either the hook
+        // function of activeHook, or originalTarget if it's nullptr.
+        void** jumpTarget;
+        void* code;
+        Hook* activeHook = nullptr;
+    };
+
+    struct Hook {
+        void* owner;
+        HMODULE module;
+        void* targetFunction;
+        void* hookFunction;
+        // Import table slots with one of these values are replaced.
+        std::vector<void*> replaceValues;
+        // Set for hooks of all modules, which hold a reference to the module
+        // load callbacks.
+        bool hasModuleLoadCallbacks = false;
+        std::vector<std::pair<HMODULE, void**>> patchedSlots;
+        ExportStub* exportStub = nullptr;
+    };
+
+    // Patches the module for all hooks in a single walk of its imports.
+    void PatchModuleLocked(std::span<Hook* const> hooks, HMODULE module);
+    void PatchExportTableLocked(Hook& hook,
+                                HMODULE dllModule,
+                                PCSTR functionName,
+                                void* replaceOwner);
+    ExportStub* FindStubLocked(void* code);
+    // The module load callbacks are shared by all hooks of all modules, and
+    // are registered while there's at least one such hook.
+    void AddModuleLoadCallbacks();
+    void RemoveModuleLoadCallbacks();
+    void OnModuleLoaded(HMODULE module);
+
+    std::mutex m_mutex;
+    std::unordered_map<Hook*, std::unique_ptr<Hook>> m_hooks;
+    std::vector<std::unique_ptr<ExportStub>> m_exportStubs;
+
+    std::mutex m_moduleLoadCallbacksMutex;
+    size_t m_moduleLoadCallbacksCount = 0;
+    std::vector<HANDLE> m_moduleLoadRegistrations;
+};
@@ -0,0 +1,136 @@
+#include "stdafx.h"
+
+#include "import_table.h"
+
+namespace ImportTable {
+
+IMAGE_NT_HEADERS* GetNtHeaders(HMODULE module) {
+    auto* base = reinterpret_cast<BYTE*>(module);
+    auto* dosHeader = reinterpret_cast<IMAGE_DOS_HEADER*>(base);
+    return reinterpret_cast<IMAGE_NT_HEADERS*>(base + dosHeader->e_lfanew);
+}
+
+const IMAGE_DATA_DIRECTORY* GetDataDirectory(HMODULE module, int index) {
+    auto* ntHeaders = GetNtHeaders(module);
+    if (ntHeaders->OptionalHeader.NumberOfRvaAndSizes <=
+            static_cast<DWORD>(index) ||
+        !ntHeaders->OptionalHeader.DataDirectory[index].VirtualAddress) {
+        return nullptr;
+    }
+
+    return &ntHeaders->OptionalHeader.DataDirectory[index];
+}
+
+DWORD* FindExportEntry(HMODULE module, PCSTR functionName) {
+    auto* exportDataDirectory =
+        GetDataDirectory(module, IMAGE_DIRECTORY_ENTRY_EXPORT);
+    if (!exportDataDirectory) {
+        return nullptr;
+    }
+
+    auto* base = reinterpret_cast<BYTE*>(module);
+    auto* exportDirectory = reinterpret_cast<IMAGE_EXPORT_DIRECTORY*>(
+        base + exportDataDirectory->VirtualAddress);
+    auto* functions =
+        reinterpret_cast<DWORD*>(base + exportDirectory->AddressOfFunctions);
+
+    DWORD index;
+    if (IS_INTRESOURCE(functionName)) {
+        DWORD ordinal = LOWORD(reinterpret_cast<ULONG_PTR>(functionName));
+        if (ordinal < exportDirectory->Base) {
+            return nullptr;
+        }
+
+        index = ordinal - exportDirectory->Base;
+    } else {
+        // Names are sorted, same as the loader assumes.
+        auto* names =
+            reinterpret_cast<DWORD*>(base + exportDirectory->AddressOfNames);
+        auto* nameOrdinals = reinterpret_cast<WORD*>(
+            base + exportDirectory->AddressOfNameOrdinals);
+
+        DWORD low = 0;
+        DWORD high = exportDirectory->NumberOfNames;
+        while (low < high) {
+            DWORD middle = low + (high - low) / 2;
+            int compare = strcmp(
+                reinterpret_cast<PCSTR>(base + names[middle]), functionName);
+            if (compare < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+
+        if (low == exportDirectory->NumberOfNames ||
+            strcmp(reinterpret_cast<PCSTR>(base + names[low]),
+                   functionName) != 0) {
+            return nullptr;
+        }
+
+        index = nameOrdinals[low];
+    }
+
+    if (index >= exportDirectory->NumberOfFunctions) {
+        return nullptr;
+    }
+
+    return &functions[index];
+}
+
+void ForEachImportSlot(HMODULE module,
+                       const std::function<void(void** slot)>& callback) {
+    auto* importDataDirectory =
+        GetDataDirectory(module, IMAGE_DIRECTORY_ENTRY_IMPORT);
+    if (!importDataDirectory) {
+        return;
+    }
+
+    auto* base = reinterpret_cast<BYTE*>(module);
+
+    for (auto* importDescriptor = reinterpret_cast<IMAGE_IMPORT_DESCRIPTOR*>(
+             base + importDataDirectory->VirtualAddress);
+         importDescriptor->Name; importDescriptor++) {
+        for (auto* slot =
+                 reinterpret_cast<void**>(base + importDescriptor->FirstThunk);
+             *slot; slot++) {
+            callback(slot);
+        }
+    }
+}
+
+void WriteStubCode(BYTE* code, void* const* jumpTarget) {
+#if defined(_M_IX86)
+    // jmp dword ptr [jumpTarget]
+    code[0] = 0xFF;
+    code[1] = 0x25;
+    DWORD address = static_cast<DWORD>(reinterpret_cast<ULONG_PTR>(jumpTarget));
+    memcpy(code + 2, &address, sizeof(address));
+    // int3
+    code[6] = 0xCC;
+    code[7] = 0xCC;
+#elif defined(_M_X64)
+    // jmp qword ptr [rip+disp32]
+    code[0] = 0xFF;
+    code[1] = 0x25;
+    LONG disp = static_cast<LONG>(reinterpret_cast<const BYTE*>(jumpTarget) -
+                                  (code + 6));
+    memcpy(code + 2, &disp, sizeof(disp));
+    // int3
+    code[6] = 0xCC;
+    code[7] = 0xCC;
+#elif defined(_M_ARM64)
+    ptrdiff_t offset = reinterpret_cast<const BYTE*>(jumpTarget) - code;
+    DWORD instructions[] = {
+        // ldr x17, jumpTarget
+        0x58000011 | ((static_cast<DWORD>(offset / 4) & 0x7FFFF) << 5),
+        // br x17
+        0xD61F0220,
+    };
+    memcpy(code, instructions, sizeof(instructions));
+#else
+#error "Unsupported architecture"
+#endif
+}
+
+}  // namespace ImportTable
@@ -0,0 +1,31 @@
+#pragma once
+
+// Walks of the import and export tables of a mapped image, and the code of the
+// export table stubs of ImportHooks. Only depends on the PE structures, so
+// that it can be tested with synthetic images.
+namespace ImportTable {
+
+IMAGE_NT_HEADERS* GetNtHeaders(HMODULE module);
+
+// Returns nullptr if the image has no such directory.
+const IMAGE_DATA_DIRECTORY* GetDataDirectory(HMODULE module, int index);
+
+// Returns the entry of the export address table which holds the RVA of the
+// function, which is exported by name or by ordinal, as with GetProcAddress.
+// Returns nullptr if the function isn't exported.
+DWORD* FindExportEntry(HMODULE module, PCSTR functionName);
+
+// Calls callback for each slot of the import address tables of the module,
+// which hold the resolved addresses of its imports.
+void ForEachImportSlot(HMODULE module,
+                       const std::function<void(void** slot)>& callback);
+
+// The size of the code of a stub, see WriteStubCode.
+inline constexpr size_t kStubCodeSize = 8;
+
+// Writes code which jumps to the address which is stored at jumpTarget. On
+// x64, jumpTarget must be within 2 GB of the code, and on ARM64, within 1 MB,
+// and aligned to 4 bytes.
+void WriteStubCode(BYTE* code, void* const* jumpTarget);
+
+}  // namespace ImportTable
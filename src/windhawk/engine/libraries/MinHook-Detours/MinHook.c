@@ -389,6 +389,66 @@ static MH_STATUS EnableHook(ULONG_PTR hookIdent, LPVOID pTarget, BOOL enable)
     return status;
 }
 
+static MH_STATUS SetHookDetour(ULONG_PTR hookIdent, LPVOID pTarget, ULONG_PTR newHookIdent, LPVOID pDetour, LPVOID *ppOriginal)
+{
+    if (hookIdent == MH_ALL_IDENTS || newHookIdent == MH_ALL_IDENTS || pTarget == MH_ALL_HOOKS)
+        return MH_ERROR_UNSUPPORTED_FUNCTION;
+
+    if (newHookIdent != hookIdent && FindHookEntry(newHookIdent, pTarget, 0) != INVALID_HOOK_POS)
+        return MH_ERROR_ALREADY_CREATED;
+
+    if (!IsExecutableAddress(pDetour))
+        return MH_ERROR_NOT_EXECUTABLE;
+
+    UINT pos = FindHookEntry(hookIdent, pTarget, 0);
+    if (pos == INVALID_HOOK_POS)
+        return MH_ERROR_NOT_CREATED;
+
+    PHOOK_ENTRY pHook = &g_hooks.pItems[pos];
+    if (!pHook->isEnabled || !pHook->queueEnable)
+        return MH_ERROR_DISABLED;
+
+    LPVOID pTrampoline = pHook->ppOriginal ? *pHook->ppOriginal : pHook->pTargetOrTrampoline;
+
+    if (ppOriginal)
+    {
+        // Same as in CreateHook, other hooks which use the ppOriginal pointer
+        // are modified to use pTargetOrTrampoline.
+        for (UINT i = 0; i < g_hooks.size; ++i)
+        {
+            PHOOK_ENTRY pHookIter = &g_hooks.pItems[i];
+            if (pHookIter != pHook && pHookIter->ppOriginal == ppOriginal)
+            {
+                pHookIter->pTargetOrTrampoline = *pHookIter->ppOriginal;
+                pHookIter->ppOriginal = NULL;
+            }
+        }
+
+        // Must be set before the new detour can be called.
+        *ppOriginal = pTrampoline;
+    }
+
+    HRESULT hr = SlimDetoursSetDetour(pTrampoline, pHook->pDetour, pDetour);
+    if (FAILED(hr))
+        return MH_ERROR_UNSUPPORTED_FUNCTION;
+
+    pHook->hookIdent = newHookIdent;
+    pHook->pDetour = pDetour;
+
+    if (ppOriginal)
+    {
+        pHook->pTargetOrTrampoline = NULL;
+        pHook->ppOriginal = ppOriginal;
+    }
+    else
+    {
+        pHook->pTargetOrTrampoline = pTrampoline;
+        pHook->ppOriginal = NULL;
+    }
+
+    return MH_OK;
+}
+
 static void RemoveDisabledHooks(ULONG_PTR hookIdent, LPVOID pTarget)
 {
     UINT pos = FindHookEntryEnabled(hookIdent, pTarget, 0, FALSE);
@@ -669,6 +729,20 @@ MH_STATUS WINAPI MH_RemoveDisabledHooksEx(ULONG_PTR hookIdent)
     return MH_OK;
 }
 
+MH_STATUS WINAPI MH_SetHookDetourEx(ULONG_PTR hookIdent, LPVOID pTarget, ULONG_PTR newHookIdent, LPVOID pDetour, LPVOID *ppOriginal)
+{
+    if (!g_initialized)
+        return MH_ERROR_NOT_INITIALIZED;
+
+    EnterCriticalSection(&g_criticalSection);
+
+    MH_STATUS status = SetHookDetour(hookIdent, pTarget, newHookIdent, pDetour, ppOriginal);
+
+    LeaveCriticalSection(&g_criticalSection);
+
+    return status;
+}
+
 MH_STATUS WINAPI MH_EnableHook(LPVOID pTarget)
 {
     return MH_EnableHookEx(MH_DEFAULT_IDENT, pTarget);
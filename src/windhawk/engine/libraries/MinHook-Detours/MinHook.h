@@ -202,6 +202,21 @@ extern "C" {
     MH_STATUS WINAPI MH_RemoveDisabledHooks();
     MH_STATUS WINAPI MH_RemoveDisabledHooksEx(ULONG_PTR hookIdent);
 
+    // Replaces the detour of an enabled hook and moves the hook to another
+    // hook identifier. The target and the trampoline aren't modified, and
+    // threads aren't suspended. Threads which already entered the previous
+    // detour keep running it.
+    // Parameters:
+    //   hookIdent    [in]  The hook identifier of the enabled hook.
+    //   pTarget      [in]  A pointer to the target function.
+    //   newHookIdent [in]  The new hook identifier, can be the same as
+    //                      hookIdent.
+    //   pDetour      [in]  A pointer to the new detour function.
+    //   ppOriginal   [out] A pointer to the trampoline function, which will be
+    //                      used to call the original target function.
+    //                      This parameter can be NULL. See MH_CreateHook.
+    MH_STATUS WINAPI MH_SetHookDetourEx(ULONG_PTR hookIdent, LPVOID pTarget, ULONG_PTR newHookIdent, LPVOID pDetour, LPVOID *ppOriginal);
+
     // Enables an already created hook.
     // Parameters:
     //   hookIdent   [in]  A hook identifier, can be set to different values for
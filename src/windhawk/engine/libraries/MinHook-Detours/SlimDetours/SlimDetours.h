@@ -92,6 +92,20 @@ NTAPI
 SlimDetoursFreeTrampoline(
     _In_ PVOID pTrampoline);
 
+/// <summary>
+/// Replace the detour of an attached hook without suspending threads
+/// </summary>
+/// <param name="pPointer">The trampoline, as stored in ppPointer by SlimDetoursAttach.</param>
+/// <param name="pDetour">The current detour.</param>
+/// <param name="pNewDetour">The new detour.</param>
+/// <returns>Returns HRESULT</returns>
+HRESULT
+NTAPI
+SlimDetoursSetDetour(
+    _In_ PVOID pPointer,
+    _In_ PVOID pDetour,
+    _In_ PVOID pNewDetour);
+
 PVOID
 NTAPI
 SlimDetoursCodeFromPointer(
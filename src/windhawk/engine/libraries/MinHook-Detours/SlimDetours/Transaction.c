@@ -642,6 +642,72 @@ fail:
     return HRESULT_FROM_NT(Status);
 }
 
+HRESULT
+NTAPI
+SlimDetoursSetDetour(
+    _In_ PVOID pPointer,
+    _In_ PVOID pDetour,
+    _In_ PVOID pNewDetour)
+{
+    // This function can be called as part of a transaction or outside of a transaction.
+    HANDLE nPrevPendingThreadId = _InterlockedCompareExchangePointer(&s_nPendingThreadId, NtCurrentThreadId(), NULL);
+    BOOL bInTransaction = nPrevPendingThreadId != NULL;
+    if (bInTransaction && nPrevPendingThreadId != NtCurrentThreadId())
+    {
+        return HRESULT_FROM_NT(STATUS_TRANSACTIONAL_CONFLICT);
+    }
+
+    NTSTATUS Status;
+    PDETOUR_TRAMPOLINE pTrampoline = (PDETOUR_TRAMPOLINE)pPointer;
+    pDetour = detour_skip_jmp((PBYTE)pDetour);
+    pNewDetour = detour_skip_jmp((PBYTE)pNewDetour);
+
+    ////////////////////////////////////// Verify that Trampoline is in place.
+    //
+    LONG cbTarget = pTrampoline->cbRestore;
+    if (cbTarget == 0 || cbTarget > sizeof(pTrampoline->rbCode) || pTrampoline->pbDetour != pDetour)
+    {
+        Status = STATUS_INVALID_BLOCK_LENGTH;
+        DETOUR_BREAK();
+        goto fail;
+    }
+
+    if (!bInTransaction)
+    {
+        // Make sure the trampoline pages are writable.
+        Status = detour_writable_trampoline_regions();
+        if (!NT_SUCCESS(Status))
+        {
+            goto fail;
+        }
+    }
+
+    // The target jumps to the detour indirectly through pbDetour, so a single
+    // pointer write redirects it without suspending threads. Threads which
+    // already entered the previous detour keep running it.
+    _InterlockedExchangePointer((PVOID volatile*)&pTrampoline->pbDetour, pNewDetour);
+
+    if (!bInTransaction)
+    {
+        detour_runnable_trampoline_regions();
+    }
+
+    Status = STATUS_SUCCESS;
+
+fail:
+    if (!bInTransaction)
+    {
+#ifdef _MSC_VER
+#pragma warning(disable: __WARNING_INTERLOCKED_ACCESS)
+#endif
+        s_nPendingThreadId = NULL;
+#ifdef _MSC_VER
+#pragma warning(default: __WARNING_INTERLOCKED_ACCESS)
+#endif
+    }
+    return HRESULT_FROM_NT(Status);
+}
+
 HRESULT
 NTAPI
 SlimDetoursUninitialize(VOID)
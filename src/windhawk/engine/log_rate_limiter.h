@@ -0,0 +1,194 @@
+#pragma once
+
+// Rate limiting of mod log lines, so that a mod which logs in a hot hook can't
+// slow down the process it's loaded in. Lines are limited per mod and per call
+// site, each with a token bucket. Lines over the budget are dropped and
+// counted, and the count is reported periodically by the drain thread of the
+// logger.
+//
+// Each bucket is a single atomic value, the time at which the bucket becomes
+// full again, as in the generic cell rate algorithm, which is equivalent to a
+// token bucket. Taking a token is a load and a CAS.
+//
+// Only the standard library is used here, the current time in milliseconds is
+// passed by the caller.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class LogRateLimiter {
+   public:
+    struct Budget {
+        // 0 for no limit.
+        uint32_t linesPerSecond = 0;
+        // The amount of lines which can be logged at once before the limit
+        // kicks in.
+        uint32_t burst = 0;
+    };
+
+    struct Budgets {
+        Budget mod;
+        Budget callSite;
+    };
+
+    explicit LogRateLimiter(const Budgets& budgets) : m_budgets(budgets) {}
+
+    LogRateLimiter(const LogRateLimiter&) = delete;
+    LogRateLimiter& operator=(const LogRateLimiter&) = delete;
+
+    // A quick check which doesn't take a token, used to skip formatting the
+    // arguments of a line which would be dropped anyway. Counts the line as
+    // suppressed if the mod is over its budget.
+    bool CheckModBudget(uint64_t now) {
+        if (m_modBucket.IsEmpty(now, m_budgets.mod)) {
+            m_suppressedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        return true;
+    }
+
+    // Takes a token for the call site and for the mod. The call site is
+    // identified by an address, such as the address of the format string. If
+    // the mod is over its budget, the token of the call site is returned, so
+    // that a line which isn't logged doesn't count against its call site.
+    bool TryAcquire(const void* callSite, uint64_t now) {
+        TokenBucket* callSiteBucket = GetCallSiteBucket(callSite);
+        if (callSiteBucket &&
+            !callSiteBucket->TryTake(now, m_budgets.callSite)) {
+            m_suppressedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        if (!m_modBucket.TryTake(now, m_budgets.mod)) {
+            if (callSiteBucket) {
+                callSiteBucket->Refund(m_budgets.callSite);
+            }
+
+            m_suppressedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        return true;
+    }
+
+    // Returns the amount of lines which were suppressed since the last report,
+    // or 0 if there's nothing to report yet. Reports are made at most once per
+    // kReportInterval, unless forced.
+    uint32_t TakeSuppressedCount(uint64_t now, bool force = false) {
+        if (m_suppressedCount.load(std::memory_order_relaxed) == 0) {
+            return 0;
+        }
+
+        if (!force) {
+            uint64_t lastReport =
+                m_lastReportTime.load(std::memory_order_relaxed);
+            if (now - lastReport < kReportInterval ||
+                !m_lastReportTime.compare_exchange_strong(
+                    lastReport, now, std::memory_order_relaxed)) {
+                return 0;
+            }
+        }
+
+        return m_suppressedCount.exchange(0, std::memory_order_relaxed);
+    }
+
+   private:
+    static constexpr uint64_t kReportInterval = 1000;
+
+    // Call sites beyond this amount share the mod budget only.
+    static constexpr size_t kCallSiteCount = 64;
+    static constexpr size_t kCallSiteMaxProbes = 8;
+
+    class TokenBucket {
+       public:
+        bool IsEmpty(uint64_t now, const Budget& budget) const {
+            if (budget.linesPerSecond == 0) {
+                return false;
+            }
+
+            return m_fullTime.load(std::memory_order_relaxed) >
+                   now * budget.linesPerSecond + Tolerance(budget);
+        }
+
+        bool TryTake(uint64_t now, const Budget& budget) {
+            if (budget.linesPerSecond == 0) {
+                return true;
+            }
+
+            // Time is measured in units of 1/linesPerSecond milliseconds, so
+            // that each line costs a whole number of units.
+            uint64_t nowUnits = now * budget.linesPerSecond;
+            uint64_t fullTime = m_fullTime.load(std::memory_order_relaxed);
+            uint64_t newFullTime;
+            do {
+                if (fullTime > nowUnits + Tolerance(budget)) {
+                    return false;
+                }
+
+                newFullTime = std::max(fullTime, nowUnits) + kLineCost;
+            } while (!m_fullTime.compare_exchange_weak(
+                fullTime, newFullTime, std::memory_order_relaxed));
+
+            return true;
+        }
+
+        // Returns a token which was taken with TryTake. Tokens which were
+        // taken later aren't affected, as the cost of each line is the same.
+        void Refund(const Budget& budget) {
+            if (budget.linesPerSecond == 0) {
+                return;
+            }
+
+            m_fullTime.fetch_sub(kLineCost, std::memory_order_relaxed);
+        }
+
+       private:
+        // A second in milliseconds.
+        static constexpr uint64_t kLineCost = 1000;
+
+        static uint64_t Tolerance(const Budget& budget) {
+            return (budget.burst > 1 ? budget.burst - 1 : 0) * kLineCost;
+        }
+
+        std::atomic<uint64_t> m_fullTime = 0;
+    };
+
+    struct CallSite {
+        std::atomic<const void*> address = nullptr;
+        TokenBucket bucket;
+    };
+
+    TokenBucket* GetCallSiteBucket(const void* address) {
+        if (m_budgets.callSite.linesPerSecond == 0 || !address) {
+            return nullptr;
+        }
+
+        uintptr_t value = reinterpret_cast<uintptr_t>(address);
+        size_t hash = static_cast<size_t>(value ^ (value >> 6) ^ (value >> 12));
+        for (size_t i = 0; i < kCallSiteMaxProbes; i++) {
+            auto& callSite = m_callSites[(hash + i) % kCallSiteCount];
+            const void* current =
+                callSite.address.load(std::memory_order_relaxed);
+            if (!current &&
+                callSite.address.compare_exchange_strong(
+                    current, address, std::memory_order_relaxed)) {
+                return &callSite.bucket;
+            }
+
+            if (current == address) {
+                return &callSite.bucket;
+            }
+        }
+
+        return nullptr;
+    }
+
+    const Budgets m_budgets;
+    TokenBucket m_modBucket;
+    std::atomic<uint32_t> m_suppressedCount = 0;
+    std::atomic<uint64_t> m_lastReportTime = 0;
+    CallSite m_callSites[kCallSiteCount];
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+// A bounded multi-producer, single-consumer queue of variable-size records,
+// used to hand log lines over to a background thread without taking locks on
+// the logging thread.
+//
+// The storage is divided into fixed-size cells, each with a sequence number
+// (based on Dmitry Vyukov's bounded queue). A record occupies one or more
+// consecutive cells. A producer reserves the cells of a record with a single
+// CAS, which only succeeds if the last reserved cell was already consumed.
+// Since cells are consumed in order, that means that all reserved cells are
+// free. The record is published by updating the sequence number of its first
+// cell.
+//
+// Records are consumed in order, so a producer which is suspended between
+// reserving its cells and publishing them stalls the consumer, even if later
+// records are already published. Once the ring fills up behind it, TryPush
+// fails for all producers. This happens e.g. while the hook engine suspends
+// threads to apply hooks, and lasts until the producer resumes. A producer
+// which is terminated at that point, e.g. with TerminateThread, stalls the
+// consumer for good, and all later records are dropped.
+//
+// Only the standard library is used here.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+template <size_t kCellCount, size_t kCellSize>
+class LogRing {
+    static_assert(kCellCount > 0 && (kCellCount & (kCellCount - 1)) == 0,
+                  "The cell count must be a power of two");
+    static_assert(kCellSize >= sizeof(uint32_t));
+
+   public:
+    // Larger records are rejected.
+    static constexpr size_t kMaxRecordSize =
+        kCellCount / 2 * kCellSize - sizeof(uint32_t);
+
+    LogRing() {
+        for (size_t i = 0; i < kCellCount; i++) {
+            m_sequence[i].store(i, std::memory_order_relaxed);
+        }
+    }
+
+    LogRing(const LogRing&) = delete;
+    LogRing& operator=(const LogRing&) = delete;
+
+    // Can be called concurrently from any number of threads. Returns false if
+    // there's not enough free space.
+    bool TryPush(const void* data, size_t size) {
+        if (size > kMaxRecordSize) {
+            return false;
+        }
+
+        size_t cellCount = CellCountForSize(size);
+
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            size_t last = pos + cellCount - 1;
+            size_t sequence =
+                m_sequence[last & kMask].load(std::memory_order_acquire);
+            intptr_t diff =
+                static_cast<intptr_t>(sequence) - static_cast<intptr_t>(last);
+            if (diff == 0) {
+                if (m_enqueuePos.compare_exchange_weak(
+                        pos, pos + cellCount, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        uint32_t recordSize = static_cast<uint32_t>(size);
+        CopyIn(pos, 0, &recordSize, sizeof(recordSize));
+        CopyIn(pos, sizeof(recordSize), data, size);
+
+        m_sequence[pos & kMask].store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Must only be called by the consumer. Returns false if the queue is empty
+    // or if the next record isn't published yet. A record which doesn't fit in
+    // the buffer is truncated.
+    bool TryPop(void* buffer, size_t bufferSize, size_t* size) {
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        if (m_sequence[pos & kMask].load(std::memory_order_acquire) !=
+            pos + 1) {
+            return false;
+        }
+
+        uint32_t recordSize;
+        CopyOut(pos, 0, &recordSize, sizeof(recordSize));
+
+        size_t copySize = recordSize < bufferSize ? recordSize : bufferSize;
+        CopyOut(pos, sizeof(recordSize), buffer, copySize);
+        *size = copySize;
+
+        size_t cellCount = CellCountForSize(recordSize);
+        for (size_t i = 0; i < cellCount; i++) {
+            m_sequence[(pos + i) & kMask].store(pos + i + kCellCount,
+                                                std::memory_order_release);
+        }
+
+        m_dequeuePos.store(pos + cellCount, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Must only be called by the consumer.
+    bool IsEmpty() {
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        return m_sequence[pos & kMask].load(std::memory_order_acquire) !=
+               pos + 1;
+    }
+
+   private:
+    static constexpr size_t kMask = kCellCount - 1;
+
+    static constexpr size_t CellCountForSize(size_t size) {
+        return (sizeof(uint32_t) + size + kCellSize - 1) / kCellSize;
+    }
+
+    // The cells of a record are consecutive, but might wrap around the end of
+    // the storage.
+    void CopyIn(size_t pos, size_t offset, const void* data, size_t size) {
+        size_t start = ((pos & kMask) * kCellSize + offset) % sizeof(m_data);
+        size_t firstPart = sizeof(m_data) - start;
+        if (firstPart >= size) {
+            memcpy(m_data + start, data, size);
+        } else {
+            memcpy(m_data + start, data, firstPart);
+            memcpy(m_data, static_cast<const std::byte*>(data) + firstPart,
+                   size - firstPart);
+        }
+    }
+
+    void CopyOut(size_t pos, size_t offset, void* data, size_t size) {
+        size_t start = ((pos & kMask) * kCellSize + offset) % sizeof(m_data);
+        size_t firstPart = sizeof(m_data) - start;
+        if (firstPart >= size) {
+            memcpy(data, m_data + start, size);
+        } else {
+            memcpy(data, m_data + start, firstPart);
+            memcpy(static_cast<std::byte*>(data) + firstPart, m_data,
+                   size - firstPart);
+        }
+    }
+
+    alignas(64) std::atomic<size_t> m_enqueuePos = 0;
+    alignas(64) std::atomic<size_t> m_dequeuePos = 0;
+    alignas(64) std::atomic<size_t> m_sequence[kCellCount];
+    std::byte m_data[kCellCount * kCellSize];
+};
@@ -1,11 +1,652 @@
 #include "stdafx.h"
 
+#include "functions.h"
 #include "logger.h"
+#include "memory_usage.h"
+#include "session_log.h"
 #include "storage_manager.h"
 #include "var_init_once.h"
 
+extern HINSTANCE g_hDllInst;
+
 namespace {
 
+// Large enough for a line which is formatted before being queued, see
+// BuildRecord.
+constexpr size_t kMaxRecordSize = 2560;
+
+constexpr size_t kMaxLineLength = 1024;
+
+// The drain thread exits after being idle for this long, releasing its
+// reference to the engine module.
+constexpr DWORD kDrainThreadIdleTimeout = 500;
+
+enum DrainState : DWORD {
+    kDrainThreadRunning = 1,
+    kDrainThreadWaiting = 2,
+};
+
+// A queued record is a RecordHeader followed by the channel characters, the
+// text characters, the format characters if the format is copied, and the
+// packed arguments.
+struct RecordHeader {
+    // nullptr if the format is copied, or if there's no format.
+    PCWSTR format;
+    DWORD threadId;
+    ULONGLONG timestamp;
+    Logger::Verbosity verbosity;
+    // The mod name for mod logs, empty for engine logs.
+    uint16_t channelLength;
+    // Text which was formatted before the line was queued.
+    uint16_t textLength;
+    uint16_t formatLength;
+    uint16_t argsSize;
+};
+
+enum class ArgType : uint8_t {
+    kInt32 = 1,
+    kInt64,
+    kDouble,
+    kPointer,
+    kWideString,
+    kNarrowString,
+};
+
+constexpr uint16_t kNullStringLength = 0xFFFF;
+
+struct FormatSpec {
+    // Including the percent sign.
+    size_t length;
+    // Width and precision given as int arguments.
+    bool widthStar;
+    bool precisionStar;
+    // A precision given as part of the format, or -1.
+    int precision;
+    // Empty for "%%".
+    std::optional<ArgType> argType;
+};
+
+// Parses a conversion specification of the legacy MSVC wide printf functions,
+// in which %s is a wide string and %S is a narrow string. Returns an empty
+// value for unsupported specifications such as %n and %Z, in which case the
+// line is formatted before being queued.
+std::optional<FormatSpec> ParseFormatSpec(PCWSTR spec) {
+    // Long specifications are rare, and it's easier to format them early.
+    constexpr size_t kMaxSpecLength = 32;
+
+    FormatSpec result{
+        .widthStar = false,
+        .precisionStar = false,
+        .precision = -1,
+    };
+
+    PCWSTR p = spec + 1;
+
+    if (*p == L'%') {
+        result.length = 2;
+        return result;
+    }
+
+    while (*p && wcschr(L"-+ #0", *p)) {
+        p++;
+    }
+
+    if (*p == L'*') {
+        result.widthStar = true;
+        p++;
+    } else {
+        while (*p >= L'0' && *p <= L'9') {
+            p++;
+        }
+    }
+
+    if (*p == L'.') {
+        p++;
+        if (*p == L'*') {
+            result.precisionStar = true;
+            p++;
+        } else {
+            result.precision = 0;
+            while (*p >= L'0' && *p <= L'9') {
+                result.precision = result.precision * 10 + (*p - L'0');
+                p++;
+            }
+        }
+    }
+
+    enum class Size {
+        kDefault,
+        kShort,
+        kLong,
+        kInt64,
+        kPtrSize,
+    };
+
+    Size size = Size::kDefault;
+    if (p[0] == L'h') {
+        size = Size::kShort;
+        p += p[1] == L'h' ? 2 : 1;
+    } else if (p[0] == L'l' && p[1] == L'l') {
+        size = Size::kInt64;
+        p += 2;
+    } else if (p[0] == L'l' || p[0] == L'w' || p[0] == L'L') {
+        size = Size::kLong;
+        p++;
+    } else if (p[0] == L'I' && p[1] == L'6' && p[2] == L'4') {
+        size = Size::kInt64;
+        p += 3;
+    } else if (p[0] == L'I' && p[1] == L'3' && p[2] == L'2') {
+        p += 3;
+    } else if (p[0] == L'I' || p[0] == L'z' || p[0] == L't') {
+        size = Size::kPtrSize;
+        p++;
+    } else if (p[0] == L'j') {
+        size = Size::kInt64;
+        p++;
+    }
+
+    switch (*p) {
+        case L'd':
+        case L'i':
+        case L'o':
+        case L'u':
+        case L'x':
+        case L'X':
+            if (size == Size::kInt64 ||
+                (size == Size::kPtrSize && sizeof(size_t) == 8)) {
+                result.argType = ArgType::kInt64;
+            } else {
+                result.argType = ArgType::kInt32;
+            }
+            break;
+
+        case L'c':
+        case L'C':
+            result.argType = ArgType::kInt32;
+            break;
+
+        case L'e':
+        case L'E':
+        case L'f':
+        case L'F':
+        case L'g':
+        case L'G':
+        case L'a':
+        case L'A':
+            result.argType = ArgType::kDouble;
+            break;
+
+        case L'p':
+            result.argType = ArgType::kPointer;
+            break;
+
+        case L's':
+            result.argType = size == Size::kShort ? ArgType::kNarrowString
+                                                  : ArgType::kWideString;
+            break;
+
+        case L'S':
+            result.argType = size == Size::kLong ? ArgType::kWideString
+                                                 : ArgType::kNarrowString;
+            break;
+
+        default:
+            return std::nullopt;
+    }
+
+    result.length = p + 1 - spec;
+    if (result.length > kMaxSpecLength) {
+        return std::nullopt;
+    }
+
+    return result;
+}
+
+class RecordWriter {
+   public:
+    RecordWriter(BYTE* buffer, size_t capacity)
+        : m_buffer(buffer), m_capacity(capacity) {}
+
+    bool Write(const void* data, size_t size) {
+        if (size > m_capacity - m_size) {
+            return false;
+        }
+
+        memcpy(m_buffer + m_size, data, size);
+        m_size += size;
+        return true;
+    }
+
+    template <typename T>
+    bool Write(const T& value) {
+        return Write(&value, sizeof(value));
+    }
+
+    template <typename Char>
+    bool WriteString(const Char* str, int precision) {
+        uint16_t length = kNullStringLength;
+        if (str) {
+            size_t remaining = m_capacity - m_size;
+            if (remaining < sizeof(ArgType) + sizeof(length)) {
+                return false;
+            }
+
+            // Longer strings are truncated. The string might not be
+            // null-terminated if a precision is given.
+            size_t maxLength =
+                (remaining - sizeof(ArgType) - sizeof(length)) / sizeof(Char);
+            if (precision >= 0 && static_cast<size_t>(precision) < maxLength) {
+                maxLength = precision;
+            }
+
+            maxLength = std::min(maxLength, kMaxLineLength);
+
+            if constexpr (std::is_same_v<Char, WCHAR>) {
+                length = static_cast<uint16_t>(wcsnlen(str, maxLength));
+            } else {
+                length = static_cast<uint16_t>(strnlen(str, maxLength));
+            }
+        }
+
+        constexpr auto argType = std::is_same_v<Char, WCHAR>
+                                     ? ArgType::kWideString
+                                     : ArgType::kNarrowString;
+
+        return Write(argType) && Write(length) &&
+               (length == kNullStringLength ||
+                Write(str, length * sizeof(Char)));
+    }
+
+    BYTE* GetBuffer() { return m_buffer; }
+    size_t GetSize() { return m_size; }
+
+   private:
+    BYTE* m_buffer;
+    size_t m_capacity;
+    size_t m_size = 0;
+};
+
+class RecordReader {
+   public:
+    RecordReader(const BYTE* buffer, size_t size)
+        : m_buffer(buffer), m_size(size) {}
+
+    const BYTE* Read(size_t size) {
+        if (size > m_size - m_offset) {
+            return nullptr;
+        }
+
+        const BYTE* data = m_buffer + m_offset;
+        m_offset += size;
+        return data;
+    }
+
+    template <typename T>
+    bool Read(T* value) {
+        const BYTE* data = Read(sizeof(T));
+        if (!data) {
+            return false;
+        }
+
+        memcpy(value, data, sizeof(T));
+        return true;
+    }
+
+   private:
+    const BYTE* m_buffer;
+    size_t m_size;
+    size_t m_offset = 0;
+};
+
+bool PackArgs(RecordWriter& writer, PCWSTR format, va_list args) {
+    for (PCWSTR p = format; *p; p++) {
+        if (*p != L'%') {
+            continue;
+        }
+
+        auto spec = ParseFormatSpec(p);
+        if (!spec) {
+            return false;
+        }
+
+        p += spec->length - 1;
+
+        if (!spec->argType) {
+            continue;
+        }
+
+        if (spec->widthStar) {
+            int width = va_arg(args, int);
+            if (!writer.Write(ArgType::kInt32) || !writer.Write(width)) {
+                return false;
+            }
+        }
+
+        int precision = spec->precision;
+        if (spec->precisionStar) {
+            precision = va_arg(args, int);
+            if (!writer.Write(ArgType::kInt32) || !writer.Write(precision)) {
+                return false;
+            }
+        }
+
+        bool written = false;
+        switch (*spec->argType) {
+            case ArgType::kInt32:
+                written = writer.Write(*spec->argType) &&
+                          writer.Write(va_arg(args, int));
+                break;
+
+            case ArgType::kInt64:
+                written = writer.Write(*spec->argType) &&
+                          writer.Write(va_arg(args, long long));
+                break;
+
+            case ArgType::kDouble:
+                written = writer.Write(*spec->argType) &&
+                          writer.Write(va_arg(args, double));
+                break;
+
+            case ArgType::kPointer:
+                written = writer.Write(*spec->argType) &&
+                          writer.Write(va_arg(args, void*));
+                break;
+
+            case ArgType::kWideString:
+                written = writer.WriteString(va_arg(args, PCWSTR), precision);
+                break;
+
+            case ArgType::kNarrowString:
+                written = writer.WriteString(va_arg(args, PCSTR), precision);
+                break;
+        }
+
+        if (!written) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Builds a record in a buffer of kMaxRecordSize bytes. If the arguments can't
+// be packed, the line is formatted right away and queued as text.
+size_t BuildRecord(BYTE* buffer,
+                   Logger::Verbosity verbosity,
+                   std::wstring_view channel,
+                   PCWSTR format,
+                   bool copyFormat,
+                   va_list args) {
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+    auto argsCopyCleanup = wil::scope_exit([&argsCopy] { va_end(argsCopy); });
+
+    channel = channel.substr(0, SessionLogRing::kChannelMaxLen);
+
+    RecordHeader header{
+        .format = copyFormat ? nullptr : format,
+        .threadId = GetCurrentThreadId(),
+        .timestamp = wil::filetime::to_int64(wil::filetime::get_system_time()),
+        .verbosity = verbosity,
+        .channelLength = static_cast<uint16_t>(channel.length()),
+    };
+
+    size_t formatLength = copyFormat ? wcslen(format) : 0;
+    if (formatLength <= kMaxLineLength) {
+        RecordWriter writer(buffer, kMaxRecordSize);
+        header.formatLength = static_cast<uint16_t>(formatLength);
+
+        if (writer.Write(header) &&
+            writer.Write(channel.data(), channel.length() * sizeof(WCHAR)) &&
+            writer.Write(format, formatLength * sizeof(WCHAR))) {
+            size_t argsOffset = writer.GetSize();
+            if (PackArgs(writer, format, args)) {
+                header.argsSize =
+                    static_cast<uint16_t>(writer.GetSize() - argsOffset);
+                memcpy(buffer, &header, sizeof(header));
+                return writer.GetSize();
+            }
+        }
+    }
+
+    WCHAR text[kMaxLineLength + 1];
+    int len = _vsnwprintf_s(text, _TRUNCATE, format, argsCopy);
+    if (len == -1) {
+        len = kMaxLineLength;
+    }
+
+    header.format = nullptr;
+    header.textLength = static_cast<uint16_t>(len);
+    header.formatLength = 0;
+    header.argsSize = 0;
+
+    RecordWriter writer(buffer, kMaxRecordSize);
+    writer.Write(header);
+    writer.Write(channel.data(), channel.length() * sizeof(WCHAR));
+    writer.Write(text, len * sizeof(WCHAR));
+    return writer.GetSize();
+}
+
+class LineBuilder {
+   public:
+    void Append(std::wstring_view str) {
+        size_t count = std::min(str.length(), kMaxLineLength - m_len);
+        memcpy(m_buffer + m_len, str.data(), count * sizeof(WCHAR));
+        m_len += count;
+        m_buffer[m_len] = L'\0';
+    }
+
+    template <typename T>
+    void AppendFormatted(PCWSTR spec, T value) {
+        int len = _snwprintf_s(m_buffer + m_len, _countof(m_buffer) - m_len,
+                               _TRUNCATE, spec, value);
+        m_len = len == -1 ? kMaxLineLength : m_len + len;
+    }
+
+    PWSTR GetBuffer() { return m_buffer; }
+    int GetLength() { return static_cast<int>(m_len); }
+
+   private:
+    WCHAR m_buffer[kMaxLineLength + 1] = L"";
+    size_t m_len = 0;
+};
+
+void FormatArgs(LineBuilder& line, PCWSTR format, RecordReader& reader) {
+    PCWSTR literalStart = format;
+    for (PCWSTR p = format; *p; p++) {
+        if (*p != L'%') {
+            continue;
+        }
+
+        line.Append(std::wstring_view(literalStart, p - literalStart));
+
+        auto spec = ParseFormatSpec(p);
+        if (!spec) {
+            // Can't happen, the record was built with the same format.
+            return;
+        }
+
+        literalStart = p + spec->length;
+
+        if (!spec->argType) {
+            line.Append(L"%");
+            p += spec->length - 1;
+            continue;
+        }
+
+        // Replace stars with their values, then format a single value.
+        WCHAR singleSpec[64];
+        size_t singleSpecLen = 0;
+        for (size_t i = 0; i < spec->length; i++) {
+            if (p[i] != L'*') {
+                singleSpec[singleSpecLen++] = p[i];
+                continue;
+            }
+
+            ArgType argType;
+            int value;
+            if (!reader.Read(&argType) || !reader.Read(&value)) {
+                return;
+            }
+
+            int len = _snwprintf_s(singleSpec + singleSpecLen,
+                                   _countof(singleSpec) - singleSpecLen - 1,
+                                   _TRUNCATE, L"%d", value);
+            if (len == -1) {
+                return;
+            }
+
+            singleSpecLen += len;
+        }
+
+        singleSpec[singleSpecLen] = L'\0';
+
+        p += spec->length - 1;
+
+        ArgType argType;
+        if (!reader.Read(&argType)) {
+            return;
+        }
+
+        switch (argType) {
+            case ArgType::kInt32: {
+                int value;
+                if (!reader.Read(&value)) {
+                    return;
+                }
+                line.AppendFormatted(singleSpec, value);
+                break;
+            }
+
+            case ArgType::kInt64: {
+                long long value;
+                if (!reader.Read(&value)) {
+                    return;
+                }
+                line.AppendFormatted(singleSpec, value);
+                break;
+            }
+
+            case ArgType::kDouble: {
+                double value;
+                if (!reader.Read(&value)) {
+                    return;
+                }
+                line.AppendFormatted(singleSpec, value);
+                break;
+            }
+
+            case ArgType::kPointer: {
+                void* value;
+                if (!reader.Read(&value)) {
+                    return;
+                }
+                line.AppendFormatted(singleSpec, value);
+                break;
+            }
+
+            case ArgType::kWideString: {
+                uint16_t length;
+                if (!reader.Read(&length)) {
+                    return;
+                }
+
+                if (length == kNullStringLength) {
+                    line.AppendFormatted(singleSpec,
+                                         static_cast<PCWSTR>(nullptr));
+                    break;
+                }
+
+                const BYTE* data = reader.Read(length * sizeof(WCHAR));
+                if (!data) {
+                    return;
+                }
+
+                std::wstring value(reinterpret_cast<PCWSTR>(data), length);
+                line.AppendFormatted(singleSpec, value.c_str());
+                break;
+            }
+
+            case ArgType::kNarrowString: {
+                uint16_t length;
+                if (!reader.Read(&length)) {
+                    return;
+                }
+
+                if (length == kNullStringLength) {
+                    line.AppendFormatted(singleSpec,
+                                         static_cast<PCSTR>(nullptr));
+                    break;
+                }
+
+                const BYTE* data = reader.Read(length);
+                if (!data) {
+                    return;
+                }
+
+                std::string value(reinterpret_cast<PCSTR>(data), length);
+                line.AppendFormatted(singleSpec, value.c_str());
+                break;
+            }
+
+            default:
+                return;
+        }
+    }
+
+    line.Append(literalStart);
+}
+
+bool FormatRecord(const BYTE* record,
+                  size_t size,
+                  RecordHeader* header,
+                  std::wstring_view* channel,
+                  LineBuilder& text) {
+    RecordReader reader(record, size);
+
+    if (!reader.Read(header)) {
+        return false;
+    }
+
+    const BYTE* channelData =
+        reader.Read(header->channelLength * sizeof(WCHAR));
+    const BYTE* textData = reader.Read(header->textLength * sizeof(WCHAR));
+    if (!channelData || !textData) {
+        return false;
+    }
+
+    *channel = std::wstring_view(reinterpret_cast<PCWSTR>(channelData),
+                                 header->channelLength);
+
+    text.Append(std::wstring_view(reinterpret_cast<PCWSTR>(textData),
+                                  header->textLength));
+
+    std::wstring copiedFormat;
+    PCWSTR format = header->format;
+    if (header->formatLength > 0) {
+        const BYTE* data = reader.Read(header->formatLength * sizeof(WCHAR));
+        if (!data) {
+            return false;
+        }
+
+        copiedFormat.assign(reinterpret_cast<PCWSTR>(data),
+                            header->formatLength);
+        format = copiedFormat.c_str();
+    }
+
+    if (format) {
+        const BYTE* args = reader.Read(header->argsSize);
+        if (!args) {
+            return false;
+        }
+
+        RecordReader argsReader(args, header->argsSize);
+        FormatArgs(text, format, argsReader);
+    }
+
+    return true;
+}
+
 Logger::Verbosity GetVerbosityFromConfig() {
     try {
         auto settings = StorageManager::GetInstance().GetAppConfig(L"Settings");
@@ -28,6 +669,13 @@ Logger::Verbosity GetVerbosityFromConfig() {
     return Logger::kDefaultVerbosity;
 }
 
+void LogModLine(Logger& logger, PCWSTR modName, PCWSTR format, ...) {
+    va_list args;
+    va_start(args, format);
+    logger.VLogModLine(modName, format, args);
+    va_end(args);
+}
+
 }  // namespace
 
 Logger::ScopedThreadVerbosity::ScopedThreadVerbosity(Verbosity verbosity) {
@@ -43,6 +691,15 @@ Logger::ScopedThreadVerbosity::~ScopedThreadVerbosity() {
 Logger::Logger(Verbosity initialVerbosity)
     : m_initialVerbosity(initialVerbosity), LoggerBase(initialVerbosity) {}
 
+Logger::~Logger() {
+    // The drain thread holds a reference to the module, so it's not running
+    // unless the process is terminating, in which case it might have been
+    // terminated while draining.
+    if (m_ring) {
+        Drain(/*wait=*/false);
+    }
+}
+
 // static
 Logger& Logger::GetInstance() {
     STATIC_INIT_ONCE(Logger, s, GetVerbosityFromConfig());
@@ -91,3 +748,248 @@ void Logger::ResetThreadVerbosity() {
         SetVerbosity(m_initialVerbosity);
     }
 }
+
+void Logger::VLogLine(Verbosity verbosity, PCWSTR format, va_list args) {
+    BYTE record[kMaxRecordSize];
+    size_t size = BuildRecord(record, verbosity, {}, format,
+                              /*copyFormat=*/false, args);
+    QueueRecord(record, size);
+}
+
+void Logger::LogLine(Verbosity verbosity, PCWSTR format, ...) {
+    va_list args;
+    va_start(args, format);
+    VLogLine(verbosity, format, args);
+    va_end(args);
+}
+
+void Logger::VLogModLine(PCWSTR modName, PCWSTR format, va_list args) {
+    BYTE record[kMaxRecordSize];
+    size_t size = BuildRecord(record, Verbosity::kOn, modName, format,
+                              /*copyFormat=*/true, args);
+    QueueRecord(record, size);
+}
+
+void Logger::SetSessionLog(std::unique_ptr<SessionLog::Writer> sessionLog) {
+    std::lock_guard lock(m_drainMutex);
+    m_sessionLog = std::move(sessionLog);
+}
+
+void Logger::AddRateLimiter(PCWSTR modName, LogRateLimiter* rateLimiter) {
+    std::lock_guard lock(m_rateLimitersMutex);
+    m_rateLimiters.emplace_back(modName, rateLimiter);
+}
+
+void Logger::RemoveRateLimiter(LogRateLimiter* rateLimiter) {
+    // Waits for the drain thread if it's reporting.
+    std::lock_guard lock(m_rateLimitersMutex);
+    std::erase_if(m_rateLimiters, [rateLimiter](const auto& item) {
+        return item.second == rateLimiter;
+    });
+}
+
+void Logger::WakeDrainThread() {
+    if (m_drainState.load(std::memory_order_relaxed) & kDrainThreadRunning) {
+        // The thread reports before exiting, even if it's waiting.
+        return;
+    }
+
+    if (InitRing()) {
+        SignalDrainThread();
+    }
+}
+
+bool Logger::InitRing() {
+    std::call_once(m_ringInitFlag, [this] {
+        wil::unique_event_nothrow ringEvent;
+        if (!ringEvent.try_create(wil::EventOptions::None, nullptr)) {
+            return;
+        }
+
+        m_ring.reset(new (std::nothrow) Ring());
+        if (m_ring) {
+            m_ringEvent = std::move(ringEvent);
+            MemoryUsage::Add(MemoryUsage::Subsystem::kLogging, sizeof(Ring));
+        }
+    });
+
+    return !!m_ring;
+}
+
+void Logger::QueueRecord(const void* record, size_t size) {
+    if (!InitRing()) {
+        // Out of resources, output the line right away.
+        OutputRecord(static_cast<const BYTE*>(record), size, nullptr);
+        return;
+    }
+
+    if (!m_ring->TryPush(record, size)) {
+        m_droppedCount++;
+    }
+
+    SignalDrainThread();
+}
+
+void Logger::SignalDrainThread() {
+    DWORD prevDrainState = m_drainState.exchange(kDrainThreadRunning);
+    if (!(prevDrainState & kDrainThreadRunning)) {
+        StartDrainThread();
+    } else if (prevDrainState & kDrainThreadWaiting) {
+        SetEvent(m_ringEvent.get());
+    }
+}
+
+void Logger::StartDrainThread() {
+    // Bump the reference count of the module to ensure that the module will
+    // stay loaded as long as the thread is executing.
+    HMODULE hDllInst;
+    GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                      reinterpret_cast<LPCWSTR>(g_hDllInst), &hDllInst);
+
+    // The thread doesn't run any code which requires TLS or DllMain
+    // callbacks.
+    wil::unique_process_handle thread(Functions::MyCreateRemoteThread(
+        GetCurrentProcess(),
+        [](LPVOID pThis) -> DWORD {
+            reinterpret_cast<Logger*>(pThis)->RunDrainThread();
+            FreeLibraryAndExitThread(g_hDllInst, 0);
+        },
+        this, Functions::MY_REMOTE_THREAD_THREAD_ATTACH_EXEMPT));
+    if (!thread) {
+        // Can't log the error, output the queued lines from this thread
+        // instead.
+        FreeLibrary(g_hDllInst);
+        m_drainState = 0;
+        Drain(/*wait=*/false);
+        return;
+    }
+
+    Functions::SetThreadDescriptionIfAvailable(thread.get(),
+                                               L"WindhawkLogger");
+}
+
+void Logger::RunDrainThread() {
+    while (true) {
+        Drain(/*wait=*/true);
+
+        if (ReportSuppressedLines(/*force=*/false)) {
+            continue;
+        }
+
+        m_drainState |= kDrainThreadWaiting;
+
+        if (!m_ring->IsEmpty()) {
+            m_drainState &= ~kDrainThreadWaiting;
+            continue;
+        }
+
+        if (WaitForSingleObject(m_ringEvent.get(), kDrainThreadIdleTimeout) !=
+            WAIT_TIMEOUT) {
+            continue;
+        }
+
+        // Report the rest before exiting, since there might be no line to
+        // start the thread again. The reports are queued, which resets the
+        // state.
+        if (ReportSuppressedLines(/*force=*/true)) {
+            continue;
+        }
+
+        // If a line was queued in the meantime, the state was reset by the
+        // producer, which also signaled the event.
+        DWORD expected = kDrainThreadRunning | kDrainThreadWaiting;
+        if (m_drainState.compare_exchange_strong(expected, 0)) {
+            break;
+        }
+    }
+}
+
+// Writes the line to the session log if it's available. The line is also
+// output with OutputDebugString if it couldn't be written or if a debugger is
+// attached.
+// static
+void Logger::OutputRecord(const BYTE* record,
+                          size_t size,
+                          SessionLog::Writer* sessionLog) {
+    RecordHeader header;
+    std::wstring_view channel;
+    LineBuilder text;
+    if (!FormatRecord(record, size, &header, &channel, text)) {
+        return;
+    }
+
+    if (sessionLog) {
+        std::wstring_view textView(text.GetBuffer(), text.GetLength());
+        while (textView.ends_with(L'\n')) {
+            textView.remove_suffix(1);
+        }
+
+        auto severity = header.verbosity >= Logger::Verbosity::kVerbose
+                            ? SessionLogRing::Severity::kVerbose
+                            : SessionLogRing::Severity::kInfo;
+
+        bool written = sessionLog->Write(header.threadId, header.timestamp,
+                                         severity, channel, textView);
+        if (written && !IsDebuggerPresent()) {
+            return;
+        }
+    }
+
+    if (channel.empty()) {
+        OutputLine(text.GetBuffer(), text.GetLength());
+        return;
+    }
+
+    LineBuilder line;
+    line.Append(L"[WH] [");
+    line.Append(channel);
+    line.Append(L"] ");
+    line.Append(std::wstring_view(text.GetBuffer(), text.GetLength()));
+    line.Append(L"\n");
+    OutputLine(line.GetBuffer(), line.GetLength());
+}
+
+void Logger::Drain(bool wait) {
+    std::unique_lock lock(m_drainMutex, std::defer_lock);
+    if (wait) {
+        lock.lock();
+    } else if (!lock.try_lock()) {
+        return;
+    }
+
+    BYTE record[kMaxRecordSize];
+    size_t size;
+    while (m_ring->TryPop(record, sizeof(record), &size)) {
+        OutputRecord(record, size, m_sessionLog.get());
+    }
+
+    DWORD droppedCount = m_droppedCount.exchange(0);
+    if (droppedCount > 0) {
+        WCHAR buffer[128];
+        int len = _snwprintf_s(
+            buffer, _TRUNCATE,
+            L"[WH] [Logger]: %u lines were dropped, the queue was full\n",
+            droppedCount);
+        OutputLine(buffer, len);
+    }
+}
+
+// Queues a line for each mod with suppressed lines. Returns whether any lines
+// were queued.
+bool Logger::ReportSuppressedLines(bool force) {
+    std::lock_guard lock(m_rateLimitersMutex);
+
+    ULONGLONG now = GetTickCount64();
+    bool reported = false;
+    for (auto [modName, rateLimiter] : m_rateLimiters) {
+        DWORD count = rateLimiter->TakeSuppressedCount(now, force);
+        if (count > 0) {
+            LogModLine(*this, modName,
+                       L"%u log lines were suppressed by the rate limit",
+                       count);
+            reported = true;
+        }
+    }
+
+    return reported;
+}
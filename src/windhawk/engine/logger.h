@@ -1,6 +1,9 @@
 #pragma once
 
+#include "log_rate_limiter.h"
+#include "log_ring.h"
 #include "logger_base.h"
+#include "session_log.h"
 
 class Logger : public LoggerBase {
    public:
@@ -20,27 +23,82 @@ class Logger : public LoggerBase {
     };
 
     Logger(Verbosity initialVerbosity);
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger(Logger&&) = delete;
+    Logger& operator=(const Logger&) = delete;
+    Logger& operator=(Logger&&) = delete;
 
     static Logger& GetInstance();
 
     bool ShouldLog(Verbosity verbosity);
 
+    // Lines are queued with their format and a copy of their arguments, and
+    // are formatted and output by a background thread. The format must remain
+    // valid as long as the engine is loaded.
+    void VLogLine(Verbosity verbosity, PCWSTR format, va_list args);
+    void LogLine(Verbosity verbosity, PCWSTR format, ...);
+
+    // Same as above, but the format is owned by the mod, so it's copied too.
+    void VLogModLine(PCWSTR modName, PCWSTR format, va_list args);
+
+    // Once set, lines are written to the session log instead of being output
+    // with OutputDebugString, unless a debugger is attached.
+    void SetSessionLog(std::unique_ptr<SessionLog::Writer> sessionLog);
+
+    // The lines suppressed by the rate limiter of a mod are reported by the
+    // drain thread, at most once per report interval of the rate limiter, and
+    // before the thread exits when idle. The mod name and the rate limiter
+    // must remain valid until the rate limiter is removed.
+    void AddRateLimiter(PCWSTR modName, LogRateLimiter* rateLimiter);
+    void RemoveRateLimiter(LogRateLimiter* rateLimiter);
+
+    // Starts the drain thread if it's not running, so that lines which were
+    // suppressed are reported even if no lines are queued. Cheap if the
+    // thread is running.
+    void WakeDrainThread();
+
    private:
+    // 128 KB, allocated on the first logged line.
+    using Ring = LogRing<2048, 64>;
+
     static std::optional<Verbosity>& GetThreadVerbosity();
     bool SetThreadVerbosity(Verbosity verbosity);
     void ResetThreadVerbosity();
 
+    bool InitRing();
+    void QueueRecord(const void* record, size_t size);
+    void SignalDrainThread();
+    void StartDrainThread();
+    void RunDrainThread();
+    void Drain(bool wait);
+    bool ReportSuppressedLines(bool force);
+    static void OutputRecord(const BYTE* record,
+                             size_t size,
+                             SessionLog::Writer* sessionLog);
+
     const std::atomic<Verbosity> m_initialVerbosity;
     std::mutex m_threadVerbosityMutex;
     int m_threadVerbosityCount = 0;
+
+    std::once_flag m_ringInitFlag;
+    std::unique_ptr<Ring> m_ring;
+    wil::unique_event_nothrow m_ringEvent;
+    std::atomic<DWORD> m_drainState = 0;
+    std::atomic<DWORD> m_droppedCount = 0;
+    std::mutex m_drainMutex;
+    std::unique_ptr<SessionLog::Writer> m_sessionLog;
+    std::mutex m_rateLimitersMutex;
+    std::vector<std::pair<PCWSTR, LogRateLimiter*>> m_rateLimiters;
 };
 
 #define LOG_WITH_VERBOSITY(verbosity, message, ...)                          \
     do {                                                                     \
         auto& inst = Logger::GetInstance();                                  \
         if (inst.GetVerbosity() >= verbosity && inst.ShouldLog(verbosity)) { \
-            inst.LogLine(L"[WH] [%S]: " message L"\n", __FUNCTION__,         \
-                         __VA_ARGS__);                                       \
+            inst.LogLine(verbosity, L"[WH] [%S]: " message L"\n",           \
+                         __FUNCTION__, __VA_ARGS__);                          \
         }                                                                    \
     } while (0)
 
@@ -5,6 +5,7 @@
 #include "dll_inject.h"
 #include "logger.h"
 #include "no_destructor.h"
+#include "startup_profile.h"
 #include "storage_manager.h"
 
 HINSTANCE g_hDllInst;
@@ -13,6 +14,8 @@ BOOL APIENTRY DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved) {
     switch (fdwReason) {
         case DLL_PROCESS_ATTACH:
             g_hDllInst = hinstDLL;
+            StartupProfile::MarkPhaseEnd(
+                StartupProfile::ProcessPhase::kInjection);
             break;
 
         case DLL_THREAD_ATTACH:
@@ -47,6 +50,10 @@ bool LazyInitialize() {
 
 // Exported
 BOOL InjectInit(const DllInject::LOAD_LIBRARY_REMOTE_DATA* pInjData) {
+    StartupProfile::MarkInjected(
+        DllInject::GetRemoteDataTrailer(pInjData).nInjectionTimestamp);
+    StartupProfile::MarkPhaseEnd(StartupProfile::ProcessPhase::kEngineLoad);
+
     if (!LazyInitialize()) {
         return FALSE;
     }
@@ -0,0 +1,131 @@
+#include "stdafx.h"
+
+#include "memory_usage.h"
+#include "mod_status_table.h"
+
+namespace {
+
+constexpr size_t kSubsystemCount =
+    static_cast<size_t>(MemoryUsage::Subsystem::kCount);
+
+static_assert(std::size(ModStatusTable::kEngineMemoryFieldNames) ==
+              kSubsystemCount);
+
+constinit std::atomic<size_t> g_usage[kSubsystemCount];
+
+#ifdef WH_HOOKING_ENGINE_MINHOOK_DETOURS
+// The size which was measured by the last snapshot, and whether hooks were
+// created or removed since then.
+constinit std::atomic<size_t> g_trampolinesSize;
+constinit std::atomic<bool> g_trampolinesSizeStale = true;
+#endif  // WH_HOOKING_ENGINE_MINHOOK_DETOURS
+
+#ifdef WH_HOOKING_ENGINE_MINHOOK_DETOURS
+// Trampolines are allocated by SlimDetours in regions of DETOUR_REGION_SIZE
+// bytes, each starting with DETOUR_REGION_SIGNATURE (see Trampoline.c). The
+// regions aren't exposed, so they're found by walking the address space.
+constexpr SIZE_T kTrampolineRegionSize = 0x10000;
+constexpr ULONGLONG kTrampolineRegionSignature =
+    (ULONGLONG)'lSNK' << 32 | 'srtD';
+
+size_t GetTrampolinesSize() {
+    size_t size = 0;
+
+    MEMORY_BASIC_INFORMATION mbi;
+    for (BYTE* address = nullptr;
+         VirtualQuery(address, &mbi, sizeof(mbi)) == sizeof(mbi);
+         address = static_cast<BYTE*>(mbi.BaseAddress) + mbi.RegionSize) {
+        if (mbi.State != MEM_COMMIT || mbi.Type != MEM_PRIVATE ||
+            mbi.BaseAddress != mbi.AllocationBase ||
+            mbi.RegionSize < sizeof(ULONGLONG) ||
+            (mbi.Protect & (PAGE_GUARD | PAGE_NOACCESS)) ||
+            !(mbi.Protect & (PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE))) {
+            continue;
+        }
+
+        // Other executable regions, e.g. of a JIT compiler, might be freed
+        // concurrently, so the memory isn't accessed directly.
+        ULONGLONG signature;
+        if (ReadProcessMemory(GetCurrentProcess(), mbi.BaseAddress,
+                              &signature, sizeof(signature), nullptr) &&
+            signature == kTrampolineRegionSignature) {
+            size += kTrampolineRegionSize;
+        }
+    }
+
+    return size;
+}
+#endif  // WH_HOOKING_ENGINE_MINHOOK_DETOURS
+
+}  // namespace
+
+namespace MemoryUsage {
+
+void Add(Subsystem subsystem, size_t bytes) noexcept {
+    g_usage[static_cast<size_t>(subsystem)].fetch_add(
+        bytes, std::memory_order_relaxed);
+}
+
+void Subtract(Subsystem subsystem, size_t bytes) noexcept {
+    g_usage[static_cast<size_t>(subsystem)].fetch_sub(
+        bytes, std::memory_order_relaxed);
+}
+
+void InvalidateTrampolinesSize() noexcept {
+#ifdef WH_HOOKING_ENGINE_MINHOOK_DETOURS
+    g_trampolinesSizeStale = true;
+#endif  // WH_HOOKING_ENGINE_MINHOOK_DETOURS
+}
+
+TrackedSize::TrackedSize(Subsystem subsystem, size_t bytes) noexcept
+    : m_subsystem(subsystem), m_bytes(bytes) {
+    Add(m_subsystem, m_bytes);
+}
+
+TrackedSize::~TrackedSize() {
+    Subtract(m_subsystem, m_bytes);
+}
+
+void TrackedSize::Set(size_t bytes) noexcept {
+    if (bytes == m_bytes) {
+        return;
+    }
+
+    if (bytes > m_bytes) {
+        Add(m_subsystem, bytes - m_bytes);
+    } else {
+        Subtract(m_subsystem, m_bytes - bytes);
+    }
+
+    m_bytes = bytes;
+}
+
+std::wstring FormatSnapshot() {
+    size_t usage[kSubsystemCount];
+    for (size_t i = 0; i < kSubsystemCount; i++) {
+        usage[i] = g_usage[i].load(std::memory_order_relaxed);
+    }
+
+#ifdef WH_HOOKING_ENGINE_MINHOOK_DETOURS
+    // The flag is cleared before the walk, so that a change during the walk
+    // marks the size as stale again.
+    if (g_trampolinesSizeStale.exchange(false)) {
+        g_trampolinesSize = GetTrampolinesSize();
+    }
+
+    usage[static_cast<size_t>(Subsystem::kTrampolines)] += g_trampolinesSize;
+#endif  // WH_HOOKING_ENGINE_MINHOOK_DETOURS
+
+    std::wstring result;
+    for (size_t i = 0; i < kSubsystemCount; i++) {
+        if (i > 0) {
+            result += L',';
+        }
+
+        result += std::to_wstring(usage[i]);
+    }
+
+    return result;
+}
+
+}  // namespace MemoryUsage
@@ -0,0 +1,55 @@
+#pragma once
+
+// Accounting of the memory which the engine uses in the current process, by
+// subsystem. Buffers which are owned by the engine are counted when they're
+// allocated and freed. Memory which is allocated by libraries, such as the
+// hooking engine trampolines, is measured when a snapshot is taken after it
+// might have changed.
+namespace MemoryUsage {
+
+enum class Subsystem {
+    kTrampolines,
+    // Symbol enumerators and their buffers, and call indexes.
+    kSymbols,
+    // Loaded mods, not including the memory of the mod libraries.
+    kMods,
+    // Setting strings returned by Wh_GetStringSetting which weren't freed yet.
+    kSettings,
+    // Buffers returned by Wh_GetUrlContent which weren't freed yet.
+    kUrlContent,
+    kLogging,
+
+    kCount,
+};
+
+void Add(Subsystem subsystem, size_t bytes) noexcept;
+void Subtract(Subsystem subsystem, size_t bytes) noexcept;
+
+// An amount of bytes which is counted for as long as the object lives, and
+// which can be updated, e.g. when a buffer grows.
+class TrackedSize {
+   public:
+    explicit TrackedSize(Subsystem subsystem, size_t bytes = 0) noexcept;
+    ~TrackedSize();
+
+    TrackedSize(const TrackedSize&) = delete;
+    TrackedSize(TrackedSize&&) = delete;
+    TrackedSize& operator=(const TrackedSize&) = delete;
+    TrackedSize& operator=(TrackedSize&&) = delete;
+
+    void Set(size_t bytes) noexcept;
+
+   private:
+    const Subsystem m_subsystem;
+    size_t m_bytes;
+};
+
+// Marks the trampolines as changed, so that they're measured again by the next
+// snapshot. Called when hooks are created or removed.
+void InvalidateTrampolinesSize() noexcept;
+
+// Returns the current amounts in the format of the engine memory entries of
+// the mod status table.
+std::wstring FormatSnapshot();
+
+}  // namespace MemoryUsage
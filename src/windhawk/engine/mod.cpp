@@ -1,13 +1,23 @@
 #include "stdafx.h"
 
+#include "call_index.h"
+#include "cross_mod_mutex.h"
 #include "customization_session.h"
+#include "disasm.h"
 #include "functions.h"
+#include "hook_engine.h"
+#include "import_hooks.h"
 #include "logger.h"
 #include "mod.h"
+#include "module_load_notifier.h"
+#include "pattern_scan.h"
 #include "process_lists.h"
-#include "session_private_namespace.h"
 #include "storage_manager.h"
+#include "symbol_cache.h"
 #include "symbol_enum.h"
+#include "url_fetch_pool.h"
+#include "url_request.h"
+#include "var_init_once.h"
 #include "version.h"
 
 extern HINSTANCE g_hDllInst;
@@ -63,96 +73,6 @@ class ModDebugLoggingScopeHelper {
 #define MOD_DEBUG_LOGGING_SCOPE_QUIET() \
     ModDebugLoggingScopeHelper(m_debugLoggingEnabled, nullptr)
 
-class CrossModMutex {
-   public:
-    CrossModMutex(PCWSTR mutexIdentifier) {
-        try {
-            m_mutex.reset(CreateSymbolLoadLockMutex(mutexIdentifier, FALSE));
-        } catch (const std::exception& e) {
-            LOG(L"%S", e.what());
-        }
-    }
-
-    operator bool() const { return !!m_mutex; }
-
-    bool Acquire(DWORD milliseconds = INFINITE) {
-        m_mutexLock = m_mutex.acquire(nullptr, milliseconds);
-        return !!m_mutexLock;
-    }
-
-   private:
-    HANDLE CreateSymbolLoadLockMutex(PCWSTR mutexIdentifier,
-                                     BOOL initialOwner) {
-        DWORD dwSessionManagerProcessId =
-            CustomizationSession::GetSessionManagerProcessId();
-
-        WCHAR sessionPrivateNamespaceName
-            [SessionPrivateNamespace::kPrivateNamespaceMaxLen + 1];
-        SessionPrivateNamespace::MakeName(sessionPrivateNamespaceName,
-                                          dwSessionManagerProcessId);
-
-        std::wstring mutexName = sessionPrivateNamespaceName;
-        mutexName += L'\\';
-        mutexName += mutexIdentifier;
-
-        wil::unique_hlocal secDesc;
-        THROW_IF_WIN32_BOOL_FALSE(
-            Functions::GetFullAccessSecurityDescriptor(&secDesc, nullptr));
-
-        SECURITY_ATTRIBUTES secAttr{
-            .nLength = sizeof(secAttr),
-            .lpSecurityDescriptor = secDesc.get(),
-            .bInheritHandle = FALSE,
-        };
-
-        wil::unique_mutex_nothrow mutex(
-            CreateMutex(&secAttr, initialOwner, mutexName.c_str()));
-        THROW_LAST_ERROR_IF_NULL(mutex);
-
-        return mutex.release();
-    }
-
-    wil::unique_mutex_nothrow m_mutex;
-    wil::mutex_release_scope_exit m_mutexLock;
-};
-
-std::wstring GenerateModInstanceId(PCWSTR modName) {
-    DWORD sessionManagerProcessId =
-        CustomizationSession::GetSessionManagerProcessId();
-
-    FILETIME sessionManagerProcessCreationTime =
-        CustomizationSession::GetSessionManagerProcessCreationTime();
-
-    return std::to_wstring(sessionManagerProcessId) + L"_" +
-           std::to_wstring(
-               wil::filetime::to_int64(sessionManagerProcessCreationTime)) +
-           L"_" + std::to_wstring(GetCurrentProcessId()) + L"_" + modName;
-}
-
-void SetModMetadataValue(wil::unique_hfile& metadataFile,
-                         PCWSTR value,
-                         PCWSTR metadataCategory,
-                         PCWSTR modInstanceId) {
-    if (!value) {
-        metadataFile.reset();
-        return;
-    }
-
-    auto& storageManager = StorageManager::GetInstance();
-
-    if (!metadataFile) {
-        metadataFile = storageManager.CreateModMetadataFile(metadataCategory,
-                                                            modInstanceId);
-    }
-
-    std::filesystem::path fullProcessImageName =
-        wil::QueryFullProcessImageName<std::wstring>(GetCurrentProcess());
-    std::wstring fullValue =
-        fullProcessImageName.filename().native() + L'|' + value;
-
-    storageManager.SetModMetadataValue(metadataFile, fullValue.c_str());
-}
-
 bool DoesArchitectureMatchPatternPart(std::wstring_view patternPart) {
 #if defined(_M_IX86)
     if (patternPart == L"x86") {
@@ -522,6 +442,18 @@ wil::unique_hmodule SetModShimsLibraryIfNeeded(HMODULE mod) {
     return shimModule;
 }
 
+// The symbol, disassembly and URL APIs are only used by some mods, and even
+// then mostly on startup. Their code is grouped at the end of the code section,
+// so that it doesn't share pages with the code which runs in every process.
+//
+// The pragma only applies to functions which are defined explicitly. Classes
+// which are only used here are marked with __declspec(code_seg) too, which
+// also covers their implicit members and lambdas. Template instantiations,
+// such as std::function wrappers of the lambdas, are placed in the default
+// section regardless. Use ../helper_scripts/check_cold_code.py with the linker
+// map to see what ends up where.
+#pragma code_seg(push, ".text$zcold")
+
 // Checks whether the module is CHPE, ARM64EC or ARM64X.
 bool IsHybridModule(const IMAGE_DOS_HEADER* dosHeader,
                     const IMAGE_NT_HEADERS* ntHeader) {
@@ -552,7 +484,90 @@ bool IsHybridModule(const IMAGE_DOS_HEADER* dosHeader,
     return cfg->CHPEMetadataPointer != 0;
 }
 
-class HookSymbolsSession {
+// A key which identifies the build of a module, for caching information which
+// is extracted from it, such as symbol addresses.
+std::wstring GetModuleCacheKey(HMODULE module,
+                               std::wstring_view moduleFileName,
+                               std::wstring_view timeStamp,
+                               std::wstring_view imageSize,
+                               bool isHybridModule) {
+    std::wstring cacheStrKey;
+
+    constexpr WCHAR currentArch[] =
+#if defined(_M_IX86)
+        L"x86";
+#elif defined(_M_X64)
+        L"x86-64";
+#elif defined(_M_ARM64)
+        L"arm64";
+#else
+#error "Unsupported architecture"
+#endif
+
+    GUID pdbGuid;
+    DWORD pdbAge;
+    if (Functions::ModuleGetPDBInfo(module, &pdbGuid, &pdbAge)) {
+        constexpr size_t kMaxPdbIdentifierLength =
+            sizeof("AAAAAAAABBBBCCCCDDDDEEEEEEEEEEEE12345678") - 1;
+        WCHAR pdbIdentifier[kMaxPdbIdentifierLength + 1];
+        swprintf_s(pdbIdentifier,
+                   L"%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X%x",
+                   pdbGuid.Data1, pdbGuid.Data2, pdbGuid.Data3,
+                   pdbGuid.Data4[0], pdbGuid.Data4[1], pdbGuid.Data4[2],
+                   pdbGuid.Data4[3], pdbGuid.Data4[4], pdbGuid.Data4[5],
+                   pdbGuid.Data4[6], pdbGuid.Data4[7], pdbAge);
+
+        cacheStrKey = L"pdb_";
+        cacheStrKey += pdbIdentifier;
+        if (isHybridModule) {
+            cacheStrKey += L"_hybrid-";
+            cacheStrKey += currentArch;
+        }
+    } else {
+        cacheStrKey = L"pe_";
+        cacheStrKey += currentArch;
+        cacheStrKey += L'_';
+        cacheStrKey += timeStamp;
+        cacheStrKey += L'_';
+        cacheStrKey += imageSize;
+        cacheStrKey += L'_';
+        cacheStrKey += moduleFileName;
+        if (isHybridModule) {
+            cacheStrKey += L"_hybrid";
+        }
+    }
+
+    return cacheStrKey;
+}
+
+struct LoadedModuleCacheInfo {
+    std::wstring fileName;  // Lowercase.
+    std::wstring cacheKey;
+};
+
+LoadedModuleCacheInfo GetLoadedModuleCacheInfo(HMODULE module) {
+    std::filesystem::path modulePath =
+        wil::GetModuleFileName<std::wstring>(module);
+    auto moduleFileName = modulePath.filename().wstring();
+    LCMapStringEx(
+        LOCALE_NAME_USER_DEFAULT, LCMAP_LOWERCASE, &moduleFileName[0],
+        wil::safe_cast<int>(moduleFileName.length()), &moduleFileName[0],
+        wil::safe_cast<int>(moduleFileName.length()), nullptr, nullptr, 0);
+
+    auto* dosHeader = reinterpret_cast<IMAGE_DOS_HEADER*>(module);
+    auto* ntHeader = reinterpret_cast<IMAGE_NT_HEADERS*>(
+        reinterpret_cast<BYTE*>(dosHeader) + dosHeader->e_lfanew);
+
+    std::wstring cacheKey = GetModuleCacheKey(
+        module, moduleFileName,
+        std::to_wstring(ntHeader->FileHeader.TimeDateStamp),
+        std::to_wstring(ntHeader->OptionalHeader.SizeOfImage),
+        IsHybridModule(dosHeader, ntHeader));
+
+    return {std::move(moduleFileName), std::move(cacheKey)};
+}
+
+class __declspec(code_seg(".text$zcold")) HookSymbolsSession {
    public:
     HookSymbolsSession(LoadedMod* loadedMod,
                        HMODULE module,
@@ -680,45 +695,30 @@ class HookSymbolsSession {
     }
 
     bool ResolveSymbolsFromCacheString(std::wstring_view cache) {
-        auto cacheParts = Functions::SplitStringToViews(cache, m_cacheSep);
-        return ResolveSymbolsFromCacheStringParts(cacheParts);
-    }
-
-    bool ResolveSymbolsFromCacheStringParts(
-        std::vector<std::wstring_view>& cacheParts) {
-        // In the new format, cacheParts[1] and cacheParts[2] are
-        // ignored and act like comments.
-        if (cacheParts.size() < 3 ||
-            cacheParts[0] != std::wstring_view(&kCacheVer, 1)) {
+        std::vector<SymbolCache::Entry> cacheEntries;
+        if (!SymbolCache::Parse(cache, m_cacheSep, kCacheVer, &cacheEntries)) {
             return false;
         }
 
-        for (size_t i = 3; i + 1 < cacheParts.size(); i += 2) {
-            const auto& symbol = cacheParts[i];
-            const auto& address = cacheParts[i + 1];
-            if (address.length() == 0) {
+        for (const auto& entry : cacheEntries) {
+            if (!entry.offset) {
                 continue;
             }
 
-            void* addressPtr =
-                (void*)(std::wcstoull(std::wstring(address).c_str(), nullptr,
-                                      10) +
-                        (ULONG_PTR)m_module);
+            void* addressPtr = (void*)(*entry.offset + (ULONG_PTR)m_module);
 
-            OnSymbolResolved(symbol, addressPtr);
+            OnSymbolResolved(entry.symbol, addressPtr);
         }
 
-        std::erase_if(m_symbolHooksUnresolved, [this, &cacheParts](
+        std::erase_if(m_symbolHooksUnresolved, [this, &cacheEntries](
                                                    const auto* symbolHook) {
             if (!symbolHook->optional) {
                 return false;
             }
 
             size_t noAddressMatchCount = 0;
-            for (size_t j = 3; j + 1 < cacheParts.size(); j += 2) {
-                const auto& symbol = cacheParts[j];
-                const auto& address = cacheParts[j + 1];
-                if (address.length() != 0) {
+            for (const auto& entry : cacheEntries) {
+                if (entry.offset) {
                     continue;
                 }
 
@@ -726,7 +726,7 @@ class HookSymbolsSession {
                     auto hookSymbol =
                         std::wstring_view(symbolHook->symbols[s].string,
                                           symbolHook->symbols[s].length);
-                    if (hookSymbol == symbol) {
+                    if (hookSymbol == entry.symbol) {
                         noAddressMatchCount++;
                         break;
                     }
@@ -889,51 +889,8 @@ class HookSymbolsSession {
 
         bool isHybridModule = IsHybridModule(dosHeader, ntHeader);
 
-        std::wstring cacheStrKey;
-
-        constexpr WCHAR currentArch[] =
-#if defined(_M_IX86)
-            L"x86";
-#elif defined(_M_X64)
-            L"x86-64";
-#elif defined(_M_ARM64)
-            L"arm64";
-#else
-#error "Unsupported architecture"
-#endif
-
-        GUID pdbGuid;
-        DWORD pdbAge;
-        if (Functions::ModuleGetPDBInfo(module, &pdbGuid, &pdbAge)) {
-            constexpr size_t kMaxPdbIdentifierLength =
-                sizeof("AAAAAAAABBBBCCCCDDDDEEEEEEEEEEEE12345678") - 1;
-            WCHAR pdbIdentifier[kMaxPdbIdentifierLength + 1];
-            swprintf_s(pdbIdentifier,
-                       L"%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X%x",
-                       pdbGuid.Data1, pdbGuid.Data2, pdbGuid.Data3,
-                       pdbGuid.Data4[0], pdbGuid.Data4[1], pdbGuid.Data4[2],
-                       pdbGuid.Data4[3], pdbGuid.Data4[4], pdbGuid.Data4[5],
-                       pdbGuid.Data4[6], pdbGuid.Data4[7], pdbAge);
-
-            cacheStrKey = L"pdb_";
-            cacheStrKey += pdbIdentifier;
-            if (isHybridModule) {
-                cacheStrKey += L"_hybrid-";
-                cacheStrKey += currentArch;
-            }
-        } else {
-            cacheStrKey = L"pe_";
-            cacheStrKey += currentArch;
-            cacheStrKey += L'_';
-            cacheStrKey += timeStamp;
-            cacheStrKey += L'_';
-            cacheStrKey += imageSize;
-            cacheStrKey += L'_';
-            cacheStrKey += moduleFileName;
-            if (isHybridModule) {
-                cacheStrKey += L"_hybrid";
-            }
-        }
+        std::wstring cacheStrKey = GetModuleCacheKey(
+            module, moduleFileName, timeStamp, imageSize, isHybridModule);
 
         m_isHybridModule = isHybridModule;
         m_cacheSep = isHybridModule ? L';' : L'#';
@@ -976,6 +933,229 @@ class HookSymbolsSession {
     std::vector<PendingHook> m_pendingHooks;
 };
 
+constexpr size_t kPatternScanChunkSize = 1024 * 1024;
+// Smaller modules are scanned on the current thread only.
+constexpr size_t kPatternScanParallelMinSize = 4 * 1024 * 1024;
+// Including the current thread.
+constexpr DWORD kPatternScanMaxThreads = 4;
+
+struct PatternScanResult {
+    const BYTE* firstMatch;
+    size_t matchCount;
+};
+
+// The state of a scan which is shared with the thread pool callbacks. A
+// callback can start after the scan is done, so it keeps the state alive, and
+// only accesses the scanned memory if there are chunks left to scan.
+struct __declspec(code_seg(".text$zcold")) PatternScanState {
+    struct Chunk {
+        std::span<const uint8_t> data;
+        size_t begin;
+        size_t end;
+    };
+
+    std::vector<PatternScan::Pattern> patterns;
+    std::vector<Chunk> chunks;
+    // The matches in each chunk, per pattern.
+    std::vector<std::vector<std::vector<size_t>>> chunkMatches;
+    std::atomic<size_t> nextChunk = 0;
+    std::atomic<size_t> doneChunks = 0;
+    std::atomic<bool> failed = false;
+    wil::unique_event allDone{wil::EventOptions::ManualReset};
+
+    void ScanChunks() noexcept {
+        size_t i;
+        while ((i = nextChunk.fetch_add(1)) < chunks.size()) {
+            const auto& chunk = chunks[i];
+
+            try {
+                PatternScan::Scan(chunk.data, chunk.begin, chunk.end, patterns,
+                                  chunkMatches[i]);
+            } catch (const std::exception& e) {
+                LOG(L"Pattern scan failed: %S", e.what());
+                failed = true;
+            }
+
+            if (doneChunks.fetch_add(1) + 1 == chunks.size()) {
+                allDone.SetEvent();
+            }
+        }
+    }
+};
+
+void CALLBACK PatternScanCallback(PTP_CALLBACK_INSTANCE instance,
+                                  PVOID context) {
+    {
+        std::unique_ptr<std::shared_ptr<PatternScanState>> state(
+            static_cast<std::shared_ptr<PatternScanState>*>(context));
+        (*state)->ScanChunks();
+    }
+
+    FreeLibraryWhenCallbackReturns(instance, g_hDllInst);
+}
+
+// Scans large ranges in chunks on the thread pool, together with the current
+// thread. The current thread only waits for chunks which other threads started
+// scanning, so it isn't blocked if the thread pool can't run, e.g. while the
+// process is initializing.
+std::vector<PatternScanResult> ScanForPatterns(
+    std::span<const std::span<const uint8_t>> ranges,
+    std::vector<PatternScan::Pattern> patterns) {
+    auto state = std::make_shared<PatternScanState>();
+    state->patterns = std::move(patterns);
+
+    size_t totalSize = 0;
+    for (const auto& range : ranges) {
+        totalSize += range.size();
+    }
+
+    bool parallel = totalSize >= kPatternScanParallelMinSize;
+
+    for (const auto& range : ranges) {
+        size_t chunkSize = parallel ? kPatternScanChunkSize : range.size();
+        for (size_t begin = 0; begin < range.size(); begin += chunkSize) {
+            state->chunks.push_back({
+                .data = range,
+                .begin = begin,
+                .end = std::min(begin + chunkSize, range.size()),
+            });
+        }
+    }
+
+    state->chunkMatches.resize(
+        state->chunks.size(),
+        std::vector<std::vector<size_t>>(state->patterns.size()));
+
+    if (parallel) {
+        DWORD threadCount =
+            std::min({kPatternScanMaxThreads,
+                      GetActiveProcessorCount(ALL_PROCESSOR_GROUPS),
+                      static_cast<DWORD>(state->chunks.size())});
+
+        for (DWORD i = 1; i < threadCount; i++) {
+            // Bump the reference count of the module, it's released when the
+            // callback returns.
+            HMODULE hDllInst;
+            GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                              reinterpret_cast<LPCWSTR>(g_hDllInst),
+                              &hDllInst);
+
+            auto context =
+                std::make_unique<std::shared_ptr<PatternScanState>>(state);
+            if (!TrySubmitThreadpoolCallback(PatternScanCallback,
+                                             context.get(), nullptr)) {
+                LOG(L"TrySubmitThreadpoolCallback failed: %u", GetLastError());
+                FreeLibrary(g_hDllInst);
+                break;
+            }
+
+            context.release();
+        }
+    }
+
+    state->ScanChunks();
+
+    if (state->doneChunks != state->chunks.size()) {
+        state->allDone.wait();
+    }
+
+    if (state->failed) {
+        throw std::runtime_error("Pattern scan failed");
+    }
+
+    std::vector<PatternScanResult> results(state->patterns.size());
+    for (size_t i = 0; i < state->chunks.size(); i++) {
+        const auto& chunk = state->chunks[i];
+        for (size_t p = 0; p < results.size(); p++) {
+            const auto& matches = state->chunkMatches[i][p];
+            if (matches.empty()) {
+                continue;
+            }
+
+            if (!results[p].firstMatch) {
+                results[p].firstMatch = chunk.data.data() + matches.front();
+            }
+
+            results[p].matchCount += matches.size();
+        }
+    }
+
+    return results;
+}
+
+// Converts the options to the current version of the struct, with defaults for
+// the fields which older versions don't have. Returns false if the version
+// isn't supported.
+bool ResolveGetUrlContentOptions(const WH_GET_URL_CONTENT_OPTIONS* options,
+                                 WH_GET_URL_CONTENT_OPTIONS* optionsResolved) {
+    struct WH_GET_URL_CONTENT_OPTIONS_CURRENT {
+        size_t optionsSize;
+        PCWSTR targetFilePath;
+        WH_URL_CONTENT_WRITE_CALLBACK writeCallback;
+        void* writeCallbackParam;
+        size_t bufferSize;
+        BOOL useCache;
+    };
+    static_assert(sizeof(WH_GET_URL_CONTENT_OPTIONS) ==
+                      sizeof(WH_GET_URL_CONTENT_OPTIONS_CURRENT),
+                  "Struct was updated, update this code too");
+
+    struct WH_GET_URL_CONTENT_OPTIONS_V1 {
+        size_t optionsSize;
+        PCWSTR targetFilePath;
+    };
+
+    switch (options ? options->optionsSize : 0) {
+        case sizeof(WH_GET_URL_CONTENT_OPTIONS):
+            *optionsResolved = *options;
+            break;
+
+        case sizeof(WH_GET_URL_CONTENT_OPTIONS_V1): {
+            const WH_GET_URL_CONTENT_OPTIONS_V1* optionsV1 =
+                reinterpret_cast<const WH_GET_URL_CONTENT_OPTIONS_V1*>(options);
+            *optionsResolved = {
+                .optionsSize = sizeof(*optionsResolved),
+                .targetFilePath = optionsV1->targetFilePath,
+            };
+            break;
+        }
+
+        case 0:
+            *optionsResolved = {
+                .optionsSize = sizeof(*optionsResolved),
+            };
+            break;
+
+        default:
+            LOG(L"Unsupported options->optionsSize value: %zu",
+                options->optionsSize);
+            return false;
+    }
+
+    return true;
+}
+
+// FNV-1a, used to identify a set of patterns in the pattern cache.
+uint64_t HashPatterns(const WH_FIND_PATTERN* patterns, size_t patternsCount) {
+    uint64_t hash = 0xCBF29CE484222325;
+    auto hashByte = [&hash](uint8_t byte) {
+        hash ^= byte;
+        hash *= 0x100000001B3;
+    };
+
+    for (size_t i = 0; i < patternsCount; i++) {
+        for (const char* p = patterns[i].pattern; *p; p++) {
+            hashByte(static_cast<uint8_t>(*p));
+        }
+
+        hashByte('\n');
+    }
+
+    return hash;
+}
+
+#pragma code_seg(pop)
+
 std::wstring GetWindowsVersionForLogging() {
     static const std::wstring result = []() {
         ULONG majorVersion = 0;
@@ -1016,22 +1196,69 @@ std::wstring GetWindowsVersionForLogging() {
     return result;
 }
 
+// Budgets for the Wh_Log lines of each mod, in lines per second. A burst of a
+// second's worth of lines is allowed. Can be changed with the app settings, 0
+// means no limit.
+LogRateLimiter::Budgets ReadModLogBudgets() {
+    LogRateLimiter::Budgets budgets{
+        .mod = {.linesPerSecond = 1000, .burst = 1000},
+        .callSite = {.linesPerSecond = 200, .burst = 200},
+    };
+
+    try {
+        auto settings = StorageManager::GetInstance().GetAppConfig(L"Settings");
+
+        if (auto limit = settings->GetInt(L"ModLogRateLimit")) {
+            auto linesPerSecond = static_cast<uint32_t>(std::max(*limit, 0));
+            budgets.mod = {.linesPerSecond = linesPerSecond,
+                           .burst = linesPerSecond};
+        }
+
+        if (auto limit = settings->GetInt(L"ModLogCallSiteRateLimit")) {
+            auto linesPerSecond = static_cast<uint32_t>(std::max(*limit, 0));
+            budgets.callSite = {.linesPerSecond = linesPerSecond,
+                                .burst = linesPerSecond};
+        }
+    } catch (const std::exception& e) {
+        LOG(L"Failed to read the log rate limit settings: %S", e.what());
+    }
+
+    return budgets;
+}
+
+const LogRateLimiter::Budgets& GetModLogBudgets() {
+    STATIC_INIT_ONCE_TRIVIAL(LogRateLimiter::Budgets, budgets,
+                             ReadModLogBudgets());
+    return budgets;
+}
+
+void LogModLine(PCWSTR modName, PCWSTR format, ...) {
+    va_list args;
+    va_start(args, format);
+    Logger::GetInstance().VLogModLine(modName, format, args);
+    va_end(args);
+}
+
 }  // namespace
 
 LoadedMod::LoadedMod(PCWSTR modName,
-                     PCWSTR modInstanceId,
                      PCWSTR libraryPath,
                      bool loadedOnStartup,
                      bool loggingEnabled,
                      bool debugLoggingEnabled)
     : m_modName(modName),
-      m_modInstanceId(modInstanceId),
+      m_modTask(ModStatusTable::Category::kModTask, modName),
       m_loadedOnStartup(loadedOnStartup),
       m_loggingEnabled(loggingEnabled),
       m_debugLoggingEnabled(debugLoggingEnabled),
+      m_logRateLimiter(GetModLogBudgets()),
+      m_startupTimesPending(loadedOnStartup),
       m_compatDemangling(ShouldUseCompatDemangling(m_modName)) {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
 
+    m_memoryUsage.Set(sizeof(LoadedMod) +
+                      m_modName.capacity() * sizeof(WCHAR));
+
     VERBOSE(L"Windows %s", GetWindowsVersionForLogging().c_str());
 #if defined(_M_IX86)
 #define WINDHAWK_ARCH L"x86"
@@ -1047,8 +1274,12 @@ LoadedMod::LoadedMod(PCWSTR modName,
     VERBOSE(L"Mod id: %s", m_modName.c_str());
     VERBOSE(L"Mod version: %s", GetModVersion(m_modName.c_str()).c_str());
 
-    m_modModule.reset(
-        LoadLibraryEx(libraryPath, nullptr, LOAD_WITH_ALTERED_SEARCH_PATH));
+    {
+        StartupProfile::ScopedModPhase startupPhase(
+            GetStartupTimes(), StartupProfile::ModPhase::kLoad);
+        m_modModule.reset(LoadLibraryEx(libraryPath, nullptr,
+                                        LOAD_WITH_ALTERED_SEARCH_PATH));
+    }
     THROW_LAST_ERROR_IF_NULL(m_modModule);
 
     VERBOSE(L"Mod base address: %p", m_modModule.get());
@@ -1061,28 +1292,42 @@ LoadedMod::LoadedMod(PCWSTR modName,
         LOG(L"Mod %s: InternalWhModPtr not found", m_modName.c_str());
     }
 
+    auto getCallback = [this](auto* callback, PCSTR name) {
+        *callback = reinterpret_cast<std::remove_pointer_t<decltype(callback)>>(
+            GetProcAddress(m_modModule.get(), name));
+    };
+    getCallback(&m_callbacks.init, "_Z10Wh_ModInitv");
+    getCallback(&m_callbacks.afterInit, "_Z15Wh_ModAfterInitv");
+    getCallback(&m_callbacks.beforeUninit, "_Z18Wh_ModBeforeUninitv");
+    getCallback(&m_callbacks.uninit, "_Z12Wh_ModUninitv");
+    getCallback(&m_callbacks.settingsChangedEx, "_Z21Wh_ModSettingsChangedPi");
+    getCallback(&m_callbacks.settingsChanged, "_Z21Wh_ModSettingsChangedv");
+
     try {
         m_modShimLibrary = SetModShimsLibraryIfNeeded(m_modModule.get());
     } catch (const std::exception& e) {
         LOG(L"Mod %s: %S", m_modName.c_str(), e.what());
     }
+
+    Logger::GetInstance().AddRateLimiter(m_modName.c_str(), &m_logRateLimiter);
 }
 
 LoadedMod::~LoadedMod() {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
 
-#ifdef WH_HOOKING_ENGINE_MINHOOK
-    MH_STATUS status =
-        MH_RemoveHookEx(reinterpret_cast<ULONG_PTR>(this), MH_ALL_HOOKS);
-    if (status != MH_OK) {
-        LOG(L"Mod %s error: MH_RemoveHookEx returned %d", m_modName.c_str(),
+    // In case the mod wasn't uninitialized, e.g. if initialization failed.
+    ModuleLoadNotifier::GetInstance().UnregisterAll(this);
+    UrlFetchPool::GetInstance().CancelAll(this);
+    ImportHooks::GetInstance().RemoveAll(this);
+
+    auto status = HookEngine::RemoveHooks(reinterpret_cast<ULONG_PTR>(this));
+    if (status != HookEngine::kOk) {
+        LOG(L"Mod %s error: RemoveHooks returned %d", m_modName.c_str(),
             status);
     }
-#elif WH_HOOKING_ENGINE == WH_HOOKING_ENGINE_NONE
-// For testing without a hooking engine.
-#else
-#error "Unsupported hooking engine"
-#endif  // WH_HOOKING_ENGINE
+
+    Logger::GetInstance().RemoveRateLimiter(&m_logRateLimiter);
+    LogSuppressedCount();
 }
 
 bool LoadedMod::Initialize() {
@@ -1094,11 +1339,10 @@ bool LoadedMod::Initialize() {
 
     SetTask(L"Initializing...");
 
-    using WH_MOD_INIT_T = BOOL(__cdecl*)();
-    auto pWH_ModInit = reinterpret_cast<WH_MOD_INIT_T>(
-        GetProcAddress(m_modModule.get(), "_Z10Wh_ModInitv"));
-    if (pWH_ModInit) {
-        m_initialized = pWH_ModInit();
+    if (m_callbacks.init) {
+        StartupProfile::ScopedModPhase startupPhase(
+            GetStartupTimes(), StartupProfile::ModPhase::kInitialize);
+        m_initialized = m_callbacks.init();
     } else {
         m_initialized = true;
     }
@@ -1111,11 +1355,15 @@ bool LoadedMod::Initialize() {
 void LoadedMod::AfterInit() {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
 
-    using WH_MOD_AFTER_INIT_T = void(__cdecl*)();
-    auto pWH_ModAfterInit = reinterpret_cast<WH_MOD_AFTER_INIT_T>(
-        GetProcAddress(m_modModule.get(), "_Z15Wh_ModAfterInitv"));
-    if (pWH_ModAfterInit) {
-        pWH_ModAfterInit();
+    if (m_callbacks.afterInit) {
+        StartupProfile::ScopedModPhase startupPhase(
+            GetStartupTimes(), StartupProfile::ModPhase::kAfterInit);
+        m_callbacks.afterInit();
+    }
+
+    if (m_startupTimesPending) {
+        m_startupTimesPending = false;
+        StartupProfile::PublishMod(m_modName.c_str(), m_startupTimes);
     }
 }
 
@@ -1124,37 +1372,29 @@ void LoadedMod::BeforeUninit() {
 
     SetTask(L"Uninitializing...");
 
-    using WH_MOD_BEFORE_UNINIT_T = void(__cdecl*)();
-    auto pWH_ModBeforeUninit = reinterpret_cast<WH_MOD_BEFORE_UNINIT_T>(
-        GetProcAddress(m_modModule.get(), "_Z18Wh_ModBeforeUninitv"));
-    if (pWH_ModBeforeUninit) {
-        pWH_ModBeforeUninit();
+    if (m_callbacks.beforeUninit) {
+        m_callbacks.beforeUninit();
     }
 
     m_uninitializing = true;
 
-#ifdef WH_HOOKING_ENGINE_MINHOOK
-    MH_STATUS status =
-        MH_QueueDisableHookEx(reinterpret_cast<ULONG_PTR>(this), MH_ALL_HOOKS);
-    if (status != MH_OK) {
-        LOG(L"Mod %s error: MH_QueueDisableHookEx returned %d",
-            m_modName.c_str(), status);
+    ModuleLoadNotifier::GetInstance().UnregisterAll(this);
+    UrlFetchPool::GetInstance().CancelAll(this);
+    ImportHooks::GetInstance().RemoveAll(this);
+
+    auto status = HookEngine::QueueDisableHook(
+        reinterpret_cast<ULONG_PTR>(this), /*target=*/nullptr);
+    if (status != HookEngine::kOk) {
+        LOG(L"Mod %s error: QueueDisableHook returned %d", m_modName.c_str(),
+            status);
     }
-#elif WH_HOOKING_ENGINE == WH_HOOKING_ENGINE_NONE
-// For testing without a hooking engine.
-#else
-#error "Unsupported hooking engine"
-#endif  // WH_HOOKING_ENGINE
 }
 
 void LoadedMod::Uninitialize() {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
 
-    using WH_MOD_UNINIT_T = void(__cdecl*)();
-    auto pWH_ModUninit = reinterpret_cast<WH_MOD_UNINIT_T>(
-        GetProcAddress(m_modModule.get(), "_Z12Wh_ModUninitv"));
-    if (pWH_ModUninit) {
-        pWH_ModUninit();
+    if (m_callbacks.uninit) {
+        m_callbacks.uninit();
     }
 }
 
@@ -1171,22 +1411,15 @@ bool LoadedMod::SettingsChanged(bool* reload) {
 
     *reload = false;
 
-    using WH_MOD_SETTINGS_CHANGED_EX_T = BOOL(__cdecl*)(BOOL*);
-    auto pWH_ModSettingsChangedEx =
-        reinterpret_cast<WH_MOD_SETTINGS_CHANGED_EX_T>(
-            GetProcAddress(m_modModule.get(), "_Z21Wh_ModSettingsChangedPi"));
-    if (pWH_ModSettingsChangedEx) {
+    if (m_callbacks.settingsChangedEx) {
         BOOL bReload = FALSE;
-        bool result = pWH_ModSettingsChangedEx(&bReload);
+        bool result = m_callbacks.settingsChangedEx(&bReload);
         *reload = bReload;
         return result;
     }
 
-    using WH_MOD_SETTINGS_CHANGED_T = void(__cdecl*)();
-    auto pWH_ModSettingsChanged = reinterpret_cast<WH_MOD_SETTINGS_CHANGED_T>(
-        GetProcAddress(m_modModule.get(), "_Z21Wh_ModSettingsChangedv"));
-    if (pWH_ModSettingsChanged) {
-        pWH_ModSettingsChanged();
+    if (m_callbacks.settingsChanged) {
+        m_callbacks.settingsChanged();
         return true;
     }
 
@@ -1202,18 +1435,32 @@ HMODULE LoadedMod::GetModModuleHandle() {
 }
 
 BOOL LoadedMod::IsLogEnabled() {
-    return m_loggingEnabled || m_debugLoggingEnabled;
+    if (!m_loggingEnabled && !m_debugLoggingEnabled) {
+        return FALSE;
+    }
+
+    // Checked here too so that the arguments of a line which is going to be
+    // dropped aren't evaluated.
+    if (!m_logRateLimiter.CheckModBudget(GetTickCount64())) {
+        Logger::GetInstance().WakeDrainThread();
+        return FALSE;
+    }
+
+    return TRUE;
 }
 
 void LoadedMod::Log(PCWSTR format, va_list args) {
+    // The format string is a literal, so its address identifies the call site.
+    if (!m_logRateLimiter.TryAcquire(format, GetTickCount64())) {
+        // The suppressed lines are reported by the drain thread.
+        Logger::GetInstance().WakeDrainThread();
+        return;
+    }
+
     va_list argsCopy;
     va_copy(argsCopy, args);  // https://stackoverflow.com/q/55274350
-    WCHAR logFormatted[1025];
-    _vsnwprintf_s(logFormatted, _TRUNCATE, format, args);
+    Logger::GetInstance().VLogModLine(m_modName.c_str(), format, argsCopy);
     va_end(argsCopy);
-
-    Logger::GetInstance().LogLine(L"[WH] [%s] %s\n", m_modName.c_str(),
-                                  logFormatted);
 }
 
 int LoadedMod::GetIntValue(PCWSTR valueName, int defaultValue) {
@@ -1433,6 +1680,8 @@ PCWSTR LoadedMod::GetStringSetting(PCWSTR valueName, va_list args) {
         auto valueAllocated = std::make_unique<WCHAR[]>(value.length() + 1);
         wcscpy_s(valueAllocated.get(), value.length() + 1, value.c_str());
         VERBOSE(L"value: %s", valueAllocated.get());
+        MemoryUsage::Add(MemoryUsage::Subsystem::kSettings,
+                         (value.length() + 1) * sizeof(WCHAR));
         return valueAllocated.release();
     } catch (const std::exception& e) {
         LogFunctionError(e);
@@ -1445,6 +1694,8 @@ void LoadedMod::FreeStringSetting(PCWSTR string) {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
 
     if (string != emptySettingStringValue) {
+        MemoryUsage::Subtract(MemoryUsage::Subsystem::kSettings,
+                              (wcslen(string) + 1) * sizeof(WCHAR));
         delete[] string;
     }
 }
@@ -1456,37 +1707,41 @@ BOOL LoadedMod::SetFunctionHook(void* targetFunction,
     VERBOSE(L"Target: %p", targetFunction);
     VERBOSE(L"Hook: %p", hookFunction);
 
-#ifdef WH_HOOKING_ENGINE_MINHOOK
     if (m_uninitializing) {
         VERBOSE(L"Uninitializing, not allowed to set hooks");
         return FALSE;
     }
 
-    MH_STATUS status =
-        MH_CreateHookEx(reinterpret_cast<ULONG_PTR>(this), targetFunction,
-                        hookFunction, originalFunction);
-    if (status != MH_OK) {
-        LOG(L"Mod %s error: MH_CreateHookEx returned %d", m_modName.c_str(),
+    if (m_hotSwapSource) {
+        // Until the hook is applied by TakeOverHooks, the original function is
+        // the target, same as for a hook which isn't enabled yet.
+        if (originalFunction) {
+            *originalFunction = targetFunction;
+        }
+
+        m_hotSwapHooks.push_back({targetFunction, hookFunction,
+                                  originalFunction});
+        return TRUE;
+    }
+
+    auto status =
+        HookEngine::CreateHook(reinterpret_cast<ULONG_PTR>(this),
+                               targetFunction, hookFunction, originalFunction);
+    if (status != HookEngine::kOk) {
+        LOG(L"Mod %s error: CreateHook returned %d", m_modName.c_str(),
             status);
         return FALSE;
     }
 
-    status =
-        MH_QueueEnableHookEx(reinterpret_cast<ULONG_PTR>(this), targetFunction);
-    if (status != MH_OK) {
-        LOG(L"Mod %s error: MH_QueueEnableHookEx returned %d",
-            m_modName.c_str(), status);
+    status = HookEngine::QueueEnableHook(reinterpret_cast<ULONG_PTR>(this),
+                                         targetFunction);
+    if (status != HookEngine::kOk) {
+        LOG(L"Mod %s error: QueueEnableHook returned %d", m_modName.c_str(),
+            status);
         return FALSE;
     }
 
     return TRUE;
-#elif WH_HOOKING_ENGINE == WH_HOOKING_ENGINE_NONE
-    // For testing without a hooking engine.
-    LOG(L"Mod %s error: No hooking engine", m_modName.c_str());
-    return FALSE;
-#else
-#error "Unsupported hooking engine"
-#endif  // WH_HOOKING_ENGINE
 }
 
 BOOL LoadedMod::RemoveFunctionHook(void* targetFunction) {
@@ -1503,23 +1758,15 @@ BOOL LoadedMod::RemoveFunctionHook(void* targetFunction) {
         return FALSE;
     }
 
-#ifdef WH_HOOKING_ENGINE_MINHOOK
-    MH_STATUS status = MH_QueueDisableHookEx(reinterpret_cast<ULONG_PTR>(this),
-                                             targetFunction);
-    if (status != MH_OK) {
-        LOG(L"Mod %s error: MH_QueueDisableHookEx returned %d",
-            m_modName.c_str(), status);
+    auto status = HookEngine::QueueDisableHook(
+        reinterpret_cast<ULONG_PTR>(this), targetFunction);
+    if (status != HookEngine::kOk) {
+        LOG(L"Mod %s error: QueueDisableHook returned %d", m_modName.c_str(),
+            status);
         return FALSE;
     }
 
     return TRUE;
-#elif WH_HOOKING_ENGINE == WH_HOOKING_ENGINE_NONE
-    // For testing without a hooking engine.
-    LOG(L"Mod %s error: No hooking engine", m_modName.c_str());
-    return FALSE;
-#else
-#error "Unsupported hooking engine"
-#endif  // WH_HOOKING_ENGINE
 }
 
 BOOL LoadedMod::ApplyHookOperations() {
@@ -1535,28 +1782,52 @@ BOOL LoadedMod::ApplyHookOperations() {
         return FALSE;
     }
 
-#ifdef WH_HOOKING_ENGINE_MINHOOK
-    MH_STATUS status = MH_ApplyQueuedEx(reinterpret_cast<ULONG_PTR>(this));
-    if (status != MH_OK) {
-        LOG(L"Mod %s error: MH_ApplyQueuedEx returned %d", m_modName.c_str(),
+    auto status = HookEngine::ApplyQueued(reinterpret_cast<ULONG_PTR>(this));
+    if (status != HookEngine::kOk) {
+        LOG(L"Mod %s error: ApplyQueued returned %d", m_modName.c_str(),
             status);
     }
 
-    MH_STATUS removeDisabledHooksStatus =
-        MH_RemoveDisabledHooksEx(reinterpret_cast<ULONG_PTR>(this));
-    if (removeDisabledHooksStatus != MH_OK) {
-        LOG(L"Mod %s error: MH_RemoveDisabledHooksEx returned %d",
+    auto removeDisabledHooksStatus =
+        HookEngine::RemoveDisabledHooks(reinterpret_cast<ULONG_PTR>(this));
+    if (removeDisabledHooksStatus != HookEngine::kOk) {
+        LOG(L"Mod %s error: RemoveDisabledHooks returned %d",
             m_modName.c_str(), removeDisabledHooksStatus);
     }
 
-    return status == MH_OK;
-#elif WH_HOOKING_ENGINE == WH_HOOKING_ENGINE_NONE
-    // For testing without a hooking engine.
-    LOG(L"Mod %s error: No hooking engine", m_modName.c_str());
-    return FALSE;
-#else
-#error "Unsupported hooking engine"
-#endif  // WH_HOOKING_ENGINE
+    return status == HookEngine::kOk;
+}
+
+#pragma code_seg(push, ".text$zcold")
+
+void LoadedMod::SetHotSwapSource(LoadedMod* previousMod) {
+    m_hotSwapSource = previousMod;
+}
+
+size_t LoadedMod::TakeOverHooks() {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+
+    LoadedMod* previousMod = std::exchange(m_hotSwapSource, nullptr);
+    std::vector<DeferredHook> hooks = std::move(m_hotSwapHooks);
+
+    size_t count = 0;
+
+    for (const auto& hook : hooks) {
+        auto status = HookEngine::SetHookDetour(
+            reinterpret_cast<ULONG_PTR>(previousMod), hook.targetFunction,
+            reinterpret_cast<ULONG_PTR>(this), hook.hookFunction,
+            hook.originalFunction);
+        if (status == HookEngine::kOk) {
+            count++;
+            continue;
+        }
+
+        // The previous version didn't hook this target.
+        SetFunctionHook(hook.targetFunction, hook.hookFunction,
+                        hook.originalFunction);
+    }
+
+    return count;
 }
 
 HANDLE LoadedMod::FindFirstSymbol(HMODULE hModule,
@@ -1615,6 +1886,8 @@ HANDLE LoadedMod::FindFirstSymbol4(HMODULE hModule,
                                    const WH_FIND_SYMBOL_OPTIONS* options,
                                    WH_FIND_SYMBOL* findData) {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+    StartupProfile::ScopedModPhase startupPhase(
+        GetStartupTimes(), StartupProfile::ModPhase::kSymbols);
 
     if (options && options->optionsSize != sizeof(WH_FIND_SYMBOL_OPTIONS)) {
         struct WH_FIND_SYMBOL_OPTIONS_V1 {
@@ -1805,6 +2078,8 @@ BOOL LoadedMod::FindNextSymbol(HANDLE symSearch, BYTE* findData) {
 
 BOOL LoadedMod::FindNextSymbol2(HANDLE symSearch, WH_FIND_SYMBOL* findData) {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE_QUIET();
+    StartupProfile::ScopedModPhase startupPhase(
+        GetStartupTimes(), StartupProfile::ModPhase::kSymbols);
 
     try {
         auto symbolEnum = static_cast<SymbolEnum*>(symSearch);
@@ -1839,6 +2114,8 @@ BOOL LoadedMod::HookSymbols(HMODULE module,
                             size_t symbolHooksCount,
                             const WH_HOOK_SYMBOLS_OPTIONS* options) {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+    StartupProfile::ScopedModPhase startupPhase(
+        GetStartupTimes(), StartupProfile::ModPhase::kSymbols);
 
     struct WH_HOOK_SYMBOLS_OPTIONS_CURRENT {
         size_t optionsSize;
@@ -2105,271 +2382,445 @@ BOOL LoadedMod::HookSymbols(HMODULE module,
 }
 
 BOOL LoadedMod::Disasm(void* address, WH_DISASM_RESULT* result) {
-#if defined(_M_ARM64)
-    int rc = aarch64_decompose_and_disassemble(
-        reinterpret_cast<ULONG_PTR>(address),
-        *reinterpret_cast<DWORD*>(address), result->text, sizeof(result->text));
-    if (rc) {
-        LOG(L"Mod %s error: aarch64_decompose_and_disassemble returned %d",
-            m_modName.c_str(), rc);
+    unsigned int error;
+    if (!Disasm::DisassembleText(address, result, &error)) {
+        LOG(L"Mod %s error: disassembly failed with error %u",
+            m_modName.c_str(), error);
         return FALSE;
     }
 
-    result->length = sizeof(DWORD);
-
     return TRUE;
-#else
-#if defined(_M_IX86)
-    auto machineMode = ZYDIS_MACHINE_MODE_LEGACY_32;
-#elif defined(_M_X64)
-    auto machineMode = ZYDIS_MACHINE_MODE_LONG_64;
-#else
-#error "Unsupported architecture"
-#endif
+}
 
-    ZydisDisassembledInstruction instruction;
-    ZyanStatus status = ZydisDisassembleIntel(
-        /* machine_mode:    */ machineMode,
-        /* runtime_address: */ (ZyanU64)address,
-        /* buffer:          */ address,
-        /* length:          */ ZYDIS_MAX_INSTRUCTION_LENGTH,
-        /* instruction:     */ &instruction);
-    if (!ZYAN_SUCCESS(status)) {
-        LOG(L"Mod %s error: ZydisDisassembleIntel returned %u",
-            m_modName.c_str(), status);
-        return FALSE;
+size_t LoadedMod::DisasmRange(void* address,
+                              WH_DISASM_INSTRUCTION* instructions,
+                              size_t instructionsCount,
+                              const WH_DISASM_RANGE_OPTIONS* options) {
+    if (options && options->optionsSize != sizeof(WH_DISASM_RANGE_OPTIONS)) {
+        LOG(L"Unsupported options->optionsSize value: %zu",
+            options->optionsSize);
+        return 0;
     }
 
-    result->length = instruction.info.length;
-    strcpy_s(result->text, instruction.text);
+    if (instructionsCount > 0 && !instructions) {
+        LOG(L"instructions is null");
+        return 0;
+    }
+
+    bool lengthOnly = options && options->lengthOnly;
+    bool stopAtReturn = !options || !options->continueAfterReturn;
+
+    return Disasm::DecodeRange(address, instructions, instructionsCount,
+                               lengthOnly, stopAtReturn);
+}
+
+HANDLE LoadedMod::RegisterModuleLoadCallback(
+    PCWSTR moduleNamePattern,
+    WH_MODULE_LOAD_CALLBACK callback,
+    void* param,
+    const WH_MODULE_LOAD_CALLBACK_OPTIONS* options) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+    VERBOSE(L"Module name pattern: %s",
+            moduleNamePattern ? moduleNamePattern : L"(null)");
+
+    if (options &&
+        options->optionsSize != sizeof(WH_MODULE_LOAD_CALLBACK_OPTIONS)) {
+        LOG(L"Unsupported options->optionsSize value: %zu",
+            options->optionsSize);
+        return nullptr;
+    }
+
+    if (!moduleNamePattern || !*moduleNamePattern || !callback) {
+        LOG(L"Invalid arguments");
+        return nullptr;
+    }
+
+    if (m_uninitializing) {
+        LOG(L"Can't register a module load callback while uninitializing");
+        return nullptr;
+    }
+
+    bool async = options && options->async;
+
+    try {
+        return ModuleLoadNotifier::GetInstance().Register(
+            this, moduleNamePattern,
+            [callback, param](HMODULE module, PCWSTR moduleName) {
+                callback(module, moduleName, param);
+            },
+            async);
+    } catch (const std::exception& e) {
+        LogFunctionError(e);
+    }
+
+    return nullptr;
+}
+
+BOOL LoadedMod::UnregisterModuleLoadCallback(HANDLE registration) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+
+    if (!ModuleLoadNotifier::GetInstance().Unregister(this, registration)) {
+        LOG(L"Invalid module load callback handle: %p", registration);
+        return FALSE;
+    }
 
     return TRUE;
-#endif  // defined(_M_ARM64)
 }
 
 const WH_URL_CONTENT* LoadedMod::GetUrlContent(
     PCWSTR url,
     const WH_GET_URL_CONTENT_OPTIONS* options) {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+
+    WH_GET_URL_CONTENT_OPTIONS optionsResolved;
+    if (!ResolveGetUrlContentOptions(options, &optionsResolved)) {
+        return nullptr;
+    }
+
     VERBOSE(L"URL: %s", url);
-    VERBOSE(L"Target file path: %s", options && options->targetFilePath
-                                         ? options->targetFilePath
+    VERBOSE(L"Target file path: %s", optionsResolved.targetFilePath
+                                         ? optionsResolved.targetFilePath
                                          : L"(none)");
 
-    if (options && options->optionsSize != sizeof(WH_GET_URL_CONTENT_OPTIONS)) {
-        struct WH_GET_URL_CONTENT_OPTIONS_V1 {
-            size_t optionsSize;
-            PCWSTR targetFilePath;
-        };
-        static_assert(sizeof(WH_GET_URL_CONTENT_OPTIONS) ==
-                          sizeof(WH_GET_URL_CONTENT_OPTIONS_V1),
-                      "Struct was updated, update this code too");
+    try {
+        return UrlContent::Get(url, optionsResolved);
+    } catch (const std::exception& e) {
+        LogFunctionError(e);
+    }
 
-        LOG(L"Unsupported options->optionsSize value: %zu",
-            options->optionsSize);
+    return nullptr;
+}
+
+void LoadedMod::FreeUrlContent(const WH_URL_CONTENT* content) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+
+    UrlContent::Free(content);
+}
+
+HANDLE LoadedMod::GetUrlContentAsync(PCWSTR url,
+                                     const WH_GET_URL_CONTENT_OPTIONS* options,
+                                     WH_URL_CONTENT_CALLBACK callback,
+                                     void* param) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+    VERBOSE(L"URL: %s", url ? url : L"(null)");
+
+    WH_GET_URL_CONTENT_OPTIONS optionsResolved;
+    if (!ResolveGetUrlContentOptions(options, &optionsResolved)) {
         return nullptr;
     }
 
-    // Avoid having winhttp.dll in the import table, since it might not be
-    // available in all cases, e.g. sandboxed processes.
-    using WinHttpCloseHandle_t = decltype(&WinHttpCloseHandle);
-    using WinHttpOpen_t = decltype(&WinHttpOpen);
-    using WinHttpConnect_t = decltype(&WinHttpConnect);
-    using WinHttpQueryHeaders_t = decltype(&WinHttpQueryHeaders);
-    using WinHttpReceiveResponse_t = decltype(&WinHttpReceiveResponse);
-    using WinHttpSendRequest_t = decltype(&WinHttpSendRequest);
-    using WinHttpOpenRequest_t = decltype(&WinHttpOpenRequest);
-    using WinHttpQueryDataAvailable_t = decltype(&WinHttpQueryDataAvailable);
-    using WinHttpReadData_t = decltype(&WinHttpReadData);
-    using WinHttpCrackUrl_t = decltype(&WinHttpCrackUrl);
-
-    class WinHttpFunctions {
-       public:
-        wil::unique_hmodule module;
-
-        WinHttpCloseHandle_t CloseHandle;
-        WinHttpOpen_t Open;
-        WinHttpConnect_t Connect;
-        WinHttpQueryHeaders_t QueryHeaders;
-        WinHttpReceiveResponse_t ReceiveResponse;
-        WinHttpSendRequest_t SendRequest;
-        WinHttpOpenRequest_t OpenRequest;
-        WinHttpQueryDataAvailable_t QueryDataAvailable;
-        WinHttpReadData_t ReadData;
-        WinHttpCrackUrl_t CrackUrl;
-
-        WinHttpFunctions() {
-            wil::unique_hmodule winhttpModule{LoadLibraryEx(
-                L"winhttp.dll", nullptr, LOAD_LIBRARY_SEARCH_SYSTEM32)};
-            if (!winhttpModule) {
-                LOG(L"Failed to load winhttp.dll");
-                return;
-            }
+    if (!url || !callback) {
+        LOG(L"Invalid arguments");
+        return nullptr;
+    }
 
-            HMODULE moduleRaw = winhttpModule.get();
-
-            CloseHandle = reinterpret_cast<WinHttpCloseHandle_t>(
-                GetProcAddress(moduleRaw, "WinHttpCloseHandle"));
-            Open = reinterpret_cast<WinHttpOpen_t>(
-                GetProcAddress(moduleRaw, "WinHttpOpen"));
-            Connect = reinterpret_cast<WinHttpConnect_t>(
-                GetProcAddress(moduleRaw, "WinHttpConnect"));
-            QueryHeaders = reinterpret_cast<WinHttpQueryHeaders_t>(
-                GetProcAddress(moduleRaw, "WinHttpQueryHeaders"));
-            ReceiveResponse = reinterpret_cast<WinHttpReceiveResponse_t>(
-                GetProcAddress(moduleRaw, "WinHttpReceiveResponse"));
-            SendRequest = reinterpret_cast<WinHttpSendRequest_t>(
-                GetProcAddress(moduleRaw, "WinHttpSendRequest"));
-            OpenRequest = reinterpret_cast<WinHttpOpenRequest_t>(
-                GetProcAddress(moduleRaw, "WinHttpOpenRequest"));
-            QueryDataAvailable = reinterpret_cast<WinHttpQueryDataAvailable_t>(
-                GetProcAddress(moduleRaw, "WinHttpQueryDataAvailable"));
-            ReadData = reinterpret_cast<WinHttpReadData_t>(
-                GetProcAddress(moduleRaw, "WinHttpReadData"));
-            CrackUrl = reinterpret_cast<WinHttpCrackUrl_t>(
-                GetProcAddress(moduleRaw, "WinHttpCrackUrl"));
-
-            if (!CloseHandle || !Open || !Connect || !QueryHeaders ||
-                !ReceiveResponse || !SendRequest || !OpenRequest ||
-                !QueryDataAvailable || !ReadData || !CrackUrl) {
-                LOG(L"Failed to get all winhttp.dll functions");
-                return;
-            }
+    if (m_uninitializing) {
+        LOG(L"Can't get URL content asynchronously while uninitializing");
+        return nullptr;
+    }
 
-            module = std::move(winhttpModule);
-        }
-    };
+    try {
+        return UrlFetchPool::GetInstance().Submit(
+            this, url, optionsResolved,
+            [callback, param](const WH_URL_CONTENT* content) {
+                callback(content, param);
+            });
+    } catch (const std::exception& e) {
+        LogFunctionError(e);
+    }
+
+    return nullptr;
+}
+
+BOOL LoadedMod::CancelUrlContentAsync(HANDLE request) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+
+    if (!UrlFetchPool::GetInstance().Cancel(this, request)) {
+        VERBOSE(L"Request %p already completed or is invalid", request);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+HANDLE LoadedMod::SetImportHook(HMODULE hModule,
+                                PCWSTR dllName,
+                                PCSTR functionName,
+                                void* hookFunction,
+                                void** originalFunction,
+                                const WH_IMPORT_HOOK_OPTIONS* options) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+    VERBOSE(L"Module: %p", hModule);
+    VERBOSE(L"DLL: %s", dllName ? dllName : L"(null)");
+    if (IS_INTRESOURCE(functionName)) {
+        VERBOSE(L"Function ordinal: %u",
+                LOWORD(reinterpret_cast<ULONG_PTR>(functionName)));
+    } else {
+        VERBOSE(L"Function: %S", functionName);
+    }
+
+    VERBOSE(L"Hook: %p", hookFunction);
+
+    if (options && options->optionsSize != sizeof(WH_IMPORT_HOOK_OPTIONS)) {
+        LOG(L"Unsupported options->optionsSize value: %zu",
+            options->optionsSize);
+        return nullptr;
+    }
 
-    STATIC_INIT_ONCE(WinHttpFunctions, winhttp, );
+    if (!dllName || !functionName || !hookFunction) {
+        LOG(L"Invalid arguments");
+        return nullptr;
+    }
 
-    if (!winhttp->module) {
-        LOG(L"WinHttp functions are not available");
+    if (m_uninitializing) {
+        VERBOSE(L"Uninitializing, not allowed to set hooks");
         return nullptr;
     }
 
+    bool patchExportTable = options && options->patchExportTable;
+
     try {
-        wil::unique_hfile targetFile;
-        PCWSTR targetFilePath = options ? options->targetFilePath : nullptr;
-        if (targetFilePath) {
-            targetFile.reset(CreateFile(targetFilePath, GENERIC_WRITE,
-                                        FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
-                                        FILE_ATTRIBUTE_NORMAL, nullptr));
-            THROW_LAST_ERROR_IF(!targetFile);
-        }
-
-        URL_COMPONENTS urlComp = {sizeof(urlComp)};
-        urlComp.dwHostNameLength = (DWORD)-1;
-        urlComp.dwUrlPathLength = (DWORD)-1;
-        THROW_IF_WIN32_BOOL_FALSE(winhttp->CrackUrl(url, 0, 0, &urlComp));
-
-        HINTERNET session{winhttp->Open(L"Windhawk/" VER_FILE_VERSION_WSTR,
-                                        WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-                                        WINHTTP_NO_PROXY_NAME,
-                                        WINHTTP_NO_PROXY_BYPASS, 0)};
-        THROW_LAST_ERROR_IF_NULL(session);
-
-        auto sessionCleanup = wil::scope_exit(
-            [winhttp, session] { winhttp->CloseHandle(session); });
-
-        HINTERNET connect{winhttp->Connect(
-            session,
-            std::wstring(urlComp.lpszHostName, urlComp.dwHostNameLength)
-                .c_str(),
-            urlComp.nPort, 0)};
-        THROW_LAST_ERROR_IF_NULL(connect);
-
-        auto connectCleanup = wil::scope_exit(
-            [winhttp, connect] { winhttp->CloseHandle(connect); });
-
-        HINTERNET request{winhttp->OpenRequest(
-            connect, L"GET",
-            std::wstring(urlComp.lpszUrlPath, urlComp.dwUrlPathLength).c_str(),
-            nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES,
-            urlComp.nScheme == INTERNET_SCHEME_HTTPS ? WINHTTP_FLAG_SECURE
-                                                     : 0)};
-        THROW_LAST_ERROR_IF_NULL(request);
-
-        auto requestCleanup = wil::scope_exit(
-            [winhttp, request] { winhttp->CloseHandle(request); });
+        // While hot swapping, the import hooks of the previous version are
+        // taken over right away, since they can be replaced atomically.
+        return ImportHooks::GetInstance().Set(
+            this, hModule, dllName, functionName, hookFunction,
+            originalFunction, patchExportTable, m_hotSwapSource);
+    } catch (const std::exception& e) {
+        LogFunctionError(e);
+    }
 
-        THROW_IF_WIN32_BOOL_FALSE(
-            winhttp->SendRequest(request, WINHTTP_NO_ADDITIONAL_HEADERS, 0,
-                                 WINHTTP_NO_REQUEST_DATA, 0, 0, 0));
+    return nullptr;
+}
+
+BOOL LoadedMod::RemoveImportHook(HANDLE importHook) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+
+    if (!ImportHooks::GetInstance().Remove(this, importHook)) {
+        LOG(L"Invalid import hook handle: %p", importHook);
+        return FALSE;
+    }
 
-        THROW_IF_WIN32_BOOL_FALSE(winhttp->ReceiveResponse(request, nullptr));
+    return TRUE;
+}
 
-        DWORD statusCode = 0;
-        DWORD statusCodeSize = sizeof(statusCode);
-        THROW_IF_WIN32_BOOL_FALSE(winhttp->QueryHeaders(
-            request, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
-            WINHTTP_HEADER_NAME_BY_INDEX, &statusCode, &statusCodeSize,
-            WINHTTP_NO_HEADER_INDEX));
+BOOL LoadedMod::FindPattern(HMODULE hModule,
+                            WH_FIND_PATTERN* patterns,
+                            size_t patternsCount,
+                            const WH_FIND_PATTERN_OPTIONS* options) {
+    auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+    StartupProfile::ScopedModPhase startupPhase(
+        GetStartupTimes(), StartupProfile::ModPhase::kSymbols);
 
-        auto content = std::make_unique<WH_URL_CONTENT>();
-        content->statusCode = statusCode;
+    if (options && options->optionsSize != sizeof(WH_FIND_PATTERN_OPTIONS)) {
+        LOG(L"Unsupported options->optionsSize value: %zu",
+            options->optionsSize);
+        return FALSE;
+    }
 
-        std::string chunk;
-        std::vector<std::string> chunks;
-        DWORD downloaded = 0;
-        size_t downloadedTotal = 0;
-        do {
-            DWORD size = 0;
-            THROW_IF_WIN32_BOOL_FALSE(
-                winhttp->QueryDataAvailable(request, &size));
+    PCSTR sectionName = options ? options->sectionName : nullptr;
+    if (sectionName && strlen(sectionName) > IMAGE_SIZEOF_SHORT_NAME) {
+        LOG(L"Section name is too long: %S", sectionName);
+        return FALSE;
+    }
 
-            if (size == 0) {
-                break;
+    if (patternsCount == 0) {
+        return TRUE;
+    }
+
+    if (!patterns) {
+        LOG(L"patterns is null");
+        return FALSE;
+    }
+
+    try {
+        std::vector<PatternScan::Pattern> parsedPatterns;
+        parsedPatterns.reserve(patternsCount);
+        for (size_t i = 0; i < patternsCount; i++) {
+            std::optional<PatternScan::Pattern> pattern;
+            if (patterns[i].pattern) {
+                pattern = PatternScan::Parse(patterns[i].pattern);
+            }
+
+            if (!pattern) {
+                LOG(L"Invalid pattern: %S", patterns[i].pattern);
+                return FALSE;
             }
 
-            chunk.resize(size);
-            THROW_IF_WIN32_BOOL_FALSE(winhttp->ReadData(
-                request, (PVOID)chunk.data(), size, &downloaded));
-
-            if (targetFile) {
-                DWORD written = 0;
-                THROW_IF_WIN32_BOOL_FALSE(WriteFile(targetFile.get(),
-                                                    chunk.data(), downloaded,
-                                                    &written, nullptr));
-                THROW_WIN32_IF(ERROR_WRITE_FAULT, written != downloaded);
-            } else {
-                chunk.resize(downloaded);
-                chunks.push_back(std::move(chunk));
-                chunk.clear();
+            parsedPatterns.push_back(std::move(*pattern));
+        }
+
+        HMODULE module = hModule;
+        if (!module) {
+            module = GetModuleHandle(nullptr);
+        }
+
+        auto* moduleBase = reinterpret_cast<const BYTE*>(module);
+        auto* dosHeader = reinterpret_cast<const IMAGE_DOS_HEADER*>(module);
+        auto* ntHeader = reinterpret_cast<const IMAGE_NT_HEADERS*>(
+            moduleBase + dosHeader->e_lfanew);
+
+        std::vector<std::span<const uint8_t>> ranges;
+        auto* section = IMAGE_FIRST_SECTION(ntHeader);
+        for (WORD i = 0; i < ntHeader->FileHeader.NumberOfSections;
+             i++, section++) {
+            if (sectionName
+                    ? strncmp(reinterpret_cast<const char*>(section->Name),
+                              sectionName, IMAGE_SIZEOF_SHORT_NAME) != 0
+                    : !(section->Characteristics & IMAGE_SCN_MEM_EXECUTE)) {
+                continue;
             }
 
-            downloadedTotal += downloaded;
-        } while (downloaded > 0);
+            DWORD size = section->Misc.VirtualSize ? section->Misc.VirtualSize
+                                                   : section->SizeOfRawData;
+            ranges.emplace_back(moduleBase + section->VirtualAddress, size);
+        }
 
-        if (targetFile) {
-            content->data = nullptr;
+        if (ranges.empty()) {
+            LOG(L"No sections to scan%s%S", sectionName ? L": " : L"",
+                sectionName ? sectionName : "");
+            return FALSE;
+        }
+
+        auto [moduleFileName, cacheKey] = GetLoadedModuleCacheInfo(module);
+
+        // The results are cached as offsets from the module base, one offset
+        // and match count per pattern.
+        WCHAR patternsHash[17];
+        swprintf_s(patternsHash, L"%016llx",
+                   HashPatterns(patterns, patternsCount));
+
+        cacheKey += L'_';
+        if (sectionName) {
+            // Section names are ASCII.
+            cacheKey.append(sectionName, sectionName + strlen(sectionName));
         } else {
-            auto data = std::make_unique<char[]>(downloadedTotal + 1);
-            size_t dataIter = 0;
-            for (const auto& chunk : chunks) {
-                std::copy(chunk.begin(), chunk.end(), data.get() + dataIter);
-                dataIter += chunk.size();
+            cacheKey += L'*';
+        }
+        cacheKey += L'_';
+        cacheKey += patternsHash;
+
+        auto& storageManager = StorageManager::GetInstance();
+
+        try {
+            auto patternCache = storageManager.GetModWritableConfig(
+                m_modName.c_str(), L"PatternCache", false);
+            auto cached =
+                patternCache->GetString(cacheKey.c_str()).value_or(L"");
+            auto cachedParts = Functions::SplitStringToViews(cached, L'#');
+            if (cachedParts.size() == 1 + patternsCount * 2 &&
+                cachedParts[0] == L"1") {
+                for (size_t i = 0; i < patternsCount; i++) {
+                    auto offset = std::wstring(cachedParts[1 + i * 2]);
+                    auto count = std::wstring(cachedParts[2 + i * 2]);
+                    size_t matchCount = wcstoull(count.c_str(), nullptr, 10);
+                    patterns[i].address =
+                        matchCount ? const_cast<BYTE*>(moduleBase) +
+                                         wcstoull(offset.c_str(), nullptr, 10)
+                                   : nullptr;
+                    patterns[i].matchCount = matchCount;
+                }
+
+                VERBOSE(L"Using pattern cache %s", cacheKey.c_str());
+                return TRUE;
             }
-            data[dataIter] = '\0';
-            content->data = data.release();
+        } catch (const std::exception& e) {
+            LOG(L"%S", e.what());
         }
 
-        content->length = downloadedTotal;
+        SetTask((L"Scanning patterns... (" + moduleFileName + L")").c_str());
+        auto activityStatusCleanup = wil::scope_exit(
+            [this] { SetTask(m_initialized ? nullptr : L"Initializing..."); });
+
+        auto results = ScanForPatterns(ranges, std::move(parsedPatterns));
+
+        std::wstring newCache = L"1";
+        for (size_t i = 0; i < patternsCount; i++) {
+            const auto& result = results[i];
+            patterns[i].address = const_cast<BYTE*>(result.firstMatch);
+            patterns[i].matchCount = result.matchCount;
+
+            newCache += L'#';
+            newCache += std::to_wstring(
+                result.firstMatch ? result.firstMatch - moduleBase : 0);
+            newCache += L'#';
+            newCache += std::to_wstring(result.matchCount);
+        }
+
+        try {
+            auto patternCache = storageManager.GetModWritableConfig(
+                m_modName.c_str(), L"PatternCache", true);
+            patternCache->SetString(cacheKey.c_str(), newCache.c_str());
+        } catch (const std::exception& e) {
+            LOG(L"%S", e.what());
+        }
 
-        return content.release();
+        return TRUE;
     } catch (const std::exception& e) {
         LogFunctionError(e);
     }
 
-    return nullptr;
+    return FALSE;
 }
 
-void LoadedMod::FreeUrlContent(const WH_URL_CONTENT* content) {
+size_t LoadedMod::FindCallers(HMODULE hModule,
+                              void* targetFunction,
+                              void** callers,
+                              size_t callersCount) {
     auto modDebugLoggingScope = MOD_DEBUG_LOGGING_SCOPE();
+    StartupProfile::ScopedModPhase startupPhase(
+        GetStartupTimes(), StartupProfile::ModPhase::kSymbols);
+
+    if (callersCount > 0 && !callers) {
+        LOG(L"callers is null");
+        return 0;
+    }
+
+    try {
+        HMODULE module = hModule;
+        if (!module) {
+            module = GetModuleHandle(nullptr);
+        }
+
+        auto* moduleBase = reinterpret_cast<BYTE*>(module);
+        auto* dosHeader = reinterpret_cast<const IMAGE_DOS_HEADER*>(module);
+        auto* ntHeader = reinterpret_cast<const IMAGE_NT_HEADERS*>(
+            moduleBase + dosHeader->e_lfanew);
+
+        auto* target = static_cast<BYTE*>(targetFunction);
+        if (target < moduleBase ||
+            target >= moduleBase + ntHeader->OptionalHeader.SizeOfImage) {
+            LOG(L"Target %p is outside of module %p", targetFunction, module);
+            return 0;
+        }
+
+        auto cacheInfo = GetLoadedModuleCacheInfo(module);
+
+        bool building = false;
+        auto activityStatusCleanup = wil::scope_exit([this, &building] {
+            if (building) {
+                SetTask(m_initialized ? nullptr : L"Initializing...");
+            }
+        });
 
-    if (content) {
-        delete[] content->data;
-        delete content;
+        const auto& callIndex = CallIndex::Get(module, cacheInfo.cacheKey, [&] {
+            VERBOSE(L"Building call index %s", cacheInfo.cacheKey.c_str());
+            SetTask(
+                (L"Indexing calls... (" + cacheInfo.fileName + L")").c_str());
+            building = true;
+        });
+
+        auto callerRvas =
+            callIndex.FindCallers(static_cast<DWORD>(target - moduleBase));
+        for (size_t i = 0; i < callersCount && i < callerRvas.size(); i++) {
+            callers[i] = moduleBase + callerRvas[i];
+        }
+
+        return callerRvas.size();
+    } catch (const std::exception& e) {
+        LogFunctionError(e);
     }
+
+    return 0;
 }
 
 std::optional<std::wstring> LoadedMod::HookSymbolsGetOnlineCache(
@@ -2463,10 +2914,11 @@ std::optional<std::wstring> LoadedMod::HookSymbolsGetOnlineCache(
     return std::nullopt;
 }
 
+#pragma code_seg(pop)
+
 void LoadedMod::SetTask(PCWSTR task) {
     try {
-        SetModMetadataValue(m_modTaskFile, task, L"mod-task",
-                            m_modInstanceId.c_str());
+        m_modTask.Set(task);
     } catch (const std::exception& e) {
         LOG(L"%S", e.what());
     }
@@ -2476,12 +2928,26 @@ void LoadedMod::LogFunctionError(const std::exception& e) {
     LOG(L"Mod %s error: %S", m_modName.c_str(), e.what());
 }
 
+void LoadedMod::LogSuppressedCount() {
+    DWORD count = m_logRateLimiter.TakeSuppressedCount(GetTickCount64(),
+                                                       /*force=*/true);
+    if (count > 0) {
+        LogModLine(m_modName.c_str(),
+                   L"%u log lines were suppressed by the rate limit", count);
+    }
+}
+
+StartupProfile::ModTimes* LoadedMod::GetStartupTimes() {
+    return m_startupTimesPending ? &m_startupTimes : nullptr;
+}
+
 Mod::Mod(PCWSTR modName)
-    : m_modName(modName), m_modInstanceId(GenerateModInstanceId(modName)) {
+    : m_modName(modName),
+      m_modStatus(ModStatusTable::Category::kModStatus, modName) {
     SetStatus(L"Pending...");
 }
 
-bool Mod::Load(bool loadedOnStartup) {
+bool Mod::Load(bool loadedOnStartup, LoadedMod* hotSwapSource) {
     if (m_loadedMod) {
         throw std::logic_error("Already loaded");
     }
@@ -2510,11 +2976,15 @@ bool Mod::Load(bool loadedOnStartup) {
         settings->GetInt(L"DebugLoggingEnabled").value_or(0);
 
     m_loadedMod = std::make_unique<LoadedMod>(
-        m_modName.c_str(), m_modInstanceId.c_str(), libraryPath.c_str(),
-        loadedOnStartup, loggingEnabled, debugLoggingEnabled);
+        m_modName.c_str(), libraryPath.c_str(), loadedOnStartup,
+        loggingEnabled, debugLoggingEnabled);
 
     SetStatus(L"Loading...");
 
+    if (hotSwapSource) {
+        m_loadedMod->SetHotSwapSource(hotSwapSource);
+    }
+
     if (!m_loadedMod->Initialize()) {
         m_loadedMod.reset();
         return false;
@@ -2583,6 +3053,45 @@ void Mod::Unload() {
     SetStatus(L"Unloaded");
 }
 
+bool Mod::CanHotSwap() {
+    if (!HookEngine::kCanSetHookDetour || !m_loadedMod) {
+        return false;
+    }
+
+    auto settings = StorageManager::GetInstance().GetModConfig(
+        m_modName.c_str(), nullptr);
+
+    return settings->GetInt(L"HotSwapEnabled").value_or(0) &&
+           settings->GetString(L"LibraryFileName").value_or(L"") !=
+               m_libraryFileName;
+}
+
+std::unique_ptr<LoadedMod> Mod::HotSwap() {
+    std::unique_ptr<LoadedMod> previousMod = std::move(m_loadedMod);
+
+    try {
+        Load(/*loadedOnStartup=*/false, previousMod.get());
+    } catch (const std::exception& e) {
+        LOG(L"Mod (%s) hot swap loading failed: %S", m_modName.c_str(),
+            e.what());
+    }
+
+    if (m_loadedMod) {
+        size_t count = m_loadedMod->TakeOverHooks();
+        VERBOSE(L"Mod (%s) took over %zu hooks", m_modName.c_str(), count);
+    }
+
+    // Must be called after the hooks are taken over, since it queues the
+    // remaining hooks of the previous version to be disabled.
+    try {
+        previousMod->BeforeUninit();
+    } catch (const std::exception& e) {
+        LOG(L"Mod (%s) BeforeUninit failed: %S", m_modName.c_str(), e.what());
+    }
+
+    return previousMod;
+}
+
 HMODULE Mod::GetLoadedModModuleHandle() {
     return m_loadedMod ? m_loadedMod->GetModModuleHandle() : nullptr;
 }
@@ -2641,10 +3150,16 @@ bool Mod::ShouldLoadInRunningProcess(PCWSTR modName) {
     return !exclude;
 }
 
+bool Mod::IsThreadAgnostic(PCWSTR modName) {
+    auto settings =
+        StorageManager::GetInstance().GetModConfig(modName, nullptr);
+
+    return settings->GetInt(L"ThreadAgnostic").value_or(0);
+}
+
 void Mod::SetStatus(PCWSTR status) {
     try {
-        SetModMetadataValue(m_modStatusFile, status, L"mod-status",
-                            m_modInstanceId.c_str());
+        m_modStatus.Set(status);
     } catch (const std::exception& e) {
         LOG(L"%S", e.what());
     }
@@ -1,11 +1,14 @@
 #pragma once
 
+#include "log_rate_limiter.h"
+#include "memory_usage.h"
+#include "mod_status.h"
 #include "mods_api.h"
+#include "startup_profile.h"
 
 class LoadedMod {
    public:
     LoadedMod(PCWSTR modName,
-              PCWSTR modInstanceId,
               PCWSTR libraryPath,
               bool loadedOnStartup,
               bool loggingEnabled,
@@ -55,6 +58,13 @@ class LoadedMod {
     BOOL RemoveFunctionHook(void* targetFunction);
     BOOL ApplyHookOperations();
 
+    // Used to hot swap a recompiled mod. Until TakeOverHooks is called, hooks
+    // are deferred. TakeOverHooks moves the enabled hooks of previousMod on the
+    // same targets to this mod, and creates the rest as usual. Returns the
+    // number of hooks which were taken over.
+    void SetHotSwapSource(LoadedMod* previousMod);
+    size_t TakeOverHooks();
+
     HANDLE FindFirstSymbol(HMODULE hModule,
                            PCWSTR symbolServer,
                            BYTE* findData);
@@ -83,53 +93,132 @@ class LoadedMod {
         const WH_GET_URL_CONTENT_OPTIONS* options);
     void FreeUrlContent(const WH_URL_CONTENT* content);
 
+    BOOL FindPattern(HMODULE hModule,
+                     WH_FIND_PATTERN* patterns,
+                     size_t patternsCount,
+                     const WH_FIND_PATTERN_OPTIONS* options);
+
+    size_t FindCallers(HMODULE hModule,
+                       void* targetFunction,
+                       void** callers,
+                       size_t callersCount);
+
+    size_t DisasmRange(void* address,
+                       WH_DISASM_INSTRUCTION* instructions,
+                       size_t instructionsCount,
+                       const WH_DISASM_RANGE_OPTIONS* options);
+
+    HANDLE RegisterModuleLoadCallback(
+        PCWSTR moduleNamePattern,
+        WH_MODULE_LOAD_CALLBACK callback,
+        void* param,
+        const WH_MODULE_LOAD_CALLBACK_OPTIONS* options);
+    BOOL UnregisterModuleLoadCallback(HANDLE registration);
+
+    HANDLE GetUrlContentAsync(PCWSTR url,
+                              const WH_GET_URL_CONTENT_OPTIONS* options,
+                              WH_URL_CONTENT_CALLBACK callback,
+                              void* param);
+    BOOL CancelUrlContentAsync(HANDLE request);
+
+    HANDLE SetImportHook(HMODULE hModule,
+                         PCWSTR dllName,
+                         PCSTR functionName,
+                         void* hookFunction,
+                         void** originalFunction,
+                         const WH_IMPORT_HOOK_OPTIONS* options);
+    BOOL RemoveImportHook(HANDLE importHook);
+
    private:
+    // The lifecycle callbacks of the mod, resolved once when it's loaded. Any
+    // of them can be nullptr.
+    struct Callbacks {
+        BOOL(__cdecl* init)();
+        void(__cdecl* afterInit)();
+        void(__cdecl* beforeUninit)();
+        void(__cdecl* uninit)();
+        BOOL(__cdecl* settingsChangedEx)(BOOL* reload);
+        void(__cdecl* settingsChanged)();
+    };
+
+    struct DeferredHook {
+        void* targetFunction;
+        void* hookFunction;
+        void** originalFunction;
+    };
+
     std::optional<std::wstring> HookSymbolsGetOnlineCache(
         PCWSTR onlineCacheBaseUrl,
         std::wstring_view cacheStrKey);
 
     void SetTask(PCWSTR task);
     void LogFunctionError(const std::exception& e);
+    void LogSuppressedCount();
+    StartupProfile::ModTimes* GetStartupTimes();
 
     std::wstring m_modName;
-    std::wstring m_modInstanceId;
-    wil::unique_hfile m_modTaskFile;
+    ModStatus::Entry m_modTask;
     bool m_loadedOnStartup;
     std::atomic<bool> m_loggingEnabled = false;
     std::atomic<bool> m_debugLoggingEnabled = false;
+    LogRateLimiter m_logRateLimiter;
+    // Only measured for mods which are loaded on startup, until the end of
+    // AfterInit.
+    StartupProfile::ModTimes m_startupTimes;
+    std::atomic<bool> m_startupTimesPending;
+    MemoryUsage::TrackedSize m_memoryUsage{MemoryUsage::Subsystem::kMods,
+                                           sizeof(LoadedMod)};
     std::atomic<bool> m_initialized = false;
     std::atomic<bool> m_uninitializing = false;
 
     // Temporary compatibility flag.
     const bool m_compatDemangling = false;
 
+    LoadedMod* m_hotSwapSource = nullptr;
+    std::vector<DeferredHook> m_hotSwapHooks;
+
     // Temporary compatibility shim library.
     wil::unique_hmodule m_modShimLibrary;
 
     wil::unique_hmodule m_modModule;
+    Callbacks m_callbacks{};
 };
 
 class Mod {
    public:
     Mod(PCWSTR modName);
 
-    bool Load(bool loadedOnStartup);
+    bool Load(bool loadedOnStartup, LoadedMod* hotSwapSource = nullptr);
     void AfterInit();
     void BeforeUninit();
     void Uninitialize();
     bool ApplyChangedSettings(bool* reload);
     void Unload();
 
+    // Whether the mod was recompiled, and can be reloaded with HotSwap instead
+    // of being unloaded first. The mod must support being initialized while
+    // its previous version is still loaded.
+    bool CanHotSwap();
+    // Loads the new version of the mod while the previous version keeps
+    // running, and queues the hooks which weren't taken over to be disabled.
+    // Returns the previous version, which must be uninitialized and destroyed
+    // once the queued hooks are applied.
+    std::unique_ptr<LoadedMod> HotSwap();
+
     HMODULE GetLoadedModModuleHandle();
 
     static bool ShouldLoadInRunningProcess(PCWSTR modName);
+    // Whether the mod declared that its callbacks can run on any thread, see
+    // the thread contract in mods_api.h. Such mods can be loaded on startup
+    // concurrently with other mods, and their callbacks can run on the thread
+    // pool.
+    static bool IsThreadAgnostic(PCWSTR modName);
 
    private:
     void SetStatus(PCWSTR status);
 
     std::wstring m_modName;
-    std::wstring m_modInstanceId;
-    wil::unique_hfile m_modStatusFile;
+    ModStatus::Entry m_modStatus;
     std::wstring m_libraryFileName;
     int m_settingsChangeTime = 0;
     std::unique_ptr<LoadedMod> m_loadedMod;
@@ -0,0 +1,242 @@
+#include "stdafx.h"
+
+#include "logger.h"
+#include "mod_image_preloader.h"
+#include "var_init_once.h"
+
+namespace {
+
+// Mods are compiled to a separate folder per architecture. Folders of
+// architectures which the OS doesn't support just don't contain the library.
+constexpr USHORT kMachines[] = {
+    IMAGE_FILE_MACHINE_I386,
+    IMAGE_FILE_MACHINE_AMD64,
+    IMAGE_FILE_MACHINE_ARM64,
+};
+
+// WIN32_MEMORY_RANGE_ENTRY, which isn't defined when targeting Windows 7.
+struct MEMORY_RANGE_ENTRY {
+    PVOID VirtualAddress;
+    SIZE_T NumberOfBytes;
+};
+
+using PrefetchVirtualMemory_t =
+    BOOL(WINAPI*)(HANDLE hProcess,
+                  ULONG_PTR NumberOfEntries,
+                  MEMORY_RANGE_ENTRY* VirtualAddresses,
+                  ULONG Flags);
+
+PrefetchVirtualMemory_t GetPrefetchVirtualMemory() {
+    // Available since Windows 8.
+    STATIC_INIT_ONCE_TRIVIAL(
+        PrefetchVirtualMemory_t, pPrefetchVirtualMemory, []() {
+            HMODULE kernel32Module = GetModuleHandle(L"kernel32.dll");
+            return kernel32Module
+                       ? reinterpret_cast<PrefetchVirtualMemory_t>(
+                             GetProcAddress(kernel32Module,
+                                            "PrefetchVirtualMemory"))
+                       : nullptr;
+        }());
+    return pPrefetchVirtualMemory;
+}
+
+wil::unique_handle OpenImageSection(PCWSTR libraryPath) {
+    wil::unique_hfile file(CreateFile(libraryPath, GENERIC_READ,
+                                      FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                      nullptr, OPEN_EXISTING, 0, nullptr));
+    if (!file) {
+        DWORD error = GetLastError();
+        if (error != ERROR_FILE_NOT_FOUND && error != ERROR_PATH_NOT_FOUND) {
+            VERBOSE(L"Failed to open %s: %u", libraryPath, error);
+        }
+
+        return {};
+    }
+
+    // The section keeps a reference to the file, which can be closed.
+    wil::unique_handle section(CreateFileMapping(
+        file.get(), nullptr, PAGE_READONLY | SEC_IMAGE, 0, 0, nullptr));
+    if (!section) {
+        VERBOSE(L"Failed to create an image section for %s: %u", libraryPath,
+                GetLastError());
+    }
+
+    return section;
+}
+
+void PrefetchImageSection(HANDLE section) {
+    auto pPrefetchVirtualMemory = GetPrefetchVirtualMemory();
+    if (!pPrefetchVirtualMemory) {
+        return;
+    }
+
+    // Images of other architectures can be mapped too, they just can't be
+    // executed.
+    void* view = MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        VERBOSE(L"MapViewOfFile failed: %u", GetLastError());
+        return;
+    }
+
+    auto unmapViewOnExit = wil::scope_exit([view] { UnmapViewOfFile(view); });
+
+    // An image view consists of a region per section of the image.
+    SIZE_T viewSize = 0;
+    MEMORY_BASIC_INFORMATION memoryInfo;
+    while (VirtualQuery(static_cast<BYTE*>(view) + viewSize, &memoryInfo,
+                        sizeof(memoryInfo)) &&
+           memoryInfo.AllocationBase == view) {
+        viewSize += memoryInfo.RegionSize;
+    }
+
+    // The pages are read asynchronously into the standby list, where they're
+    // shared with the processes which map the image later.
+    MEMORY_RANGE_ENTRY range = {view, viewSize};
+    if (!pPrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0)) {
+        VERBOSE(L"PrefetchVirtualMemory failed: %u", GetLastError());
+    }
+}
+
+}  // namespace
+
+ModImagePreloader::ModImagePreloader() {
+    // Without the notification, the sections would never be closed, and the
+    // libraries of removed mods couldn't be deleted.
+    m_modConfigChangeNotification.emplace();
+
+    m_refreshWork.reset(
+        CreateThreadpoolWork(RefreshWorkCallback, this, nullptr));
+    THROW_LAST_ERROR_IF_NULL(m_refreshWork);
+
+    if (m_modConfigChangeNotification->CanMonitorAcrossThreads()) {
+        m_modConfigChangeWait.reset(
+            CreateThreadpoolWait(ModConfigChangeWaitCallback, this, nullptr));
+        THROW_LAST_ERROR_IF_NULL(m_modConfigChangeWait);
+
+        m_waitOnThreadPool = true;
+        SetThreadpoolWait(m_modConfigChangeWait.get(),
+                          m_modConfigChangeNotification->GetHandle(), nullptr);
+    }
+
+    SubmitThreadpoolWork(m_refreshWork.get());
+}
+
+ModImagePreloader::~ModImagePreloader() {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_closing = true;
+}
+
+void ModImagePreloader::RefreshIfChanged() noexcept {
+    if (m_waitOnThreadPool) {
+        return;
+    }
+
+    try {
+        if (WaitForSingleObject(m_modConfigChangeNotification->GetHandle(),
+                                0) != WAIT_OBJECT_0) {
+            return;
+        }
+
+        m_modConfigChangeNotification->ContinueMonitoring();
+    } catch (const std::exception& e) {
+        LOG(L"%S", e.what());
+    }
+
+    SubmitThreadpoolWork(m_refreshWork.get());
+}
+
+// static
+void CALLBACK
+ModImagePreloader::RefreshWorkCallback(PTP_CALLBACK_INSTANCE instance,
+                                       PVOID context,
+                                       PTP_WORK work) {
+    static_cast<ModImagePreloader*>(context)->Refresh();
+}
+
+// static
+void CALLBACK ModImagePreloader::ModConfigChangeWaitCallback(
+    PTP_CALLBACK_INSTANCE instance,
+    PVOID context,
+    PTP_WAIT wait,
+    TP_WAIT_RESULT waitResult) {
+    auto* preloader = static_cast<ModImagePreloader*>(context);
+
+    try {
+        preloader->m_modConfigChangeNotification->ContinueMonitoring();
+    } catch (const std::exception& e) {
+        LOG(L"%S", e.what());
+    }
+
+    preloader->Refresh();
+
+    std::lock_guard<std::mutex> guard(preloader->m_mutex);
+    if (!preloader->m_closing) {
+        SetThreadpoolWait(wait,
+                          preloader->m_modConfigChangeNotification->GetHandle(),
+                          nullptr);
+    }
+}
+
+void ModImagePreloader::Refresh() noexcept {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (m_closing) {
+        return;
+    }
+
+    try {
+        RefreshLocked();
+    } catch (const std::exception& e) {
+        LOG(L"%S", e.what());
+    }
+}
+
+void ModImagePreloader::RefreshLocked() {
+    auto& storageManager = StorageManager::GetInstance();
+
+    // Sections which are still needed are moved from m_sections, the rest are
+    // closed.
+    std::unordered_map<std::wstring, wil::unique_handle> sections;
+
+    storageManager.EnumMods([this, &storageManager, &sections](PCWSTR modName) {
+        try {
+            auto settings = storageManager.GetModConfig(modName, nullptr);
+
+            if (settings->GetInt(L"Disabled").value_or(0)) {
+                return;
+            }
+
+            auto libraryFileName =
+                settings->GetString(L"LibraryFileName").value_or(L"");
+            if (libraryFileName.empty()) {
+                return;
+            }
+
+            for (USHORT machine : kMachines) {
+                std::wstring libraryPath =
+                    storageManager.GetModsPath(machine) / libraryFileName;
+
+                if (auto node = m_sections.extract(libraryPath)) {
+                    sections.insert(std::move(node));
+                    continue;
+                }
+
+                wil::unique_handle section =
+                    OpenImageSection(libraryPath.c_str());
+                if (!section) {
+                    continue;
+                }
+
+                PrefetchImageSection(section.get());
+
+                sections.try_emplace(std::move(libraryPath),
+                                     std::move(section));
+            }
+        } catch (const std::exception& e) {
+            LOG(L"Mod %s: %S", modName, e.what());
+        }
+    });
+
+    m_sections = std::move(sections);
+
+    VERBOSE(L"Keeping %zu mod images", m_sections.size());
+}
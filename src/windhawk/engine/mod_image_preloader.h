@@ -0,0 +1,57 @@
+#pragma once
+
+#include "storage_manager.h"
+
+// Used by the session manager to keep the images of enabled mods warm for the
+// processes which load them. An image section is kept open for each mod
+// library of each architecture, so that the memory manager keeps the shared
+// image pages even while no process has the mod loaded, and the image is
+// prefetched when it's first opened, so that the first process which loads
+// the mod after boot doesn't have to wait for the disk.
+//
+// While a section is open, the library file can't be deleted. The images are
+// refreshed on the thread pool as soon as the mod config changes, so that the
+// sections of libraries which are no longer used are closed before the app
+// deletes them. The first refresh is done on the thread pool as well.
+class ModImagePreloader {
+   public:
+    ModImagePreloader();
+    ~ModImagePreloader();
+
+    ModImagePreloader(const ModImagePreloader&) = delete;
+    ModImagePreloader& operator=(const ModImagePreloader&) = delete;
+
+    // Checks for mod config changes if they can't be waited for on the thread
+    // pool, i.e. on Windows 7, where the registry notification is bound to the
+    // thread which requested it. Must be called from the thread which created
+    // the object.
+    void RefreshIfChanged() noexcept;
+
+   private:
+    static void CALLBACK RefreshWorkCallback(PTP_CALLBACK_INSTANCE instance,
+                                             PVOID context,
+                                             PTP_WORK work);
+    static void CALLBACK ModConfigChangeWaitCallback(
+        PTP_CALLBACK_INSTANCE instance,
+        PVOID context,
+        PTP_WAIT wait,
+        TP_WAIT_RESULT waitResult);
+
+    void Refresh() noexcept;
+    void RefreshLocked();
+
+    std::optional<StorageManager::ModConfigChangeNotification>
+        m_modConfigChangeNotification;
+    bool m_waitOnThreadPool = false;
+
+    std::mutex m_mutex;
+    // Set by the destructor, after which the wait isn't set again.
+    bool m_closing = false;
+    // Section handles by library path.
+    std::unordered_map<std::wstring, wil::unique_handle> m_sections;
+
+    // Declared last, so that pending callbacks are cancelled and running ones
+    // are waited for before the rest is destroyed.
+    wil::unique_threadpool_work m_refreshWork;
+    wil::unique_threadpool_wait m_modConfigChangeWait;
+};
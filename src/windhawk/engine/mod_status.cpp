@@ -0,0 +1,184 @@
+#include "stdafx.h"
+
+#include "customization_session.h"
+#include "functions.h"
+#include "logger.h"
+#include "mod_status.h"
+#include "session_private_namespace.h"
+#include "session_table_view.h"
+#include "var_init_once.h"
+
+namespace {
+
+// The session table and its change events, as opened by a target process.
+class ModStatusTableView {
+   public:
+    static ModStatusTableView& GetInstance() {
+        STATIC_INIT_ONCE(ModStatusTableView, s);
+        return *s;
+    }
+
+    ModStatusTable::SessionTable* GetTable() {
+        return m_view ? m_view->GetTable() : nullptr;
+    }
+    PCWSTR GetProcessName() { return m_view->GetProcessName(); }
+    ULONGLONG GetProcessCreationTime() {
+        return m_view->GetProcessCreationTime();
+    }
+
+    void NotifyChanged(ModStatusTable::Category category) {
+        m_view->GetTable()->NotifyChanged();
+
+        switch (category) {
+            case ModStatusTable::Category::kModStatus:
+                SetEvent(m_modStatusChangedEvent.get());
+                break;
+
+            case ModStatusTable::Category::kModTask:
+                SetEvent(m_modTaskChangedEvent.get());
+                break;
+
+            case ModStatusTable::Category::kEngineMemory:
+                break;
+        }
+    }
+
+   private:
+    ModStatusTableView() {
+        try {
+            Open();
+        } catch (const std::exception& e) {
+            LOG(L"Failed to open the mod status table: %S", e.what());
+            m_view.reset();
+        }
+    }
+
+    void Open() {
+        DWORD sessionManagerProcessId =
+            CustomizationSession::GetSessionManagerProcessId();
+
+        m_view.emplace(ModStatusTable::kFileMappingName,
+                       ModStatusTable::kVersion);
+
+        m_modStatusChangedEvent.reset(OpenEvent(
+            EVENT_MODIFY_STATE, FALSE,
+            SessionPrivateNamespace::MakeObjectName(
+                sessionManagerProcessId,
+                ModStatusTable::kModStatusChangedEventName)
+                .c_str()));
+        THROW_LAST_ERROR_IF(!m_modStatusChangedEvent);
+
+        m_modTaskChangedEvent.reset(OpenEvent(
+            EVENT_MODIFY_STATE, FALSE,
+            SessionPrivateNamespace::MakeObjectName(
+                sessionManagerProcessId,
+                ModStatusTable::kModTaskChangedEventName)
+                .c_str()));
+        THROW_LAST_ERROR_IF(!m_modTaskChangedEvent);
+    }
+
+    std::optional<SessionTableView<ModStatusTable::SessionTable>> m_view;
+    wil::unique_event_nothrow m_modStatusChangedEvent;
+    wil::unique_event_nothrow m_modTaskChangedEvent;
+};
+
+}  // namespace
+
+namespace ModStatus {
+
+SessionTable::SessionTable() {
+    DWORD sessionManagerProcessId = GetCurrentProcessId();
+
+    wil::unique_hlocal secDesc;
+    THROW_IF_WIN32_BOOL_FALSE(
+        Functions::GetFullAccessSecurityDescriptor(&secDesc, nullptr));
+
+    SECURITY_ATTRIBUTES secAttr{
+        .nLength = sizeof(secAttr),
+        .lpSecurityDescriptor = secDesc.get(),
+        .bInheritHandle = FALSE,
+    };
+
+    m_fileMapping.reset(CreateFileMapping(
+        INVALID_HANDLE_VALUE, &secAttr, PAGE_READWRITE, 0,
+        sizeof(ModStatusTable::SessionTable),
+        SessionPrivateNamespace::MakeObjectName(
+            sessionManagerProcessId, ModStatusTable::kFileMappingName)
+            .c_str()));
+    THROW_LAST_ERROR_IF(!m_fileMapping ||
+                        GetLastError() == ERROR_ALREADY_EXISTS);
+
+    wil::unique_mapview_ptr<ModStatusTable::SessionTable> table(
+        reinterpret_cast<ModStatusTable::SessionTable*>(
+            MapViewOfFile(m_fileMapping.get(), FILE_MAP_WRITE, 0, 0, 0)));
+    THROW_LAST_ERROR_IF(!table);
+
+    table->Initialize(ModStatusTable::kVersion);
+
+    m_modStatusChangedEvent.reset(CreateEvent(
+        &secAttr, FALSE, FALSE,
+        SessionPrivateNamespace::MakeObjectName(
+            sessionManagerProcessId, ModStatusTable::kModStatusChangedEventName)
+            .c_str()));
+    THROW_LAST_ERROR_IF(!m_modStatusChangedEvent);
+
+    m_modTaskChangedEvent.reset(CreateEvent(
+        &secAttr, FALSE, FALSE,
+        SessionPrivateNamespace::MakeObjectName(
+            sessionManagerProcessId, ModStatusTable::kModTaskChangedEventName)
+            .c_str()));
+    THROW_LAST_ERROR_IF(!m_modTaskChangedEvent);
+}
+
+Entry::Entry(ModStatusTable::Category category, PCWSTR modName)
+    : m_category(category), m_modName(modName) {}
+
+Entry::~Entry() {
+    if (m_slotIndex != -1) {
+        Set(nullptr);
+    }
+}
+
+void Entry::Set(PCWSTR value) {
+    auto& view = ModStatusTableView::GetInstance();
+    auto* table = view.GetTable();
+    if (!table) {
+        return;
+    }
+
+    if (!value) {
+        if (m_slotIndex != -1) {
+            table->GetSlot(m_slotIndex).Release();
+            m_slotIndex = -1;
+            view.NotifyChanged(m_category);
+        }
+
+        return;
+    }
+
+    if (m_slotIndex == -1) {
+        int slotIndex = table->Claim(GetCurrentProcessId());
+        if (slotIndex == -1) {
+            throw std::runtime_error("The mod status table is full");
+        }
+
+        m_slotIndex = slotIndex;
+        m_creationTime =
+            wil::filetime::to_int64(wil::filetime::get_system_time());
+    }
+
+    ModStatusTable::Entry entry{
+        .category = m_category,
+        .processId = GetCurrentProcessId(),
+        .processCreationTime = view.GetProcessCreationTime(),
+        .creationTime = m_creationTime,
+    };
+    ModStatusTable::CopyString(entry.modName, m_modName);
+    ModStatusTable::CopyString(entry.processName, view.GetProcessName());
+    ModStatusTable::CopyString(entry.value, value);
+
+    table->GetSlot(m_slotIndex).Publish(entry);
+    view.NotifyChanged(m_category);
+}
+
+}  // namespace ModStatus
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "mod_status_table.h"
+
+namespace ModStatus {
+
+// Creates the session table and its change events. Owned by the session
+// manager for the lifetime of the session private namespace.
+class SessionTable {
+   public:
+    SessionTable();
+
+   private:
+    wil::unique_handle m_fileMapping;
+    wil::unique_event_nothrow m_modStatusChangedEvent;
+    wil::unique_event_nothrow m_modTaskChangedEvent;
+};
+
+// A mod status value of the current process, published in a slot of the
+// session table. The slot is claimed on the first value and released when the
+// value is cleared.
+class Entry {
+   public:
+    Entry(ModStatusTable::Category category, PCWSTR modName);
+    ~Entry();
+
+    Entry(const Entry&) = delete;
+    Entry(Entry&&) = delete;
+    Entry& operator=(const Entry&) = delete;
+    Entry& operator=(Entry&&) = delete;
+
+    // Set to nullptr to clear the value.
+    void Set(PCWSTR value);
+
+   private:
+    const ModStatusTable::Category m_category;
+    const std::wstring m_modName;
+    int m_slotIndex = -1;
+    ULONGLONG m_creationTime = 0;
+};
+
+}  // namespace ModStatus
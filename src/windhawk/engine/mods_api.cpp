@@ -155,3 +155,74 @@ const WH_URL_CONTENT* InternalWh_GetUrlContent(
 void InternalWh_FreeUrlContent(void* mod, const WH_URL_CONTENT* content) {
     static_cast<LoadedMod*>(mod)->FreeUrlContent(content);
 }
+
+BOOL InternalWh_FindPattern(void* mod,
+                            HMODULE hModule,
+                            WH_FIND_PATTERN* patterns,
+                            size_t patternsCount,
+                            const WH_FIND_PATTERN_OPTIONS* options) {
+    return static_cast<LoadedMod*>(mod)->FindPattern(hModule, patterns,
+                                                     patternsCount, options);
+}
+
+size_t InternalWh_FindCallers(void* mod,
+                              HMODULE hModule,
+                              void* targetFunction,
+                              void** callers,
+                              size_t callersCount) {
+    return static_cast<LoadedMod*>(mod)->FindCallers(hModule, targetFunction,
+                                                     callers, callersCount);
+}
+
+size_t InternalWh_DisasmRange(void* mod,
+                              void* address,
+                              WH_DISASM_INSTRUCTION* instructions,
+                              size_t instructionsCount,
+                              const WH_DISASM_RANGE_OPTIONS* options) {
+    return static_cast<LoadedMod*>(mod)->DisasmRange(
+        address, instructions, instructionsCount, options);
+}
+
+HANDLE InternalWh_RegisterModuleLoadCallback(
+    void* mod,
+    PCWSTR moduleNamePattern,
+    WH_MODULE_LOAD_CALLBACK callback,
+    void* param,
+    const WH_MODULE_LOAD_CALLBACK_OPTIONS* options) {
+    return static_cast<LoadedMod*>(mod)->RegisterModuleLoadCallback(
+        moduleNamePattern, callback, param, options);
+}
+
+BOOL InternalWh_UnregisterModuleLoadCallback(void* mod, HANDLE registration) {
+    return static_cast<LoadedMod*>(mod)->UnregisterModuleLoadCallback(
+        registration);
+}
+
+HANDLE InternalWh_GetUrlContentAsync(void* mod,
+                                     PCWSTR url,
+                                     const WH_GET_URL_CONTENT_OPTIONS* options,
+                                     WH_URL_CONTENT_CALLBACK callback,
+                                     void* param) {
+    return static_cast<LoadedMod*>(mod)->GetUrlContentAsync(url, options,
+                                                            callback, param);
+}
+
+BOOL InternalWh_CancelUrlContentAsync(void* mod, HANDLE request) {
+    return static_cast<LoadedMod*>(mod)->CancelUrlContentAsync(request);
+}
+
+HANDLE InternalWh_SetImportHook(void* mod,
+                                HMODULE hModule,
+                                PCWSTR dllName,
+                                PCSTR functionName,
+                                void* hookFunction,
+                                void** originalFunction,
+                                const WH_IMPORT_HOOK_OPTIONS* options) {
+    return static_cast<LoadedMod*>(mod)->SetImportHook(
+        hModule, dllName, functionName, hookFunction, originalFunction,
+        options);
+}
+
+BOOL InternalWh_RemoveImportHook(void* mod, HANDLE importHook) {
+    return static_cast<LoadedMod*>(mod)->RemoveImportHook(importHook);
+}
@@ -49,6 +49,12 @@ typedef struct tagWH_DISASM_RESULT {
     char text[96];
 } WH_DISASM_RESULT;
 
+// Receives a part of the downloaded content. Return `FALSE` to cancel the
+// download, in which case `Wh_GetUrlContent` fails.
+typedef BOOL (*WH_URL_CONTENT_WRITE_CALLBACK)(const void* data,
+                                              size_t length,
+                                              void* param);
+
 typedef struct tagWH_GET_URL_CONTENT_OPTIONS {
     // Must be set to `sizeof(WH_GET_URL_CONTENT_OPTIONS)`.
     size_t optionsSize;
@@ -57,6 +63,23 @@ typedef struct tagWH_GET_URL_CONTENT_OPTIONS {
     // struct will be `NULL`. If this field is `NULL`, the content will be
     // returned in the `data` field.
     PCWSTR targetFilePath;
+    // Available since Windhawk v1.8. If set, the content is passed to the
+    // callback in parts as it's downloaded, and the `data` field of the
+    // returned struct will be `NULL`. Takes precedence over `targetFilePath`.
+    WH_URL_CONTENT_WRITE_CALLBACK writeCallback;
+    // Available since Windhawk v1.8. The parameter passed to `writeCallback`.
+    void* writeCallbackParam;
+    // Available since Windhawk v1.8. The maximum size of the parts passed to
+    // `writeCallback` and written to `targetFilePath`. Set to zero to use the
+    // default size.
+    size_t bufferSize;
+    // Available since Windhawk v1.8. Set to `TRUE` to use an HTTP cache which
+    // is shared by all processes. Responses are reused according to the
+    // `Cache-Control` and `Expires` headers, and revalidated with the `ETag`
+    // and `Last-Modified` headers. If several processes request the same URL
+    // at once, only one of them downloads it. Only used if neither
+    // `writeCallback` nor `targetFilePath` is set.
+    BOOL useCache;
 } WH_GET_URL_CONTENT_OPTIONS;
 
 typedef struct tagWH_URL_CONTENT {
@@ -65,9 +88,138 @@ typedef struct tagWH_URL_CONTENT {
     int statusCode;
 } WH_URL_CONTENT;
 
+typedef struct tagWH_FIND_PATTERN_OPTIONS {
+    // Must be set to `sizeof(WH_FIND_PATTERN_OPTIONS)`.
+    size_t optionsSize;
+    // The name of the section to scan, e.g. ".text". Set to `NULL` to scan all
+    // executable sections of the module.
+    PCSTR sectionName;
+} WH_FIND_PATTERN_OPTIONS;
+
+typedef struct tagWH_FIND_PATTERN {
+    // The pattern to find, written as hex bytes separated by spaces, in which
+    // `?` or `??` match any byte, e.g. "48 8B ?? ?? E8".
+    PCSTR pattern;
+    // Receives the address of the first match, or `NULL` if there are no
+    // matches.
+    void* address;
+    // Receives the number of matches.
+    size_t matchCount;
+} WH_FIND_PATTERN;
+
+typedef struct tagWH_DISASM_RANGE_OPTIONS {
+    // Must be set to `sizeof(WH_DISASM_RANGE_OPTIONS)`.
+    size_t optionsSize;
+    // Set to `TRUE` to only retrieve the address and length of each
+    // instruction, which is faster. Useful for skipping over instructions.
+    BOOL lengthOnly;
+    // Set to `TRUE` to continue decoding after return instructions. By
+    // default, decoding stops after the first return instruction.
+    BOOL continueAfterReturn;
+} WH_DISASM_RANGE_OPTIONS;
+
+typedef enum tagWH_DISASM_OPERAND_TYPE {
+    // An operand which isn't described by the other types, e.g. a system
+    // register or a register list.
+    WH_DISASM_OPERAND_OTHER,
+    WH_DISASM_OPERAND_REGISTER,
+    WH_DISASM_OPERAND_IMMEDIATE,
+    WH_DISASM_OPERAND_MEMORY,
+} WH_DISASM_OPERAND_TYPE;
+
+typedef struct tagWH_DISASM_OPERAND {
+    WH_DISASM_OPERAND_TYPE type;
+    // The register, or the base register of a memory operand, as a lowercase
+    // name such as "rax" or "x0". `NULL` if there's no register, or if the
+    // operand is relative to the instruction pointer.
+    PCSTR reg;
+    // The index register of a memory operand, or `NULL`.
+    PCSTR index;
+    // The scale of the index register of a memory operand.
+    unsigned int scale;
+    // The value of an immediate operand, or the displacement of a memory
+    // operand. For operands which are relative to the instruction pointer,
+    // such as branch targets, the resolved absolute address.
+    INT64 value;
+} WH_DISASM_OPERAND;
+
+// The instruction is a call.
+#define WH_DISASM_FLAG_CALL 0x01
+// The instruction is a jump.
+#define WH_DISASM_FLAG_JUMP 0x02
+// The instruction is a conditional jump, set together with
+// `WH_DISASM_FLAG_JUMP`.
+#define WH_DISASM_FLAG_CONDITIONAL 0x04
+// The instruction is a return.
+#define WH_DISASM_FLAG_RETURN 0x08
+// One of the operands is relative to the instruction pointer, and its value
+// was resolved to an absolute address.
+#define WH_DISASM_FLAG_RELATIVE 0x10
+
+typedef struct tagWH_DISASM_INSTRUCTION {
+    // The address of the instruction.
+    void* address;
+    // The length of the instruction.
+    size_t length;
+    // The lowercase mnemonic of the instruction, e.g. "mov". The fields below
+    // aren't set in length only mode.
+    PCSTR mnemonic;
+    // A combination of `WH_DISASM_FLAG_*` values.
+    DWORD flags;
+    // The number of elements in the `operands` array which are set.
+    size_t operandCount;
+    WH_DISASM_OPERAND operands[5];
+} WH_DISASM_INSTRUCTION;
+
+typedef void (*WH_MODULE_LOAD_CALLBACK)(HMODULE module,
+                                        PCWSTR moduleName,
+                                        void* param);
+
+typedef struct tagWH_MODULE_LOAD_CALLBACK_OPTIONS {
+    // Must be set to `sizeof(WH_MODULE_LOAD_CALLBACK_OPTIONS)`.
+    size_t optionsSize;
+    // Set to `TRUE` to call the callback on a worker thread, which allows to
+    // call functions such as `Wh_HookSymbols`. By default, the callback is
+    // called while the module is being loaded, with the loader lock held.
+    BOOL async;
+} WH_MODULE_LOAD_CALLBACK_OPTIONS;
+
+// Receives the content retrieved by `Wh_GetUrlContentAsync`, or `NULL` in case
+// of an error. When no longer needed, call `Wh_FreeUrlContent` to free the
+// content.
+typedef void (*WH_URL_CONTENT_CALLBACK)(const WH_URL_CONTENT* content,
+                                        void* param);
+
+typedef struct tagWH_IMPORT_HOOK_OPTIONS {
+    // Must be set to `sizeof(WH_IMPORT_HOOK_OPTIONS)`.
+    size_t optionsSize;
+    // Set to `TRUE` to also patch the export table of the DLL, so that the
+    // hook is called by code which gets the function address later, e.g. with
+    // `GetProcAddress` or with delay-loaded imports. The DLL stays loaded
+    // until the process exits.
+    BOOL patchExportTable;
+} WH_IMPORT_HOOK_OPTIONS;
+
 // Definitions for mods.
 #ifdef WH_MOD
 
+// The thread contract of the mod callbacks (`Wh_ModInit`, `Wh_ModAfterInit`,
+// `Wh_ModSettingsChanged`, `Wh_ModBeforeUninit`, `Wh_ModUninit`):
+//
+// The callbacks of a mod never run concurrently, and they run on engine
+// threads, which don't pump messages. By default, once a mod is loaded into a
+// running process, its callbacks run on the same engine thread until the mod
+// is unloaded. When the engine is loaded as the process starts, the callbacks
+// might run on different threads, so thread-affine resources, such as windows
+// or COM objects, are best created on a thread which the mod owns.
+//
+// A mod can declare `// @threadAgnostic true` in its metadata if its callbacks
+// can run on any thread. It can then be initialized on a worker thread,
+// concurrently with other mods, and if all mods in a process are thread
+// agnostic, the engine waits on the thread pool instead of keeping a thread
+// while the process is idle. Each callback of such a mod might run on a
+// different thread.
+
 // Placeholder values for the editor, will be defined when the mod is compiled.
 #ifdef WH_EDITING
 #define WH_MOD_ID L"mod-id-placeholder"
@@ -368,7 +520,10 @@ inline BOOL Wh_Disasm(void* address, WH_DISASM_RESULT* result) {
 
 /**
  * @brief Retrieves the content of a URL. When no longer needed, call
- *     `Wh_FreeUrlContent` to free the content.
+ *     `Wh_FreeUrlContent` to free the content. Gzip and deflate encoded
+ *     content is decompressed on Windows 8.1 and newer. To process large
+ *     content without keeping it in memory, set `writeCallback` or
+ *     `targetFilePath` in the options.
  * @since Windhawk v1.5
  * @param url The URL to retrieve.
  * @param options The options for the URL content retrieval. Pass `NULL` to use
@@ -392,6 +547,230 @@ inline void Wh_FreeUrlContent(const WH_URL_CONTENT* content) {
     WH_INTERNAL(InternalWh_FreeUrlContent(InternalWhModPtr, content));
 }
 
+/**
+ * @brief Finds byte patterns in the code of a module, which can be used when
+ *     symbols aren't available. All patterns are found in a single pass over
+ *     the module, so it's preferable to pass all of the patterns at once. The
+ *     results are cached for the module version.
+ * @since Windhawk v1.8
+ * @param hModule A handle to the loaded module to scan. If this parameter is
+ *     `NULL`, the module of the current process (.exe file) is used.
+ * @param patterns An array of patterns to find. The `address` and `matchCount`
+ *     fields of each pattern receive the results.
+ * @param patternsCount The number of elements in the `patterns` array.
+ * @param options Can be used to customize the scan. Pass `NULL` to use the
+ *     default options.
+ * @return A boolean value indicating whether the function succeeded. The
+ *     function fails if one of the patterns is invalid, or if the section
+ *     isn't found.
+ */
+inline BOOL Wh_FindPattern(HMODULE hModule,
+                           WH_FIND_PATTERN* patterns,
+                           size_t patternsCount,
+                           const WH_FIND_PATTERN_OPTIONS* options) {
+    return WH_INTERNAL_OR(
+        InternalWh_FindPattern(InternalWhModPtr, hModule, patterns,
+                               patternsCount, options),
+        FALSE);
+}
+
+/**
+ * @brief Finds the instructions in a module which call or jump directly to a
+ *     function. The module is indexed on first use, and the index is cached
+ *     for the module version, so that subsequent queries are fast. Indirect
+ *     calls, such as calls through the import table, aren't included.
+ * @since Windhawk v1.8
+ * @param hModule A handle to the loaded module to search. If this parameter is
+ *     `NULL`, the module of the current process (.exe file) is used.
+ * @param targetFunction The address of the function, which must be inside the
+ *     module.
+ * @param callers An array which receives the addresses of the call and jump
+ *     instructions, in ascending order. Can be `NULL` if `callersCount` is
+ *     zero.
+ * @param callersCount The number of elements in the `callers` array.
+ * @return The total number of callers, which can be larger than
+ *     `callersCount`. In case of an error, zero is returned.
+ */
+inline size_t Wh_FindCallers(HMODULE hModule,
+                             void* targetFunction,
+                             void** callers,
+                             size_t callersCount) {
+    return WH_INTERNAL_OR(
+        InternalWh_FindCallers(InternalWhModPtr, hModule, targetFunction,
+                               callers, callersCount),
+        0);
+}
+
+/**
+ * @brief Decodes consecutive instructions, which is much faster than calling
+ *     `Wh_Disasm` for each instruction. The instructions aren't formatted as
+ *     text, their operands are returned instead.
+ * @since Windhawk v1.8
+ * @param address The address of the first instruction.
+ * @param instructions An array which receives the decoded instructions.
+ * @param instructionsCount The maximum number of instructions to decode.
+ * @param options Can be used to customize the decoding. Pass `NULL` to use the
+ *     default options.
+ * @return The number of decoded instructions. Decoding stops when
+ *     `instructionsCount` instructions are decoded, after a return instruction
+ *     unless `continueAfterReturn` is set, or before an invalid instruction.
+ */
+inline size_t Wh_DisasmRange(void* address,
+                             WH_DISASM_INSTRUCTION* instructions,
+                             size_t instructionsCount,
+                             const WH_DISASM_RANGE_OPTIONS* options) {
+    return WH_INTERNAL_OR(
+        InternalWh_DisasmRange(InternalWhModPtr, address, instructions,
+                               instructionsCount, options),
+        0);
+}
+
+/**
+ * @brief Registers a callback which is called when a matching module is
+ *     loaded. All mods share a single loader notification, which makes it
+ *     cheaper than hooking `LoadLibraryExW` in each mod. To handle modules
+ *     which are already loaded, register the callback first, then check with
+ *     `GetModuleHandle`, so that no load is missed.
+ *
+ *     By default, the callback is called before the module's entry point runs,
+ *     with the loader lock held. Hooks can be set with `Wh_SetFunctionHook` and
+ *     applied with `Wh_ApplyHookOperations`, but libraries must not be loaded,
+ *     and `Wh_HookSymbols` must not be called. Use the `async` option for
+ *     such work.
+ *
+ *     The callbacks of a registration never run concurrently. Callbacks are
+ *     unregistered automatically when the mod is unloaded.
+ * @since Windhawk v1.8
+ * @param moduleNamePattern The module file name, case-insensitive, in which
+ *     `*` and `?` can be used as wildcards, e.g. "Taskbar.View.dll".
+ * @param callback The callback, which receives the module handle, the module
+ *     file name, and `param`.
+ * @param param A value to pass to the callback.
+ * @param options Can be used to customize the registration. Pass `NULL` to use
+ *     the default options.
+ * @return A handle for `Wh_UnregisterModuleLoadCallback`, or `NULL` in case of
+ *     an error.
+ */
+inline HANDLE Wh_RegisterModuleLoadCallback(
+    PCWSTR moduleNamePattern,
+    WH_MODULE_LOAD_CALLBACK callback,
+    void* param,
+    const WH_MODULE_LOAD_CALLBACK_OPTIONS* options) {
+    return WH_INTERNAL_OR(
+        InternalWh_RegisterModuleLoadCallback(
+            InternalWhModPtr, moduleNamePattern, callback, param, options),
+        NULL);
+}
+
+/**
+ * @brief Unregisters a callback registered with
+ *     `Wh_RegisterModuleLoadCallback`. Once the function returns, the callback
+ *     isn't running, and won't be called again. Can be called from the
+ *     callback itself.
+ * @since Windhawk v1.8
+ * @param registration The handle returned by `Wh_RegisterModuleLoadCallback`.
+ * @return A boolean value indicating whether the function succeeded.
+ */
+inline BOOL Wh_UnregisterModuleLoadCallback(HANDLE registration) {
+    return WH_INTERNAL_OR(InternalWh_UnregisterModuleLoadCallback(
+                              InternalWhModPtr, registration),
+                          FALSE);
+}
+
+/**
+ * @brief Retrieves the content of a URL in the background, like
+ *     `Wh_GetUrlContent`, and passes it to a callback. Can be used in
+ *     `Wh_ModInit` without delaying the initialization of the mod. The
+ *     callback is called on a worker thread once the request completes.
+ *
+ *     Requests which didn't complete are cancelled automatically when the mod
+ *     is unloaded, before `Wh_ModUninit` is called.
+ * @since Windhawk v1.8
+ * @param url The URL to retrieve.
+ * @param options The options for the URL content retrieval. Pass `NULL` to use
+ *     the default options. The options are copied, and if a write callback is
+ *     set, it's called on the worker thread.
+ * @param callback The callback, which receives the content and `param`.
+ * @param param A value to pass to the callback.
+ * @return A handle for `Wh_CancelUrlContentAsync`, or `NULL` in case of an
+ *     error.
+ */
+inline HANDLE Wh_GetUrlContentAsync(PCWSTR url,
+                                    const WH_GET_URL_CONTENT_OPTIONS* options,
+                                    WH_URL_CONTENT_CALLBACK callback,
+                                    void* param) {
+    return WH_INTERNAL_OR(InternalWh_GetUrlContentAsync(
+                              InternalWhModPtr, url, options, callback, param),
+                          NULL);
+}
+
+/**
+ * @brief Cancels a request started by `Wh_GetUrlContentAsync`. Once the
+ *     function returns, the callbacks of the request aren't running and won't
+ *     be called. Can be called from the callbacks of the request.
+ * @since Windhawk v1.8
+ * @param request The handle returned by `Wh_GetUrlContentAsync`.
+ * @return A boolean value indicating whether the request was cancelled.
+ *     `FALSE` is returned if the request already completed.
+ */
+inline BOOL Wh_CancelUrlContentAsync(HANDLE request) {
+    return WH_INTERNAL_OR(
+        InternalWh_CancelUrlContentAsync(InternalWhModPtr, request), FALSE);
+}
+
+/**
+ * @brief Hooks a function by replacing its address in the import tables of
+ *     modules which import it. Each address is replaced with a single atomic
+ *     write, so unlike `Wh_SetFunctionHook`, no threads are suspended, and the
+ *     hook is applied immediately, without `Wh_ApplyHookOperations`. Calls
+ *     which don't go through the import table, e.g. calls from within the
+ *     DLL itself, aren't hooked.
+ *
+ *     Import table entries which were already replaced, e.g. by another mod,
+ *     are left as is. The hook is removed automatically when the mod is
+ *     unloaded.
+ * @since Windhawk v1.8
+ * @param hModule The module whose import table is patched. If this parameter
+ *     is `NULL`, all loaded modules are patched, and modules which are loaded
+ *     later are patched while they're being loaded.
+ * @param dllName The name of the DLL which exports the function, e.g.
+ *     "kernel32.dll". The DLL must be loaded.
+ * @param functionName The name of the function, or its ordinal value created
+ *     with `MAKEINTRESOURCEA`, same as for `GetProcAddress`.
+ * @param hookFunction The hook function.
+ * @param originalFunction A pointer which receives the address of the
+ *     original function, which is set before the hook can be called.
+ * @param options Can be used to customize the hook. Pass `NULL` to use the
+ *     default options.
+ * @return A handle for `Wh_RemoveImportHook`, or `NULL` in case of an error.
+ */
+inline HANDLE Wh_SetImportHook(HMODULE hModule,
+                               PCWSTR dllName,
+                               PCSTR functionName,
+                               void* hookFunction,
+                               void** originalFunction,
+                               const WH_IMPORT_HOOK_OPTIONS* options) {
+    return WH_INTERNAL_OR(
+        InternalWh_SetImportHook(InternalWhModPtr, hModule, dllName,
+                                 functionName, hookFunction, originalFunction,
+                                 options),
+        NULL);
+}
+
+/**
+ * @brief Removes a hook set with `Wh_SetImportHook`. The original addresses
+ *     are restored with atomic writes, without suspending threads. Once the
+ *     function returns, new calls don't reach the hook, but calls which
+ *     already started might still be running.
+ * @since Windhawk v1.8
+ * @param importHook The handle returned by `Wh_SetImportHook`.
+ * @return A boolean value indicating whether the function succeeded.
+ */
+inline BOOL Wh_RemoveImportHook(HANDLE importHook) {
+    return WH_INTERNAL_OR(
+        InternalWh_RemoveImportHook(InternalWhModPtr, importHook), FALSE);
+}
+
 #undef WH_INTERNAL
 #undef WH_INTERNAL_OR
 
@@ -18,6 +18,18 @@ typedef struct tagWH_HOOK_SYMBOLS_OPTIONS WH_HOOK_SYMBOLS_OPTIONS;
 typedef struct tagWH_DISASM_RESULT WH_DISASM_RESULT;
 typedef struct tagWH_GET_URL_CONTENT_OPTIONS WH_GET_URL_CONTENT_OPTIONS;
 typedef struct tagWH_URL_CONTENT WH_URL_CONTENT;
+typedef struct tagWH_FIND_PATTERN_OPTIONS WH_FIND_PATTERN_OPTIONS;
+typedef struct tagWH_FIND_PATTERN WH_FIND_PATTERN;
+typedef struct tagWH_DISASM_RANGE_OPTIONS WH_DISASM_RANGE_OPTIONS;
+typedef struct tagWH_DISASM_INSTRUCTION WH_DISASM_INSTRUCTION;
+typedef void (*WH_MODULE_LOAD_CALLBACK)(HMODULE module,
+                                        PCWSTR moduleName,
+                                        void* param);
+typedef struct tagWH_MODULE_LOAD_CALLBACK_OPTIONS
+    WH_MODULE_LOAD_CALLBACK_OPTIONS;
+typedef void (*WH_URL_CONTENT_CALLBACK)(const WH_URL_CONTENT* content,
+                                        void* param);
+typedef struct tagWH_IMPORT_HOOK_OPTIONS WH_IMPORT_HOOK_OPTIONS;
 
 // Internal functions, do not call directly.
 #ifdef __cplusplus
@@ -82,6 +94,48 @@ const WH_URL_CONTENT* InternalWh_GetUrlContent(
     const WH_GET_URL_CONTENT_OPTIONS* options);
 void InternalWh_FreeUrlContent(void* mod, const WH_URL_CONTENT* content);
 
+BOOL InternalWh_FindPattern(void* mod,
+                            HMODULE hModule,
+                            WH_FIND_PATTERN* patterns,
+                            size_t patternsCount,
+                            const WH_FIND_PATTERN_OPTIONS* options);
+
+size_t InternalWh_FindCallers(void* mod,
+                              HMODULE hModule,
+                              void* targetFunction,
+                              void** callers,
+                              size_t callersCount);
+
+size_t InternalWh_DisasmRange(void* mod,
+                              void* address,
+                              WH_DISASM_INSTRUCTION* instructions,
+                              size_t instructionsCount,
+                              const WH_DISASM_RANGE_OPTIONS* options);
+
+HANDLE InternalWh_RegisterModuleLoadCallback(
+    void* mod,
+    PCWSTR moduleNamePattern,
+    WH_MODULE_LOAD_CALLBACK callback,
+    void* param,
+    const WH_MODULE_LOAD_CALLBACK_OPTIONS* options);
+BOOL InternalWh_UnregisterModuleLoadCallback(void* mod, HANDLE registration);
+
+HANDLE InternalWh_GetUrlContentAsync(void* mod,
+                                     PCWSTR url,
+                                     const WH_GET_URL_CONTENT_OPTIONS* options,
+                                     WH_URL_CONTENT_CALLBACK callback,
+                                     void* param);
+BOOL InternalWh_CancelUrlContentAsync(void* mod, HANDLE request);
+
+HANDLE InternalWh_SetImportHook(void* mod,
+                                HMODULE hModule,
+                                PCWSTR dllName,
+                                PCSTR functionName,
+                                void* hookFunction,
+                                void** originalFunction,
+                                const WH_IMPORT_HOOK_OPTIONS* options);
+BOOL InternalWh_RemoveImportHook(void* mod, HANDLE importHook);
+
 #ifdef __cplusplus
 }
 #endif
@@ -89,7 +143,23 @@ void InternalWh_FreeUrlContent(void* mod, const WH_URL_CONTENT* content);
 // Internal definitions for mods.
 #ifdef WH_MOD
 
-inline void* InternalWhModPtr;
+// Only the symbols which the engine looks up are exported. Declaring them with
+// dllexport turns off the automatic export of all symbols, and the callbacks
+// are only exported if the mod defines them.
+//
+// Mods which define a callback with a different signature, e.g.
+// `bool Wh_ModInit()`, are compiled with WH_EXPORT_ALL_SYMBOLS and linked with
+// --export-all-symbols instead.
+__declspec(dllexport) inline void* InternalWhModPtr;
+
+#ifndef WH_EXPORT_ALL_SYMBOLS
+__declspec(dllexport) BOOL Wh_ModInit();
+__declspec(dllexport) void Wh_ModAfterInit();
+__declspec(dllexport) void Wh_ModBeforeUninit();
+__declspec(dllexport) void Wh_ModUninit();
+__declspec(dllexport) BOOL Wh_ModSettingsChanged(BOOL* bReload);
+__declspec(dllexport) void Wh_ModSettingsChanged();
+#endif  // WH_EXPORT_ALL_SYMBOLS
 
 inline void InternalWh_Log_Wrapper(PCWSTR format, ...) {
     va_list args;
@@ -1,7 +1,10 @@
 #include "stdafx.h"
 
+#include "functions.h"
+#include "hook_engine.h"
 #include "logger.h"
 #include "mods_manager.h"
+#include "startup_profile.h"
 #include "storage_manager.h"
 
 namespace {
@@ -13,9 +16,106 @@ DWORD GetModuleSizeOfImage(HMODULE module) {
     return ntHeader->OptionalHeader.SizeOfImage;
 }
 
+// The maximum amount of threads, including the current thread, which load mods
+// concurrently on startup. Mapping the mod libraries is serialized by the
+// loader lock, so more threads mostly help with mods which spend their
+// initialization time elsewhere, e.g. waiting for symbols.
+constexpr DWORD kConcurrentLoadMaxThreads = 4;
+
+using ModEntry = std::pair<const std::wstring, Mod>;
+
+// Returns the duration of the load, in milliseconds.
+ULONGLONG LoadModOnStartup(ModEntry& modEntry) {
+    auto& [name, mod] = modEntry;
+
+    ULONGLONG startTime = GetTickCount64();
+
+    try {
+        mod.Load(/*loadedOnStartup=*/true);
+    } catch (const std::exception& e) {
+        LOG(L"Mod (%s) loading failed: %S", name.c_str(), e.what());
+    }
+
+    return GetTickCount64() - startTime;
+}
+
+// Loads mods on a small pool of threads. The hooks which are set by the mods
+// are only queued, and are applied together with the rest of the hooks of the
+// session.
+class ConcurrentModLoader {
+   public:
+    ConcurrentModLoader(std::vector<ModEntry*> modEntries)
+        : m_modEntries(std::move(modEntries)),
+          m_durations(m_modEntries.size()) {}
+
+    void Run() {
+        DWORD threadCount = std::min(
+            {kConcurrentLoadMaxThreads,
+             GetActiveProcessorCount(ALL_PROCESSOR_GROUPS),
+             static_cast<DWORD>(m_modEntries.size())});
+
+        ULONGLONG startTime = GetTickCount64();
+
+        std::vector<wil::unique_process_handle> threads;
+        for (DWORD i = 1; i < threadCount; i++) {
+            wil::unique_process_handle thread(Functions::MyCreateRemoteThread(
+                GetCurrentProcess(), ThreadProc, this, 0));
+            if (!thread) {
+                LOG(L"Thread creation failed: %u", GetLastError());
+                break;
+            }
+
+            Functions::SetThreadDescriptionIfAvailable(thread.get(),
+                                                       L"WindhawkModLoader");
+            threads.push_back(std::move(thread));
+        }
+
+        LoadMods();
+
+        for (const auto& thread : threads) {
+            WaitForSingleObject(thread.get(), INFINITE);
+        }
+
+        // The slowest mod bounds the time of the whole batch.
+        size_t criticalPathIndex = 0;
+        for (size_t i = 1; i < m_durations.size(); i++) {
+            if (m_durations[i] > m_durations[criticalPathIndex]) {
+                criticalPathIndex = i;
+            }
+        }
+
+        VERBOSE(L"Loaded %zu mods on %zu threads in %llu ms, critical path: "
+                L"%s (%llu ms)",
+                m_modEntries.size(), threads.size() + 1,
+                GetTickCount64() - startTime,
+                m_modEntries[criticalPathIndex]->first.c_str(),
+                m_durations[criticalPathIndex]);
+    }
+
+   private:
+    static DWORD WINAPI ThreadProc(LPVOID pThis) {
+        SetThreadErrorMode(SEM_FAILCRITICALERRORS, nullptr);
+        static_cast<ConcurrentModLoader*>(pThis)->LoadMods();
+        return 0;
+    }
+
+    void LoadMods() {
+        size_t i;
+        while ((i = m_nextIndex.fetch_add(1)) < m_modEntries.size()) {
+            m_durations[i] = LoadModOnStartup(*m_modEntries[i]);
+        }
+    }
+
+    const std::vector<ModEntry*> m_modEntries;
+    std::vector<ULONGLONG> m_durations;
+    std::atomic<size_t> m_nextIndex = 0;
+};
+
 }  // namespace
 
-ModsManager::ModsManager() {
+ModsManager::ModsManager(bool concurrentInit) {
+    StartupProfile::MarkPhaseEnd(StartupProfile::ProcessPhase::kHookEngineInit);
+
     StorageManager::GetInstance().EnumMods([this](PCWSTR modName) {
         try {
             if (Mod::ShouldLoadInRunningProcess(modName)) {
@@ -30,13 +130,43 @@ ModsManager::ModsManager() {
         }
     });
 
-    for (auto& [name, mod] : m_mods) {
-        try {
-            mod.Load(/*loadedOnStartup=*/true);
-        } catch (const std::exception& e) {
-            LOG(L"Mod (%s) loading failed: %S", name.c_str(), e.what());
+    std::vector<ModEntry*> concurrentModEntries;
+    std::vector<ModEntry*> serialModEntries;
+
+    for (auto& modEntry : m_mods) {
+        bool allowsConcurrentInit = false;
+        if (concurrentInit) {
+            try {
+                allowsConcurrentInit =
+                    Mod::IsThreadAgnostic(modEntry.first.c_str());
+            } catch (const std::exception& e) {
+                LOG(L"Mod (%s) loading failed: %S", modEntry.first.c_str(),
+                    e.what());
+            }
+        }
+
+        if (allowsConcurrentInit) {
+            concurrentModEntries.push_back(&modEntry);
+        } else {
+            serialModEntries.push_back(&modEntry);
         }
     }
+
+    // Mods which aren't thread agnostic are loaded after the rest, one at a
+    // time, on the current thread.
+    if (concurrentModEntries.size() > 1) {
+        ConcurrentModLoader(std::move(concurrentModEntries)).Run();
+    } else {
+        serialModEntries.insert(serialModEntries.begin(),
+                                concurrentModEntries.begin(),
+                                concurrentModEntries.end());
+    }
+
+    for (ModEntry* modEntry : serialModEntries) {
+        LoadModOnStartup(*modEntry);
+    }
+
+    StartupProfile::MarkPhaseEnd(StartupProfile::ProcessPhase::kModsLoad);
 }
 
 ModsManager::~ModsManager() {
@@ -87,10 +217,12 @@ void ModsManager::ReloadModsAndSettings() {
     std::unordered_set<std::wstring> modsToKeepLoaded;
     std::unordered_set<std::wstring> modsToKeepUnloaded;
     std::vector<std::wstring> modsToLoad;
+    // Recompiled mods which are reloaded in place, also in modsToKeepLoaded.
+    std::vector<std::wstring> modsToHotSwap;
 
     StorageManager::GetInstance().EnumMods([this, &modsToKeepLoaded,
-                                            &modsToKeepUnloaded,
-                                            &modsToLoad](PCWSTR modName) {
+                                            &modsToKeepUnloaded, &modsToLoad,
+                                            &modsToHotSwap](PCWSTR modName) {
         try {
             bool shouldBeLoaded = Mod::ShouldLoadInRunningProcess(modName);
             if (!shouldBeLoaded) {
@@ -104,6 +236,9 @@ void ModsManager::ReloadModsAndSettings() {
                 bool reload = false;
                 if (!loadedMod.ApplyChangedSettings(&reload)) {
                     modsToKeepUnloaded.emplace(modName);
+                } else if (reload && loadedMod.CanHotSwap()) {
+                    modsToKeepLoaded.emplace(modName);
+                    modsToHotSwap.emplace_back(modName);
                 } else if (reload) {
                     modsToLoad.emplace_back(modName);
                 } else {
@@ -128,16 +263,10 @@ void ModsManager::ReloadModsAndSettings() {
         }
     }
 
-#ifdef WH_HOOKING_ENGINE_MINHOOK
-    MH_STATUS status = MH_ApplyQueuedEx(MH_ALL_IDENTS);
-    if (status != MH_OK) {
-        LOG(L"MH_ApplyQueuedEx failed with %d", status);
+    auto status = HookEngine::ApplyQueued(HookEngine::kAllOwners);
+    if (status != HookEngine::kOk) {
+        LOG(L"HookEngine::ApplyQueued failed with %d", status);
     }
-#elif WH_HOOKING_ENGINE == WH_HOOKING_ENGINE_NONE
-// For testing without a hooking engine.
-#else
-#error "Unsupported hooking engine"
-#endif  // WH_HOOKING_ENGINE
 
     std::vector<ThreadCallStackRegionInfo> regions;
 
@@ -176,6 +305,19 @@ void ModsManager::ReloadModsAndSettings() {
         }
     }
 
+    // The hooks of hot swapped mods are taken over by the new versions without
+    // freezing threads. The rest are applied below with the hooks of the newly
+    // loaded mods.
+    std::vector<std::unique_ptr<LoadedMod>> hotSwappedMods;
+
+    for (const auto& modName : modsToHotSwap) {
+        try {
+            hotSwappedMods.push_back(m_mods.at(modName).HotSwap());
+        } catch (const std::exception& e) {
+            LOG(L"Mod (%s) hot swap failed: %S", modName.c_str(), e.what());
+        }
+    }
+
     for (const auto& modName : modsToLoad) {
         try {
             auto result = m_mods.emplace(modName, modName.c_str());
@@ -200,16 +342,10 @@ void ModsManager::ReloadModsAndSettings() {
         }
     }
 
-#ifdef WH_HOOKING_ENGINE_MINHOOK
-    status = MH_ApplyQueuedEx(MH_ALL_IDENTS);
-    if (status != MH_OK) {
-        LOG(L"MH_ApplyQueuedEx failed with %d", status);
+    status = HookEngine::ApplyQueued(HookEngine::kAllOwners);
+    if (status != HookEngine::kOk) {
+        LOG(L"HookEngine::ApplyQueued failed with %d", status);
     }
-#elif WH_HOOKING_ENGINE == WH_HOOKING_ENGINE_NONE
-// For testing without a hooking engine.
-#else
-#error "Unsupported hooking engine"
-#endif  // WH_HOOKING_ENGINE
 
     for (const auto& modName : modsToLoad) {
         auto i = m_mods.find(modName);
@@ -223,4 +359,51 @@ void ModsManager::ReloadModsAndSettings() {
             }
         }
     }
+
+    for (const auto& modName : modsToHotSwap) {
+        try {
+            m_mods.at(modName).AfterInit();
+        } catch (const std::exception& e) {
+            LOG(L"Mod (%s) AfterInit failed: %S", modName.c_str(), e.what());
+        }
+    }
+
+    // The previous versions of hot swapped mods are unloaded last, once no
+    // thread runs their code.
+    regions.clear();
+
+    for (auto& previousMod : hotSwappedMods) {
+        try {
+            previousMod->Uninitialize();
+
+            HMODULE module = previousMod->GetModModuleHandle();
+            regions.push_back({
+                .address = reinterpret_cast<DWORD_PTR>(module),
+                .size = GetModuleSizeOfImage(module),
+            });
+        } catch (const std::exception& e) {
+            LOG(L"Mod (%s) Uninitialize failed: %S",
+                previousMod->GetModName(), e.what());
+        }
+    }
+
+    if (!regions.empty()) {
+        ThreadsCallStackWaitForRegions(
+            regions.data(), static_cast<DWORD>(regions.size()), 200, 400);
+    }
+}
+
+bool ModsManager::AreAllModsThreadAgnostic() {
+    for (const auto& [name, mod] : m_mods) {
+        try {
+            if (!Mod::IsThreadAgnostic(name.c_str())) {
+                return false;
+            }
+        } catch (const std::exception& e) {
+            LOG(L"Mod (%s) config reading failed: %S", name.c_str(), e.what());
+            return false;
+        }
+    }
+
+    return true;
 }
@@ -4,7 +4,8 @@
 
 class ModsManager {
    public:
-    ModsManager();
+    // If concurrentInit is set, thread agnostic mods are loaded concurrently.
+    ModsManager(bool concurrentInit);
     ~ModsManager();
 
     ModsManager(const ModsManager&) = delete;
@@ -13,6 +14,8 @@ class ModsManager {
     void AfterInit();
     void BeforeUninit();
     void ReloadModsAndSettings();
+    // Whether all loaded mods are thread agnostic, see Mod::IsThreadAgnostic.
+    bool AreAllModsThreadAgnostic();
 
    private:
     std::unordered_map<std::wstring, Mod> m_mods;
@@ -0,0 +1,300 @@
+#include "stdafx.h"
+
+#include "module_load_notifier.h"
+#include "functions.h"
+#include "logger.h"
+#include "no_destructor.h"
+#include "var_init_once.h"
+
+extern HINSTANCE g_hDllInst;
+
+namespace {
+
+constexpr ULONG kLdrDllNotificationReasonLoaded = 1;
+
+struct LdrDllLoadedNotificationData {
+    ULONG Flags;
+    const UNICODE_STRING* FullDllName;
+    const UNICODE_STRING* BaseDllName;
+    PVOID DllBase;
+    ULONG SizeOfImage;
+};
+
+using LdrDllNotificationFunction_t =
+    VOID(CALLBACK*)(ULONG notificationReason,
+                    const void* notificationData,
+                    PVOID context);
+
+using LdrRegisterDllNotification_t =
+    NTSTATUS(NTAPI*)(ULONG flags,
+                     LdrDllNotificationFunction_t notificationFunction,
+                     PVOID context,
+                     PVOID* cookie);
+
+using LdrUnregisterDllNotification_t = NTSTATUS(NTAPI*)(PVOID cookie);
+
+std::wstring ToLower(std::wstring_view s) {
+    std::wstring result{s};
+    LCMapStringEx(LOCALE_NAME_USER_DEFAULT, LCMAP_LOWERCASE, &result[0],
+                  wil::safe_cast<int>(result.length()), &result[0],
+                  wil::safe_cast<int>(result.length()), nullptr, nullptr, 0);
+    return result;
+}
+
+bool IsWildcardPattern(std::wstring_view pattern) {
+    return pattern.find_first_of(L"*?") != pattern.npos;
+}
+
+}  // namespace
+
+// static
+ModuleLoadNotifier& ModuleLoadNotifier::GetInstance() {
+    STATIC_INIT_ONCE(NoDestructorIfTerminating<ModuleLoadNotifier>, s);
+    return **s;
+}
+
+ModuleLoadNotifier::ModuleLoadNotifier() = default;
+
+ModuleLoadNotifier::~ModuleLoadNotifier() {
+    // The notification stays registered once it's needed, since unregistering
+    // it from a notification callback isn't safe. Unregister it before the
+    // engine is unloaded.
+    if (m_ldrNotificationCookie) {
+        GET_PROC_ADDRESS_ONCE(LdrUnregisterDllNotification_t,
+                              pLdrUnregisterDllNotification, L"ntdll.dll",
+                              "LdrUnregisterDllNotification");
+        if (pLdrUnregisterDllNotification) {
+            pLdrUnregisterDllNotification(m_ldrNotificationCookie);
+        }
+    }
+}
+
+HANDLE ModuleLoadNotifier::Register(void* owner,
+                                    std::wstring_view pattern,
+                                    Callback callback,
+                                    bool async) {
+    auto registration = std::make_shared<Registration>();
+    registration->owner = owner;
+    registration->pattern = ToLower(pattern);
+    registration->callback = std::move(callback);
+    registration->async = async;
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    if (!m_ldrNotificationCookie) {
+        GET_PROC_ADDRESS_ONCE(LdrRegisterDllNotification_t,
+                              pLdrRegisterDllNotification, L"ntdll.dll",
+                              "LdrRegisterDllNotification");
+        if (!pLdrRegisterDllNotification) {
+            LOG(L"Failed to get LdrRegisterDllNotification address");
+            return nullptr;
+        }
+
+        NTSTATUS status = pLdrRegisterDllNotification(
+            0, LdrDllNotification, this, &m_ldrNotificationCookie);
+        if (!SUCCEEDED_NTSTATUS(status)) {
+            LOG(L"LdrRegisterDllNotification error: %08X", status);
+            m_ldrNotificationCookie = nullptr;
+            return nullptr;
+        }
+    }
+
+    Registration* key = registration.get();
+    if (IsWildcardPattern(key->pattern)) {
+        m_wildcards.push_back(key);
+    } else {
+        m_byName[key->pattern].push_back(key);
+    }
+
+    m_registrations.emplace(key, std::move(registration));
+
+    return key;
+}
+
+bool ModuleLoadNotifier::Unregister(void* owner, HANDLE registration) {
+    std::shared_ptr<Registration> removed;
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        auto it =
+            m_registrations.find(static_cast<Registration*>(registration));
+        if (it == m_registrations.end() || it->second->owner != owner) {
+            return false;
+        }
+
+        removed = it->second;
+        RemoveLocked(it->first);
+    }
+
+    Deactivate(*removed);
+    return true;
+}
+
+void ModuleLoadNotifier::UnregisterAll(void* owner) {
+    std::vector<std::shared_ptr<Registration>> removed;
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        for (const auto& [key, registration] : m_registrations) {
+            if (registration->owner == owner) {
+                removed.push_back(registration);
+            }
+        }
+
+        for (const auto& registration : removed) {
+            RemoveLocked(registration.get());
+        }
+    }
+
+    for (const auto& registration : removed) {
+        Deactivate(*registration);
+    }
+}
+
+// static
+VOID CALLBACK
+ModuleLoadNotifier::LdrDllNotification(ULONG notificationReason,
+                                       const void* notificationData,
+                                       PVOID context) {
+    if (notificationReason != kLdrDllNotificationReasonLoaded) {
+        return;
+    }
+
+    auto* data =
+        static_cast<const LdrDllLoadedNotificationData*>(notificationData);
+    std::wstring_view moduleName(data->BaseDllName->Buffer,
+                                 data->BaseDllName->Length / sizeof(WCHAR));
+
+    try {
+        static_cast<ModuleLoadNotifier*>(context)->OnModuleLoaded(
+            static_cast<HMODULE>(data->DllBase), moduleName);
+    } catch (const std::exception& e) {
+        LOG(L"Module load notification failed: %S", e.what());
+    }
+}
+
+// static
+void CALLBACK ModuleLoadNotifier::AsyncCallback(PTP_CALLBACK_INSTANCE instance,
+                                                PVOID context) {
+    {
+        std::unique_ptr<AsyncCall> call(static_cast<AsyncCall*>(context));
+
+        // Keep the module loaded while the callback runs. Fails if the module
+        // was unloaded in the meantime, e.g. if its initialization failed.
+        HMODULE module;
+        if (GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                              reinterpret_cast<LPCWSTR>(call->module),
+                              &module)) {
+            if (module == call->module) {
+                Invoke(*call->registration, module, call->moduleName.c_str());
+            }
+
+            FreeLibrary(module);
+        }
+    }
+
+    FreeLibraryWhenCallbackReturns(instance, g_hDllInst);
+}
+
+void ModuleLoadNotifier::OnModuleLoaded(HMODULE module,
+                                        std::wstring_view moduleName) {
+    std::wstring moduleNameLower = ToLower(moduleName);
+
+    std::vector<std::shared_ptr<Registration>> matched;
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if (auto it = m_byName.find(moduleNameLower); it != m_byName.end()) {
+            for (auto* registration : it->second) {
+                matched.push_back(m_registrations.at(registration));
+            }
+        }
+
+        for (auto* registration : m_wildcards) {
+            if (Functions::wcsmatch(
+                    registration->pattern.c_str(),
+                    registration->pattern.length(), moduleNameLower.c_str(),
+                    moduleNameLower.length())) {
+                matched.push_back(m_registrations.at(registration));
+            }
+        }
+    }
+
+    if (matched.empty()) {
+        return;
+    }
+
+    std::wstring moduleNameStr{moduleName};
+
+    for (auto& registration : matched) {
+        if (!registration->async) {
+            Invoke(*registration, module, moduleNameStr.c_str());
+            continue;
+        }
+
+        // Bump the reference count of the engine, it's released when the
+        // callback returns.
+        HMODULE hDllInst;
+        GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                          reinterpret_cast<LPCWSTR>(g_hDllInst), &hDllInst);
+
+        auto call = std::make_unique<AsyncCall>(AsyncCall{
+            .registration = std::move(registration),
+            .module = module,
+            .moduleName = moduleNameStr,
+        });
+        if (!TrySubmitThreadpoolCallback(AsyncCallback, call.get(), nullptr)) {
+            LOG(L"TrySubmitThreadpoolCallback failed: %u", GetLastError());
+            FreeLibrary(g_hDllInst);
+            continue;
+        }
+
+        call.release();
+    }
+}
+
+// static
+void ModuleLoadNotifier::Invoke(Registration& registration,
+                                HMODULE module,
+                                PCWSTR moduleName) {
+    std::lock_guard<std::mutex> guard(registration.callbackMutex);
+
+    if (!registration.active) {
+        return;
+    }
+
+    registration.callbackThreadId = GetCurrentThreadId();
+    auto callbackThreadIdCleanup = wil::scope_exit(
+        [&registration] { registration.callbackThreadId = 0; });
+
+    registration.callback(module, moduleName);
+}
+
+// static
+void ModuleLoadNotifier::Deactivate(Registration& registration) {
+    if (registration.callbackThreadId == GetCurrentThreadId()) {
+        // Called from the callback, which already holds the lock.
+        registration.active = false;
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(registration.callbackMutex);
+    registration.active = false;
+}
+
+void ModuleLoadNotifier::RemoveLocked(Registration* registration) {
+    if (IsWildcardPattern(registration->pattern)) {
+        std::erase(m_wildcards, registration);
+    } else if (auto it = m_byName.find(registration->pattern);
+               it != m_byName.end()) {
+        std::erase(it->second, registration);
+        if (it->second.empty()) {
+            m_byName.erase(it);
+        }
+    }
+
+    m_registrations.erase(registration);
+}
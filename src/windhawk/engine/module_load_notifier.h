@@ -0,0 +1,73 @@
+#pragma once
+
+// Dispatches the module load notifications of the process to callbacks which
+// are registered by module name. A single loader notification is registered
+// for all callbacks, and a load is matched with one lookup of the lowercase
+// module name, followed by a scan of the patterns with wildcards.
+class ModuleLoadNotifier {
+   public:
+    using Callback = std::function<void(HMODULE module, PCWSTR moduleName)>;
+
+    static ModuleLoadNotifier& GetInstance();
+
+    ModuleLoadNotifier(const ModuleLoadNotifier&) = delete;
+    ModuleLoadNotifier& operator=(const ModuleLoadNotifier&) = delete;
+
+    ModuleLoadNotifier();
+    ~ModuleLoadNotifier();
+
+    // The pattern is a module file name, case-insensitive, in which `*` and
+    // `?` are wildcards. If async is false, the callback is called during the
+    // load with the loader lock held, before the module's entry point runs.
+    // Otherwise, it's called on a thread pool thread after the load completes.
+    // Callbacks of a single registration never run concurrently.
+    HANDLE Register(void* owner,
+                    std::wstring_view pattern,
+                    Callback callback,
+                    bool async);
+
+    // Once this returns, the callback isn't running, and won't be called
+    // again. Can be called from the callback itself.
+    bool Unregister(void* owner, HANDLE registration);
+    void UnregisterAll(void* owner);
+
+   private:
+    struct Registration {
+        void* owner;
+        std::wstring pattern;
+        Callback callback;
+        bool async;
+
+        // Held while the callback runs.
+        std::mutex callbackMutex;
+        std::atomic<bool> active = true;
+        std::atomic<DWORD> callbackThreadId = 0;
+    };
+
+    struct AsyncCall {
+        std::shared_ptr<Registration> registration;
+        HMODULE module;
+        std::wstring moduleName;
+    };
+
+    static VOID CALLBACK LdrDllNotification(ULONG notificationReason,
+                                            const void* notificationData,
+                                            PVOID context);
+    static void CALLBACK AsyncCallback(PTP_CALLBACK_INSTANCE instance,
+                                       PVOID context);
+
+    void OnModuleLoaded(HMODULE module, std::wstring_view moduleName);
+    static void Invoke(Registration& registration,
+                       HMODULE module,
+                       PCWSTR moduleName);
+    static void Deactivate(Registration& registration);
+    void RemoveLocked(Registration* registration);
+
+    std::mutex m_mutex;
+    PVOID m_ldrNotificationCookie = nullptr;
+    std::unordered_map<Registration*, std::shared_ptr<Registration>>
+        m_registrations;
+    // Registrations without wildcards, by lowercase module name.
+    std::unordered_map<std::wstring, std::vector<Registration*>> m_byName;
+    std::vector<Registration*> m_wildcards;
+};
@@ -2,6 +2,7 @@
 
 #include "dll_inject.h"
 #include "functions.h"
+#include "hook_engine.h"
 #include "logger.h"
 #include "new_process_injector.h"
 #include "process_lists.h"
@@ -64,19 +65,8 @@ NewProcessInjector::NewProcessInjector(HANDLE hSessionManagerProcess)
             reinterpret_cast<CreateProcessInternalW_t>(
                 GetProcAddress(hKernelBase, "CreateProcessInternalW"));
         if (pCreateProcessInternalW) {
-#ifdef WH_HOOKING_ENGINE_MINHOOK
-            if (MH_CreateHook(
-                    pCreateProcessInternalW, CreateProcessInternalW_Hook,
-                    reinterpret_cast<void**>(
-                        &m_originalCreateProcessInternalW)) == MH_OK) {
-                MH_QueueEnableHook(pCreateProcessInternalW);
-                createProcessInternalWHooked = true;
-            }
-#elif WH_HOOKING_ENGINE == WH_HOOKING_ENGINE_NONE
-// For testing without a hooking engine.
-#else
-#error "Unsupported hooking engine"
-#endif  // WH_HOOKING_ENGINE
+            createProcessInternalWHooked =
+                HookCreateProcessInternalW(pCreateProcessInternalW);
         }
     }
 
@@ -88,19 +78,8 @@ NewProcessInjector::NewProcessInjector(HANDLE hSessionManagerProcess)
                 reinterpret_cast<CreateProcessInternalW_t>(
                     GetProcAddress(hKernel32, "CreateProcessInternalW"));
             if (pCreateProcessInternalW) {
-#ifdef WH_HOOKING_ENGINE_MINHOOK
-                if (MH_CreateHook(
-                        pCreateProcessInternalW, CreateProcessInternalW_Hook,
-                        reinterpret_cast<void**>(
-                            &m_originalCreateProcessInternalW)) == MH_OK) {
-                    MH_QueueEnableHook(pCreateProcessInternalW);
-                    createProcessInternalWHooked = true;
-                }
-#elif WH_HOOKING_ENGINE == WH_HOOKING_ENGINE_NONE
-// For testing without a hooking engine.
-#else
-#error "Unsupported hooking engine"
-#endif  // WH_HOOKING_ENGINE
+                createProcessInternalWHooked =
+                    HookCreateProcessInternalW(pCreateProcessInternalW);
             }
         }
     }
@@ -151,6 +130,23 @@ NewProcessInjector::~NewProcessInjector() {
     }
 }
 
+bool NewProcessInjector::HookCreateProcessInternalW(
+    CreateProcessInternalW_t pCreateProcessInternalW) {
+    auto status = HookEngine::CreateHook(
+        HookEngine::kEngineOwner,
+        reinterpret_cast<void*>(pCreateProcessInternalW),
+        reinterpret_cast<void*>(CreateProcessInternalW_Hook),
+        reinterpret_cast<void**>(&m_originalCreateProcessInternalW));
+    if (status != HookEngine::kOk) {
+        return false;
+    }
+
+    HookEngine::QueueEnableHook(
+        HookEngine::kEngineOwner,
+        reinterpret_cast<void*>(pCreateProcessInternalW));
+    return true;
+}
+
 // static
 BOOL WINAPI NewProcessInjector::CreateProcessInternalW_Hook(
     HANDLE hUserToken,
@@ -39,6 +39,8 @@ class NewProcessInjector {
                                 LPSTARTUPINFOW lpStartupInfo,
                                 LPPROCESS_INFORMATION lpProcessInformation,
                                 PHANDLE hRestrictedUserToken);
+    bool HookCreateProcessInternalW(
+        CreateProcessInternalW_t pCreateProcessInternalW);
     void HandleCreatedProcess(LPPROCESS_INFORMATION lpProcessInformation);
     bool ShouldSkipNewProcess(std::wstring_view processImageName) const;
     bool ShouldAttachExemptThread(std::wstring_view processImageName) const;
@@ -0,0 +1,408 @@
+#include "stdafx.h"
+
+#include "pattern_scan.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PATTERN_SCAN_SSE2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define PATTERN_SCAN_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(PATTERN_SCAN_SSE2) && (defined(__clang__) || defined(__GNUC__))
+#define PATTERN_SCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PATTERN_SCAN_TARGET_AVX2
+#endif
+
+namespace {
+
+using PatternScan::Pattern;
+
+// Byte values which are common in code, most common first. The anchors of a
+// pattern are chosen to be the least common bytes, to have as few false
+// candidates as possible.
+constexpr uint8_t kCommonCodeBytes[] = {
+#if defined(_M_ARM64) || defined(__aarch64__)
+    0x00, 0xFF, 0xF9, 0x91, 0xAA, 0xA9, 0x52, 0xB9, 0x94, 0x97, 0x40, 0xE0,
+    0x03, 0x01, 0x02, 0x1F, 0xD6, 0x5F, 0x54, 0x34, 0x35, 0x71, 0xF1, 0x80,
+#else
+    0x00, 0xFF, 0xCC, 0x48, 0x8B, 0x89, 0x24, 0x0F, 0x4C, 0x44, 0xE8, 0x83,
+    0x8D, 0x01, 0x85, 0x74, 0x75, 0xC3, 0x40, 0x41, 0x49, 0x08, 0x10, 0x20,
+    0xC0, 0x90, 0x33, 0x45, 0x4D, 0xC7, 0x84, 0x04, 0xE9, 0xEB, 0x28, 0x30,
+#endif
+};
+
+size_t GetByteCommonness(uint8_t value) {
+    for (size_t i = 0; i < std::size(kCommonCodeBytes); i++) {
+        if (kCommonCodeBytes[i] == value) {
+            return std::size(kCommonCodeBytes) - i;
+        }
+    }
+
+    return 0;
+}
+
+std::optional<uint8_t> ParseHexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return static_cast<uint8_t>(c - '0');
+    }
+
+    if (c >= 'a' && c <= 'f') {
+        return static_cast<uint8_t>(c - 'a' + 10);
+    }
+
+    if (c >= 'A' && c <= 'F') {
+        return static_cast<uint8_t>(c - 'A' + 10);
+    }
+
+    return std::nullopt;
+}
+
+bool MatchesAt(const uint8_t* p, const Pattern& pattern) {
+    const size_t size = pattern.bytes.size();
+    const uint8_t* bytes = pattern.bytes.data();
+    const uint8_t* mask = pattern.mask.data();
+
+    size_t i = 0;
+
+#if defined(PATTERN_SCAN_SSE2)
+    for (; i + 16 <= size; i += 16) {
+        __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i maskVector =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + i));
+        __m128i bytesVector =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+        __m128i equal =
+            _mm_cmpeq_epi8(_mm_and_si128(data, maskVector), bytesVector);
+        if (_mm_movemask_epi8(equal) != 0xFFFF) {
+            return false;
+        }
+    }
+#elif defined(PATTERN_SCAN_NEON)
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t equal = vceqq_u8(
+            vandq_u8(vld1q_u8(p + i), vld1q_u8(mask + i)), vld1q_u8(bytes + i));
+        if (vminvq_u8(equal) != 0xFF) {
+            return false;
+        }
+    }
+#endif
+
+    for (; i < size; i++) {
+        if ((p[i] & mask[i]) != bytes[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Scans the candidates which start in the [from, to) range one at a time.
+// Used for the parts which are too short for a full vector.
+void ScanScalar(const uint8_t* data,
+                size_t from,
+                size_t to,
+                const Pattern& pattern,
+                std::vector<size_t>& matches) {
+    if (from >= to) {
+        return;
+    }
+
+    const size_t anchorIndex = pattern.anchorIndex1;
+    const uint8_t anchor = pattern.bytes[anchorIndex];
+    const uint8_t* p = data + from + anchorIndex;
+    const uint8_t* last = data + to + anchorIndex;
+
+    while (p < last) {
+        p = static_cast<const uint8_t*>(memchr(p, anchor, last - p));
+        if (!p) {
+            break;
+        }
+
+        const uint8_t* candidate = p - anchorIndex;
+        if (MatchesAt(candidate, pattern)) {
+            matches.push_back(candidate - data);
+        }
+
+        p++;
+    }
+}
+
+#if defined(PATTERN_SCAN_SSE2)
+
+bool IsAvx2Supported() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+
+    // OSXSAVE and AVX.
+    __cpuid(info, 1);
+    constexpr int kOsxsaveAndAvx = (1 << 27) | (1 << 28);
+    if ((info[2] & kOsxsaveAndAvx) != kOsxsaveAndAvx) {
+        return false;
+    }
+
+    // The OS saves the XMM and YMM registers.
+    if ((_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// Each of the ScanBlocks functions scans the candidates of patterns[i] which
+// start in [begin, scanEnds[i]) with full vectors. The rest of the candidates,
+// fewer than the vector width, are left for ScanScalar. The anchors of all
+// patterns are compared in each block, so that the memory is only read once.
+
+PATTERN_SCAN_TARGET_AVX2 void ScanBlocksAvx2(
+    const uint8_t* data,
+    size_t begin,
+    size_t maxScanEnd,
+    std::span<const Pattern> patterns,
+    std::span<const size_t> scanEnds,
+    std::span<std::vector<size_t>> matches) {
+    for (size_t pos = begin; pos + 32 <= maxScanEnd; pos += 32) {
+        for (size_t i = 0; i < patterns.size(); i++) {
+            if (pos + 32 > scanEnds[i]) {
+                continue;
+            }
+
+            const Pattern& pattern = patterns[i];
+
+            const uint8_t* p = data + pos;
+            __m256i block1 = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(p + pattern.anchorIndex1));
+            __m256i block2 = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(p + pattern.anchorIndex2));
+            __m256i anchor1 = _mm256_set1_epi8(
+                static_cast<char>(pattern.bytes[pattern.anchorIndex1]));
+            __m256i anchor2 = _mm256_set1_epi8(
+                static_cast<char>(pattern.bytes[pattern.anchorIndex2]));
+            __m256i equal =
+                _mm256_and_si256(_mm256_cmpeq_epi8(block1, anchor1),
+                                 _mm256_cmpeq_epi8(block2, anchor2));
+
+            uint32_t bits = static_cast<uint32_t>(_mm256_movemask_epi8(equal));
+            while (bits) {
+                size_t offset = pos + std::countr_zero(bits);
+                if (MatchesAt(data + offset, pattern)) {
+                    matches[i].push_back(offset);
+                }
+
+                bits &= bits - 1;
+            }
+        }
+    }
+}
+
+void ScanBlocksSse2(const uint8_t* data,
+                    size_t begin,
+                    size_t maxScanEnd,
+                    std::span<const Pattern> patterns,
+                    std::span<const size_t> scanEnds,
+                    std::span<std::vector<size_t>> matches) {
+    for (size_t pos = begin; pos + 16 <= maxScanEnd; pos += 16) {
+        for (size_t i = 0; i < patterns.size(); i++) {
+            if (pos + 16 > scanEnds[i]) {
+                continue;
+            }
+
+            const Pattern& pattern = patterns[i];
+
+            const uint8_t* p = data + pos;
+            __m128i block1 = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(p + pattern.anchorIndex1));
+            __m128i block2 = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(p + pattern.anchorIndex2));
+            __m128i anchor1 = _mm_set1_epi8(
+                static_cast<char>(pattern.bytes[pattern.anchorIndex1]));
+            __m128i anchor2 = _mm_set1_epi8(
+                static_cast<char>(pattern.bytes[pattern.anchorIndex2]));
+            __m128i equal = _mm_and_si128(_mm_cmpeq_epi8(block1, anchor1),
+                                          _mm_cmpeq_epi8(block2, anchor2));
+
+            uint32_t bits = static_cast<uint32_t>(_mm_movemask_epi8(equal));
+            while (bits) {
+                size_t offset = pos + std::countr_zero(bits);
+                if (MatchesAt(data + offset, pattern)) {
+                    matches[i].push_back(offset);
+                }
+
+                bits &= bits - 1;
+            }
+        }
+    }
+}
+
+#elif defined(PATTERN_SCAN_NEON)
+
+void ScanBlocksNeon(const uint8_t* data,
+                    size_t begin,
+                    size_t maxScanEnd,
+                    std::span<const Pattern> patterns,
+                    std::span<const size_t> scanEnds,
+                    std::span<std::vector<size_t>> matches) {
+    for (size_t pos = begin; pos + 16 <= maxScanEnd; pos += 16) {
+        for (size_t i = 0; i < patterns.size(); i++) {
+            if (pos + 16 > scanEnds[i]) {
+                continue;
+            }
+
+            const Pattern& pattern = patterns[i];
+
+            uint8x16_t equal = vandq_u8(
+                vceqq_u8(vld1q_u8(data + pos + pattern.anchorIndex1),
+                         vdupq_n_u8(pattern.bytes[pattern.anchorIndex1])),
+                vceqq_u8(vld1q_u8(data + pos + pattern.anchorIndex2),
+                         vdupq_n_u8(pattern.bytes[pattern.anchorIndex2])));
+
+            // NEON has no movemask, narrowing leaves four bits per byte.
+            uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(equal), 4);
+            uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+            while (bits) {
+                int index = std::countr_zero(bits) / 4;
+                size_t offset = pos + index;
+                if (MatchesAt(data + offset, pattern)) {
+                    matches[i].push_back(offset);
+                }
+
+                bits &= ~(0xFull << (index * 4));
+            }
+        }
+    }
+}
+
+#endif
+
+}  // namespace
+
+namespace PatternScan {
+
+std::optional<Pattern> Parse(std::string_view pattern) {
+    Pattern result{};
+
+    size_t pos = 0;
+    while (true) {
+        pos = pattern.find_first_not_of(' ', pos);
+        if (pos == pattern.npos) {
+            break;
+        }
+
+        size_t tokenEnd = pattern.find(' ', pos);
+        if (tokenEnd == pattern.npos) {
+            tokenEnd = pattern.size();
+        }
+
+        auto token = pattern.substr(pos, tokenEnd - pos);
+        pos = tokenEnd;
+
+        if (token == "?" || token == "??") {
+            result.bytes.push_back(0);
+            result.mask.push_back(0);
+            continue;
+        }
+
+        if (token.size() != 2) {
+            return std::nullopt;
+        }
+
+        auto high = ParseHexDigit(token[0]);
+        auto low = ParseHexDigit(token[1]);
+        if (!high || !low) {
+            return std::nullopt;
+        }
+
+        result.bytes.push_back(static_cast<uint8_t>(*high << 4 | *low));
+        result.mask.push_back(0xFF);
+    }
+
+    std::optional<size_t> anchorIndex1;
+    std::optional<size_t> anchorIndex2;
+    for (size_t i = 0; i < result.bytes.size(); i++) {
+        if (!result.mask[i]) {
+            continue;
+        }
+
+        size_t commonness = GetByteCommonness(result.bytes[i]);
+        if (!anchorIndex1 ||
+            commonness < GetByteCommonness(result.bytes[*anchorIndex1])) {
+            anchorIndex2 = anchorIndex1;
+            anchorIndex1 = i;
+        } else if (!anchorIndex2 ||
+                   commonness <
+                       GetByteCommonness(result.bytes[*anchorIndex2])) {
+            anchorIndex2 = i;
+        }
+    }
+
+    if (!anchorIndex1) {
+        return std::nullopt;
+    }
+
+    result.anchorIndex1 = *anchorIndex1;
+    result.anchorIndex2 = anchorIndex2.value_or(*anchorIndex1);
+    return result;
+}
+
+void Scan(std::span<const uint8_t> data,
+          size_t begin,
+          size_t end,
+          std::span<const Pattern> patterns,
+          std::span<std::vector<size_t>> matches) {
+    // The end of the range of candidates of each pattern, such that the whole
+    // pattern is within the data.
+    std::vector<size_t> scanEnds(patterns.size());
+    size_t maxScanEnd = begin;
+    for (size_t i = 0; i < patterns.size(); i++) {
+        size_t patternSize = patterns[i].bytes.size();
+        size_t scanEnd = patternSize <= data.size()
+                             ? std::min(end, data.size() - patternSize + 1)
+                             : 0;
+        scanEnds[i] = std::max(scanEnd, begin);
+        maxScanEnd = std::max(maxScanEnd, scanEnds[i]);
+    }
+
+    size_t vectorWidth = 0;
+
+#if defined(PATTERN_SCAN_SSE2)
+    static const bool avx2Supported = IsAvx2Supported();
+    if (avx2Supported) {
+        ScanBlocksAvx2(data.data(), begin, maxScanEnd, patterns, scanEnds,
+                       matches);
+        vectorWidth = 32;
+    } else {
+        ScanBlocksSse2(data.data(), begin, maxScanEnd, patterns, scanEnds,
+                       matches);
+        vectorWidth = 16;
+    }
+#elif defined(PATTERN_SCAN_NEON)
+    ScanBlocksNeon(data.data(), begin, maxScanEnd, patterns, scanEnds, matches);
+    vectorWidth = 16;
+#endif
+
+    for (size_t i = 0; i < patterns.size(); i++) {
+        size_t scalarBegin = begin;
+        if (vectorWidth) {
+            scalarBegin += (scanEnds[i] - begin) / vectorWidth * vectorWidth;
+        }
+
+        ScanScalar(data.data(), scalarBegin, scanEnds[i], patterns[i],
+                   matches[i]);
+    }
+}
+
+}  // namespace PatternScan
@@ -0,0 +1,34 @@
+#pragma once
+
+// Scanning of memory for masked byte patterns, such as "48 8B ?? ?? E8". Only
+// depends on the standard library and on compiler intrinsics, the caller
+// provides the memory to scan.
+namespace PatternScan {
+
+struct Pattern {
+    // Wildcard bytes are zero.
+    std::vector<uint8_t> bytes;
+    // 0xFF for bytes which must match, zero for wildcards.
+    std::vector<uint8_t> mask;
+    // The two least common fixed bytes, which are used to find candidates.
+    // They're the same if the pattern has a single fixed byte.
+    size_t anchorIndex1;
+    size_t anchorIndex2;
+};
+
+// Parses a pattern of hex bytes separated by spaces, in which `?` or `??`
+// match any byte. Returns `std::nullopt` if the pattern is invalid or has no
+// fixed bytes.
+std::optional<Pattern> Parse(std::string_view pattern);
+
+// Finds the matches of all patterns in a single pass over `data`. Only matches
+// which start in the [begin, end) range are reported, but they can extend
+// beyond it, which allows scanning a large buffer in chunks. The offsets of
+// the matches of patterns[i] are appended to matches[i] in ascending order.
+void Scan(std::span<const uint8_t> data,
+          size_t begin,
+          size_t end,
+          std::span<const Pattern> patterns,
+          std::span<std::vector<size_t>> matches);
+
+}  // namespace PatternScan
@@ -0,0 +1,34 @@
+#include "stdafx.h"
+
+#include "pool_wait_loop.h"
+
+bool PoolWaitLoop::Start() noexcept {
+    return m_host->WaitForFirstThread() != FirstThread::kNoneLeft;
+}
+
+PoolWaitLoop::State PoolWaitLoop::OnSignaled(Wait wait) noexcept {
+    switch (wait) {
+        case Wait::kSessionManagerProcess:
+            return State::kSessionManagerExited;
+
+        case Wait::kFirstThread:
+            // A wait on the process itself can't replace this: the process
+            // handle is only signaled once all threads exited, including the
+            // pool thread which runs this callback. The waited thread is the
+            // oldest alive one, usually the main thread, so the threads are
+            // rarely enumerated again before the process exits.
+            m_host->OnFirstThreadExited();
+            return m_host->WaitForFirstThread() == FirstThread::kNoneLeft
+                       ? State::kNoThreadsLeft
+                       : State::kWaiting;
+
+        case Wait::kModConfigChange:
+            if (m_host->WaitForSessionManagerExit(kModConfigChangeDelayMs)) {
+                return State::kSessionManagerExited;
+            }
+
+            return State::kModConfigChanged;
+    }
+
+    return State::kSessionManagerExited;
+}
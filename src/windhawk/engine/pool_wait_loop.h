@@ -0,0 +1,60 @@
+#pragma once
+
+// The state machine of the main loop which runs on thread pool waits, see
+// CustomizationSession::ThreadPoolMainLoop. The waits are set by the host, so
+// that this part only depends on the standard library and can be tested with
+// a stand-in pool.
+class PoolWaitLoop {
+   public:
+    enum class Wait {
+        kSessionManagerProcess,
+        kFirstThread,
+        kModConfigChange,
+    };
+
+    enum class State {
+        kWaiting,
+        kModConfigChanged,
+        kSessionManagerExited,
+        kNoThreadsLeft,
+    };
+
+    enum class FirstThread {
+        kFound,
+        kNoneLeft,
+        // The threads can't be enumerated, e.g. in a sandboxed process.
+        kUnknown,
+    };
+
+    // Config changes are reloaded after this delay, in case more changes will
+    // follow.
+    static constexpr uint32_t kModConfigChangeDelayMs = 200;
+
+    class Host {
+       public:
+        // Looks for the first alive thread other than the current one, and if
+        // there's one, sets the first thread wait on it.
+        virtual FirstThread WaitForFirstThread() noexcept = 0;
+        // Called when the first thread exited, before looking for the next
+        // one, so that the exit code of the last thread can be kept.
+        virtual void OnFirstThreadExited() noexcept = 0;
+        // Returns true if the session manager exited within the timeout.
+        virtual bool WaitForSessionManagerExit(uint32_t timeoutMs) noexcept = 0;
+
+       protected:
+        ~Host() = default;
+    };
+
+    explicit PoolWaitLoop(Host* host) noexcept : m_host(host) {}
+
+    // Returns false if no other threads are left, in which case the other
+    // waits shouldn't be set.
+    bool Start() noexcept;
+
+    // Called from the callback of the wait which was signaled. The waits are
+    // closed unless kWaiting is returned.
+    State OnSignaled(Wait wait) noexcept;
+
+   private:
+    Host* m_host;
+};
@@ -0,0 +1,69 @@
+#include "stdafx.h"
+
+#include "response_body.h"
+
+namespace {
+
+// The initial size of the buffer if the Content-Length header is missing or
+// can't be used. Otherwise, the header is used up to the maximum size, since
+// it's not verified.
+constexpr size_t kDefaultInitialCapacity = 64 * 1024;
+constexpr size_t kMaxInitialCapacity = 64 * 1024 * 1024;
+
+}  // namespace
+
+namespace ResponseBody {
+
+size_t GetInitialCapacity(std::optional<DWORD> contentLength,
+                          bool decompressed) {
+    if (!contentLength || decompressed ||
+        *contentLength >= kMaxInitialCapacity) {
+        return kDefaultInitialCapacity;
+    }
+
+    // One byte is reserved for the null terminator.
+    return static_cast<size_t>(*contentLength) + 1;
+}
+
+std::unique_ptr<char[]> ReadToEnd(
+    const std::function<size_t(void* buffer, size_t size)>& read,
+    size_t initialCapacity,
+    size_t* length) {
+    size_t capacity = std::max(initialCapacity, size_t{1});
+    auto data = std::make_unique_for_overwrite<char[]>(capacity);
+    size_t dataLength = 0;
+
+    while (true) {
+        if (dataLength + 1 == capacity) {
+            // Check whether there's more data before growing the buffer, since
+            // with a Content-Length header, the content usually fits exactly.
+            char next;
+            if (read(&next, 1) == 0) {
+                break;
+            }
+
+            size_t newCapacity = capacity * 2;
+            auto newData = std::make_unique_for_overwrite<char[]>(newCapacity);
+            memcpy(newData.get(), data.get(), dataLength);
+            data = std::move(newData);
+            capacity = newCapacity;
+
+            data[dataLength++] = next;
+            continue;
+        }
+
+        size_t bytesRead =
+            read(data.get() + dataLength, capacity - dataLength - 1);
+        if (bytesRead == 0) {
+            break;
+        }
+
+        dataLength += bytesRead;
+    }
+
+    data[dataLength] = '\0';
+    *length = dataLength;
+    return data;
+}
+
+}  // namespace ResponseBody
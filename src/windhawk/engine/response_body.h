@@ -0,0 +1,22 @@
+#pragma once
+
+// Reading of a whole response body into memory, as done by
+// UrlRequest::ReadToEnd. Only depends on the standard library, so that it can
+// be tested with a stand-in for WinHTTP.
+namespace ResponseBody {
+
+// Returns the initial size of the buffer for a body. The Content-Length header
+// is only used if the body is read as sent. If WinHTTP decompresses it, the
+// header is the compressed size, which is usually a fraction of the body.
+size_t GetInitialCapacity(std::optional<DWORD> contentLength,
+                          bool decompressed);
+
+// Reads the body into a single null-terminated buffer, which starts with the
+// given capacity and is doubled when full. read returns zero at the end of the
+// body, and exceptions which it throws, e.g. on cancellation, are propagated.
+std::unique_ptr<char[]> ReadToEnd(
+    const std::function<size_t(void* buffer, size_t size)>& read,
+    size_t initialCapacity,
+    size_t* length);
+
+}  // namespace ResponseBody
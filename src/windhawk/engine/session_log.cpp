@@ -0,0 +1,66 @@
+#include "stdafx.h"
+
+#include "functions.h"
+#include "session_log.h"
+#include "session_private_namespace.h"
+
+namespace SessionLog {
+
+SessionRing::SessionRing() {
+    DWORD sessionManagerProcessId = GetCurrentProcessId();
+
+    wil::unique_hlocal secDesc;
+    THROW_IF_WIN32_BOOL_FALSE(
+        Functions::GetFullAccessSecurityDescriptor(&secDesc, nullptr));
+
+    SECURITY_ATTRIBUTES secAttr{
+        .nLength = sizeof(secAttr),
+        .lpSecurityDescriptor = secDesc.get(),
+        .bInheritHandle = FALSE,
+    };
+
+    m_fileMapping.reset(CreateFileMapping(
+        INVALID_HANDLE_VALUE, &secAttr, PAGE_READWRITE, 0,
+        sizeof(SessionLogRing::SessionRing),
+        SessionPrivateNamespace::MakeObjectName(
+            sessionManagerProcessId, SessionLogRing::kFileMappingName)
+            .c_str()));
+    THROW_LAST_ERROR_IF(!m_fileMapping ||
+                        GetLastError() == ERROR_ALREADY_EXISTS);
+
+    wil::unique_mapview_ptr<SessionLogRing::SessionRing> ring(
+        reinterpret_cast<SessionLogRing::SessionRing*>(
+            MapViewOfFile(m_fileMapping.get(), FILE_MAP_WRITE, 0, 0, 0)));
+    THROW_LAST_ERROR_IF(!ring);
+
+    ring->Initialize(SessionLogRing::kVersion);
+}
+
+Writer::Writer(DWORD sessionManagerProcessId)
+    : m_processId(GetCurrentProcessId()) {
+    m_fileMapping.reset(OpenFileMapping(
+        FILE_MAP_READ | FILE_MAP_WRITE, FALSE,
+        SessionPrivateNamespace::MakeObjectName(
+            sessionManagerProcessId, SessionLogRing::kFileMappingName)
+            .c_str()));
+    THROW_LAST_ERROR_IF(!m_fileMapping);
+
+    m_ring.reset(reinterpret_cast<SessionLogRing::SessionRing*>(
+        MapViewOfFile(m_fileMapping.get(), FILE_MAP_WRITE, 0, 0, 0)));
+    THROW_LAST_ERROR_IF(!m_ring);
+
+    if (!m_ring->IsCompatible(SessionLogRing::kVersion)) {
+        throw std::runtime_error("Incompatible session log ring");
+    }
+}
+
+bool Writer::Write(DWORD threadId,
+                   ULONGLONG timestamp,
+                   SessionLogRing::Severity severity,
+                   std::wstring_view channel,
+                   std::wstring_view text) {
+    return m_ring->Write(m_processId, threadId, timestamp, severity, channel,
+                         text);
+}
+
+}  // namespace SessionLog
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "session_log_ring.h"
+
+namespace SessionLog {
+
+// Creates the session log ring. Owned by the session manager for the lifetime
+// of the session private namespace.
+class SessionRing {
+   public:
+    SessionRing();
+
+   private:
+    wil::unique_handle m_fileMapping;
+};
+
+// Writes log lines of the current process to the session log ring, which is
+// read by the app.
+class Writer {
+   public:
+    Writer(DWORD sessionManagerProcessId);
+
+    // Returns false if the line was dropped.
+    bool Write(DWORD threadId,
+               ULONGLONG timestamp,
+               SessionLogRing::Severity severity,
+               std::wstring_view channel,
+               std::wstring_view text);
+
+   private:
+    const DWORD m_processId;
+    wil::unique_handle m_fileMapping;
+    wil::unique_mapview_ptr<SessionLogRing::SessionRing> m_ring;
+};
+
+}  // namespace SessionLog
@@ -47,6 +47,17 @@ int MakeName(WCHAR szPrivateNamespaceName[kPrivateNamespaceMaxLen + 1],
                       L"WindhawkSession%u", dwSessionManagerProcessId);
 }
 
+std::wstring MakeObjectName(DWORD dwSessionManagerProcessId,
+                            PCWSTR objectName) {
+    WCHAR szPrivateNamespaceName[kPrivateNamespaceMaxLen + 1];
+    MakeName(szPrivateNamespaceName, dwSessionManagerProcessId);
+
+    std::wstring name = szPrivateNamespaceName;
+    name += L'\\';
+    name += objectName;
+    return name;
+}
+
 wil::unique_private_namespace_destroy Create(DWORD dwSessionManagerProcessId) {
     WCHAR szPrivateNamespaceName[kPrivateNamespaceMaxLen + 1];
     MakeName(szPrivateNamespaceName, dwSessionManagerProcessId);
@@ -7,6 +7,8 @@ constexpr size_t kPrivateNamespaceMaxLen =
 
 int MakeName(WCHAR szPrivateNamespaceName[kPrivateNamespaceMaxLen + 1],
              DWORD dwSessionManagerProcessId) noexcept;
+// Returns the name of an object in the private namespace.
+std::wstring MakeObjectName(DWORD dwSessionManagerProcessId, PCWSTR objectName);
 wil::unique_private_namespace_destroy Create(DWORD dwSessionManagerProcessId);
 wil::unique_private_namespace_close Open(DWORD dwSessionManagerProcessId);
 
@@ -0,0 +1,34 @@
+#include "stdafx.h"
+
+#include "customization_session.h"
+#include "session_private_namespace.h"
+#include "session_table_view.h"
+
+SessionTableViewBase::SessionTableViewBase(PCWSTR fileMappingName) {
+    DWORD sessionManagerProcessId =
+        CustomizationSession::GetSessionManagerProcessId();
+
+    m_fileMapping.reset(OpenFileMapping(
+        FILE_MAP_READ | FILE_MAP_WRITE, FALSE,
+        SessionPrivateNamespace::MakeObjectName(sessionManagerProcessId,
+                                                fileMappingName)
+            .c_str()));
+    THROW_LAST_ERROR_IF(!m_fileMapping);
+
+    m_view.reset(reinterpret_cast<BYTE*>(
+        MapViewOfFile(m_fileMapping.get(), FILE_MAP_WRITE, 0, 0, 0)));
+    THROW_LAST_ERROR_IF(!m_view);
+
+    std::filesystem::path fullProcessImageName =
+        wil::QueryFullProcessImageName<std::wstring>(GetCurrentProcess());
+    m_processName = fullProcessImageName.filename().native();
+
+    FILETIME creationTime;
+    FILETIME exitTime;
+    FILETIME kernelTime;
+    FILETIME userTime;
+    THROW_IF_WIN32_BOOL_FALSE(GetProcessTimes(GetCurrentProcess(),
+                                              &creationTime, &exitTime,
+                                              &kernelTime, &userTime));
+    m_processCreationTime = wil::filetime::to_int64(creationTime);
+}
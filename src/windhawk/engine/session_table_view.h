@@ -0,0 +1,39 @@
+#pragma once
+
+// A view of a table which is shared by the session manager with the target
+// processes of the session, as opened by a target process. Values which are
+// shared by all entries of the process are queried once.
+class SessionTableViewBase {
+   public:
+    SessionTableViewBase(const SessionTableViewBase&) = delete;
+    SessionTableViewBase& operator=(const SessionTableViewBase&) = delete;
+
+    PCWSTR GetProcessName() const { return m_processName.c_str(); }
+    ULONGLONG GetProcessCreationTime() const { return m_processCreationTime; }
+
+   protected:
+    // Throws on failure.
+    explicit SessionTableViewBase(PCWSTR fileMappingName);
+
+    BYTE* GetView() const { return m_view.get(); }
+
+   private:
+    wil::unique_handle m_fileMapping;
+    wil::unique_mapview_ptr<BYTE> m_view;
+    std::wstring m_processName;
+    ULONGLONG m_processCreationTime = 0;
+};
+
+template <typename Table>
+class SessionTableView : public SessionTableViewBase {
+   public:
+    // Throws on failure, including if the table has a different version.
+    SessionTableView(PCWSTR fileMappingName, uint32_t version)
+        : SessionTableViewBase(fileMappingName) {
+        if (!GetTable()->IsCompatible(version)) {
+            throw std::runtime_error("Incompatible session table");
+        }
+    }
+
+    Table* GetTable() const { return reinterpret_cast<Table*>(GetView()); }
+};
@@ -0,0 +1,212 @@
+#include "stdafx.h"
+
+#include "functions.h"
+#include "logger.h"
+#include "session_private_namespace.h"
+#include "session_table_view.h"
+#include "startup_profile.h"
+#include "var_init_once.h"
+#include "version.h"
+
+namespace {
+
+constexpr size_t kProcessPhaseCount =
+    static_cast<size_t>(StartupProfile::ProcessPhase::kCount);
+constexpr size_t kModPhaseCount =
+    static_cast<size_t>(StartupProfile::ModPhase::kCount);
+
+// Zero if not marked. Written during startup only, which is serialized by the
+// customization session semaphore.
+LONGLONG g_injectionTime;
+LONGLONG g_phaseEndTimes[kProcessPhaseCount];
+bool g_processPublished;
+
+uint32_t TicksToMicroseconds(LONGLONG ticks) {
+    STATIC_INIT_ONCE_TRIVIAL(LONGLONG, frequency, []() {
+        LARGE_INTEGER value;
+        QueryPerformanceFrequency(&value);
+        return value.QuadPart;
+    }());
+
+    if (ticks < 0) {
+        return StartupProfileTable::kNoDuration;
+    }
+
+    LONGLONG microseconds = ticks / frequency * 1000000 +
+                            ticks % frequency * 1000000 / frequency;
+    return static_cast<uint32_t>(
+        std::min(microseconds,
+                 static_cast<LONGLONG>(StartupProfileTable::kNoDuration - 1)));
+}
+
+// The session ring, as opened by a target process.
+class StartupProfileTableView {
+   public:
+    static StartupProfileTableView& GetInstance() {
+        STATIC_INIT_ONCE(StartupProfileTableView, s);
+        return *s;
+    }
+
+    void Write(StartupProfileTable::Entry& entry) {
+        if (!m_view) {
+            return;
+        }
+
+        entry.processId = GetCurrentProcessId();
+        entry.processCreationTime = m_view->GetProcessCreationTime();
+        entry.recordTime =
+            wil::filetime::to_int64(wil::filetime::get_system_time());
+        entry.engineVersion = VER_FILE_VERSION_LONG;
+        CopyString(entry.processName, m_view->GetProcessName());
+
+        if (!m_view->GetTable()->Write(entry)) {
+            VERBOSE(L"Startup profile record was dropped");
+        }
+    }
+
+    template <size_t N>
+    static void CopyString(wchar_t (&destination)[N],
+                           std::wstring_view source) {
+        size_t length = std::min(source.length(), N - 1);
+        memcpy(destination, source.data(), length * sizeof(wchar_t));
+        destination[length] = L'\0';
+    }
+
+   private:
+    StartupProfileTableView() {
+        try {
+            m_view.emplace(StartupProfileTable::kFileMappingName,
+                           StartupProfileTable::kVersion);
+        } catch (const std::exception& e) {
+            LOG(L"Failed to open the startup profile table: %S", e.what());
+        }
+    }
+
+    std::optional<SessionTableView<StartupProfileTable::SessionRing>> m_view;
+};
+
+}  // namespace
+
+namespace StartupProfile {
+
+LONGLONG GetTimestamp() noexcept {
+    LARGE_INTEGER value;
+    QueryPerformanceCounter(&value);
+    return value.QuadPart;
+}
+
+void MarkInjected(LONGLONG timestamp) noexcept {
+    if (!g_injectionTime) {
+        g_injectionTime = timestamp;
+    }
+}
+
+void MarkPhaseEnd(ProcessPhase phase) noexcept {
+    LONGLONG& phaseEndTime = g_phaseEndTimes[static_cast<size_t>(phase)];
+    if (!phaseEndTime) {
+        phaseEndTime = GetTimestamp();
+    }
+}
+
+ScopedModPhase::ScopedModPhase(ModTimes* times, ModPhase phase) noexcept
+    : m_times(times), m_phaseIndex(static_cast<size_t>(phase)) {
+    if (m_times && m_times->nestingDepth[m_phaseIndex]++ == 0) {
+        m_startTime = GetTimestamp();
+    }
+}
+
+ScopedModPhase::~ScopedModPhase() {
+    if (m_times && --m_times->nestingDepth[m_phaseIndex] == 0) {
+        m_times->durations[m_phaseIndex] += GetTimestamp() - m_startTime;
+        m_times->measured[m_phaseIndex] = true;
+    }
+}
+
+SessionTable::SessionTable() {
+    DWORD sessionManagerProcessId = GetCurrentProcessId();
+
+    wil::unique_hlocal secDesc;
+    THROW_IF_WIN32_BOOL_FALSE(
+        Functions::GetFullAccessSecurityDescriptor(&secDesc, nullptr));
+
+    SECURITY_ATTRIBUTES secAttr{
+        .nLength = sizeof(secAttr),
+        .lpSecurityDescriptor = secDesc.get(),
+        .bInheritHandle = FALSE,
+    };
+
+    m_fileMapping.reset(CreateFileMapping(
+        INVALID_HANDLE_VALUE, &secAttr, PAGE_READWRITE, 0,
+        sizeof(StartupProfileTable::SessionRing),
+        SessionPrivateNamespace::MakeObjectName(
+            sessionManagerProcessId, StartupProfileTable::kFileMappingName)
+            .c_str()));
+    THROW_LAST_ERROR_IF(!m_fileMapping ||
+                        GetLastError() == ERROR_ALREADY_EXISTS);
+
+    wil::unique_mapview_ptr<StartupProfileTable::SessionRing> ring(
+        reinterpret_cast<StartupProfileTable::SessionRing*>(
+            MapViewOfFile(m_fileMapping.get(), FILE_MAP_WRITE, 0, 0, 0)));
+    THROW_LAST_ERROR_IF(!ring);
+
+    ring->Initialize(StartupProfileTable::kVersion);
+}
+
+void PublishProcess() noexcept {
+    // The marks are only kept for the first startup. The engine might stay
+    // loaded after the session ends, and be started again by a later session.
+    if (g_processPublished) {
+        return;
+    }
+
+    g_processPublished = true;
+
+    StartupProfileTable::Entry entry{
+        .kind = StartupProfileTable::Kind::kProcess,
+    };
+
+    // Each phase starts at the end of the last phase which was marked before
+    // it. Phases which weren't marked, such as the injection phase if the
+    // engine was loaded by other means, have no duration.
+    LONGLONG previousEndTime = g_injectionTime;
+    for (size_t i = 0; i < StartupProfileTable::kMaxPhaseCount; i++) {
+        entry.durations[i] = StartupProfileTable::kNoDuration;
+        if (i >= kProcessPhaseCount || !g_phaseEndTimes[i]) {
+            continue;
+        }
+
+        if (previousEndTime) {
+            entry.durations[i] =
+                TicksToMicroseconds(g_phaseEndTimes[i] - previousEndTime);
+        }
+
+        previousEndTime = g_phaseEndTimes[i];
+    }
+
+    try {
+        StartupProfileTableView::GetInstance().Write(entry);
+    } catch (const std::exception& e) {
+        LOG(L"Failed to write the startup profile: %S", e.what());
+    }
+}
+
+void PublishMod(PCWSTR modName, const ModTimes& times) noexcept {
+    StartupProfileTable::Entry entry{
+        .kind = StartupProfileTable::Kind::kMod,
+    };
+
+    for (size_t i = 0; i < StartupProfileTable::kMaxPhaseCount; i++) {
+        entry.durations[i] = i < kModPhaseCount && times.measured[i]
+                                 ? TicksToMicroseconds(times.durations[i])
+                                 : StartupProfileTable::kNoDuration;
+    }
+
+    try {
+        StartupProfileTableView::CopyString(entry.modName, modName);
+        StartupProfileTableView::GetInstance().Write(entry);
+    } catch (const std::exception& e) {
+        LOG(L"Failed to write the startup profile: %S", e.what());
+    }
+}
+
+}  // namespace StartupProfile
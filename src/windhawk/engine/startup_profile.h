@@ -0,0 +1,63 @@
+#pragma once
+
+#include "startup_profile_table.h"
+
+// Measures the startup phases of the engine in the current process, and
+// publishes them to the session's startup profile table once the mods are
+// active. Timestamps are taken with QueryPerformanceCounter, which is
+// consistent across processes, so that the injection time can be measured by
+// the injecting process.
+namespace StartupProfile {
+
+using ProcessPhase = StartupProfileTable::ProcessPhase;
+using ModPhase = StartupProfileTable::ModPhase;
+
+LONGLONG GetTimestamp() noexcept;
+
+// Only the first mark of each phase is kept. Safe to call from DllMain.
+void MarkInjected(LONGLONG timestamp) noexcept;
+void MarkPhaseEnd(ProcessPhase phase) noexcept;
+
+// The durations of the startup phases of a mod, in performance counter ticks.
+struct ModTimes {
+    LONGLONG durations[static_cast<size_t>(ModPhase::kCount)]{};
+    bool measured[static_cast<size_t>(ModPhase::kCount)]{};
+    int nestingDepth[static_cast<size_t>(ModPhase::kCount)]{};
+};
+
+// Adds the time of the scope to a phase of a mod. Nested scopes of the same
+// phase are only counted once. Does nothing if times is null, e.g. once the
+// startup of the mod was published.
+class ScopedModPhase {
+   public:
+    ScopedModPhase(ModTimes* times, ModPhase phase) noexcept;
+    ~ScopedModPhase();
+
+    ScopedModPhase(const ScopedModPhase&) = delete;
+    ScopedModPhase(ScopedModPhase&&) = delete;
+    ScopedModPhase& operator=(const ScopedModPhase&) = delete;
+    ScopedModPhase& operator=(ScopedModPhase&&) = delete;
+
+   private:
+    ModTimes* const m_times;
+    const size_t m_phaseIndex;
+    LONGLONG m_startTime = 0;
+};
+
+// Creates the session startup profile table. Owned by the session manager for
+// the lifetime of the session private namespace.
+class SessionTable {
+   public:
+    SessionTable();
+
+   private:
+    wil::unique_handle m_fileMapping;
+};
+
+// Write the records of the current process to the session table. The process
+// record is only written for the first startup of the engine in the process.
+// Errors are logged and otherwise ignored.
+void PublishProcess() noexcept;
+void PublishMod(PCWSTR modName, const ModTimes& times) noexcept;
+
+}  // namespace StartupProfile
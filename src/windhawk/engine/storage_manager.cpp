@@ -189,43 +189,6 @@ std::filesystem::path StorageManager::GetModStoragePath(PCWSTR modName) {
     return modStoragePath;
 }
 
-std::filesystem::path StorageManager::GetModMetadataPath(
-    PCWSTR metadataCategory) {
-    return appDataPath / L"ModsWritable" / metadataCategory;
-}
-
-wil::unique_hfile StorageManager::CreateModMetadataFile(PCWSTR metadataCategory,
-                                                        PCWSTR modInstanceId) {
-    auto metadataCategoryPath = GetModMetadataPath(metadataCategory);
-
-    if (!std::filesystem::is_directory(metadataCategoryPath)) {
-        std::error_code ec;
-        std::filesystem::create_directories(metadataCategoryPath, ec);
-    }
-
-    auto metadataFilePath = metadataCategoryPath / modInstanceId;
-
-    wil::unique_hfile file(CreateFile(
-        metadataFilePath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
-        CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
-        nullptr));
-    THROW_LAST_ERROR_IF(!file);
-
-    return file;
-}
-
-void StorageManager::SetModMetadataValue(wil::unique_hfile& file,
-                                         PCWSTR value) {
-    THROW_LAST_ERROR_IF(SetFilePointer(file.get(), 0, nullptr, FILE_BEGIN) ==
-                        INVALID_SET_FILE_POINTER);
-    THROW_IF_WIN32_BOOL_FALSE(SetEndOfFile(file.get()));
-
-    DWORD dwNumberOfBytesWritten;
-    THROW_IF_WIN32_BOOL_FALSE(WriteFile(
-        file.get(), value, wil::safe_cast<DWORD>(wcslen(value) * sizeof(WCHAR)),
-        &dwNumberOfBytesWritten, nullptr));
-}
-
 std::filesystem::path StorageManager::GetEnginePath(USHORT machine) {
     std::filesystem::path libraryPath =
         wil::GetModuleFileName<std::wstring>(g_hDllInst);
@@ -305,6 +268,14 @@ std::filesystem::path StorageManager::GetSymbolsPath() {
     return appDataPath / L"Symbols";
 }
 
+std::filesystem::path StorageManager::GetCallIndexPath() {
+    return appDataPath / L"CallIndex";
+}
+
+std::filesystem::path StorageManager::GetUrlCachePath() {
+    return appDataPath / L"UrlCache";
+}
+
 StorageManager::StorageManager() {
     std::filesystem::path dllPath =
         wil::GetModuleFileName<std::wstring>(g_hDllInst);
@@ -22,16 +22,13 @@ class StorageManager {
 
     std::filesystem::path GetModStoragePath(PCWSTR modName);
 
-    std::filesystem::path GetModMetadataPath(PCWSTR metadataCategory);
-    wil::unique_hfile CreateModMetadataFile(PCWSTR metadataCategory,
-                                            PCWSTR modInstanceId);
-    void SetModMetadataValue(wil::unique_hfile& file, PCWSTR value);
-
     std::filesystem::path GetEnginePath(
         USHORT machine = IMAGE_FILE_MACHINE_UNKNOWN);
     std::filesystem::path GetModsPath(
         USHORT machine = IMAGE_FILE_MACHINE_UNKNOWN);
     std::filesystem::path GetSymbolsPath();
+    std::filesystem::path GetCallIndexPath();
+    std::filesystem::path GetUrlCachePath();
 
     class ModConfigChangeNotification {
        public:
@@ -0,0 +1,199 @@
+#include "stdafx.h"
+
+#include "functions.h"
+
+// The string functions of the Functions namespace. They only depend on a few
+// Win32 calls, which allows to build and benchmark them on other platforms, see
+// tests/CMakeLists.txt.
+
+namespace Functions {
+
+// https://github.com/tidwall/match.c
+//
+// match returns true if str matches pattern. This is a very
+// simple wildcard match where '*' matches on any number characters
+// and '?' matches on any one character.
+//
+// pattern:
+//   { term }
+// term:
+// 	 '*'         matches any sequence of non-Separator characters
+// 	 '?'         matches any single non-Separator character
+// 	 c           matches character c (c != '*', '?')
+bool wcsmatch(PCWSTR pat, size_t plen, PCWSTR str, size_t slen) {
+    if (plen < 0)
+        plen = wcslen(pat);
+    if (slen < 0)
+        slen = wcslen(str);
+    while (plen > 0) {
+        if (pat[0] == L'*') {
+            if (plen == 1)
+                return true;
+            if (pat[1] == L'*') {
+                pat++;
+                plen--;
+                continue;
+            }
+            if (wcsmatch(pat + 1, plen - 1, str, slen))
+                return true;
+            if (slen == 0)
+                return false;
+            str++;
+            slen--;
+            continue;
+        }
+        if (slen == 0)
+            return false;
+        if (pat[0] != L'?' && str[0] != pat[0])
+            return false;
+        pat++;
+        plen--;
+        str++;
+        slen--;
+    }
+    return slen == 0 && plen == 0;
+}
+
+std::vector<std::wstring> SplitString(std::wstring_view s, WCHAR delim) {
+    // https://stackoverflow.com/a/48403210
+    auto view =
+        s | std::views::split(delim) | std::views::transform([](auto&& rng) {
+            return std::wstring_view(rng.data(), rng.size());
+        });
+    return std::vector<std::wstring>(view.begin(), view.end());
+}
+
+std::vector<std::wstring_view> SplitStringToViews(std::wstring_view s,
+                                                  WCHAR delim) {
+    // https://stackoverflow.com/a/48403210
+    auto view =
+        s | std::views::split(delim) | std::views::transform([](auto&& rng) {
+            return std::wstring_view(rng.data(), rng.size());
+        });
+    return std::vector<std::wstring_view>(view.begin(), view.end());
+}
+
+// https://stackoverflow.com/a/29752943
+std::wstring ReplaceAll(std::wstring_view source,
+                        std::wstring_view from,
+                        std::wstring_view to,
+                        bool ignoreCase) {
+    auto findString = [ignoreCase](std::wstring_view haystack,
+                                   std::wstring_view needle,
+                                   size_t pos) -> size_t {
+        if (!ignoreCase) {
+            return haystack.find(needle, pos);
+        }
+
+        auto it = std::search(
+            haystack.begin() + pos, haystack.end(), needle.begin(),
+            needle.end(), [](WCHAR ch1, WCHAR ch2) {
+                LCMapStringEx(LOCALE_NAME_USER_DEFAULT, LCMAP_UPPERCASE, &ch1,
+                              1, &ch1, 1, nullptr, nullptr, 0);
+                LCMapStringEx(LOCALE_NAME_USER_DEFAULT, LCMAP_UPPERCASE, &ch2,
+                              1, &ch2, 1, nullptr, nullptr, 0);
+                return ch1 == ch2;
+            });
+        if (it == haystack.end()) {
+            return haystack.npos;
+        }
+
+        return std::distance(haystack.begin(), it);
+    };
+
+    std::wstring newString;
+
+    size_t lastPos = 0;
+    size_t findPos;
+
+    while ((findPos = findString(source, from, lastPos)) != source.npos) {
+        newString.append(source, lastPos, findPos - lastPos);
+        newString += to;
+        lastPos = findPos + from.length();
+    }
+
+    // Care for the rest after last occurrence.
+    newString += source.substr(lastPos);
+
+    return newString;
+}
+
+bool DoesPathMatchPattern(std::wstring_view path,
+                          std::wstring_view pattern,
+                          bool explicitOnly) {
+    if (pattern.empty()) {
+        return false;
+    }
+
+    // A case-insensitive comparison as recommended here:
+    // https://stackoverflow.com/q/410502
+
+    std::wstring pathUpper{path};
+
+    // Don't use CharUpperBuff to avoid depending on user32.dll. Use
+    // LCMapStringEx just like it's called internally by CharUpperBuff.
+    // CharUpperBuff(&pathUpper[0], wil::safe_cast<DWORD>(pathUpper.length()));
+    LCMapStringEx(LOCALE_NAME_USER_DEFAULT, LCMAP_UPPERCASE, &pathUpper[0],
+                  wil::safe_cast<int>(pathUpper.length()), &pathUpper[0],
+                  wil::safe_cast<int>(pathUpper.length()), nullptr, nullptr, 0);
+
+    std::wstring_view pathFileNameUpper = pathUpper;
+    if (size_t i = pathFileNameUpper.rfind(L'\\');
+        i != pathFileNameUpper.npos) {
+        pathFileNameUpper.remove_prefix(i + 1);
+    }
+
+    for (const auto& patternPartView : SplitStringToViews(pattern, L'|')) {
+        if (explicitOnly) {
+            bool patternIsWildcard =
+                patternPartView.find_first_of(L"*?") != patternPartView.npos;
+            if (patternIsWildcard) {
+                // If the pattern contains wildcards, it's not an explicit
+                // match.
+                continue;
+            }
+        }
+
+        auto patternPart = std::wstring{patternPartView};
+
+#ifndef _WIN64
+        BOOL isWow64;
+        if (IsWow64Process(GetCurrentProcess(), &isWow64) && isWow64) {
+            // Get the native Program Files path regardless of the current
+            // process architecture.
+            patternPart = ReplaceAll(patternPart, L"%ProgramFiles%",
+                                     L"%ProgramW6432%", /*ignoreCase=*/true);
+        }
+#endif  // _WIN64
+
+        auto patternPartNormalized =
+            wil::ExpandEnvironmentStrings<std::wstring>(patternPart.c_str());
+
+        // CharUpperBuff(&patternPartNormalized[0],
+        //               wil::safe_cast<DWORD>(patternPartNormalized.length()));
+        LCMapStringEx(LOCALE_NAME_USER_DEFAULT, LCMAP_UPPERCASE,
+                      &patternPartNormalized[0],
+                      wil::safe_cast<int>(patternPartNormalized.length()),
+                      &patternPartNormalized[0],
+                      wil::safe_cast<int>(patternPartNormalized.length()),
+                      nullptr, nullptr, 0);
+
+        std::wstring_view match = pathUpper;
+
+        // If there's no backslash in the pattern part, match only against the
+        // file name, not the full path.
+        if (patternPartNormalized.find(L'\\') == patternPartNormalized.npos) {
+            match = pathFileNameUpper;
+        }
+
+        if (wcsmatch(patternPartNormalized.data(),
+                     patternPartNormalized.length(), match.data(),
+                     match.length())) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+}  // namespace Functions
@@ -0,0 +1,79 @@
+#include "stdafx.h"
+
+#include "symbol_cache.h"
+
+namespace {
+
+// Unlike wcstoull, doesn't require a null-terminated copy of the digits. Stops
+// at the first character which isn't a digit.
+ULONG_PTR ParseOffset(std::wstring_view digits) {
+    ULONG_PTR offset = 0;
+    for (WCHAR c : digits) {
+        if (c < L'0' || c > L'9') {
+            break;
+        }
+
+        offset = offset * 10 + (c - L'0');
+    }
+
+    return offset;
+}
+
+}  // namespace
+
+namespace SymbolCache {
+
+bool Parse(std::wstring_view cache,
+           WCHAR separator,
+           WCHAR version,
+           std::vector<Entry>* entries) {
+    entries->clear();
+
+    // The version, then the module file name and the module time stamp and
+    // size, which are ignored and act like comments.
+    size_t pos = 0;
+    for (int i = 0; i < 3; i++) {
+        size_t next = cache.find(separator, pos);
+        if (i == 0 && cache.substr(pos, next - pos) !=
+                          std::wstring_view(&version, 1)) {
+            return false;
+        }
+
+        if (next == cache.npos) {
+            return i == 2;
+        }
+
+        pos = next + 1;
+    }
+
+    while (true) {
+        size_t symbolEnd = cache.find(separator, pos);
+        if (symbolEnd == cache.npos) {
+            // A symbol without an offset is ignored.
+            break;
+        }
+
+        size_t offsetEnd = cache.find(separator, symbolEnd + 1);
+        auto offset =
+            cache.substr(symbolEnd + 1, offsetEnd == cache.npos
+                                            ? cache.npos
+                                            : offsetEnd - (symbolEnd + 1));
+
+        entries->push_back(Entry{
+            .symbol = cache.substr(pos, symbolEnd - pos),
+            .offset = offset.empty()
+                          ? std::nullopt
+                          : std::optional<ULONG_PTR>(ParseOffset(offset)),
+        });
+
+        if (offsetEnd == cache.npos) {
+            break;
+        }
+
+        pos = offsetEnd + 1;
+    }
+
+    return true;
+}
+
+}  // namespace SymbolCache
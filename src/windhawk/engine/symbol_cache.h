@@ -0,0 +1,26 @@
+#pragma once
+
+// Parsing of the symbol cache strings which are stored by Wh_HookSymbols. The
+// format is:
+//
+// <version><sep><module file name><sep><time stamp>-<image size>
+// (<sep><symbol><sep><offset>)*
+//
+// The separator depends on the module, and the offset is a decimal number
+// which is relative to the module base. An empty offset means that the symbol
+// doesn't exist in the module.
+namespace SymbolCache {
+
+struct Entry {
+    std::wstring_view symbol;
+    std::optional<ULONG_PTR> offset;
+};
+
+// Returns false if the string doesn't start with the expected version. The
+// entries point into the cache string.
+bool Parse(std::wstring_view cache,
+           WCHAR separator,
+           WCHAR version,
+           std::vector<Entry>* entries);
+
+}  // namespace SymbolCache
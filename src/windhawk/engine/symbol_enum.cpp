@@ -6,6 +6,9 @@
 #include "symbol_enum.h"
 #include "var_init_once.h"
 
+// Symbol enumeration is only used by some mods, see the note in mod.cpp.
+#pragma code_seg(push, ".text$zcold")
+
 void MySysFreeString(BSTR bstrString) {
     // Avoid having oleaut32.dll in the import table, since it might not be
     // available in all cases, e.g. sandboxed processes.
@@ -248,52 +251,6 @@ HMODULE WINAPI MsdiaLoadLibraryExWHook(LPCWSTR lpLibFileName,
     }
 }
 
-template <typename IMAGE_NT_HEADERS_T, typename IMAGE_LOAD_CONFIG_DIRECTORY_T>
-std::optional<std::span<const SymbolEnum::IMAGE_CHPE_RANGE_ENTRY>>
-GetChpeRanges(const IMAGE_DOS_HEADER* dosHeader,
-              const IMAGE_NT_HEADERS_T* ntHeader) {
-    auto* opt = &ntHeader->OptionalHeader;
-
-    if (opt->NumberOfRvaAndSizes <= IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG ||
-        !opt->DataDirectory[IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG].VirtualAddress) {
-        return std::nullopt;
-    }
-
-    DWORD directorySize =
-        opt->DataDirectory[IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG].Size;
-
-    auto* cfg =
-        (const IMAGE_LOAD_CONFIG_DIRECTORY_T*)((const char*)dosHeader +
-                                               opt->DataDirectory
-                                                   [IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG]
-                                                       .VirtualAddress);
-
-    constexpr DWORD kMinSize =
-        offsetof(IMAGE_LOAD_CONFIG_DIRECTORY_T, CHPEMetadataPointer) +
-        sizeof(IMAGE_LOAD_CONFIG_DIRECTORY_T::CHPEMetadataPointer);
-
-    if (directorySize < kMinSize || cfg->Size < kMinSize) {
-        return std::nullopt;
-    }
-
-    if (!cfg->CHPEMetadataPointer) {
-        return std::nullopt;
-    }
-
-    // Either IMAGE_CHPE_METADATA_X86 or IMAGE_ARM64EC_METADATA.
-    const void* metadata =
-        (const char*)dosHeader + cfg->CHPEMetadataPointer - opt->ImageBase;
-
-    ULONG codeMapRva = ((const ULONG*)metadata)[1];
-    ULONG codeMapCount = ((const ULONG*)metadata)[2];
-
-    auto* codeMap =
-        (const SymbolEnum::IMAGE_CHPE_RANGE_ENTRY*)((const char*)dosHeader +
-                                                    codeMapRva);
-
-    return std::span(codeMap, codeMapCount);
-}
-
 }  // namespace
 
 SymbolEnum::SymbolEnum(HMODULE moduleBase,
@@ -399,14 +356,9 @@ std::optional<SymbolEnum::Symbol> SymbolEnum::GetNextSymbol() {
             if (m_moduleInfo.isHybrid) {
                 bool is32Bit =
                     m_moduleInfo.magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC;
-                for (const auto& range : m_moduleInfo.chpeRanges) {
-                    ULONG start = is32Bit ? (range.StartOffset & ~1)
-                                          : (range.StartOffset & ~3);
-                    if (currentSymbolRva < start ||
-                        currentSymbolRva >= start + range.Length) {
-                        continue;
-                    }
-
+                auto* range = ChpeRanges::FindRange(
+                    m_moduleInfo.chpeRanges, currentSymbolRva, is32Bit);
+                if (range) {
                     if (is32Bit) {
                         constexpr PCWSTR prefixes[] = {
 #if defined(_M_IX86)
@@ -421,7 +373,7 @@ std::optional<SymbolEnum::Symbol> SymbolEnum::GetNextSymbol() {
 #endif
                         };
                         currentSymbolNameUndecoratedPrefix1 =
-                            prefixes[range.StartOffset & 1];
+                            prefixes[range->StartOffset & 1];
                     } else {
                         constexpr PCWSTR prefixes[] = {
 #if defined(_M_ARM64)
@@ -438,10 +390,8 @@ std::optional<SymbolEnum::Symbol> SymbolEnum::GetNextSymbol() {
                             L"arch=3\\",
                         };
                         currentSymbolNameUndecoratedPrefix1 =
-                            prefixes[range.StartOffset & 3];
+                            prefixes[range->StartOffset & 3];
                     }
-
-                    break;
                 }
             }
 
@@ -493,6 +443,7 @@ std::optional<SymbolEnum::Symbol> SymbolEnum::GetNextSymbol() {
                 m_currentSymbolNameUndecorated.get();
             currentSymbolNameUndecorated =
                 m_currentSymbolNameUndecoratedWithPrefixes.c_str();
+            UpdateMemoryUsage();
         }
 
         return SymbolEnum::Symbol{
@@ -511,14 +462,14 @@ void SymbolEnum::InitModuleInfo(HMODULE module) {
     std::optional<std::span<const IMAGE_CHPE_RANGE_ENTRY>> chpeRanges;
     switch (magic) {
         case IMAGE_NT_OPTIONAL_HDR32_MAGIC:
-            chpeRanges = GetChpeRanges<IMAGE_NT_HEADERS32,
-                                       IMAGE_LOAD_CONFIG_DIRECTORY32>(
+            chpeRanges = ChpeRanges::GetRanges<IMAGE_NT_HEADERS32,
+                                               IMAGE_LOAD_CONFIG_DIRECTORY32>(
                 dosHeader, (const IMAGE_NT_HEADERS32*)ntHeader);
             break;
 
         case IMAGE_NT_OPTIONAL_HDR64_MAGIC:
-            chpeRanges = GetChpeRanges<IMAGE_NT_HEADERS64,
-                                       IMAGE_LOAD_CONFIG_DIRECTORY64>(
+            chpeRanges = ChpeRanges::GetRanges<IMAGE_NT_HEADERS64,
+                                               IMAGE_LOAD_CONFIG_DIRECTORY64>(
                 dosHeader, (const IMAGE_NT_HEADERS64*)ntHeader);
             break;
     }
@@ -528,11 +479,20 @@ void SymbolEnum::InitModuleInfo(HMODULE module) {
     if (chpeRanges) {
         m_moduleInfo.isHybrid = true;
         m_moduleInfo.chpeRanges.assign(chpeRanges->begin(), chpeRanges->end());
+        UpdateMemoryUsage();
     } else {
         m_moduleInfo.isHybrid = false;
     }
 }
 
+void SymbolEnum::UpdateMemoryUsage() {
+    m_memoryUsage.Set(
+        sizeof(SymbolEnum) +
+        m_moduleInfo.chpeRanges.capacity() * sizeof(IMAGE_CHPE_RANGE_ENTRY) +
+        m_currentSymbolNameUndecoratedWithPrefixes.capacity() *
+            sizeof(WCHAR));
+}
+
 wil::com_ptr<IDiaDataSource> SymbolEnum::LoadMsdia() {
     auto enginePath = StorageManager::GetInstance().GetEnginePath();
     auto msdiaPath = enginePath / L"msdia140_windhawk.dll";
@@ -574,3 +534,5 @@ wil::com_ptr<IDiaDataSource> SymbolEnum::LoadMsdia() {
 
     return diaSource;
 }
+
+#pragma code_seg(pop)
@@ -1,11 +1,16 @@
 #pragma once
 
+#include "chpe_ranges.h"
+#include "memory_usage.h"
+
 void MySysFreeString(BSTR bstrString);
 
 using my_unique_bstr =
     wil::unique_any<BSTR, decltype(&MySysFreeString), MySysFreeString>;
 
-class SymbolEnum {
+// Only used by the symbol APIs, so the code is placed with the rest of their
+// code, see the note in mod.cpp.
+class __declspec(code_seg(".text$zcold")) SymbolEnum {
    public:
     enum class UndecorateMode {
         Default = 0,
@@ -36,21 +41,11 @@ class SymbolEnum {
 
     std::optional<Symbol> GetNextSymbol();
 
-    // https://ntdoc.m417z.com/image_chpe_range_entry
-    typedef struct _IMAGE_CHPE_RANGE_ENTRY {
-        union {
-            ULONG StartOffset;
-            struct {
-                ULONG NativeCode : 1;
-                ULONG AddressBits : 31;
-            } DUMMYSTRUCTNAME;
-        } DUMMYUNIONNAME;
-
-        ULONG Length;
-    } IMAGE_CHPE_RANGE_ENTRY, *PIMAGE_CHPE_RANGE_ENTRY;
+    using IMAGE_CHPE_RANGE_ENTRY = ChpeRanges::IMAGE_CHPE_RANGE_ENTRY;
 
    private:
     void InitModuleInfo(HMODULE module);
+    void UpdateMemoryUsage();
     wil::com_ptr<IDiaDataSource> LoadMsdia();
 
     static constexpr enum SymTagEnum kSymTags[] = {
@@ -75,4 +70,6 @@ class SymbolEnum {
     my_unique_bstr m_currentSymbolName;
     my_unique_bstr m_currentSymbolNameUndecorated;
     std::wstring m_currentSymbolNameUndecoratedWithPrefixes;
+    MemoryUsage::TrackedSize m_memoryUsage{MemoryUsage::Subsystem::kSymbols,
+                                           sizeof(SymbolEnum)};
 };
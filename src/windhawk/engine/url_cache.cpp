@@ -0,0 +1,321 @@
+#include "stdafx.h"
+
+#include "cache_folder.h"
+#include "cross_mod_mutex.h"
+#include "logger.h"
+#include "storage_manager.h"
+#include "url_cache.h"
+#include "url_cache_policy.h"
+#include "url_request.h"
+
+namespace {
+
+constexpr DWORD kFileMagic = 'CUHW';
+constexpr DWORD kFileVersion = 1;
+
+// Larger responses aren't cached, and the lengths of the stored strings are
+// limited, which also limits the size of a cache file which is trusted.
+constexpr size_t kMaxBodyLength = 64 * 1024 * 1024;
+constexpr size_t kMaxStringLength = 64 * 1024;
+
+// The least recently used entries are deleted above these limits.
+constexpr size_t kMaxCachedFileCount = 200;
+constexpr uintmax_t kMaxCacheSize = 256 * 1024 * 1024;
+
+constexpr WCHAR kFileExtension[] = L".bin";
+
+// A process which waits for another process to download the same URL gives up
+// after this time and downloads it too. The wait is done in slices, so that
+// the request can be cancelled meanwhile.
+constexpr DWORD kLockTimeout = 30 * 1000;
+constexpr DWORD kLockWaitSlice = 100;
+
+struct FileHeader {
+    DWORD magic;
+    DWORD version;
+    DWORD urlLength;
+    DWORD etagLength;
+    DWORD lastModifiedLength;
+    DWORD reserved;
+    // A FILETIME value, until which the response can be used without
+    // revalidation. Zero if it must always be revalidated.
+    ULONGLONG freshUntil;
+    ULONGLONG bodyLength;
+    // Followed by WCHAR url[urlLength], etag[etagLength],
+    // lastModified[lastModifiedLength] and char body[bodyLength].
+};
+
+struct Entry {
+    std::wstring etag;
+    std::wstring lastModified;
+    ULONGLONG freshUntil;
+    // Null-terminated.
+    std::unique_ptr<char[]> body;
+    size_t bodyLength;
+};
+
+// Per-process counters, which are logged with each request.
+std::atomic<DWORD> g_hits;
+std::atomic<DWORD> g_misses;
+std::atomic<DWORD> g_revalidations;
+
+void LogResult(PCWSTR result) {
+    VERBOSE(L"URL cache %s (%u hits, %u misses, %u revalidations)", result,
+            g_hits.load(), g_misses.load(), g_revalidations.load());
+}
+
+ULONGLONG FileTimeToUInt64(const FILETIME& fileTime) {
+    return (static_cast<ULONGLONG>(fileTime.dwHighDateTime) << 32) |
+           fileTime.dwLowDateTime;
+}
+
+ULONGLONG GetCurrentFileTime() {
+    FILETIME fileTime;
+    GetSystemTimeAsFileTime(&fileTime);
+    return FileTimeToUInt64(fileTime);
+}
+
+// Returns the time until which the response can be used without
+// revalidation, or zero if it must always be revalidated.
+ULONGLONG GetFreshUntil(UrlRequest& request, bool* noStore) {
+    ULONGLONG expires = 0;
+    if (auto expiresTime = request.GetHeaderTime(WINHTTP_QUERY_EXPIRES)) {
+        FILETIME fileTime;
+        if (SystemTimeToFileTime(&*expiresTime, &fileTime)) {
+            expires = FileTimeToUInt64(fileTime);
+        }
+    }
+
+    return UrlCachePolicy::GetFreshUntil(
+        request.GetHeader(WINHTTP_QUERY_CACHE_CONTROL).value_or(L""), expires,
+        GetCurrentFileTime(), noStore);
+}
+
+// Waits for the mutex of the URL, which is held by other processes while they
+// request it. Returns false on timeout. Throws ERROR_CANCELLED if the request
+// is cancelled meanwhile.
+bool AcquireLock(CrossModMutex& lock,
+                 const std::function<bool()>& isCancelled) {
+    if (!isCancelled) {
+        return lock.Acquire(kLockTimeout);
+    }
+
+    for (DWORD waited = 0; waited < kLockTimeout; waited += kLockWaitSlice) {
+        THROW_WIN32_IF(ERROR_CANCELLED, isCancelled());
+        if (lock.Acquire(kLockWaitSlice)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::optional<Entry> LoadEntry(const std::filesystem::path& path,
+                               std::wstring_view url) {
+    wil::unique_hfile file(CreateFile(path.c_str(), GENERIC_READ,
+                                      FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                      nullptr, OPEN_EXISTING, 0, nullptr));
+    if (!file) {
+        return std::nullopt;
+    }
+
+    auto read = [&file](void* buffer, size_t size) {
+        DWORD bytesRead;
+        return ReadFile(file.get(), buffer, static_cast<DWORD>(size),
+                        &bytesRead, nullptr) &&
+               bytesRead == size;
+    };
+
+    auto readString = [&read](std::wstring* value, DWORD length) {
+        value->resize(length);
+        return read(value->data(), length * sizeof(WCHAR));
+    };
+
+    LARGE_INTEGER fileSize;
+    FileHeader header;
+    if (!GetFileSizeEx(file.get(), &fileSize) ||
+        !read(&header, sizeof(header))) {
+        return std::nullopt;
+    }
+
+    // The file is written by other processes, validate it before allocating
+    // buffers by its sizes.
+    if (header.magic != kFileMagic || header.version != kFileVersion ||
+        header.urlLength > kMaxStringLength ||
+        header.etagLength > kMaxStringLength ||
+        header.lastModifiedLength > kMaxStringLength ||
+        header.bodyLength > kMaxBodyLength ||
+        sizeof(FileHeader) +
+                (static_cast<ULONGLONG>(header.urlLength) + header.etagLength +
+                 header.lastModifiedLength) *
+                    sizeof(WCHAR) +
+                header.bodyLength !=
+            static_cast<ULONGLONG>(fileSize.QuadPart)) {
+        return std::nullopt;
+    }
+
+    std::wstring entryUrl;
+    Entry entry;
+    if (!readString(&entryUrl, header.urlLength) || entryUrl != url ||
+        !readString(&entry.etag, header.etagLength) ||
+        !readString(&entry.lastModified, header.lastModifiedLength)) {
+        return std::nullopt;
+    }
+
+    entry.freshUntil = header.freshUntil;
+    entry.bodyLength = static_cast<size_t>(header.bodyLength);
+    entry.body = std::make_unique_for_overwrite<char[]>(entry.bodyLength + 1);
+    if (!read(entry.body.get(), entry.bodyLength)) {
+        return std::nullopt;
+    }
+
+    entry.body[entry.bodyLength] = '\0';
+    return entry;
+}
+
+void SaveEntry(const std::filesystem::path& path,
+               std::wstring_view url,
+               std::wstring_view etag,
+               std::wstring_view lastModified,
+               ULONGLONG freshUntil,
+               const char* body,
+               size_t bodyLength) {
+    if (url.length() > kMaxStringLength || etag.length() > kMaxStringLength ||
+        lastModified.length() > kMaxStringLength ||
+        bodyLength > kMaxBodyLength) {
+        return;
+    }
+
+    std::filesystem::create_directories(path.parent_path());
+
+    FileHeader header{
+        .magic = kFileMagic,
+        .version = kFileVersion,
+        .urlLength = static_cast<DWORD>(url.length()),
+        .etagLength = static_cast<DWORD>(etag.length()),
+        .lastModifiedLength = static_cast<DWORD>(lastModified.length()),
+        .freshUntil = freshUntil,
+        .bodyLength = bodyLength,
+    };
+
+    // Written to a temporary file first, so that other processes never read a
+    // partially written entry.
+    auto tempPath = path;
+    tempPath += L"." + std::to_wstring(GetCurrentProcessId()) + L".tmp";
+
+    {
+        wil::unique_hfile file(CreateFile(tempPath.c_str(), GENERIC_WRITE, 0,
+                                          nullptr, CREATE_ALWAYS, 0, nullptr));
+        THROW_LAST_ERROR_IF(!file);
+
+        auto write = [&file](const void* buffer, size_t size) {
+            DWORD bytesWritten;
+            THROW_IF_WIN32_BOOL_FALSE(
+                WriteFile(file.get(), buffer, static_cast<DWORD>(size),
+                          &bytesWritten, nullptr));
+        };
+
+        write(&header, sizeof(header));
+        write(url.data(), url.length() * sizeof(WCHAR));
+        write(etag.data(), etag.length() * sizeof(WCHAR));
+        write(lastModified.data(), lastModified.length() * sizeof(WCHAR));
+        write(body, bodyLength);
+    }
+
+    if (!MoveFileEx(tempPath.c_str(), path.c_str(),
+                    MOVEFILE_REPLACE_EXISTING)) {
+        DWORD error = GetLastError();
+        DeleteFile(tempPath.c_str());
+        THROW_WIN32(error);
+    }
+}
+
+}  // namespace
+
+namespace UrlCache {
+
+WH_URL_CONTENT* Get(PCWSTR url, const std::function<bool()>& isCancelled) {
+    std::wstring key = UrlCachePolicy::MakeKey(url);
+    auto folder = StorageManager::GetInstance().GetUrlCachePath();
+    auto path = folder / (key + kFileExtension);
+
+    // If another process is requesting the same URL, wait for it to finish,
+    // then use its response from the cache.
+    CrossModMutex lock((L"WindhawkUrlCache_" + key).c_str());
+    if (lock && !AcquireLock(lock, isCancelled)) {
+        LOG(L"Timed out waiting for another request of %s", url);
+    }
+
+    auto entry = LoadEntry(path, url);
+    if (entry && GetCurrentFileTime() < entry->freshUntil) {
+        g_hits++;
+        LogResult(L"hit");
+        CacheFolder::Touch(path);
+        return UrlContent::FromBuffer(HTTP_STATUS_OK, std::move(entry->body),
+                                      entry->bodyLength);
+    }
+
+    std::wstring conditionalHeaders =
+        entry ? UrlCachePolicy::MakeConditionalHeaders(entry->etag,
+                                                       entry->lastModified)
+              : L"";
+
+    UrlRequest request(url, conditionalHeaders.empty()
+                                ? nullptr
+                                : conditionalHeaders.c_str());
+    DWORD statusCode = request.GetStatusCode();
+
+    bool noStore;
+    ULONGLONG freshUntil = GetFreshUntil(request, &noStore);
+
+    if (entry && statusCode == HTTP_STATUS_NOT_MODIFIED) {
+        g_revalidations++;
+        LogResult(L"revalidation");
+
+        if (freshUntil != entry->freshUntil) {
+            try {
+                SaveEntry(path, url, entry->etag, entry->lastModified,
+                          freshUntil, entry->body.get(), entry->bodyLength);
+            } catch (const std::exception& e) {
+                LOG(L"Saving URL cache entry failed: %S", e.what());
+            }
+        } else {
+            CacheFolder::Touch(path);
+        }
+
+        return UrlContent::FromBuffer(HTTP_STATUS_OK, std::move(entry->body),
+                                      entry->bodyLength);
+    }
+
+    size_t length;
+    auto data = request.ReadToEnd(&length, isCancelled);
+
+    g_misses++;
+    LogResult(L"miss");
+
+    if (statusCode == HTTP_STATUS_OK && !noStore) {
+        auto etag = request.GetHeader(WINHTTP_QUERY_ETAG).value_or(L"");
+        auto lastModified =
+            request.GetHeader(WINHTTP_QUERY_LAST_MODIFIED).value_or(L"");
+
+        // Without a freshness lifetime or a validator, the entry could never
+        // be used.
+        if (freshUntil || !etag.empty() || !lastModified.empty()) {
+            try {
+                SaveEntry(path, url, etag, lastModified, freshUntil,
+                          data.get(), length);
+            } catch (const std::exception& e) {
+                LOG(L"Saving URL cache entry failed: %S", e.what());
+            }
+
+            CacheFolder::Trim(folder, kFileExtension, kMaxCachedFileCount,
+                              kMaxCacheSize);
+        }
+    } else if (entry && noStore) {
+        DeleteFile(path.c_str());
+    }
+
+    return UrlContent::FromBuffer(statusCode, std::move(data), length);
+}
+
+}  // namespace UrlCache
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "mods_api.h"
+
+// An HTTP cache for the in-memory content of Wh_GetUrlContent, which is shared
+// by all processes. Responses are stored in files, used as is while they're
+// fresh according to Cache-Control or Expires, and revalidated with ETag and
+// Last-Modified afterwards. A cross-process mutex is held for each URL while
+// it's requested, so that if several processes request the same URL at once,
+// only the first one downloads it, and the others read it from the cache. The
+// least recently used entries are deleted above 200 entries or 256 MB.
+namespace UrlCache {
+
+// Like UrlContent::Get for in-memory content. isCancelled is also checked
+// while waiting for another process. Throws on failure.
+WH_URL_CONTENT* Get(PCWSTR url,
+                    const std::function<bool()>& isCancelled = nullptr);
+
+}  // namespace UrlCache
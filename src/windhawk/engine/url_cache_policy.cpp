@@ -0,0 +1,106 @@
+#include "stdafx.h"
+
+#include "url_cache_policy.h"
+
+namespace {
+
+std::wstring_view TrimWhitespace(std::wstring_view s) {
+    size_t start = s.find_first_not_of(L" \t");
+    if (start == s.npos) {
+        return {};
+    }
+
+    size_t end = s.find_last_not_of(L" \t");
+    return s.substr(start, end - start + 1);
+}
+
+bool StartsWithIgnoreCase(std::wstring_view s, std::wstring_view prefix) {
+    return s.length() >= prefix.length() &&
+           _wcsnicmp(s.data(), prefix.data(), prefix.length()) == 0;
+}
+
+}  // namespace
+
+namespace UrlCachePolicy {
+
+// FNV-1a.
+std::wstring MakeKey(std::wstring_view url) {
+    uint64_t hash = 0xCBF29CE484222325;
+    for (WCHAR c : url) {
+        hash ^= c;
+        hash *= 0x100000001B3;
+    }
+
+    WCHAR key[sizeof("0123456789abcdef")];
+    swprintf_s(key, L"%016llx", static_cast<unsigned long long>(hash));
+    return key;
+}
+
+ULONGLONG GetFreshUntil(std::wstring_view cacheControl,
+                        ULONGLONG expires,
+                        ULONGLONG now,
+                        bool* noStore) {
+    *noStore = false;
+
+    bool noCache = false;
+    std::optional<ULONGLONG> maxAge;
+
+    std::wstring_view rest = cacheControl;
+    while (!rest.empty()) {
+        size_t comma = rest.find(L',');
+        auto directive = TrimWhitespace(rest.substr(0, comma));
+        rest = comma == rest.npos ? L"" : rest.substr(comma + 1);
+
+        if (StartsWithIgnoreCase(directive, L"no-store")) {
+            *noStore = true;
+        } else if (StartsWithIgnoreCase(directive, L"no-cache")) {
+            noCache = true;
+        } else if (StartsWithIgnoreCase(directive, L"max-age=")) {
+            ULONGLONG value = 0;
+            for (WCHAR c : directive.substr(sizeof("max-age=") - 1)) {
+                if (c < L'0' || c > L'9') {
+                    break;
+                }
+
+                value = std::min(value * 10 + (c - L'0'), kMaxAgeSeconds);
+            }
+
+            maxAge = value;
+        }
+    }
+
+    if (noCache) {
+        return 0;
+    }
+
+    if (maxAge) {
+        return *maxAge ? now + *maxAge * kFileTimeTicksPerSecond : 0;
+    }
+
+    if (expires) {
+        return std::min(expires,
+                        now + kMaxAgeSeconds * kFileTimeTicksPerSecond);
+    }
+
+    return 0;
+}
+
+std::wstring MakeConditionalHeaders(std::wstring_view etag,
+                                    std::wstring_view lastModified) {
+    std::wstring headers;
+    if (!etag.empty()) {
+        headers += L"If-None-Match: ";
+        headers += etag;
+        headers += L"\r\n";
+    }
+
+    if (!lastModified.empty()) {
+        headers += L"If-Modified-Since: ";
+        headers += lastModified;
+        headers += L"\r\n";
+    }
+
+    return headers;
+}
+
+}  // namespace UrlCachePolicy
@@ -0,0 +1,30 @@
+#pragma once
+
+// The HTTP caching rules of UrlCache: how long a response is fresh, and how
+// it's revalidated afterwards. Times are FILETIME values. Only depends on the
+// standard library, so that it can be tested with canned responses.
+namespace UrlCachePolicy {
+
+inline constexpr ULONGLONG kFileTimeTicksPerSecond = 10'000'000;
+
+// Freshness lifetimes are capped at a year.
+inline constexpr ULONGLONG kMaxAgeSeconds = 365 * 24 * 60 * 60;
+
+// The name of the cache file and of the mutex of a URL.
+std::wstring MakeKey(std::wstring_view url);
+
+// Returns the time until which a response can be used without revalidation,
+// or zero if it must always be revalidated. cacheControl is empty and expires
+// is zero if the headers are missing. noStore is set if the response must not
+// be stored at all.
+ULONGLONG GetFreshUntil(std::wstring_view cacheControl,
+                        ULONGLONG expires,
+                        ULONGLONG now,
+                        bool* noStore);
+
+// The request headers which revalidate a stored response, separated by
+// "\r\n". Empty if the response has no validators.
+std::wstring MakeConditionalHeaders(std::wstring_view etag,
+                                    std::wstring_view lastModified);
+
+}  // namespace UrlCachePolicy
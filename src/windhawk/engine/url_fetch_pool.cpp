@@ -0,0 +1,215 @@
+#include "stdafx.h"
+
+#include "logger.h"
+#include "no_destructor.h"
+#include "url_fetch_pool.h"
+#include "url_request.h"
+#include "var_init_once.h"
+
+extern HINSTANCE g_hDllInst;
+
+namespace {
+
+// Downloads are mostly waiting for the network, but a limit avoids creating
+// many threads if a lot of requests are submitted at once.
+constexpr DWORD kMaxThreads = 4;
+
+}  // namespace
+
+// static
+UrlFetchPool& UrlFetchPool::GetInstance() {
+    STATIC_INIT_ONCE(NoDestructorIfTerminating<UrlFetchPool>, s);
+    return **s;
+}
+
+UrlFetchPool::UrlFetchPool() {
+    InitializeThreadpoolEnvironment(&m_callbackEnvironment);
+
+    m_pool = CreateThreadpool(nullptr);
+    if (!m_pool) {
+        LOG(L"CreateThreadpool failed, using the default pool: %u",
+            GetLastError());
+        return;
+    }
+
+    SetThreadpoolThreadMaximum(m_pool, kMaxThreads);
+    SetThreadpoolCallbackPool(&m_callbackEnvironment, m_pool);
+}
+
+UrlFetchPool::~UrlFetchPool() {
+    // Each pending request holds a reference to the engine, so there are no
+    // pending requests at this point.
+    DestroyThreadpoolEnvironment(&m_callbackEnvironment);
+
+    if (m_pool) {
+        CloseThreadpool(m_pool);
+    }
+}
+
+HANDLE UrlFetchPool::Submit(void* owner,
+                            PCWSTR url,
+                            const WH_GET_URL_CONTENT_OPTIONS& options,
+                            Callback callback) {
+    auto request = std::make_shared<Request>();
+    request->owner = owner;
+    request->url = url;
+    request->options = options;
+    request->callback = std::move(callback);
+
+    if (options.targetFilePath) {
+        request->targetFilePath = options.targetFilePath;
+        request->options.targetFilePath = request->targetFilePath->c_str();
+    }
+
+    // The write callback is called through WriteCallback, which doesn't call
+    // it after the request is cancelled.
+    if (options.writeCallback) {
+        request->writeCallback = options.writeCallback;
+        request->writeCallbackParam = options.writeCallbackParam;
+        request->options.writeCallback = WriteCallback;
+        request->options.writeCallbackParam = request.get();
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        // Handles aren't reused, so that a stale handle can't cancel another
+        // request.
+        request->handle = reinterpret_cast<HANDLE>(++m_lastHandleValue);
+        m_requests.emplace(request->handle, request);
+    }
+
+    // Bump the reference count of the engine, it's released when the callback
+    // returns.
+    HMODULE hDllInst;
+    GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                      reinterpret_cast<LPCWSTR>(g_hDllInst), &hDllInst);
+
+    auto context = std::make_unique<std::shared_ptr<Request>>(request);
+    if (!TrySubmitThreadpoolCallback(WorkCallback, context.get(),
+                                     &m_callbackEnvironment)) {
+        LOG(L"TrySubmitThreadpoolCallback failed: %u", GetLastError());
+        FreeLibrary(g_hDllInst);
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_requests.erase(request->handle);
+        return nullptr;
+    }
+
+    context.release();
+    return request->handle;
+}
+
+bool UrlFetchPool::Cancel(void* owner, HANDLE request) {
+    std::shared_ptr<Request> removed;
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        auto it = m_requests.find(request);
+        if (it == m_requests.end() || it->second->owner != owner) {
+            return false;
+        }
+
+        removed = std::move(it->second);
+        m_requests.erase(it);
+    }
+
+    Deactivate(*removed);
+    return true;
+}
+
+void UrlFetchPool::CancelAll(void* owner) {
+    std::vector<std::shared_ptr<Request>> removed;
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        for (auto it = m_requests.begin(); it != m_requests.end();) {
+            if (it->second->owner == owner) {
+                removed.push_back(std::move(it->second));
+                it = m_requests.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    for (const auto& request : removed) {
+        Deactivate(*request);
+    }
+}
+
+// static
+void CALLBACK UrlFetchPool::WorkCallback(PTP_CALLBACK_INSTANCE instance,
+                                         PVOID context) {
+    {
+        std::unique_ptr<std::shared_ptr<Request>> request(
+            static_cast<std::shared_ptr<Request>*>(context));
+
+        GetInstance().Run(*request);
+    }
+
+    FreeLibraryWhenCallbackReturns(instance, g_hDllInst);
+}
+
+// static
+BOOL UrlFetchPool::WriteCallback(const void* data, size_t length, void* param) {
+    auto* request = static_cast<Request*>(param);
+
+    std::lock_guard<std::mutex> guard(request->callbackMutex);
+
+    if (!request->active) {
+        return FALSE;
+    }
+
+    request->callbackThreadId = GetCurrentThreadId();
+    auto callbackThreadIdCleanup =
+        wil::scope_exit([request] { request->callbackThreadId = 0; });
+
+    return request->writeCallback(data, length, request->writeCallbackParam);
+}
+
+void UrlFetchPool::Run(const std::shared_ptr<Request>& request) {
+    WH_URL_CONTENT* content = nullptr;
+
+    try {
+        content = UrlContent::Get(request->url.c_str(), request->options,
+                                  [&request] { return !request->active; });
+    } catch (const std::exception& e) {
+        if (request->active) {
+            LOG(L"Failed to get URL content of %s: %S", request->url.c_str(),
+                e.what());
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(request->callbackMutex);
+
+        if (request->active) {
+            request->callbackThreadId = GetCurrentThreadId();
+            auto callbackThreadIdCleanup =
+                wil::scope_exit([&request] { request->callbackThreadId = 0; });
+
+            // The callback owns the content from now on.
+            request->callback(std::exchange(content, nullptr));
+        }
+    }
+
+    UrlContent::Free(content);
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_requests.erase(request->handle);
+}
+
+// static
+void UrlFetchPool::Deactivate(Request& request) {
+    if (request.callbackThreadId == GetCurrentThreadId()) {
+        // Called from a callback, which already holds the lock.
+        request.active = false;
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(request.callbackMutex);
+    request.active = false;
+}
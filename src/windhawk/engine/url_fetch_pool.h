@@ -0,0 +1,67 @@
+#pragma once
+
+#include "mods_api.h"
+
+// Runs the asynchronous URL content requests of mods on a thread pool which is
+// dedicated to them, so that slow downloads don't occupy the threads of the
+// default pool. The requests share the WinHTTP session of UrlRequest, which
+// keeps connections alive per host.
+class UrlFetchPool {
+   public:
+    // Receives the content, which the callback owns, or nullptr on failure.
+    using Callback = std::function<void(const WH_URL_CONTENT* content)>;
+
+    static UrlFetchPool& GetInstance();
+
+    UrlFetchPool(const UrlFetchPool&) = delete;
+    UrlFetchPool& operator=(const UrlFetchPool&) = delete;
+
+    UrlFetchPool();
+    ~UrlFetchPool();
+
+    // The URL and the options are copied. Returns nullptr on failure.
+    HANDLE Submit(void* owner,
+                  PCWSTR url,
+                  const WH_GET_URL_CONTENT_OPTIONS& options,
+                  Callback callback);
+
+    // Once this returns, neither the callback nor the write callback of the
+    // options is running, and they won't be called again. A download which is
+    // in progress is stopped before its next read. Can be called from the
+    // callbacks themselves. Returns false if the request already completed.
+    bool Cancel(void* owner, HANDLE request);
+    void CancelAll(void* owner);
+
+   private:
+    struct Request {
+        void* owner;
+        HANDLE handle;
+        std::wstring url;
+        std::optional<std::wstring> targetFilePath;
+        WH_GET_URL_CONTENT_OPTIONS options;
+        Callback callback;
+        // The write callback of the options, which is replaced with
+        // WriteCallback.
+        WH_URL_CONTENT_WRITE_CALLBACK writeCallback;
+        void* writeCallbackParam;
+
+        // Held while the callback or the write callback runs.
+        std::mutex callbackMutex;
+        std::atomic<bool> active = true;
+        std::atomic<DWORD> callbackThreadId = 0;
+    };
+
+    static void CALLBACK WorkCallback(PTP_CALLBACK_INSTANCE instance,
+                                      PVOID context);
+    static BOOL WriteCallback(const void* data, size_t length, void* param);
+
+    void Run(const std::shared_ptr<Request>& request);
+    static void Deactivate(Request& request);
+
+    std::mutex m_mutex;
+    ULONG_PTR m_lastHandleValue = 0;
+    std::unordered_map<HANDLE, std::shared_ptr<Request>> m_requests;
+
+    PTP_POOL m_pool = nullptr;
+    TP_CALLBACK_ENVIRON m_callbackEnvironment;
+};
@@ -0,0 +1,413 @@
+#include "stdafx.h"
+
+#include "logger.h"
+#include "memory_usage.h"
+#include "no_destructor.h"
+#include "response_body.h"
+#include "url_cache.h"
+#include "url_request.h"
+#include "var_init_once.h"
+#include "version.h"
+
+// Available since Windows 8.1, ignored on older versions.
+#ifndef WINHTTP_OPTION_DECOMPRESSION
+#define WINHTTP_OPTION_DECOMPRESSION 118
+#define WINHTTP_DECOMPRESSION_FLAG_GZIP 0x00000001
+#define WINHTTP_DECOMPRESSION_FLAG_DEFLATE 0x00000002
+#define WINHTTP_DECOMPRESSION_FLAG_ALL \
+    (WINHTTP_DECOMPRESSION_FLAG_GZIP | WINHTTP_DECOMPRESSION_FLAG_DEFLATE)
+#endif
+
+namespace {
+
+// The default size of the parts which are passed to the write callback or
+// written to the target file.
+constexpr size_t kDefaultBufferSize = 64 * 1024;
+
+using WinHttpCloseHandle_t = decltype(&WinHttpCloseHandle);
+using WinHttpOpen_t = decltype(&WinHttpOpen);
+using WinHttpConnect_t = decltype(&WinHttpConnect);
+using WinHttpQueryHeaders_t = decltype(&WinHttpQueryHeaders);
+using WinHttpReceiveResponse_t = decltype(&WinHttpReceiveResponse);
+using WinHttpSendRequest_t = decltype(&WinHttpSendRequest);
+using WinHttpOpenRequest_t = decltype(&WinHttpOpenRequest);
+using WinHttpReadData_t = decltype(&WinHttpReadData);
+using WinHttpCrackUrl_t = decltype(&WinHttpCrackUrl);
+using WinHttpSetOption_t = decltype(&WinHttpSetOption);
+
+class WinHttpFunctions {
+   public:
+    wil::unique_hmodule module;
+
+    WinHttpCloseHandle_t CloseHandle;
+    WinHttpOpen_t Open;
+    WinHttpConnect_t Connect;
+    WinHttpQueryHeaders_t QueryHeaders;
+    WinHttpReceiveResponse_t ReceiveResponse;
+    WinHttpSendRequest_t SendRequest;
+    WinHttpOpenRequest_t OpenRequest;
+    WinHttpReadData_t ReadData;
+    WinHttpCrackUrl_t CrackUrl;
+    WinHttpSetOption_t SetOption;
+
+    WinHttpFunctions() {
+        wil::unique_hmodule winhttpModule{LoadLibraryEx(
+            L"winhttp.dll", nullptr, LOAD_LIBRARY_SEARCH_SYSTEM32)};
+        if (!winhttpModule) {
+            LOG(L"Failed to load winhttp.dll");
+            return;
+        }
+
+        HMODULE moduleRaw = winhttpModule.get();
+
+        CloseHandle = reinterpret_cast<WinHttpCloseHandle_t>(
+            GetProcAddress(moduleRaw, "WinHttpCloseHandle"));
+        Open = reinterpret_cast<WinHttpOpen_t>(
+            GetProcAddress(moduleRaw, "WinHttpOpen"));
+        Connect = reinterpret_cast<WinHttpConnect_t>(
+            GetProcAddress(moduleRaw, "WinHttpConnect"));
+        QueryHeaders = reinterpret_cast<WinHttpQueryHeaders_t>(
+            GetProcAddress(moduleRaw, "WinHttpQueryHeaders"));
+        ReceiveResponse = reinterpret_cast<WinHttpReceiveResponse_t>(
+            GetProcAddress(moduleRaw, "WinHttpReceiveResponse"));
+        SendRequest = reinterpret_cast<WinHttpSendRequest_t>(
+            GetProcAddress(moduleRaw, "WinHttpSendRequest"));
+        OpenRequest = reinterpret_cast<WinHttpOpenRequest_t>(
+            GetProcAddress(moduleRaw, "WinHttpOpenRequest"));
+        ReadData = reinterpret_cast<WinHttpReadData_t>(
+            GetProcAddress(moduleRaw, "WinHttpReadData"));
+        CrackUrl = reinterpret_cast<WinHttpCrackUrl_t>(
+            GetProcAddress(moduleRaw, "WinHttpCrackUrl"));
+        SetOption = reinterpret_cast<WinHttpSetOption_t>(
+            GetProcAddress(moduleRaw, "WinHttpSetOption"));
+
+        if (!CloseHandle || !Open || !Connect || !QueryHeaders ||
+            !ReceiveResponse || !SendRequest || !OpenRequest || !ReadData ||
+            !CrackUrl || !SetOption) {
+            LOG(L"Failed to get all winhttp.dll functions");
+            return;
+        }
+
+        module = std::move(winhttpModule);
+    }
+};
+
+const WinHttpFunctions& GetWinHttp() {
+    STATIC_INIT_ONCE(WinHttpFunctions, winhttp, );
+    if (!winhttp->module) {
+        throw std::runtime_error("WinHttp functions are not available");
+    }
+
+    return *winhttp;
+}
+
+// A single session is used for all requests of the process, which allows
+// WinHTTP to keep connections alive and reuse them for requests to the same
+// host.
+class SharedSession {
+   public:
+    SharedSession() {
+        m_session = GetWinHttp().Open(L"Windhawk/" VER_FILE_VERSION_WSTR,
+                                      WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+                                      WINHTTP_NO_PROXY_NAME,
+                                      WINHTTP_NO_PROXY_BYPASS, 0);
+        if (!m_session) {
+            LOG(L"WinHttpOpen failed: %u", GetLastError());
+        }
+    }
+
+    ~SharedSession() {
+        if (m_session) {
+            GetWinHttp().CloseHandle(m_session);
+        }
+    }
+
+    SharedSession(const SharedSession&) = delete;
+    SharedSession& operator=(const SharedSession&) = delete;
+
+    HINTERNET Get() const { return m_session; }
+
+   private:
+    HINTERNET m_session;
+};
+
+HINTERNET GetSharedSession() {
+    STATIC_INIT_ONCE(NoDestructorIfTerminating<SharedSession>, session);
+    HINTERNET handle = (*session)->Get();
+    if (!handle) {
+        throw std::runtime_error("WinHttp session is not available");
+    }
+
+    return handle;
+}
+
+}  // namespace
+
+UrlRequest::UrlRequest(PCWSTR url, PCWSTR additionalHeaders) {
+    const auto& winhttp = GetWinHttp();
+
+    try {
+        URL_COMPONENTS urlComp = {sizeof(urlComp)};
+        urlComp.dwHostNameLength = (DWORD)-1;
+        urlComp.dwUrlPathLength = (DWORD)-1;
+        THROW_IF_WIN32_BOOL_FALSE(winhttp.CrackUrl(url, 0, 0, &urlComp));
+
+        m_connect = winhttp.Connect(
+            GetSharedSession(),
+            std::wstring(urlComp.lpszHostName, urlComp.dwHostNameLength)
+                .c_str(),
+            urlComp.nPort, 0);
+        THROW_LAST_ERROR_IF_NULL(m_connect);
+
+        m_request = winhttp.OpenRequest(
+            m_connect, L"GET",
+            std::wstring(urlComp.lpszUrlPath, urlComp.dwUrlPathLength).c_str(),
+            nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES,
+            urlComp.nScheme == INTERNET_SCHEME_HTTPS ? WINHTTP_FLAG_SECURE
+                                                     : 0);
+        THROW_LAST_ERROR_IF_NULL(m_request);
+
+        // Adds the Accept-Encoding header and decompresses the body while it's
+        // read. Fails on Windows versions which don't support it, in which
+        // case the body is received as is.
+        DWORD decompression = WINHTTP_DECOMPRESSION_FLAG_ALL;
+        m_decompression =
+            winhttp.SetOption(m_request, WINHTTP_OPTION_DECOMPRESSION,
+                              &decompression, sizeof(decompression));
+        if (!m_decompression) {
+            VERBOSE(L"WINHTTP_OPTION_DECOMPRESSION isn't supported: %u",
+                    GetLastError());
+        }
+
+        THROW_IF_WIN32_BOOL_FALSE(winhttp.SendRequest(
+            m_request,
+            additionalHeaders ? additionalHeaders
+                              : WINHTTP_NO_ADDITIONAL_HEADERS,
+            additionalHeaders ? static_cast<DWORD>(-1L) : 0,
+            WINHTTP_NO_REQUEST_DATA, 0, 0, 0));
+
+        THROW_IF_WIN32_BOOL_FALSE(
+            winhttp.ReceiveResponse(m_request, nullptr));
+    } catch (...) {
+        Close();
+        throw;
+    }
+}
+
+UrlRequest::~UrlRequest() {
+    Close();
+}
+
+DWORD UrlRequest::GetStatusCode() {
+    DWORD statusCode = 0;
+    DWORD statusCodeSize = sizeof(statusCode);
+    THROW_IF_WIN32_BOOL_FALSE(GetWinHttp().QueryHeaders(
+        m_request, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+        WINHTTP_HEADER_NAME_BY_INDEX, &statusCode, &statusCodeSize,
+        WINHTTP_NO_HEADER_INDEX));
+
+    return statusCode;
+}
+
+std::optional<DWORD> UrlRequest::GetContentLength() {
+    DWORD contentLength = 0;
+    DWORD contentLengthSize = sizeof(contentLength);
+    if (!GetWinHttp().QueryHeaders(
+            m_request, WINHTTP_QUERY_CONTENT_LENGTH | WINHTTP_QUERY_FLAG_NUMBER,
+            WINHTTP_HEADER_NAME_BY_INDEX, &contentLength, &contentLengthSize,
+            WINHTTP_NO_HEADER_INDEX)) {
+        return std::nullopt;
+    }
+
+    return contentLength;
+}
+
+std::optional<std::wstring> UrlRequest::GetHeader(DWORD infoLevel) {
+    const auto& winhttp = GetWinHttp();
+
+    DWORD size = 0;
+    if (!winhttp.QueryHeaders(m_request, infoLevel,
+                              WINHTTP_HEADER_NAME_BY_INDEX,
+                              WINHTTP_NO_OUTPUT_BUFFER, &size,
+                              WINHTTP_NO_HEADER_INDEX)) {
+        DWORD error = GetLastError();
+        if (error == ERROR_WINHTTP_HEADER_NOT_FOUND) {
+            return std::nullopt;
+        }
+
+        THROW_WIN32_IF(error, error != ERROR_INSUFFICIENT_BUFFER);
+    }
+
+    std::wstring value(size / sizeof(WCHAR), L'\0');
+    THROW_IF_WIN32_BOOL_FALSE(winhttp.QueryHeaders(
+        m_request, infoLevel, WINHTTP_HEADER_NAME_BY_INDEX, value.data(),
+        &size, WINHTTP_NO_HEADER_INDEX));
+    value.resize(size / sizeof(WCHAR));
+
+    return value;
+}
+
+std::optional<SYSTEMTIME> UrlRequest::GetHeaderTime(DWORD infoLevel) {
+    SYSTEMTIME time;
+    DWORD timeSize = sizeof(time);
+    if (!GetWinHttp().QueryHeaders(
+            m_request, infoLevel | WINHTTP_QUERY_FLAG_SYSTEMTIME,
+            WINHTTP_HEADER_NAME_BY_INDEX, &time, &timeSize,
+            WINHTTP_NO_HEADER_INDEX)) {
+        return std::nullopt;
+    }
+
+    return time;
+}
+
+size_t UrlRequest::Read(void* buffer, size_t size) {
+    DWORD read = 0;
+    THROW_IF_WIN32_BOOL_FALSE(GetWinHttp().ReadData(
+        m_request, buffer,
+        static_cast<DWORD>(std::min(size, static_cast<size_t>(MAXDWORD))),
+        &read));
+
+    return read;
+}
+
+size_t UrlRequest::ReadFull(void* buffer, size_t size) {
+    size_t total = 0;
+    while (total < size) {
+        size_t read = Read(static_cast<BYTE*>(buffer) + total, size - total);
+        if (read == 0) {
+            break;
+        }
+
+        total += read;
+    }
+
+    return total;
+}
+
+std::unique_ptr<char[]> UrlRequest::ReadToEnd(
+    size_t* length,
+    const std::function<bool()>& isCancelled) {
+    // WinHTTP keeps the Content-Encoding header of a body which it
+    // decompresses, and Content-Length is the compressed size in that case.
+    bool decompressed = false;
+    if (m_decompression) {
+        auto contentEncoding = GetHeader(WINHTTP_QUERY_CONTENT_ENCODING);
+        decompressed = contentEncoding && !contentEncoding->empty() &&
+                       _wcsicmp(contentEncoding->c_str(), L"identity") != 0;
+    }
+
+    return ResponseBody::ReadToEnd(
+        [this, &isCancelled](void* buffer, size_t size) {
+            THROW_WIN32_IF(ERROR_CANCELLED, isCancelled && isCancelled());
+            return Read(buffer, size);
+        },
+        ResponseBody::GetInitialCapacity(GetContentLength(), decompressed),
+        length);
+}
+
+void UrlRequest::Close() {
+    const auto& winhttp = GetWinHttp();
+
+    if (m_request) {
+        winhttp.CloseHandle(m_request);
+        m_request = nullptr;
+    }
+
+    if (m_connect) {
+        winhttp.CloseHandle(m_connect);
+        m_connect = nullptr;
+    }
+}
+
+namespace UrlContent {
+
+WH_URL_CONTENT* Get(PCWSTR url,
+                    const WH_GET_URL_CONTENT_OPTIONS& options,
+                    const std::function<bool()>& isCancelled) {
+    wil::unique_hfile targetFile;
+    if (!options.writeCallback && options.targetFilePath) {
+        targetFile.reset(CreateFile(options.targetFilePath, GENERIC_WRITE,
+                                    FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr));
+        THROW_LAST_ERROR_IF(!targetFile);
+    }
+
+    if (!options.writeCallback && !targetFile && options.useCache) {
+        return UrlCache::Get(url, isCancelled);
+    }
+
+    UrlRequest request(url);
+    int statusCode = request.GetStatusCode();
+
+    if (!options.writeCallback && !targetFile) {
+        size_t length;
+        auto data = request.ReadToEnd(&length, isCancelled);
+        return FromBuffer(statusCode, std::move(data), length);
+    }
+
+    size_t bufferSize =
+        options.bufferSize
+            ? std::min(options.bufferSize, static_cast<size_t>(MAXDWORD))
+            : kDefaultBufferSize;
+    auto buffer = std::make_unique_for_overwrite<BYTE[]>(bufferSize);
+
+    size_t downloadedTotal = 0;
+    while (true) {
+        THROW_WIN32_IF(ERROR_CANCELLED, isCancelled && isCancelled());
+
+        size_t read = request.ReadFull(buffer.get(), bufferSize);
+        if (read == 0) {
+            break;
+        }
+
+        if (options.writeCallback) {
+            THROW_WIN32_IF(ERROR_CANCELLED,
+                           !options.writeCallback(buffer.get(), read,
+                                                  options.writeCallbackParam));
+        } else {
+            DWORD written = 0;
+            THROW_IF_WIN32_BOOL_FALSE(
+                WriteFile(targetFile.get(), buffer.get(),
+                          static_cast<DWORD>(read), &written, nullptr));
+            THROW_WIN32_IF(ERROR_WRITE_FAULT, written != read);
+        }
+
+        downloadedTotal += read;
+
+        // A partial read means that the end of the content was reached.
+        if (read < bufferSize) {
+            break;
+        }
+    }
+
+    auto content = std::make_unique<WH_URL_CONTENT>();
+    content->data = nullptr;
+    content->length = downloadedTotal;
+    content->statusCode = statusCode;
+    return content.release();
+}
+
+WH_URL_CONTENT* FromBuffer(int statusCode,
+                           std::unique_ptr<char[]> data,
+                           size_t length) {
+    auto content = std::make_unique<WH_URL_CONTENT>();
+    content->data = data.release();
+    content->length = length;
+    content->statusCode = statusCode;
+    MemoryUsage::Add(MemoryUsage::Subsystem::kUrlContent, length + 1);
+    return content.release();
+}
+
+void Free(const WH_URL_CONTENT* content) {
+    if (content) {
+        if (content->data) {
+            MemoryUsage::Subtract(MemoryUsage::Subsystem::kUrlContent,
+                                  content->length + 1);
+        }
+
+        delete[] content->data;
+        delete content;
+    }
+}
+
+}  // namespace UrlContent
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "mods_api.h"
+
+// A synchronous HTTP GET request. winhttp.dll is loaded on first use instead of
+// being imported, since it might not be available in all cases, e.g. sandboxed
+// processes. Responses with gzip or deflate content encoding are decompressed
+// by WinHTTP if it supports it.
+class UrlRequest {
+   public:
+    // Sends the request and receives the response headers. The additional
+    // headers are separated by "\r\n". Throws on failure.
+    explicit UrlRequest(PCWSTR url, PCWSTR additionalHeaders = nullptr);
+    ~UrlRequest();
+
+    UrlRequest(const UrlRequest&) = delete;
+    UrlRequest& operator=(const UrlRequest&) = delete;
+
+    DWORD GetStatusCode();
+
+    // The Content-Length header value, if the server sent one. It's the size
+    // of the body as sent, which is the compressed size if the body is
+    // decompressed while it's read.
+    std::optional<DWORD> GetContentLength();
+
+    // A response header, e.g. WINHTTP_QUERY_ETAG, if the server sent it.
+    std::optional<std::wstring> GetHeader(DWORD infoLevel);
+    std::optional<SYSTEMTIME> GetHeaderTime(DWORD infoLevel);
+
+    // Reads the next part of the body, up to size bytes, directly into the
+    // buffer. Returns zero at the end of the body.
+    size_t Read(void* buffer, size_t size);
+
+    // Like Read, but only returns less than size bytes at the end of the body.
+    size_t ReadFull(void* buffer, size_t size);
+
+    // Reads the rest of the body into a single null-terminated buffer. If
+    // isCancelled is set, it's checked before each read, and the function
+    // fails with ERROR_CANCELLED once it returns true.
+    std::unique_ptr<char[]> ReadToEnd(
+        size_t* length,
+        const std::function<bool()>& isCancelled = nullptr);
+
+   private:
+    void Close();
+
+    HINTERNET m_connect = nullptr;
+    HINTERNET m_request = nullptr;
+    bool m_decompression = false;
+};
+
+// The implementation of Wh_GetUrlContent, after the options were resolved.
+namespace UrlContent {
+
+// Downloads the content to memory, to the write callback, or to the target
+// file, as described in WH_GET_URL_CONTENT_OPTIONS. If isCancelled is set,
+// it's checked before each read, and the download fails with ERROR_CANCELLED
+// once it returns true. Throws on failure.
+WH_URL_CONTENT* Get(PCWSTR url,
+                    const WH_GET_URL_CONTENT_OPTIONS& options,
+                    const std::function<bool()>& isCancelled = nullptr);
+
+// Takes ownership of a null-terminated buffer of the given length.
+WH_URL_CONTENT* FromBuffer(int statusCode,
+                           std::unique_ptr<char[]> data,
+                           size_t length);
+
+void Free(const WH_URL_CONTENT* content);
+
+}  // namespace UrlContent
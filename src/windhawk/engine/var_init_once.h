@@ -9,7 +9,7 @@
 #define STATIC_INIT_ONCE(T, var_name, ...)                                 \
     T* var_name;                                                           \
     do {                                                                   \
-        static alignas(T) char static_init_once_storage_[sizeof(T)];       \
+        alignas(T) static char static_init_once_storage_[sizeof(T)];       \
         static std::once_flag static_init_once_flag_;                      \
         std::call_once(static_init_once_flag_, []() {                      \
             new (static_init_once_storage_) T(__VA_ARGS__);                \
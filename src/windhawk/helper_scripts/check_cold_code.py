@@ -0,0 +1,301 @@
+"""
+Checks the placement of the cold engine code, which is grouped in the
+.text$zcold section, see the note in engine/mod.cpp, and measures how much of
+the engine code is resident in a process.
+
+With a linker map of windhawk.dll, which the Release configurations generate,
+reports:
+* The size of the default code section and of the cold code section.
+* The functions of the cold code which were placed in the default section
+  anyway, such as template instantiations over the lambdas of the cold
+  functions. The cold functions and classes are read from the code_seg regions
+  of the sources, and the whole code of symbol_enum.obj is cold.
+
+With --pid, which only works on Windows, also reports for a running process:
+* The private working set of the process.
+* The resident pages of the engine code, in the default and in the cold
+  section, and how many of them are private, e.g. after being patched.
+
+To compare builds, run the same scenario with each build, and compare the
+numbers, e.g. for an explorer.exe process with a mod which doesn't use the
+symbol APIs. Usage:
+
+python check_cold_code.py x64\\Release\\windhawk.map
+python check_cold_code.py x64\\Release\\windhawk.map --pid 1234
+"""
+
+import argparse
+import re
+import sys
+from dataclasses import dataclass
+from pathlib import Path
+
+ENGINE_DIR = Path(__file__).resolve().parent.parent / 'engine'
+
+COLD_SECTION = '.text$zcold'
+DEFAULT_SECTION = '.text$mn'
+COLD_OBJECTS = {'symbol_enum.obj'}
+COLD_REGION_SOURCES = ['mod.cpp', 'symbol_enum.cpp']
+
+PAGE_SIZE = 0x1000
+
+
+@dataclass
+class Contribution:
+    section: int
+    start: int
+    length: int
+    name: str
+
+
+@dataclass
+class Symbol:
+    section: int
+    offset: int
+    name: str
+    obj: str
+    is_function: bool
+    size: int = 0
+
+
+def parse_map(map_path: Path):
+    contributions = []
+    symbols = []
+    section_rvas = {}
+    preferred_base = 0
+
+    contribution_re = re.compile(
+        r'^\s*([0-9a-f]{4}):([0-9a-f]{8})\s+([0-9a-f]{8})H\s+(\S+)\s+\w+$',
+        re.IGNORECASE)
+    symbol_re = re.compile(
+        r'^\s*([0-9a-f]{4}):([0-9a-f]{8})\s+(\S+)\s+([0-9a-f]+)\s+(.*)$',
+        re.IGNORECASE)
+
+    for line in map_path.read_text(errors='replace').splitlines():
+        match = re.match(r'^\s*Preferred load address is ([0-9a-f]+)', line,
+                         re.IGNORECASE)
+        if match:
+            preferred_base = int(match.group(1), 16)
+            continue
+
+        match = contribution_re.match(line)
+        if match:
+            contributions.append(Contribution(
+                int(match.group(1), 16), int(match.group(2), 16),
+                int(match.group(3), 16), match.group(4)))
+            continue
+
+        match = symbol_re.match(line)
+        if match:
+            section = int(match.group(1), 16)
+            offset = int(match.group(2), 16)
+            rva = int(match.group(4), 16) - preferred_base
+            fields = match.group(5).split()
+            if section == 0 or not fields:
+                continue
+
+            section_rvas.setdefault(section, rva - offset)
+            symbols.append(Symbol(section, offset, match.group(3), fields[-1],
+                                  'f' in fields[:-1]))
+
+    # Sizes are estimated as the distance to the next symbol.
+    symbols.sort(key=lambda s: (s.section, s.offset))
+    for symbol, next_symbol in zip(symbols, symbols[1:]):
+        if next_symbol.section == symbol.section:
+            symbol.size = next_symbol.offset - symbol.offset
+
+    return contributions, symbols, section_rvas
+
+
+def find_contribution(contributions, section: int, offset: int):
+    for contribution in contributions:
+        if (contribution.section == section and
+                contribution.start <= offset <
+                contribution.start + contribution.length):
+            return contribution
+    return None
+
+
+def read_cold_names():
+    """Returns the decorated name fragments of the functions and classes which
+    are defined in the code_seg regions of the sources."""
+    definition_res = [
+        re.compile(r'^(?:class|struct)\s+(?:__declspec\(.*?\)\)\s+)?(\w+)'),
+        re.compile(r'^[^\s/#].*?\b(?:(\w+)::)?(\w+)\('),
+    ]
+
+    names = set()
+    for source in COLD_REGION_SOURCES:
+        in_region = False
+        for line in (ENGINE_DIR / source).read_text().splitlines():
+            if line.startswith('#pragma code_seg(push'):
+                in_region = True
+            elif line.startswith('#pragma code_seg(pop'):
+                in_region = False
+            elif in_region:
+                match = definition_res[0].match(line)
+                if match:
+                    names.add(f'{match.group(1)}@')
+                    continue
+
+                match = definition_res[1].match(line)
+                if match and match.group(2) not in ('if', 'for', 'while'):
+                    if match.group(1):
+                        names.add(f'{match.group(2)}@{match.group(1)}@@')
+                    else:
+                        names.add(f'?{match.group(2)}@')
+
+    return names
+
+
+def is_cold_symbol(symbol: Symbol, cold_names):
+    if symbol.obj in COLD_OBJECTS:
+        return True
+    return any(name in symbol.name for name in cold_names)
+
+
+def report_map(contributions, symbols):
+    sizes = {}
+    for contribution in contributions:
+        sizes[contribution.name] = (sizes.get(contribution.name, 0) +
+                                    contribution.length)
+
+    for name in [DEFAULT_SECTION, COLD_SECTION]:
+        print(f'{name:<16} {sizes.get(name, 0) / 1024:>8.1f} KB')
+
+    cold_names = read_cold_names()
+    misplaced = []
+    for symbol in symbols:
+        if not symbol.is_function or not is_cold_symbol(symbol, cold_names):
+            continue
+
+        contribution = find_contribution(contributions, symbol.section,
+                                         symbol.offset)
+        if contribution and contribution.name == DEFAULT_SECTION:
+            misplaced.append(symbol)
+
+    print()
+    print(f'Cold functions in {DEFAULT_SECTION}: {len(misplaced)}, '
+          f'{sum(s.size for s in misplaced) / 1024:.1f} KB')
+    for symbol in sorted(misplaced, key=lambda s: -s.size):
+        print(f'{symbol.size:>8} {symbol.obj:<20} {symbol.name}')
+
+
+def get_code_ranges(contributions, section_rvas):
+    """Returns the RVA ranges of the default and of the cold code, rounded
+    to pages, since a page which is shared by both is hot."""
+    ranges = {DEFAULT_SECTION: [], COLD_SECTION: []}
+    for contribution in contributions:
+        if contribution.name in ranges and contribution.length > 0:
+            start = section_rvas[contribution.section] + contribution.start
+            ranges[contribution.name].append(
+                (start, start + contribution.length))
+
+    hot_pages = set()
+    for start, end in ranges[DEFAULT_SECTION]:
+        hot_pages.update(range(start // PAGE_SIZE,
+                               (end + PAGE_SIZE - 1) // PAGE_SIZE))
+
+    cold_pages = set()
+    for start, end in ranges[COLD_SECTION]:
+        cold_pages.update(range(start // PAGE_SIZE,
+                                (end + PAGE_SIZE - 1) // PAGE_SIZE))
+
+    return hot_pages, cold_pages - hot_pages
+
+
+def report_process(pid: int, contributions, section_rvas):
+    import ctypes
+    from ctypes import wintypes
+
+    PROCESS_QUERY_INFORMATION = 0x0400
+    PROCESS_VM_READ = 0x0010
+    LIST_MODULES_ALL = 0x03
+    ERROR_BAD_LENGTH = 24
+
+    kernel32 = ctypes.WinDLL('kernel32', use_last_error=True)
+    psapi = ctypes.WinDLL('psapi', use_last_error=True)
+    kernel32.OpenProcess.restype = wintypes.HANDLE
+    kernel32.OpenProcess.argtypes = [wintypes.DWORD, wintypes.BOOL,
+                                     wintypes.DWORD]
+    kernel32.CloseHandle.argtypes = [wintypes.HANDLE]
+    psapi.EnumProcessModulesEx.argtypes = [
+        wintypes.HANDLE, ctypes.POINTER(ctypes.c_void_p), wintypes.DWORD,
+        ctypes.POINTER(wintypes.DWORD), wintypes.DWORD]
+    psapi.GetModuleBaseNameW.argtypes = [wintypes.HANDLE, ctypes.c_void_p,
+                                         wintypes.LPWSTR, wintypes.DWORD]
+    psapi.QueryWorkingSet.argtypes = [wintypes.HANDLE, ctypes.c_void_p,
+                                      wintypes.DWORD]
+
+    process = kernel32.OpenProcess(
+        PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, False, pid)
+    if not process:
+        raise ctypes.WinError(ctypes.get_last_error())
+
+    try:
+        modules = (ctypes.c_void_p * 1024)()
+        needed = wintypes.DWORD()
+        if not psapi.EnumProcessModulesEx(process, modules,
+                                          ctypes.sizeof(modules),
+                                          ctypes.byref(needed),
+                                          LIST_MODULES_ALL):
+            raise ctypes.WinError(ctypes.get_last_error())
+
+        engine_base = None
+        name = ctypes.create_unicode_buffer(260)
+        for module in modules[:needed.value // ctypes.sizeof(ctypes.c_void_p)]:
+            if (psapi.GetModuleBaseNameW(process, module, name, len(name)) and
+                    name.value.lower() == 'windhawk.dll'):
+                engine_base = module
+                break
+
+        if engine_base is None:
+            sys.exit(f'windhawk.dll is not loaded in process {pid}')
+
+        entry_count = 0x10000
+        while True:
+            buffer = (ctypes.c_size_t * (entry_count + 1))()
+            if psapi.QueryWorkingSet(process, buffer, ctypes.sizeof(buffer)):
+                break
+            if ctypes.get_last_error() != ERROR_BAD_LENGTH:
+                raise ctypes.WinError(ctypes.get_last_error())
+            entry_count = buffer[0] + 0x1000
+    finally:
+        kernel32.CloseHandle(process)
+
+    # Each entry has the page number in the high bits, and the shared flag
+    # in bit 8.
+    pages = {}
+    for entry in buffer[1:buffer[0] + 1]:
+        pages[entry // PAGE_SIZE] = bool(entry & 0x100)
+
+    private_count = sum(1 for shared in pages.values() if not shared)
+    print(f'Private working set: {private_count * PAGE_SIZE / 1024:.0f} KB')
+
+    base_page = engine_base // PAGE_SIZE
+    hot_pages, cold_pages = get_code_ranges(contributions, section_rvas)
+    for label, code_pages in [('default', hot_pages), ('cold', cold_pages)]:
+        resident = [base_page + page for page in code_pages
+                    if base_page + page in pages]
+        private = [page for page in resident if not pages[page]]
+        print(f'Engine {label} code: {len(resident)} of {len(code_pages)} '
+              f'pages resident, {len(private)} private')
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Check the placement of the cold engine code.')
+    parser.add_argument('map_path', type=Path)
+    parser.add_argument('--pid', type=int)
+    args = parser.parse_args()
+
+    contributions, symbols, section_rvas = parse_map(args.map_path)
+    report_map(contributions, symbols)
+
+    if args.pid is not None:
+        print()
+        report_process(args.pid, contributions, section_rvas)
+
+
+if __name__ == '__main__':
+    main()
@@ -21,6 +21,18 @@ void LoggerBase::VLogLine(PCWSTR format, va_list args) {
         len = _countof(buffer) - 1;
     }
 
+    OutputLine(buffer, len);
+}
+
+void LoggerBase::LogLine(PCWSTR format, ...) {
+    va_list args;
+    va_start(args, format);
+    VLogLine(format, args);
+    va_end(args);
+}
+
+// static
+void LoggerBase::OutputLine(PWSTR buffer, int len) {
     while (--len >= 0 && buffer[len] == L'\n') {
         // Skip all newlines at the end.
     }
@@ -32,10 +44,3 @@ void LoggerBase::VLogLine(PCWSTR format, va_list args) {
 
     OutputDebugString(buffer);
 }
-
-void LoggerBase::LogLine(PCWSTR format, ...) {
-    va_list args;
-    va_start(args, format);
-    VLogLine(format, args);
-    va_end(args);
-}
@@ -17,6 +17,11 @@ class LoggerBase {
     void VLogLine(PCWSTR format, va_list args);
     void LogLine(PCWSTR format, ...);
 
+   protected:
+    // Outputs a formatted line of the given length, leaving at most a single
+    // trailing newline. The buffer must be null-terminated.
+    static void OutputLine(PWSTR buffer, int len);
+
    private:
     std::atomic<Verbosity> m_verbosity = kDefaultVerbosity;
 };
@@ -0,0 +1,322 @@
+#pragma once
+
+// A fixed-size table of mod status slots, placed in memory which is shared
+// between the session manager, the engine instances which are loaded in target
+// processes, and the app. Each slot is published with a seqlock: writers never
+// wait for readers, and readers retry instead of observing a torn value. The
+// slot generation is incremented each time a slot is claimed, which allows
+// readers to tell a reused slot apart from an updated one, and keeps a slot
+// from being reclaimed on the basis of a stale read.
+//
+// Only the standard library is used here, the Windows specific parts (the file
+// mapping, the change events) are implemented by the engine and the app.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+namespace ModStatusTable {
+
+template <typename T>
+class Slot {
+   public:
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(std::atomic<uint32_t>::is_always_lock_free);
+    static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+    enum class ReadResult {
+        kFree,
+        kValid,
+        kBusy,
+    };
+
+    struct Ownership {
+        uint32_t owner;
+        uint32_t generation;
+    };
+
+    struct Snapshot {
+        uint32_t owner;
+        uint32_t generation;
+        T value;
+    };
+
+    // An owner value which is never used by a real owner, set while a slot of
+    // a terminated owner is being released by someone else.
+    static constexpr uint32_t kReclaimingOwner = 0xFFFFFFFF;
+
+    // The owner and the generation are changed together, so that they can be
+    // read without the sequence counter, e.g. if the slot stays busy.
+    Ownership GetOwnership() const {
+        return Unpack(m_ownership.load(std::memory_order_acquire));
+    }
+
+    bool TryClaim(uint32_t owner) {
+        uint64_t ownership = m_ownership.load(std::memory_order_relaxed);
+        if (Unpack(ownership).owner != 0) {
+            return false;
+        }
+
+        // The slot stays inactive until the first value is published, since
+        // it's deactivated before being released or reclaimed.
+        uint32_t generation = Unpack(ownership).generation + 1;
+        return m_ownership.compare_exchange_strong(
+            ownership, Pack({owner, generation}), std::memory_order_acq_rel);
+    }
+
+    // Must only be called by the slot owner. Concurrent calls from several
+    // threads of the owner are serialized by the sequence counter.
+    void Publish(const T& value) {
+        uint32_t words[kWordCount]{};
+        memcpy(words, &value, sizeof(T));
+
+        uint32_t sequence = BeginWrite();
+        for (size_t i = 0; i < kWordCount; i++) {
+            m_data[i].store(words[i], std::memory_order_relaxed);
+        }
+        m_active.store(1, std::memory_order_relaxed);
+        EndWrite(sequence);
+    }
+
+    // Must only be called by the slot owner.
+    void Release() {
+        uint32_t sequence = BeginWrite();
+        m_active.store(0, std::memory_order_relaxed);
+        EndWrite(sequence);
+
+        Ownership ownership = GetOwnership();
+        m_ownership.store(Pack({0, ownership.generation}),
+                          std::memory_order_release);
+    }
+
+    // Releases a slot on behalf of an owner which is known to be gone, such as
+    // a process which was terminated without releasing its slots. The owner
+    // might have been terminated in the middle of a write, so the sequence
+    // counter isn't waited for. The generation makes sure that a slot which
+    // was released and claimed again by the same owner since it was read
+    // isn't reclaimed.
+    bool TryReclaim(uint32_t owner, uint32_t generation) {
+        uint64_t expected = Pack({owner, generation});
+        if (!m_ownership.compare_exchange_strong(
+                expected, Pack({kReclaimingOwner, generation}),
+                std::memory_order_acq_rel)) {
+            return false;
+        }
+
+        uint32_t sequence = m_sequence.load(std::memory_order_relaxed) | 1;
+        m_sequence.store(sequence, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_active.store(0, std::memory_order_relaxed);
+        EndWrite(sequence - 1);
+
+        m_ownership.store(Pack({0, generation}), std::memory_order_release);
+        return true;
+    }
+
+    ReadResult Read(Snapshot* snapshot, int maxAttempts = 64) const {
+        for (int attempt = 0; attempt < maxAttempts; attempt++) {
+            if (GetOwnership().owner == 0) {
+                return ReadResult::kFree;
+            }
+
+            uint32_t sequenceBefore =
+                m_sequence.load(std::memory_order_acquire);
+            if (sequenceBefore & 1) {
+                continue;
+            }
+
+            Ownership ownership =
+                Unpack(m_ownership.load(std::memory_order_relaxed));
+            uint32_t active = m_active.load(std::memory_order_relaxed);
+
+            uint32_t words[kWordCount];
+            for (size_t i = 0; i < kWordCount; i++) {
+                words[i] = m_data[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_sequence.load(std::memory_order_relaxed) != sequenceBefore) {
+                continue;
+            }
+
+            if (!active) {
+                return ReadResult::kFree;
+            }
+
+            snapshot->owner = ownership.owner;
+            snapshot->generation = ownership.generation;
+            memcpy(&snapshot->value, words, sizeof(T));
+            return ReadResult::kValid;
+        }
+
+        return ReadResult::kBusy;
+    }
+
+   private:
+    static constexpr size_t kWordCount =
+        (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    uint32_t BeginWrite() {
+        uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+        while (true) {
+            if (!(sequence & 1) &&
+                m_sequence.compare_exchange_weak(sequence, sequence + 1,
+                                                 std::memory_order_relaxed)) {
+                break;
+            }
+
+            sequence = m_sequence.load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_release);
+        return sequence;
+    }
+
+    void EndWrite(uint32_t sequence) {
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    static uint64_t Pack(Ownership ownership) {
+        return static_cast<uint64_t>(ownership.generation) << 32 |
+               ownership.owner;
+    }
+
+    static Ownership Unpack(uint64_t ownership) {
+        return {static_cast<uint32_t>(ownership),
+                static_cast<uint32_t>(ownership >> 32)};
+    }
+
+    // The owner in the low half, the generation in the high half.
+    std::atomic<uint64_t> m_ownership;
+    std::atomic<uint32_t> m_sequence;
+    std::atomic<uint32_t> m_active;
+    std::atomic<uint32_t> m_data[kWordCount];
+};
+
+template <typename T, uint32_t kSlotCount>
+class Table {
+   public:
+    using SlotType = Slot<T>;
+
+    static constexpr uint32_t kMagic = 0x5453484D;  // 'MHST'
+
+    // Must be called once, by the creator of the table, on zeroed memory.
+    void Initialize(uint32_t version) {
+        m_version = version;
+        m_slotCount = kSlotCount;
+        m_slotSize = sizeof(SlotType);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_magic = kMagic;
+    }
+
+    bool IsCompatible(uint32_t version) const {
+        return m_magic == kMagic && m_version == version &&
+               m_slotCount == kSlotCount && m_slotSize == sizeof(SlotType);
+    }
+
+    // Returns the index of the claimed slot, or -1 if the table is full. Slots
+    // are claimed first-fit to keep the used part of the table compact.
+    int Claim(uint32_t owner) {
+        for (uint32_t i = 0; i < kSlotCount; i++) {
+            if (!m_slots[i].TryClaim(owner)) {
+                continue;
+            }
+
+            uint32_t usedCount = m_usedCount.load(std::memory_order_relaxed);
+            while (usedCount < i + 1 &&
+                   !m_usedCount.compare_exchange_weak(
+                       usedCount, i + 1, std::memory_order_release)) {
+            }
+
+            return static_cast<int>(i);
+        }
+
+        return -1;
+    }
+
+    SlotType& GetSlot(int index) { return m_slots[index]; }
+    const SlotType& GetSlot(int index) const { return m_slots[index]; }
+
+    // All claimed slots are below this index. The value never decreases, so
+    // readers don't have to scan the whole table.
+    uint32_t GetUsedCount() const {
+        return m_usedCount.load(std::memory_order_acquire);
+    }
+
+    void NotifyChanged() {
+        m_changeCounter.fetch_add(1, std::memory_order_release);
+    }
+
+    uint32_t GetChangeCounter() const {
+        return m_changeCounter.load(std::memory_order_acquire);
+    }
+
+   private:
+    uint32_t m_magic;
+    uint32_t m_version;
+    uint32_t m_slotCount;
+    uint32_t m_slotSize;
+    std::atomic<uint32_t> m_usedCount;
+    std::atomic<uint32_t> m_changeCounter;
+    SlotType m_slots[kSlotCount];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// The session table layout, shared by the engine and the app.
+
+constexpr uint32_t kVersion = 2;
+
+// Enough for 300 processes with 15 mods each, times two categories, plus an
+// engine memory entry per process, with room to spare.
+constexpr uint32_t kSlotCount = 12288;
+
+constexpr size_t kModNameMaxLen = 79;
+constexpr size_t kProcessNameMaxLen = 79;
+constexpr size_t kValueMaxLen = 159;
+
+// Object names, relative to the session private namespace.
+inline constexpr wchar_t kFileMappingName[] = L"ModStatusTable";
+inline constexpr wchar_t kModStatusChangedEventName[] =
+    L"ModStatusTableChanged-mod-status";
+inline constexpr wchar_t kModTaskChangedEventName[] =
+    L"ModStatusTableChanged-mod-task";
+
+enum class Category : uint32_t {
+    kModStatus = 1,
+    kModTask,
+    // One entry per process, with an empty mod name. Changes aren't signaled
+    // with an event, the value is a snapshot which is meant to be polled.
+    kEngineMemory,
+};
+
+// The value of kEngineMemory entries: the amount of bytes used by each engine
+// subsystem, as comma-separated decimal numbers in this order.
+inline constexpr const wchar_t* kEngineMemoryFieldNames[] = {
+    L"trampolines", L"symbols",     L"mods",
+    L"settings",    L"url_content", L"logging",
+};
+
+struct Entry {
+    Category category;
+    uint32_t processId;
+    uint64_t processCreationTime;
+    // The time the value was first set, as a FILETIME value.
+    uint64_t creationTime;
+    wchar_t modName[kModNameMaxLen + 1];
+    wchar_t processName[kProcessNameMaxLen + 1];
+    wchar_t value[kValueMaxLen + 1];
+};
+
+using SessionTable = Table<Entry, kSlotCount>;
+
+template <size_t N>
+void CopyString(wchar_t (&destination)[N], std::wstring_view source) {
+    size_t length = source.length() < N - 1 ? source.length() : N - 1;
+    memcpy(destination, source.data(), length * sizeof(wchar_t));
+    destination[length] = L'\0';
+}
+
+}  // namespace ModStatusTable
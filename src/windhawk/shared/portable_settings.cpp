@@ -71,7 +71,7 @@ PortableSettings::EnumIterator<Type>::~EnumIterator() = default;
 
 template <typename Type>
 PortableSettings::EnumIterator<Type>::operator bool() const {
-    return impl->is_done();
+    return !impl->is_done();
 }
 
 template <typename Type>
@@ -0,0 +1,302 @@
+#pragma once
+
+// A ring of log records, placed in memory which is shared between the engine
+// instances which are loaded in target processes, and any number of readers,
+// such as the app. Writers never wait: a writer reserves consecutive tickets
+// with a single atomic add, and each ticket maps to a slot which is published
+// with a seqlock. Readers keep their own cursor, and old records are
+// overwritten when a reader falls behind, in which case the reader counts them
+// as lost.
+//
+// A writer which is terminated in the middle of a write leaves its slot busy
+// until a writer of the next lap takes it over. Readers skip such a slot after
+// it stays pending for a while (see Reader::SkipPending).
+//
+// Only the standard library is used here, the Windows specific parts (the file
+// mapping, the session lookup) are implemented by the engine and the app.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "ticket_ring_slot.h"
+
+namespace SessionLogRing {
+
+constexpr uint32_t kVersion = 2;
+
+// 1 MB in total.
+constexpr uint32_t kSlotCount = 2048;
+
+constexpr size_t kChannelMaxLen = 63;
+constexpr size_t kTextMaxLen = 1024;
+
+// Object names, relative to the session private namespace.
+inline constexpr wchar_t kFileMappingName[] = L"SessionLogRing";
+
+enum class Severity : uint32_t {
+    kInfo = 1,
+    kVerbose,
+};
+
+struct Record {
+    uint32_t processId;
+    uint32_t threadId;
+    // A FILETIME value.
+    uint64_t timestamp;
+    Severity severity;
+    // The mod name for mod logs, empty for engine logs.
+    wchar_t channel[kChannelMaxLen + 1];
+    wchar_t text[kTextMaxLen + 1];
+};
+
+// Each slot holds a part of a record, the first part starts with a header.
+struct Part {
+    static constexpr size_t kWordCount = 125;
+    static constexpr size_t kPayloadSize = kWordCount * sizeof(uint32_t);
+
+    uint32_t index;
+    uint32_t count;
+    uint32_t words[kWordCount];
+};
+
+using Slot = TicketRing::Slot<Part>;
+
+// The serialized form of a record, split into the slot payloads.
+struct RecordHeader {
+    uint32_t processId;
+    uint32_t threadId;
+    uint64_t timestamp;
+    Severity severity;
+    uint16_t channelLength;
+    uint16_t textLength;
+};
+
+constexpr size_t kRecordMaxSize =
+    sizeof(RecordHeader) + (kChannelMaxLen + kTextMaxLen) * sizeof(wchar_t);
+constexpr uint32_t kRecordMaxSlotCount =
+    (kRecordMaxSize + Part::kPayloadSize - 1) / Part::kPayloadSize;
+
+template <uint32_t kSlotCount>
+class Ring {
+    static_assert(kSlotCount > kRecordMaxSlotCount &&
+                      (kSlotCount & (kSlotCount - 1)) == 0,
+                  "The slot count must be a power of two");
+
+   public:
+    static constexpr uint32_t kMagic = 0x474C4853;  // 'SHLG'
+
+    // Must be called once, by the creator of the ring, on zeroed memory.
+    void Initialize(uint32_t version) {
+        m_version = version;
+        m_slotCount = kSlotCount;
+        m_slotSize = sizeof(Slot);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_magic = kMagic;
+    }
+
+    bool IsCompatible(uint32_t version) const {
+        return m_magic == kMagic && m_version == version &&
+               m_slotCount == kSlotCount && m_slotSize == sizeof(Slot);
+    }
+
+    // Returns false if a part of the record was dropped because its slot was
+    // busy. Longer strings are truncated.
+    bool Write(uint32_t processId,
+               uint32_t threadId,
+               uint64_t timestamp,
+               Severity severity,
+               std::wstring_view channel,
+               std::wstring_view text) {
+        channel = channel.substr(0, kChannelMaxLen);
+        text = text.substr(0, kTextMaxLen);
+
+        RecordHeader header{
+            .processId = processId,
+            .threadId = threadId,
+            .timestamp = timestamp,
+            .severity = severity,
+            .channelLength = static_cast<uint16_t>(channel.length()),
+            .textLength = static_cast<uint16_t>(text.length()),
+        };
+
+        std::byte buffer[kRecordMaxSlotCount * Part::kPayloadSize]{};
+        size_t size = 0;
+        memcpy(buffer + size, &header, sizeof(header));
+        size += sizeof(header);
+        memcpy(buffer + size, channel.data(),
+               channel.length() * sizeof(wchar_t));
+        size += channel.length() * sizeof(wchar_t);
+        memcpy(buffer + size, text.data(), text.length() * sizeof(wchar_t));
+        size += text.length() * sizeof(wchar_t);
+
+        uint32_t count = static_cast<uint32_t>(
+            (size + Part::kPayloadSize - 1) / Part::kPayloadSize);
+
+        uint64_t firstTicket =
+            m_writeIndex.fetch_add(count, std::memory_order_relaxed);
+
+        bool written = true;
+        for (uint32_t i = 0; i < count; i++) {
+            Part part{
+                .index = i,
+                .count = count,
+            };
+            memcpy(part.words, buffer + i * Part::kPayloadSize,
+                   Part::kPayloadSize);
+
+            uint64_t ticket = firstTicket + i;
+            if (!m_slots[ticket % kSlotCount].TryWrite(ticket, part)) {
+                written = false;
+            }
+        }
+
+        return written;
+    }
+
+    uint64_t GetWriteIndex() const {
+        return m_writeIndex.load(std::memory_order_acquire);
+    }
+
+    const Slot& GetSlot(uint64_t ticket) const {
+        return m_slots[ticket % kSlotCount];
+    }
+
+   private:
+    uint32_t m_magic;
+    uint32_t m_version;
+    uint32_t m_slotCount;
+    uint32_t m_slotSize;
+    alignas(64) std::atomic<uint64_t> m_writeIndex;
+    alignas(64) Slot m_slots[kSlotCount];
+};
+
+template <uint32_t kSlotCount>
+class Reader {
+   public:
+    enum class ReadResult {
+        kRecord,
+        kEmpty,
+        kPending,
+    };
+
+    // Starts reading at the records which will be written from now on.
+    explicit Reader(const Ring<kSlotCount>& ring)
+        : m_ring(ring), m_cursor(ring.GetWriteIndex()) {}
+
+    // Returns kPending if the next record is still being written. If it stays
+    // pending, its writer might have been terminated, and SkipPending can be
+    // used to move on.
+    ReadResult Read(Record* record) {
+        while (true) {
+            uint64_t writeIndex = m_ring.GetWriteIndex();
+            if (m_cursor >= writeIndex) {
+                return ReadResult::kEmpty;
+            }
+
+            if (writeIndex - m_cursor > kSlotCount) {
+                m_lostCount += writeIndex - m_cursor - kSlotCount;
+                m_cursor = writeIndex - kSlotCount;
+            }
+
+            std::byte buffer[kRecordMaxSlotCount * Part::kPayloadSize];
+            Part part;
+
+            auto result = m_ring.GetSlot(m_cursor).Read(m_cursor, &part);
+            if (result == Slot::ReadResult::kPending) {
+                return ReadResult::kPending;
+            }
+
+            if (result == Slot::ReadResult::kOverwritten) {
+                m_lostCount++;
+                m_cursor++;
+                continue;
+            }
+
+            if (part.index != 0 || part.count == 0 ||
+                part.count > kRecordMaxSlotCount) {
+                // The rest of a record whose first part was lost.
+                m_cursor++;
+                continue;
+            }
+
+            uint32_t count = part.count;
+            memcpy(buffer, part.words, Part::kPayloadSize);
+
+            uint32_t i;
+            for (i = 1; i < count; i++) {
+                uint64_t ticket = m_cursor + i;
+                result = m_ring.GetSlot(ticket).Read(ticket, &part);
+                if (result != Slot::ReadResult::kValid || part.index != i) {
+                    break;
+                }
+
+                memcpy(buffer + i * Part::kPayloadSize, part.words,
+                       Part::kPayloadSize);
+            }
+
+            if (i < count) {
+                if (result == Slot::ReadResult::kPending) {
+                    return ReadResult::kPending;
+                }
+
+                m_lostCount++;
+                m_cursor += i;
+                continue;
+            }
+
+            m_cursor += count;
+
+            RecordHeader header;
+            memcpy(&header, buffer, sizeof(header));
+            if (header.channelLength > kChannelMaxLen ||
+                header.textLength > kTextMaxLen) {
+                m_lostCount++;
+                continue;
+            }
+
+            record->processId = header.processId;
+            record->threadId = header.threadId;
+            record->timestamp = header.timestamp;
+            record->severity = header.severity;
+
+            size_t offset = sizeof(header);
+            memcpy(record->channel, buffer + offset,
+                   header.channelLength * sizeof(wchar_t));
+            record->channel[header.channelLength] = L'\0';
+            offset += header.channelLength * sizeof(wchar_t);
+
+            memcpy(record->text, buffer + offset,
+                   header.textLength * sizeof(wchar_t));
+            record->text[header.textLength] = L'\0';
+
+            return ReadResult::kRecord;
+        }
+    }
+
+    void SkipPending() {
+        if (m_cursor < m_ring.GetWriteIndex()) {
+            m_lostCount++;
+            m_cursor++;
+        }
+    }
+
+    // The number of slots which were overwritten before they were read, or
+    // were dropped by their writer. A record takes one or more slots.
+    uint64_t GetLostSlotCount() const { return m_lostCount; }
+
+   private:
+    const Ring<kSlotCount>& m_ring;
+    uint64_t m_cursor;
+    uint64_t m_lostCount = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// The session ring layout, shared by the engine and the app.
+
+using SessionRing = Ring<kSlotCount>;
+using SessionReader = Reader<kSlotCount>;
+
+}  // namespace SessionLogRing
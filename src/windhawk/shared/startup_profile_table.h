@@ -0,0 +1,149 @@
+#pragma once
+
+// A ring of startup profile records, placed in memory which is shared between
+// the engine instances which are loaded in target processes and the app. Each
+// engine instance writes a record with the duration of its startup phases once
+// the mods are active, and a record for each mod which was loaded on startup.
+// The app aggregates the records, e.g. by process name.
+//
+// Writers never wait: a writer claims a ticket with a single atomic add, and
+// the slot of the ticket is published with a seqlock, see ticket_ring_slot.h.
+// When the ring is full, the oldest records are overwritten.
+//
+// Only the standard library is used here, the Windows specific parts (the file
+// mapping, the session lookup) are implemented by the engine and the app.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "ticket_ring_slot.h"
+
+namespace StartupProfileTable {
+
+template <typename T, uint32_t kSlotCount>
+class Ring {
+   public:
+    using SlotType = TicketRing::Slot<T>;
+
+    static constexpr uint32_t kMagic = 0x50534857;  // 'WHSP'
+
+    // Must be called once, by the creator of the ring, on zeroed memory.
+    void Initialize(uint32_t version) {
+        m_version = version;
+        m_slotCount = kSlotCount;
+        m_slotSize = sizeof(SlotType);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_magic = kMagic;
+    }
+
+    bool IsCompatible(uint32_t version) const {
+        return m_magic == kMagic && m_version == version &&
+               m_slotCount == kSlotCount && m_slotSize == sizeof(SlotType);
+    }
+
+    // Returns false if the record was dropped because its slot was busy.
+    bool Write(const T& value) {
+        uint64_t ticket = m_writeIndex.fetch_add(1, std::memory_order_relaxed);
+        return m_slots[ticket % kSlotCount].TryWrite(ticket, value);
+    }
+
+    // Calls callback(const T&) for each record in the ring, oldest first.
+    template <typename Callback>
+    void ForEach(Callback callback) const {
+        uint64_t writeIndex = m_writeIndex.load(std::memory_order_acquire);
+        uint64_t first = writeIndex > kSlotCount ? writeIndex - kSlotCount : 0;
+        for (uint64_t ticket = first; ticket < writeIndex; ticket++) {
+            T value;
+            if (m_slots[ticket % kSlotCount].Read(ticket, &value) ==
+                SlotType::ReadResult::kValid) {
+                callback(value);
+            }
+        }
+    }
+
+   private:
+    uint32_t m_magic;
+    uint32_t m_version;
+    uint32_t m_slotCount;
+    uint32_t m_slotSize;
+    alignas(8) std::atomic<uint64_t> m_writeIndex;
+    SlotType m_slots[kSlotCount];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// The session ring layout, shared by the engine and the app.
+
+constexpr uint32_t kVersion = 2;
+
+constexpr uint32_t kSlotCount = 2048;
+
+constexpr size_t kModNameMaxLen = 79;
+constexpr size_t kProcessNameMaxLen = 79;
+
+// Object names, relative to the session private namespace.
+inline constexpr wchar_t kFileMappingName[] = L"StartupProfileTable";
+
+enum class Kind : uint32_t {
+    kProcess = 1,
+    kMod,
+};
+
+// The startup phases of the engine in a process, in order.
+enum class ProcessPhase : uint32_t {
+    // From the injection until the engine's DllMain. Includes the remote
+    // thread or APC startup, the shellcode, and most of LoadLibraryW.
+    kInjection,
+    // From DllMain until InjectInit is called by the shellcode.
+    kEngineLoad,
+    // From InjectInit until the customization session is constructed.
+    kSessionStart,
+    kPrivateNamespace,
+    kHookEngineInit,
+    // Loading and initializing all mods, see ModPhase.
+    kModsLoad,
+    // Applying the queued hooks, MH_ApplyQueuedEx.
+    kHooksApply,
+    kAfterInit,
+
+    kCount,
+};
+
+enum class ModPhase : uint32_t {
+    // Loading the mod library.
+    kLoad,
+    // Wh_ModInit, including the symbol resolution below.
+    kInitialize,
+    // Time spent in the symbol APIs, e.g. Wh_HookSymbols, which are mostly
+    // used in Wh_ModInit.
+    kSymbols,
+    kAfterInit,
+
+    kCount,
+};
+
+constexpr size_t kMaxPhaseCount = 8;
+static_assert(static_cast<size_t>(ProcessPhase::kCount) <= kMaxPhaseCount);
+static_assert(static_cast<size_t>(ModPhase::kCount) <= kMaxPhaseCount);
+
+// A phase which wasn't reached or wasn't measured.
+constexpr uint32_t kNoDuration = 0xFFFFFFFF;
+
+struct Entry {
+    Kind kind;
+    uint32_t processId;
+    uint64_t processCreationTime;
+    // The time the record was written, as a FILETIME value.
+    uint64_t recordTime;
+    // VER_FILE_VERSION_LONG of the engine.
+    uint32_t engineVersion;
+    // In microseconds, or kNoDuration.
+    uint32_t durations[kMaxPhaseCount];
+    wchar_t processName[kProcessNameMaxLen + 1];
+    // Empty for process records.
+    wchar_t modName[kModNameMaxLen + 1];
+};
+
+using SessionRing = Ring<Entry, kSlotCount>;
+
+}  // namespace StartupProfileTable
@@ -0,0 +1,118 @@
+#pragma once
+
+// A slot of a ring in shared memory, in which writers reserve tickets with an
+// atomic add, and each ticket maps to a slot. Writers never wait, and readers
+// retry instead of observing a torn value. Used by the session log ring and the
+// startup profile ring.
+//
+// The slot state is 2 * ticket + 1 while the ticket is being written, and
+// 2 * ticket + 2 once it's written.
+//
+// A writer which is terminated or suspended in the middle of a write leaves the
+// slot state odd. A writer of a later ticket of the same slot, which is at
+// least a full lap of the ring ahead, takes the slot over. If the earlier
+// writer resumes, it can't publish its ticket anymore, but its remaining
+// stores might still land in the slot. A checksum of the ticket and the value
+// lets readers reject such a mixed value.
+//
+// Only the standard library is used here.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace TicketRing {
+
+template <typename T>
+class Slot {
+   public:
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(std::atomic<uint32_t>::is_always_lock_free);
+    static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+    enum class ReadResult {
+        kValid,
+        // The ticket wasn't written yet, or is being written.
+        kPending,
+        // The slot was reused for a later ticket, or the value was mixed with
+        // a write of a stalled writer.
+        kOverwritten,
+    };
+
+    // Returns false if the slot was already reused for a later ticket, or if
+    // it was taken over by a later ticket during the write.
+    bool TryWrite(uint64_t ticket, const T& value) {
+        uint64_t writingState = ticket * 2 + 1;
+
+        uint64_t state = m_state.load(std::memory_order_relaxed);
+        do {
+            if (state >= writingState) {
+                return false;
+            }
+        } while (!m_state.compare_exchange_weak(state, writingState,
+                                                std::memory_order_relaxed));
+
+        std::atomic_thread_fence(std::memory_order_release);
+
+        uint32_t words[kWordCount]{};
+        memcpy(words, &value, sizeof(T));
+        for (size_t i = 0; i < kWordCount; i++) {
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+        m_checksum.store(Checksum(ticket, words), std::memory_order_relaxed);
+
+        return m_state.compare_exchange_strong(writingState, ticket * 2 + 2,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed);
+    }
+
+    ReadResult Read(uint64_t ticket, T* value) const {
+        uint64_t stateBefore = m_state.load(std::memory_order_acquire);
+        if (stateBefore < ticket * 2 + 2) {
+            return ReadResult::kPending;
+        }
+
+        if (stateBefore > ticket * 2 + 2) {
+            return ReadResult::kOverwritten;
+        }
+
+        uint32_t words[kWordCount];
+        for (size_t i = 0; i < kWordCount; i++) {
+            words[i] = m_words[i].load(std::memory_order_relaxed);
+        }
+        uint32_t checksum = m_checksum.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_state.load(std::memory_order_relaxed) != stateBefore ||
+            checksum != Checksum(ticket, words)) {
+            return ReadResult::kOverwritten;
+        }
+
+        memcpy(value, words, sizeof(T));
+        return ReadResult::kValid;
+    }
+
+   private:
+    static constexpr size_t kWordCount =
+        (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    // FNV-1a over 32-bit words.
+    static uint32_t Checksum(uint64_t ticket, const uint32_t* words) {
+        uint32_t hash = 0x811C9DC5;
+        hash = (hash ^ static_cast<uint32_t>(ticket)) * 0x01000193;
+        hash = (hash ^ static_cast<uint32_t>(ticket >> 32)) * 0x01000193;
+        for (size_t i = 0; i < kWordCount; i++) {
+            hash = (hash ^ words[i]) * 0x01000193;
+        }
+
+        return hash;
+    }
+
+    std::atomic<uint64_t> m_state;
+    std::atomic<uint32_t> m_checksum;
+    std::atomic<uint32_t> m_words[kWordCount];
+};
+
+}  // namespace TicketRing
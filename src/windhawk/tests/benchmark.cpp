@@ -0,0 +1,110 @@
+#include "benchmark.h"
+
+#include <cerrno>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+std::atomic<uint64_t> g_allocationCount;
+bool g_shortRun;
+
+}  // namespace
+
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size) {
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+}
+
+}  // extern "C"
+
+namespace Benchmark {
+
+void Init(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--short") == 0) {
+            g_shortRun = true;
+        }
+    }
+}
+
+bool IsShortRun() {
+    return g_shortRun;
+}
+
+uint64_t AllocationCount() {
+    return g_allocationCount.load(std::memory_order_relaxed);
+}
+
+void Run(std::string_view name, const std::function<void(size_t)>& op) {
+    using Clock = std::chrono::steady_clock;
+
+    const auto minDuration = g_shortRun ? std::chrono::milliseconds(1)
+                                        : std::chrono::milliseconds(300);
+
+    // Warm up, then grow the iteration count until the run is long enough.
+    op(0);
+
+    size_t iterations = 1;
+    while (true) {
+        uint64_t allocationsBefore = AllocationCount();
+        auto start = Clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            op(i);
+        }
+        auto elapsed = Clock::now() - start;
+        uint64_t allocations = AllocationCount() - allocationsBefore;
+
+        if (elapsed >= minDuration || iterations >= (size_t{1} << 30)) {
+            double ns = std::chrono::duration<double, std::nano>(elapsed)
+                            .count();
+            printf(
+                "{\"benchmark\":\"%.*s\",\"iterations\":%zu,"
+                "\"ns_per_op\":%.2f,\"allocs_per_op\":%.2f}\n",
+                static_cast<int>(name.length()), name.data(), iterations,
+                ns / iterations, static_cast<double>(allocations) / iterations);
+            fflush(stdout);
+            return;
+        }
+
+        iterations *= elapsed < minDuration / 10 ? 10 : 2;
+    }
+}
+
+void CheckFailed(const char* condition, const char* file, int line) {
+    fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, condition);
+    abort();
+}
+
+}  // namespace Benchmark
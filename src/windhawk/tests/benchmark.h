@@ -0,0 +1,49 @@
+#pragma once
+
+// A minimal benchmark harness. Each benchmark prints one JSON line with the
+// time and the number of heap allocations per operation. Allocations are
+// counted by interposing malloc, which covers operator new and the HeapAlloc
+// shim alike.
+//
+// With --short, each benchmark runs for a few iterations only, which is how
+// ctest runs them to check that they still work.
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+namespace Benchmark {
+
+void Init(int argc, char* argv[]);
+
+bool IsShortRun();
+
+uint64_t AllocationCount();
+
+// Prevents the compiler from optimizing away a computed value.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Runs op repeatedly and reports the averages. op gets the iteration index.
+void Run(std::string_view name, const std::function<void(size_t)>& op);
+
+}  // namespace Benchmark
+
+// Checks a condition in tests and benchmarks, also in release builds.
+#define CHECK(condition)                                                \
+    do {                                                                \
+        if (!(condition)) {                                             \
+            ::Benchmark::CheckFailed(#condition, __FILE__, __LINE__);   \
+        }                                                               \
+    } while (0)
+
+namespace Benchmark {
+
+[[noreturn]] void CheckFailed(const char* condition,
+                              const char* file,
+                              int line);
+
+}  // namespace Benchmark
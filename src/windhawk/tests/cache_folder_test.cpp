@@ -0,0 +1,143 @@
+// Tests of the size limits of the cache folders, in a temporary folder. The
+// last write times are set explicitly, since the file system might not record
+// them with a high enough resolution.
+
+#include "stdafx.h"
+
+#include <unistd.h>
+
+#include <fstream>
+
+#include "benchmark.h"
+#include "cache_folder.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+class TempFolder {
+   public:
+    TempFolder() {
+        m_path = fs::temp_directory_path() /
+                 ("cache_folder_test." + std::to_string(getpid()));
+        fs::remove_all(m_path);
+        fs::create_directories(m_path);
+    }
+
+    ~TempFolder() {
+        std::error_code ec;
+        fs::remove_all(m_path, ec);
+    }
+
+    const fs::path& path() const { return m_path; }
+
+   private:
+    fs::path m_path;
+};
+
+// Creates a file of the given size, which was last used ageSeconds ago.
+void WriteTestFile(const fs::path& path, size_t size, int ageSeconds) {
+    std::ofstream(path, std::ios::binary) << std::string(size, 'x');
+    fs::last_write_time(path, fs::file_time_type::clock::now() -
+                                  std::chrono::seconds(ageSeconds));
+}
+
+void TestTrimByCount() {
+    TempFolder folder;
+    for (int i = 0; i < 5; i++) {
+        WriteTestFile(folder.path() / (std::to_string(i) + ".bin"), 10,
+                      100 - i);
+    }
+
+    // Within the limits.
+    CacheFolder::Trim(folder.path(), L".bin", 5, 1000);
+    for (int i = 0; i < 5; i++) {
+        CHECK(fs::exists(folder.path() / (std::to_string(i) + ".bin")));
+    }
+
+    // The oldest files are deleted first.
+    CacheFolder::Trim(folder.path(), L".bin", 3, 1000);
+    CHECK(!fs::exists(folder.path() / "0.bin"));
+    CHECK(!fs::exists(folder.path() / "1.bin"));
+    CHECK(fs::exists(folder.path() / "2.bin"));
+    CHECK(fs::exists(folder.path() / "3.bin"));
+    CHECK(fs::exists(folder.path() / "4.bin"));
+}
+
+void TestTrimBySize() {
+    TempFolder folder;
+    WriteTestFile(folder.path() / "old.bin", 300, 30);
+    WriteTestFile(folder.path() / "middle.bin", 300, 20);
+    WriteTestFile(folder.path() / "new.bin", 300, 10);
+
+    CacheFolder::Trim(folder.path(), L".bin", 100, 700);
+    CHECK(!fs::exists(folder.path() / "old.bin"));
+    CHECK(fs::exists(folder.path() / "middle.bin"));
+    CHECK(fs::exists(folder.path() / "new.bin"));
+
+    // A single file above the limit is deleted too.
+    CacheFolder::Trim(folder.path(), L".bin", 100, 200);
+    CHECK(!fs::exists(folder.path() / "middle.bin"));
+    CHECK(!fs::exists(folder.path() / "new.bin"));
+}
+
+void TestTouch() {
+    TempFolder folder;
+    WriteTestFile(folder.path() / "a.bin", 10, 30);
+    WriteTestFile(folder.path() / "b.bin", 10, 20);
+
+    // The oldest file is used again, so the other one is deleted.
+    CacheFolder::Touch(folder.path() / "a.bin");
+    CacheFolder::Trim(folder.path(), L".bin", 1, 1000);
+    CHECK(fs::exists(folder.path() / "a.bin"));
+    CHECK(!fs::exists(folder.path() / "b.bin"));
+
+    // Files which don't exist are ignored.
+    CacheFolder::Touch(folder.path() / "missing.bin");
+    CHECK(!fs::exists(folder.path() / "missing.bin"));
+}
+
+void TestOtherFilesAreKept() {
+    TempFolder folder;
+    WriteTestFile(folder.path() / "a.bin", 10, 30);
+    WriteTestFile(folder.path() / "a.bin.1234.tmp", 1000, 40);
+    WriteTestFile(folder.path() / "other.txt", 1000, 40);
+    fs::create_directories(folder.path() / "sub.bin");
+
+    CacheFolder::Trim(folder.path(), L".bin", 0, 0);
+    CHECK(!fs::exists(folder.path() / "a.bin"));
+    CHECK(fs::exists(folder.path() / "a.bin.1234.tmp"));
+    CHECK(fs::exists(folder.path() / "other.txt"));
+    CHECK(fs::exists(folder.path() / "sub.bin"));
+
+    // A folder which doesn't exist is ignored.
+    CacheFolder::Trim(folder.path() / "missing", L".bin", 0, 0);
+}
+
+void BenchmarkTrim() {
+    TempFolder folder;
+    for (int i = 0; i < 100; i++) {
+        WriteTestFile(folder.path() / (std::to_string(i) + ".bin"), 10, i);
+    }
+
+    // The common case: a file was added to a folder which is within the
+    // limits.
+    Benchmark::Run("CacheFolder::Trim/100_files", [&](size_t) {
+        CacheFolder::Trim(folder.path(), L".bin", 100, 1000000);
+    });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmark::Init(argc, argv);
+
+    TestTrimByCount();
+    TestTrimBySize();
+    TestTouch();
+    TestOtherFilesAreKept();
+
+    BenchmarkTrim();
+
+    return 0;
+}
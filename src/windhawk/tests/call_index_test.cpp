@@ -0,0 +1,340 @@
+// Tests of the call index with synthetic images: the x86 and x64 linear sweep,
+// the ARM64 B and BL decoding, and the validation of cache files, which are
+// written by other processes. Also a benchmark of building the index of a
+// large code section.
+//
+// The x86 and x64 code is only compiled with _M_IX86 or _M_X64, which
+// CMakeLists.txt defines for this target, together with the Zydis sources.
+
+#include "stdafx.h"
+
+#include "benchmark.h"
+#include "call_index.h"
+
+namespace {
+
+using Architecture = CallIndex::Architecture;
+
+constexpr DWORD kNtHeaderOffset = 0x40;
+constexpr DWORD kCodeRva = 0x1000;
+
+// An image with a code section at kCodeRva, followed by a data section. The
+// data section is filled with call instructions, which must not be indexed.
+std::vector<BYTE> MakeImage(std::span<const BYTE> code, DWORD imageSize) {
+    DWORD codeSize = static_cast<DWORD>(code.size());
+    DWORD dataRva = kCodeRva + ((codeSize + 0xFFF) & ~0xFFFu);
+    CHECK(dataRva + 0x10 <= imageSize);
+
+    std::vector<BYTE> image(imageSize);
+
+    auto* dosHeader = reinterpret_cast<IMAGE_DOS_HEADER*>(image.data());
+    dosHeader->e_magic = IMAGE_DOS_SIGNATURE;
+    dosHeader->e_lfanew = kNtHeaderOffset;
+
+    auto* ntHeader =
+        reinterpret_cast<IMAGE_NT_HEADERS*>(image.data() + kNtHeaderOffset);
+    ntHeader->Signature = IMAGE_NT_SIGNATURE;
+    ntHeader->FileHeader.NumberOfSections = 2;
+    ntHeader->FileHeader.SizeOfOptionalHeader =
+        sizeof(ntHeader->OptionalHeader);
+    ntHeader->OptionalHeader.SizeOfImage = imageSize;
+
+    auto* section = IMAGE_FIRST_SECTION(ntHeader);
+    section[0].VirtualAddress = kCodeRva;
+    section[0].Misc.VirtualSize = codeSize;
+    section[0].Characteristics = IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE;
+    section[1].VirtualAddress = dataRva;
+    section[1].Misc.VirtualSize = 0x10;
+
+    memcpy(image.data() + kCodeRva, code.data(), code.size());
+    memset(image.data() + dataRva, 0xE8, 0x10);
+
+    return image;
+}
+
+std::vector<DWORD> Callers(const CallIndex& index, DWORD targetRva) {
+    auto callers = index.FindCallers(targetRva);
+    return std::vector<DWORD>(callers.begin(), callers.end());
+}
+
+// Direct calls and jumps to the function at +0x40 and to the start of the
+// section, and instructions which must not be indexed. The same bytes decode
+// the same way in 32-bit and in 64-bit code.
+constexpr BYTE kX86Code[] = {
+    // +0x00: call +0x40
+    0xE8, 0x3B, 0x00, 0x00, 0x00,
+    // +0x05: jmp +0x40
+    0xE9, 0x36, 0x00, 0x00, 0x00,
+    // +0x0A: jmp short +0x40, not indexed
+    0xEB, 0x34,
+    // +0x0C: call qword/dword ptr [...], not indexed
+    0xFF, 0x15, 0x00, 0x00, 0x00, 0x00,
+    // +0x12: call, out of the image
+    0xE8, 0xF0, 0xFF, 0xFF, 0x7F,
+    // +0x17: jz +0x40, not indexed
+    0x0F, 0x84, 0x23, 0x00, 0x00, 0x00,
+    // +0x1D: call +0x00
+    0xE8, 0xDE, 0xFF, 0xFF, 0xFF,
+    // +0x22: call, before the image
+    0xE8, 0x00, 0x00, 0xFF, 0xFF,
+    // +0x27: padding up to +0x40
+    0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+    0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+    0xCC,
+    // +0x40: ret
+    0xC3,
+};
+
+void CheckX86Index(const CallIndex& index) {
+    CHECK((Callers(index, kCodeRva + 0x40) ==
+           std::vector<DWORD>{kCodeRva + 0x00, kCodeRva + 0x05}));
+    CHECK((Callers(index, kCodeRva) == std::vector<DWORD>{kCodeRva + 0x1D}));
+    CHECK(Callers(index, kCodeRva + 0x41).empty());
+}
+
+void TestX64() {
+    auto image = MakeImage(kX86Code, 0x3000);
+    auto index = CallIndex::Build(image.data(), Architecture::kX64);
+    CheckX86Index(*index);
+}
+
+void TestX86() {
+    auto image = MakeImage(kX86Code, 0x3000);
+    auto index = CallIndex::Build(image.data(), Architecture::kX86);
+    CheckX86Index(*index);
+
+    // A call with a 16-bit offset truncates the instruction pointer, and isn't
+    // indexed.
+    constexpr BYTE kCode16[] = {
+        // +0x00: call +0x10, with an operand size prefix
+        0x66, 0xE8, 0x0C, 0x00,
+        // +0x04: call +0x10
+        0xE8, 0x07, 0x00, 0x00, 0x00,
+        // +0x09: padding up to +0x10
+        0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+        // +0x10: ret
+        0xC3,
+    };
+
+    image = MakeImage(kCode16, 0x3000);
+    index = CallIndex::Build(image.data(), Architecture::kX86);
+    CHECK((Callers(*index, kCodeRva + 0x10) ==
+           std::vector<DWORD>{kCodeRva + 0x04}));
+}
+
+void TestX64Resync() {
+    // 0x06 isn't a valid instruction in 64-bit code, the sweep continues with
+    // the next byte.
+    constexpr BYTE kCode[] = {
+        // +0x00: invalid
+        0x06,
+        // +0x01: call +0x10
+        0xE8, 0x0A, 0x00, 0x00, 0x00,
+        // +0x06: invalid, truncated call at the end of the section
+        0x06, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+        // +0x10: ret
+        0xC3,
+        // +0x11: call with a missing offset byte
+        0xE8, 0x00, 0x00, 0x00,
+    };
+
+    auto image = MakeImage(kCode, 0x3000);
+    auto index = CallIndex::Build(image.data(), Architecture::kX64);
+    CHECK((Callers(*index, kCodeRva + 0x10) ==
+           std::vector<DWORD>{kCodeRva + 0x01}));
+}
+
+std::vector<BYTE> Arm64Code(std::initializer_list<DWORD> instructions) {
+    std::vector<BYTE> code(instructions.size() * sizeof(DWORD));
+    memcpy(code.data(), std::data(instructions), code.size());
+    return code;
+}
+
+void TestArm64() {
+    auto code = Arm64Code({
+        // +0x00: bl +0x40
+        0x94000010,
+        // +0x04: b +0x00
+        0x17FFFFFF,
+        // +0x08: b.eq +0x10, not indexed
+        0x54000040,
+        // +0x0C: bl, out of the image
+        0x95FFFFFF,
+        // +0x10: bl, before the image
+        0x96000000,
+        // +0x14: bl +0x40
+        0x9400000B,
+        // +0x18: padding up to +0x40
+        0xD503201F, 0xD503201F, 0xD503201F, 0xD503201F, 0xD503201F,
+        0xD503201F, 0xD503201F, 0xD503201F, 0xD503201F, 0xD503201F,
+        // +0x40: ret
+        0xD65F03C0,
+    });
+
+    auto image = MakeImage(code, 0x3000);
+    auto index = CallIndex::Build(image.data(), Architecture::kArm64);
+    CHECK((Callers(*index, kCodeRva + 0x40) ==
+           std::vector<DWORD>{kCodeRva + 0x00, kCodeRva + 0x14}));
+    CHECK((Callers(*index, kCodeRva) == std::vector<DWORD>{kCodeRva + 0x04}));
+    CHECK(Callers(*index, kCodeRva + 0x10).empty());
+}
+
+// The offsets of the arrays in the saved format, see FileHeader.
+constexpr size_t kHeaderSize = 4 * sizeof(DWORD);
+
+DWORD ReadDword(const std::vector<BYTE>& data, size_t offset) {
+    DWORD value;
+    memcpy(&value, data.data() + offset, sizeof(value));
+    return value;
+}
+
+void WriteDword(std::vector<BYTE>& data, size_t offset, DWORD value) {
+    memcpy(data.data() + offset, &value, sizeof(value));
+}
+
+void TestSaveLoad() {
+    constexpr DWORD kImageSize = 0x3000;
+
+    auto image = MakeImage(kX86Code, kImageSize);
+    auto data = CallIndex::Build(image.data(), Architecture::kX64)->Save();
+
+    auto index = CallIndex::Load(data, kImageSize);
+    CHECK(index);
+    CheckX86Index(*index);
+    CHECK(index->Save() == data);
+
+    // Two targets, three callers.
+    DWORD targetCount = ReadDword(data, 2 * sizeof(DWORD));
+    DWORD callerCount = ReadDword(data, 3 * sizeof(DWORD));
+    CHECK(targetCount == 2);
+    CHECK(callerCount == 3);
+    size_t targetsOffset = kHeaderSize;
+    size_t offsetsOffset = targetsOffset + targetCount * sizeof(DWORD);
+    size_t callersOffset = offsetsOffset + (targetCount + 1) * sizeof(DWORD);
+    CHECK(callersOffset + callerCount * sizeof(DWORD) == data.size());
+
+    auto loads = [](const std::vector<BYTE>& data, DWORD imageSize) {
+        return CallIndex::Load(data, imageSize) != nullptr;
+    };
+
+    // Truncated or extended data.
+    CHECK(!loads(std::vector<BYTE>(), kImageSize));
+    CHECK(!loads(
+        std::vector<BYTE>(data.begin(), data.begin() + kHeaderSize - 1),
+        kImageSize));
+    CHECK(!loads(std::vector<BYTE>(data.begin(), data.end() - 1), kImageSize));
+    auto extended = data;
+    extended.push_back(0);
+    CHECK(!loads(extended, kImageSize));
+
+    // A wrong magic or version.
+    for (size_t offset : {0, 4}) {
+        auto modified = data;
+        WriteDword(modified, offset, ReadDword(modified, offset) + 1);
+        CHECK(!loads(modified, kImageSize));
+    }
+
+    // Counts which don't match the size, including ones which overflow.
+    {
+        auto modified = data;
+        WriteDword(modified, 2 * sizeof(DWORD), targetCount + 1);
+        CHECK(!loads(modified, kImageSize));
+        WriteDword(modified, 2 * sizeof(DWORD), 0x80000000);
+        CHECK(!loads(modified, kImageSize));
+    }
+
+    // Unsorted and duplicate targets.
+    {
+        auto modified = data;
+        DWORD target0 = ReadDword(modified, targetsOffset);
+        DWORD target1 = ReadDword(modified, targetsOffset + sizeof(DWORD));
+        WriteDword(modified, targetsOffset, target1);
+        WriteDword(modified, targetsOffset + sizeof(DWORD), target0);
+        CHECK(!loads(modified, kImageSize));
+        WriteDword(modified, targetsOffset, target0);
+        CHECK(!loads(modified, kImageSize));
+    }
+
+    // Offsets which don't start at zero, aren't sorted, or don't end at the
+    // caller count.
+    {
+        auto modified = data;
+        WriteDword(modified, offsetsOffset, 1);
+        CHECK(!loads(modified, kImageSize));
+    }
+    {
+        auto modified = data;
+        WriteDword(modified, offsetsOffset + sizeof(DWORD), callerCount + 1);
+        CHECK(!loads(modified, kImageSize));
+    }
+    {
+        auto modified = data;
+        WriteDword(modified, offsetsOffset + targetCount * sizeof(DWORD),
+                   callerCount - 1);
+        CHECK(!loads(modified, kImageSize));
+    }
+
+    // Targets and callers out of the image.
+    {
+        auto modified = data;
+        WriteDword(modified, targetsOffset + sizeof(DWORD), kImageSize);
+        CHECK(!loads(modified, kImageSize));
+    }
+    {
+        auto modified = data;
+        WriteDword(modified, callersOffset, kImageSize);
+        CHECK(!loads(modified, kImageSize));
+    }
+
+    // The same index of a smaller image, e.g. of another version of the module
+    // which has the same cache key.
+    CHECK(!loads(data, kCodeRva + 0x40));
+    CHECK(loads(data, kCodeRva + 0x41));
+}
+
+void BenchmarkBuild() {
+    // A 4 MB code section of repeated test code.
+    constexpr size_t kCodeSize = 4 * 1024 * 1024;
+    std::vector<BYTE> code;
+    code.reserve(kCodeSize);
+    while (code.size() + sizeof(kX86Code) <= kCodeSize) {
+        code.insert(code.end(), std::begin(kX86Code), std::end(kX86Code));
+    }
+
+    auto image = MakeImage(code, kCodeRva + kCodeSize + 0x1000);
+
+    Benchmark::Run("CallIndex::Build/x64_4MB", [&](size_t) {
+        auto index = CallIndex::Build(image.data(), Architecture::kX64);
+        Benchmark::DoNotOptimize(index);
+    });
+
+    auto index = CallIndex::Build(image.data(), Architecture::kX64);
+    auto data = index->Save();
+
+    Benchmark::Run("CallIndex::Load/x64_4MB", [&](size_t) {
+        auto loaded = CallIndex::Load(data, static_cast<DWORD>(image.size()));
+        Benchmark::DoNotOptimize(loaded);
+    });
+
+    Benchmark::Run("CallIndex::FindCallers", [&](size_t i) {
+        DWORD offset = static_cast<DWORD>(i * sizeof(kX86Code) % kCodeSize);
+        auto callers = index->FindCallers(kCodeRva + offset + 0x40);
+        Benchmark::DoNotOptimize(callers);
+    });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmark::Init(argc, argv);
+
+    TestX64();
+    TestX86();
+    TestX64Resync();
+    TestArm64();
+    TestSaveLoad();
+
+    BenchmarkBuild();
+
+    return 0;
+}
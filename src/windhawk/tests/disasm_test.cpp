@@ -0,0 +1,321 @@
+// Tests of the batch decoding of Wh_DisasmRange: the structured operands and
+// flags of the full mode, the length only mode, which must return the same
+// addresses and lengths, the stop after a return instruction, and the stop at
+// an instruction which can't be decoded. Also benchmarks of both modes, which
+// show what the length only mode saves.
+//
+// The test is built for each architecture, see CMakeLists.txt, with Zydis for
+// x86 and x64, and with the ARM64 disassembler for ARM64.
+
+#include "stdafx.h"
+
+#include "benchmark.h"
+#include "disasm.h"
+
+namespace {
+
+struct ExpectedOperand {
+    WH_DISASM_OPERAND_TYPE type;
+    const char* reg = nullptr;
+    // For relative operands, an offset from the start of the code.
+    INT64 value = 0;
+};
+
+struct ExpectedInstruction {
+    size_t offset;
+    size_t length;
+    const char* mnemonic;
+    DWORD flags;
+    std::vector<ExpectedOperand> operands;
+};
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+// The code is followed by a lock prefix on an instruction which doesn't
+// support it, which can't be decoded. Padded so that the decoder can read the
+// maximum instruction length anywhere in the code.
+#if defined(_M_X64)
+constexpr BYTE kCode[] = {
+    // +0x00: push rbp
+    0x55,
+    // +0x01: mov rax, [rip+0x10]
+    0x48, 0x8B, 0x05, 0x10, 0x00, 0x00, 0x00,
+    // +0x08: call +0x0D
+    0xE8, 0x00, 0x00, 0x00, 0x00,
+    // +0x0D: jz +0x11
+    0x74, 0x02,
+    // +0x0F: ret
+    0xC3,
+    // +0x10: int3
+    0xCC,
+    // +0x11: nop
+    0x90,
+    // +0x12: ret
+    0xC3,
+    // +0x13: lock nop
+    0xF0, 0x90,
+    // Padding
+    0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+    0xCC, 0xCC, 0xCC,
+};
+
+const ExpectedInstruction kExpected[] = {
+    {0x00, 1, "push", 0, {{WH_DISASM_OPERAND_REGISTER, "rbp"}}},
+    {0x01,
+     7,
+     "mov",
+     WH_DISASM_FLAG_RELATIVE,
+     {{WH_DISASM_OPERAND_REGISTER, "rax"},
+      {WH_DISASM_OPERAND_MEMORY, nullptr, 0x18}}},
+    {0x08,
+     5,
+     "call",
+     WH_DISASM_FLAG_CALL | WH_DISASM_FLAG_RELATIVE,
+     {{WH_DISASM_OPERAND_IMMEDIATE, nullptr, 0x0D}}},
+    {0x0D,
+     2,
+     "jz",
+     WH_DISASM_FLAG_JUMP | WH_DISASM_FLAG_CONDITIONAL |
+         WH_DISASM_FLAG_RELATIVE,
+     {{WH_DISASM_OPERAND_IMMEDIATE, nullptr, 0x11}}},
+    {0x0F, 1, "ret", WH_DISASM_FLAG_RETURN, {}},
+    {0x10, 1, "int3", 0, {}},
+    {0x11, 1, "nop", 0, {}},
+    {0x12, 1, "ret", WH_DISASM_FLAG_RETURN, {}},
+};
+#else
+constexpr BYTE kCode[] = {
+    // +0x00: push ebp
+    0x55,
+    // +0x01: mov eax, [ebp+8]
+    0x8B, 0x45, 0x08,
+    // +0x04: call +0x09
+    0xE8, 0x00, 0x00, 0x00, 0x00,
+    // +0x09: jz +0x0D
+    0x74, 0x02,
+    // +0x0B: ret
+    0xC3,
+    // +0x0C: int3
+    0xCC,
+    // +0x0D: nop
+    0x90,
+    // +0x0E: ret
+    0xC3,
+    // +0x0F: lock nop
+    0xF0, 0x90,
+    // Padding
+    0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
+    0xCC, 0xCC, 0xCC,
+};
+
+const ExpectedInstruction kExpected[] = {
+    {0x00, 1, "push", 0, {{WH_DISASM_OPERAND_REGISTER, "ebp"}}},
+    {0x01,
+     3,
+     "mov",
+     0,
+     {{WH_DISASM_OPERAND_REGISTER, "eax"},
+      {WH_DISASM_OPERAND_MEMORY, "ebp", 8}}},
+    {0x04,
+     5,
+     "call",
+     WH_DISASM_FLAG_CALL | WH_DISASM_FLAG_RELATIVE,
+     {{WH_DISASM_OPERAND_IMMEDIATE, nullptr, 0x09}}},
+    {0x09,
+     2,
+     "jz",
+     WH_DISASM_FLAG_JUMP | WH_DISASM_FLAG_CONDITIONAL |
+         WH_DISASM_FLAG_RELATIVE,
+     {{WH_DISASM_OPERAND_IMMEDIATE, nullptr, 0x0D}}},
+    {0x0B, 1, "ret", WH_DISASM_FLAG_RETURN, {}},
+    {0x0C, 1, "int3", 0, {}},
+    {0x0D, 1, "nop", 0, {}},
+    {0x0E, 1, "ret", WH_DISASM_FLAG_RETURN, {}},
+};
+#endif
+
+#elif defined(_M_ARM64)
+
+// The code is followed by a word which isn't an allocated encoding.
+constexpr DWORD kCode[] = {
+    // +0x00: stp x29, x30, [sp, #-0x10]!
+    0xA9BF7BFD,
+    // +0x04: bl +0x0C
+    0x94000002,
+    // +0x08: cbz x0, +0x10
+    0xB4000040,
+    // +0x0C: ret
+    0xD65F03C0,
+    // +0x10: mov x0, #1
+    0xD2800020,
+    // +0x14: nop
+    0xD503201F,
+    // +0x18: ret
+    0xD65F03C0,
+    // +0x1C: unallocated
+    0xFFFFFFFF,
+};
+
+const ExpectedInstruction kExpected[] = {
+    {0x00,
+     4,
+     "stp",
+     0,
+     {{WH_DISASM_OPERAND_REGISTER, "x29"},
+      {WH_DISASM_OPERAND_REGISTER, "x30"},
+      {WH_DISASM_OPERAND_MEMORY, "sp", -0x10}}},
+    {0x04,
+     4,
+     "bl",
+     WH_DISASM_FLAG_CALL | WH_DISASM_FLAG_RELATIVE,
+     {{WH_DISASM_OPERAND_IMMEDIATE, nullptr, 0x0C}}},
+    {0x08,
+     4,
+     "cbz",
+     WH_DISASM_FLAG_JUMP | WH_DISASM_FLAG_CONDITIONAL |
+         WH_DISASM_FLAG_RELATIVE,
+     {{WH_DISASM_OPERAND_REGISTER, "x0"},
+      {WH_DISASM_OPERAND_IMMEDIATE, nullptr, 0x10}}},
+    {0x0C, 4, "ret", WH_DISASM_FLAG_RETURN, {}},
+    {0x10,
+     4,
+     "mov",
+     0,
+     {{WH_DISASM_OPERAND_REGISTER, "x0"},
+      {WH_DISASM_OPERAND_IMMEDIATE, nullptr, 1}}},
+    {0x14, 4, "nop", 0, {}},
+    {0x18, 4, "ret", WH_DISASM_FLAG_RETURN, {}},
+};
+
+#else
+#error "Unsupported architecture"
+#endif
+
+void CheckInstruction(const WH_DISASM_INSTRUCTION& instruction,
+                      const ExpectedInstruction& expected,
+                      bool lengthOnly) {
+    auto* code = reinterpret_cast<const BYTE*>(kCode);
+    CHECK(instruction.address == code + expected.offset);
+    CHECK(instruction.length == expected.length);
+
+    if (lengthOnly) {
+        CHECK(!instruction.mnemonic);
+        CHECK(instruction.flags == 0);
+        CHECK(instruction.operandCount == 0);
+        return;
+    }
+
+    CHECK(strcmp(instruction.mnemonic, expected.mnemonic) == 0);
+    CHECK(instruction.flags == expected.flags);
+    CHECK(instruction.operandCount == expected.operands.size());
+
+    for (size_t i = 0; i < expected.operands.size(); i++) {
+        const auto& operand = instruction.operands[i];
+        const auto& expectedOperand = expected.operands[i];
+        CHECK(operand.type == expectedOperand.type);
+        if (expectedOperand.reg) {
+            CHECK(operand.reg && strcmp(operand.reg, expectedOperand.reg) == 0);
+        } else {
+            CHECK(!operand.reg);
+        }
+
+        bool relative = expectedOperand.type == WH_DISASM_OPERAND_IMMEDIATE &&
+                        (expected.flags & WH_DISASM_FLAG_RELATIVE);
+        relative |= expectedOperand.type == WH_DISASM_OPERAND_MEMORY &&
+                    !expectedOperand.reg;
+        INT64 value = expectedOperand.value;
+        if (relative) {
+            value += reinterpret_cast<INT64>(code);
+        }
+
+        CHECK(operand.value == value);
+    }
+}
+
+void TestDecodeRange() {
+    constexpr size_t kExpectedCount = std::size(kExpected);
+
+    // The number of instructions up to and including the first return.
+    size_t firstReturnCount = 1;
+    while (!(kExpected[firstReturnCount - 1].flags & WH_DISASM_FLAG_RETURN)) {
+        firstReturnCount++;
+    }
+
+    for (bool lengthOnly : {false, true}) {
+        WH_DISASM_INSTRUCTION instructions[16];
+
+        // Stops at the instruction which can't be decoded.
+        size_t count = Disasm::DecodeRange(kCode, instructions,
+                                           std::size(instructions), lengthOnly,
+                                           /*stopAtReturn=*/false);
+        CHECK(count == kExpectedCount);
+        for (size_t i = 0; i < count; i++) {
+            CheckInstruction(instructions[i], kExpected[i], lengthOnly);
+        }
+
+        // Stops after the first return.
+        count = Disasm::DecodeRange(kCode, instructions,
+                                    std::size(instructions), lengthOnly,
+                                    /*stopAtReturn=*/true);
+        CHECK(count == firstReturnCount);
+        CHECK(instructions[count - 1].length == kExpected[count - 1].length);
+
+        // Continues after the return.
+        auto* afterReturn = static_cast<const BYTE*>(
+            instructions[count - 1].address) + instructions[count - 1].length;
+        count = Disasm::DecodeRange(afterReturn, instructions,
+                                    std::size(instructions), lengthOnly,
+                                    /*stopAtReturn=*/true);
+        CHECK(count == kExpectedCount - firstReturnCount);
+        for (size_t i = 0; i < count; i++) {
+            CheckInstruction(instructions[i], kExpected[firstReturnCount + i],
+                             lengthOnly);
+        }
+
+        // Stops at the requested count, and doesn't write beyond it.
+        instructions[2].length = 0xDEAD;
+        count = Disasm::DecodeRange(kCode, instructions, 2, lengthOnly,
+                                    /*stopAtReturn=*/false);
+        CHECK(count == 2);
+        CHECK(instructions[2].length == 0xDEAD);
+
+        count = Disasm::DecodeRange(kCode, instructions, 0, lengthOnly,
+                                    /*stopAtReturn=*/false);
+        CHECK(count == 0);
+
+        // Starts with an instruction which can't be decoded.
+        auto* code = reinterpret_cast<const BYTE*>(kCode);
+        size_t invalidOffset = kExpected[kExpectedCount - 1].offset +
+                               kExpected[kExpectedCount - 1].length;
+        count = Disasm::DecodeRange(code + invalidOffset, instructions,
+                                    std::size(instructions), lengthOnly,
+                                    /*stopAtReturn=*/false);
+        CHECK(count == 0);
+    }
+}
+
+void BenchmarkDecodeRange() {
+    for (bool lengthOnly : {false, true}) {
+        WH_DISASM_INSTRUCTION instructions[std::size(kExpected)];
+        std::string name = "Disasm::DecodeRange/";
+        name += lengthOnly ? "length_only" : "full";
+        Benchmark::Run(name, [&](size_t) {
+            size_t count = Disasm::DecodeRange(kCode, instructions,
+                                               std::size(instructions),
+                                               lengthOnly, false);
+            Benchmark::DoNotOptimize(count);
+        });
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmark::Init(argc, argv);
+
+    TestDecodeRange();
+
+    BenchmarkDecodeRange();
+
+    return 0;
+}
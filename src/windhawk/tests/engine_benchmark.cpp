@@ -0,0 +1,299 @@
+// Benchmarks of the portable engine and shared code, see CMakeLists.txt. Each
+// benchmark also checks its results, so that the numbers are known to be
+// measured on working code.
+
+#include "stdafx.h"
+
+#include "benchmark.h"
+#include "chpe_ranges.h"
+#include "functions.h"
+#include "portable_settings.h"
+#include "symbol_cache.h"
+
+#include "MinHook.h"
+
+namespace {
+
+void BenchmarkWcsmatch() {
+    constexpr std::wstring_view kPattern = L"*\\windows\\*\\explorer.exe";
+    constexpr std::wstring_view kMatch = L"c:\\windows\\system32\\explorer.exe";
+    constexpr std::wstring_view kMismatch =
+        L"c:\\program files\\windhawk\\windhawk.exe";
+
+    CHECK(Functions::wcsmatch(kPattern.data(), kPattern.length(),
+                              kMatch.data(), kMatch.length()));
+    CHECK(!Functions::wcsmatch(kPattern.data(), kPattern.length(),
+                               kMismatch.data(), kMismatch.length()));
+
+    Benchmark::Run("wcsmatch", [&](size_t i) {
+        auto str = i & 1 ? kMatch : kMismatch;
+        Benchmark::DoNotOptimize(Functions::wcsmatch(
+            kPattern.data(), kPattern.length(), str.data(), str.length()));
+    });
+}
+
+void BenchmarkDoesPathMatchPattern() {
+    constexpr std::wstring_view kPattern =
+        L"notepad.exe|mspaint.exe|%ProgramFiles%\\Windhawk\\*.exe|explorer.exe";
+    constexpr std::wstring_view kPath = L"C:\\Windows\\explorer.exe";
+
+    CHECK(Functions::DoesPathMatchPattern(kPath, kPattern));
+    CHECK(Functions::DoesPathMatchPattern(
+        L"C:\\Program Files\\Windhawk\\windhawk.exe", kPattern));
+    CHECK(!Functions::DoesPathMatchPattern(L"C:\\Windows\\regedit.exe",
+                                           kPattern));
+    CHECK(!Functions::DoesPathMatchPattern(kPath, L"explorer.*", true));
+
+    Benchmark::Run("DoesPathMatchPattern", [&](size_t i) {
+        Benchmark::DoNotOptimize(
+            Functions::DoesPathMatchPattern(kPath, kPattern));
+    });
+}
+
+void BenchmarkSplitStringToViews() {
+    std::wstring s;
+    for (int i = 0; i < 32; i++) {
+        if (i > 0) {
+            s += L'|';
+        }
+
+        s += L"process" + std::to_wstring(i) + L".exe";
+    }
+
+    auto parts = Functions::SplitStringToViews(s, L'|');
+    CHECK(parts.size() == 32);
+    CHECK(parts[5] == L"process5.exe");
+    CHECK(Functions::SplitStringToViews(L"a||b|", L'|').size() == 4);
+
+    Benchmark::Run("SplitStringToViews", [&](size_t i) {
+        Benchmark::DoNotOptimize(Functions::SplitStringToViews(s, L'|'));
+    });
+}
+
+void BenchmarkReplaceAll() {
+    std::wstring s;
+    for (int i = 0; i < 32; i++) {
+        s += L"std::basic_string<wchar_t,std::char_traits<wchar_t>> ";
+    }
+
+    CHECK(Functions::ReplaceAll(L"aXbxc", L"x", L"--", true) == L"a--b--c");
+    CHECK(Functions::ReplaceAll(L"aXbxc", L"x", L"--") == L"aXb--c");
+
+    Benchmark::Run("ReplaceAll", [&](size_t i) {
+        Benchmark::DoNotOptimize(
+            Functions::ReplaceAll(s, L"wchar_t", L"unsigned short"));
+    });
+
+    Benchmark::Run("ReplaceAll/ignoreCase", [&](size_t i) {
+        Benchmark::DoNotOptimize(
+            Functions::ReplaceAll(s, L"WCHAR_T", L"unsigned short", true));
+    });
+}
+
+void BenchmarkSymbolCache() {
+    constexpr WCHAR kSep = L'#';
+    constexpr WCHAR kVer = L'1';
+
+    std::wstring cache = L"1#explorer.exe#12345678-901234";
+    for (int i = 0; i < 200; i++) {
+        cache += L"#public: void __cdecl CTaskBand::Method" +
+                 std::to_wstring(i) + L"(void)#";
+        if (i % 10 != 0) {
+            cache += std::to_wstring(0x1000 + i * 0x40);
+        }
+    }
+
+    std::vector<SymbolCache::Entry> entries;
+    CHECK(SymbolCache::Parse(cache, kSep, kVer, &entries));
+    CHECK(entries.size() == 200);
+    CHECK(!entries[0].offset);
+    CHECK(entries[1].offset == 0x1000 + 0x40);
+    CHECK(entries[199].symbol ==
+          L"public: void __cdecl CTaskBand::Method199(void)");
+
+    CHECK(!SymbolCache::Parse(L"2#a#b", kSep, kVer, &entries));
+    CHECK(SymbolCache::Parse(L"1#a#b", kSep, kVer, &entries) &&
+          entries.empty());
+    CHECK(SymbolCache::Parse(L"1#a#b#sym#", kSep, kVer, &entries) &&
+          entries.size() == 1 && !entries[0].offset);
+    CHECK(SymbolCache::Parse(L"1#a#b#sym", kSep, kVer, &entries) &&
+          entries.empty());
+
+    Benchmark::Run("SymbolCache::Parse/200", [&](size_t i) {
+        SymbolCache::Parse(cache, kSep, kVer, &entries);
+        Benchmark::DoNotOptimize(entries.data());
+    });
+}
+
+void BenchmarkMinHookTable() {
+    // The SlimDetours shim doesn't patch code, so any address can be hooked.
+    static char targets[256];
+    static char detour;
+
+    CHECK(MH_Initialize() == MH_OK);
+
+    for (size_t i = 0; i < std::size(targets); i++) {
+        CHECK(MH_CreateHookEx(i % 8 + 1, &targets[i], &detour, nullptr) ==
+              MH_OK);
+    }
+
+    CHECK(MH_CreateHookEx(1, &targets[0], &detour, nullptr) ==
+          MH_ERROR_ALREADY_CREATED);
+
+    // A lookup of the last hook walks the whole table.
+    Benchmark::Run("MinHook/EnableDisable/256", [&](size_t i) {
+        size_t index = std::size(targets) - 1 - i % 8;
+        ULONG_PTR ident = index % 8 + 1;
+        CHECK(MH_EnableHookEx(ident, &targets[index]) == MH_OK);
+        CHECK(MH_DisableHookEx(ident, &targets[index]) == MH_OK);
+    });
+
+    Benchmark::Run("MinHook/QueueApply/256", [&](size_t i) {
+        ULONG_PTR ident = i % 8 + 1;
+        for (size_t j = ident - 1; j < std::size(targets); j += 8) {
+            MH_QueueEnableHookEx(ident, &targets[j]);
+        }
+
+        CHECK(MH_ApplyQueuedEx(ident) == MH_OK);
+        CHECK(MH_DisableHookEx(ident, MH_ALL_HOOKS) == MH_OK);
+    });
+
+    Benchmark::Run("MinHook/CreateRemove/256", [&](size_t i) {
+        CHECK(MH_CreateHookEx(100, &targets[i % std::size(targets)], &detour,
+                              nullptr) == MH_OK);
+        CHECK(MH_RemoveHookEx(100, &targets[i % std::size(targets)]) ==
+              MH_OK);
+    });
+
+    CHECK(MH_Uninitialize() == MH_OK);
+}
+
+void BenchmarkIniFileSettings() {
+    constexpr PCWSTR kFile = L"C:\\Windhawk\\settings.ini";
+
+    {
+        IniFileSettings settings(kFile, L"Settings", true);
+        for (int i = 0; i < 50; i++) {
+            auto name = L"value" + std::to_wstring(i);
+            settings.SetInt(name.c_str(), i);
+        }
+
+        settings.SetString(L"quoted", L"\"a b\"");
+        settings.SetString(L"long", std::wstring(1000, L'x').c_str());
+
+        BYTE binary[] = {0x00, 0x12, 0xAB, 0xFF};
+        settings.SetBinary(L"binary", binary, sizeof(binary));
+    }
+
+    IniFileSettings settings(kFile, L"Settings", false);
+    CHECK(settings.GetInt(L"value49") == 49);
+    CHECK(!settings.GetInt(L"missing"));
+    CHECK(settings.GetString(L"quoted") == L"\"a b\"");
+    CHECK(settings.GetString(L"long") == std::wstring(1000, L'x'));
+    CHECK((settings.GetBinary(L"binary") ==
+           std::vector<BYTE>{0x00, 0x12, 0xAB, 0xFF}));
+
+    int count = 0;
+    for (auto it = settings.EnumStringValues(); it; ++it) {
+        count++;
+    }
+
+    CHECK(count == 53);
+
+    Benchmark::Run("IniFileSettings/GetInt/50", [&](size_t i) {
+        Benchmark::DoNotOptimize(settings.GetInt(L"value25"));
+    });
+
+    Benchmark::Run("IniFileSettings/GetString/1000", [&](size_t i) {
+        Benchmark::DoNotOptimize(settings.GetString(L"long"));
+    });
+
+    Benchmark::Run("IniFileSettings/EnumStringValues/53", [&](size_t i) {
+        for (auto it = settings.EnumStringValues(); it; ++it) {
+            Benchmark::DoNotOptimize(it->second);
+        }
+    });
+}
+
+// A 64-bit image with only the structures which ChpeRanges reads.
+struct HybridImage {
+    IMAGE_DOS_HEADER dosHeader;
+    IMAGE_NT_HEADERS64 ntHeader;
+    IMAGE_LOAD_CONFIG_DIRECTORY64 loadConfig;
+    ULONG metadata[3];
+    ChpeRanges::IMAGE_CHPE_RANGE_ENTRY ranges[64];
+};
+
+void BenchmarkChpeRanges() {
+    static HybridImage image{};
+    constexpr ULONGLONG kImageBase = 0x180000000;
+
+    image.dosHeader.e_magic = IMAGE_DOS_SIGNATURE;
+    image.dosHeader.e_lfanew = offsetof(HybridImage, ntHeader);
+    image.ntHeader.Signature = IMAGE_NT_SIGNATURE;
+
+    auto& opt = image.ntHeader.OptionalHeader;
+    opt.Magic = IMAGE_NT_OPTIONAL_HDR64_MAGIC;
+    opt.ImageBase = kImageBase;
+    opt.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+    opt.DataDirectory[IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG] = {
+        offsetof(HybridImage, loadConfig), sizeof(image.loadConfig)};
+
+    image.loadConfig.Size = sizeof(image.loadConfig);
+    image.loadConfig.CHPEMetadataPointer =
+        kImageBase + offsetof(HybridImage, metadata);
+
+    image.metadata[0] = 1;
+    image.metadata[1] = offsetof(HybridImage, ranges);
+    image.metadata[2] = std::size(image.ranges);
+
+    // Alternating ARM64 (0) and x64 (2) ranges of 0x1000 bytes, with the code
+    // type in the low bits.
+    for (ULONG i = 0; i < std::size(image.ranges); i++) {
+        image.ranges[i].StartOffset = (0x1000 + i * 0x1000) | (i % 2 ? 2 : 0);
+        image.ranges[i].Length = 0x1000;
+    }
+
+    auto ranges = ChpeRanges::GetRanges<IMAGE_NT_HEADERS64,
+                                        IMAGE_LOAD_CONFIG_DIRECTORY64>(
+        &image.dosHeader, &image.ntHeader);
+    CHECK(ranges && ranges->size() == std::size(image.ranges));
+
+    auto* range = ChpeRanges::FindRange(*ranges, 0x1FFF, false);
+    CHECK(range == &image.ranges[0]);
+    range = ChpeRanges::FindRange(*ranges, 0x2000, false);
+    CHECK(range == &image.ranges[1] && (range->StartOffset & 3) == 2);
+    CHECK(!ChpeRanges::FindRange(*ranges, 0x0FFF, false));
+    CHECK(!ChpeRanges::FindRange(*ranges, 0x41000, false));
+
+    image.loadConfig.CHPEMetadataPointer = 0;
+    CHECK(!(ChpeRanges::GetRanges<IMAGE_NT_HEADERS64,
+                                  IMAGE_LOAD_CONFIG_DIRECTORY64>(
+        &image.dosHeader, &image.ntHeader)));
+    image.loadConfig.CHPEMetadataPointer =
+        kImageBase + offsetof(HybridImage, metadata);
+
+    // Symbols are enumerated in no particular order, so spread the lookups
+    // over the image.
+    Benchmark::Run("ChpeRanges::FindRange/64", [&](size_t i) {
+        ULONG rva = 0x1000 + static_cast<ULONG>((i * 0x9E37) % 0x40000);
+        Benchmark::DoNotOptimize(ChpeRanges::FindRange(*ranges, rva, false));
+    });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmark::Init(argc, argv);
+
+    BenchmarkWcsmatch();
+    BenchmarkDoesPathMatchPattern();
+    BenchmarkSplitStringToViews();
+    BenchmarkReplaceAll();
+    BenchmarkSymbolCache();
+    BenchmarkMinHookTable();
+    BenchmarkIniFileSettings();
+    BenchmarkChpeRanges();
+
+    return 0;
+}
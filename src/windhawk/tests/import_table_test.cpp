@@ -0,0 +1,285 @@
+// Tests of the import and export table walks of the import hooks with a
+// synthetic image, and of the code of the export table stubs, which is decoded
+// to check that it jumps through the given pointer. Also benchmarks of the
+// walks, which run for each loaded module while a hook of all modules is set.
+//
+// The test is built for each architecture, see CMakeLists.txt, since the stub
+// code depends on it. The x86 and x64 stubs are decoded with Zydis, the ARM64
+// stub is decoded here.
+
+#include "stdafx.h"
+
+#include "benchmark.h"
+#include "import_table.h"
+
+namespace {
+
+constexpr DWORD kNtHeaderOffset = 0x40;
+constexpr DWORD kExportDirectoryRva = 0x200;
+constexpr DWORD kImportDirectoryRva = 0x400;
+
+// Exports Alpha, Beta and Gamma, with ordinals 7, 5 and 8 and a base of 5.
+// Ordinal 6 has no name.
+struct TestImage {
+    std::vector<BYTE> data = std::vector<BYTE>(0x1000);
+
+    HMODULE module() { return data.data(); }
+
+    IMAGE_NT_HEADERS* ntHeaders() {
+        return reinterpret_cast<IMAGE_NT_HEADERS*>(data.data() +
+                                                   kNtHeaderOffset);
+    }
+
+    template <typename T>
+    T* At(DWORD rva) {
+        return reinterpret_cast<T*>(data.data() + rva);
+    }
+
+    DWORD* functions() {
+        auto* exportDirectory =
+            At<IMAGE_EXPORT_DIRECTORY>(kExportDirectoryRva);
+        return At<DWORD>(exportDirectory->AddressOfFunctions);
+    }
+
+    TestImage() {
+        At<IMAGE_DOS_HEADER>(0)->e_magic = IMAGE_DOS_SIGNATURE;
+        At<IMAGE_DOS_HEADER>(0)->e_lfanew = kNtHeaderOffset;
+        ntHeaders()->Signature = IMAGE_NT_SIGNATURE;
+        ntHeaders()->OptionalHeader.NumberOfRvaAndSizes =
+            IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+        ntHeaders()->OptionalHeader.SizeOfImage =
+            static_cast<DWORD>(data.size());
+
+        auto& directories = ntHeaders()->OptionalHeader.DataDirectory;
+        directories[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress =
+            kExportDirectoryRva;
+        directories[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress =
+            kImportDirectoryRva;
+
+        auto* exportDirectory =
+            At<IMAGE_EXPORT_DIRECTORY>(kExportDirectoryRva);
+        exportDirectory->Base = 5;
+        exportDirectory->NumberOfFunctions = 4;
+        exportDirectory->NumberOfNames = 3;
+        exportDirectory->AddressOfFunctions = 0x280;
+        exportDirectory->AddressOfNames = 0x2A0;
+        exportDirectory->AddressOfNameOrdinals = 0x2C0;
+
+        for (DWORD i = 0; i < 4; i++) {
+            At<DWORD>(0x280)[i] = 0x800 + i * 0x10;
+        }
+
+        const std::pair<const char*, WORD> names[] = {
+            {"Alpha", 2},
+            {"Beta", 0},
+            {"Gamma", 3},
+        };
+        DWORD nameRva = 0x300;
+        for (size_t i = 0; i < std::size(names); i++) {
+            At<DWORD>(0x2A0)[i] = nameRva;
+            At<WORD>(0x2C0)[i] = names[i].second;
+            strcpy(At<char>(nameRva), names[i].first);
+            nameRva += 0x10;
+        }
+
+        // Two import descriptors, with three and one slots.
+        auto* importDescriptors =
+            At<IMAGE_IMPORT_DESCRIPTOR>(kImportDirectoryRva);
+        importDescriptors[0].Name = 0x340;
+        importDescriptors[0].FirstThunk = 0x500;
+        importDescriptors[1].Name = 0x350;
+        importDescriptors[1].FirstThunk = 0x540;
+
+        for (DWORD i = 0; i < 3; i++) {
+            At<void*>(0x500)[i] = reinterpret_cast<void*>(0x1000 + i);
+        }
+        At<void*>(0x540)[0] = reinterpret_cast<void*>(0x2000);
+    }
+};
+
+void TestFindExportEntry() {
+    TestImage image;
+    DWORD* functions = image.functions();
+
+    CHECK(ImportTable::FindExportEntry(image.module(), "Alpha") ==
+          &functions[2]);
+    CHECK(ImportTable::FindExportEntry(image.module(), "Beta") ==
+          &functions[0]);
+    CHECK(ImportTable::FindExportEntry(image.module(), "Gamma") ==
+          &functions[3]);
+
+    // Before, between and after the names, and prefixes.
+    for (const char* name : {"A", "Alph", "Alphaa", "Delta", "Zeta", ""}) {
+        CHECK(!ImportTable::FindExportEntry(image.module(), name));
+    }
+
+    CHECK(ImportTable::FindExportEntry(image.module(), MAKEINTRESOURCEA(5)) ==
+          &functions[0]);
+    CHECK(ImportTable::FindExportEntry(image.module(), MAKEINTRESOURCEA(6)) ==
+          &functions[1]);
+    CHECK(ImportTable::FindExportEntry(image.module(), MAKEINTRESOURCEA(8)) ==
+          &functions[3]);
+    CHECK(!ImportTable::FindExportEntry(image.module(), MAKEINTRESOURCEA(4)));
+    CHECK(!ImportTable::FindExportEntry(image.module(), MAKEINTRESOURCEA(9)));
+
+    // No export directory.
+    image.ntHeaders()
+        ->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT]
+        .VirtualAddress = 0;
+    CHECK(!ImportTable::FindExportEntry(image.module(), "Alpha"));
+}
+
+std::vector<void**> ImportSlots(HMODULE module) {
+    std::vector<void**> slots;
+    ImportTable::ForEachImportSlot(
+        module, [&slots](void** slot) { slots.push_back(slot); });
+    return slots;
+}
+
+void TestForEachImportSlot() {
+    TestImage image;
+    auto* slots = image.At<void*>(0x500);
+    CHECK((ImportSlots(image.module()) ==
+           std::vector<void**>{&slots[0], &slots[1], &slots[2],
+                               image.At<void*>(0x540)}));
+
+    // A descriptor without slots.
+    image.At<void*>(0x540)[0] = nullptr;
+    CHECK(ImportSlots(image.module()).size() == 3);
+
+    // No import directory, and a directory which is beyond the number of
+    // directories.
+    image.ntHeaders()->OptionalHeader.NumberOfRvaAndSizes =
+        IMAGE_DIRECTORY_ENTRY_IMPORT;
+    CHECK(ImportSlots(image.module()).empty());
+    image.ntHeaders()->OptionalHeader.NumberOfRvaAndSizes =
+        IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+    image.ntHeaders()
+        ->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT]
+        .VirtualAddress = 0;
+    CHECK(ImportSlots(image.module()).empty());
+}
+
+// Returns the address of the pointer which the stub code jumps through.
+ULONG_PTR DecodeStub(const BYTE* code) {
+#if defined(_M_IX86) || defined(_M_X64)
+    ZydisDecoder decoder;
+#if defined(_M_IX86)
+    ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LEGACY_32,
+                     ZYDIS_STACK_WIDTH_32);
+#else
+    ZydisDecoderInit(&decoder, ZYDIS_MACHINE_MODE_LONG_64,
+                     ZYDIS_STACK_WIDTH_64);
+#endif
+
+    ZydisDecodedInstruction instruction;
+    ZydisDecodedOperand operands[ZYDIS_MAX_OPERAND_COUNT];
+    CHECK(ZYAN_SUCCESS(ZydisDecoderDecodeFull(&decoder, code,
+                                              ImportTable::kStubCodeSize,
+                                              &instruction, operands)));
+    CHECK(instruction.mnemonic == ZYDIS_MNEMONIC_JMP);
+    CHECK(operands[0].type == ZYDIS_OPERAND_TYPE_MEMORY);
+
+    ZyanU64 address;
+    CHECK(ZYAN_SUCCESS(ZydisCalcAbsoluteAddress(
+        &instruction, &operands[0], reinterpret_cast<ZyanU64>(code),
+        &address)));
+
+    // The rest of the stub isn't reached.
+    for (size_t i = instruction.length; i < ImportTable::kStubCodeSize; i++) {
+        CHECK(code[i] == 0xCC);
+    }
+
+    return static_cast<ULONG_PTR>(address);
+#elif defined(_M_ARM64)
+    DWORD instructions[2];
+    memcpy(instructions, code, sizeof(instructions));
+
+    // ldr x17, label: imm19 in bits 5-23, a signed offset in words.
+    CHECK((instructions[0] & 0xFF00001F) == 0x58000011);
+    INT32 imm19 = static_cast<INT32>(instructions[0] << 8) >> 13;
+    // br x17
+    CHECK(instructions[1] == 0xD61F0220);
+
+    return reinterpret_cast<ULONG_PTR>(code) + static_cast<INT64>(imm19) * 4;
+#else
+#error "Unsupported architecture"
+#endif
+}
+
+void TestStubCode() {
+    alignas(0x1000) static BYTE memory[0x2000];
+
+    // The offsets of the code and of the pointer: the engine's layout, a
+    // pointer before the code, and a pointer right after the code.
+    constexpr std::pair<size_t, size_t> kLayouts[] = {
+        {0, 0x1000},
+        {0x1000, 0},
+        {0x100, 0x108},
+    };
+
+    for (auto [codeOffset, targetOffset] : kLayouts) {
+        BYTE* code = memory + codeOffset;
+        auto* jumpTarget = reinterpret_cast<void**>(memory + targetOffset);
+        memset(memory, 0, sizeof(memory));
+        ImportTable::WriteStubCode(code, jumpTarget);
+
+        ULONG_PTR address = DecodeStub(code);
+#if defined(_M_IX86)
+        // The tests run as a 64-bit process, and the 32-bit stub holds the
+        // low part of the address.
+        CHECK(static_cast<DWORD>(address) ==
+              static_cast<DWORD>(reinterpret_cast<ULONG_PTR>(jumpTarget)));
+#else
+        CHECK(address == reinterpret_cast<ULONG_PTR>(jumpTarget));
+#endif
+    }
+}
+
+void BenchmarkWalks() {
+    // A module with 1000 imports from 20 DLLs.
+    TestImage image;
+    image.data.resize(0x10000);
+    auto* importDescriptors =
+        image.At<IMAGE_IMPORT_DESCRIPTOR>(kImportDirectoryRva);
+    DWORD slotsRva = 0x1000;
+    for (DWORD i = 0; i < 20; i++) {
+        importDescriptors[i].Name = 0x340;
+        importDescriptors[i].FirstThunk = slotsRva;
+        for (DWORD j = 0; j < 50; j++) {
+            image.At<void*>(slotsRva)[j] =
+                reinterpret_cast<void*>(0x100000 + i * 0x1000 + j);
+        }
+        slotsRva += 51 * sizeof(void*);
+    }
+    importDescriptors[20] = {};
+
+    void* value = reinterpret_cast<void*>(0x100000 + 19 * 0x1000 + 49);
+    Benchmark::Run("ImportTable::ForEachImportSlot/1000_slots", [&](size_t) {
+        size_t matches = 0;
+        ImportTable::ForEachImportSlot(image.module(), [&](void** slot) {
+            matches += *slot == value;
+        });
+        CHECK(matches == 1);
+    });
+
+    Benchmark::Run("ImportTable::FindExportEntry", [&](size_t i) {
+        auto* entry = ImportTable::FindExportEntry(
+            image.module(), i % 2 ? "Gamma" : "Delta");
+        Benchmark::DoNotOptimize(entry);
+    });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmark::Init(argc, argv);
+
+    TestFindExportEntry();
+    TestForEachImportSlot();
+    TestStubCode();
+
+    BenchmarkWalks();
+
+    return 0;
+}
@@ -0,0 +1,251 @@
+// Tests of the keyed list model which backs the task manager list, and
+// benchmarks of its refresh with 10k rows, about the size of the list with
+// many mods loaded in many processes.
+
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "keyed_list_model.h"
+
+namespace {
+
+struct Entry {
+    uint64_t key;
+    std::wstring name;
+    std::wstring status;
+};
+
+struct Item {
+    std::wstring name;
+    std::wstring status;
+    int updateCount = 0;
+};
+
+using Model = KeyedListModel<uint64_t, Item>;
+
+Model::Changes Apply(Model& model, std::vector<Entry> snapshot) {
+    return model.Apply(
+        std::move(snapshot), [](const Entry& entry) { return entry.key; },
+        [](Entry&& entry) {
+            return Item{
+                .name = std::move(entry.name),
+                .status = std::move(entry.status),
+            };
+        },
+        [](Item& item, Entry&& entry) {
+            item.updateCount++;
+            if (item.status == entry.status) {
+                return false;
+            }
+
+            item.status = std::move(entry.status);
+            return true;
+        });
+}
+
+std::vector<uint64_t> RowKeys(const Model& model) {
+    std::vector<uint64_t> keys;
+    for (size_t i = 0; i < model.GetCount(); i++) {
+        keys.push_back(model.GetRowKey(i));
+    }
+
+    return keys;
+}
+
+void CheckFindRow(const Model& model) {
+    for (size_t i = 0; i < model.GetCount(); i++) {
+        CHECK(model.FindRow(model.GetRowKey(i)) == i);
+    }
+}
+
+void TestAddRemoveChange() {
+    Model model;
+
+    auto changes = Apply(model, {
+                                    {1, L"a", L"running"},
+                                    {2, L"b", L"running"},
+                                    {3, L"c", L"running"},
+                                });
+    CHECK(changes.added == 3 && changes.removed == 0 && changes.changed == 0);
+    CHECK((RowKeys(model) == std::vector<uint64_t>{1, 2, 3}));
+    CHECK(model.GetRow(1).name == L"b");
+    CheckFindRow(model);
+
+    // Unchanged entries are updated in place, and report no changes.
+    changes = Apply(model, {
+                               {3, L"c", L"running"},
+                               {1, L"a", L"running"},
+                               {2, L"b", L"running"},
+                           });
+    CHECK(!changes.Any());
+    CHECK((RowKeys(model) == std::vector<uint64_t>{1, 2, 3}));
+    CHECK(model.GetRow(0).updateCount == 1);
+
+    // Removed rows keep the relative order of the rest, new rows are
+    // appended.
+    changes = Apply(model, {
+                               {4, L"d", L"running"},
+                               {3, L"c", L"stopped"},
+                               {1, L"a", L"running"},
+                           });
+    CHECK(changes.added == 1 && changes.removed == 1 && changes.changed == 1);
+    CHECK((RowKeys(model) == std::vector<uint64_t>{1, 3, 4}));
+    CHECK(model.GetRow(1).status == L"stopped");
+    CHECK(!model.FindRow(2));
+    CheckFindRow(model);
+
+    changes = Apply(model, {});
+    CHECK(changes.removed == 3);
+    CHECK(model.GetCount() == 0);
+    CHECK(!model.FindRow(1));
+}
+
+void TestDuplicateKeys() {
+    Model model;
+
+    // Only the first entry of a key is used.
+    auto changes = Apply(model, {
+                                    {1, L"a", L"first"},
+                                    {2, L"b", L"running"},
+                                    {1, L"a", L"second"},
+                                });
+    CHECK(changes.added == 2);
+    CHECK((RowKeys(model) == std::vector<uint64_t>{1, 2}));
+    CHECK(model.GetRow(0).status == L"first");
+
+    changes = Apply(model, {
+                               {1, L"a", L"first"},
+                               {1, L"a", L"second"},
+                               {2, L"b", L"running"},
+                           });
+    CHECK(!changes.Any());
+    CHECK(model.GetRow(0).status == L"first");
+    CHECK(model.GetRow(0).updateCount == 1);
+    CheckFindRow(model);
+}
+
+void TestOrder() {
+    Model model;
+
+    Apply(model, {
+                     {1, L"c", L"running"},
+                     {2, L"a", L"stopped"},
+                     {3, L"b", L"running"},
+                     {4, L"a", L"running"},
+                 });
+
+    // Ties keep their current relative order.
+    model.SetOrder(
+        [](const Item& a, const Item& b) { return a.name < b.name; });
+    CHECK((RowKeys(model) == std::vector<uint64_t>{2, 4, 3, 1}));
+    CheckFindRow(model);
+
+    model.SetOrder(
+        [](const Item& a, const Item& b) { return a.status < b.status; });
+    CHECK((RowKeys(model) == std::vector<uint64_t>{4, 3, 1, 2}));
+    CheckFindRow(model);
+
+    // A change re-sorts the rows, an unchanged snapshot leaves them as is.
+    auto changes = Apply(model, {
+                                    {1, L"c", L"running"},
+                                    {2, L"a", L"running"},
+                                    {3, L"b", L"running"},
+                                    {4, L"a", L"running"},
+                                });
+    CHECK(changes.changed == 1);
+    CHECK((RowKeys(model) == std::vector<uint64_t>{4, 3, 1, 2}));
+
+    model.SetOrder(
+        [](const Item& a, const Item& b) { return a.name > b.name; });
+    CHECK((RowKeys(model) == std::vector<uint64_t>{1, 3, 4, 2}));
+    CheckFindRow(model);
+
+    // New rows are placed by the order too.
+    changes = Apply(model, {
+                               {1, L"c", L"running"},
+                               {2, L"a", L"running"},
+                               {3, L"b", L"running"},
+                               {4, L"a", L"running"},
+                               {5, L"d", L"running"},
+                           });
+    CHECK(changes.added == 1);
+    CHECK((RowKeys(model) == std::vector<uint64_t>{5, 1, 3, 4, 2}));
+    CheckFindRow(model);
+}
+
+constexpr size_t kBenchmarkRowCount = 10000;
+
+std::vector<Entry> MakeSnapshot(uint64_t firstKey) {
+    std::vector<Entry> snapshot;
+    snapshot.reserve(kBenchmarkRowCount);
+    for (size_t i = 0; i < kBenchmarkRowCount; i++) {
+        snapshot.push_back({
+            .key = firstKey + i,
+            .name = L"mod-" + std::to_wstring(i % 97) + L" process-" +
+                    std::to_wstring(i),
+            .status = L"running",
+        });
+    }
+
+    return snapshot;
+}
+
+// Each refresh gets a new snapshot, so the copy of the snapshot is included
+// in the numbers, as is the sort by name.
+void BenchmarkApply() {
+    auto order = [](const Item& a, const Item& b) { return a.name < b.name; };
+
+    const auto snapshot = MakeSnapshot(0);
+
+    Model model;
+    model.SetOrder(order);
+    Apply(model, snapshot);
+
+    Benchmark::Run("KeyedListModel::Apply/10k/unchanged", [&](size_t i) {
+        auto changes = Apply(model, snapshot);
+        Benchmark::DoNotOptimize(changes);
+    });
+
+    // 1% of the rows change their status in each refresh.
+    auto changedSnapshot = snapshot;
+    Benchmark::Run("KeyedListModel::Apply/10k/1%_changed", [&](size_t i) {
+        for (size_t j = i % 100; j < kBenchmarkRowCount; j += 100) {
+            changedSnapshot[j].status =
+                (i / 100) & 1 ? L"running" : L"stopped";
+        }
+
+        auto changes = Apply(model, changedSnapshot);
+        Benchmark::DoNotOptimize(changes);
+    });
+
+    // All rows are replaced, e.g. when all processes restart.
+    const std::vector<Entry> snapshots[] = {MakeSnapshot(0),
+                                            MakeSnapshot(kBenchmarkRowCount)};
+    Benchmark::Run("KeyedListModel::Apply/10k/replaced", [&](size_t i) {
+        auto changes = Apply(model, snapshots[i & 1]);
+        Benchmark::DoNotOptimize(changes);
+    });
+
+    CHECK(model.GetCount() == kBenchmarkRowCount);
+    CheckFindRow(model);
+
+    Benchmark::Run("KeyedListModel::FindRow/10k", [&](size_t i) {
+        Benchmark::DoNotOptimize(
+            model.FindRow((i * 7919) % (kBenchmarkRowCount * 2)));
+    });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmark::Init(argc, argv);
+
+    TestAddRemoveChange();
+    TestDuplicateKeys();
+    TestOrder();
+
+    BenchmarkApply();
+
+    return 0;
+}
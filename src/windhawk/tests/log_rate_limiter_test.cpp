@@ -0,0 +1,149 @@
+// Tests of the rate limiter of mod log lines, with a fake clock, and a
+// benchmark of a line which is allowed and of one which is suppressed, as
+// logged from a hot hook.
+
+#include "benchmark.h"
+#include "log_rate_limiter.h"
+
+namespace {
+
+// Distinct addresses for call sites.
+const char g_callSites[4] = {};
+
+void TestBurstAndRefill() {
+    LogRateLimiter limiter({
+        .mod = {.linesPerSecond = 10, .burst = 5},
+    });
+
+    uint64_t now = 1000;
+    for (int i = 0; i < 5; i++) {
+        CHECK(limiter.CheckModBudget(now));
+        CHECK(limiter.TryAcquire(nullptr, now));
+    }
+
+    CHECK(!limiter.CheckModBudget(now));
+    CHECK(!limiter.TryAcquire(nullptr, now));
+
+    // A line per 100 ms.
+    CHECK(!limiter.TryAcquire(nullptr, now + 99));
+    CHECK(limiter.TryAcquire(nullptr, now + 100));
+    CHECK(!limiter.TryAcquire(nullptr, now + 100));
+
+    // The burst is refilled after half a second.
+    now += 100 + 500;
+    for (int i = 0; i < 5; i++) {
+        CHECK(limiter.TryAcquire(nullptr, now));
+    }
+
+    CHECK(!limiter.TryAcquire(nullptr, now));
+}
+
+void TestCallSites() {
+    LogRateLimiter limiter({
+        .mod = {.linesPerSecond = 100, .burst = 100},
+        .callSite = {.linesPerSecond = 10, .burst = 3},
+    });
+
+    uint64_t now = 1000;
+    for (int i = 0; i < 3; i++) {
+        CHECK(limiter.TryAcquire(&g_callSites[0], now));
+    }
+
+    CHECK(!limiter.TryAcquire(&g_callSites[0], now));
+
+    // Other call sites have their own budget.
+    for (int i = 0; i < 3; i++) {
+        CHECK(limiter.TryAcquire(&g_callSites[1], now));
+    }
+
+    CHECK(!limiter.TryAcquire(&g_callSites[1], now));
+}
+
+// A line which is rejected by the mod budget doesn't take a token from its
+// call site.
+void TestModBudgetDoesNotSpendCallSiteTokens() {
+    LogRateLimiter limiter({
+        .mod = {.linesPerSecond = 100, .burst = 2},
+        .callSite = {.linesPerSecond = 10, .burst = 4},
+    });
+
+    uint64_t now = 1000;
+    CHECK(limiter.TryAcquire(&g_callSites[1], now));
+    CHECK(limiter.TryAcquire(&g_callSites[1], now));
+
+    // The mod is over its budget, the call site isn't.
+    for (int i = 0; i < 10; i++) {
+        CHECK(!limiter.TryAcquire(&g_callSites[0], now));
+    }
+
+    // The mod budget is refilled much sooner than the call site budget, which
+    // still has its whole burst.
+    for (int i = 0; i < 2; i++) {
+        now += 20;
+        CHECK(limiter.TryAcquire(&g_callSites[0], now));
+        CHECK(limiter.TryAcquire(&g_callSites[0], now));
+    }
+
+    now += 20;
+    CHECK(!limiter.TryAcquire(&g_callSites[0], now));
+    CHECK(limiter.TryAcquire(&g_callSites[1], now));
+}
+
+void TestSuppressedCount() {
+    LogRateLimiter limiter({
+        .mod = {.linesPerSecond = 10, .burst = 1},
+    });
+
+    uint64_t now = 5000;
+    CHECK(limiter.TakeSuppressedCount(now) == 0);
+
+    CHECK(limiter.TryAcquire(nullptr, now));
+    CHECK(!limiter.TryAcquire(nullptr, now));
+    CHECK(!limiter.CheckModBudget(now));
+    CHECK(!limiter.TryAcquire(nullptr, now));
+
+    CHECK(limiter.TakeSuppressedCount(now) == 3);
+
+    // Reports are made once per second, unless forced.
+    CHECK(!limiter.TryAcquire(nullptr, now));
+    CHECK(limiter.TakeSuppressedCount(now + 999) == 0);
+    CHECK(limiter.TakeSuppressedCount(now + 1000) == 1);
+
+    CHECK(limiter.TryAcquire(nullptr, now + 1000));
+    CHECK(!limiter.TryAcquire(nullptr, now + 1000));
+    CHECK(limiter.TakeSuppressedCount(now + 1000) == 0);
+    CHECK(limiter.TakeSuppressedCount(now + 1000, /*force=*/true) == 1);
+}
+
+void BenchmarkTryAcquire() {
+    LogRateLimiter unlimited({
+        .mod = {.linesPerSecond = 1000000000, .burst = 1000000000},
+        .callSite = {.linesPerSecond = 1000000000, .burst = 1000000000},
+    });
+    Benchmark::Run("LogRateLimiter::TryAcquire/allowed", [&](size_t i) {
+        Benchmark::DoNotOptimize(unlimited.TryAcquire(&g_callSites[0], 1000));
+    });
+
+    LogRateLimiter limited({
+        .mod = {.linesPerSecond = 10, .burst = 1},
+        .callSite = {.linesPerSecond = 1000, .burst = 1000},
+    });
+    Benchmark::Run("LogRateLimiter::TryAcquire/suppressed", [&](size_t i) {
+        Benchmark::DoNotOptimize(limited.TryAcquire(&g_callSites[0], 1000));
+    });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmark::Init(argc, argv);
+
+    TestBurstAndRefill();
+    TestCallSites();
+    TestModBudgetDoesNotSpendCallSiteTokens();
+    TestSuppressedCount();
+
+    BenchmarkTryAcquire();
+
+    return 0;
+}
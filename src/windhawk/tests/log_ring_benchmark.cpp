@@ -0,0 +1,211 @@
+// Benchmarks of the log ring which hands log lines over to the drain thread of
+// the logger, with the same geometry as Logger::Ring. The consumer checks that
+// the records of each producer arrive intact and in order.
+//
+// Besides the averages of the harness, the contended benchmark reports the
+// latency percentiles of TryPush, which is the time a logging thread spends in
+// the logger after formatting.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+#include "log_ring.h"
+
+namespace {
+
+using Ring = LogRing<2048, 64>;
+
+struct RecordHeader {
+    uint32_t producer;
+    uint32_t sequence;
+};
+
+// Records of a typical log line size, one to several cells.
+constexpr size_t kRecordSizes[] = {48, 120, 250, 600};
+
+size_t MakeRecord(std::byte* buffer, uint32_t producer, uint32_t sequence) {
+    size_t size = kRecordSizes[sequence % std::size(kRecordSizes)];
+    RecordHeader header{producer, sequence};
+    memcpy(buffer, &header, sizeof(header));
+    for (size_t i = sizeof(header); i < size; i++) {
+        buffer[i] = static_cast<std::byte>(producer * 31 + sequence + i);
+    }
+
+    return size;
+}
+
+void CheckRecord(const std::byte* buffer, size_t size) {
+    RecordHeader header;
+    CHECK(size >= sizeof(header));
+    memcpy(&header, buffer, sizeof(header));
+    CHECK(size == kRecordSizes[header.sequence % std::size(kRecordSizes)]);
+    for (size_t i = sizeof(header); i < size; i++) {
+        CHECK(buffer[i] ==
+              static_cast<std::byte>(header.producer * 31 + header.sequence +
+                                     i));
+    }
+}
+
+// A busy logging thread, which logs about a line per microsecond, so that the
+// ring isn't full all the time.
+void Pause() {
+    auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(1);
+    while (std::chrono::steady_clock::now() < end) {
+    }
+}
+
+void BenchmarkPushPop() {
+    auto ring = std::make_unique<Ring>();
+
+    for (size_t size : {16, 64, 256, 1024}) {
+        std::vector<std::byte> record(size, std::byte{0x5A});
+        std::vector<std::byte> buffer(Ring::kMaxRecordSize);
+
+        char name[64];
+        snprintf(name, sizeof(name), "LogRing::PushPop/%zuB", size);
+        Benchmark::Run(name, [&](size_t i) {
+            CHECK(ring->TryPush(record.data(), record.size()));
+            size_t poppedSize;
+            CHECK(ring->TryPop(buffer.data(), buffer.size(), &poppedSize));
+            CHECK(poppedSize == size);
+        });
+    }
+}
+
+// Producers push records while a consumer drains them, like logging threads
+// and the drain thread. Pushes fail while the ring is full, and are counted
+// as dropped, like the logger does. The background producers pause between
+// records, the current thread is measured both with and without pauses. The
+// drop rates depend on the consumer having a core of its own.
+void BenchmarkContended(uint32_t producerCount) {
+    auto ring = std::make_unique<Ring>();
+
+    std::atomic<bool> stop = false;
+    std::atomic<uint64_t> consumed = 0;
+
+    std::thread consumer([&] {
+        std::vector<uint32_t> nextSequence(producerCount + 1);
+        std::vector<std::byte> buffer(Ring::kMaxRecordSize);
+        while (true) {
+            size_t size;
+            if (!ring->TryPop(buffer.data(), buffer.size(), &size)) {
+                if (stop) {
+                    break;
+                }
+
+                std::this_thread::yield();
+                continue;
+            }
+
+            CheckRecord(buffer.data(), size);
+
+            RecordHeader header;
+            memcpy(&header, buffer.data(), sizeof(header));
+            CHECK(header.sequence >= nextSequence[header.producer]);
+            nextSequence[header.producer] = header.sequence + 1;
+            consumed++;
+        }
+    });
+
+    std::vector<std::thread> producers;
+    for (uint32_t producer = 1; producer < producerCount; producer++) {
+        producers.emplace_back([&, producer] {
+            std::byte record[Ring::kMaxRecordSize];
+            for (uint32_t sequence = 0; !stop; sequence++) {
+                size_t size = MakeRecord(record, producer, sequence);
+                ring->TryPush(record, size);
+                Pause();
+            }
+        });
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "LogRing::TryPush/%u_producers",
+             producerCount);
+
+    // Pushes without a pause, which is a burst of log lines faster than the
+    // consumer drains them, so most of them are dropped once the ring is full.
+    uint32_t sequence = 0;
+    uint64_t pushed = 0;
+    uint64_t dropped = 0;
+    std::byte record[Ring::kMaxRecordSize];
+    Benchmark::Run(name, [&](size_t i) {
+        size_t size = MakeRecord(record, producerCount, sequence++);
+        pushed++;
+        if (!ring->TryPush(record, size)) {
+            dropped++;
+        }
+    });
+
+    printf(
+        "{\"benchmark\":\"%s/burst\",\"pushed\":%llu,\"drop_rate\":%.3f}\n",
+        name, static_cast<unsigned long long>(pushed),
+        static_cast<double>(dropped) / pushed);
+
+    // The latency of single pushes with pauses, which includes the clock
+    // overhead.
+    constexpr size_t kSampleCount = 100000;
+    std::vector<uint64_t> samples;
+    samples.reserve(kSampleCount);
+    pushed = 0;
+    dropped = 0;
+    for (size_t i = 0; i < (Benchmark::IsShortRun() ? 1000 : kSampleCount);
+         i++) {
+        Pause();
+
+        size_t size = MakeRecord(record, producerCount, sequence++);
+        auto start = std::chrono::steady_clock::now();
+        bool result = ring->TryPush(record, size);
+        auto end = std::chrono::steady_clock::now();
+        pushed++;
+        if (!result) {
+            dropped++;
+            continue;
+        }
+
+        samples.push_back(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+                .count());
+    }
+
+    stop = true;
+    for (auto& producer : producers) {
+        producer.join();
+    }
+
+    consumer.join();
+    CHECK(consumed > 0);
+
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double p) {
+        return samples.empty()
+                   ? 0
+                   : samples[static_cast<size_t>(p * (samples.size() - 1))];
+    };
+
+    printf(
+        "{\"benchmark\":\"%s/latency\",\"samples\":%zu,\"p50_ns\":%llu,"
+        "\"p99_ns\":%llu,\"max_ns\":%llu,\"drop_rate\":%.3f}\n",
+        name, samples.size(), static_cast<unsigned long long>(percentile(0.5)),
+        static_cast<unsigned long long>(percentile(0.99)),
+        static_cast<unsigned long long>(percentile(1)),
+        static_cast<double>(dropped) / pushed);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmark::Init(argc, argv);
+
+    BenchmarkPushPop();
+    BenchmarkContended(1);
+    BenchmarkContended(4);
+
+    return 0;
+}
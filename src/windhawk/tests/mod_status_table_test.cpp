@@ -0,0 +1,227 @@
+// A multi-threaded stress test of the mod status table. Owner threads claim,
+// publish and release slots, and sometimes abandon them, like a process which
+// is terminated before or after its first write. Reader threads verify every
+// snapshot and reclaim abandoned slots, trying stale generations on live
+// slots too.
+//
+// The owner IDs are reused by the owner threads, like process IDs which are
+// reused after a process exits, so only the generation tells the incarnations
+// of an owner apart.
+
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "benchmark.h"
+#include "mod_status_table.h"
+
+namespace {
+
+struct Value {
+    uint32_t owner;
+    uint32_t generation;
+    uint32_t counter;
+    uint32_t check[29];
+};
+
+constexpr uint32_t kSlotCount = 64;
+constexpr uint32_t kOwnerCount = 6;
+constexpr uint32_t kReaderCount = 3;
+
+using Table = ModStatusTable::Table<Value, kSlotCount>;
+using SlotType = Table::SlotType;
+
+Table g_table;
+
+// The incarnation which holds each slot, to catch a slot which is handed out
+// twice. Set by the owner after claiming the slot, so a reclaimed slot might
+// be claimed again before the reclaiming reader clears it.
+std::atomic<uint64_t> g_holders[kSlotCount];
+
+uint64_t MakeHolder(uint32_t owner, uint32_t generation) {
+    return static_cast<uint64_t>(generation) << 32 | owner;
+}
+
+// The abandoned incarnations, by slot index, owner and generation. Plays the
+// role of the process termination check of the app.
+std::mutex g_abandonedMutex;
+std::set<std::tuple<int, uint32_t, uint32_t>> g_abandoned;
+
+std::atomic<bool> g_stop;
+std::atomic<uint64_t> g_validReads;
+std::atomic<uint64_t> g_reclaims;
+std::atomic<uint64_t> g_staleReclaimAttempts;
+
+uint32_t CheckWord(uint32_t owner, uint32_t generation, uint32_t counter,
+                   size_t i) {
+    return (owner * 0x9E3779B1u) ^ (generation * 0x85EBCA77u) ^
+           (counter * 0xC2B2AE3Du) ^ static_cast<uint32_t>(i);
+}
+
+Value MakeValue(uint32_t owner, uint32_t generation, uint32_t counter) {
+    Value value{owner, generation, counter};
+    for (size_t i = 0; i < std::size(value.check); i++) {
+        value.check[i] = CheckWord(owner, generation, counter, i);
+    }
+
+    return value;
+}
+
+bool IsAbandoned(int index, uint32_t owner, uint32_t generation) {
+    std::lock_guard lock(g_abandonedMutex);
+    return g_abandoned.contains({index, owner, generation});
+}
+
+void OwnerThread(uint32_t owner) {
+    std::mt19937 random(owner);
+
+    while (!g_stop.load(std::memory_order_relaxed)) {
+        int index = g_table.Claim(owner);
+        if (index == -1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        auto& slot = g_table.GetSlot(index);
+        auto ownership = slot.GetOwnership();
+        CHECK(ownership.owner == owner);
+
+        uint64_t holder = MakeHolder(owner, ownership.generation);
+        uint64_t previous = g_holders[index].exchange(holder);
+        CHECK(previous == 0 ||
+              IsAbandoned(index, static_cast<uint32_t>(previous),
+                          static_cast<uint32_t>(previous >> 32)));
+
+        uint32_t publishCount = random() % 8;
+        for (uint32_t counter = 0; counter < publishCount; counter++) {
+            slot.Publish(MakeValue(owner, ownership.generation, counter));
+        }
+
+        // A live slot must never be reclaimed.
+        auto current = slot.GetOwnership();
+        CHECK(current.owner == owner &&
+              current.generation == ownership.generation);
+
+        if (random() % 16 == 0) {
+            // Terminated, possibly before the first write.
+            std::lock_guard lock(g_abandonedMutex);
+            g_abandoned.insert({index, owner, ownership.generation});
+            continue;
+        }
+
+        CHECK(g_holders[index].exchange(0) == holder);
+        slot.Release();
+    }
+}
+
+void TryReclaim(int index, SlotType::Ownership ownership) {
+    if (!IsAbandoned(index, ownership.owner, ownership.generation)) {
+        // The owner is alive. A stale generation, as could be read before the
+        // slot was released and claimed again, must not reclaim the slot.
+        if (ownership.generation > 1) {
+            CHECK(!g_table.GetSlot(index).TryReclaim(
+                ownership.owner, ownership.generation - 1));
+            g_staleReclaimAttempts++;
+        }
+
+        return;
+    }
+
+    if (!g_table.GetSlot(index).TryReclaim(ownership.owner,
+                                           ownership.generation)) {
+        // Reclaimed by another reader.
+        return;
+    }
+
+    uint64_t holder = MakeHolder(ownership.owner, ownership.generation);
+    g_holders[index].compare_exchange_strong(holder, 0);
+
+    std::lock_guard lock(g_abandonedMutex);
+    g_abandoned.erase({index, ownership.owner, ownership.generation});
+    g_reclaims++;
+}
+
+void ReaderThread() {
+    while (!g_stop.load(std::memory_order_relaxed)) {
+        uint32_t usedCount = g_table.GetUsedCount();
+        CHECK(usedCount <= kSlotCount);
+
+        for (uint32_t i = 0; i < usedCount; i++) {
+            auto& slot = g_table.GetSlot(i);
+
+            SlotType::Snapshot snapshot;
+            if (slot.Read(&snapshot) != SlotType::ReadResult::kValid) {
+                TryReclaim(i, slot.GetOwnership());
+                continue;
+            }
+
+            const Value& value = snapshot.value;
+            CHECK(value.owner == snapshot.owner);
+            CHECK(value.generation == snapshot.generation);
+            for (size_t j = 0; j < std::size(value.check); j++) {
+                CHECK(value.check[j] == CheckWord(value.owner,
+                                                  value.generation,
+                                                  value.counter, j));
+            }
+
+            g_validReads++;
+
+            TryReclaim(i, {snapshot.owner, snapshot.generation});
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmark::Init(argc, argv);
+
+    g_table.Initialize(1);
+    CHECK(g_table.IsCompatible(1));
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < kOwnerCount; i++) {
+        threads.emplace_back(OwnerThread, i + 1);
+    }
+
+    for (uint32_t i = 0; i < kReaderCount; i++) {
+        threads.emplace_back(ReaderThread);
+    }
+
+    std::this_thread::sleep_for(Benchmark::IsShortRun()
+                                    ? std::chrono::milliseconds(500)
+                                    : std::chrono::seconds(10));
+    g_stop = true;
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // The owners are gone, so every slot which is still held is abandoned and
+    // must be reclaimable by a final pass.
+    for (uint32_t i = 0; i < g_table.GetUsedCount(); i++) {
+        auto ownership = g_table.GetSlot(i).GetOwnership();
+        if (ownership.owner == 0) {
+            CHECK(g_holders[i] == 0);
+            continue;
+        }
+
+        CHECK(IsAbandoned(i, ownership.owner, ownership.generation));
+        TryReclaim(i, ownership);
+        CHECK(g_table.GetSlot(i).GetOwnership().owner == 0);
+    }
+
+    CHECK(g_abandoned.empty());
+    CHECK(g_validReads > 0);
+    CHECK(g_reclaims > 0);
+    CHECK(g_staleReclaimAttempts > 0);
+
+    printf("valid reads: %llu, reclaims: %llu, stale reclaim attempts: %llu\n",
+           static_cast<unsigned long long>(g_validReads),
+           static_cast<unsigned long long>(g_reclaims),
+           static_cast<unsigned long long>(g_staleReclaimAttempts));
+    return 0;
+}
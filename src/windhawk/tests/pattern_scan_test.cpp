@@ -0,0 +1,279 @@
+// Tests of the pattern scanner against a naive scan, and benchmarks of a scan
+// of a real executable image. The vectorized block scan only handles full
+// vectors, and the rest of the candidates of each pattern is left to the
+// scalar scan, so the tests cover ranges and pattern sizes around the vector
+// widths.
+//
+// The test is built twice, see CMakeLists.txt: once with the runtime dispatch,
+// which uses AVX2 if available, and once with the SSE2 block scan forced. The
+// NEON block scan can't run here.
+
+#include "stdafx.h"
+
+#include <array>
+#include <random>
+
+#include "benchmark.h"
+#include "pattern_scan.h"
+
+namespace {
+
+using PatternScan::Pattern;
+
+std::vector<size_t> NaiveScan(std::span<const uint8_t> data,
+                              size_t begin,
+                              size_t end,
+                              const Pattern& pattern) {
+    std::vector<size_t> matches;
+    size_t size = pattern.bytes.size();
+    for (size_t offset = begin; offset < end && offset + size <= data.size();
+         offset++) {
+        bool match = true;
+        for (size_t i = 0; i < size; i++) {
+            if ((data[offset + i] & pattern.mask[i]) != pattern.bytes[i]) {
+                match = false;
+                break;
+            }
+        }
+
+        if (match) {
+            matches.push_back(offset);
+        }
+    }
+
+    return matches;
+}
+
+void TestParse() {
+    auto pattern = PatternScan::Parse("48 8b ?? E8 12 ?");
+    CHECK(pattern);
+    CHECK((pattern->bytes ==
+           std::vector<uint8_t>{0x48, 0x8B, 0, 0xE8, 0x12, 0}));
+    CHECK((pattern->mask ==
+           std::vector<uint8_t>{0xFF, 0xFF, 0, 0xFF, 0xFF, 0}));
+
+    // The least common byte first, then the next least common one.
+    CHECK(pattern->anchorIndex1 == 4);
+    CHECK(pattern->anchorIndex2 == 3);
+
+    // Bytes which aren't in the common bytes table are equally rare, the first
+    // ones are used.
+    pattern = PatternScan::Parse("00 12 34 56");
+    CHECK(pattern);
+    CHECK(pattern->anchorIndex1 == 1);
+    CHECK(pattern->anchorIndex2 == 2);
+
+    pattern = PatternScan::Parse("CC 00 48");
+    CHECK(pattern);
+    CHECK(pattern->anchorIndex1 == 2);
+    CHECK(pattern->anchorIndex2 == 0);
+
+    // A single fixed byte is used for both anchors.
+    pattern = PatternScan::Parse("?? ?? 00 ??");
+    CHECK(pattern);
+    CHECK(pattern->anchorIndex1 == 2);
+    CHECK(pattern->anchorIndex2 == 2);
+
+    pattern = PatternScan::Parse("  E8   ?? ");
+    CHECK(pattern);
+    CHECK(pattern->bytes.size() == 2);
+
+    CHECK(!PatternScan::Parse(""));
+    CHECK(!PatternScan::Parse("?? ?"));
+    CHECK(!PatternScan::Parse("4"));
+    CHECK(!PatternScan::Parse("123"));
+    CHECK(!PatternScan::Parse("G0"));
+    CHECK(!PatternScan::Parse("48 ???"));
+}
+
+// Random patterns over a small alphabet, so that matches are common.
+Pattern RandomPattern(std::mt19937& random, size_t size) {
+    constexpr uint8_t kAlphabet[] = {0x00, 0x48, 0x8B, 0xE8, 0x12};
+
+    std::string text;
+    bool hasFixedByte = false;
+    for (size_t i = 0; i < size; i++) {
+        if (i > 0) {
+            text += ' ';
+        }
+
+        // Make sure that there's a fixed byte, at a random position.
+        bool wildcard = random() % 4 == 0 && (hasFixedByte || i + 1 < size);
+        if (wildcard) {
+            text += "??";
+            continue;
+        }
+
+        char hex[3];
+        sprintf(hex, "%02X", kAlphabet[random() % std::size(kAlphabet)]);
+        text += hex;
+        hasFixedByte = true;
+    }
+
+    auto pattern = PatternScan::Parse(text);
+    CHECK(pattern);
+    return *pattern;
+}
+
+void TestScanAgainstNaiveScan() {
+    std::mt19937 random(1);
+
+    // Sizes around multiples of the vector widths.
+    constexpr size_t kPatternSizes[] = {1, 2, 3, 15, 16, 17, 31, 32, 33, 40};
+
+    for (int round = 0; round < 3000; round++) {
+        std::vector<uint8_t> data(random() % 300);
+        for (auto& byte : data) {
+            // Mostly bytes of the pattern alphabet.
+            byte = random() % 3 ? std::array<uint8_t, 4>{0x00, 0x48, 0x8B,
+                                                         0xE8}[random() % 4]
+                                : static_cast<uint8_t>(random());
+        }
+
+        std::vector<Pattern> patterns;
+        size_t patternCount = 1 + random() % 4;
+        for (size_t i = 0; i < patternCount; i++) {
+            patterns.push_back(RandomPattern(
+                random, kPatternSizes[random() % std::size(kPatternSizes)]));
+        }
+
+        size_t begin = data.empty() ? 0 : random() % (data.size() + 1);
+        size_t end = begin + random() % (data.size() - begin + 40);
+
+        std::vector<std::vector<size_t>> matches(patterns.size());
+        PatternScan::Scan(data, begin, end, patterns, matches);
+
+        for (size_t i = 0; i < patterns.size(); i++) {
+            CHECK(matches[i] == NaiveScan(data, begin, end, patterns[i]));
+        }
+
+        // Scanning in chunks finds the same matches, since matches can extend
+        // beyond the end of a chunk.
+        std::vector<std::vector<size_t>> chunkMatches(patterns.size());
+        size_t chunkSize = 1 + random() % 70;
+        for (size_t chunkBegin = begin; chunkBegin < end;
+             chunkBegin += chunkSize) {
+            PatternScan::Scan(data, chunkBegin,
+                              std::min(chunkBegin + chunkSize, end), patterns,
+                              chunkMatches);
+        }
+
+        CHECK(chunkMatches == matches);
+    }
+}
+
+// A match which ends exactly at the end of the data, and candidates in the
+// last partial vector.
+void TestScanTail() {
+    auto pattern = PatternScan::Parse("E8 ?? 12");
+    CHECK(pattern);
+
+    for (size_t size = 3; size < 100; size++) {
+        std::vector<uint8_t> data(size, 0xE8);
+        data[size - 1] = 0x12;
+        data[size - 3] = 0xE8;
+
+        for (size_t begin = 0; begin <= size - 3; begin++) {
+            std::vector<std::vector<size_t>> matches(1);
+            PatternScan::Scan(data, begin, size, std::span(&*pattern, 1),
+                              matches);
+            CHECK(matches[0] == NaiveScan(data, begin, size, *pattern));
+            CHECK(matches[0] == std::vector<size_t>{size - 3});
+        }
+    }
+}
+
+std::vector<uint8_t> ReadFile(const char* path) {
+    FILE* file = fopen(path, "rb");
+    CHECK(file);
+
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + read);
+    }
+
+    fclose(file);
+    return data;
+}
+
+// Patterns of 32-bit x86 code, as the image is a 32-bit executable: a function
+// prologue, a call followed by a stack cleanup, an indirect call through the
+// import table, and a pattern which doesn't occur.
+void BenchmarkScanImage() {
+    const std::vector<uint8_t> image = ReadFile(PATTERN_SCAN_TEST_IMAGE);
+
+    std::vector<Pattern> patterns;
+    for (const char* text : {
+             "55 8B EC 83 EC ??",
+             "E8 ?? ?? ?? ?? 83 C4 ??",
+             "FF 15 ?? ?? ?? ?? 85 C0",
+             "8B 45 ?? 85 C0 74 ?? 8B 4D ?? 51 E8 ?? ?? ?? ?? 5A 5A 5A",
+         }) {
+        auto pattern = PatternScan::Parse(text);
+        CHECK(pattern);
+        patterns.push_back(*pattern);
+    }
+
+    std::vector<std::vector<size_t>> matches(patterns.size());
+    PatternScan::Scan(image, 0, image.size(), patterns, matches);
+    for (size_t i = 0; i < patterns.size(); i++) {
+        CHECK(matches[i] == NaiveScan(image, 0, image.size(), patterns[i]));
+    }
+
+    CHECK(!matches[0].empty() && !matches[1].empty());
+    CHECK(matches[3].empty());
+
+    Benchmark::Run("PatternScan::Scan/image/4_patterns", [&](size_t i) {
+        for (auto& patternMatches : matches) {
+            patternMatches.clear();
+        }
+
+        PatternScan::Scan(image, 0, image.size(), patterns, matches);
+        Benchmark::DoNotOptimize(matches);
+    });
+
+    Benchmark::Run("PatternScan::Scan/image/1_pattern", [&](size_t i) {
+        matches[0].clear();
+        PatternScan::Scan(image, 0, image.size(), std::span(patterns.data(), 1),
+                          std::span(matches.data(), 1));
+        Benchmark::DoNotOptimize(matches);
+    });
+
+    // 64 KB chunks, as the engine scans the sections of a module.
+    Benchmark::Run("PatternScan::Scan/image/4_patterns_chunked", [&](size_t i) {
+        for (auto& patternMatches : matches) {
+            patternMatches.clear();
+        }
+
+        constexpr size_t kChunkSize = 0x10000;
+        for (size_t begin = 0; begin < image.size(); begin += kChunkSize) {
+            PatternScan::Scan(image, begin,
+                              std::min(begin + kChunkSize, image.size()),
+                              patterns, matches);
+        }
+
+        Benchmark::DoNotOptimize(matches);
+    });
+
+    // The naive scan as a baseline.
+    Benchmark::Run("PatternScan::NaiveScan/image/1_pattern", [&](size_t i) {
+        Benchmark::DoNotOptimize(
+            NaiveScan(image, 0, image.size(), patterns[0]));
+    });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmark::Init(argc, argv);
+
+    TestParse();
+    TestScanAgainstNaiveScan();
+    TestScanTail();
+
+    BenchmarkScanImage();
+
+    return 0;
+}
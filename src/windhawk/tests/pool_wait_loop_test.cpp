@@ -0,0 +1,518 @@
+// Tests of the main loop which runs on thread pool waits, with a stand-in pool
+// which has a single thread for all waits, like the private pool of the
+// engine, and stand-ins for the threads of the process. Also a comparison of
+// the memory which idle sessions hold with a dedicated thread each, as with
+// MainLoopRunner::Run, and with waits on the pool.
+
+#include "stdafx.h"
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <thread>
+
+#include "benchmark.h"
+#include "pool_wait_loop.h"
+
+namespace {
+
+using Wait = PoolWaitLoop::Wait;
+using State = PoolWaitLoop::State;
+
+class LocalPool;
+
+// A manual reset event which wakes the pool when it's set.
+class Event {
+   public:
+    explicit Event(LocalPool* pool = nullptr) : m_pool(pool) {}
+
+    void Set();
+
+    bool IsSet() const { return m_set.load(); }
+
+    bool WaitFor(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_condition.wait_for(lock, timeout, [this] { return IsSet(); });
+    }
+
+   private:
+    LocalPool* m_pool;
+    std::atomic<bool> m_set = false;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+};
+
+// One-shot waits, which are serviced by a single thread, like waits on a pool
+// with SetThreadpoolThreadMaximum(pool, 1). Callbacks never run concurrently.
+class LocalPool {
+   public:
+    LocalPool() : m_thread([this] { Run(); }) {}
+
+    ~LocalPool() {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_stop = true;
+        }
+
+        m_condition.notify_one();
+        m_thread.join();
+    }
+
+    void SetWait(void* owner, Event* event, std::function<void()> callback) {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_waits.push_back({owner, event, std::move(callback)});
+        }
+
+        m_condition.notify_one();
+    }
+
+    // Like closing the waits: cancels the pending ones, and waits for a running
+    // callback to return.
+    void CancelWaits(void* owner) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::erase_if(m_waits, [owner](const Registration& r) {
+            return r.owner == owner;
+        });
+        m_idle.wait(lock, [this, owner] { return m_runningOwner != owner; });
+    }
+
+    void Wake() {
+        { std::lock_guard<std::mutex> guard(m_mutex); }
+        m_condition.notify_one();
+    }
+
+    size_t WaitCount() {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_waits.size();
+    }
+
+   private:
+    struct Registration {
+        void* owner;
+        Event* event;
+        std::function<void()> callback;
+    };
+
+    void Run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            auto it = m_waits.end();
+            m_condition.wait(lock, [this, &it] {
+                if (m_stop) {
+                    return true;
+                }
+
+                it = std::find_if(
+                    m_waits.begin(), m_waits.end(),
+                    [](const Registration& r) { return r.event->IsSet(); });
+                return it != m_waits.end();
+            });
+
+            if (m_stop) {
+                return;
+            }
+
+            m_runningOwner = it->owner;
+            auto callback = std::move(it->callback);
+            m_waits.erase(it);
+
+            lock.unlock();
+            callback();
+            lock.lock();
+
+            m_runningOwner = nullptr;
+            m_idle.notify_all();
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::condition_variable m_idle;
+    std::vector<Registration> m_waits;
+    void* m_runningOwner = nullptr;
+    bool m_stop = false;
+    std::thread m_thread;
+};
+
+void Event::Set() {
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_set = true;
+    }
+
+    m_condition.notify_all();
+    if (m_pool) {
+        m_pool->Wake();
+    }
+}
+
+// The threads of a process, in creation order, as NtGetNextThread enumerates
+// them. Like on Windows, threads which exited are removed once they're no
+// longer referenced, here when they're skipped by the enumeration.
+class LocalProcess {
+   public:
+    struct Thread {
+        explicit Thread(LocalPool* pool) : exited(pool) {}
+
+        Event exited;
+        uint32_t exitCode = 0;
+    };
+
+    explicit LocalProcess(LocalPool* pool) : m_pool(pool) {}
+
+    Thread* AddThread() {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_threads.emplace_back(std::make_unique<Thread>(m_pool)).get();
+    }
+
+    void ExitThread(Thread* thread, uint32_t exitCode) {
+        thread->exitCode = exitCode;
+        thread->exited.Set();
+    }
+
+    Thread* FindFirstAliveThread() {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        while (!m_threads.empty() && m_threads.front()->exited.IsSet()) {
+            m_threads.pop_front();
+        }
+
+        return m_threads.empty() ? nullptr : m_threads.front().get();
+    }
+
+    // A sandboxed process can't enumerate its threads.
+    bool enumerable = true;
+
+   private:
+    LocalPool* m_pool;
+    std::mutex m_mutex;
+    std::deque<std::unique_ptr<Thread>> m_threads;
+};
+
+// Mirrors CustomizationSession::ThreadPoolMainLoop.
+class LocalSession : private PoolWaitLoop::Host {
+   public:
+    LocalSession(LocalPool* pool, LocalProcess* process)
+        : m_pool(pool),
+          m_process(process),
+          sessionManagerExited(pool),
+          modConfigChanged(pool) {}
+
+    ~LocalSession() { m_pool->CancelWaits(this); }
+
+    bool Start() {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if (!m_loop.Start()) {
+            return false;
+        }
+
+        m_pool->SetWait(this, &sessionManagerExited, [this] {
+            OnSignaled(Wait::kSessionManagerProcess);
+        });
+        m_pool->SetWait(this, &modConfigChanged,
+                        [this] { OnSignaled(Wait::kModConfigChange); });
+        return true;
+    }
+
+    // Waits for the loop to end, and returns the state which ended it.
+    State WaitForEnd() {
+        CHECK(m_ended.WaitFor(std::chrono::seconds(10)));
+        return m_endState;
+    }
+
+    bool HasEnded() const { return m_ended.IsSet(); }
+
+    Event sessionManagerExited;
+    Event modConfigChanged;
+
+    std::atomic<uint32_t> lastThreadExitCode = 0;
+    std::atomic<int> enumerations = 0;
+
+   private:
+    void OnSignaled(Wait wait) {
+        State state;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            state = m_loop.OnSignaled(wait);
+        }
+
+        if (state != State::kWaiting) {
+            m_endState = state;
+            m_ended.Set();
+        }
+    }
+
+    PoolWaitLoop::FirstThread WaitForFirstThread() noexcept override {
+        enumerations++;
+        m_firstThread = nullptr;
+
+        if (!m_process->enumerable) {
+            return PoolWaitLoop::FirstThread::kUnknown;
+        }
+
+        m_firstThread = m_process->FindFirstAliveThread();
+        if (!m_firstThread) {
+            return PoolWaitLoop::FirstThread::kNoneLeft;
+        }
+
+        m_pool->SetWait(this, &m_firstThread->exited,
+                        [this] { OnSignaled(Wait::kFirstThread); });
+        return PoolWaitLoop::FirstThread::kFound;
+    }
+
+    void OnFirstThreadExited() noexcept override {
+        lastThreadExitCode = m_firstThread->exitCode;
+    }
+
+    bool WaitForSessionManagerExit(uint32_t timeoutMs) noexcept override {
+        return sessionManagerExited.WaitFor(
+            std::chrono::milliseconds(timeoutMs));
+    }
+
+    LocalPool* m_pool;
+    LocalProcess* m_process;
+    PoolWaitLoop m_loop{this};
+    std::mutex m_mutex;
+    LocalProcess::Thread* m_firstThread = nullptr;
+    Event m_ended;
+    State m_endState = State::kWaiting;
+};
+
+void TestSessionManagerExit() {
+    LocalPool pool;
+    LocalProcess process(&pool);
+    process.AddThread();
+    LocalSession session(&pool, &process);
+
+    CHECK(session.Start());
+    session.sessionManagerExited.Set();
+    CHECK(session.WaitForEnd() == State::kSessionManagerExited);
+    CHECK(session.enumerations == 1);
+}
+
+void TestThreadsExit() {
+    LocalPool pool;
+    LocalProcess process(&pool);
+    auto* mainThread = process.AddThread();
+    auto* thread1 = process.AddThread();
+    auto* thread2 = process.AddThread();
+    LocalSession session(&pool, &process);
+
+    CHECK(session.Start());
+
+    // Threads other than the waited one exit without a callback.
+    process.ExitThread(thread1, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(session.enumerations == 1);
+
+    // The first thread exits, and the next alive one is waited for.
+    process.ExitThread(mainThread, 2);
+    while (session.enumerations < 2) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    CHECK(!session.HasEnded());
+    CHECK(session.lastThreadExitCode == 2);
+
+    // A thread which is created later is found once the older ones exited.
+    auto* thread3 = process.AddThread();
+    process.ExitThread(thread2, 3);
+    while (session.enumerations < 3) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    CHECK(!session.HasEnded());
+
+    process.ExitThread(thread3, 4);
+    CHECK(session.WaitForEnd() == State::kNoThreadsLeft);
+    CHECK(session.lastThreadExitCode == 4);
+    CHECK(session.enumerations == 4);
+    CHECK(pool.WaitCount() == 2);
+}
+
+void TestModConfigChange() {
+    LocalPool pool;
+    LocalProcess process(&pool);
+    process.AddThread();
+
+    {
+        LocalSession session(&pool, &process);
+        CHECK(session.Start());
+
+        auto start = std::chrono::steady_clock::now();
+        session.modConfigChanged.Set();
+        CHECK(session.WaitForEnd() == State::kModConfigChanged);
+        CHECK(std::chrono::steady_clock::now() - start >=
+              std::chrono::milliseconds(PoolWaitLoop::kModConfigChangeDelayMs));
+    }
+
+    // The session manager exits while the change is delayed.
+    {
+        LocalSession session(&pool, &process);
+        CHECK(session.Start());
+
+        session.modConfigChanged.Set();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        session.sessionManagerExited.Set();
+        CHECK(session.WaitForEnd() == State::kSessionManagerExited);
+    }
+}
+
+void TestNoThreads() {
+    LocalPool pool;
+
+    LocalProcess emptyProcess(&pool);
+    LocalSession session(&pool, &emptyProcess);
+    CHECK(!session.Start());
+    CHECK(pool.WaitCount() == 0);
+
+    // Without the threads, the process is monitored without them.
+    LocalProcess sandboxedProcess(&pool);
+    sandboxedProcess.enumerable = false;
+    LocalSession sandboxedSession(&pool, &sandboxedProcess);
+    CHECK(sandboxedSession.Start());
+    CHECK(pool.WaitCount() == 2);
+    sandboxedSession.sessionManagerExited.Set();
+    CHECK(sandboxedSession.WaitForEnd() == State::kSessionManagerExited);
+}
+
+struct MemoryStatus {
+    // The resident set, which corresponds to the working set.
+    size_t rssBytes = 0;
+    // Private writable mappings, which is what Linux charges as commit. Unlike
+    // Windows, Linux charges thread stacks fully, not only the committed part.
+    size_t commitBytes = 0;
+};
+
+MemoryStatus GetMemoryStatus() {
+    MemoryStatus status;
+    std::ifstream file("/proc/self/status");
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t kb;
+        if (sscanf(line.c_str(), "VmRSS: %zu kB", &kb) == 1) {
+            status.rssBytes = kb * 1024;
+        } else if (sscanf(line.c_str(), "VmData: %zu kB", &kb) == 1) {
+            status.commitBytes = kb * 1024;
+        }
+    }
+
+    return status;
+}
+
+void PrintMemoryPerSession(const char* name,
+                           const MemoryStatus& before,
+                           const MemoryStatus& after,
+                           size_t sessionCount) {
+    printf(
+        "{\"benchmark\":\"%s\",\"sessions\":%zu,"
+        "\"rss_bytes_per_session\":%zd,\"commit_bytes_per_session\":%zd}\n",
+        name, sessionCount,
+        static_cast<ssize_t>(after.rssBytes - before.rssBytes) /
+            static_cast<ssize_t>(sessionCount),
+        static_cast<ssize_t>(after.commitBytes - before.commitBytes) /
+            static_cast<ssize_t>(sessionCount));
+}
+
+// Each idle session holds a blocked thread with MainLoopRunner::Run, and only
+// its waits with the pool. In the engine, each session is in its own process,
+// so the numbers are per process.
+void BenchmarkIdleSessions() {
+    const size_t sessionCount = Benchmark::IsShortRun() ? 16 : 256;
+
+    {
+        std::vector<std::unique_ptr<Event>> sessionManagerExited;
+        for (size_t i = 0; i < sessionCount; i++) {
+            sessionManagerExited.push_back(std::make_unique<Event>());
+        }
+
+        auto before = GetMemoryStatus();
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < sessionCount; i++) {
+            threads.emplace_back([event = sessionManagerExited[i].get()] {
+                while (!event->WaitFor(std::chrono::seconds(1))) {
+                }
+            });
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        PrintMemoryPerSession("MainLoop/dedicated_thread", before,
+                              GetMemoryStatus(), sessionCount);
+
+        for (size_t i = 0; i < sessionCount; i++) {
+            sessionManagerExited[i]->Set();
+            threads[i].join();
+        }
+    }
+
+    {
+        LocalPool pool;
+        std::vector<std::unique_ptr<LocalProcess>> processes;
+        std::vector<std::unique_ptr<LocalSession>> sessions;
+        for (size_t i = 0; i < sessionCount; i++) {
+            processes.push_back(std::make_unique<LocalProcess>(&pool));
+            processes[i]->AddThread();
+            sessions.push_back(
+                std::make_unique<LocalSession>(&pool, processes[i].get()));
+        }
+
+        auto before = GetMemoryStatus();
+
+        for (auto& session : sessions) {
+            CHECK(session->Start());
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        PrintMemoryPerSession("MainLoop/pool_waits", before, GetMemoryStatus(),
+                              sessionCount);
+
+        for (auto& session : sessions) {
+            session->sessionManagerExited.Set();
+            CHECK(session->WaitForEnd() == State::kSessionManagerExited);
+        }
+    }
+}
+
+// The cost of the exit of the waited thread: the threads are enumerated again
+// and the wait is set on the next one.
+void BenchmarkFirstThreadExit() {
+    LocalPool pool;
+    LocalProcess process(&pool);
+    auto* firstThread = process.AddThread();
+    LocalSession session(&pool, &process);
+
+    CHECK(session.Start());
+
+    Benchmark::Run("PoolWaitLoop/first_thread_exit", [&](size_t) {
+        auto* nextThread = process.AddThread();
+
+        int enumerations = session.enumerations;
+        process.ExitThread(firstThread, 0);
+        firstThread = nextThread;
+        while (session.enumerations == enumerations) {
+            std::this_thread::yield();
+        }
+    });
+
+    CHECK(!session.HasEnded());
+    session.sessionManagerExited.Set();
+    CHECK(session.WaitForEnd() == State::kSessionManagerExited);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmark::Init(argc, argv);
+
+    TestSessionManagerExit();
+    TestThreadsExit();
+    TestModConfigChange();
+    TestNoThreads();
+
+    BenchmarkIdleSessions();
+    BenchmarkFirstThreadExit();
+
+    return 0;
+}
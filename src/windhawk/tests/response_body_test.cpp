@@ -0,0 +1,270 @@
+// Tests of the reading of a whole response body, against a local stand-in for
+// an HTTP server which serves a canned response in parts, the way
+// WinHttpReadData returns the data which arrived so far. Checks the buffer
+// growth with an exact, a missing and a wrong Content-Length header, the
+// latter being the compressed size of a body which WinHTTP decompresses, and
+// the propagation of a cancellation. Also benchmarks of a body with and
+// without the header.
+
+#include "stdafx.h"
+
+#include "benchmark.h"
+#include "response_body.h"
+
+namespace {
+
+// Serves the body of a raw HTTP response, at most partSize bytes per read. If
+// decodedBody is set, it's served instead of the body of the response, as if
+// the body were decompressed while it's read.
+class LocalServer {
+   public:
+    LocalServer(std::string_view response,
+                size_t partSize,
+                std::optional<std::string> decodedBody = std::nullopt)
+        : m_partSize(partSize) {
+        size_t headersEnd = response.find("\r\n\r\n");
+        CHECK(headersEnd != response.npos);
+
+        std::string_view headers = response.substr(0, headersEnd);
+        CHECK(headers.starts_with("HTTP/1.1 200 OK"));
+        m_contentLength = HeaderValue(headers, "Content-Length");
+        m_contentEncoding = HeaderValue(headers, "Content-Encoding");
+
+        m_body = decodedBody ? *decodedBody
+                             : std::string(response.substr(headersEnd + 4));
+
+        // Not allocated while the body is read, so that the allocations of
+        // the reading can be counted.
+        m_requests.reserve(1024);
+    }
+
+    // The response headers, as UrlRequest gets them.
+    std::optional<DWORD> contentLength() const {
+        if (!m_contentLength) {
+            return std::nullopt;
+        }
+
+        return static_cast<DWORD>(std::stoul(*m_contentLength));
+    }
+
+    bool decompressed() const {
+        return m_contentEncoding && *m_contentEncoding != "identity";
+    }
+
+    // The sizes which were requested by each read.
+    const std::vector<size_t>& requests() const { return m_requests; }
+
+    // The number of reads of a single byte which returned data, each of
+    // which is followed by the growth of the buffer.
+    size_t growths() const { return m_growths; }
+
+    size_t Read(void* buffer, size_t size) {
+        m_requests.push_back(size);
+        size_t count = std::min({size, m_partSize, m_body.size() - m_offset});
+        memcpy(buffer, m_body.data() + m_offset, count);
+        m_offset += count;
+        if (size == 1 && count == 1) {
+            m_growths++;
+        }
+
+        return count;
+    }
+
+    std::unique_ptr<char[]> ReadToEnd(size_t* length) {
+        return ResponseBody::ReadToEnd(
+            [this](void* buffer, size_t size) { return Read(buffer, size); },
+            ResponseBody::GetInitialCapacity(contentLength(), decompressed()),
+            length);
+    }
+
+   private:
+    static std::optional<std::string> HeaderValue(std::string_view headers,
+                                                  std::string_view name) {
+        std::string prefix = "\r\n" + std::string(name) + ": ";
+        size_t start = headers.find(prefix);
+        if (start == headers.npos) {
+            return std::nullopt;
+        }
+
+        start += prefix.size();
+        size_t end = headers.find("\r\n", start);
+        return std::string(headers.substr(start, end - start));
+    }
+
+    size_t m_partSize;
+    std::optional<std::string> m_contentLength;
+    std::optional<std::string> m_contentEncoding;
+    std::string m_body;
+    size_t m_offset = 0;
+    std::vector<size_t> m_requests;
+    size_t m_growths = 0;
+};
+
+std::string MakeBody(size_t size) {
+    std::string body(size, '\0');
+    for (size_t i = 0; i < size; i++) {
+        body[i] = static_cast<char>('a' + i % 26);
+    }
+
+    return body;
+}
+
+std::string MakeResponse(std::string_view body, bool contentLength) {
+    std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n";
+    if (contentLength) {
+        response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    }
+
+    response += "\r\n";
+    response += body;
+    return response;
+}
+
+void CheckBody(const std::unique_ptr<char[]>& data,
+               size_t length,
+               const std::string& body) {
+    CHECK(length == body.size());
+    CHECK(memcmp(data.get(), body.data(), length) == 0);
+    CHECK(data[length] == '\0');
+}
+
+void TestGetInitialCapacity() {
+    CHECK(ResponseBody::GetInitialCapacity(std::nullopt, false) == 64 * 1024);
+    CHECK(ResponseBody::GetInitialCapacity(0, false) == 1);
+    CHECK(ResponseBody::GetInitialCapacity(1000, false) == 1001);
+
+    // The header isn't trusted for huge sizes.
+    CHECK(ResponseBody::GetInitialCapacity(64 * 1024 * 1024, false) ==
+          64 * 1024);
+
+    // The compressed size isn't used.
+    CHECK(ResponseBody::GetInitialCapacity(1000, true) == 64 * 1024);
+}
+
+void TestExactContentLength() {
+    std::string body = MakeBody(1000);
+    LocalServer server(MakeResponse(body, true), 300);
+
+    uint64_t allocations = Benchmark::AllocationCount();
+    size_t length;
+    auto data = server.ReadToEnd(&length);
+    CHECK(Benchmark::AllocationCount() - allocations == 1);
+    CheckBody(data, length, body);
+
+    // The body fits exactly, and a single byte is read to check that it
+    // ended.
+    CHECK((server.requests() == std::vector<size_t>{1000, 700, 400, 100, 1}));
+    CHECK(server.growths() == 0);
+}
+
+void TestEmptyBody() {
+    for (bool contentLength : {false, true}) {
+        LocalServer server(MakeResponse("", contentLength), 300);
+        size_t length;
+        auto data = server.ReadToEnd(&length);
+        CheckBody(data, length, "");
+        CHECK(server.requests().size() == 1);
+    }
+}
+
+void TestMissingContentLength() {
+    // Grows from 64 KB to 128 KB and 256 KB.
+    std::string body = MakeBody(200 * 1000);
+    LocalServer server(MakeResponse(body, false), 8192);
+
+    size_t length;
+    auto data = server.ReadToEnd(&length);
+    CheckBody(data, length, body);
+    CHECK(server.growths() == 2);
+}
+
+void TestCompressedContentLength() {
+    // The header is the size of the compressed body, which is decompressed
+    // to a larger body while it's read.
+    std::string compressed = MakeBody(300);
+    std::string body = MakeBody(5000);
+    std::string response =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Encoding: gzip\r\n"
+        "Content-Length: 300\r\n"
+        "\r\n" +
+        compressed;
+
+    LocalServer server(response, 1024, body);
+    CHECK(server.decompressed());
+
+    size_t length;
+    auto data = server.ReadToEnd(&length);
+    CheckBody(data, length, body);
+    CHECK(server.growths() == 0);
+
+    // Had the header been used, the buffer would have been grown from 301
+    // bytes to 9632 bytes, which still reads the whole body.
+    LocalServer wrongHintServer(response, 1024, body);
+    data = ResponseBody::ReadToEnd(
+        [&](void* buffer, size_t size) {
+            return wrongHintServer.Read(buffer, size);
+        },
+        ResponseBody::GetInitialCapacity(300, false), &length);
+    CheckBody(data, length, body);
+    CHECK(wrongHintServer.growths() == 5);
+}
+
+void TestCancellation() {
+    std::string body = MakeBody(100 * 1000);
+    LocalServer server(MakeResponse(body, false), 1000);
+
+    // Cancelled before the fourth read, the way UrlRequest checks
+    // isCancelled.
+    size_t reads = 0;
+    bool cancelled = false;
+    try {
+        size_t length;
+        ResponseBody::ReadToEnd(
+            [&](void* buffer, size_t size) {
+                if (++reads == 4) {
+                    throw std::runtime_error("cancelled");
+                }
+
+                return server.Read(buffer, size);
+            },
+            ResponseBody::GetInitialCapacity(std::nullopt, false), &length);
+    } catch (const std::runtime_error&) {
+        cancelled = true;
+    }
+
+    CHECK(cancelled);
+    CHECK(server.requests().size() == 3);
+}
+
+void BenchmarkReadToEnd() {
+    std::string body = MakeBody(1024 * 1024);
+    for (bool contentLength : {true, false}) {
+        std::string response = MakeResponse(body, contentLength);
+        std::string name = "ResponseBody::ReadToEnd/1MB_";
+        name += contentLength ? "content_length" : "no_content_length";
+        Benchmark::Run(name, [&](size_t) {
+            LocalServer server(response, 16 * 1024);
+            size_t length;
+            auto data = server.ReadToEnd(&length);
+            CHECK(length == body.size());
+        });
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmark::Init(argc, argv);
+
+    TestGetInitialCapacity();
+    TestExactContentLength();
+    TestEmptyBody();
+    TestMissingContentLength();
+    TestCompressedContentLength();
+    TestCancellation();
+
+    BenchmarkReadToEnd();
+
+    return 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// SlimDetours replacement for building MinHook on Linux. Transactions always
+// succeed and no code is patched, which leaves the MinHook hook table logic to
+// be measured on its own.
+
+#include <windows.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _DETOUR_TRANSACTION_OPTIONS {
+    BOOL fSuspendThreads;
+} DETOUR_TRANSACTION_OPTIONS, *PDETOUR_TRANSACTION_OPTIONS;
+
+typedef const DETOUR_TRANSACTION_OPTIONS* PCDETOUR_TRANSACTION_OPTIONS;
+
+typedef struct _DETOUR_DETACH_OPTIONS {
+    PVOID* ppTrampolineToFreeManually;
+} DETOUR_DETACH_OPTIONS, *PDETOUR_DETACH_OPTIONS;
+
+typedef const DETOUR_DETACH_OPTIONS* PCDETOUR_DETACH_OPTIONS;
+
+HRESULT NTAPI
+SlimDetoursTransactionBeginEx(PCDETOUR_TRANSACTION_OPTIONS pOptions);
+HRESULT NTAPI SlimDetoursTransactionAbort(VOID);
+HRESULT NTAPI SlimDetoursTransactionCommit(VOID);
+HRESULT NTAPI SlimDetoursAttach(PVOID* ppPointer, PVOID pDetour);
+HRESULT NTAPI SlimDetoursDetachEx(PVOID* ppPointer,
+                                  PVOID pDetour,
+                                  PCDETOUR_DETACH_OPTIONS pOptions);
+HRESULT NTAPI SlimDetoursFreeTrampoline(PVOID pTrampoline);
+HRESULT NTAPI SlimDetoursSetDetour(PVOID pPointer,
+                                   PVOID pDetour,
+                                   PVOID pNewDetour);
+HRESULT NTAPI SlimDetoursUninitialize(VOID);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
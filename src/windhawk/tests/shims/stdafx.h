@@ -0,0 +1,86 @@
+#pragma once
+
+// Replaces the precompiled header of the engine and the app when building their
+// portable parts on Linux, see windows.h.
+
+#include <windows.h>
+
+// STL
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+using namespace std::string_view_literals;
+
+// CRT
+
+template <size_t N, typename... Args>
+int sprintf_s(char (&buffer)[N], const char* format, Args... args) {
+    return snprintf(buffer, N, format, args...);
+}
+
+template <size_t N, typename... Args>
+int swprintf_s(wchar_t (&buffer)[N], const wchar_t* format, Args... args) {
+    return swprintf(buffer, N, format, args...);
+}
+
+inline int _wcsnicmp(const wchar_t* a, const wchar_t* b, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        wint_t ca = towlower(a[i]);
+        wint_t cb = towlower(b[i]);
+        if (ca != cb) {
+            return ca < cb ? -1 : 1;
+        }
+
+        if (!ca) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+// Libraries
+
+#include "wil_shims.h"
+
+// For the app targets, which have nlohmann/json in the include paths.
+#if __has_include(<nlohmann/json.hpp>)
+#define JSON_USE_IMPLICIT_CONVERSIONS 0
+#include <nlohmann/json.hpp>
+#endif
+
+// Disasm engine, for the targets which define the architecture, see
+// CMakeLists.txt.
+#if defined(_M_IX86) || defined(_M_X64)
+#include <Zydis/Zydis.h>
+#elif defined(_M_ARM64)
+#include <binaryninja-arm64-disassembler/decompose_and_disassemble.h>
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+// The subset of WIL which is used by the portable sources.
+
+namespace wil {
+
+template <typename To, typename From>
+To safe_cast(From value) {
+    if (!std::in_range<To>(value)) {
+        throw std::overflow_error("wil::safe_cast");
+    }
+
+    return static_cast<To>(value);
+}
+
+template <typename String>
+String ExpandEnvironmentStrings(PCWSTR input) {
+    String result;
+    result.resize(::ExpandEnvironmentStringsW(input, nullptr, 0));
+    DWORD length = ::ExpandEnvironmentStringsW(
+        input, result.data(), safe_cast<DWORD>(result.length()));
+    result.resize(length ? length - 1 : 0);
+    return result;
+}
+
+// Only used as a member, no keys are ever opened.
+class unique_hkey {
+   public:
+    unique_hkey() = default;
+    unique_hkey(const unique_hkey&) = delete;
+    unique_hkey& operator=(const unique_hkey&) = delete;
+    ~unique_hkey() { reset(); }
+
+    HKEY get() const { return m_key; }
+
+    HKEY* operator&() {
+        reset();
+        return &m_key;
+    }
+
+    void reset() {
+        if (m_key) {
+            RegCloseKey(m_key);
+            m_key = nullptr;
+        }
+    }
+
+   private:
+    HKEY m_key = nullptr;
+};
+
+}  // namespace wil
@@ -0,0 +1,559 @@
+#pragma once
+
+// A thin subset of the Win32 API, which allows building the portable parts of
+// the engine on Linux. Only what these parts use is declared. The functions are
+// implemented in windows_shims.cpp, in the simplest way which keeps the calling
+// code on its real paths.
+//
+// Must stay valid C, since it's also used for the MinHook sources.
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wchar.h>
+
+#if defined(__x86_64__) || defined(__aarch64__)
+#define _WIN64
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WINAPI
+#define NTAPI
+#define FORCEINLINE static inline
+#define VOID void
+#define CONST const
+
+#define _In_
+#define _In_opt_
+#define _Inout_
+#define _Out_
+#define _Out_opt_
+#define _Outptr_
+
+#define DUMMYSTRUCTNAME
+#define DUMMYUNIONNAME
+
+typedef int BOOL;
+typedef uint8_t BYTE;
+typedef uint8_t UINT8;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t INT32;
+typedef int64_t INT64;
+typedef uint32_t ULONG;
+typedef int32_t LONG;
+typedef unsigned int UINT;
+typedef uint64_t ULONGLONG;
+typedef uintptr_t ULONG_PTR;
+typedef size_t SIZE_T;
+typedef int32_t HRESULT;
+typedef LONG LSTATUS;
+typedef wchar_t WCHAR;
+typedef char CHAR;
+typedef WCHAR* PWSTR;
+typedef WCHAR* LPWSTR;
+typedef const WCHAR* PCWSTR;
+typedef const WCHAR* LPCWSTR;
+typedef const CHAR* PCSTR;
+typedef const CHAR* LPCSTR;
+typedef void* PVOID;
+typedef void* LPVOID;
+typedef const void* LPCVOID;
+typedef ULONG* PULONG;
+typedef DWORD* LPDWORD;
+typedef BYTE* LPBYTE;
+typedef void* HANDLE;
+typedef void* HMODULE;
+typedef void* HINSTANCE;
+typedef void* HKEY;
+typedef void* PSECURITY_DESCRIPTOR;
+typedef DWORD (*LPTHREAD_START_ROUTINE)(LPVOID);
+typedef intptr_t (*FARPROC)(void);
+
+typedef struct _GUID {
+    uint32_t Data1;
+    uint16_t Data2;
+    uint16_t Data3;
+    uint8_t Data4[8];
+} GUID;
+
+typedef struct _SECURITY_ATTRIBUTES {
+    DWORD nLength;
+    LPVOID lpSecurityDescriptor;
+    BOOL bInheritHandle;
+} SECURITY_ATTRIBUTES, *LPSECURITY_ATTRIBUTES;
+
+#define TRUE 1
+#define FALSE 0
+
+#define S_OK ((HRESULT)0)
+#define E_FAIL ((HRESULT)0x80004005)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+#define ERROR_SUCCESS 0L
+#define ERROR_FILE_NOT_FOUND 2L
+#define ERROR_PATH_NOT_FOUND 3L
+#define ERROR_INVALID_PARAMETER 87L
+#define ERROR_MORE_DATA 234L
+#define ERROR_NO_MORE_ITEMS 259L
+
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+
+DWORD WINAPI GetLastError(void);
+void WINAPI SetLastError(DWORD dwErrCode);
+
+// Heap.
+
+HANDLE WINAPI GetProcessHeap(void);
+LPVOID WINAPI HeapAlloc(HANDLE hHeap, DWORD dwFlags, SIZE_T dwBytes);
+LPVOID WINAPI HeapReAlloc(HANDLE hHeap,
+                          DWORD dwFlags,
+                          LPVOID lpMem,
+                          SIZE_T dwBytes);
+BOOL WINAPI HeapFree(HANDLE hHeap, DWORD dwFlags, LPVOID lpMem);
+
+// Virtual memory. Every address is reported as committed executable memory.
+
+#define PAGE_EXECUTE 0x10
+#define PAGE_EXECUTE_READ 0x20
+#define PAGE_EXECUTE_READWRITE 0x40
+#define PAGE_EXECUTE_WRITECOPY 0x80
+#define MEM_COMMIT 0x1000
+
+typedef struct _MEMORY_BASIC_INFORMATION {
+    PVOID BaseAddress;
+    PVOID AllocationBase;
+    DWORD AllocationProtect;
+    SIZE_T RegionSize;
+    DWORD State;
+    DWORD Protect;
+    DWORD Type;
+} MEMORY_BASIC_INFORMATION, *PMEMORY_BASIC_INFORMATION;
+
+SIZE_T WINAPI VirtualQuery(LPCVOID lpAddress,
+                           PMEMORY_BASIC_INFORMATION lpBuffer,
+                           SIZE_T dwLength);
+
+// Synchronization.
+
+typedef struct _CRITICAL_SECTION {
+    void* impl;
+} CRITICAL_SECTION, *LPCRITICAL_SECTION;
+
+void WINAPI InitializeCriticalSection(LPCRITICAL_SECTION lpCriticalSection);
+void WINAPI EnterCriticalSection(LPCRITICAL_SECTION lpCriticalSection);
+void WINAPI LeaveCriticalSection(LPCRITICAL_SECTION lpCriticalSection);
+void WINAPI DeleteCriticalSection(LPCRITICAL_SECTION lpCriticalSection);
+
+// Modules. There are no loaded modules.
+
+HMODULE WINAPI GetModuleHandleW(LPCWSTR lpModuleName);
+FARPROC WINAPI GetProcAddress(HMODULE hModule, LPCSTR lpProcName);
+#define GetModuleHandle GetModuleHandleW
+
+// Processes.
+
+HANDLE WINAPI GetCurrentProcess(void);
+BOOL WINAPI IsWow64Process(HANDLE hProcess, BOOL* Wow64Process);
+
+// Strings. Only the default locale is supported, with towupper and towlower
+// semantics.
+
+#define LOCALE_NAME_USER_DEFAULT NULL
+#define LCMAP_LOWERCASE 0x00000100
+#define LCMAP_UPPERCASE 0x00000200
+
+int WINAPI LCMapStringEx(LPCWSTR lpLocaleName,
+                         DWORD dwMapFlags,
+                         LPCWSTR lpSrcStr,
+                         int cchSrc,
+                         LPWSTR lpDestStr,
+                         int cchDest,
+                         void* lpVersionInformation,
+                         LPVOID lpReserved,
+                         ULONG_PTR sortHandle);
+
+// Environment variables, with a fixed set of Windows values.
+
+DWORD WINAPI ExpandEnvironmentStringsW(LPCWSTR lpSrc,
+                                       LPWSTR lpDst,
+                                       DWORD nSize);
+#define ExpandEnvironmentStrings ExpandEnvironmentStringsW
+
+// Files. Only used to create INI files, which are kept in memory, see the
+// profile functions below.
+
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 0x00000001
+#define CREATE_NEW 1
+#define FILE_ATTRIBUTE_NORMAL 0x00000080
+
+HANDLE WINAPI CreateFileW(LPCWSTR lpFileName,
+                          DWORD dwDesiredAccess,
+                          DWORD dwShareMode,
+                          LPSECURITY_ATTRIBUTES lpSecurityAttributes,
+                          DWORD dwCreationDisposition,
+                          DWORD dwFlagsAndAttributes,
+                          HANDLE hTemplateFile);
+BOOL WINAPI WriteFile(HANDLE hFile,
+                      LPCVOID lpBuffer,
+                      DWORD nNumberOfBytesToWrite,
+                      LPDWORD lpNumberOfBytesWritten,
+                      void* lpOverlapped);
+BOOL WINAPI CloseHandle(HANDLE hObject);
+#define CreateFile CreateFileW
+
+// INI files, parsed on each call like the real functions do. The files are
+// kept in memory.
+
+DWORD WINAPI GetPrivateProfileStringW(LPCWSTR lpAppName,
+                                      LPCWSTR lpKeyName,
+                                      LPCWSTR lpDefault,
+                                      LPWSTR lpReturnedString,
+                                      DWORD nSize,
+                                      LPCWSTR lpFileName);
+BOOL WINAPI WritePrivateProfileStringW(LPCWSTR lpAppName,
+                                       LPCWSTR lpKeyName,
+                                       LPCWSTR lpString,
+                                       LPCWSTR lpFileName);
+#define GetPrivateProfileString GetPrivateProfileStringW
+#define WritePrivateProfileString WritePrivateProfileStringW
+
+// Registry. There are no keys, every call fails with ERROR_FILE_NOT_FOUND.
+
+#define REG_SZ 1
+#define REG_BINARY 3
+#define REG_DWORD 4
+#define KEY_QUERY_VALUE 0x0001
+#define KEY_SET_VALUE 0x0002
+#define KEY_READ 0x20019
+#define KEY_WRITE 0x20006
+#define KEY_WOW64_64KEY 0x0100
+
+LSTATUS WINAPI RegCreateKeyExW(HKEY hKey,
+                               LPCWSTR lpSubKey,
+                               DWORD Reserved,
+                               LPWSTR lpClass,
+                               DWORD dwOptions,
+                               DWORD samDesired,
+                               LPSECURITY_ATTRIBUTES lpSecurityAttributes,
+                               HKEY* phkResult,
+                               LPDWORD lpdwDisposition);
+LSTATUS WINAPI RegCloseKey(HKEY hKey);
+LSTATUS WINAPI RegQueryValueExW(HKEY hKey,
+                                LPCWSTR lpValueName,
+                                LPDWORD lpReserved,
+                                LPDWORD lpType,
+                                LPBYTE lpData,
+                                LPDWORD lpcbData);
+LSTATUS WINAPI RegSetValueExW(HKEY hKey,
+                              LPCWSTR lpValueName,
+                              DWORD Reserved,
+                              DWORD dwType,
+                              const BYTE* lpData,
+                              DWORD cbData);
+LSTATUS WINAPI RegDeleteValueW(HKEY hKey, LPCWSTR lpValueName);
+LSTATUS WINAPI RegDeleteKeyExW(HKEY hKey,
+                               LPCWSTR lpSubKey,
+                               DWORD samDesired,
+                               DWORD Reserved);
+LSTATUS WINAPI RegQueryInfoKeyW(HKEY hKey,
+                                LPWSTR lpClass,
+                                LPDWORD lpcchClass,
+                                LPDWORD lpReserved,
+                                LPDWORD lpcSubKeys,
+                                LPDWORD lpcbMaxSubKeyLen,
+                                LPDWORD lpcbMaxClassLen,
+                                LPDWORD lpcValues,
+                                LPDWORD lpcbMaxValueNameLen,
+                                LPDWORD lpcbMaxValueLen,
+                                LPDWORD lpcbSecurityDescriptor,
+                                void* lpftLastWriteTime);
+LSTATUS WINAPI RegEnumValueW(HKEY hKey,
+                             DWORD dwIndex,
+                             LPWSTR lpValueName,
+                             LPDWORD lpcchValueName,
+                             LPDWORD lpReserved,
+                             LPDWORD lpType,
+                             LPBYTE lpData,
+                             LPDWORD lpcbData);
+#define RegCreateKeyEx RegCreateKeyExW
+#define RegQueryValueEx RegQueryValueExW
+#define RegSetValueEx RegSetValueExW
+#define RegDeleteValue RegDeleteValueW
+#define RegDeleteKeyEx RegDeleteKeyExW
+#define RegQueryInfoKey RegQueryInfoKeyW
+#define RegEnumValue RegEnumValueW
+
+// PE image structures, as laid out in memory.
+
+#define IMAGE_DOS_SIGNATURE 0x5A4D
+#define IMAGE_NT_SIGNATURE 0x00004550
+#define IMAGE_NT_OPTIONAL_HDR32_MAGIC 0x10b
+#define IMAGE_NT_OPTIONAL_HDR64_MAGIC 0x20b
+#define IMAGE_NUMBEROF_DIRECTORY_ENTRIES 16
+#define IMAGE_DIRECTORY_ENTRY_EXPORT 0
+#define IMAGE_DIRECTORY_ENTRY_IMPORT 1
+#define IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG 10
+#define IMAGE_SIZEOF_SHORT_NAME 8
+#define IMAGE_SCN_CNT_CODE 0x00000020
+#define IMAGE_SCN_MEM_EXECUTE 0x20000000
+
+typedef struct _IMAGE_DOS_HEADER {
+    WORD e_magic;
+    WORD e_cblp;
+    WORD e_cp;
+    WORD e_crlc;
+    WORD e_cparhdr;
+    WORD e_minalloc;
+    WORD e_maxalloc;
+    WORD e_ss;
+    WORD e_sp;
+    WORD e_csum;
+    WORD e_ip;
+    WORD e_cs;
+    WORD e_lfarlc;
+    WORD e_ovno;
+    WORD e_res[4];
+    WORD e_oemid;
+    WORD e_oeminfo;
+    WORD e_res2[10];
+    LONG e_lfanew;
+} IMAGE_DOS_HEADER, *PIMAGE_DOS_HEADER;
+
+typedef struct _IMAGE_FILE_HEADER {
+    WORD Machine;
+    WORD NumberOfSections;
+    DWORD TimeDateStamp;
+    DWORD PointerToSymbolTable;
+    DWORD NumberOfSymbols;
+    WORD SizeOfOptionalHeader;
+    WORD Characteristics;
+} IMAGE_FILE_HEADER, *PIMAGE_FILE_HEADER;
+
+typedef struct _IMAGE_DATA_DIRECTORY {
+    DWORD VirtualAddress;
+    DWORD Size;
+} IMAGE_DATA_DIRECTORY, *PIMAGE_DATA_DIRECTORY;
+
+typedef struct _IMAGE_OPTIONAL_HEADER {
+    WORD Magic;
+    BYTE MajorLinkerVersion;
+    BYTE MinorLinkerVersion;
+    DWORD SizeOfCode;
+    DWORD SizeOfInitializedData;
+    DWORD SizeOfUninitializedData;
+    DWORD AddressOfEntryPoint;
+    DWORD BaseOfCode;
+    DWORD BaseOfData;
+    DWORD ImageBase;
+    DWORD SectionAlignment;
+    DWORD FileAlignment;
+    WORD MajorOperatingSystemVersion;
+    WORD MinorOperatingSystemVersion;
+    WORD MajorImageVersion;
+    WORD MinorImageVersion;
+    WORD MajorSubsystemVersion;
+    WORD MinorSubsystemVersion;
+    DWORD Win32VersionValue;
+    DWORD SizeOfImage;
+    DWORD SizeOfHeaders;
+    DWORD CheckSum;
+    WORD Subsystem;
+    WORD DllCharacteristics;
+    DWORD SizeOfStackReserve;
+    DWORD SizeOfStackCommit;
+    DWORD SizeOfHeapReserve;
+    DWORD SizeOfHeapCommit;
+    DWORD LoaderFlags;
+    DWORD NumberOfRvaAndSizes;
+    IMAGE_DATA_DIRECTORY DataDirectory[IMAGE_NUMBEROF_DIRECTORY_ENTRIES];
+} IMAGE_OPTIONAL_HEADER32, *PIMAGE_OPTIONAL_HEADER32;
+
+typedef struct _IMAGE_OPTIONAL_HEADER64 {
+    WORD Magic;
+    BYTE MajorLinkerVersion;
+    BYTE MinorLinkerVersion;
+    DWORD SizeOfCode;
+    DWORD SizeOfInitializedData;
+    DWORD SizeOfUninitializedData;
+    DWORD AddressOfEntryPoint;
+    DWORD BaseOfCode;
+    ULONGLONG ImageBase;
+    DWORD SectionAlignment;
+    DWORD FileAlignment;
+    WORD MajorOperatingSystemVersion;
+    WORD MinorOperatingSystemVersion;
+    WORD MajorImageVersion;
+    WORD MinorImageVersion;
+    WORD MajorSubsystemVersion;
+    WORD MinorSubsystemVersion;
+    DWORD Win32VersionValue;
+    DWORD SizeOfImage;
+    DWORD SizeOfHeaders;
+    DWORD CheckSum;
+    WORD Subsystem;
+    WORD DllCharacteristics;
+    ULONGLONG SizeOfStackReserve;
+    ULONGLONG SizeOfStackCommit;
+    ULONGLONG SizeOfHeapReserve;
+    ULONGLONG SizeOfHeapCommit;
+    DWORD LoaderFlags;
+    DWORD NumberOfRvaAndSizes;
+    IMAGE_DATA_DIRECTORY DataDirectory[IMAGE_NUMBEROF_DIRECTORY_ENTRIES];
+} IMAGE_OPTIONAL_HEADER64, *PIMAGE_OPTIONAL_HEADER64;
+
+typedef struct _IMAGE_NT_HEADERS {
+    DWORD Signature;
+    IMAGE_FILE_HEADER FileHeader;
+    IMAGE_OPTIONAL_HEADER32 OptionalHeader;
+} IMAGE_NT_HEADERS32, *PIMAGE_NT_HEADERS32;
+
+typedef struct _IMAGE_NT_HEADERS64 {
+    DWORD Signature;
+    IMAGE_FILE_HEADER FileHeader;
+    IMAGE_OPTIONAL_HEADER64 OptionalHeader;
+} IMAGE_NT_HEADERS64, *PIMAGE_NT_HEADERS64;
+
+#ifdef _WIN64
+typedef IMAGE_NT_HEADERS64 IMAGE_NT_HEADERS;
+#else
+typedef IMAGE_NT_HEADERS32 IMAGE_NT_HEADERS;
+#endif
+
+typedef struct _IMAGE_SECTION_HEADER {
+    BYTE Name[IMAGE_SIZEOF_SHORT_NAME];
+    union {
+        DWORD PhysicalAddress;
+        DWORD VirtualSize;
+    } Misc;
+    DWORD VirtualAddress;
+    DWORD SizeOfRawData;
+    DWORD PointerToRawData;
+    DWORD PointerToRelocations;
+    DWORD PointerToLinenumbers;
+    WORD NumberOfRelocations;
+    WORD NumberOfLinenumbers;
+    DWORD Characteristics;
+} IMAGE_SECTION_HEADER, *PIMAGE_SECTION_HEADER;
+
+#define IMAGE_FIRST_SECTION(ntheader)                                 \
+    ((PIMAGE_SECTION_HEADER)((ULONG_PTR)(ntheader) +                  \
+                             offsetof(IMAGE_NT_HEADERS64, OptionalHeader) + \
+                             (ntheader)->FileHeader.SizeOfOptionalHeader))
+
+typedef struct _IMAGE_EXPORT_DIRECTORY {
+    DWORD Characteristics;
+    DWORD TimeDateStamp;
+    WORD MajorVersion;
+    WORD MinorVersion;
+    DWORD Name;
+    DWORD Base;
+    DWORD NumberOfFunctions;
+    DWORD NumberOfNames;
+    DWORD AddressOfFunctions;
+    DWORD AddressOfNames;
+    DWORD AddressOfNameOrdinals;
+} IMAGE_EXPORT_DIRECTORY, *PIMAGE_EXPORT_DIRECTORY;
+
+typedef struct _IMAGE_IMPORT_DESCRIPTOR {
+    union {
+        DWORD Characteristics;
+        DWORD OriginalFirstThunk;
+    } DUMMYUNIONNAME;
+    DWORD TimeDateStamp;
+    DWORD ForwarderChain;
+    DWORD Name;
+    DWORD FirstThunk;
+} IMAGE_IMPORT_DESCRIPTOR, *PIMAGE_IMPORT_DESCRIPTOR;
+
+#define LOWORD(l) ((WORD)(((ULONG_PTR)(l)) & 0xffff))
+#define IS_INTRESOURCE(r) ((((ULONG_PTR)(r)) >> 16) == 0)
+#define MAKEINTRESOURCEA(i) ((LPCSTR)((ULONG_PTR)((WORD)(i))))
+
+typedef struct _IMAGE_LOAD_CONFIG_CODE_INTEGRITY {
+    WORD Flags;
+    WORD Catalog;
+    DWORD CatalogOffset;
+    DWORD Reserved;
+} IMAGE_LOAD_CONFIG_CODE_INTEGRITY;
+
+// Only the fields up to CHPEMetadataPointer.
+typedef struct _IMAGE_LOAD_CONFIG_DIRECTORY32 {
+    DWORD Size;
+    DWORD TimeDateStamp;
+    WORD MajorVersion;
+    WORD MinorVersion;
+    DWORD GlobalFlagsClear;
+    DWORD GlobalFlagsSet;
+    DWORD CriticalSectionDefaultTimeout;
+    DWORD DeCommitFreeBlockThreshold;
+    DWORD DeCommitTotalFreeThreshold;
+    DWORD LockPrefixTable;
+    DWORD MaximumAllocationSize;
+    DWORD VirtualMemoryThreshold;
+    DWORD ProcessHeapFlags;
+    DWORD ProcessAffinityMask;
+    WORD CSDVersion;
+    WORD DependentLoadFlags;
+    DWORD EditList;
+    DWORD SecurityCookie;
+    DWORD SEHandlerTable;
+    DWORD SEHandlerCount;
+    DWORD GuardCFCheckFunctionPointer;
+    DWORD GuardCFDispatchFunctionPointer;
+    DWORD GuardCFFunctionTable;
+    DWORD GuardCFFunctionCount;
+    DWORD GuardFlags;
+    IMAGE_LOAD_CONFIG_CODE_INTEGRITY CodeIntegrity;
+    DWORD GuardAddressTakenIatEntryTable;
+    DWORD GuardAddressTakenIatEntryCount;
+    DWORD GuardLongJumpTargetTable;
+    DWORD GuardLongJumpTargetCount;
+    DWORD DynamicValueRelocTable;
+    DWORD CHPEMetadataPointer;
+} IMAGE_LOAD_CONFIG_DIRECTORY32, *PIMAGE_LOAD_CONFIG_DIRECTORY32;
+
+// Only the fields up to CHPEMetadataPointer.
+typedef struct _IMAGE_LOAD_CONFIG_DIRECTORY64 {
+    DWORD Size;
+    DWORD TimeDateStamp;
+    WORD MajorVersion;
+    WORD MinorVersion;
+    DWORD GlobalFlagsClear;
+    DWORD GlobalFlagsSet;
+    DWORD CriticalSectionDefaultTimeout;
+    ULONGLONG DeCommitFreeBlockThreshold;
+    ULONGLONG DeCommitTotalFreeThreshold;
+    ULONGLONG LockPrefixTable;
+    ULONGLONG MaximumAllocationSize;
+    ULONGLONG VirtualMemoryThreshold;
+    ULONGLONG ProcessAffinityMask;
+    DWORD ProcessHeapFlags;
+    WORD CSDVersion;
+    WORD DependentLoadFlags;
+    ULONGLONG EditList;
+    ULONGLONG SecurityCookie;
+    ULONGLONG SEHandlerTable;
+    ULONGLONG SEHandlerCount;
+    ULONGLONG GuardCFCheckFunctionPointer;
+    ULONGLONG GuardCFDispatchFunctionPointer;
+    ULONGLONG GuardCFFunctionTable;
+    ULONGLONG GuardCFFunctionCount;
+    DWORD GuardFlags;
+    IMAGE_LOAD_CONFIG_CODE_INTEGRITY CodeIntegrity;
+    ULONGLONG GuardAddressTakenIatEntryTable;
+    ULONGLONG GuardAddressTakenIatEntryCount;
+    ULONGLONG GuardLongJumpTargetTable;
+    ULONGLONG GuardLongJumpTargetCount;
+    ULONGLONG DynamicValueRelocTable;
+    ULONGLONG CHPEMetadataPointer;
+} IMAGE_LOAD_CONFIG_DIRECTORY64, *PIMAGE_LOAD_CONFIG_DIRECTORY64;
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
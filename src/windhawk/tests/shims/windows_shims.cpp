@@ -0,0 +1,560 @@
+#include "stdafx.h"
+
+#include "SlimDetours/SlimDetours.h"
+
+namespace {
+
+thread_local DWORD g_lastError;
+
+std::wstring_view Trim(std::wstring_view s) {
+    while (!s.empty() && (s.front() == L' ' || s.front() == L'\t')) {
+        s.remove_prefix(1);
+    }
+
+    while (!s.empty() && (s.back() == L' ' || s.back() == L'\t' ||
+                          s.back() == L'\r')) {
+        s.remove_suffix(1);
+    }
+
+    return s;
+}
+
+bool EqualsIgnoreCase(std::wstring_view a, std::wstring_view b) {
+    return a.length() == b.length() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](WCHAR x, WCHAR y) {
+               return towupper(x) == towupper(y);
+           });
+}
+
+// The INI files, by file name. The files are kept as text, which is parsed on
+// each call, like the real profile functions do.
+std::map<std::wstring, std::wstring>& IniFiles() {
+    static std::map<std::wstring, std::wstring> files;
+    return files;
+}
+
+std::mutex g_iniFilesMutex;
+
+struct IniLine {
+    size_t begin;
+    size_t end;
+    std::wstring_view text;
+};
+
+template <typename Callback>
+void ForEachIniLine(const std::wstring& file, Callback callback) {
+    size_t begin = 0;
+    while (begin < file.length()) {
+        size_t end = file.find(L'\n', begin);
+        if (end == file.npos) {
+            end = file.length();
+        } else {
+            end++;
+        }
+
+        std::wstring_view text(file.data() + begin, end - begin);
+        if (!text.empty() && text.back() == L'\n') {
+            text.remove_suffix(1);
+        }
+
+        if (!callback(IniLine{begin, end, Trim(text)})) {
+            break;
+        }
+
+        begin = end;
+    }
+}
+
+bool IsSectionLine(std::wstring_view line, std::wstring_view* name) {
+    if (line.length() < 2 || line.front() != L'[' || line.back() != L']') {
+        return false;
+    }
+
+    *name = line.substr(1, line.length() - 2);
+    return true;
+}
+
+bool IsKeyLine(std::wstring_view line,
+               std::wstring_view* key,
+               std::wstring_view* value) {
+    size_t equals = line.find(L'=');
+    if (equals == line.npos) {
+        return false;
+    }
+
+    *key = Trim(line.substr(0, equals));
+    *value = Trim(line.substr(equals + 1));
+    return true;
+}
+
+DWORD CopyProfileString(std::wstring_view value,
+                        LPWSTR buffer,
+                        DWORD size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    if (value.length() + 1 > size) {
+        value = value.substr(0, size - 1);
+        g_lastError = ERROR_MORE_DATA;
+    }
+
+    std::copy(value.begin(), value.end(), buffer);
+    buffer[value.length()] = L'\0';
+    return static_cast<DWORD>(value.length());
+}
+
+}  // namespace
+
+extern "C" {
+
+DWORD WINAPI GetLastError(void) {
+    return g_lastError;
+}
+
+void WINAPI SetLastError(DWORD dwErrCode) {
+    g_lastError = dwErrCode;
+}
+
+HANDLE WINAPI GetProcessHeap(void) {
+    return reinterpret_cast<HANDLE>(1);
+}
+
+LPVOID WINAPI HeapAlloc(HANDLE hHeap, DWORD dwFlags, SIZE_T dwBytes) {
+    return malloc(dwBytes);
+}
+
+LPVOID WINAPI HeapReAlloc(HANDLE hHeap,
+                          DWORD dwFlags,
+                          LPVOID lpMem,
+                          SIZE_T dwBytes) {
+    return realloc(lpMem, dwBytes);
+}
+
+BOOL WINAPI HeapFree(HANDLE hHeap, DWORD dwFlags, LPVOID lpMem) {
+    free(lpMem);
+    return TRUE;
+}
+
+SIZE_T WINAPI VirtualQuery(LPCVOID lpAddress,
+                           PMEMORY_BASIC_INFORMATION lpBuffer,
+                           SIZE_T dwLength) {
+    *lpBuffer = MEMORY_BASIC_INFORMATION{
+        .BaseAddress = const_cast<void*>(lpAddress),
+        .AllocationBase = const_cast<void*>(lpAddress),
+        .AllocationProtect = PAGE_EXECUTE_READ,
+        .RegionSize = 0x1000,
+        .State = MEM_COMMIT,
+        .Protect = PAGE_EXECUTE_READ,
+    };
+    return sizeof(*lpBuffer);
+}
+
+void WINAPI InitializeCriticalSection(LPCRITICAL_SECTION lpCriticalSection) {
+    lpCriticalSection->impl = new std::recursive_mutex;
+}
+
+void WINAPI EnterCriticalSection(LPCRITICAL_SECTION lpCriticalSection) {
+    static_cast<std::recursive_mutex*>(lpCriticalSection->impl)->lock();
+}
+
+void WINAPI LeaveCriticalSection(LPCRITICAL_SECTION lpCriticalSection) {
+    static_cast<std::recursive_mutex*>(lpCriticalSection->impl)->unlock();
+}
+
+void WINAPI DeleteCriticalSection(LPCRITICAL_SECTION lpCriticalSection) {
+    delete static_cast<std::recursive_mutex*>(lpCriticalSection->impl);
+    lpCriticalSection->impl = nullptr;
+}
+
+HMODULE WINAPI GetModuleHandleW(LPCWSTR lpModuleName) {
+    g_lastError = ERROR_FILE_NOT_FOUND;
+    return nullptr;
+}
+
+FARPROC WINAPI GetProcAddress(HMODULE hModule, LPCSTR lpProcName) {
+    g_lastError = ERROR_FILE_NOT_FOUND;
+    return nullptr;
+}
+
+HANDLE WINAPI GetCurrentProcess(void) {
+    return reinterpret_cast<HANDLE>(-1);
+}
+
+BOOL WINAPI IsWow64Process(HANDLE hProcess, BOOL* Wow64Process) {
+    *Wow64Process = FALSE;
+    return TRUE;
+}
+
+int WINAPI LCMapStringEx(LPCWSTR lpLocaleName,
+                         DWORD dwMapFlags,
+                         LPCWSTR lpSrcStr,
+                         int cchSrc,
+                         LPWSTR lpDestStr,
+                         int cchDest,
+                         void* lpVersionInformation,
+                         LPVOID lpReserved,
+                         ULONG_PTR sortHandle) {
+    if (cchSrc < 0) {
+        cchSrc = static_cast<int>(wcslen(lpSrcStr)) + 1;
+    }
+
+    if (cchDest < cchSrc) {
+        g_lastError = ERROR_INVALID_PARAMETER;
+        return 0;
+    }
+
+    for (int i = 0; i < cchSrc; i++) {
+        lpDestStr[i] = (dwMapFlags & LCMAP_UPPERCASE) ? towupper(lpSrcStr[i])
+                                                      : towlower(lpSrcStr[i]);
+    }
+
+    return cchSrc;
+}
+
+DWORD WINAPI ExpandEnvironmentStringsW(LPCWSTR lpSrc,
+                                       LPWSTR lpDst,
+                                       DWORD nSize) {
+    static const std::pair<std::wstring_view, std::wstring_view> kVariables[] =
+        {
+            {L"ProgramFiles", L"C:\\Program Files"},
+            {L"ProgramFiles(x86)", L"C:\\Program Files (x86)"},
+            {L"ProgramW6432", L"C:\\Program Files"},
+            {L"SystemRoot", L"C:\\Windows"},
+            {L"windir", L"C:\\Windows"},
+        };
+
+    std::wstring_view source = lpSrc;
+    std::wstring result;
+    while (!source.empty()) {
+        size_t begin = source.find(L'%');
+        size_t end = begin == source.npos ? source.npos
+                                          : source.find(L'%', begin + 1);
+        if (end == source.npos) {
+            result += source;
+            break;
+        }
+
+        result += source.substr(0, begin);
+
+        auto name = source.substr(begin + 1, end - begin - 1);
+        auto it = std::find_if(
+            std::begin(kVariables), std::end(kVariables),
+            [name](const auto& v) { return EqualsIgnoreCase(v.first, name); });
+        if (it != std::end(kVariables)) {
+            result += it->second;
+            source.remove_prefix(end + 1);
+        } else {
+            // Unknown variables are left as is, and the closing % might begin
+            // another variable.
+            result += source.substr(begin, end - begin);
+            source.remove_prefix(end);
+        }
+    }
+
+    DWORD required = static_cast<DWORD>(result.length() + 1);
+    if (lpDst && nSize >= required) {
+        std::copy(result.begin(), result.end(), lpDst);
+        lpDst[result.length()] = L'\0';
+    }
+
+    return required;
+}
+
+HANDLE WINAPI CreateFileW(LPCWSTR lpFileName,
+                          DWORD dwDesiredAccess,
+                          DWORD dwShareMode,
+                          LPSECURITY_ATTRIBUTES lpSecurityAttributes,
+                          DWORD dwCreationDisposition,
+                          DWORD dwFlagsAndAttributes,
+                          HANDLE hTemplateFile) {
+    std::lock_guard lock(g_iniFilesMutex);
+
+    if (!IniFiles().try_emplace(lpFileName).second) {
+        g_lastError = 80;  // ERROR_FILE_EXISTS
+        return INVALID_HANDLE_VALUE;
+    }
+
+    return reinterpret_cast<HANDLE>(2);
+}
+
+BOOL WINAPI WriteFile(HANDLE hFile,
+                      LPCVOID lpBuffer,
+                      DWORD nNumberOfBytesToWrite,
+                      LPDWORD lpNumberOfBytesWritten,
+                      void* lpOverlapped) {
+    // Only used for the UTF-16 BOM, which isn't kept.
+    *lpNumberOfBytesWritten = nNumberOfBytesToWrite;
+    return TRUE;
+}
+
+BOOL WINAPI CloseHandle(HANDLE hObject) {
+    return TRUE;
+}
+
+DWORD WINAPI GetPrivateProfileStringW(LPCWSTR lpAppName,
+                                      LPCWSTR lpKeyName,
+                                      LPCWSTR lpDefault,
+                                      LPWSTR lpReturnedString,
+                                      DWORD nSize,
+                                      LPCWSTR lpFileName) {
+    std::lock_guard lock(g_iniFilesMutex);
+
+    std::wstring_view defaultValue = lpDefault ? lpDefault : L"";
+
+    auto file = IniFiles().find(lpFileName);
+    if (file == IniFiles().end()) {
+        g_lastError = ERROR_FILE_NOT_FOUND;
+        return CopyProfileString(defaultValue, lpReturnedString, nSize);
+    }
+
+    // Key names are returned as a list of null-terminated strings, terminated
+    // with an extra null.
+    std::wstring keyNames;
+    std::optional<std::wstring_view> value;
+    bool inSection = false;
+    ForEachIniLine(file->second, [&](const IniLine& line) {
+        std::wstring_view section;
+        if (IsSectionLine(line.text, &section)) {
+            inSection = EqualsIgnoreCase(section, lpAppName);
+            return true;
+        }
+
+        std::wstring_view key;
+        std::wstring_view lineValue;
+        if (!inSection || !IsKeyLine(line.text, &key, &lineValue)) {
+            return true;
+        }
+
+        if (!lpKeyName) {
+            keyNames += key;
+            keyNames += L'\0';
+            return true;
+        }
+
+        if (!EqualsIgnoreCase(key, lpKeyName)) {
+            return true;
+        }
+
+        value = lineValue;
+        return false;
+    });
+
+    if (!lpKeyName) {
+        if (keyNames.length() + 1 > nSize) {
+            if (nSize < 2) {
+                return 0;
+            }
+
+            std::copy_n(keyNames.begin(), nSize - 2, lpReturnedString);
+            lpReturnedString[nSize - 2] = L'\0';
+            lpReturnedString[nSize - 1] = L'\0';
+            g_lastError = ERROR_MORE_DATA;
+            return nSize - 2;
+        }
+
+        std::copy(keyNames.begin(), keyNames.end(), lpReturnedString);
+        lpReturnedString[keyNames.length()] = L'\0';
+        return static_cast<DWORD>(keyNames.length());
+    }
+
+    if (!value) {
+        g_lastError = ERROR_FILE_NOT_FOUND;
+        return CopyProfileString(defaultValue, lpReturnedString, nSize);
+    }
+
+    if (value->length() >= 2 && value->front() == value->back() &&
+        (value->front() == L'"' || value->front() == L'\'')) {
+        *value = value->substr(1, value->length() - 2);
+    }
+
+    return CopyProfileString(*value, lpReturnedString, nSize);
+}
+
+BOOL WINAPI WritePrivateProfileStringW(LPCWSTR lpAppName,
+                                       LPCWSTR lpKeyName,
+                                       LPCWSTR lpString,
+                                       LPCWSTR lpFileName) {
+    std::lock_guard lock(g_iniFilesMutex);
+
+    auto& file = IniFiles()[lpFileName];
+
+    // The ranges of the section, from its header line to its end, and of the
+    // key line.
+    std::optional<size_t> sectionBegin;
+    std::optional<size_t> sectionEnd;
+    std::optional<std::pair<size_t, size_t>> keyLine;
+    ForEachIniLine(file, [&](const IniLine& line) {
+        std::wstring_view section;
+        if (IsSectionLine(line.text, &section)) {
+            if (sectionBegin) {
+                sectionEnd = line.begin;
+                return false;
+            }
+
+            if (EqualsIgnoreCase(section, lpAppName)) {
+                sectionBegin = line.begin;
+            }
+
+            return true;
+        }
+
+        std::wstring_view key;
+        std::wstring_view value;
+        if (sectionBegin && lpKeyName && IsKeyLine(line.text, &key, &value) &&
+            EqualsIgnoreCase(key, lpKeyName)) {
+            keyLine = {line.begin, line.end};
+        }
+
+        return true;
+    });
+
+    if (sectionBegin && !sectionEnd) {
+        sectionEnd = file.length();
+    }
+
+    if (!lpKeyName) {
+        if (sectionBegin) {
+            file.erase(*sectionBegin, *sectionEnd - *sectionBegin);
+        }
+
+        return TRUE;
+    }
+
+    if (!lpString) {
+        if (keyLine) {
+            file.erase(keyLine->first, keyLine->second - keyLine->first);
+        }
+
+        return TRUE;
+    }
+
+    std::wstring newLine = lpKeyName;
+    newLine += L'=';
+    newLine += lpString;
+    newLine += L"\r\n";
+
+    if (keyLine) {
+        file.replace(keyLine->first, keyLine->second - keyLine->first,
+                     newLine);
+    } else if (sectionBegin) {
+        file.insert(*sectionEnd, newLine);
+    } else {
+        file += L'[';
+        file += lpAppName;
+        file += L"]\r\n";
+        file += newLine;
+    }
+
+    return TRUE;
+}
+
+LSTATUS WINAPI RegCreateKeyExW(HKEY hKey,
+                               LPCWSTR lpSubKey,
+                               DWORD Reserved,
+                               LPWSTR lpClass,
+                               DWORD dwOptions,
+                               DWORD samDesired,
+                               LPSECURITY_ATTRIBUTES lpSecurityAttributes,
+                               HKEY* phkResult,
+                               LPDWORD lpdwDisposition) {
+    return ERROR_FILE_NOT_FOUND;
+}
+
+LSTATUS WINAPI RegCloseKey(HKEY hKey) {
+    return ERROR_SUCCESS;
+}
+
+LSTATUS WINAPI RegQueryValueExW(HKEY hKey,
+                                LPCWSTR lpValueName,
+                                LPDWORD lpReserved,
+                                LPDWORD lpType,
+                                LPBYTE lpData,
+                                LPDWORD lpcbData) {
+    return ERROR_FILE_NOT_FOUND;
+}
+
+LSTATUS WINAPI RegSetValueExW(HKEY hKey,
+                              LPCWSTR lpValueName,
+                              DWORD Reserved,
+                              DWORD dwType,
+                              const BYTE* lpData,
+                              DWORD cbData) {
+    return ERROR_FILE_NOT_FOUND;
+}
+
+LSTATUS WINAPI RegDeleteValueW(HKEY hKey, LPCWSTR lpValueName) {
+    return ERROR_FILE_NOT_FOUND;
+}
+
+LSTATUS WINAPI RegDeleteKeyExW(HKEY hKey,
+                               LPCWSTR lpSubKey,
+                               DWORD samDesired,
+                               DWORD Reserved) {
+    return ERROR_FILE_NOT_FOUND;
+}
+
+LSTATUS WINAPI RegQueryInfoKeyW(HKEY hKey,
+                                LPWSTR lpClass,
+                                LPDWORD lpcchClass,
+                                LPDWORD lpReserved,
+                                LPDWORD lpcSubKeys,
+                                LPDWORD lpcbMaxSubKeyLen,
+                                LPDWORD lpcbMaxClassLen,
+                                LPDWORD lpcValues,
+                                LPDWORD lpcbMaxValueNameLen,
+                                LPDWORD lpcbMaxValueLen,
+                                LPDWORD lpcbSecurityDescriptor,
+                                void* lpftLastWriteTime) {
+    return ERROR_FILE_NOT_FOUND;
+}
+
+LSTATUS WINAPI RegEnumValueW(HKEY hKey,
+                             DWORD dwIndex,
+                             LPWSTR lpValueName,
+                             LPDWORD lpcchValueName,
+                             LPDWORD lpReserved,
+                             LPDWORD lpType,
+                             LPBYTE lpData,
+                             LPDWORD lpcbData) {
+    return ERROR_NO_MORE_ITEMS;
+}
+
+HRESULT NTAPI
+SlimDetoursTransactionBeginEx(PCDETOUR_TRANSACTION_OPTIONS pOptions) {
+    return S_OK;
+}
+
+HRESULT NTAPI SlimDetoursTransactionAbort(VOID) {
+    return S_OK;
+}
+
+HRESULT NTAPI SlimDetoursTransactionCommit(VOID) {
+    return S_OK;
+}
+
+HRESULT NTAPI SlimDetoursAttach(PVOID* ppPointer, PVOID pDetour) {
+    return S_OK;
+}
+
+HRESULT NTAPI SlimDetoursDetachEx(PVOID* ppPointer,
+                                  PVOID pDetour,
+                                  PCDETOUR_DETACH_OPTIONS pOptions) {
+    return S_OK;
+}
+
+HRESULT NTAPI SlimDetoursFreeTrampoline(PVOID pTrampoline) {
+    return S_OK;
+}
+
+HRESULT NTAPI SlimDetoursSetDetour(PVOID pPointer,
+                                   PVOID pDetour,
+                                   PVOID pNewDetour) {
+    return S_OK;
+}
+
+HRESULT NTAPI SlimDetoursUninitialize(VOID) {
+    return S_OK;
+}
+
+}  // extern "C"
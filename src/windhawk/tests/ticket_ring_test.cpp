@@ -0,0 +1,265 @@
+// A multi-process stress test of the session log ring and the startup profile
+// ring, which share the slot protocol in ticket_ring_slot.h. Writer processes
+// are killed, or suspended and resumed, at random points, which leaves slots
+// in the middle of a write. A reader process checks that every record it gets
+// is intact.
+//
+// Then, with the remaining writers suspended, a new writer must be able to
+// write every record, since the slots of the stalled writers are taken over.
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+#include "session_log_ring.h"
+#include "startup_profile_table.h"
+
+namespace {
+
+// Small rings, so that the writers lap them often.
+constexpr uint32_t kSlotCount = 16;
+constexpr int kWriterCount = 4;
+
+struct ProfileValue {
+    uint32_t processId;
+    uint32_t sequence;
+    uint32_t words[60];
+};
+
+using LogRing = SessionLogRing::Ring<kSlotCount>;
+using LogReader = SessionLogRing::Reader<kSlotCount>;
+using ProfileRing = StartupProfileTable::Ring<ProfileValue, kSlotCount>;
+
+struct Shared {
+    LogRing logRing;
+    ProfileRing profileRing;
+    std::atomic<bool> stopReader;
+    std::atomic<uint64_t> logRecords;
+    std::atomic<uint64_t> profileRecords;
+    std::atomic<uint64_t> lostSlots;
+};
+
+Shared* g_shared;
+
+uint32_t ProfileWord(uint32_t processId, uint32_t sequence, size_t i) {
+    return (processId * 0x9E3779B1u) ^ (sequence * 0x85EBCA77u) ^
+           static_cast<uint32_t>(i * 0xC2B2AE3Du);
+}
+
+ProfileValue MakeProfileValue(uint32_t processId, uint32_t sequence) {
+    ProfileValue value{processId, sequence};
+    for (size_t i = 0; i < std::size(value.words); i++) {
+        value.words[i] = ProfileWord(processId, sequence, i);
+    }
+
+    return value;
+}
+
+// Records of varying length, so that they take from one to the maximum number
+// of slots.
+std::wstring MakeLogText(uint32_t processId, uint32_t sequence) {
+    std::wstring text =
+        std::to_wstring(processId) + L":" + std::to_wstring(sequence) + L":";
+    size_t length = (sequence * 397) % SessionLogRing::kTextMaxLen;
+    while (text.length() < length) {
+        text += static_cast<wchar_t>(
+            L'a' + (processId * 31 + sequence * 7 + text.length()) % 26);
+    }
+
+    return text;
+}
+
+void WriteRecords(uint32_t sequence, bool* logWritten, bool* profileWritten) {
+    uint32_t processId = getpid();
+    std::wstring text = MakeLogText(processId, sequence);
+    *logWritten = g_shared->logRing.Write(
+        processId, sequence, sequence, SessionLogRing::Severity::kInfo,
+        L"writer", text);
+    *profileWritten =
+        g_shared->profileRing.Write(MakeProfileValue(processId, sequence));
+}
+
+[[noreturn]] void WriterProcess() {
+    for (uint32_t sequence = 0;; sequence++) {
+        bool logWritten;
+        bool profileWritten;
+        WriteRecords(sequence, &logWritten, &profileWritten);
+    }
+}
+
+void CheckLogRecord(const SessionLogRing::Record& record) {
+    CHECK(wcscmp(record.channel, L"writer") == 0);
+    CHECK(record.severity == SessionLogRing::Severity::kInfo);
+    CHECK(record.threadId == record.timestamp);
+    CHECK(wcscmp(record.text, MakeLogText(record.processId, record.threadId)
+                                  .c_str()) == 0);
+}
+
+void CheckProfileValue(const ProfileValue& value) {
+    for (size_t i = 0; i < std::size(value.words); i++) {
+        CHECK(value.words[i] ==
+              ProfileWord(value.processId, value.sequence, i));
+    }
+}
+
+[[noreturn]] void ReaderProcess() {
+    LogReader reader(g_shared->logRing);
+    int pendingCount = 0;
+
+    while (!g_shared->stopReader.load()) {
+        SessionLogRing::Record record;
+        switch (reader.Read(&record)) {
+            case LogReader::ReadResult::kRecord:
+                CheckLogRecord(record);
+                g_shared->logRecords++;
+                pendingCount = 0;
+                break;
+
+            case LogReader::ReadResult::kPending:
+                // The writer might be stopped or killed.
+                if (++pendingCount > 1000) {
+                    reader.SkipPending();
+                    pendingCount = 0;
+                }
+                break;
+
+            case LogReader::ReadResult::kEmpty:
+                break;
+        }
+
+        g_shared->profileRing.ForEach([](const ProfileValue& value) {
+            CheckProfileValue(value);
+            g_shared->profileRecords++;
+        });
+    }
+
+    g_shared->lostSlots = reader.GetLostSlotCount();
+    _exit(0);
+}
+
+pid_t Spawn(void (*function)()) {
+    pid_t pid = fork();
+    CHECK(pid != -1);
+    if (pid == 0) {
+        function();
+    }
+
+    return pid;
+}
+
+void KillAndWait(pid_t pid) {
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+}
+
+void WaitForReader(pid_t reader) {
+    g_shared->stopReader = true;
+    int status;
+    CHECK(waitpid(reader, &status, 0) == reader);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    g_shared->stopReader = false;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmark::Init(argc, argv);
+
+    void* memory = mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    CHECK(memory != MAP_FAILED);
+    g_shared = new (memory) Shared{};
+    g_shared->logRing.Initialize(SessionLogRing::kVersion);
+    g_shared->profileRing.Initialize(StartupProfileTable::kVersion);
+
+    // Kill, stop and resume writers at random.
+    pid_t reader = Spawn(ReaderProcess);
+
+    std::vector<pid_t> writers;
+    std::vector<bool> stopped;
+    for (int i = 0; i < kWriterCount; i++) {
+        writers.push_back(Spawn(WriterProcess));
+        stopped.push_back(false);
+    }
+
+    std::mt19937 random(1);
+    int killCount = 0;
+    int stopCount = 0;
+
+    auto end = std::chrono::steady_clock::now() +
+               (Benchmark::IsShortRun() ? std::chrono::seconds(1)
+                                        : std::chrono::seconds(15));
+    while (std::chrono::steady_clock::now() < end) {
+        std::this_thread::sleep_for(
+            std::chrono::microseconds(200 + random() % 2000));
+
+        size_t i = random() % writers.size();
+        if (stopped[i]) {
+            kill(writers[i], SIGCONT);
+            stopped[i] = false;
+        } else if (random() % 2) {
+            KillAndWait(writers[i]);
+            writers[i] = Spawn(WriterProcess);
+            killCount++;
+        } else {
+            kill(writers[i], SIGSTOP);
+            stopped[i] = true;
+            stopCount++;
+        }
+    }
+
+    // Stop all writers, most likely in the middle of a write.
+    for (size_t i = 0; i < writers.size(); i++) {
+        kill(writers[i], SIGSTOP);
+        waitpid(writers[i], nullptr, WUNTRACED);
+    }
+
+    WaitForReader(reader);
+    CHECK(g_shared->logRecords > 0);
+    CHECK(g_shared->profileRecords > 0);
+
+    printf(
+        "kills: %d, stops: %d, log records: %llu, lost log slots: %llu, "
+        "profile records: %llu\n",
+        killCount, stopCount,
+        static_cast<unsigned long long>(g_shared->logRecords.load()),
+        static_cast<unsigned long long>(g_shared->lostSlots.load()),
+        static_cast<unsigned long long>(g_shared->profileRecords.load()));
+
+    // With all other writers stopped, the slots they hold are taken over, and
+    // nothing is dropped.
+    for (uint32_t sequence = 0; sequence < kSlotCount * 8; sequence++) {
+        bool logWritten;
+        bool profileWritten;
+        WriteRecords(sequence, &logWritten, &profileWritten);
+        CHECK(logWritten);
+        CHECK(profileWritten);
+    }
+
+    // Resume the stalled writers. Their remaining stores land in slots which
+    // were taken over, and must not be read as records.
+    g_shared->logRecords = 0;
+    reader = Spawn(ReaderProcess);
+    for (pid_t writer : writers) {
+        kill(writer, SIGCONT);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(
+        Benchmark::IsShortRun() ? 200 : 2000));
+
+    for (pid_t writer : writers) {
+        KillAndWait(writer);
+    }
+
+    WaitForReader(reader);
+    CHECK(g_shared->logRecords > 0);
+
+    return 0;
+}
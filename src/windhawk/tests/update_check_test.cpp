@@ -0,0 +1,410 @@
+// Tests of the parts of the update check which don't need WinHTTP: the gzip
+// compressor of the posted data, which is checked by decompressing with zlib,
+// and the streaming parser of the online data. Also a local stand-in for the
+// update server, which answers checks with a full response, 304 NOT MODIFIED
+// or a 226 IM USED delta, the way UpdateChecker expects, and benchmarks which
+// report the CPU time and the bytes of each kind of check.
+
+#include "stdafx.h"
+
+#include <zlib.h>
+
+#include <random>
+
+#include "benchmark.h"
+#include "gzip.h"
+#include "online_data.h"
+
+namespace {
+
+using json = nlohmann::json;
+
+std::string Gunzip(std::string_view data) {
+    z_stream stream{};
+    CHECK(inflateInit2(&stream, 16 + MAX_WBITS) == Z_OK);
+    stream.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+
+    std::string out;
+    char buffer[16 * 1024];
+    int result;
+    do {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        result = inflate(&stream, Z_NO_FLUSH);
+        CHECK(result == Z_OK || result == Z_STREAM_END);
+        out.append(buffer, sizeof(buffer) - stream.avail_out);
+    } while (result != Z_STREAM_END);
+
+    CHECK(stream.avail_in == 0);
+    inflateEnd(&stream);
+    return out;
+}
+
+std::string ModId(int index) {
+    return "mod-" + std::to_string(index);
+}
+
+// The posted data, as UserProfile builds it.
+std::string MakeUserProfile(int installedModCount) {
+    json profile = {
+        {"id", "{8F1A3C52-6B0D-4E7A-9C21-5D3E8B7F0A14}"},
+        {"os", "10.0.22631"},
+        {"app", {{"version", "1.5.1"}}},
+        {"mods", json::object()},
+    };
+    for (int i = 0; i < installedModCount; i++) {
+        profile["mods"][ModId(i * 7)] = {{"version", "1.0"}};
+    }
+
+    return profile.dump(2);
+}
+
+// A stand-in for the update server. It has the latest version of the app and
+// of each mod, and an ETag for each change. Checks which send the ETag of an
+// older change get a delta with the versions which changed since then.
+class LocalUpdateServer {
+   public:
+    struct Request {
+        std::string body;
+        bool gzip = false;
+        std::optional<std::string> ifNoneMatch;
+        bool acceptsDelta = false;
+    };
+
+    struct Response {
+        int statusCode;
+        std::string etag;
+        bool delta = false;
+        std::string body;
+    };
+
+    explicit LocalUpdateServer(int modCount) {
+        Snapshot snapshot{.appVersion = "1.5.1"};
+        for (int i = 0; i < modCount; i++) {
+            snapshot.modVersions[ModId(i)] = "1.0";
+        }
+
+        m_snapshots.push_back(std::move(snapshot));
+    }
+
+    void SetModVersion(const std::string& modId, const std::string& version) {
+        Snapshot snapshot = m_snapshots.back();
+        snapshot.modVersions[modId] = version;
+        m_snapshots.push_back(std::move(snapshot));
+    }
+
+    std::string CurrentETag() const { return ETag(m_snapshots.size() - 1); }
+
+    Response Handle(const Request& request) {
+        // Checks that the posted data arrived intact.
+        json profile =
+            json::parse(request.gzip ? Gunzip(request.body) : request.body);
+        CHECK(profile["mods"].is_object());
+
+        const Snapshot& current = m_snapshots.back();
+
+        if (request.ifNoneMatch == CurrentETag()) {
+            return {304, CurrentETag()};
+        }
+
+        if (request.ifNoneMatch && request.acceptsDelta) {
+            for (size_t i = 0; i + 1 < m_snapshots.size(); i++) {
+                if (*request.ifNoneMatch == ETag(i)) {
+                    return {226, CurrentETag(), true,
+                            MakeDelta(m_snapshots[i], current)};
+                }
+            }
+        }
+
+        json mods = json::object();
+        for (const auto& [modId, version] : current.modVersions) {
+            mods[modId] = {
+                {"metadata",
+                 {{"name", "Mod " + modId},
+                  {"description", "A mod which customizes " + modId},
+                  {"version", version}}},
+                {"downloads", 1234},
+                {"tags", {"taskbar", "start-menu"}},
+            };
+        }
+
+        json versions = {{"app", {{"version", current.appVersion}}},
+                         {"mods", std::move(mods)}};
+        return {200, CurrentETag(), false, versions.dump()};
+    }
+
+   private:
+    struct Snapshot {
+        std::string appVersion;
+        std::map<std::string, std::string> modVersions;
+    };
+
+    static std::string ETag(size_t index) {
+        return "\"v" + std::to_string(index) + "\"";
+    }
+
+    static std::string MakeDelta(const Snapshot& from, const Snapshot& to) {
+        json delta = {{"mods", json::object()}};
+        if (from.appVersion != to.appVersion) {
+            delta["app"] = to.appVersion;
+        }
+
+        for (const auto& [modId, version] : to.modVersions) {
+            auto it = from.modVersions.find(modId);
+            if (it == from.modVersions.end() || it->second != version) {
+                delta["mods"][modId] = version;
+            }
+        }
+
+        return delta.dump();
+    }
+
+    std::vector<Snapshot> m_snapshots;
+};
+
+// The steps of UpdateChecker and UserProfile.
+class UpdateClient {
+   public:
+    UpdateClient(LocalUpdateServer* server, int installedModCount)
+        : m_server(server), m_postedData(MakeUserProfile(installedModCount)) {
+        json profile = json::parse(m_postedData);
+        for (const auto& [modId, mod] : profile["mods"].items()) {
+            m_modIds.insert(modId);
+        }
+    }
+
+    bool gzip = true;
+    std::optional<std::string> etag;
+    std::optional<std::string> latestAppVersion;
+    std::unordered_map<std::string, std::string> latestModVersions;
+
+    size_t requestBytes = 0;
+    size_t responseBytes = 0;
+
+    int Check() {
+        LocalUpdateServer::Request request{
+            .body = gzip ? Gzip::Compress(m_postedData) : m_postedData,
+            .gzip = gzip,
+            .ifNoneMatch = etag,
+            .acceptsDelta = etag.has_value(),
+        };
+        requestBytes = request.body.size();
+
+        auto response = m_server->Handle(request);
+        responseBytes = response.body.size();
+
+        if (response.statusCode == 304) {
+            return response.statusCode;
+        }
+
+        auto versions = OnlineData::Parse(response.body, m_modIds);
+        if (!response.delta) {
+            CHECK(versions.appVersion);
+            CHECK(versions.hasMods);
+        }
+
+        if (versions.appVersion) {
+            latestAppVersion = versions.appVersion;
+        }
+
+        for (auto& [modId, version] : versions.modVersions) {
+            latestModVersions[modId] = std::move(version);
+        }
+
+        etag = response.etag;
+        return response.statusCode;
+    }
+
+   private:
+    LocalUpdateServer* m_server;
+    std::string m_postedData;
+    std::unordered_set<std::string> m_modIds;
+};
+
+void TestGzipRoundTrip() {
+    std::mt19937 random(1);
+    std::string randomBytes(100 * 1000, '\0');
+    for (char& c : randomBytes) {
+        c = static_cast<char>(random());
+    }
+
+    std::string json = MakeUserProfile(100);
+
+    const std::string inputs[] = {
+        "",
+        "a",
+        "abcabcabcabcabcabcabcabc",
+        // Matches of the maximum length and distance one.
+        std::string(100 * 1000, 'x'),
+        // Matches at the maximum distance.
+        randomBytes.substr(0, 40 * 1024) + randomBytes.substr(0, 40 * 1024),
+        randomBytes,
+        json,
+    };
+
+    for (const auto& input : inputs) {
+        CHECK(Gunzip(Gzip::Compress(input)) == input);
+    }
+
+    CHECK(Gzip::Compress(json).size() < json.size() / 4);
+    CHECK(Gzip::Compress(std::string(100 * 1000, 'x')).size() < 1000);
+}
+
+void TestParseFormats() {
+    std::unordered_set<std::string> modIds = {"a", "b", "c", "d"};
+
+    auto versions = OnlineData::Parse(
+        R"({"app": "1.6", "mods": {"a": "1.1", "b": {"metadata":
+        {"name": "B", "version": "2.0"}}, "other": "3.0"}})",
+        modIds);
+    CHECK(versions.appVersion == "1.6");
+    CHECK(versions.hasMods);
+    CHECK((versions.modVersions ==
+           std::unordered_map<std::string, std::string>{{"a", "1.1"},
+                                                        {"b", "2.0"}}));
+
+    versions = OnlineData::Parse(R"({"app": {"version": "1.7"}, "mods": {}})",
+                                 modIds);
+    CHECK(versions.appVersion == "1.7");
+    CHECK(versions.hasMods);
+    CHECK(versions.modVersions.empty());
+
+    // Values in arrays and at other depths are ignored.
+    versions = OnlineData::Parse(
+        R"({"x": {"app": "9"}, "mods": {"a": ["1"], "b": {"version": "2"},
+        "c": {"metadata": {"version": ["3"], "x": {"version": "4"}}},
+        "d": {"metadata": {"tags": ["5"], "version": "6"}}}})",
+        modIds);
+    CHECK(!versions.appVersion);
+    CHECK((versions.modVersions ==
+           std::unordered_map<std::string, std::string>{{"d", "6"}}));
+
+    // A delta might only have some of the values.
+    versions = OnlineData::Parse(R"({"mods": {"c": "1.2"}})", modIds);
+    CHECK(!versions.appVersion);
+    CHECK(versions.hasMods);
+    CHECK(versions.modVersions.size() == 1);
+
+    versions = OnlineData::Parse(R"({"app": "1.8"})", modIds);
+    CHECK(!versions.hasMods);
+
+    for (const char* invalid : {"", "{", R"({"app": })", "[1, 2", "null x"}) {
+        bool thrown = false;
+        try {
+            OnlineData::Parse(invalid, modIds);
+        } catch (const std::exception&) {
+            thrown = true;
+        }
+
+        CHECK(thrown);
+    }
+}
+
+void TestChecks() {
+    LocalUpdateServer server(2000);
+    UpdateClient client(&server, 30);
+
+    CHECK(client.Check() == 200);
+    CHECK(client.latestAppVersion == "1.5.1");
+    CHECK(client.latestModVersions.size() == 30);
+    CHECK(client.latestModVersions.at(ModId(7)) == "1.0");
+    size_t fullResponseBytes = client.responseBytes;
+
+    CHECK(client.Check() == 304);
+    CHECK(client.responseBytes == 0);
+
+    // A mod which is installed and a mod which isn't are updated.
+    server.SetModVersion(ModId(7), "1.1");
+    server.SetModVersion(ModId(8), "1.1");
+    CHECK(client.Check() == 226);
+    CHECK(client.etag == server.CurrentETag());
+    CHECK(client.latestModVersions.size() == 30);
+    CHECK(client.latestModVersions.at(ModId(7)) == "1.1");
+    CHECK(client.latestModVersions.at(ModId(14)) == "1.0");
+    CHECK(client.responseBytes < fullResponseBytes / 100);
+
+    // An unknown ETag gets a full response.
+    client.etag = "\"unknown\"";
+    CHECK(client.Check() == 200);
+    CHECK(client.latestModVersions.at(ModId(7)) == "1.1");
+
+    // The server gets the same data without compression.
+    client.gzip = false;
+    CHECK(client.Check() == 304);
+}
+
+void BenchmarkChecks() {
+    LocalUpdateServer server(2000);
+
+    struct Check {
+        const char* name;
+        std::function<void(UpdateClient&)> prepare;
+    };
+
+    const Check checks[] = {
+        {"full", [](UpdateClient& client) { client.etag.reset(); }},
+        {"not_modified",
+         [&](UpdateClient& client) { client.etag = server.CurrentETag(); }},
+        {"delta", [](UpdateClient& client) { client.etag = "\"v0\""; }},
+    };
+
+    server.SetModVersion(ModId(7), "1.1");
+
+    for (const auto& check : checks) {
+        for (bool gzip : {true, false}) {
+            UpdateClient client(&server, 30);
+            client.gzip = gzip;
+
+            std::string name = "UpdateCheck/";
+            name += check.name;
+            name += gzip ? "_gzip" : "_plain";
+            Benchmark::Run(name, [&](size_t) {
+                check.prepare(client);
+                client.Check();
+            });
+
+            printf(
+                "{\"benchmark\":\"%s\",\"request_bytes\":%zu,"
+                "\"response_bytes\":%zu}\n",
+                name.c_str(), client.requestBytes, client.responseBytes);
+        }
+    }
+}
+
+void BenchmarkParse() {
+    LocalUpdateServer server(2000);
+    std::string versions = server.Handle({.body = "{\"mods\": {}}"}).body;
+
+    std::unordered_set<std::string> modIds;
+    for (int i = 0; i < 30; i++) {
+        modIds.insert(ModId(i * 7));
+    }
+
+    Benchmark::Run("OnlineData::Parse/2000_mods", [&](size_t) {
+        auto parsed = OnlineData::Parse(versions, modIds);
+        CHECK(parsed.modVersions.size() == 30);
+    });
+
+    std::string userProfile = MakeUserProfile(30);
+    Benchmark::Run("Gzip::Compress/userprofile", [&](size_t) {
+        auto compressed = Gzip::Compress(userProfile);
+        Benchmark::DoNotOptimize(compressed.size());
+    });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmark::Init(argc, argv);
+
+    TestGzipRoundTrip();
+    TestParseFormats();
+    TestChecks();
+
+    BenchmarkChecks();
+    BenchmarkParse();
+
+    return 0;
+}
@@ -0,0 +1,292 @@
+// Tests of the caching rules of the URL cache: the parsing of Cache-Control
+// and Expires, and the revalidation against a local stand-in for an HTTP
+// server, which answers conditional requests with 304 Not Modified the way a
+// real server does. The client of the test follows the steps of UrlCache::Get
+// with an in-memory entry. Also a benchmark of the header parsing, which runs
+// for each response.
+
+#include "stdafx.h"
+
+#include "benchmark.h"
+#include "url_cache_policy.h"
+
+namespace {
+
+using UrlCachePolicy::kFileTimeTicksPerSecond;
+using UrlCachePolicy::kMaxAgeSeconds;
+
+constexpr ULONGLONG kNow = 133'000'000'000'000'000;
+
+ULONGLONG Seconds(ULONGLONG seconds) {
+    return seconds * kFileTimeTicksPerSecond;
+}
+
+struct Response {
+    int statusCode;
+    std::wstring cacheControl;
+    std::wstring etag;
+    std::wstring lastModified;
+    std::string body;
+};
+
+// Serves a single resource, and records the requests.
+class LocalServer {
+   public:
+    std::wstring cacheControl;
+    std::wstring etag;
+    std::wstring lastModified;
+    std::string body;
+
+    std::vector<std::wstring> requests;
+
+    Response Get(const std::wstring& requestHeaders) {
+        requests.push_back(requestHeaders);
+
+        auto ifNoneMatch = RequestHeader(requestHeaders, L"If-None-Match");
+        auto ifModifiedSince =
+            RequestHeader(requestHeaders, L"If-Modified-Since");
+        bool notModified = ifNoneMatch
+                               ? !etag.empty() && *ifNoneMatch == etag
+                               : ifModifiedSince && !lastModified.empty() &&
+                                     *ifModifiedSince == lastModified;
+        if (notModified) {
+            return {304, cacheControl, etag, lastModified, ""};
+        }
+
+        return {200, cacheControl, etag, lastModified, body};
+    }
+
+   private:
+    static std::optional<std::wstring> RequestHeader(
+        const std::wstring& headers,
+        std::wstring_view name) {
+        std::wstring prefix = std::wstring(name) + L": ";
+        for (size_t start = 0; start < headers.size();) {
+            size_t end = headers.find(L"\r\n", start);
+            std::wstring_view line(headers.data() + start, end - start);
+            if (line.starts_with(prefix)) {
+                return std::wstring(line.substr(prefix.size()));
+            }
+
+            start = end + 2;
+        }
+
+        return std::nullopt;
+    }
+};
+
+struct Entry {
+    std::wstring etag;
+    std::wstring lastModified;
+    ULONGLONG freshUntil;
+    std::string body;
+};
+
+// The steps of UrlCache::Get.
+class Client {
+   public:
+    explicit Client(LocalServer* server) : m_server(server) {}
+
+    std::optional<Entry> entry;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t revalidations = 0;
+
+    std::string Get(ULONGLONG now) {
+        if (entry && now < entry->freshUntil) {
+            hits++;
+            return entry->body;
+        }
+
+        std::wstring conditionalHeaders =
+            entry ? UrlCachePolicy::MakeConditionalHeaders(entry->etag,
+                                                           entry->lastModified)
+                  : L"";
+        Response response = m_server->Get(conditionalHeaders);
+
+        bool noStore;
+        ULONGLONG freshUntil = UrlCachePolicy::GetFreshUntil(
+            response.cacheControl, 0, now, &noStore);
+
+        if (entry && response.statusCode == 304) {
+            revalidations++;
+            entry->freshUntil = freshUntil;
+            return entry->body;
+        }
+
+        misses++;
+        if (response.statusCode == 200 && !noStore) {
+            if (freshUntil || !response.etag.empty() ||
+                !response.lastModified.empty()) {
+                entry = Entry{response.etag, response.lastModified, freshUntil,
+                              response.body};
+            }
+        } else if (entry && noStore) {
+            entry.reset();
+        }
+
+        return response.body;
+    }
+
+   private:
+    LocalServer* m_server;
+};
+
+ULONGLONG FreshUntil(std::wstring_view cacheControl,
+                     ULONGLONG expires = 0,
+                     bool* noStore = nullptr) {
+    bool unused;
+    return UrlCachePolicy::GetFreshUntil(cacheControl, expires, kNow,
+                                         noStore ? noStore : &unused);
+}
+
+void TestGetFreshUntil() {
+    bool noStore;
+
+    CHECK(FreshUntil(L"") == 0);
+    CHECK(FreshUntil(L"max-age=60") == kNow + Seconds(60));
+    CHECK(FreshUntil(L"public, max-age=60") == kNow + Seconds(60));
+    CHECK(FreshUntil(L" Max-Age=60 ,public") == kNow + Seconds(60));
+    CHECK(FreshUntil(L"max-age=0") == 0);
+    CHECK(FreshUntil(L"max-age=60x") == kNow + Seconds(60));
+
+    // Capped at a year, also when the value would overflow.
+    CHECK(FreshUntil(L"max-age=99999999999999999999999") ==
+          kNow + Seconds(kMaxAgeSeconds));
+
+    CHECK(FreshUntil(L"max-age=60, no-cache") == 0);
+    CHECK(FreshUntil(L"no-cache, max-age=60") == 0);
+
+    CHECK(FreshUntil(L"max-age=60", 0, &noStore) == kNow + Seconds(60));
+    CHECK(!noStore);
+    FreshUntil(L"private, no-store", 0, &noStore);
+    CHECK(noStore);
+
+    // Expires is used without max-age, and capped at a year.
+    CHECK(FreshUntil(L"", kNow + Seconds(10)) == kNow + Seconds(10));
+    CHECK(FreshUntil(L"max-age=60", kNow + Seconds(10)) == kNow + Seconds(60));
+    CHECK(FreshUntil(L"", kNow + Seconds(2 * kMaxAgeSeconds)) ==
+          kNow + Seconds(kMaxAgeSeconds));
+    CHECK(FreshUntil(L"no-cache", kNow + Seconds(10)) == 0);
+}
+
+void TestMakeConditionalHeaders() {
+    CHECK(UrlCachePolicy::MakeConditionalHeaders(L"", L"").empty());
+    CHECK(UrlCachePolicy::MakeConditionalHeaders(L"\"v1\"", L"") ==
+          L"If-None-Match: \"v1\"\r\n");
+    CHECK(UrlCachePolicy::MakeConditionalHeaders(
+              L"\"v1\"", L"Wed, 21 Oct 2015 07:28:00 GMT") ==
+          L"If-None-Match: \"v1\"\r\n"
+          L"If-Modified-Since: Wed, 21 Oct 2015 07:28:00 GMT\r\n");
+}
+
+void TestMakeKey() {
+    auto key = UrlCachePolicy::MakeKey(L"https://example.com/a");
+    CHECK(key.size() == 16);
+    CHECK(key.find_first_not_of(L"0123456789abcdef") == key.npos);
+    CHECK(key == UrlCachePolicy::MakeKey(L"https://example.com/a"));
+    CHECK(key != UrlCachePolicy::MakeKey(L"https://example.com/b"));
+
+    // The FNV-1a offset basis.
+    CHECK(UrlCachePolicy::MakeKey(L"") == L"cbf29ce484222325");
+}
+
+void TestRevalidation() {
+    LocalServer server;
+    server.cacheControl = L"max-age=60";
+    server.etag = L"\"v1\"";
+    server.body = "first";
+
+    Client client(&server);
+    CHECK(client.Get(kNow) == "first");
+    CHECK(client.misses == 1);
+    CHECK(server.requests == std::vector<std::wstring>{L""});
+
+    // Fresh, the server isn't asked.
+    CHECK(client.Get(kNow + Seconds(59)) == "first");
+    CHECK(client.hits == 1);
+    CHECK(server.requests.size() == 1);
+
+    // Stale, revalidated with the ETag, and fresh again.
+    CHECK(client.Get(kNow + Seconds(60)) == "first");
+    CHECK(client.revalidations == 1);
+    CHECK(server.requests.back() == L"If-None-Match: \"v1\"\r\n");
+    CHECK(client.entry->freshUntil == kNow + Seconds(120));
+    CHECK(client.Get(kNow + Seconds(61)) == "first");
+    CHECK(client.hits == 2);
+
+    // Changed on the server.
+    server.etag = L"\"v2\"";
+    server.body = "second";
+    CHECK(client.Get(kNow + Seconds(200)) == "second");
+    CHECK(client.misses == 2);
+    CHECK(client.entry->etag == L"\"v2\"");
+    CHECK(client.entry->body == "second");
+}
+
+void TestLastModifiedOnly() {
+    LocalServer server;
+    server.cacheControl = L"no-cache";
+    server.lastModified = L"Wed, 21 Oct 2015 07:28:00 GMT";
+    server.body = "content";
+
+    // Always revalidated, but the body is only downloaded once.
+    Client client(&server);
+    for (int i = 0; i < 3; i++) {
+        CHECK(client.Get(kNow + Seconds(i)) == "content");
+    }
+
+    CHECK(client.misses == 1);
+    CHECK(client.revalidations == 2);
+    CHECK(client.hits == 0);
+    CHECK(server.requests.back() ==
+          L"If-Modified-Since: Wed, 21 Oct 2015 07:28:00 GMT\r\n");
+}
+
+void TestNotStored() {
+    LocalServer server;
+    server.body = "content";
+
+    // Without a freshness lifetime or a validator.
+    Client client(&server);
+    client.Get(kNow);
+    CHECK(!client.entry);
+
+    // no-store deletes an existing entry.
+    server.cacheControl = L"max-age=60";
+    server.etag = L"\"v1\"";
+    client.Get(kNow);
+    CHECK(client.entry);
+
+    server.cacheControl = L"no-store";
+    server.etag = L"\"v2\"";
+    client.Get(kNow + Seconds(60));
+    CHECK(!client.entry);
+    CHECK(client.misses == 3);
+}
+
+void BenchmarkGetFreshUntil() {
+    Benchmark::Run("UrlCachePolicy::GetFreshUntil", [](size_t i) {
+        bool noStore;
+        ULONGLONG freshUntil = UrlCachePolicy::GetFreshUntil(
+            L"public, max-age=31536000, immutable", 0, kNow + i, &noStore);
+        Benchmark::DoNotOptimize(freshUntil);
+    });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Benchmark::Init(argc, argv);
+
+    TestGetFreshUntil();
+    TestMakeConditionalHeaders();
+    TestMakeKey();
+    TestRevalidation();
+    TestLastModifiedOnly();
+    TestNotStored();
+
+    BenchmarkGetFreshUntil();
+
+    return 0;
+}